@@ -0,0 +1,107 @@
+#include "../tcp.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+// Broadcast fan-out over loopback: the shared-payload Broadcaster against a
+// send() per connection from the publishing thread.
+// Usage: broadcast_fanout [clients] [messages] [payload bytes] [direct|queued]
+
+namespace {
+
+// Publishes `messages` times and waits until every client has all the bytes
+template <typename Publisher>
+double measure(size_t messages, size_t expected, std::atomic<size_t>& received, Publisher&& publish) {
+    received = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < messages; i++) {
+        publish();
+    }
+
+    auto deadline = start + std::chrono::seconds(30);
+    while (received < expected && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (received < expected) {
+        std::cerr << "  timed out with " << received << " of " << expected << " bytes" << std::endl;
+    }
+    return messages / elapsed;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t clientCount = argc > 1 ? std::stoul(argv[1]) : 100;
+    size_t messages = argc > 2 ? std::stoul(argv[2]) : 2000;
+    size_t payloadSize = argc > 3 ? std::stoul(argv[3]) : 256;
+    std::string sendMode = argc > 4 ? argv[4] : "queued";
+
+    if (!tcp::Library::initialize()) {
+        std::cerr << "Failed to initialize TCP library" << std::endl;
+        return 1;
+    }
+
+    tcp::TcpServer server;
+    if (sendMode == "queued") {
+        server.setSendMode(tcp::TcpConnection::SendMode::Queued);
+        // Never shed load here: both sides must deliver everything
+        server.setWriteWatermarks(SIZE_MAX / 2, SIZE_MAX);
+    }
+
+    uint16_t port = tcp::NetworkUtils::findAvailablePort("127.0.0.1", 17200);
+    if (!server.start("127.0.0.1", port)) {
+        std::cerr << "Failed to start server" << std::endl;
+        return 1;
+    }
+
+    std::atomic<size_t> received(0);
+    std::vector<std::unique_ptr<tcp::TcpClient>> clients;
+    for (size_t i = 0; i < clientCount; i++) {
+        auto client = std::make_unique<tcp::TcpClient>();
+        client->setOnDataReceived([&](const std::vector<uint8_t>& data) {
+            received += data.size();
+        });
+        if (!client->connect("127.0.0.1", port)) {
+            std::cerr << "Failed to connect client " << i << std::endl;
+            return 1;
+        }
+        clients.push_back(std::move(client));
+    }
+
+    while (server.getConnectionCount() < clientCount) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    const std::vector<uint8_t> payload(payloadSize, 'x');
+    const size_t expected = messages * payloadSize * clientCount;
+
+    double loopRate = measure(messages, expected, received, [&]() {
+        for (const auto& connection : server.getConnections()) {
+            connection->send(payload);
+        }
+    });
+    double broadcastRate = measure(messages, expected, received, [&]() {
+        server.broadcast(payload);
+    });
+
+    for (auto& client : clients) {
+        client->disconnect();
+    }
+    server.stop();
+
+    std::cout << std::fixed << std::setprecision(0);
+    std::cout << "Broadcast fan-out (" << clientCount << " clients, " << messages << " x " << payloadSize
+              << " bytes, " << sendMode << " server sends)" << std::endl;
+    std::cout << "  send() per connection: " << loopRate << " msg/s" << std::endl;
+    std::cout << "  broadcast():           " << broadcastRate << " msg/s" << std::endl;
+
+    tcp::Library::cleanup();
+    return 0;
+}
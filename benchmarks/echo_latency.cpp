@@ -0,0 +1,106 @@
+#include "../tcp.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+
+// Round-trip latency of the echo_server/echo_client pair over loopback.
+// Usage: echo_latency [iterations] [reactor|thread]
+
+namespace {
+
+double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    size_t index = static_cast<size_t>(p * (sorted.size() - 1));
+    return sorted[index];
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t iterations = argc > 1 ? std::stoul(argv[1]) : 2000;
+    std::string mode = argc > 2 ? argv[2] : "reactor";
+
+    if (!tcp::Library::initialize()) {
+        std::cerr << "Failed to initialize TCP library" << std::endl;
+        return 1;
+    }
+
+    // Echo server, same protocol as examples/echo_server.cpp
+    tcp::TcpServer server;
+    if (mode == "thread") {
+        server.setIoMode(tcp::TcpServer::IoMode::ThreadPerConnection);
+    }
+
+    auto serverFramer = std::make_shared<tcp::DelimiterFramer>("\r\n", false);
+    server.setOnDataReceived([serverFramer](std::shared_ptr<tcp::TcpConnection> connection, const std::vector<uint8_t>& data) {
+        for (const auto& message : serverFramer->unframe(data)) {
+            std::string response = "Echo: " + std::string(message.begin(), message.end()) + "\r\n";
+            connection->send(response);
+        }
+    });
+
+    uint16_t port = tcp::NetworkUtils::findAvailablePort("127.0.0.1", 17000);
+    if (!server.start("127.0.0.1", port)) {
+        std::cerr << "Failed to start server" << std::endl;
+        return 1;
+    }
+
+    // Echo client, same protocol as examples/echo_client.cpp
+    tcp::TcpClient client;
+    auto clientFramer = std::make_shared<tcp::DelimiterFramer>("\r\n", false);
+    std::mutex mutex;
+    std::condition_variable replied;
+    size_t replies = 0;
+
+    client.setOnDataReceived([&](const std::vector<uint8_t>& data) {
+        size_t count = clientFramer->unframe(data).size();
+        if (count > 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            replies += count;
+            replied.notify_one();
+        }
+    });
+
+    if (!client.connect("127.0.0.1", port)) {
+        std::cerr << "Failed to connect to server" << std::endl;
+        return 1;
+    }
+
+    std::vector<double> samples;
+    samples.reserve(iterations);
+    const std::string message = "ping\r\n";
+
+    for (size_t i = 0; i < iterations; i++) {
+        auto start = std::chrono::steady_clock::now();
+        client.send(message);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!replied.wait_for(lock, std::chrono::seconds(5), [&] { return replies > i; })) {
+            std::cerr << "Timed out waiting for echo " << i << std::endl;
+            return 1;
+        }
+        auto end = std::chrono::steady_clock::now();
+        samples.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+    }
+
+    client.disconnect();
+    server.stop();
+
+    std::sort(samples.begin(), samples.end());
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Echo round-trip latency (" << mode << " server, " << iterations << " messages)" << std::endl;
+    std::cout << "  p50:  " << percentile(samples, 0.50) << " us" << std::endl;
+    std::cout << "  p99:  " << percentile(samples, 0.99) << " us" << std::endl;
+    std::cout << "  p999: " << percentile(samples, 0.999) << " us" << std::endl;
+    std::cout << "  max:  " << samples.back() << " us" << std::endl;
+
+    tcp::Library::cleanup();
+    return 0;
+}
@@ -0,0 +1,143 @@
+#include "../tcp.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstring>
+
+// LengthPrefixedFramer and DelimiterFramer decode throughput on a stream of
+// small frames fed in socket-sized reads, so frames, headers and delimiters
+// regularly straddle two reads.
+// Usage: framer_throughput [frames] [frame bytes] [read bytes]
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+void report(const std::string& name, size_t frames, size_t bytes, Clock::time_point start) {
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::cout << "  " << std::left << std::setw(22) << name << std::right
+              << std::setw(12) << static_cast<size_t>(frames / seconds) << " frames/s"
+              << std::setw(10) << std::setprecision(1) << std::fixed << (bytes / seconds / (1024 * 1024)) << " MiB/s"
+              << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t frameCount = argc > 1 ? std::stoul(argv[1]) : 2000000;
+    size_t frameSize = argc > 2 ? std::stoul(argv[2]) : 40;
+    size_t readSize = argc > 3 ? std::stoul(argv[3]) : 65536;
+
+    // Encode the stream once
+    tcp::LengthPrefixedFramer encoder(tcp::LengthPrefixedFramer::LengthType::UInt32);
+    std::vector<uint8_t> payload(frameSize, 'm');
+    std::vector<uint8_t> frame = encoder.frame(payload);
+    std::vector<uint8_t> stream;
+    stream.reserve(frame.size() * frameCount);
+    for (size_t i = 0; i < frameCount; i++) {
+        stream.insert(stream.end(), frame.begin(), frame.end());
+    }
+
+    // Cut it into reads
+    std::vector<std::vector<uint8_t>> reads;
+    for (size_t offset = 0; offset < stream.size(); offset += readSize) {
+        size_t end = std::min(offset + readSize, stream.size());
+        reads.emplace_back(stream.begin() + offset, stream.begin() + end);
+    }
+
+    std::cout << "LengthPrefixedFramer (" << frameCount << " x " << frameSize << " bytes, "
+              << readSize << "-byte reads)" << std::endl;
+
+    {
+        tcp::LengthPrefixedFramer framer(tcp::LengthPrefixedFramer::LengthType::UInt32);
+        size_t decoded = 0;
+        auto start = Clock::now();
+        for (const auto& read : reads) {
+            decoded += framer.unframe(read).size();
+        }
+        report("unframe (vectors)", decoded, stream.size(), start);
+    }
+
+    {
+        tcp::LengthPrefixedFramer framer(tcp::LengthPrefixedFramer::LengthType::UInt32);
+        size_t decoded = 0;
+        size_t bytes = 0;
+        auto start = Clock::now();
+        for (const auto& read : reads) {
+            decoded += framer.unframe(tcp::ByteView(read), [&bytes](const tcp::ByteView& frame) {
+                bytes += frame.size();
+            });
+        }
+        report("unframe (views)", decoded, stream.size(), start);
+    }
+
+    {
+        // Same reads held in pooled blocks, as the zero-copy receive path delivers them
+        std::vector<tcp::BufferView> blocks;
+        for (const auto& read : reads) {
+            tcp::Buffer buffer = tcp::BufferPool::shared().acquire(read.size());
+            std::memcpy(buffer.data(), read.data(), read.size());
+            buffer.setSize(read.size());
+            blocks.emplace_back(std::move(buffer));
+        }
+
+        tcp::LengthPrefixedFramer framer(tcp::LengthPrefixedFramer::LengthType::UInt32);
+        size_t decoded = 0;
+        size_t bytes = 0;
+        auto start = Clock::now();
+        for (const auto& block : blocks) {
+            decoded += framer.unframe(block, [&bytes](const tcp::BufferView& frame) {
+                bytes += frame.size();
+            });
+        }
+        report("unframe (BufferView)", decoded, stream.size(), start);
+    }
+
+    // Line-oriented streams: "\n" and "\r\n" take the specialized scanners,
+    // "\r\n\r\n" the generic one
+    for (std::string delimiter : {"\n", "\r\n", "\r\n\r\n"}) {
+        std::string line(frameSize, 'm');
+        line += delimiter;
+        std::vector<uint8_t> text;
+        text.reserve(line.size() * frameCount);
+        for (size_t i = 0; i < frameCount; i++) {
+            text.insert(text.end(), line.begin(), line.end());
+        }
+        
+        std::vector<std::vector<uint8_t>> lines;
+        for (size_t offset = 0; offset < text.size(); offset += readSize) {
+            size_t end = std::min(offset + readSize, text.size());
+            lines.emplace_back(text.begin() + offset, text.begin() + end);
+        }
+        
+        std::string name = delimiter == "\n" ? "LF" : (delimiter == "\r\n" ? "CRLF" : "CRLFCRLF");
+        std::cout << "DelimiterFramer " << name << std::endl;
+        
+        {
+            tcp::DelimiterFramer framer(delimiter);
+            size_t decoded = 0;
+            auto start = Clock::now();
+            for (const auto& read : lines) {
+                decoded += framer.unframe(read).size();
+            }
+            report("unframe (vectors)", decoded, text.size(), start);
+        }
+        
+        {
+            tcp::DelimiterFramer framer(delimiter);
+            size_t decoded = 0;
+            size_t bytes = 0;
+            auto start = Clock::now();
+            for (const auto& read : lines) {
+                decoded += framer.unframe(tcp::ByteView(read), [&bytes](const tcp::ByteView& message) {
+                    bytes += message.size();
+                });
+            }
+            report("unframe (views)", decoded, text.size(), start);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,189 @@
+#include "../tcp.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <cstring>
+#include <csignal>
+#include <atomic>
+#include <thread>
+
+// Soak and capacity driver: many client sessions against a running server,
+// reporting throughput and reply latency every second. Speaks the echo
+// protocol by default, so it can point at examples/echo_server.
+// Usage: load_generator <host> <port> [--sessions=N] [--threads=N] [--rate=<msgs/s per session, 0 = closed loop>]
+//                       [--size=<bytes>] [--framing=line|length] [--ramp-up=<s>] [--duration=<s>]
+//                       [--churn=<s>] [--tls] [--insecure] [--json]
+
+namespace {
+
+std::atomic<bool> interrupted{false};
+
+void onSignal(int) {
+    interrupted = true;
+}
+
+std::chrono::milliseconds seconds(const char* text) {
+    return std::chrono::milliseconds(static_cast<long long>(std::stod(text) * 1000));
+}
+
+double micros(std::chrono::nanoseconds value) {
+    return value.count() / 1000.0;
+}
+
+std::string formatJson(const tcp::LoadGenerator::Report& report, const char* kind) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3)
+        << "{\"type\":\"" << kind << "\""
+        << ",\"elapsed\":" << report.elapsedSeconds
+        << ",\"interval\":" << report.intervalSeconds
+        << ",\"sessions\":" << report.activeSessions
+        << ",\"connects\":" << report.connects
+        << ",\"connect_failures\":" << report.connectFailures
+        << ",\"disconnects\":" << report.disconnects
+        << ",\"messages_sent\":" << report.messagesSent
+        << ",\"messages_received\":" << report.messagesReceived
+        << ",\"deferred_sends\":" << report.deferredSends
+        << ",\"bytes_sent\":" << report.bytesSent
+        << ",\"bytes_received\":" << report.bytesReceived
+        << ",\"messages_per_second\":" << report.messagesPerSecond()
+        << ",\"bytes_per_second\":" << report.bytesPerSecond()
+        << ",\"p50_us\":" << micros(report.latency.percentile(0.50))
+        << ",\"p99_us\":" << micros(report.latency.percentile(0.99))
+        << ",\"p999_us\":" << micros(report.latency.percentile(0.999))
+        << ",\"max_us\":" << report.latency.max / 1000.0
+        << ",\"connect_p99_us\":" << micros(report.connectLatency.percentile(0.99))
+        << "}";
+    return out.str();
+}
+
+std::string formatLine(const tcp::LoadGenerator::Report& report) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(0)
+        << std::setw(6) << report.elapsedSeconds << "s"
+        << "  sessions " << std::setw(7) << report.activeSessions
+        << "  +" << report.connects << "/-" << report.disconnects;
+    if (report.connectFailures > 0) {
+        out << " (" << report.connectFailures << " failed)";
+    }
+    out << "  " << std::setw(9) << report.messagesPerSecond() << " msg/s"
+        << std::setprecision(1) << std::setw(8) << report.bytesPerSecond() / (1024 * 1024) << " MiB/s"
+        << "  p50 " << micros(report.latency.percentile(0.50))
+        << "  p99 " << micros(report.latency.percentile(0.99))
+        << "  p999 " << micros(report.latency.percentile(0.999)) << " us";
+    if (report.deferredSends > 0) {
+        out << "  deferred " << report.deferredSends;
+    }
+    return out.str();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: load_generator <host> <port> [--sessions=N] [--threads=N] [--rate=<msgs/s per session>]" << std::endl
+                  << "                      [--size=<bytes>] [--framing=line|length] [--ramp-up=<s>] [--duration=<s>]" << std::endl
+                  << "                      [--churn=<s>] [--tls] [--insecure] [--json]" << std::endl;
+        return 1;
+    }
+
+    tcp::LoadGenerator::Config config;
+    config.host = argv[1];
+    config.port = static_cast<uint16_t>(std::stoi(argv[2]));
+    config.duration = std::chrono::seconds(30);
+    bool tls = false;
+    bool insecure = false;
+    bool json = false;
+
+    for (int i = 3; i < argc; i++) {
+        std::string arg = argv[i];
+        auto value = [&arg](const char* prefix) -> const char* {
+            size_t length = std::strlen(prefix);
+            return arg.compare(0, length, prefix) == 0 ? arg.c_str() + length : nullptr;
+        };
+
+        if (const char* text = value("--sessions=")) {
+            config.sessions = std::stoul(text);
+        } else if (const char* text = value("--threads=")) {
+            config.ioThreads = std::stoul(text);
+        } else if (const char* text = value("--rate=")) {
+            config.messagesPerSecond = std::stod(text);
+        } else if (const char* text = value("--size=")) {
+            config.messageSize = std::stoul(text);
+        } else if (const char* text = value("--framing=")) {
+            config.framing = std::string(text) == "length" ? tcp::LoadGenerator::Framing::LengthPrefixed
+                                                           : tcp::LoadGenerator::Framing::Line;
+        } else if (const char* text = value("--ramp-up=")) {
+            config.rampUp = seconds(text);
+        } else if (const char* text = value("--duration=")) {
+            config.duration = seconds(text);
+        } else if (const char* text = value("--churn=")) {
+            config.sessionLifetime = seconds(text);
+        } else if (arg == "--tls") {
+            tls = true;
+        } else if (arg == "--insecure") {
+            insecure = true;
+        } else if (arg == "--json") {
+            json = true;
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    if (!tcp::Library::initialize()) {
+        std::cerr << "Failed to initialize TCP library" << std::endl;
+        return 1;
+    }
+    tcp::Logger::setLevel(tcp::Logger::Level::Error);
+
+    if (tls) {
+        config.sslContext = tcp::SslContext::createClientContext();
+        if (!config.sslContext) {
+            std::cerr << "Failed to create TLS client context" << std::endl;
+            return 1;
+        }
+        if (insecure) {
+            config.sslContext->setVerifyMode(tcp::SslContext::VerifyMode::None);
+        }
+    }
+
+    tcp::LoadGenerator generator(config);
+    generator.setOnReport([json](const tcp::LoadGenerator::Report& report) {
+        std::cout << (json ? formatJson(report, "interval") : formatLine(report)) << std::endl;
+    });
+
+    if (!generator.start()) {
+        std::cerr << "Failed to start load generator" << std::endl;
+        return 1;
+    }
+
+    // Ctrl-C ends the run early and still prints the summary
+    std::signal(SIGINT, onSignal);
+    std::thread watcher([&generator]() {
+        while (generator.isRunning() && !interrupted) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        generator.stop();
+    });
+    generator.wait();
+    tcp::LoadGenerator::Report totals = generator.getTotals();
+    interrupted = true;
+    watcher.join();
+
+    if (json) {
+        std::cout << formatJson(totals, "total") << std::endl;
+    } else {
+        std::cout << "Total: " << totals.messagesReceived << " replies to " << totals.messagesSent << " requests, "
+                  << totals.connects << " connects (" << totals.connectFailures << " failed), "
+                  << std::fixed << std::setprecision(0) << totals.messagesPerSecond() << " msg/s" << std::endl
+                  << std::setprecision(1)
+                  << "  p50 " << micros(totals.latency.percentile(0.50)) << " us"
+                  << "  p99 " << micros(totals.latency.percentile(0.99)) << " us"
+                  << "  p999 " << micros(totals.latency.percentile(0.999)) << " us"
+                  << "  max " << totals.latency.max / 1000.0 << " us" << std::endl;
+    }
+
+    tcp::Library::cleanup();
+    return 0;
+}
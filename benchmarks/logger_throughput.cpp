@@ -0,0 +1,67 @@
+#include "../tcp.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+
+// Logger cost per call: filtered out, synchronous and asynchronous, with
+// output going to a file.
+// Usage: logger_throughput [messages per thread] [threads] [log file]
+
+namespace {
+
+template <typename Body>
+double measure(size_t threadCount, size_t messages, Body&& body) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < threadCount; t++) {
+        threads.emplace_back([&body, t, messages]() {
+            for (size_t i = 0; i < messages; i++) {
+                body(t, i);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    tcp::Logger::flush();
+    double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return elapsed / (threadCount * messages);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t messages = argc > 1 ? std::stoul(argv[1]) : 200000;
+    size_t threadCount = argc > 2 ? std::stoul(argv[2]) : 4;
+    std::string path = argc > 3 ? argv[3] : "logger_throughput.log";
+
+    if (!tcp::Logger::setOutputFile(path)) {
+        std::cerr << "Failed to open " << path << std::endl;
+        return 1;
+    }
+    tcp::Logger::setLevel(tcp::Logger::Level::Info);
+
+    double filtered = measure(threadCount, messages, [](size_t thread, size_t i) {
+        tcp::Logger::debug("connection {} read {} bytes", thread, i);
+    });
+    double sync = measure(threadCount, messages, [](size_t thread, size_t i) {
+        tcp::Logger::info("connection {} read {} bytes", thread, i);
+    });
+
+    tcp::Logger::startAsync(8192, tcp::Logger::OverflowPolicy::Block);
+    double async = measure(threadCount, messages, [](size_t thread, size_t i) {
+        tcp::Logger::info("connection {} read {} bytes", thread, i);
+    });
+    tcp::Logger::stopAsync();
+    tcp::Logger::setOutputFile("");
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Logger cost (" << threadCount << " threads x " << messages << " messages)" << std::endl;
+    std::cout << "  Filtered: " << filtered << " ns/call" << std::endl;
+    std::cout << "  Sync:     " << sync << " ns/call" << std::endl;
+    std::cout << "  Async:    " << async << " ns/call (including the final flush)" << std::endl;
+    return 0;
+}
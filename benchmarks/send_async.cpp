@@ -0,0 +1,128 @@
+#include "../tcp.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+
+// sendAsync() throughput over loopback, client-to-server and server-to-client.
+// Usage: send_async [messages] [payload bytes] [direct|queued]
+
+namespace {
+
+// Fires `count` sendAsync() calls and waits for every completion callback
+template <typename Sender>
+double measure(size_t count, Sender&& sender) {
+    std::mutex mutex;
+    std::condition_variable done;
+    std::atomic<size_t> completed(0);
+    std::atomic<size_t> failed(0);
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; i++) {
+        sender([&](bool success) {
+            if (!success) {
+                failed++;
+            }
+            if (++completed == count) {
+                std::lock_guard<std::mutex> lock(mutex);
+                done.notify_one();
+            }
+        });
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&] { return completed.load() == count; });
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (failed > 0) {
+        std::cerr << "  " << failed << " sends failed" << std::endl;
+    }
+    return count / elapsed;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t messages = argc > 1 ? std::stoul(argv[1]) : 20000;
+    size_t payloadSize = argc > 2 ? std::stoul(argv[2]) : 64;
+    std::string sendMode = argc > 3 ? argv[3] : "direct";
+
+    if (!tcp::Library::initialize()) {
+        std::cerr << "Failed to initialize TCP library" << std::endl;
+        return 1;
+    }
+
+    // Sink server; remembers the accepted connection for the reverse direction
+    tcp::TcpServer server;
+    if (sendMode == "queued") {
+        server.setSendMode(tcp::TcpConnection::SendMode::Queued);
+    }
+    std::atomic<size_t> serverReceived(0);
+    std::shared_ptr<tcp::TcpConnection> peer;
+    std::mutex peerMutex;
+    std::condition_variable peerReady;
+
+    server.setOnConnected([&](std::shared_ptr<tcp::TcpConnection> connection) {
+        std::lock_guard<std::mutex> lock(peerMutex);
+        peer = connection;
+        peerReady.notify_one();
+    });
+    server.setOnDataReceived([&](std::shared_ptr<tcp::TcpConnection>, const std::vector<uint8_t>& data) {
+        serverReceived += data.size();
+    });
+
+    uint16_t port = tcp::NetworkUtils::findAvailablePort("127.0.0.1", 17100);
+    if (!server.start("127.0.0.1", port)) {
+        std::cerr << "Failed to start server" << std::endl;
+        return 1;
+    }
+
+    tcp::TcpClient client;
+    std::atomic<size_t> clientReceived(0);
+    client.setOnDataReceived([&](const std::vector<uint8_t>& data) {
+        clientReceived += data.size();
+    });
+
+    if (!client.connect("127.0.0.1", port)) {
+        std::cerr << "Failed to connect to server" << std::endl;
+        return 1;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(peerMutex);
+        peerReady.wait(lock, [&] { return peer != nullptr; });
+    }
+
+    const std::vector<uint8_t> payload(payloadSize, 'x');
+
+    double clientRate = measure(messages, [&](std::function<void(bool)> callback) {
+        client.sendAsync(payload, callback);
+    });
+    double serverRate = measure(messages, [&](std::function<void(bool)> callback) {
+        peer->sendAsync(payload, callback);
+    });
+
+    // Let the receivers drain before tearing down
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while ((serverReceived < messages * payloadSize || clientReceived < messages * payloadSize) &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    peer.reset();
+    client.disconnect();
+    server.stop();
+
+    std::cout << std::fixed << std::setprecision(0);
+    std::cout << "sendAsync throughput (" << messages << " x " << payloadSize << " bytes, "
+              << sendMode << " server sends)" << std::endl;
+    std::cout << "  TcpClient:     " << clientRate << " msg/s" << std::endl;
+    std::cout << "  TcpConnection: " << serverRate << " msg/s" << std::endl;
+
+    tcp::Library::cleanup();
+    return 0;
+}
@@ -0,0 +1,1172 @@
+#include "../tcp.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <cstring>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <sys/time.h>
+#endif
+
+// Regression suite: microbenchmarks of the framing, buffering and protocol
+// helpers, then loopback harnesses over the echo_server/echo_client protocol
+// for 1, 4 and N client threads. Results print as a table and, with --json,
+// as a JSON document shaped like Google Benchmark's so the same tooling can
+// track them.
+//
+// Usage: tcp_benchmarks [--filter=<substring>] [--json[=<path>]] [--min-time=<seconds>]
+//                       [--duration=<seconds>] [--threads=<N>] [--message-size=<bytes>]
+//                       [--max-connections=<N>]
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::string filter;
+    bool json = false;
+    std::string jsonPath; // Empty: JSON to stdout, table to stderr
+    double minTime = 0.5;
+    double duration = 2.0;
+    size_t threads = 0;   // 0 = hardware concurrency
+    size_t messageSize = 64;
+    size_t maxConnections = 4096;
+};
+
+struct Result {
+    std::string name;
+    uint64_t iterations = 0;
+    double nanosPerOp = 0;
+    double itemsPerSecond = 0;
+    double bytesPerSecond = 0;
+    std::vector<std::pair<std::string, double>> counters; // Extra fields, in order
+};
+
+// Keeps benchmark bodies from being optimized away
+volatile size_t benchmarkSink = 0;
+
+bool selected(const Options& options, const std::string& name) {
+    return options.filter.empty() || name.find(options.filter) != std::string::npos;
+}
+
+// Run body (which returns anything countable) in growing batches until one
+// batch takes minTime; the last batch is the measurement
+template <typename Body>
+Result measure(const std::string& name, double minTime, size_t bytesPerOp, size_t itemsPerOp, Body&& body) {
+    uint64_t iterations = 1;
+    double seconds = 0;
+    for (;;) {
+        size_t sink = 0;
+        auto start = Clock::now();
+        for (uint64_t i = 0; i < iterations; i++) {
+            sink += static_cast<size_t>(body());
+        }
+        seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        benchmarkSink = benchmarkSink + sink;
+
+        if (seconds >= minTime || iterations >= (uint64_t(1) << 34)) {
+            break;
+        }
+        double scale = seconds > 0 ? minTime * 1.4 / seconds : 10.0;
+        iterations = static_cast<uint64_t>(iterations * std::min(10.0, std::max(2.0, scale)));
+    }
+
+    Result result;
+    result.name = name;
+    result.iterations = iterations;
+    result.nanosPerOp = seconds * 1e9 / iterations;
+    result.itemsPerSecond = itemsPerOp * iterations / seconds;
+    result.bytesPerSecond = bytesPerOp * iterations / seconds;
+    return result;
+}
+
+// Stream of whole frames about one socket read long, so feeding the same
+// block repeatedly leaves the framer between frames every time
+std::vector<uint8_t> repeatFrames(const std::vector<uint8_t>& frame, size_t targetBytes, size_t& frames) {
+    frames = std::max<size_t>(1, targetBytes / frame.size());
+    std::vector<uint8_t> stream;
+    stream.reserve(frames * frame.size());
+    for (size_t i = 0; i < frames; i++) {
+        stream.insert(stream.end(), frame.begin(), frame.end());
+    }
+    return stream;
+}
+
+void runMicrobenchmarks(const Options& options, std::vector<Result>& results) {
+    const size_t kReadSize = 65536;
+
+    // Framers
+    for (size_t frameSize : {40, 512}) {
+        std::string name = "framer/length_prefixed/unframe/" + std::to_string(frameSize);
+        if (selected(options, name)) {
+            tcp::LengthPrefixedFramer encoder(tcp::LengthPrefixedFramer::LengthType::UInt32);
+            size_t frames;
+            std::vector<uint8_t> stream = repeatFrames(encoder.frame(std::vector<uint8_t>(frameSize, 'm')), kReadSize, frames);
+            tcp::LengthPrefixedFramer framer(tcp::LengthPrefixedFramer::LengthType::UInt32);
+            tcp::ByteView input(stream);
+            results.push_back(measure(name, options.minTime, stream.size(), frames, [&]() {
+                return framer.unframe(input, [](const tcp::ByteView&) {});
+            }));
+        }
+    }
+
+    for (std::string delimiter : {"\n", "\r\n"}) {
+        std::string name = std::string("framer/delimiter/unframe/") + (delimiter == "\n" ? "lf" : "crlf");
+        if (selected(options, name)) {
+            std::string line = std::string(40, 'm') + delimiter;
+            size_t frames;
+            std::vector<uint8_t> stream = repeatFrames(std::vector<uint8_t>(line.begin(), line.end()), kReadSize, frames);
+            tcp::DelimiterFramer framer(delimiter);
+            tcp::ByteView input(stream);
+            results.push_back(measure(name, options.minTime, stream.size(), frames, [&]() {
+                return framer.unframe(input, [](const tcp::ByteView&) {});
+            }));
+        }
+    }
+
+    // CircularBuffer: one write and one read of the same size, wrapping
+    for (size_t chunk : {64, 4096}) {
+        std::string name = "circular_buffer/write_read/" + std::to_string(chunk);
+        if (selected(options, name)) {
+            tcp::BufferManager::CircularBuffer buffer(65536 + 100); // Not a multiple, so copies wrap
+            std::vector<uint8_t> in(chunk, 'c');
+            std::vector<uint8_t> out(chunk);
+            results.push_back(measure(name, options.minTime, chunk, 1, [&]() {
+                buffer.write(in.data(), in.size());
+                return buffer.read(out.data(), out.size());
+            }));
+        }
+    }
+
+    // Lock-free rings, same pattern; 65536 is rounded to itself, so the
+    // 100-byte offset makes copies wrap unless the memory is mirrored
+    for (bool mirrored : {false, true}) {
+        for (size_t chunk : {64, 4096}) {
+            std::string name = std::string(mirrored ? "spsc_ring/mirrored/" : "spsc_ring/write_read/") + std::to_string(chunk);
+            if (selected(options, name)) {
+                tcp::SpscRingBuffer ring(65536, mirrored);
+                std::vector<uint8_t> in(chunk, 'c');
+                std::vector<uint8_t> out(chunk);
+                std::vector<uint8_t> pad(100);
+                ring.write(pad.data(), pad.size());
+                ring.skip(pad.size());
+                results.push_back(measure(name, options.minTime, chunk, 1, [&]() {
+                    ring.write(in.data(), in.size());
+                    return ring.read(out.data(), out.size());
+                }));
+            }
+        }
+    }
+
+    if (selected(options, "mpsc_ring/write_read/64")) {
+        tcp::MpscRingBuffer ring(65536);
+        std::vector<uint8_t> in(64, 'c');
+        std::vector<uint8_t> out(64);
+        results.push_back(measure("mpsc_ring/write_read/64", options.minTime, 64, 1, [&]() {
+            ring.write(in.data(), in.size());
+            return ring.read(out.data(), out.size());
+        }));
+    }
+
+    // RateLimiter with a rate it never reaches, so every call is allowed
+    if (selected(options, "rate_limiter/allow_bytes")) {
+        tcp::RateLimiter limiter(size_t(1) << 50);
+        results.push_back(measure("rate_limiter/allow_bytes", options.minTime, 0, 1, [&]() {
+            return limiter.allowBytes(64);
+        }));
+    }
+
+    // A per-connection bucket under a shared parent: two CAS loops per call
+    if (selected(options, "rate_limiter/hierarchical")) {
+        auto parent = std::make_shared<tcp::RateLimiter>(size_t(1) << 50);
+        tcp::RateLimiter limiter(size_t(1) << 50, 0, parent);
+        results.push_back(measure("rate_limiter/hierarchical", options.minTime, 0, 1, [&]() {
+            return limiter.allowBytes(64);
+        }));
+    }
+
+    // Protocol helpers
+    for (size_t size : {64, 4096, 65536}) {
+        std::string name = "base64/encode/" + std::to_string(size);
+        if (selected(options, name)) {
+            std::vector<uint8_t> data = tcp::ProtocolHelper::generateRandomBytes(size);
+            results.push_back(measure(name, options.minTime, size, 1, [&]() {
+                return tcp::ProtocolHelper::base64Encode(data).size();
+            }));
+        }
+    }
+
+    for (size_t size : {4096, 65536}) {
+        std::string name = "base64/decode/" + std::to_string(size);
+        if (selected(options, name)) {
+            std::string encoded = tcp::ProtocolHelper::base64Encode(tcp::ProtocolHelper::generateRandomBytes(size));
+            results.push_back(measure(name, options.minTime, encoded.size(), 1, [&]() {
+                return tcp::ProtocolHelper::base64Decode(encoded).size();
+            }));
+        }
+    }
+
+    // Into caller buffers: the codec alone, no allocation
+    if (selected(options, "base64/encode_into/4096")) {
+        std::vector<uint8_t> data = tcp::ProtocolHelper::generateRandomBytes(4096);
+        std::vector<char> output(tcp::ProtocolHelper::base64EncodedSize(data.size()));
+        results.push_back(measure("base64/encode_into/4096", options.minTime, data.size(), 1, [&]() {
+            return tcp::ProtocolHelper::base64Encode(tcp::ByteView(data), output.data());
+        }));
+    }
+
+    if (selected(options, "base64/decode_into/4096")) {
+        std::string encoded = tcp::ProtocolHelper::base64Encode(tcp::ProtocolHelper::generateRandomBytes(4096));
+        std::vector<uint8_t> output(tcp::ProtocolHelper::base64DecodedSize(encoded.size()));
+        results.push_back(measure("base64/decode_into/4096", options.minTime, encoded.size(), 1, [&]() {
+            return tcp::ProtocolHelper::base64Decode(tcp::ByteView(encoded), output.data());
+        }));
+    }
+
+    const std::pair<const char*, void (*)(const tcp::ByteView&, uint8_t*)> hashes[] = {
+        {"hash/sha1/4096", &tcp::ProtocolHelper::sha1Digest},
+        {"hash/sha256/4096", &tcp::ProtocolHelper::sha256Digest},
+        {"hash/md5/4096", &tcp::ProtocolHelper::md5Digest},
+    };
+    for (const auto& hash : hashes) {
+        if (selected(options, hash.first)) {
+            std::vector<uint8_t> data = tcp::ProtocolHelper::generateRandomBytes(4096);
+            uint8_t digest[tcp::ProtocolHelper::kSha256DigestSize];
+            results.push_back(measure(hash.first, options.minTime, data.size(), 1, [&]() {
+                hash.second(tcp::ByteView(data), digest);
+                return digest[0];
+            }));
+        }
+    }
+
+    // A typical browser GET: about 400 bytes and 8 fields
+    const std::string httpRequest =
+        "GET /api/v1/items?page=2&sort=name HTTP/1.1\r\n"
+        "Host: api.example.com\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0 Safari/537.36\r\n"
+        "Accept: application/json, text/plain, */*\r\n"
+        "Accept-Language: en-US,en;q=0.9\r\n"
+        "Accept-Encoding: gzip, deflate, br\r\n"
+        "Cookie: session=8f14e45fceea167a5a36dedd4bea2543; theme=dark\r\n"
+        "Referer: https://www.example.com/items\r\n"
+        "Connection: keep-alive\r\n"
+        "\r\n";
+    auto pooled = [](const std::string& text) {
+        tcp::Buffer block = tcp::BufferPool::shared().acquire(text.size());
+        std::memcpy(block.data(), text.data(), text.size());
+        block.setSize(text.size());
+        return tcp::BufferView(std::move(block));
+    };
+    if (selected(options, "http/parse/request")) {
+        tcp::BufferView data = pooled(httpRequest);
+        tcp::HttpParser parser;
+        results.push_back(measure("http/parse/request", options.minTime, data.size(), 1, [&]() {
+            size_t fields = 0;
+            parser.parse(data, [&](const tcp::HttpMessage& message) { fields += message.headerCount; });
+            return fields;
+        }));
+    }
+    if (selected(options, "http/parse/pipelined/16")) {
+        std::string pipelined;
+        for (int i = 0; i < 16; i++) {
+            pipelined += httpRequest;
+        }
+        tcp::BufferView data = pooled(pipelined);
+        tcp::HttpParser parser;
+        results.push_back(measure("http/parse/pipelined/16", options.minTime, data.size(), 16, [&]() {
+            return parser.parse(data, [](const tcp::HttpMessage&) {});
+        }));
+    }
+    if (selected(options, "http/parse/chunked/16x1024")) {
+        std::string chunked = "POST /upload HTTP/1.1\r\nHost: example.com\r\nTransfer-Encoding: chunked\r\n\r\n";
+        for (int i = 0; i < 16; i++) {
+            chunked += "400\r\n" + std::string(1024, 'c') + "\r\n";
+        }
+        chunked += "0\r\n\r\n";
+        tcp::BufferView data = pooled(chunked);
+        tcp::HttpParser parser;
+        results.push_back(measure("http/parse/chunked/16x1024", options.minTime, data.size(), 1, [&]() {
+            size_t size = 0;
+            parser.parse(data, [&](const tcp::HttpMessage& message) { size += message.body.size(); });
+            return size;
+        }));
+    }
+    if (selected(options, "http/build/response")) {
+        results.push_back(measure("http/build/response", options.minTime, 0, 1, [&]() {
+            return tcp::HttpBuilder::response(200)
+                .header("Content-Type", "application/json")
+                .header("Cache-Control", "no-cache")
+                .contentLength(1024)
+                .finish()
+                .size();
+        }));
+    }
+
+    for (size_t size : {125, 4096, 65536}) {
+        for (bool mask : {true, false}) {
+            std::string name = std::string("websocket/build_frame/") + (mask ? "masked/" : "unmasked/") + std::to_string(size);
+            if (selected(options, name)) {
+                std::vector<uint8_t> payload(size, 'w');
+                results.push_back(measure(name, options.minTime, size, 1, [&]() {
+                    return tcp::ProtocolHelper::buildWebSocketFrame(payload, mask).size();
+                }));
+            }
+        }
+    }
+
+    if (selected(options, "websocket/parse_frame/masked/4096")) {
+        std::vector<uint8_t> frame = tcp::ProtocolHelper::buildWebSocketFrame(std::vector<uint8_t>(4096, 'w'), true);
+        results.push_back(measure("websocket/parse_frame/masked/4096", options.minTime, 4096, 1, [&]() {
+            return tcp::ProtocolHelper::parseWebSocketFrame(frame).size();
+        }));
+    }
+
+    if (selected(options, "websocket/parse_frame/masked/65536")) {
+        std::vector<uint8_t> frame = tcp::ProtocolHelper::buildWebSocketFrame(std::vector<uint8_t>(65536, 'w'), true);
+        results.push_back(measure("websocket/parse_frame/masked/65536", options.minTime, 65536, 1, [&]() {
+            return tcp::ProtocolHelper::parseWebSocketFrame(frame).size();
+        }));
+    }
+
+    // Masking: the byte-at-a-time loop the helpers used against the framer's
+    const uint8_t maskKey[4] = {0x37, 0xFA, 0x21, 0x3D};
+    if (selected(options, "websocket/mask/bytewise/65536")) {
+        std::vector<uint8_t> data(65536, 'w');
+        results.push_back(measure("websocket/mask/bytewise/65536", options.minTime, data.size(), 1, [&]() {
+            for (size_t i = 0; i < data.size(); i++) {
+                data[i] ^= maskKey[i % 4];
+            }
+            return data[data.size() - 1];
+        }));
+    }
+
+    if (selected(options, "websocket/mask/simd/65536")) {
+        std::vector<uint8_t> data(65536, 'w');
+        results.push_back(measure("websocket/mask/simd/65536", options.minTime, data.size(), 1, [&]() {
+            tcp::WebSocketFramer::applyMask(data.data(), data.size(), maskKey);
+            return data[data.size() - 1];
+        }));
+    }
+
+    for (size_t size : {64, 4096, 65536}) {
+        std::string name = "websocket/framer/encode/masked/" + std::to_string(size);
+        if (selected(options, name)) {
+            tcp::WebSocketFramer framer(tcp::WebSocketFramer::Role::Client);
+            std::vector<uint8_t> payload(size, 'w');
+            results.push_back(measure(name, options.minTime, size, 1, [&]() {
+                return framer.encode(tcp::WebSocketFramer::Opcode::Binary, tcp::ByteView(payload)).size();
+            }));
+        }
+    }
+
+    // Decoding unmasks the block in place, so each pass toggles the mask;
+    // the work is the same every time
+    for (size_t size : {4096, 65536}) {
+        std::string name = "websocket/framer/decode/masked/" + std::to_string(size);
+        if (selected(options, name)) {
+            tcp::WebSocketFramer client(tcp::WebSocketFramer::Role::Client);
+            tcp::WebSocketFramer server(tcp::WebSocketFramer::Role::Server);
+            tcp::BufferView frame = client.encode(tcp::WebSocketFramer::Opcode::Binary,
+                                                  tcp::ByteView(std::vector<uint8_t>(size, 'w')));
+            results.push_back(measure(name, options.minTime, size, 1, [&]() {
+                size_t received = 0;
+                server.unframe(frame, [&](tcp::WebSocketFramer::Opcode, const tcp::BufferView& payload) {
+                    received += payload.size();
+                });
+                return received;
+            }));
+        }
+    }
+
+    if (selected(options, "websocket/framer/decode/fragmented/65536")) {
+        // One 64K message in 16 fragments of 4K, reassembled
+        tcp::WebSocketFramer client(tcp::WebSocketFramer::Role::Client);
+        tcp::WebSocketFramer server(tcp::WebSocketFramer::Role::Server);
+        std::vector<uint8_t> fragment(4096, 'w');
+        std::vector<uint8_t> stream;
+        for (size_t i = 0; i < 16; i++) {
+            tcp::WebSocketFramer::Opcode opcode = i == 0 ? tcp::WebSocketFramer::Opcode::Binary
+                                                         : tcp::WebSocketFramer::Opcode::Continuation;
+            std::vector<uint8_t> frame = client.encode(opcode, tcp::ByteView(fragment), i == 15).toVector();
+            stream.insert(stream.end(), frame.begin(), frame.end());
+        }
+        tcp::Buffer block = tcp::BufferPool::shared().acquire(stream.size());
+        std::memcpy(block.data(), stream.data(), stream.size());
+        block.setSize(stream.size());
+        tcp::BufferView input(std::move(block));
+        results.push_back(measure("websocket/framer/decode/fragmented/65536", options.minTime, 65536, 1, [&]() {
+            size_t received = 0;
+            server.unframe(input, [&](tcp::WebSocketFramer::Opcode, const tcp::BufferView& payload) {
+                received += payload.size();
+            });
+            return received;
+        }));
+    }
+
+#ifdef TCP_ZLIB_SUPPORT
+    if (selected(options, "websocket/framer/deflate/round_trip/4096")) {
+        tcp::WebSocketFramer client(tcp::WebSocketFramer::Role::Client);
+        tcp::WebSocketFramer server(tcp::WebSocketFramer::Role::Server);
+        client.negotiateDeflate(server.negotiateDeflate(tcp::WebSocketFramer::deflateOffer()));
+        std::string text;
+        while (text.size() < 4096) {
+            text += "{\"id\":" + std::to_string(text.size()) + ",\"status\":\"ok\",\"items\":[1,2,3]}";
+        }
+        text.resize(4096);
+        tcp::ByteView payload(text);
+        results.push_back(measure("websocket/framer/deflate/round_trip/4096", options.minTime, text.size(), 1, [&]() {
+            size_t received = 0;
+            server.unframe(client.encode(tcp::WebSocketFramer::Opcode::Text, payload),
+                           [&](tcp::WebSocketFramer::Opcode, const tcp::BufferView& message) {
+                received += message.size();
+            });
+            return received;
+        }));
+    }
+#endif
+}
+
+// Echo server over the examples/echo_server.cpp protocol (CRLF lines
+// answered with "Echo: <line>"), one framer per connection
+class EchoServer {
+public:
+    bool start(uint16_t& port) {
+        server_.setOnConnected([this](std::shared_ptr<tcp::TcpConnection> connection) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            framers_[connection->getId()] = std::make_shared<tcp::DelimiterFramer>("\r\n", false);
+        });
+        server_.setOnDisconnected([this](std::shared_ptr<tcp::TcpConnection> connection) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            framers_.erase(connection->getId());
+        });
+        server_.setOnDataReceived([this](std::shared_ptr<tcp::TcpConnection> connection, const std::vector<uint8_t>& data) {
+            std::shared_ptr<tcp::DelimiterFramer> framer;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto it = framers_.find(connection->getId());
+                if (it == framers_.end()) {
+                    return;
+                }
+                framer = it->second;
+            }
+            for (const auto& message : framer->unframe(data)) {
+                std::string response = "Echo: " + std::string(message.begin(), message.end()) + "\r\n";
+                connection->send(response);
+            }
+        });
+
+        port = tcp::NetworkUtils::findAvailablePort("127.0.0.1", 18000);
+        return server_.start("127.0.0.1", port, 1024);
+    }
+
+    void stop() { server_.stop(); }
+    size_t getConnectionCount() const { return server_.getConnectionCount(); }
+
+private:
+    tcp::TcpServer server_;
+    std::mutex mutex_;
+    std::unordered_map<tcp::ConnectionId, std::shared_ptr<tcp::DelimiterFramer>> framers_;
+};
+
+// One echo_client-style session: send a line, wait for its echo
+class EchoSession {
+public:
+    bool connect(uint16_t port) {
+        client_.setOnDataReceived([this](const std::vector<uint8_t>& data) {
+            size_t count = framer_.unframe(data).size();
+            if (count > 0) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                replies_ += count;
+                replied_.notify_one();
+            }
+        });
+        return client_.connect("127.0.0.1", port);
+    }
+
+    bool roundTrip(const std::string& line, size_t index) {
+        client_.send(line);
+        std::unique_lock<std::mutex> lock(mutex_);
+        return replied_.wait_for(lock, std::chrono::seconds(5), [&] { return replies_ > index; });
+    }
+
+    void disconnect() { client_.disconnect(); }
+
+private:
+    tcp::TcpClient client_;
+    tcp::DelimiterFramer framer_{"\r\n", false};
+    std::mutex mutex_;
+    std::condition_variable replied_;
+    size_t replies_ = 0;
+};
+
+void addLatencyCounters(Result& result, const tcp::LatencyHistogram::Snapshot& rtt) {
+    auto micros = [](std::chrono::nanoseconds value) { return value.count() / 1000.0; };
+    result.counters.emplace_back("p50_us", micros(rtt.percentile(0.50)));
+    result.counters.emplace_back("p99_us", micros(rtt.percentile(0.99)));
+    result.counters.emplace_back("p999_us", micros(rtt.percentile(0.999)));
+    result.counters.emplace_back("max_us", rtt.max / 1000.0);
+}
+
+// Closed loop: every thread keeps one message in flight on its own client
+bool runEchoThroughput(const Options& options, size_t threads, uint16_t port, Result& result) {
+    std::vector<std::unique_ptr<EchoSession>> sessions;
+    for (size_t i = 0; i < threads; i++) {
+        sessions.emplace_back(new EchoSession());
+        if (!sessions.back()->connect(port)) {
+            std::cerr << "Failed to connect echo client " << i << std::endl;
+            return false;
+        }
+    }
+
+    std::string line(options.messageSize, 'e');
+    line += "\r\n";
+    size_t reply = line.size() + 6; // "Echo: "
+
+    tcp::LatencyHistogram rtt;
+    std::atomic<uint64_t> messages{0};
+    std::atomic<bool> failed{false};
+    auto deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.duration));
+    auto start = Clock::now();
+
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            EchoSession& session = *sessions[t];
+            uint64_t sent = 0;
+            while (Clock::now() < deadline) {
+                auto begin = Clock::now();
+                if (!session.roundTrip(line, sent)) {
+                    failed = true;
+                    break;
+                }
+                rtt.record(Clock::now() - begin);
+                sent++;
+            }
+            messages.fetch_add(sent, std::memory_order_relaxed);
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    for (auto& session : sessions) {
+        session->disconnect();
+    }
+    if (failed) {
+        std::cerr << "Timed out waiting for an echo with " << threads << " client threads" << std::endl;
+        return false;
+    }
+
+    uint64_t total = messages.load();
+    result.name = "echo/round_trip/threads:" + std::to_string(threads);
+    result.iterations = total;
+    result.nanosPerOp = total > 0 ? seconds * 1e9 / total : 0;
+    result.itemsPerSecond = total / seconds;
+    result.bytesPerSecond = total * (line.size() + reply) / seconds;
+    addLatencyCounters(result, rtt.snapshot());
+    return true;
+}
+
+#ifdef TCP_COROUTINES
+// Both ends as coroutines on one loop thread: each session is a frame
+// rather than a thread, so this is the reactor's and the syscalls' cost
+tcp::Task<> coroutineEcho(tcp::AsyncConnection connection) {
+    tcp::Buffer buffer = tcp::BufferPool::shared().acquire(16384);
+    for (;;) {
+        tcp::IoResult read = co_await connection.read(buffer);
+        if (!read.ok() || !(co_await connection.write(tcp::BufferView(buffer))).ok()) {
+            break;
+        }
+    }
+}
+
+tcp::Task<> coroutineAccept(tcp::EventLoop& loop, tcp::AsyncServer& server) {
+    tcp::AsyncConnection connection = co_await server.accept();
+    if (connection.isOpen()) {
+        tcp::spawn(loop, coroutineEcho(std::move(connection)));
+    }
+}
+
+tcp::Task<> coroutinePingPong(tcp::EventLoop& loop, uint16_t port, const Options& options, Result& result,
+                              std::promise<bool>& done) {
+    tcp::AsyncClient client(loop);
+    tcp::AsyncConnection connection = co_await client.connect("127.0.0.1", port, std::chrono::seconds(2));
+    if (!connection.isOpen()) {
+        done.set_value(false);
+        co_return;
+    }
+
+    std::string message(options.messageSize, 'e');
+    std::vector<uint8_t> reply(message.size());
+    tcp::LatencyHistogram rtt;
+    uint64_t total = 0;
+    auto deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.duration));
+    auto start = Clock::now();
+    while (Clock::now() < deadline) {
+        auto begin = Clock::now();
+        if (!(co_await connection.write(tcp::ByteView(message))).ok()) {
+            done.set_value(false);
+            co_return;
+        }
+        for (size_t received = 0; received < reply.size();) {
+            tcp::IoResult read = co_await connection.read(reply.data() + received, reply.size() - received);
+            if (!read.ok()) {
+                done.set_value(false);
+                co_return;
+            }
+            received += read.bytes;
+        }
+        rtt.record(Clock::now() - begin);
+        total++;
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    result.name = "coroutine/echo/round_trip";
+    result.iterations = total;
+    result.nanosPerOp = total > 0 ? seconds * 1e9 / total : 0;
+    result.itemsPerSecond = total / seconds;
+    result.bytesPerSecond = total * message.size() * 2 / seconds;
+    addLatencyCounters(result, rtt.snapshot());
+    connection.close(); // Ends the echo coroutine
+    done.set_value(true);
+}
+
+bool runCoroutineEcho(const Options& options, Result& result) {
+    tcp::EventLoop loop;
+    tcp::AsyncServer server(loop);
+    if (!loop.start() || !server.listen("127.0.0.1", 0)) {
+        std::cerr << "Failed to start coroutine echo server" << std::endl;
+        return false;
+    }
+
+    std::promise<bool> done;
+    std::future<bool> finished = done.get_future();
+    tcp::spawn(loop, coroutineAccept(loop, server));
+    tcp::spawn(loop, coroutinePingPong(loop, server.getLocalPort(), options, result, done));
+    bool ok = finished.wait_for(std::chrono::duration<double>(options.duration + 10)) == std::future_status::ready &&
+              finished.get();
+
+    loop.post([&server]() { server.close(); });
+    loop.stop();
+    if (!ok) {
+        std::cerr << "Coroutine echo failed" << std::endl;
+    }
+    return ok;
+}
+#endif
+
+#ifndef _WIN32
+// Raw blocking client sockets: a TcpClient per connection would cost three
+// threads each and measure the client rather than the server
+socket_t connectRaw(uint16_t port) {
+    socket_t fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == INVALID_SOCKET) {
+        return INVALID_SOCKET;
+    }
+
+    struct timeval timeout;
+    timeout.tv_sec = 2;
+    timeout.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        ::close(fd);
+        return INVALID_SOCKET;
+    }
+    return fd;
+}
+
+// Sends "ping" on every socket, then reads every echo
+bool echoRound(const std::vector<socket_t>& sockets, size_t begin, size_t end, tcp::LatencyHistogram& completion,
+               Clock::time_point start) {
+    static const char kPing[] = "ping\r\n";
+    static const size_t kReply = sizeof("Echo: ping\r\n") - 1;
+
+    for (size_t i = begin; i < end; i++) {
+        if (::send(sockets[i], kPing, sizeof(kPing) - 1, MSG_NOSIGNAL) != static_cast<ssize_t>(sizeof(kPing) - 1)) {
+            return false;
+        }
+    }
+
+    char reply[64];
+    for (size_t i = begin; i < end; i++) {
+        size_t received = 0;
+        while (received < kReply) {
+            ssize_t length = ::recv(sockets[i], reply + received, kReply - received, 0);
+            if (length <= 0) {
+                return false;
+            }
+            received += static_cast<size_t>(length);
+        }
+        completion.record(Clock::now() - start);
+    }
+    return true;
+}
+
+// Doubles the connection count until a round of echoes over all of them
+// fails or its p99 exceeds 100 ms; reports the last count that held
+bool runConnectionScaling(const Options& options, size_t threads, uint16_t port, EchoServer& server, Result& result) {
+    const auto kBudget = std::chrono::milliseconds(100);
+
+    std::vector<socket_t> sockets;
+    size_t sustained = 0;
+    tcp::LatencyHistogram::Snapshot sustainedRound;
+    auto start = Clock::now();
+
+    for (size_t target = 64; target <= options.maxConnections; target *= 2) {
+        bool connected = true;
+        while (sockets.size() < target) {
+            socket_t fd = connectRaw(port);
+            if (fd == INVALID_SOCKET) {
+                connected = false;
+                break;
+            }
+            sockets.push_back(fd);
+        }
+        if (!connected) {
+            break;
+        }
+
+        // Wait for the server to register them all
+        auto registered = Clock::now() + std::chrono::seconds(5);
+        while (server.getConnectionCount() < sockets.size() && Clock::now() < registered) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        tcp::LatencyHistogram completion;
+        std::atomic<bool> ok{true};
+        auto roundStart = Clock::now();
+        std::vector<std::thread> workers;
+        size_t perThread = (sockets.size() + threads - 1) / threads;
+        for (size_t t = 0; t < threads; t++) {
+            size_t begin = std::min(sockets.size(), t * perThread);
+            size_t end = std::min(sockets.size(), begin + perThread);
+            workers.emplace_back([&, begin, end]() {
+                if (!echoRound(sockets, begin, end, completion, roundStart)) {
+                    ok = false;
+                }
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+
+        tcp::LatencyHistogram::Snapshot round = completion.snapshot();
+        if (!ok || round.percentile(0.99) > kBudget) {
+            break;
+        }
+        sustained = sockets.size();
+        sustainedRound = std::move(round);
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    for (socket_t fd : sockets) {
+        ::close(fd);
+    }
+
+    // Let the server drain the closes before the next run
+    auto drained = Clock::now() + std::chrono::seconds(5);
+    while (server.getConnectionCount() > 0 && Clock::now() < drained) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    result.name = "connections/max_sustainable/threads:" + std::to_string(threads);
+    result.iterations = sustained;
+    result.nanosPerOp = seconds * 1e9;
+    result.counters.emplace_back("max_connections", static_cast<double>(sustained));
+    result.counters.emplace_back("connect_attempts", static_cast<double>(sockets.size()));
+    if (sustained > 0) {
+        result.counters.emplace_back("round_p99_us", sustainedRound.percentile(0.99).count() / 1000.0);
+    }
+    return true;
+}
+
+#if defined(TCP_IO_URING) && defined(__linux__)
+// Pipelined echo per event-loop backend: the client writes a batch of
+// messages at a time and reads them all back, the server echoes each
+// receive in Queued mode. Reports the server's syscalls per echoed message.
+bool runBackendEcho(const Options& options, bool ioUring, Result& result) {
+    const size_t kDepth = 16;
+
+    tcp::EventLoop::Options loopOptions;
+    loopOptions.ioUring = ioUring;
+    tcp::TcpServer server;
+    server.setIoThreadCount(1);
+    server.setEventLoopOptions(loopOptions);
+    server.setSendMode(tcp::TcpConnection::SendMode::Queued);
+    server.setOnBufferReceived([](std::shared_ptr<tcp::TcpConnection> connection, const tcp::BufferView& data) {
+        connection->send(data);
+    });
+    uint16_t port = tcp::NetworkUtils::findAvailablePort("127.0.0.1", 18500);
+    if (!server.start("127.0.0.1", port, 16)) {
+        std::cerr << "Failed to start backend echo server" << std::endl;
+        return false;
+    }
+
+    socket_t fd = connectRaw(port);
+    if (fd == INVALID_SOCKET) {
+        std::cerr << "Failed to connect to backend echo server" << std::endl;
+        server.stop();
+        return false;
+    }
+
+    std::vector<char> batch(options.messageSize * kDepth, 'p');
+    std::vector<char> reply(batch.size());
+    tcp::TcpServer::Statistics before = server.getStatistics();
+    uint64_t total = 0;
+    bool ok = true;
+    auto deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.duration));
+    auto start = Clock::now();
+    while (ok && Clock::now() < deadline) {
+        ok = ::send(fd, batch.data(), batch.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(batch.size());
+        for (size_t received = 0; ok && received < reply.size();) {
+            ssize_t length = ::recv(fd, reply.data() + received, reply.size() - received, 0);
+            ok = length > 0;
+            received += ok ? static_cast<size_t>(length) : 0;
+        }
+        total += ok ? kDepth : 0;
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    tcp::TcpServer::Statistics after = server.getStatistics();
+    ::close(fd);
+    server.stop();
+    if (!ok) {
+        std::cerr << "Backend echo failed" << std::endl;
+        return false;
+    }
+
+    size_t syscalls = (after.sendCalls - before.sendCalls) + (after.receiveCalls - before.receiveCalls) +
+                      (after.pollerCalls - before.pollerCalls);
+    result.name = std::string("echo/pipelined/backend:") + (ioUring ? "io_uring" : "epoll");
+    result.iterations = total;
+    result.nanosPerOp = total > 0 ? seconds * 1e9 / total : 0;
+    result.itemsPerSecond = total / seconds;
+    result.bytesPerSecond = total * options.messageSize * 2 / seconds;
+    result.counters.emplace_back("syscalls_per_msg", total > 0 ? static_cast<double>(syscalls) / total : 0);
+    return true;
+}
+#endif
+
+// Connection scaling needs a descriptor per socket, twice over loopback
+void raiseDescriptorLimit(size_t connections) {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0) {
+        return;
+    }
+    rlim_t wanted = static_cast<rlim_t>(connections * 2 + 256);
+    if (limit.rlim_cur < wanted) {
+        limit.rlim_cur = std::min(wanted, limit.rlim_max);
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+#endif
+
+// One-way stream of small framed messages, sent one write per message or
+// kBatch per sendBatch(); the server decodes them with receive batching.
+// Reports the server's reads per message next to the rate.
+bool runBatchedSend(const Options& options, bool batched, Result& result) {
+    const size_t kBatch = 16;
+
+    std::mutex mutex;
+    std::condition_variable drained;
+    uint64_t received = 0;
+    tcp::TcpServer server;
+    server.setIoThreadCount(1);
+    server.setReceiveBatching([] { return std::unique_ptr<tcp::MessageFramer>(new tcp::LengthPrefixedFramer()); });
+    server.setOnMessagesReceived([&](std::shared_ptr<tcp::TcpConnection>, const std::vector<tcp::BufferView>& messages) {
+        std::lock_guard<std::mutex> lock(mutex);
+        received += messages.size();
+        drained.notify_all();
+    });
+    uint16_t port = tcp::NetworkUtils::findAvailablePort("127.0.0.1", 18600);
+    if (!server.start("127.0.0.1", port, 16)) {
+        std::cerr << "Failed to start batch server" << std::endl;
+        return false;
+    }
+
+    tcp::TcpClient client;
+    if (!client.connect("127.0.0.1", port)) {
+        std::cerr << "Failed to connect to batch server" << std::endl;
+        server.stop();
+        return false;
+    }
+
+    tcp::LengthPrefixedFramer framer;
+    std::vector<uint8_t> payload(options.messageSize, 'b');
+    std::vector<tcp::ByteView> messages(kBatch, tcp::ByteView(payload));
+    std::vector<uint8_t> frame;
+    framer.appendFrame(payload, frame);
+    tcp::TcpServer::Statistics before = server.getStatistics();
+    uint64_t total = 0;
+    bool ok = true;
+    auto deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.duration));
+    auto start = Clock::now();
+    while (ok && Clock::now() < deadline) {
+        if (batched) {
+            ok = client.sendBatch(messages, framer);
+        } else {
+            for (size_t i = 0; ok && i < kBatch; i++) {
+                ok = client.send(frame);
+            }
+        }
+        total += ok ? kBatch : 0;
+    }
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        ok = ok && drained.wait_for(lock, std::chrono::seconds(10), [&] { return received >= total; });
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    tcp::TcpServer::Statistics after = server.getStatistics();
+    client.disconnect();
+    server.stop();
+    if (!ok) {
+        std::cerr << "Batched send failed" << std::endl;
+        return false;
+    }
+
+    result.name = std::string("messages/one_way/") + (batched ? "send_batch:16" : "send");
+    result.iterations = total;
+    result.nanosPerOp = total > 0 ? seconds * 1e9 / total : 0;
+    result.itemsPerSecond = total / seconds;
+    result.bytesPerSecond = total * options.messageSize / seconds;
+    result.counters.emplace_back("reads_per_msg", total > 0 ? static_cast<double>(after.receiveCalls - before.receiveCalls) / total : 0);
+    return true;
+}
+
+void runLoopbackHarnesses(const Options& options, std::vector<Result>& results) {
+    size_t hardware = options.threads > 0 ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    std::vector<size_t> clientThreads = {1, 4};
+    if (std::find(clientThreads.begin(), clientThreads.end(), hardware) == clientThreads.end()) {
+        clientThreads.push_back(hardware);
+    }
+
+#ifdef TCP_COROUTINES
+    Result coroutineResult;
+    if (selected(options, "coroutine/echo/round_trip") && runCoroutineEcho(options, coroutineResult)) {
+        results.push_back(coroutineResult);
+    }
+#endif
+
+#if defined(TCP_IO_URING) && defined(__linux__)
+    // Both backends, when the kernel can run io_uring
+    if (tcp::EventLoop().getBackend() == tcp::EventLoop::Backend::IoUring) {
+        for (bool ioUring : {false, true}) {
+            Result result;
+            if (selected(options, std::string("echo/pipelined/backend:") + (ioUring ? "io_uring" : "epoll")) &&
+                runBackendEcho(options, ioUring, result)) {
+                results.push_back(result);
+            }
+        }
+    }
+#endif
+
+    for (bool batched : {false, true}) {
+        Result result;
+        if (selected(options, std::string("messages/one_way/") + (batched ? "send_batch:16" : "send")) &&
+            runBatchedSend(options, batched, result)) {
+            results.push_back(result);
+        }
+    }
+
+    bool echo = selected(options, "echo/round_trip");
+    bool scaling = selected(options, "connections/max_sustainable");
+    if (!echo && !scaling) {
+        return;
+    }
+
+    EchoServer server;
+    uint16_t port;
+    if (!server.start(port)) {
+        std::cerr << "Failed to start echo server" << std::endl;
+        return;
+    }
+
+    for (size_t threads : clientThreads) {
+        Result result;
+        if (selected(options, "echo/round_trip/threads:" + std::to_string(threads)) &&
+            runEchoThroughput(options, threads, port, result)) {
+            results.push_back(result);
+        }
+    }
+
+#ifndef _WIN32
+    raiseDescriptorLimit(options.maxConnections);
+    for (size_t threads : clientThreads) {
+        Result result;
+        if (selected(options, "connections/max_sustainable/threads:" + std::to_string(threads)) &&
+            runConnectionScaling(options, threads, port, server, result)) {
+            results.push_back(result);
+        }
+    }
+#endif
+
+    server.stop();
+}
+
+// Output
+std::string jsonString(const std::string& value) {
+    return "\"" + tcp::ProtocolHelper::escapeJson(value) + "\"";
+}
+
+std::string jsonNumber(double value) {
+    std::ostringstream out;
+    out << std::setprecision(12) << value;
+    return out.str();
+}
+
+std::string currentDate() {
+    std::time_t now = std::time(nullptr);
+    std::tm local;
+#ifdef _WIN32
+    localtime_s(&local, &now);
+#else
+    localtime_r(&now, &local);
+#endif
+    char text[32];
+    std::strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%S", &local);
+    return text;
+}
+
+void writeJson(std::ostream& out, const Options& options, const std::vector<Result>& results) {
+    out << "{\n";
+    out << "  \"context\": {\n";
+    out << "    \"date\": " << jsonString(currentDate()) << ",\n";
+    out << "    \"library_version\": " << jsonString(tcp::Version::getString()) << ",\n";
+    out << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n";
+    out << "    \"min_time\": " << jsonNumber(options.minTime) << ",\n";
+    out << "    \"duration\": " << jsonNumber(options.duration) << ",\n";
+    out << "    \"message_size\": " << options.messageSize << "\n";
+    out << "  },\n";
+    out << "  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& result = results[i];
+        out << (i == 0 ? "\n" : ",\n") << "    {\n";
+        out << "      \"name\": " << jsonString(result.name) << ",\n";
+        out << "      \"iterations\": " << result.iterations << ",\n";
+        out << "      \"real_time\": " << jsonNumber(result.nanosPerOp) << ",\n";
+        out << "      \"time_unit\": \"ns\",\n";
+        out << "      \"items_per_second\": " << jsonNumber(result.itemsPerSecond) << ",\n";
+        out << "      \"bytes_per_second\": " << jsonNumber(result.bytesPerSecond);
+        for (const auto& counter : result.counters) {
+            out << ",\n      " << jsonString(counter.first) << ": " << jsonNumber(counter.second);
+        }
+        out << "\n    }";
+    }
+    out << "\n  ]\n}\n";
+}
+
+void writeRow(std::ostream& out, const Result& result) {
+    out << std::left << std::setw(44) << result.name << std::right << std::fixed << std::setprecision(1)
+        << std::setw(14) << result.nanosPerOp << " ns";
+    if (result.itemsPerSecond > 0) {
+        out << std::setw(14) << std::setprecision(0) << result.itemsPerSecond << " /s";
+    }
+    if (result.bytesPerSecond > 0) {
+        out << std::setw(10) << std::setprecision(1) << result.bytesPerSecond / (1024 * 1024) << " MiB/s";
+    }
+    for (const auto& counter : result.counters) {
+        out << "  " << counter.first << "=" << std::setprecision(1) << counter.second;
+    }
+    out << std::endl;
+}
+
+bool parseOptions(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto value = [&arg](const char* prefix) -> const char* {
+            size_t length = std::strlen(prefix);
+            return arg.compare(0, length, prefix) == 0 ? arg.c_str() + length : nullptr;
+        };
+
+        if (arg == "--json") {
+            options.json = true;
+        } else if (const char* path = value("--json=")) {
+            options.json = true;
+            options.jsonPath = path;
+        } else if (const char* filter = value("--filter=")) {
+            options.filter = filter;
+        } else if (const char* seconds = value("--min-time=")) {
+            options.minTime = std::stod(seconds);
+        } else if (const char* seconds = value("--duration=")) {
+            options.duration = std::stod(seconds);
+        } else if (const char* count = value("--threads=")) {
+            options.threads = std::stoul(count);
+        } else if (const char* bytes = value("--message-size=")) {
+            options.messageSize = std::stoul(bytes);
+        } else if (const char* count = value("--max-connections=")) {
+            options.maxConnections = std::stoul(count);
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "Usage: tcp_benchmarks [--filter=<substring>] [--json[=<path>]] [--min-time=<seconds>]" << std::endl
+                  << "                      [--duration=<seconds>] [--threads=<N>] [--message-size=<bytes>]" << std::endl
+                  << "                      [--max-connections=<N>]" << std::endl;
+        return 1;
+    }
+
+    if (!tcp::Library::initialize()) {
+        std::cerr << "Failed to initialize TCP library" << std::endl;
+        return 1;
+    }
+    tcp::Logger::setLevel(tcp::Logger::Level::Error);
+
+    // The table goes to stderr while JSON is on stdout
+    std::ostream& table = options.json && options.jsonPath.empty() ? std::cerr : std::cout;
+
+    std::vector<Result> results;
+    runMicrobenchmarks(options, results);
+    for (const auto& result : results) {
+        writeRow(table, result);
+    }
+
+    size_t printed = results.size();
+    runLoopbackHarnesses(options, results);
+    for (size_t i = printed; i < results.size(); i++) {
+        writeRow(table, results[i]);
+    }
+
+    if (options.json) {
+        if (options.jsonPath.empty()) {
+            writeJson(std::cout, options, results);
+        } else {
+            std::ofstream file(options.jsonPath);
+            if (!file) {
+                std::cerr << "Failed to open " << options.jsonPath << std::endl;
+                return 1;
+            }
+            writeJson(file, options, results);
+        }
+    }
+
+    tcp::Library::cleanup();
+    return 0;
+}
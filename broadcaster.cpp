@@ -0,0 +1,300 @@
+#include "broadcaster.h"
+#include "event_loop.h"
+#include <algorithm>
+#include <cstring>
+
+namespace tcp {
+
+Broadcaster::Broadcaster() : state_(std::make_shared<State>()) {
+}
+
+Broadcaster::~Broadcaster() = default;
+
+bool Broadcaster::add(std::shared_ptr<TcpConnection> connection) {
+    if (!connection) {
+        return false;
+    }
+
+    std::shared_ptr<Bucket> bucket = bucketFor(connection->getEventLoop(), true);
+    auto subscriber = std::make_shared<Subscriber>();
+    ConnectionId id = connection->getId();
+    subscriber->connection = std::move(connection);
+
+    std::lock_guard<std::mutex> lock(bucket->mutex);
+    return bucket->subscribers.emplace(id, std::move(subscriber)).second;
+}
+
+void Broadcaster::remove(const std::shared_ptr<TcpConnection>& connection) {
+    std::shared_ptr<Bucket> bucket = bucketFor(connection->getEventLoop(), false);
+    if (!bucket) {
+        return;
+    }
+
+    // Released outside the lock: the last reference may be the connection's
+    std::shared_ptr<Subscriber> subscriber;
+    {
+        std::lock_guard<std::mutex> lock(bucket->mutex);
+        auto it = bucket->subscribers.find(connection->getId());
+        if (it == bucket->subscribers.end()) {
+            return;
+        }
+        subscriber = std::move(it->second);
+        bucket->subscribers.erase(it);
+
+        for (const std::string& topic : subscriber->topics) {
+            auto members = bucket->topics.find(topic);
+            if (members != bucket->topics.end()) {
+                members->second.erase(connection->getId());
+                if (members->second.empty()) {
+                    bucket->topics.erase(members);
+                }
+            }
+        }
+    }
+}
+
+bool Broadcaster::subscribe(const std::shared_ptr<TcpConnection>& connection, const std::string& topic) {
+    std::shared_ptr<Bucket> bucket = bucketFor(connection->getEventLoop(), false);
+    if (!bucket || topic.empty()) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(bucket->mutex);
+    auto it = bucket->subscribers.find(connection->getId());
+    if (it == bucket->subscribers.end()) {
+        return false;
+    }
+
+    if (bucket->topics[topic].emplace(connection->getId(), it->second).second) {
+        it->second->topics.push_back(topic);
+    }
+    return true;
+}
+
+bool Broadcaster::unsubscribe(const std::shared_ptr<TcpConnection>& connection, const std::string& topic) {
+    std::shared_ptr<Bucket> bucket = bucketFor(connection->getEventLoop(), false);
+    if (!bucket) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(bucket->mutex);
+    auto members = bucket->topics.find(topic);
+    if (members == bucket->topics.end()) {
+        return false;
+    }
+
+    auto it = members->second.find(connection->getId());
+    if (it == members->second.end()) {
+        return false;
+    }
+
+    std::vector<std::string>& topics = it->second->topics;
+    topics.erase(std::remove(topics.begin(), topics.end(), topic), topics.end());
+    members->second.erase(it);
+    if (members->second.empty()) {
+        bucket->topics.erase(members);
+    }
+    return true;
+}
+
+size_t Broadcaster::getSubscriberCount(const std::string& topic) const {
+    size_t count = 0;
+    for (const auto& bucket : snapshotBuckets()) {
+        std::lock_guard<std::mutex> lock(bucket->mutex);
+        auto members = bucket->topics.find(topic);
+        if (members != bucket->topics.end()) {
+            count += members->second.size();
+        }
+    }
+    return count;
+}
+
+void Broadcaster::clear() {
+    std::vector<std::shared_ptr<Bucket>> buckets;
+    {
+        std::lock_guard<std::mutex> lock(bucketsMutex_);
+        buckets.swap(buckets_);
+    }
+}
+
+void Broadcaster::broadcast(const BufferView& payload, ConnectionId exclude) {
+    dispatch(nullptr, payload, exclude);
+}
+
+void Broadcaster::publish(const std::string& topic, const BufferView& payload, ConnectionId exclude) {
+    dispatch(&topic, payload, exclude);
+}
+
+BufferView Broadcaster::encode(const void* data, size_t length) {
+    Buffer buffer = BufferPool::shared().acquire(length);
+    if (length > 0) {
+        std::memcpy(buffer.data(), data, length);
+    }
+    buffer.setSize(length);
+    return BufferView(buffer);
+}
+
+void Broadcaster::onDrained(const std::shared_ptr<TcpConnection>& connection) {
+    std::shared_ptr<Bucket> bucket = bucketFor(connection->getEventLoop(), false);
+    if (!bucket) {
+        return;
+    }
+
+    // Only topics still subscribed to; an unsubscribe may have raced the backlog
+    std::vector<std::pair<std::string, BufferView>> pending;
+    {
+        std::lock_guard<std::mutex> lock(bucket->mutex);
+        auto it = bucket->subscribers.find(connection->getId());
+        if (it == bucket->subscribers.end() || it->second->pending.empty()) {
+            return;
+        }
+
+        Subscriber& subscriber = *it->second;
+        for (auto& message : subscriber.pending) {
+            if (message.first.empty() ||
+                std::find(subscriber.topics.begin(), subscriber.topics.end(), message.first) != subscriber.topics.end()) {
+                pending.push_back(std::move(message));
+            }
+        }
+        subscriber.pending.clear();
+    }
+
+    for (const auto& message : pending) {
+        if (connection->send(message.second)) {
+            state_->deliveries.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+Broadcaster::Statistics Broadcaster::getStatistics() const {
+    Statistics stats;
+    stats.messages = state_->messages.load(std::memory_order_relaxed);
+    stats.deliveries = state_->deliveries.load(std::memory_order_relaxed);
+    stats.dropped = state_->dropped.load(std::memory_order_relaxed);
+    stats.coalesced = state_->coalesced.load(std::memory_order_relaxed);
+    stats.disconnected = state_->disconnected.load(std::memory_order_relaxed);
+    return stats;
+}
+
+std::shared_ptr<Broadcaster::Bucket> Broadcaster::bucketFor(EventLoop* loop, bool create) {
+    std::lock_guard<std::mutex> lock(bucketsMutex_);
+    for (const auto& bucket : buckets_) {
+        if (bucket->loop == loop) {
+            return bucket;
+        }
+    }
+
+    if (!create) {
+        return nullptr;
+    }
+
+    auto bucket = std::make_shared<Bucket>();
+    bucket->loop = loop;
+    buckets_.push_back(bucket);
+    return bucket;
+}
+
+std::vector<std::shared_ptr<Broadcaster::Bucket>> Broadcaster::snapshotBuckets() const {
+    std::lock_guard<std::mutex> lock(bucketsMutex_);
+    return buckets_;
+}
+
+void Broadcaster::dispatch(const std::string* topic, const BufferView& payload, ConnectionId exclude) {
+    if (payload.empty()) {
+        return;
+    }
+    state_->messages.fetch_add(1, std::memory_order_relaxed);
+
+    std::string name = topic ? *topic : std::string();
+    for (const auto& bucket : snapshotBuckets()) {
+        {
+            std::lock_guard<std::mutex> lock(bucket->mutex);
+            bool empty = topic ? bucket->topics.count(name) == 0 : bucket->subscribers.empty();
+            if (empty) {
+                continue;
+            }
+        }
+
+        if (!bucket->loop) {
+            deliver(*state_, *bucket, name, topic == nullptr, payload, exclude);
+            continue;
+        }
+
+        std::shared_ptr<State> state = state_;
+        bool allMembers = topic == nullptr;
+        bucket->loop->post([state, bucket, name, allMembers, payload, exclude]() {
+            deliver(*state, *bucket, name, allMembers, payload, exclude);
+        });
+    }
+}
+
+void Broadcaster::deliver(State& state, Bucket& bucket, const std::string& topic, bool allMembers,
+                          const BufferView& payload, ConnectionId exclude) {
+    // Targets are copied so sends, closes and their callbacks run unlocked
+    std::vector<std::shared_ptr<Subscriber>> targets;
+    {
+        std::lock_guard<std::mutex> lock(bucket.mutex);
+        const Members* members = &bucket.subscribers;
+        if (!allMembers) {
+            auto it = bucket.topics.find(topic);
+            if (it == bucket.topics.end()) {
+                return;
+            }
+            members = &it->second;
+        }
+
+        targets.reserve(members->size());
+        for (const auto& entry : *members) {
+            targets.push_back(entry.second);
+        }
+    }
+
+    SlowConsumerPolicy policy = state.policy;
+    std::vector<std::shared_ptr<TcpConnection>> evicted;
+    size_t delivered = 0;
+    size_t dropped = 0;
+    size_t coalesced = 0;
+
+    for (const auto& subscriber : targets) {
+        const std::shared_ptr<TcpConnection>& connection = subscriber->connection;
+        if (connection->getId() == exclude || !connection->isConnected()) {
+            continue;
+        }
+
+        if (connection->isAboveHighWatermark()) {
+            if (policy == SlowConsumerPolicy::Drop) {
+                dropped++;
+            } else if (policy == SlowConsumerPolicy::Disconnect) {
+                evicted.push_back(connection);
+            } else {
+                auto& pending = subscriber->pending;
+                auto it = std::find_if(pending.begin(), pending.end(),
+                                       [&topic](const std::pair<std::string, BufferView>& message) {
+                                           return message.first == topic;
+                                       });
+                if (it != pending.end()) {
+                    it->second = payload;
+                    coalesced++;
+                } else {
+                    pending.emplace_back(topic, payload);
+                }
+            }
+            continue;
+        }
+
+        if (connection->send(payload)) {
+            delivered++;
+        }
+    }
+
+    state.deliveries.fetch_add(delivered, std::memory_order_relaxed);
+    state.dropped.fetch_add(dropped, std::memory_order_relaxed);
+    state.coalesced.fetch_add(coalesced, std::memory_order_relaxed);
+    state.disconnected.fetch_add(evicted.size(), std::memory_order_relaxed);
+
+    for (const auto& connection : evicted) {
+        connection->close();
+    }
+}
+
+} // namespace tcp
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "tcp_socket.h"
+#include "tcp_buffer.h"
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace tcp {
+
+// Fan-out of one payload to many connections. The payload is encoded once
+// into a pooled, reference-counted buffer that every target's outbound
+// queue shares. Connections are grouped by event loop and each loop
+// delivers to its own, so publishing costs one task per loop and a slow
+// subscriber only ever affects its own queue. Topics select subsets; every
+// added connection also receives broadcast() messages.
+class Broadcaster {
+public:
+    // What happens to a message for a queued connection above its high
+    // watermark. Direct-mode connections are always written inline.
+    enum class SlowConsumerPolicy {
+        Drop,       // Skip the message for that connection
+        Disconnect, // Close the connection
+        Coalesce    // Keep only the newest message per topic until it drains
+    };
+
+    struct Statistics {
+        size_t messages = 0;     // broadcast()/publish() calls
+        size_t deliveries = 0;   // Messages handed to a connection
+        size_t dropped = 0;
+        size_t coalesced = 0;    // Messages replaced by a newer one while waiting
+        size_t disconnected = 0;
+    };
+
+    Broadcaster();
+    ~Broadcaster();
+
+    // Non-copyable
+    Broadcaster(const Broadcaster&) = delete;
+    Broadcaster& operator=(const Broadcaster&) = delete;
+
+    // Membership (thread-safe). remove() drops all of a connection's topics.
+    bool add(std::shared_ptr<TcpConnection> connection);
+    void remove(const std::shared_ptr<TcpConnection>& connection);
+    bool subscribe(const std::shared_ptr<TcpConnection>& connection, const std::string& topic);
+    bool unsubscribe(const std::shared_ptr<TcpConnection>& connection, const std::string& topic);
+    size_t getSubscriberCount(const std::string& topic) const;
+    void clear();
+
+    // Publishing (thread-safe). Returns once every loop has the message;
+    // exclude skips one connection, such as the sender of a chat line.
+    void broadcast(const BufferView& payload, ConnectionId exclude = 0);
+    void publish(const std::string& topic, const BufferView& payload, ConnectionId exclude = 0);
+    static BufferView encode(const void* data, size_t length); // The one copy
+
+    // Hands coalesced messages to a connection that drained below its low
+    // watermark. Called on the connection's loop thread.
+    void onDrained(const std::shared_ptr<TcpConnection>& connection);
+
+    void setSlowConsumerPolicy(SlowConsumerPolicy policy) { state_->policy = policy; }
+    SlowConsumerPolicy getSlowConsumerPolicy() const { return state_->policy; }
+    Statistics getStatistics() const;
+
+private:
+    struct Subscriber {
+        std::shared_ptr<TcpConnection> connection;
+        std::vector<std::string> topics;
+        // Coalesced messages by topic ("" for broadcasts); loop thread only
+        std::vector<std::pair<std::string, BufferView>> pending;
+    };
+    using Members = std::unordered_map<ConnectionId, std::shared_ptr<Subscriber>>;
+
+    // Connections of one event loop (loop is null for loop-less connections,
+    // which are delivered to on the publishing thread)
+    struct Bucket {
+        EventLoop* loop = nullptr;
+        mutable std::mutex mutex;
+        Members subscribers;
+        std::unordered_map<std::string, Members> topics;
+    };
+
+    // Shared with tasks queued on the loops, which may outlive the Broadcaster
+    struct State {
+        std::atomic<SlowConsumerPolicy> policy{SlowConsumerPolicy::Drop};
+        std::atomic<size_t> messages{0};
+        std::atomic<size_t> deliveries{0};
+        std::atomic<size_t> dropped{0};
+        std::atomic<size_t> coalesced{0};
+        std::atomic<size_t> disconnected{0};
+    };
+
+    std::shared_ptr<State> state_;
+    std::vector<std::shared_ptr<Bucket>> buckets_;
+    mutable std::mutex bucketsMutex_;
+
+    std::shared_ptr<Bucket> bucketFor(EventLoop* loop, bool create);
+    std::vector<std::shared_ptr<Bucket>> snapshotBuckets() const;
+    void dispatch(const std::string* topic, const BufferView& payload, ConnectionId exclude);
+    static void deliver(State& state, Bucket& bucket, const std::string& topic, bool allMembers,
+                        const BufferView& payload, ConnectionId exclude);
+};
+
+} // namespace tcp
@@ -0,0 +1,506 @@
+#include "connection_pool.h"
+#include "event_loop.h"
+#include "executor.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace tcp {
+
+using Clock = std::chrono::steady_clock;
+
+// One endpoint. total counts every connection it owns: idle, checked out
+// and being connected, so the limit holds without a lock.
+struct ConnectionPoolBase::SubPool {
+    static constexpr size_t kShards = 8;
+
+    struct Idle {
+        Erased connection;
+        Clock::time_point since;
+    };
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        std::vector<Idle> stack; // Most recently used on top
+    };
+
+    Shard shards[kShards];
+    std::atomic<size_t> total{0};
+    std::atomic<size_t> idle{0};
+    std::atomic<size_t> waiters{0};
+    std::atomic<bool> closed{false};
+    std::mutex waitMutex;
+    std::condition_variable available;
+
+    bool reserve(size_t maxConnections) {
+        size_t current = total.load();
+        while (current < maxConnections) {
+            if (total.compare_exchange_weak(current, current + 1)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void unreserve() {
+        total--;
+        notify();
+    }
+
+    // The calling thread's shard first, then the others
+    bool pop(Erased& connection) {
+        if (idle.load() == 0) {
+            return false;
+        }
+        size_t home = Counter::shardIndex() % kShards;
+        for (size_t i = 0; i < kShards; i++) {
+            Shard& shard = shards[(home + i) % kShards];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            if (!shard.stack.empty()) {
+                connection = std::move(shard.stack.back().connection);
+                shard.stack.pop_back();
+                idle--;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void push(Erased connection, Clock::time_point since, size_t shardIndex) {
+        {
+            Shard& shard = shards[shardIndex % kShards];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.stack.push_back({std::move(connection), since});
+        }
+        idle++;
+        notify();
+    }
+
+    // Oldest first
+    std::vector<Idle> takeIdle() {
+        std::vector<Idle> taken;
+        for (Shard& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (auto& entry : shard.stack) {
+                taken.push_back(std::move(entry));
+            }
+            idle -= shard.stack.size();
+            shard.stack.clear();
+        }
+        std::sort(taken.begin(), taken.end(), [](const Idle& a, const Idle& b) { return a.since < b.since; });
+        return taken;
+    }
+
+    // Pairs with waiters++ before the waiter's last look at the stacks
+    void notify(bool all = false) {
+        if (waiters.load() > 0) {
+            std::lock_guard<std::mutex> lock(waitMutex);
+            if (all) {
+                available.notify_all();
+            } else {
+                available.notify_one();
+            }
+        }
+    }
+};
+
+struct ConnectionPoolBase::State {
+    // Hot path settings
+    std::atomic<size_t> maxConnections;
+    std::atomic<size_t> minIdle{0};
+    std::atomic<int64_t> acquireTimeout{5000};
+    std::atomic<int64_t> idleTimeout{60000};
+
+    // Rarely changed; guarded by mutex
+    std::chrono::milliseconds healthCheckInterval{5000};
+    TimerId healthCheckTimer = 0;
+    ErasedFactory factory;
+    ErasedCheck healthCheck;
+    std::shared_ptr<ReconnectPolicy> policy;
+    mutable std::mutex mutex;
+
+    const ErasedCheck isConnected;
+    std::unordered_map<std::string, std::shared_ptr<SubPool>> pools;
+    mutable std::shared_mutex poolsMutex;
+    std::atomic<bool> maintaining{false};
+    std::atomic<bool> stopped{false};
+
+    // Metrics
+    Counter acquires;
+    Counter hits;
+    Counter misses;
+    Counter timeouts;
+    Counter connectFailures;
+    Counter evictions;
+    Counter healthCheckFailures;
+    LatencyHistogram waitTime;
+
+    State(size_t maxConnections, ErasedCheck isConnected)
+        : maxConnections(maxConnections), isConnected(std::move(isConnected)) {
+    }
+
+    std::shared_ptr<SubPool> find(const std::string& endpoint) const {
+        std::shared_lock<std::shared_mutex> lock(poolsMutex);
+        auto it = pools.find(endpoint);
+        return it != pools.end() ? it->second : nullptr;
+    }
+
+    std::shared_ptr<SubPool> findOrCreate(const std::string& endpoint) {
+        std::shared_ptr<SubPool> pool = find(endpoint);
+        if (pool) {
+            return pool;
+        }
+        std::unique_lock<std::shared_mutex> lock(poolsMutex);
+        std::shared_ptr<SubPool>& slot = pools[endpoint];
+        if (!slot) {
+            slot = std::make_shared<SubPool>();
+        }
+        return slot;
+    }
+
+    std::vector<std::shared_ptr<SubPool>> snapshot() const {
+        std::vector<std::shared_ptr<SubPool>> result;
+        std::shared_lock<std::shared_mutex> lock(poolsMutex);
+        result.reserve(pools.size());
+        for (const auto& entry : pools) {
+            result.push_back(entry.second);
+        }
+        return result;
+    }
+
+    // With a slot reserved; gives it back on failure
+    Erased connect(const std::string& endpoint, SubPool& pool) {
+        ErasedFactory factoryCopy;
+        std::shared_ptr<ReconnectPolicy> policyCopy;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            factoryCopy = factory;
+            policyCopy = policy;
+        }
+
+        Erased connection;
+        if (factoryCopy && (!policyCopy || policyCopy->allowAttempt())) {
+            connection = factoryCopy(endpoint);
+            if (policyCopy) {
+                if (connection) {
+                    policyCopy->recordSuccess();
+                } else {
+                    policyCopy->recordFailure();
+                }
+            }
+        }
+        if (!connection) {
+            connectFailures.add();
+            pool.unreserve();
+        }
+        return connection;
+    }
+
+    // Health checks, eviction and warm-up, on the shared Executor
+    void maintain() {
+        if (maintaining.exchange(true)) {
+            return;
+        }
+
+        ErasedCheck check;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            check = healthCheck;
+        }
+        std::chrono::milliseconds idleLimit(idleTimeout.load());
+        size_t minimum = minIdle.load();
+
+        std::vector<std::pair<std::string, std::shared_ptr<SubPool>>> endpoints;
+        {
+            std::shared_lock<std::shared_mutex> lock(poolsMutex);
+            endpoints.assign(pools.begin(), pools.end());
+        }
+
+        for (auto& endpoint : endpoints) {
+            SubPool& pool = *endpoint.second;
+            std::vector<SubPool::Idle> taken = pool.takeIdle();
+            std::vector<Erased> dropped; // Closed outside the stacks' locks
+            auto now = Clock::now();
+            size_t shard = 0;
+            for (auto& entry : taken) {
+                if (idleLimit.count() > 0 && now - entry.since >= idleLimit && pool.total.load() > minimum) {
+                    evictions.add();
+                } else if (!isConnected(entry.connection.get()) || (check && !check(entry.connection.get()))) {
+                    healthCheckFailures.add();
+                } else {
+                    pool.push(std::move(entry.connection), entry.since, shard++);
+                    continue;
+                }
+                dropped.push_back(std::move(entry.connection));
+                pool.unreserve();
+            }
+            dropped.clear();
+
+            while (!stopped && !pool.closed && pool.total.load() < minimum && pool.reserve(maxConnections.load())) {
+                Erased connection = connect(endpoint.first, pool);
+                if (!connection) {
+                    break;
+                }
+                pool.push(std::move(connection), Clock::now(), shard++);
+            }
+        }
+
+        maintaining = false;
+    }
+
+    void scheduleHealthCheck(const std::shared_ptr<State>& self) {
+        EventLoop& loop = EventLoop::shared();
+        if (healthCheckTimer != 0) {
+            loop.cancelTimer(healthCheckTimer);
+            healthCheckTimer = 0;
+        }
+        if (healthCheckInterval.count() <= 0) {
+            return;
+        }
+
+        std::weak_ptr<State> weak = self;
+        healthCheckTimer = loop.runEvery(healthCheckInterval, [weak]() {
+            // Factories and health checks may block
+            if (auto state = weak.lock()) {
+                Executor::shared().trySubmit([state]() { state->maintain(); });
+            }
+        });
+    }
+};
+
+ConnectionPoolBase::ConnectionPoolBase(size_t maxConnections, ErasedCheck isConnected)
+    : state_(std::make_shared<State>(maxConnections, std::move(isConnected))) {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    state_->scheduleHealthCheck(state_);
+}
+
+ConnectionPoolBase::~ConnectionPoolBase() {
+    state_->stopped = true;
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        if (state_->healthCheckTimer != 0) {
+            EventLoop::shared().cancelTimer(state_->healthCheckTimer);
+            state_->healthCheckTimer = 0;
+        }
+    }
+    clear();
+}
+
+void ConnectionPoolBase::setMaxConnections(size_t maxConnections) {
+    state_->maxConnections = maxConnections;
+    for (auto& pool : state_->snapshot()) {
+        pool->notify(true);
+    }
+}
+
+size_t ConnectionPoolBase::getMaxConnections() const {
+    return state_->maxConnections;
+}
+
+void ConnectionPoolBase::setMinIdleConnections(size_t minIdle) {
+    state_->minIdle = minIdle;
+}
+
+size_t ConnectionPoolBase::getMinIdleConnections() const {
+    return state_->minIdle;
+}
+
+void ConnectionPoolBase::setAcquireTimeout(std::chrono::milliseconds timeout) {
+    state_->acquireTimeout = timeout.count();
+}
+
+std::chrono::milliseconds ConnectionPoolBase::getAcquireTimeout() const {
+    return std::chrono::milliseconds(state_->acquireTimeout.load());
+}
+
+void ConnectionPoolBase::setIdleTimeout(std::chrono::milliseconds timeout) {
+    state_->idleTimeout = timeout.count();
+}
+
+std::chrono::milliseconds ConnectionPoolBase::getIdleTimeout() const {
+    return std::chrono::milliseconds(state_->idleTimeout.load());
+}
+
+void ConnectionPoolBase::setHealthCheckInterval(std::chrono::milliseconds interval) {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    state_->healthCheckInterval = interval;
+    state_->scheduleHealthCheck(state_);
+}
+
+std::chrono::milliseconds ConnectionPoolBase::getHealthCheckInterval() const {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    return state_->healthCheckInterval;
+}
+
+void ConnectionPoolBase::setReconnectPolicy(std::shared_ptr<ReconnectPolicy> policy) {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    state_->policy = policy;
+}
+
+std::shared_ptr<ReconnectPolicy> ConnectionPoolBase::getReconnectPolicy() const {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    return state_->policy;
+}
+
+bool ConnectionPoolBase::warmUp(const std::string& endpoint) {
+    std::shared_ptr<SubPool> pool = state_->findOrCreate(endpoint);
+    while (pool->total.load() < state_->minIdle.load()) {
+        if (!pool->reserve(state_->maxConnections.load())) {
+            break;
+        }
+        Erased connection = state_->connect(endpoint, *pool);
+        if (!connection) {
+            return false;
+        }
+        giveBack(pool, std::move(connection), true);
+    }
+    return true;
+}
+
+void ConnectionPoolBase::clear() {
+    std::unordered_map<std::string, std::shared_ptr<SubPool>> pools;
+    {
+        std::unique_lock<std::shared_mutex> lock(state_->poolsMutex);
+        pools.swap(state_->pools);
+    }
+
+    for (auto& entry : pools) {
+        SubPool& pool = *entry.second;
+        pool.closed = true;
+        std::vector<SubPool::Idle> idle = pool.takeIdle();
+        pool.total -= idle.size();
+        pool.notify(true);
+    }
+}
+
+size_t ConnectionPoolBase::getActiveConnections() const {
+    size_t active = 0;
+    for (auto& pool : state_->snapshot()) {
+        active += pool->total.load() - std::min(pool->total.load(), pool->idle.load());
+    }
+    return active;
+}
+
+size_t ConnectionPoolBase::getIdleConnections() const {
+    size_t idle = 0;
+    for (auto& pool : state_->snapshot()) {
+        idle += pool->idle.load();
+    }
+    return idle;
+}
+
+size_t ConnectionPoolBase::getActiveConnections(const std::string& endpoint) const {
+    std::shared_ptr<SubPool> pool = state_->find(endpoint);
+    return pool ? pool->total.load() - std::min(pool->total.load(), pool->idle.load()) : 0;
+}
+
+size_t ConnectionPoolBase::getIdleConnections(const std::string& endpoint) const {
+    std::shared_ptr<SubPool> pool = state_->find(endpoint);
+    return pool ? pool->idle.load() : 0;
+}
+
+ConnectionPoolBase::Statistics ConnectionPoolBase::getStatistics() const {
+    Statistics stats;
+    stats.acquires = static_cast<size_t>(state_->acquires.value());
+    stats.hits = static_cast<size_t>(state_->hits.value());
+    stats.misses = static_cast<size_t>(state_->misses.value());
+    stats.timeouts = static_cast<size_t>(state_->timeouts.value());
+    stats.connectFailures = static_cast<size_t>(state_->connectFailures.value());
+    stats.evictions = static_cast<size_t>(state_->evictions.value());
+    stats.healthCheckFailures = static_cast<size_t>(state_->healthCheckFailures.value());
+    stats.activeConnections = getActiveConnections();
+    stats.idleConnections = getIdleConnections();
+    stats.waitTime = state_->waitTime.snapshot();
+    return stats;
+}
+
+void ConnectionPoolBase::setFactory(ErasedFactory factory) {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    state_->factory = std::move(factory);
+}
+
+void ConnectionPoolBase::setHealthCheck(ErasedCheck check) {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    state_->healthCheck = std::move(check);
+}
+
+ConnectionPoolBase::Lease ConnectionPoolBase::acquireErased(const std::string& endpoint, std::chrono::milliseconds timeout) {
+    State& state = *state_;
+    auto start = Clock::now();
+    auto deadline = start + timeout;
+    state.acquires.add();
+
+    Lease lease;
+    lease.pool = state.findOrCreate(endpoint);
+    SubPool& pool = *lease.pool;
+
+    std::unique_lock<std::mutex> waitLock(pool.waitMutex, std::defer_lock);
+    bool expired = false;
+    for (;;) {
+        while (pool.pop(lease.connection)) {
+            if (state.isConnected(lease.connection.get())) {
+                state.hits.add();
+                if (waitLock.owns_lock()) {
+                    pool.waiters--;
+                }
+                state.waitTime.record(Clock::now() - start);
+                return lease;
+            }
+            // Closed by the peer while idle. Its slot is reserved again below,
+            // so no one else needs waking (and waitMutex may be held).
+            state.healthCheckFailures.add();
+            lease.connection.reset();
+            pool.total--;
+        }
+
+        if (pool.reserve(state.maxConnections.load())) {
+            if (waitLock.owns_lock()) {
+                pool.waiters--;
+                waitLock.unlock();
+            }
+            lease.connection = state.connect(endpoint, pool);
+            if (!lease.connection) {
+                lease.pool.reset();
+                return lease;
+            }
+            state.misses.add();
+            state.waitTime.record(Clock::now() - start);
+            return lease;
+        }
+
+        if (expired || pool.closed || timeout.count() <= 0) {
+            break;
+        }
+        if (!waitLock.owns_lock()) {
+            // Registered before looking again, so a release can't slip by
+            waitLock.lock();
+            pool.waiters++;
+            continue;
+        }
+        expired = pool.available.wait_until(waitLock, deadline) == std::cv_status::timeout;
+    }
+
+    if (waitLock.owns_lock()) {
+        pool.waiters--;
+    }
+    state.timeouts.add();
+    lease.pool.reset();
+    return lease;
+}
+
+void ConnectionPoolBase::giveBack(const std::shared_ptr<SubPool>& pool, Erased connection, bool reusable) {
+    if (!pool || !connection) {
+        return;
+    }
+    if (reusable && !pool->closed) {
+        pool->push(std::move(connection), Clock::now(), Counter::shardIndex());
+        return;
+    }
+    connection.reset();
+    pool->unreserve();
+}
+
+} // namespace tcp
@@ -0,0 +1,209 @@
+#pragma once
+
+#include "metrics.h"
+#include "reconnect_policy.h"
+#include <memory>
+#include <string>
+#include <chrono>
+#include <functional>
+
+namespace tcp {
+
+// Forward declarations
+class TcpConnection;
+class TcpClient;
+
+// Untyped core of BasicConnectionPool. Each endpoint (an opaque string the
+// factory understands, e.g. "db1:5432") has its own sub-pool with a limit
+// on open connections. Idle connections sit on per-thread-sharded stacks,
+// so a hot acquire/release cycle touches one uncontended lock and a few
+// atomics; handles return connections in O(1) without searching. A timer
+// on EventLoop::shared() periodically health-checks idle connections,
+// evicts those idle too long and pre-connects endpoints back up to the
+// minimum, on the shared Executor.
+class ConnectionPoolBase {
+public:
+    struct Statistics {
+        size_t acquires = 0;
+        size_t hits = 0;                // Served an idle connection
+        size_t misses = 0;              // Connected for the caller
+        size_t timeouts = 0;            // Nothing free within the acquire timeout
+        size_t connectFailures = 0;     // Factory failed or the reconnect policy refused
+        size_t evictions = 0;           // Idle longer than the idle timeout
+        size_t healthCheckFailures = 0; // Closed or failed the health check while idle
+        size_t activeConnections = 0;   // Checked out or connecting
+        size_t idleConnections = 0;
+        LatencyHistogram::Snapshot waitTime; // acquire() until it returned a connection
+
+        double hitRate() const { return acquires > 0 ? static_cast<double>(hits) / acquires : 0.0; }
+    };
+
+    // Non-copyable
+    ConnectionPoolBase(const ConnectionPoolBase&) = delete;
+    ConnectionPoolBase& operator=(const ConnectionPoolBase&) = delete;
+
+    // Configuration. Limits apply per endpoint.
+    void setMaxConnections(size_t maxConnections);
+    size_t getMaxConnections() const;
+    void setMinIdleConnections(size_t minIdle); // Kept pre-connected by the health check
+    size_t getMinIdleConnections() const;
+    void setAcquireTimeout(std::chrono::milliseconds timeout); // 0 = fail at once when exhausted
+    std::chrono::milliseconds getAcquireTimeout() const;
+    void setIdleTimeout(std::chrono::milliseconds timeout); // 0 = never evict
+    std::chrono::milliseconds getIdleTimeout() const;
+    void setHealthCheckInterval(std::chrono::milliseconds interval); // 0 = no background checks
+    std::chrono::milliseconds getHealthCheckInterval() const;
+
+    // Paces the factory: while the policy backs off or its circuit is open,
+    // acquire() without an idle connection fails fast instead of connecting.
+    // One policy covers every endpoint.
+    void setReconnectPolicy(std::shared_ptr<ReconnectPolicy> policy);
+    std::shared_ptr<ReconnectPolicy> getReconnectPolicy() const;
+
+    // Connects on the calling thread until the endpoint has the minimum idle
+    // connections; returns false if the factory failed
+    bool warmUp(const std::string& endpoint = std::string());
+
+    // Drops idle connections and forgets every endpoint. Connections checked
+    // out are closed when returned, and waiting acquires give up.
+    void clear();
+
+    // Totals across endpoints
+    size_t getActiveConnections() const;
+    size_t getIdleConnections() const;
+    size_t getActiveConnections(const std::string& endpoint) const;
+    size_t getIdleConnections(const std::string& endpoint) const;
+    Statistics getStatistics() const;
+
+protected:
+    using Erased = std::shared_ptr<void>;
+    using ErasedFactory = std::function<Erased(const std::string& endpoint)>;
+    using ErasedCheck = std::function<bool(void* connection)>;
+
+    struct SubPool;
+    struct State;
+    struct Lease {
+        std::shared_ptr<SubPool> pool;
+        Erased connection;
+    };
+
+    ConnectionPoolBase(size_t maxConnections, ErasedCheck isConnected);
+    ~ConnectionPoolBase();
+
+    void setFactory(ErasedFactory factory);
+    void setHealthCheck(ErasedCheck check);
+    Lease acquireErased(const std::string& endpoint, std::chrono::milliseconds timeout);
+
+    // Back to the idle stack, or closed when not reusable or the pool is gone
+    static void giveBack(const std::shared_ptr<SubPool>& pool, Erased connection, bool reusable);
+
+private:
+    std::shared_ptr<State> state_; // Shared with the health check timer and tasks
+};
+
+// Pool of connections of one type; see ConnectionPoolBase.
+template <typename Connection>
+class BasicConnectionPool : public ConnectionPoolBase {
+public:
+    using Factory = std::function<std::shared_ptr<Connection>(const std::string& endpoint)>;
+    using HealthCheck = std::function<bool(Connection& connection)>; // Idle connections only
+
+    // Checked-out connection. Returns it to its sub-pool when released or
+    // destroyed, or closes it if it is no longer connected.
+    class Handle {
+    public:
+        Handle() = default;
+        ~Handle() { release(); }
+
+        Handle(Handle&& other) noexcept
+            : pool_(std::move(other.pool_)), connection_(std::move(other.connection_)) {
+        }
+        Handle& operator=(Handle&& other) noexcept {
+            if (this != &other) {
+                release();
+                pool_ = std::move(other.pool_);
+                connection_ = std::move(other.connection_);
+            }
+            return *this;
+        }
+
+        // Non-copyable
+        Handle(const Handle&) = delete;
+        Handle& operator=(const Handle&) = delete;
+
+        Connection* operator->() const { return connection_.get(); }
+        Connection& operator*() const { return *connection_; }
+        explicit operator bool() const { return connection_ != nullptr; }
+        const std::shared_ptr<Connection>& get() const { return connection_; }
+
+        void release() {
+            if (connection_) {
+                bool reusable = connection_->isConnected();
+                giveBack(pool_, std::move(connection_), reusable);
+                connection_.reset();
+                pool_.reset();
+            }
+        }
+
+        // Broken or in an unknown protocol state: close instead of reusing
+        void discard() {
+            if (connection_) {
+                giveBack(pool_, std::move(connection_), false);
+                connection_.reset();
+                pool_.reset();
+            }
+        }
+
+    private:
+        friend class BasicConnectionPool;
+
+        Handle(std::shared_ptr<SubPool> pool, std::shared_ptr<Connection> connection)
+            : pool_(std::move(pool)), connection_(std::move(connection)) {
+        }
+
+        std::shared_ptr<SubPool> pool_;
+        std::shared_ptr<Connection> connection_;
+    };
+
+    explicit BasicConnectionPool(size_t maxConnections = 10)
+        : ConnectionPoolBase(maxConnections, [](void* connection) {
+              return static_cast<Connection*>(connection)->isConnected();
+          }) {
+    }
+
+    // Empty when the endpoint is exhausted for the whole timeout (the
+    // configured acquire timeout by default) or a connect failed
+    Handle acquire(const std::string& endpoint = std::string()) {
+        return acquire(endpoint, getAcquireTimeout());
+    }
+    Handle acquire(const std::string& endpoint, std::chrono::milliseconds timeout) {
+        Lease lease = acquireErased(endpoint, timeout);
+        return Handle(std::move(lease.pool), std::static_pointer_cast<Connection>(lease.connection));
+    }
+    void release(Handle& handle) { handle.release(); }
+
+    // Connects for an endpoint; returns nullptr on failure. Called without
+    // pool locks held, possibly from the shared Executor when warming up.
+    void setEndpointFactory(Factory factory) {
+        setFactory([factory](const std::string& endpoint) -> Erased { return factory(endpoint); });
+    }
+    void setConnectionFactory(std::function<std::shared_ptr<Connection>()> factory) {
+        setFactory([factory](const std::string&) -> Erased { return factory(); });
+    }
+
+    // Run on idle connections at each health check, after isConnected()
+    void setHealthCheck(HealthCheck check) {
+        if (!check) {
+            ConnectionPoolBase::setHealthCheck(nullptr);
+            return;
+        }
+        ConnectionPoolBase::setHealthCheck([check](void* connection) {
+            return check(*static_cast<Connection*>(connection));
+        });
+    }
+};
+
+using ConnectionPool = BasicConnectionPool<TcpConnection>;
+using ClientPool = BasicConnectionPool<TcpClient>; // Outbound connections, e.g. an RPC tier
+
+} // namespace tcp
@@ -0,0 +1,92 @@
+#include "connection_registry.h"
+
+namespace tcp {
+
+ConnectionRegistry::ConnectionRegistry(size_t shardCount) : size_(0) {
+    size_t count = 1;
+    while (count < shardCount) {
+        count <<= 1;
+    }
+    shards_.reset(new Shard[count]);
+    shardMask_ = count - 1;
+}
+
+bool ConnectionRegistry::insert(std::shared_ptr<TcpConnection> connection) {
+    if (!connection) {
+        return false;
+    }
+    
+    ConnectionId id = connection->getId();
+    Shard& shard = shardFor(id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (!shard.connections.emplace(id, std::move(connection)).second) {
+        return false;
+    }
+    size_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+std::shared_ptr<TcpConnection> ConnectionRegistry::remove(ConnectionId id) {
+    std::shared_ptr<TcpConnection> connection;
+    Shard& shard = shardFor(id);
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.connections.find(id);
+        if (it == shard.connections.end()) {
+            return nullptr;
+        }
+        connection = std::move(it->second);
+        shard.connections.erase(it);
+    }
+    size_.fetch_sub(1, std::memory_order_relaxed);
+    return connection;
+}
+
+std::shared_ptr<TcpConnection> ConnectionRegistry::find(ConnectionId id) const {
+    Shard& shard = shardFor(id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.connections.find(id);
+    return it != shard.connections.end() ? it->second : nullptr;
+}
+
+void ConnectionRegistry::forEach(const std::function<void(const std::shared_ptr<TcpConnection>&)>& callback) const {
+    std::vector<std::shared_ptr<TcpConnection>> batch;
+    for (size_t i = 0; i <= shardMask_; i++) {
+        batch.clear();
+        copyShard(shards_[i], batch);
+        for (const auto& connection : batch) {
+            callback(connection);
+        }
+    }
+}
+
+std::vector<std::shared_ptr<TcpConnection>> ConnectionRegistry::snapshot() const {
+    std::vector<std::shared_ptr<TcpConnection>> connections;
+    connections.reserve(size());
+    for (size_t i = 0; i <= shardMask_; i++) {
+        copyShard(shards_[i], connections);
+    }
+    return connections;
+}
+
+std::vector<std::shared_ptr<TcpConnection>> ConnectionRegistry::clear() {
+    std::vector<std::shared_ptr<TcpConnection>> connections;
+    for (size_t i = 0; i <= shardMask_; i++) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        for (auto& entry : shards_[i].connections) {
+            connections.push_back(std::move(entry.second));
+        }
+        size_.fetch_sub(shards_[i].connections.size(), std::memory_order_relaxed);
+        shards_[i].connections.clear();
+    }
+    return connections;
+}
+
+void ConnectionRegistry::copyShard(const Shard& shard, std::vector<std::shared_ptr<TcpConnection>>& out) const {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    for (const auto& entry : shard.connections) {
+        out.push_back(entry.second);
+    }
+}
+
+} // namespace tcp
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "tcp_socket.h"
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include <unordered_map>
+
+namespace tcp {
+
+// Connection set keyed by ConnectionId. Entries are spread over independently
+// locked shards so insert/remove/find are O(1) and rarely contend; iteration
+// copies one shard at a time and invokes callbacks without holding any lock.
+class ConnectionRegistry {
+public:
+    explicit ConnectionRegistry(size_t shardCount = 16); // Rounded up to a power of two
+
+    // Non-copyable
+    ConnectionRegistry(const ConnectionRegistry&) = delete;
+    ConnectionRegistry& operator=(const ConnectionRegistry&) = delete;
+
+    bool insert(std::shared_ptr<TcpConnection> connection);
+    std::shared_ptr<TcpConnection> remove(ConnectionId id);
+    std::shared_ptr<TcpConnection> find(ConnectionId id) const;
+    size_t size() const { return size_.load(std::memory_order_relaxed); }
+
+    // Iteration over a point-in-time copy of each shard
+    void forEach(const std::function<void(const std::shared_ptr<TcpConnection>&)>& callback) const;
+    std::vector<std::shared_ptr<TcpConnection>> snapshot() const;
+
+    // Empties the registry and returns its former contents
+    std::vector<std::shared_ptr<TcpConnection>> clear();
+
+private:
+    // Cache-line aligned so neighbouring shard locks don't false-share
+    struct alignas(64) Shard {
+        mutable std::mutex mutex;
+        std::unordered_map<ConnectionId, std::shared_ptr<TcpConnection>> connections;
+    };
+
+    std::unique_ptr<Shard[]> shards_;
+    size_t shardMask_;
+    std::atomic<size_t> size_;
+
+    Shard& shardFor(ConnectionId id) const { return shards_[id & shardMask_]; }
+    void copyShard(const Shard& shard, std::vector<std::shared_ptr<TcpConnection>>& out) const;
+};
+
+} // namespace tcp
@@ -0,0 +1,249 @@
+#include "connector.h"
+#include "resolver.h"
+#include <algorithm>
+
+namespace tcp {
+
+namespace {
+
+void closeSocketHandle(socket_t socket) {
+#ifdef _WIN32
+    closesocket(socket);
+#else
+    ::close(socket);
+#endif
+}
+
+void setNonBlockingHandle(socket_t socket) {
+#ifdef _WIN32
+    u_long mode = 1;
+    ioctlsocket(socket, FIONBIO, &mode);
+#else
+    fcntl(socket, F_SETFL, fcntl(socket, F_GETFL, 0) | O_NONBLOCK);
+#endif
+}
+
+bool isConnectInProgress() {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EINPROGRESS;
+#endif
+}
+
+} // namespace
+
+Connector::Connector(EventLoop& loop)
+    : loop_(loop), attemptDelay_(kDefaultAttemptDelay), nextAddress_(0),
+      deadlineTimer_(0), attemptTimer_(0), done_(false),
+      lastError_(ErrorCode::ConnectionFailed), lastMessage_("Connection failed") {
+}
+
+Connector::~Connector() {
+    // Only left over when the loop stopped mid-connect
+    for (const auto& attempt : attempts_) {
+        closeSocketHandle(attempt.socket);
+    }
+}
+
+void Connector::connect(const std::string& host, uint16_t port, std::chrono::milliseconds timeout, Callback callback) {
+    auto self = shared_from_this();
+    loop_.dispatch([self, timeout, callback]() {
+        self->start(timeout, callback);
+    });
+
+    // Queued behind start(), whichever thread resolves
+    Resolver::shared().resolve(host, [self, port](const Resolver::Result& result) {
+        std::vector<SocketAddress> addresses = result.addresses;
+        for (auto& address : addresses) {
+            address.setPort(port);
+        }
+        std::string error = result.error;
+        self->loop_.dispatch([self, addresses, error]() {
+            self->onResolved(addresses, error);
+        });
+    });
+}
+
+void Connector::connect(std::vector<SocketAddress> addresses, std::chrono::milliseconds timeout, Callback callback) {
+    auto self = shared_from_this();
+    loop_.dispatch([self, timeout, callback]() {
+        self->start(timeout, callback);
+    });
+    loop_.dispatch([self, addresses]() {
+        self->onResolved(addresses, "No addresses to connect to");
+    });
+}
+
+void Connector::cancel() {
+    auto self = shared_from_this();
+    loop_.dispatch([self]() {
+        if (!self->done_) {
+            self->fail(ErrorCode::ConnectionFailed, "Connect cancelled");
+        }
+    });
+}
+
+std::vector<SocketAddress> Connector::sortAddresses(const std::vector<SocketAddress>& addresses) {
+    if (addresses.empty()) {
+        return addresses;
+    }
+
+    std::vector<SocketAddress> preferred;
+    std::vector<SocketAddress> other;
+    int family = addresses.front().getFamily();
+    for (const auto& address : addresses) {
+        (address.getFamily() == family ? preferred : other).push_back(address);
+    }
+
+    std::vector<SocketAddress> sorted;
+    sorted.reserve(addresses.size());
+    for (size_t i = 0; i < std::max(preferred.size(), other.size()); i++) {
+        if (i < preferred.size()) {
+            sorted.push_back(preferred[i]);
+        }
+        if (i < other.size()) {
+            sorted.push_back(other[i]);
+        }
+    }
+    return sorted;
+}
+
+void Connector::start(std::chrono::milliseconds timeout, Callback callback) {
+    callback_ = std::move(callback);
+    if (timeout.count() > 0) {
+        auto self = shared_from_this();
+        deadlineTimer_ = loop_.runAfter(timeout, [self]() {
+            self->deadlineTimer_ = 0;
+            self->fail(ErrorCode::Timeout, "Connection timeout");
+        });
+    }
+}
+
+void Connector::onResolved(std::vector<SocketAddress> addresses, const std::string& error) {
+    if (done_) {
+        return;
+    }
+    if (addresses.empty()) {
+        fail(ErrorCode::InvalidAddress, error);
+        return;
+    }
+
+    addresses_ = sortAddresses(addresses);
+    startAttempt();
+}
+
+void Connector::startAttempt() {
+    while (!done_ && nextAddress_ < addresses_.size()) {
+        const SocketAddress& address = addresses_[nextAddress_++];
+
+        socket_t socket = ::socket(address.getFamily(), SOCK_STREAM, IPPROTO_TCP);
+        if (socket == INVALID_SOCKET) {
+            // E.g. no IPv6 on this host: on to the next address
+            lastMessage_ = "Cannot create a socket for " + address.toString();
+            continue;
+        }
+        setNonBlockingHandle(socket);
+
+        if (::connect(socket, address.get(), address.getLength()) == 0) {
+            Result result;
+            result.socket = socket;
+            result.address = address;
+            finish(result);
+            return;
+        }
+
+        auto self = shared_from_this();
+        if (!isConnectInProgress() ||
+            !loop_.add(socket, EventLoop::Writable, [self, socket](uint32_t) { self->onWritable(socket); })) {
+            closeSocketHandle(socket);
+            lastMessage_ = "Connection to " + address.toString() + " failed";
+            continue;
+        }
+        attempts_.push_back({socket, address});
+
+        // The next address joins the race unless this one settles first
+        if (nextAddress_ < addresses_.size()) {
+            attemptTimer_ = loop_.runAfter(attemptDelay_, [self]() {
+                self->attemptTimer_ = 0;
+                self->startAttempt();
+            });
+        }
+        return;
+    }
+
+    if (!done_ && attempts_.empty()) {
+        fail(lastError_, lastMessage_);
+    }
+}
+
+void Connector::onWritable(socket_t socket) {
+    auto it = std::find_if(attempts_.begin(), attempts_.end(), [socket](const Attempt& attempt) {
+        return attempt.socket == socket;
+    });
+    if (done_ || it == attempts_.end()) {
+        return;
+    }
+
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (getsockopt(socket, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error), &length) == 0 && error == 0) {
+        Result result;
+        result.socket = socket;
+        result.address = it->address;
+        attempts_.erase(it);
+        loop_.remove(socket);
+        finish(result);
+        return;
+    }
+
+    lastMessage_ = "Connection to " + it->address.toString() + " failed";
+    closeAttempt(socket);
+
+    // A failed attempt starts the next one at once (RFC 8305 section 5)
+    if (attemptTimer_ != 0) {
+        loop_.cancelTimer(attemptTimer_);
+        attemptTimer_ = 0;
+    }
+    startAttempt();
+}
+
+void Connector::closeAttempt(socket_t socket) {
+    loop_.remove(socket);
+    closeSocketHandle(socket);
+    attempts_.erase(std::remove_if(attempts_.begin(), attempts_.end(), [socket](const Attempt& attempt) {
+        return attempt.socket == socket;
+    }), attempts_.end());
+}
+
+void Connector::fail(ErrorCode error, const std::string& message) {
+    Result result;
+    result.error = error;
+    result.message = message;
+    finish(result);
+}
+
+void Connector::finish(Result result) {
+    done_ = true;
+
+    // Cancelling drops the timers' references to this connector
+    if (deadlineTimer_ != 0) {
+        loop_.cancelTimer(deadlineTimer_);
+        deadlineTimer_ = 0;
+    }
+    if (attemptTimer_ != 0) {
+        loop_.cancelTimer(attemptTimer_);
+        attemptTimer_ = 0;
+    }
+    while (!attempts_.empty()) {
+        closeAttempt(attempts_.back().socket);
+    }
+
+    Callback callback = std::move(callback_);
+    callback_ = nullptr;
+    if (callback) {
+        callback(result);
+    }
+}
+
+} // namespace tcp
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "tcp_socket.h"
+#include "event_loop.h"
+#include <vector>
+#include <memory>
+#include <string>
+#include <chrono>
+#include <functional>
+
+namespace tcp {
+
+// One non-blocking outbound connect, driven by an event loop. Names go
+// through the Resolver cache, and the addresses race as in RFC 8305 (Happy
+// Eyeballs v2): families alternate, starting with the resolver's preferred
+// one, and a new attempt starts every attempt delay (or as soon as the
+// last one fails) while earlier ones stay in flight. The first to connect
+// wins and the others are closed, so a dead IPv6 route costs 250 ms rather
+// than a full connect timeout. No thread blocks, and descriptors above
+// FD_SETSIZE are fine.
+class Connector : public std::enable_shared_from_this<Connector> {
+public:
+    // On success socket is connected, non-blocking and owned by the callee
+    struct Result {
+        socket_t socket = INVALID_SOCKET;
+        SocketAddress address;
+        ErrorCode error = ErrorCode::Success;
+        std::string message;
+
+        bool ok() const { return socket != INVALID_SOCKET; }
+    };
+    using Callback = std::function<void(const Result&)>;
+
+    static constexpr std::chrono::milliseconds kDefaultAttemptDelay{250};
+
+    explicit Connector(EventLoop& loop);
+    ~Connector();
+
+    // Non-copyable
+    Connector(const Connector&) = delete;
+    Connector& operator=(const Connector&) = delete;
+
+    // Call once. The timeout covers resolution and every attempt (0 =
+    // none); the callback runs once, on the loop thread.
+    void connect(const std::string& host, uint16_t port, std::chrono::milliseconds timeout, Callback callback);
+    void connect(std::vector<SocketAddress> addresses, std::chrono::milliseconds timeout, Callback callback);
+    void cancel(); // Reports ErrorCode::ConnectionFailed unless already done
+
+    void setAttemptDelay(std::chrono::milliseconds delay) { attemptDelay_ = delay; } // Before connect()
+    std::chrono::milliseconds getAttemptDelay() const { return attemptDelay_; }
+
+    // Interleaves families, keeping the order within each (RFC 8305 section 4)
+    static std::vector<SocketAddress> sortAddresses(const std::vector<SocketAddress>& addresses);
+
+private:
+    struct Attempt {
+        socket_t socket;
+        SocketAddress address;
+    };
+
+    // Loop thread only, after start()
+    EventLoop& loop_;
+    std::chrono::milliseconds attemptDelay_;
+    std::vector<SocketAddress> addresses_;
+    size_t nextAddress_;
+    std::vector<Attempt> attempts_; // In flight
+    TimerId deadlineTimer_;
+    TimerId attemptTimer_;
+    Callback callback_;
+    bool done_;
+    ErrorCode lastError_;
+    std::string lastMessage_;
+
+    void start(std::chrono::milliseconds timeout, Callback callback);
+    void onResolved(std::vector<SocketAddress> addresses, const std::string& error);
+    void startAttempt();
+    void onWritable(socket_t socket);
+    void closeAttempt(socket_t socket);
+    void fail(ErrorCode error, const std::string& message);
+    void finish(Result result);
+};
+
+} // namespace tcp
@@ -0,0 +1,399 @@
+#include "coroutine.h"
+
+#if defined(TCP_COROUTINES) && defined(__cpp_impl_coroutine)
+
+#include <cstring>
+
+#ifndef _WIN32
+#include <netinet/tcp.h>
+#endif
+
+namespace tcp {
+
+namespace {
+
+#ifdef MSG_NOSIGNAL
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+constexpr int kSendFlags = 0;
+#endif
+
+void closeSocketHandle(socket_t socket) {
+#ifdef _WIN32
+    closesocket(socket);
+#else
+    ::close(socket);
+#endif
+}
+
+bool isWouldBlock() {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+bool isInterrupted() {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEINTR;
+#else
+    return errno == EINTR;
+#endif
+}
+
+bool shouldRetryAccept() {
+#ifdef _WIN32
+    int error = WSAGetLastError();
+    return error == WSAECONNRESET || error == WSAEINTR;
+#else
+    return errno == EINTR || errno == ECONNABORTED || errno == EPROTO;
+#endif
+}
+
+void prepareSocket(socket_t socket) {
+#ifdef _WIN32
+    u_long mode = 1;
+    ioctlsocket(socket, FIONBIO, &mode);
+#else
+    fcntl(socket, F_SETFL, fcntl(socket, F_GETFL, 0) | O_NONBLOCK);
+#endif
+    int optval = 1;
+    setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&optval), sizeof(optval));
+#ifdef SO_NOSIGPIPE
+    setsockopt(socket, SOL_SOCKET, SO_NOSIGPIPE, reinterpret_cast<const char*>(&optval), sizeof(optval));
+#endif
+}
+
+} // namespace
+
+void spawn(EventLoop& loop, Task<void> task) {
+    if (!task.handle_) {
+        return;
+    }
+    std::coroutine_handle<Task<void>::promise_type> handle = std::exchange(task.handle_, nullptr);
+    handle.promise().detached = true;
+    loop.dispatch([handle]() {
+        handle.resume();
+    });
+}
+
+namespace detail {
+
+// IoState
+
+IoState::IoState(EventLoop& loop, socket_t socket)
+    : loop_(loop), socket_(socket), reader_(nullptr), writer_(nullptr), interest_(0), registered_(false) {
+}
+
+IoState::~IoState() {
+    close();
+}
+
+bool IoState::wait(IoOperation& operation, uint32_t direction) {
+    if (!registered_) {
+        uint32_t interest = direction | (reader_ ? EventLoop::Readable : 0) | (writer_ ? EventLoop::Writable : 0);
+        if (!loop_.add(socket_, interest, [this](uint32_t events) { onEvents(events); })) {
+            return false;
+        }
+        registered_ = true;
+        interest_ = interest;
+    } else if ((interest_ & direction) == 0) {
+        setInterest(interest_ | direction);
+    }
+
+    if (direction == EventLoop::Readable) {
+        reader_ = &operation;
+    } else {
+        writer_ = &operation;
+    }
+    return true;
+}
+
+void IoState::close() {
+    if (socket_ == INVALID_SOCKET) {
+        return;
+    }
+    if (registered_) {
+        loop_.remove(socket_);
+        registered_ = false;
+    }
+    closeSocketHandle(socket_);
+    socket_ = INVALID_SOCKET;
+    interest_ = 0;
+
+    // Waiting operations find the socket gone; they resume from the loop so
+    // close() never runs another coroutine on its own stack
+    for (IoOperation* operation : {std::exchange(reader_, nullptr), std::exchange(writer_, nullptr)}) {
+        if (operation) {
+            operation->perform();
+            std::coroutine_handle<> handle = operation->handle;
+            loop_.post([handle]() {
+                handle.resume();
+            });
+        }
+    }
+}
+
+void IoState::onEvents(uint32_t events) {
+    bool failed = (events & (EventLoop::Error | EventLoop::Hangup)) != 0;
+    IoOperation* reader = reader_;
+    IoOperation* writer = writer_;
+
+    // Retry what's waiting; an error or hangup lets each find out why
+    IoOperation* readerDone = nullptr;
+    IoOperation* writerDone = nullptr;
+    if (reader && ((events & EventLoop::Readable) || failed) && reader->perform()) {
+        readerDone = reader;
+        reader_ = nullptr;
+    }
+    if (writer && ((events & EventLoop::Writable) || failed) && writer->perform()) {
+        writerDone = writer;
+        writer_ = nullptr;
+    }
+
+    // Readiness nobody was waiting for: stop asking for it. Level-triggered
+    // errors and hangups can't be masked, so with nothing waiting the
+    // socket leaves the loop until the next operation.
+    if (failed && !reader_ && !writer_) {
+        loop_.remove(socket_);
+        registered_ = false;
+        interest_ = 0;
+    } else {
+        uint32_t idle = 0;
+        if ((events & EventLoop::Readable) && !reader) {
+            idle |= EventLoop::Readable;
+        }
+        if ((events & EventLoop::Writable) && !writer) {
+            idle |= EventLoop::Writable;
+        }
+        if (idle != 0) {
+            setInterest(interest_ & ~idle);
+        }
+    }
+
+    // Resuming may destroy this state, so it comes last
+    if (readerDone && writerDone) {
+        std::coroutine_handle<> writerHandle = writerDone->handle;
+        readerDone->handle.resume();
+        writerHandle.resume();
+    } else if (readerDone) {
+        readerDone->handle.resume();
+    } else if (writerDone) {
+        writerDone->handle.resume();
+    }
+}
+
+void IoState::setInterest(uint32_t interest) {
+    if (interest != interest_ && loop_.modify(socket_, interest)) {
+        interest_ = interest;
+    }
+}
+
+} // namespace detail
+
+// AsyncConnection
+
+AsyncConnection::AsyncConnection(EventLoop& loop, socket_t socket, const SocketAddress& peer)
+    : peer_(peer), error_(ErrorCode::Success) {
+    if (socket != INVALID_SOCKET) {
+        prepareSocket(socket);
+        state_ = std::make_unique<detail::IoState>(loop, socket);
+    } else {
+        error_ = ErrorCode::InvalidSocket;
+    }
+}
+
+void AsyncConnection::close() {
+    if (state_) {
+        state_->close();
+    }
+}
+
+AsyncConnection AsyncConnection::failed(ErrorCode error) {
+    AsyncConnection connection;
+    connection.error_ = error;
+    return connection;
+}
+
+AsyncConnection::ReadAwaiter::ReadAwaiter(detail::IoState* state, uint8_t* data, size_t length, Buffer* buffer)
+    : state_(state), data_(data), length_(length), buffer_(buffer) {
+    if (!state_) {
+        result_.error = ErrorCode::InvalidSocket;
+    }
+}
+
+bool AsyncConnection::ReadAwaiter::perform() {
+    if (!state_->isOpen()) {
+        result_.error = ErrorCode::ConnectionClosed;
+        return true;
+    }
+    for (;;) {
+        int received = ::recv(state_->getSocket(), reinterpret_cast<char*>(data_), static_cast<int>(length_), 0);
+        if (received > 0) {
+            result_.bytes = static_cast<size_t>(received);
+            if (buffer_) {
+                buffer_->setSize(result_.bytes);
+            }
+            return true;
+        }
+        if (received == 0) {
+            result_.error = ErrorCode::ConnectionClosed;
+        } else if (isInterrupted()) {
+            continue;
+        } else if (isWouldBlock()) {
+            return false;
+        } else {
+            result_.error = ErrorCode::ReceiveFailed;
+        }
+        if (buffer_) {
+            buffer_->setSize(0);
+        }
+        return true;
+    }
+}
+
+AsyncConnection::WriteAwaiter::WriteAwaiter(detail::IoState* state, const ByteView& data)
+    : state_(state), data_(data) {
+    if (!state_) {
+        result_.error = ErrorCode::InvalidSocket;
+    }
+}
+
+bool AsyncConnection::WriteAwaiter::perform() {
+    if (!state_->isOpen()) {
+        result_.error = ErrorCode::ConnectionClosed;
+        return true;
+    }
+    while (result_.bytes < data_.size()) {
+        int sent = ::send(state_->getSocket(), reinterpret_cast<const char*>(data_.data() + result_.bytes),
+                          static_cast<int>(data_.size() - result_.bytes), kSendFlags);
+        if (sent > 0) {
+            result_.bytes += static_cast<size_t>(sent);
+        } else if (sent < 0 && isInterrupted()) {
+            continue;
+        } else if (sent < 0 && isWouldBlock()) {
+            return false;
+        } else {
+            result_.error = ErrorCode::SendFailed;
+            return true;
+        }
+    }
+    return true;
+}
+
+// AsyncClient
+
+AsyncClient::ConnectAwaiter::ConnectAwaiter(EventLoop& loop, std::string host, uint16_t port,
+                                            std::chrono::milliseconds timeout)
+    : loop_(loop), host_(std::move(host)), port_(port), timeout_(timeout), done_(false), suspended_(false) {
+}
+
+bool AsyncClient::ConnectAwaiter::await_suspend(std::coroutine_handle<> handle) {
+    handle_ = handle;
+    auto connector = std::make_shared<Connector>(loop_);
+    // The connector holds itself until it reports, which drops the cycle
+    connector->connect(host_, port_, timeout_, [this, connector](const Connector::Result& result) {
+        result_ = result;
+        done_ = true;
+        if (suspended_) {
+            handle_.resume();
+        }
+    });
+    // Failures found on the spot report before connect() returns
+    suspended_ = !done_;
+    return suspended_;
+}
+
+AsyncConnection AsyncClient::ConnectAwaiter::await_resume() {
+    if (!result_.ok()) {
+        return AsyncConnection::failed(result_.error != ErrorCode::Success ? result_.error : ErrorCode::ConnectionFailed);
+    }
+    return AsyncConnection(loop_, result_.socket, result_.address);
+}
+
+// AsyncServer
+
+AsyncServer::AsyncServer(EventLoop& loop) : loop_(loop), localPort_(0) {
+}
+
+AsyncServer::~AsyncServer() {
+    close();
+}
+
+bool AsyncServer::listen(const std::string& address, uint16_t port, int backlog) {
+    close();
+
+    SocketAddress bindAddress;
+    if (!SocketAddress::parse(address, port, bindAddress)) {
+        return false;
+    }
+    socket_t listener = ::socket(bindAddress.getFamily(), SOCK_STREAM, IPPROTO_TCP);
+    if (listener == INVALID_SOCKET) {
+        return false;
+    }
+
+    int optval = 1;
+    bool ok = setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&optval), sizeof(optval)) == 0 &&
+              ::bind(listener, bindAddress.get(), bindAddress.getLength()) != SOCKET_ERROR &&
+              ::listen(listener, backlog) != SOCKET_ERROR;
+    if (!ok) {
+        closeSocketHandle(listener);
+        return false;
+    }
+#ifdef _WIN32
+    u_long mode = 1;
+    ioctlsocket(listener, FIONBIO, &mode);
+#else
+    fcntl(listener, F_SETFL, fcntl(listener, F_GETFL, 0) | O_NONBLOCK);
+#endif
+
+    localPort_ = SocketAddress::local(listener).getPort();
+    state_ = std::make_unique<detail::IoState>(loop_, listener);
+    return true;
+}
+
+void AsyncServer::close() {
+    if (state_) {
+        state_->close();
+    }
+}
+
+AsyncServer::AcceptAwaiter::AcceptAwaiter(detail::IoState* state)
+    : state_(state), socket_(INVALID_SOCKET), error_(state ? ErrorCode::Success : ErrorCode::InvalidSocket) {
+}
+
+bool AsyncServer::AcceptAwaiter::perform() {
+    if (!state_->isOpen()) {
+        error_ = ErrorCode::ConnectionClosed;
+        return true;
+    }
+    for (;;) {
+        struct sockaddr_storage address;
+        socklen_t length = sizeof(address);
+        socket_t accepted = ::accept(state_->getSocket(), reinterpret_cast<struct sockaddr*>(&address), &length);
+        if (accepted != INVALID_SOCKET) {
+            socket_ = accepted;
+            peer_ = SocketAddress(reinterpret_cast<struct sockaddr*>(&address), length);
+            return true;
+        }
+        if (isWouldBlock()) {
+            return false;
+        }
+        if (!shouldRetryAccept()) {
+            error_ = ErrorCode::AcceptFailed;
+            return true;
+        }
+    }
+}
+
+AsyncConnection AsyncServer::AcceptAwaiter::await_resume() {
+    if (socket_ == INVALID_SOCKET) {
+        return AsyncConnection::failed(error_);
+    }
+    return AsyncConnection(state_->getLoop(), socket_, peer_);
+}
+
+} // namespace tcp
+
+#endif // TCP_COROUTINES
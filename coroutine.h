@@ -0,0 +1,363 @@
+#pragma once
+
+// C++20 coroutine API, built with TCP_COROUTINES (CMake -DTCP_COROUTINES=ON)
+#if defined(TCP_COROUTINES) && defined(__cpp_impl_coroutine)
+
+#include "tcp_socket.h"
+#include "event_loop.h"
+#include "connector.h"
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+
+namespace tcp {
+
+template <typename T = void>
+class Task;
+
+namespace detail {
+
+// Promise state shared by every Task: whoever awaits it is resumed by
+// symmetric transfer when it finishes; a detached task frees itself
+struct TaskPromiseBase {
+    std::coroutine_handle<> continuation;
+    std::exception_ptr exception;
+    bool detached = false;
+
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            TaskPromiseBase& promise = handle.promise();
+            if (promise.continuation) {
+                return promise.continuation;
+            }
+            if (promise.detached) {
+                handle.destroy();
+            }
+            return std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+    };
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    void unhandled_exception() noexcept {
+        if (detached) {
+            std::terminate(); // Nobody to rethrow to, as with a thread
+        }
+        exception = std::current_exception();
+    }
+};
+
+template <typename T>
+struct TaskResult {
+    std::optional<T> value;
+
+    void return_value(T result) { value.emplace(std::move(result)); }
+    T take() { return std::move(*value); }
+};
+
+template <>
+struct TaskResult<void> {
+    void return_void() {}
+    void take() {}
+};
+
+// Pending read, write or accept, living in the awaiting coroutine's frame.
+// perform() retries the operation on readiness and returns true once it
+// has a result.
+struct IoOperation {
+    std::coroutine_handle<> handle;
+
+    virtual ~IoOperation() = default;
+    virtual bool perform() = 0;
+};
+
+// Registration of one socket with its loop. Interest is added when an
+// operation would block and dropped lazily, when readiness arrives with
+// nothing waiting, so a read loop re-arms without a syscall per read.
+class IoState {
+public:
+    IoState(EventLoop& loop, socket_t socket);
+    ~IoState();
+
+    // Non-copyable
+    IoState(const IoState&) = delete;
+    IoState& operator=(const IoState&) = delete;
+
+    EventLoop& getLoop() const { return loop_; }
+    socket_t getSocket() const { return socket_; }
+    bool isOpen() const { return socket_ != INVALID_SOCKET; }
+
+    bool wait(IoOperation& operation, uint32_t direction); // EventLoop::Readable or Writable; false if it can't
+    void close(); // Pending operations complete with ConnectionClosed
+
+private:
+    EventLoop& loop_;
+    socket_t socket_;
+    IoOperation* reader_;
+    IoOperation* writer_;
+    uint32_t interest_;
+    bool registered_;
+
+    void onEvents(uint32_t events);
+    void setInterest(uint32_t interest);
+};
+
+} // namespace detail
+
+// Lazily started coroutine: it runs when awaited, or when handed to
+// spawn(), and costs one frame allocation. Exceptions reach the awaiter.
+template <typename T>
+class Task {
+public:
+    struct promise_type : detail::TaskPromiseBase, detail::TaskResult<T> {
+        Task get_return_object() noexcept { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+    };
+
+    Task() = default;
+    Task(Task&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (handle_) {
+                handle_.destroy();
+            }
+            handle_ = std::exchange(other.handle_, nullptr);
+        }
+        return *this;
+    }
+    ~Task() {
+        if (handle_) {
+            handle_.destroy();
+        }
+    }
+
+    // Non-copyable
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    bool isValid() const { return static_cast<bool>(handle_); }
+
+    // Awaiting runs the task; the awaiter resumes where it finishes
+    bool await_ready() const noexcept { return !handle_ || handle_.done(); }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle_.promise().continuation = awaiting;
+        return handle_;
+    }
+    T await_resume() {
+        promise_type& promise = handle_.promise();
+        if (promise.exception) {
+            std::rethrow_exception(promise.exception);
+        }
+        return promise.take();
+    }
+
+private:
+    friend void spawn(EventLoop& loop, Task<void> task);
+
+    std::coroutine_handle<promise_type> handle_;
+
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+};
+
+// Starts a task on the loop's thread (inline when already on it) without
+// awaiting it; its frame is freed when it finishes
+void spawn(EventLoop& loop, Task<void> task);
+
+// Outcome of an awaited read or write. End of stream is ConnectionClosed.
+struct IoResult {
+    size_t bytes = 0;
+    ErrorCode error = ErrorCode::Success;
+
+    bool ok() const { return error == ErrorCode::Success; }
+};
+
+// Connected non-blocking socket for coroutines. Operations are awaited from
+// a coroutine running on the connection's loop thread: each first tries
+// the syscall, and only if it would block suspends until the loop reports
+// readiness, resuming on that thread. The awaiters live in the coroutine
+// frame, so an operation allocates nothing. One read and one write may be
+// pending at a time.
+class AsyncConnection {
+public:
+    class ReadAwaiter : private detail::IoOperation {
+    public:
+        bool await_ready() { return !state_ || perform(); }
+        bool await_suspend(std::coroutine_handle<> handle) {
+            this->handle = handle;
+            if (state_->wait(*this, EventLoop::Readable)) {
+                return true;
+            }
+            result_.error = ErrorCode::ReceiveFailed;
+            return false;
+        }
+        IoResult await_resume() { return result_; }
+
+    private:
+        friend class AsyncConnection;
+
+        detail::IoState* state_;
+        uint8_t* data_;
+        size_t length_;
+        Buffer* buffer_;
+        IoResult result_;
+
+        ReadAwaiter(detail::IoState* state, uint8_t* data, size_t length, Buffer* buffer);
+        bool perform() override;
+    };
+
+    class WriteAwaiter : private detail::IoOperation {
+    public:
+        bool await_ready() { return !state_ || perform(); }
+        bool await_suspend(std::coroutine_handle<> handle) {
+            this->handle = handle;
+            if (state_->wait(*this, EventLoop::Writable)) {
+                return true;
+            }
+            result_.error = ErrorCode::SendFailed;
+            return false;
+        }
+        IoResult await_resume() { return result_; }
+
+    private:
+        friend class AsyncConnection;
+
+        detail::IoState* state_;
+        ByteView data_;
+        IoResult result_;
+
+        WriteAwaiter(detail::IoState* state, const ByteView& data);
+        bool perform() override;
+    };
+
+    AsyncConnection() = default; // Not open
+    AsyncConnection(EventLoop& loop, socket_t socket, const SocketAddress& peer); // Takes a connected socket
+    AsyncConnection(AsyncConnection&& other) noexcept = default;
+    AsyncConnection& operator=(AsyncConnection&& other) noexcept = default;
+    ~AsyncConnection() = default; // Closes
+
+    bool isOpen() const { return state_ && state_->isOpen(); }
+    void close();
+    socket_t getSocket() const { return state_ ? state_->getSocket() : INVALID_SOCKET; }
+    const SocketAddress& getPeerAddress() const { return peer_; }
+    EventLoop* getEventLoop() const { return state_ ? &state_->getLoop() : nullptr; }
+    ErrorCode getError() const { return error_; } // Why a connect or accept gave no connection
+
+    // Whatever is available, up to length (or the buffer's capacity, which
+    // then gets the size read)
+    ReadAwaiter read(void* data, size_t length) {
+        return ReadAwaiter(state_.get(), static_cast<uint8_t*>(data), length, nullptr);
+    }
+    ReadAwaiter read(Buffer& buffer) { return ReadAwaiter(state_.get(), buffer.data(), buffer.capacity(), &buffer); }
+    // All of data, which must outlive the await
+    WriteAwaiter write(const ByteView& data) { return WriteAwaiter(state_.get(), data); }
+
+private:
+    friend class AsyncClient;
+    friend class AsyncServer;
+
+    std::unique_ptr<detail::IoState> state_;
+    SocketAddress peer_;
+    ErrorCode error_ = ErrorCode::InvalidSocket;
+
+    static AsyncConnection failed(ErrorCode error);
+};
+
+// Outbound connects for coroutines, through the Connector (cached
+// resolution, Happy Eyeballs)
+class AsyncClient {
+public:
+    class ConnectAwaiter {
+    public:
+        bool await_ready() { return false; }
+        bool await_suspend(std::coroutine_handle<> handle);
+        AsyncConnection await_resume();
+
+    private:
+        friend class AsyncClient;
+
+        EventLoop& loop_;
+        std::string host_;
+        uint16_t port_;
+        std::chrono::milliseconds timeout_;
+        std::coroutine_handle<> handle_;
+        Connector::Result result_;
+        bool done_;
+        bool suspended_;
+
+        ConnectAwaiter(EventLoop& loop, std::string host, uint16_t port, std::chrono::milliseconds timeout);
+    };
+
+    explicit AsyncClient(EventLoop& loop) : loop_(loop) {}
+
+    // The connection is not open on failure; getError() says why. A
+    // timeout of 0 means none.
+    ConnectAwaiter connect(const std::string& host, uint16_t port,
+                           std::chrono::milliseconds timeout = std::chrono::milliseconds(0)) {
+        return ConnectAwaiter(loop_, host, port, timeout);
+    }
+
+    EventLoop& getEventLoop() const { return loop_; }
+
+private:
+    EventLoop& loop_;
+};
+
+// Listening socket for coroutines
+class AsyncServer {
+public:
+    class AcceptAwaiter : private detail::IoOperation {
+    public:
+        bool await_ready() { return !state_ || perform(); }
+        bool await_suspend(std::coroutine_handle<> handle) {
+            this->handle = handle;
+            if (state_->wait(*this, EventLoop::Readable)) {
+                return true;
+            }
+            error_ = ErrorCode::AcceptFailed;
+            return false;
+        }
+        AsyncConnection await_resume();
+
+    private:
+        friend class AsyncServer;
+
+        detail::IoState* state_;
+        socket_t socket_;
+        SocketAddress peer_;
+        ErrorCode error_;
+
+        explicit AcceptAwaiter(detail::IoState* state);
+        bool perform() override;
+    };
+
+    explicit AsyncServer(EventLoop& loop);
+    ~AsyncServer();
+
+    // Non-copyable
+    AsyncServer(const AsyncServer&) = delete;
+    AsyncServer& operator=(const AsyncServer&) = delete;
+
+    // Numeric address ("" for all IPv4 interfaces, "::" for IPv6); port 0 picks one
+    bool listen(const std::string& address, uint16_t port, int backlog = 128);
+    void close(); // A pending accept completes with a closed connection
+    bool isListening() const { return state_ && state_->isOpen(); }
+    uint16_t getLocalPort() const { return localPort_; }
+
+    // The connection is not open on failure; getError() says why
+    AcceptAwaiter accept() { return AcceptAwaiter(state_.get()); }
+
+private:
+    EventLoop& loop_;
+    std::unique_ptr<detail::IoState> state_;
+    uint16_t localPort_;
+};
+
+} // namespace tcp
+
+#endif // TCP_COROUTINES
@@ -0,0 +1,1593 @@
+#include "event_loop.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#define TCP_EVENT_LOOP_EPOLL 1
+#if defined(TCP_IO_URING)
+#include "io_ring.h"
+#include <poll.h>
+#include <unordered_set>
+#define TCP_EVENT_LOOP_IO_URING 1
+#endif
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__)
+#include <sys/event.h>
+#include <sys/time.h>
+#define TCP_EVENT_LOOP_KQUEUE 1
+#elif !defined(_WIN32)
+#include <poll.h>
+#endif
+
+namespace tcp {
+
+namespace {
+
+constexpr int kMaxEventsPerWait = 256;
+
+void closeSocketHandle(socket_t socket) {
+#ifdef _WIN32
+    closesocket(socket);
+#else
+    ::close(socket);
+#endif
+}
+
+// Hard affinity for the calling thread; macOS only takes hints, so it
+// stays unpinned there
+bool pinCurrentThread(int cpu) {
+#if defined(__linux__)
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#elif defined(_WIN32)
+    return cpu >= 0 && cpu < 64 && SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) != 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+int currentCpu() {
+#if defined(__linux__)
+    return sched_getcpu();
+#elif defined(_WIN32)
+    return static_cast<int>(GetCurrentProcessorNumber());
+#else
+    return -1;
+#endif
+}
+
+uint64_t elapsedNanos(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+    return static_cast<uint64_t>(std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count()));
+}
+
+} // namespace
+
+// Poller backends
+class EventLoop::Poller {
+public:
+    struct ReadyEvent {
+        socket_t socket;
+        uint32_t events;
+    };
+
+    virtual ~Poller() = default;
+    virtual bool isValid() const = 0;
+    virtual bool add(socket_t socket, uint32_t events) = 0;
+    virtual bool modify(socket_t socket, uint32_t events) = 0;
+    virtual void remove(socket_t socket) = 0;
+    virtual int wait(std::vector<ReadyEvent>& ready, int timeoutMs) = 0; // Events and completions; 0 on timeout
+    virtual Backend backend() const = 0;
+    virtual uint64_t getSyscallCount() const { return syscalls_.load(std::memory_order_relaxed); }
+    // Changes made off the loop thread only take effect on its next turn
+    virtual bool deferredChanges() const { return false; }
+
+    // Completion operations, for backends that have them. Completions
+    // reaped by wait() run their handlers in dispatchCompletions();
+    // discardOperations() drops whatever is still pending when the loop
+    // stops, without running the handlers.
+    virtual bool accept(socket_t, AcceptHandler&) { return false; }
+    virtual bool receive(socket_t, ReceiveHandler&) { return false; }
+    virtual bool send(socket_t, const ByteView*, size_t, SendHandler&) { return false; }
+    virtual bool hasCompletionIo() const { return false; }
+    virtual void dispatchCompletions() {}
+    virtual void discardOperations() {}
+
+protected:
+    std::atomic<uint64_t> syscalls_{0};
+
+    void countSyscall() { syscalls_.fetch_add(1, std::memory_order_relaxed); }
+};
+
+#if defined(TCP_EVENT_LOOP_EPOLL)
+
+class EpollPoller : public EventLoop::Poller {
+public:
+    EpollPoller() : epollFd_(epoll_create1(EPOLL_CLOEXEC)), events_(kMaxEventsPerWait) {}
+
+    ~EpollPoller() override {
+        if (epollFd_ >= 0) {
+            ::close(epollFd_);
+        }
+    }
+
+    bool isValid() const override { return epollFd_ >= 0; }
+
+    bool add(socket_t socket, uint32_t events) override {
+        return control(EPOLL_CTL_ADD, socket, events);
+    }
+
+    bool modify(socket_t socket, uint32_t events) override {
+        return control(EPOLL_CTL_MOD, socket, events);
+    }
+
+    void remove(socket_t socket) override {
+        countSyscall();
+        epoll_ctl(epollFd_, EPOLL_CTL_DEL, socket, nullptr);
+    }
+
+    int wait(std::vector<ReadyEvent>& ready, int timeoutMs) override {
+        countSyscall();
+        int count = epoll_wait(epollFd_, events_.data(), static_cast<int>(events_.size()), timeoutMs);
+        if (count <= 0) {
+            return count;
+        }
+
+        for (int i = 0; i < count; i++) {
+            uint32_t flags = events_[i].events;
+            uint32_t events = 0;
+            if (flags & EPOLLIN) events |= EventLoop::Readable;
+            if (flags & EPOLLOUT) events |= EventLoop::Writable;
+            if (flags & EPOLLERR) events |= EventLoop::Error;
+            if (flags & (EPOLLHUP | EPOLLRDHUP)) events |= EventLoop::Hangup;
+            ready.push_back({events_[i].data.fd, events});
+        }
+        return count;
+    }
+
+    EventLoop::Backend backend() const override { return EventLoop::Backend::Epoll; }
+
+private:
+    int epollFd_;
+    std::vector<struct epoll_event> events_;
+
+    bool control(int operation, socket_t socket, uint32_t events) {
+        struct epoll_event event;
+        std::memset(&event, 0, sizeof(event));
+        event.data.fd = socket;
+        if (events & EventLoop::Readable) event.events |= EPOLLIN | EPOLLRDHUP;
+        if (events & EventLoop::Writable) event.events |= EPOLLOUT;
+        countSyscall();
+        return epoll_ctl(epollFd_, operation, socket, &event) == 0;
+    }
+};
+
+#elif defined(TCP_EVENT_LOOP_KQUEUE)
+
+class KqueuePoller : public EventLoop::Poller {
+public:
+    KqueuePoller() : kqueueFd_(kqueue()), events_(kMaxEventsPerWait) {}
+
+    ~KqueuePoller() override {
+        if (kqueueFd_ >= 0) {
+            ::close(kqueueFd_);
+        }
+    }
+
+    bool isValid() const override { return kqueueFd_ >= 0; }
+
+    bool add(socket_t socket, uint32_t events) override {
+        return apply(socket, 0, events);
+    }
+
+    bool modify(socket_t socket, uint32_t events) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = interest_.find(socket);
+        uint32_t current = it != interest_.end() ? it->second : 0;
+        return applyLocked(socket, current, events);
+    }
+
+    void remove(socket_t socket) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = interest_.find(socket);
+        if (it != interest_.end()) {
+            applyLocked(socket, it->second, 0);
+            interest_.erase(socket);
+        }
+    }
+
+    int wait(std::vector<ReadyEvent>& ready, int timeoutMs) override {
+        struct timespec timeout;
+        struct timespec* timeoutPtr = nullptr;
+        if (timeoutMs >= 0) {
+            timeout.tv_sec = timeoutMs / 1000;
+            timeout.tv_nsec = (timeoutMs % 1000) * 1000000L;
+            timeoutPtr = &timeout;
+        }
+
+        countSyscall();
+        int count = kevent(kqueueFd_, nullptr, 0, events_.data(), static_cast<int>(events_.size()), timeoutPtr);
+        if (count <= 0) {
+            return count;
+        }
+
+        for (int i = 0; i < count; i++) {
+            uint32_t events = 0;
+            if (events_[i].filter == EVFILT_READ) events |= EventLoop::Readable;
+            if (events_[i].filter == EVFILT_WRITE) events |= EventLoop::Writable;
+            if (events_[i].flags & EV_ERROR) events |= EventLoop::Error;
+            if (events_[i].flags & EV_EOF) events |= EventLoop::Hangup;
+            ready.push_back({static_cast<socket_t>(events_[i].ident), events});
+        }
+        return count;
+    }
+
+    EventLoop::Backend backend() const override { return EventLoop::Backend::Kqueue; }
+
+private:
+    int kqueueFd_;
+    std::vector<struct kevent> events_;
+    std::unordered_map<socket_t, uint32_t> interest_;
+    std::mutex mutex_;
+
+    bool apply(socket_t socket, uint32_t current, uint32_t events) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return applyLocked(socket, current, events);
+    }
+
+    bool applyLocked(socket_t socket, uint32_t current, uint32_t events) {
+        struct kevent changes[2];
+        int changeCount = 0;
+
+        if ((events & EventLoop::Readable) != (current & EventLoop::Readable)) {
+            EV_SET(&changes[changeCount++], socket, EVFILT_READ,
+                   (events & EventLoop::Readable) ? EV_ADD : EV_DELETE, 0, 0, nullptr);
+        }
+        if ((events & EventLoop::Writable) != (current & EventLoop::Writable)) {
+            EV_SET(&changes[changeCount++], socket, EVFILT_WRITE,
+                   (events & EventLoop::Writable) ? EV_ADD : EV_DELETE, 0, 0, nullptr);
+        }
+
+        if (changeCount > 0) {
+            countSyscall();
+            if (kevent(kqueueFd_, changes, changeCount, nullptr, 0, nullptr) == -1) {
+                return false;
+            }
+        }
+
+        interest_[socket] = events;
+        return true;
+    }
+};
+
+#else
+
+// Portable fallback. On Windows this is WSAPoll; completion-based IOCP does
+// not fit the readiness model the rest of the library is built on.
+class PollPoller : public EventLoop::Poller {
+public:
+    bool isValid() const override { return true; }
+
+    bool add(socket_t socket, uint32_t events) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (indices_.count(socket) > 0) {
+            return false;
+        }
+        indices_[socket] = descriptors_.size();
+        descriptors_.push_back(makeDescriptor(socket, events));
+        return true;
+    }
+
+    bool modify(socket_t socket, uint32_t events) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = indices_.find(socket);
+        if (it == indices_.end()) {
+            return false;
+        }
+        descriptors_[it->second] = makeDescriptor(socket, events);
+        return true;
+    }
+
+    void remove(socket_t socket) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = indices_.find(socket);
+        if (it == indices_.end()) {
+            return;
+        }
+
+        size_t index = it->second;
+        size_t last = descriptors_.size() - 1;
+        if (index != last) {
+            descriptors_[index] = descriptors_[last];
+            indices_[descriptors_[index].fd] = index;
+        }
+        descriptors_.pop_back();
+        indices_.erase(it);
+    }
+
+    int wait(std::vector<ReadyEvent>& ready, int timeoutMs) override {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            snapshot_ = descriptors_;
+        }
+
+        countSyscall();
+#ifdef _WIN32
+        int count = WSAPoll(snapshot_.data(), static_cast<ULONG>(snapshot_.size()), timeoutMs);
+#else
+        int count = ::poll(snapshot_.data(), static_cast<nfds_t>(snapshot_.size()), timeoutMs);
+#endif
+        if (count <= 0) {
+            return count;
+        }
+
+        for (const auto& descriptor : snapshot_) {
+            if (descriptor.revents == 0) {
+                continue;
+            }
+
+            uint32_t events = 0;
+            if (descriptor.revents & POLLIN) events |= EventLoop::Readable;
+            if (descriptor.revents & POLLOUT) events |= EventLoop::Writable;
+            if (descriptor.revents & (POLLERR | POLLNVAL)) events |= EventLoop::Error;
+            if (descriptor.revents & POLLHUP) events |= EventLoop::Hangup;
+            ready.push_back({descriptor.fd, events});
+        }
+        return count;
+    }
+
+    EventLoop::Backend backend() const override { return EventLoop::Backend::Poll; }
+    bool deferredChanges() const override { return true; }
+
+private:
+    std::vector<pollfd> descriptors_;
+    std::vector<pollfd> snapshot_;
+    std::unordered_map<socket_t, size_t> indices_;
+    std::mutex mutex_;
+
+    static pollfd makeDescriptor(socket_t socket, uint32_t events) {
+        pollfd descriptor;
+        descriptor.fd = socket;
+        descriptor.events = 0;
+        descriptor.revents = 0;
+        if (events & EventLoop::Readable) descriptor.events |= POLLIN;
+        if (events & EventLoop::Writable) descriptor.events |= POLLOUT;
+        return descriptor;
+    }
+};
+
+#endif
+
+#if defined(TCP_EVENT_LOOP_IO_URING)
+
+namespace {
+
+constexpr unsigned kFixedFiles = 4096;       // Later sockets use their plain descriptors
+constexpr uint16_t kBufferGroup = 0;
+constexpr unsigned kReceiveBuffers = 128;    // Shared by the loop's multishot receives
+constexpr size_t kReceiveBufferSize = 16384;
+constexpr int kMaxDiscardTurns = 100;        // Waits for cancelled operations to report
+constexpr int kDiscardWaitMs = 10;
+
+uint32_t toPollMask(uint32_t events) {
+    uint32_t mask = 0;
+    if (events & EventLoop::Readable) mask |= POLLIN | POLLRDHUP;
+    if (events & EventLoop::Writable) mask |= POLLOUT;
+    return mask;
+}
+
+uint32_t fromPollMask(uint32_t mask) {
+    uint32_t events = 0;
+    if (mask & POLLIN) events |= EventLoop::Readable;
+    if (mask & POLLOUT) events |= EventLoop::Writable;
+    if (mask & (POLLERR | POLLNVAL)) events |= EventLoop::Error;
+    if (mask & (POLLHUP | POLLRDHUP)) events |= EventLoop::Hangup;
+    return events;
+}
+
+} // namespace
+
+// Readiness is a one-shot poll request re-armed as it is reaped, which
+// keeps the level-triggered behaviour of the other backends; the re-arms,
+// and everything queued meanwhile (from any thread), reach the kernel with
+// the next wait. Sockets live in the registered file table, and receives pick
+// blocks from a buffer group owned by the loop.
+//
+// Removal cancels synchronously, so a closed descriptor number can never
+// be matched to requests of the socket that owned it. Until their final
+// completions are reaped, operations and registrations stay allocated.
+class IoUringPoller : public EventLoop::Poller {
+public:
+    IoUringPoller(const EventLoop::Options& options, BufferPool& pool)
+        : pool_(pool), bufferRing_(nullptr), bufferTail_(0), ringDelivered_(false) {
+        IoRing::Config config;
+        config.entries = options.ringEntries;
+        config.sqPoll = options.sqPoll;
+        config.sqPollIdleMs = options.sqPollIdleMs;
+
+        // Multishot receive and synchronous cancel arrived in 6.0, with zero-copy send
+        if (!ring_.open(config) || !ring_.supports(IORING_OP_SEND_ZC)) {
+            ring_.close();
+            return;
+        }
+
+        if (ring_.registerFiles(kFixedFiles)) {
+            for (unsigned slot = kFixedFiles; slot > 0; slot--) {
+                freeSlots_.push_back(static_cast<int>(slot - 1));
+            }
+        }
+
+        buffers_.resize(kReceiveBuffers);
+        inKernel_.assign(kReceiveBuffers, false);
+        bufferRing_ = ring_.registerBufferRing(kBufferGroup, kReceiveBuffers);
+        for (unsigned id = 0; id < kReceiveBuffers; id++) {
+            buffers_[id] = pool_.acquire(kReceiveBufferSize);
+            provideBuffer(static_cast<uint16_t>(id));
+        }
+    }
+
+    ~IoUringPoller() override {
+        // Closing the ring first releases the kernel's hold on the buffers
+        ring_.close();
+        for (Operation* operation : operations_) {
+            delete operation;
+        }
+    }
+
+    bool isValid() const override { return ring_.isOpen(); }
+
+    bool add(socket_t socket, uint32_t events) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Registration* registration = registrationFor(socket);
+        registration->events = events;
+        if (events != 0 && !registration->pollArmed && !armPoll(registration)) {
+            return false;
+        }
+        return true;
+    }
+
+    bool modify(socket_t socket, uint32_t events) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = registrations_.find(socket);
+        if (it == registrations_.end()) {
+            return false;
+        }
+
+        Registration* registration = it->second.get();
+        uint32_t previous = registration->events;
+        registration->events = events;
+        if (!registration->pollArmed) {
+            if (events != 0 && !armPoll(registration)) {
+                return false;
+            }
+        } else if (toPollMask(events) != toPollMask(previous)) {
+            // Updates the armed request in place; one that already fired
+            // fails quietly, and its completion re-arms with the new mask
+            io_uring_sqe* sqe = getSqe();
+            if (!sqe) {
+                return false;
+            }
+            sqe->opcode = IORING_OP_POLL_REMOVE;
+            sqe->fd = -1;
+            sqe->addr = reinterpret_cast<uint64_t>(&registration->poll);
+            if (events != 0) {
+                sqe->len = IORING_POLL_UPDATE_EVENTS;
+                sqe->poll32_events = toPollMask(events);
+            }
+            sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+        }
+        return true;
+    }
+
+    void remove(socket_t socket) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = registrations_.find(socket);
+        if (it == registrations_.end()) {
+            return;
+        }
+
+        std::unique_ptr<Registration> registration = std::move(it->second);
+        registrations_.erase(it);
+        registration->removed = true;
+        bool fixed = registration->slot >= 0;
+        if (registration->pending > 0) {
+            // Requests still in the queue go first, so the cancel finds them.
+            // Other threads leave them to the loop: they fail on the emptied
+            // slot, which stays reserved until they have reported.
+            if (canSubmit() || !fixed) {
+                ring_.submit();
+                while (ring_.isSqPoll() && ring_.getFreeSqes() < ring_.getEntries()) {
+                    std::this_thread::yield();
+                }
+            }
+            ring_.cancelFile(fixed ? registration->slot : registration->socket, fixed);
+        }
+        if (fixed) {
+            ring_.updateFile(static_cast<unsigned>(registration->slot), -1);
+        }
+        if (registration->pending == 0) {
+            freeSlot(registration.get());
+        } else {
+            Registration* retired = registration.get();
+            retired_[retired] = std::move(registration);
+        }
+    }
+
+    int wait(std::vector<ReadyEvent>& ready, int timeoutMs) override {
+        unsigned pending;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            loopThread_ = std::this_thread::get_id();
+            publishBuffers();
+            pending = ring_.flush();
+        }
+
+        // Outside the lock, so other threads can queue (and submit) meanwhile
+        int result = ring_.wait(pending, timeoutMs);
+        if (result < 0) {
+            return result;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        int count = 0;
+        ring_.reap([&](const io_uring_cqe& cqe) {
+            Operation* operation = reinterpret_cast<Operation*>(static_cast<uintptr_t>(cqe.user_data));
+            if (!operation) {
+                return;
+            }
+            if (operation->kind == Kind::Poll) {
+                if (completePoll(operation->registration, cqe.res, ready)) {
+                    count++;
+                }
+            } else {
+                completions_.push_back({operation, cqe.res, cqe.flags});
+            }
+        });
+        return count + static_cast<int>(completions_.size());
+    }
+
+    EventLoop::Backend backend() const override { return EventLoop::Backend::IoUring; }
+    bool deferredChanges() const override { return true; }
+    uint64_t getSyscallCount() const override { return ring_.getSyscallCount(); }
+
+    bool accept(socket_t listener, EventLoop::AcceptHandler& handler) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::unique_ptr<AcceptOperation> operation(new AcceptOperation());
+        operation->kind = Kind::Accept;
+        operation->registration = registrationFor(listener);
+        if (!armAccept(operation.get())) {
+            return false;
+        }
+        operation->handler = std::move(handler);
+        track(operation.release());
+        return true;
+    }
+
+    bool receive(socket_t socket, EventLoop::ReceiveHandler& handler) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::unique_ptr<ReceiveOperation> operation(new ReceiveOperation());
+        operation->kind = Kind::Receive;
+        operation->registration = registrationFor(socket);
+        if (!armReceive(operation.get())) {
+            return false;
+        }
+        operation->handler = std::move(handler);
+        track(operation.release());
+        return true;
+    }
+
+    bool send(socket_t socket, const ByteView* buffers, size_t count, EventLoop::SendHandler& handler) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (ring_.getFreeSqes() < count && canSubmit()) {
+            ring_.submit();
+        }
+        count = std::min<size_t>(count, ring_.getFreeSqes());
+        if (count == 0) {
+            return false;
+        }
+
+        // Each link waits for all of its bytes, and a failure cancels the
+        // rest. Only the last link reports success; MSG_MORE lets the
+        // stack coalesce the others into full segments.
+        std::unique_ptr<SendChain> chain(new SendChain());
+        chain->kind = Kind::Send;
+        chain->registration = registrationFor(socket);
+        chain->links.resize(count);
+        size_t offset = 0;
+        for (size_t i = 0; i < count; i++) {
+            bool last = i + 1 == count;
+            SendLink& link = chain->links[i];
+            link.kind = Kind::SendLink;
+            link.registration = chain->registration;
+            link.chain = chain.get();
+            link.offset = offset;
+            link.length = static_cast<uint32_t>(buffers[i].size());
+            offset += link.length;
+
+            io_uring_sqe* sqe = ring_.getSqe();
+            prepare(sqe, IORING_OP_SEND, chain->registration);
+            sqe->addr = reinterpret_cast<uint64_t>(buffers[i].data());
+            sqe->len = link.length;
+            sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL | (last ? 0 : MSG_MORE);
+            if (!last) {
+                sqe->flags |= IOSQE_IO_LINK | IOSQE_CQE_SKIP_SUCCESS;
+            }
+            sqe->user_data = reinterpret_cast<uint64_t>(&link);
+        }
+        chain->handler = std::move(handler);
+        track(chain.release());
+        return true;
+    }
+
+    bool hasCompletionIo() const override { return true; }
+
+    void dispatchCompletions() override {
+        // Loop thread only, like wait(); handlers run without the lock
+        for (const Completion& completion : completions_) {
+            switch (completion.operation->kind) {
+            case Kind::Accept:
+                completeAccept(static_cast<AcceptOperation*>(completion.operation), completion);
+                break;
+            case Kind::Receive:
+                completeReceive(static_cast<ReceiveOperation*>(completion.operation), completion);
+                break;
+            case Kind::SendLink:
+                completeSend(static_cast<SendLink*>(completion.operation), completion);
+                break;
+            default:
+                break;
+            }
+        }
+        completions_.clear();
+    }
+
+    void discardOperations() override {
+        // Everything is cancelled, then reaped until each operation has had
+        // its final completion. Readiness polls re-arm as usual.
+        std::vector<std::unique_ptr<Operation>> discarded;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (const Completion& completion : completions_) {
+                settle(completion, discarded);
+            }
+            completions_.clear();
+            if (operations_.empty()) {
+                return;
+            }
+
+            ring_.submit();
+            ring_.cancelAll();
+            std::vector<ReadyEvent> ignored;
+            for (int turn = 0; turn < kMaxDiscardTurns && !operations_.empty(); turn++) {
+                ring_.wait(ring_.flush(), kDiscardWaitMs);
+                ring_.reap([&](const io_uring_cqe& cqe) {
+                    Operation* operation = reinterpret_cast<Operation*>(static_cast<uintptr_t>(cqe.user_data));
+                    if (!operation) {
+                        return;
+                    }
+                    if (operation->kind == Kind::Poll) {
+                        completePoll(operation->registration, cqe.res, ignored);
+                    } else {
+                        settle({operation, cqe.res, cqe.flags}, discarded);
+                    }
+                });
+                ignored.clear();
+            }
+            publishBuffers();
+        }
+        // Handlers may own connections that remove themselves on destruction
+        discarded.clear();
+    }
+
+private:
+    enum class Kind : uint8_t {
+        Poll,
+        Accept,
+        Receive,
+        Send,
+        SendLink
+    };
+
+    struct Registration;
+
+    // Requests carry a pointer to their operation as user data
+    struct Operation {
+        Kind kind = Kind::Poll;
+        Registration* registration = nullptr;
+        virtual ~Operation() = default;
+    };
+
+    struct Registration {
+        socket_t socket = INVALID_SOCKET;
+        int slot = -1;            // Registered file, or -1 for the plain descriptor
+        uint32_t events = 0;      // Readiness interest; 0 arms no poll
+        bool pollArmed = false;
+        bool removed = false;
+        unsigned pending = 0;     // Operations whose final completion is still due
+        Operation poll;
+    };
+
+    struct AcceptOperation : Operation {
+        EventLoop::AcceptHandler handler;
+    };
+
+    struct ReceiveOperation : Operation {
+        EventLoop::ReceiveHandler handler;
+    };
+
+    struct SendChain;
+
+    struct SendLink : Operation {
+        SendChain* chain = nullptr;
+        size_t offset = 0;        // Bytes of the links before this one
+        uint32_t length = 0;
+    };
+
+    struct SendChain : Operation {
+        EventLoop::SendHandler handler;
+        std::vector<SendLink> links;
+        size_t written = 0;
+        ErrorCode error = ErrorCode::Success;
+    };
+
+    struct Completion {
+        Operation* operation;
+        int32_t result;
+        uint32_t flags;
+    };
+
+    IoRing ring_;
+    std::mutex mutex_; // Submission queue, registrations and operations
+    std::thread::id loopThread_;
+
+    std::unordered_map<socket_t, std::unique_ptr<Registration>> registrations_;
+    std::unordered_map<Registration*, std::unique_ptr<Registration>> retired_; // Removed, completions due
+    std::vector<int> freeSlots_;
+    std::unordered_set<Operation*> operations_; // Owned
+    std::vector<Completion> completions_;       // Loop thread only
+
+    // Receive buffers: ring-mapped when the kernel takes them that way,
+    // otherwise provided back one request at a time
+    BufferPool& pool_;
+    std::vector<Buffer> buffers_;
+    std::vector<bool> inKernel_;
+    io_uring_buf_ring* bufferRing_;
+    uint16_t bufferTail_;
+    bool ringDelivered_;
+
+    Registration* registrationFor(socket_t socket) {
+        std::unique_ptr<Registration>& registration = registrations_[socket];
+        if (!registration) {
+            registration.reset(new Registration());
+            registration->socket = socket;
+            registration->poll.registration = registration.get();
+            if (!freeSlots_.empty() && ring_.updateFile(static_cast<unsigned>(freeSlots_.back()), socket)) {
+                registration->slot = freeSlots_.back();
+                freeSlots_.pop_back();
+            }
+        }
+        return registration.get();
+    }
+
+    io_uring_sqe* getSqe() {
+        io_uring_sqe* sqe = ring_.getSqe();
+        if (!sqe && canSubmit()) {
+            ring_.submit();
+            sqe = ring_.getSqe();
+        }
+        return sqe;
+    }
+
+    static void prepare(io_uring_sqe* sqe, uint8_t opcode, const Registration* registration) {
+        sqe->opcode = opcode;
+        if (registration->slot >= 0) {
+            sqe->fd = registration->slot;
+            sqe->flags = IOSQE_FIXED_FILE;
+        } else {
+            sqe->fd = registration->socket;
+        }
+    }
+
+    // Requests complete through the task that submitted them, so only the
+    // loop thread enters the ring; other threads' requests wait for its
+    // next turn. A kernel polling thread takes them from anyone.
+    bool canSubmit() const {
+        return ring_.isSqPoll() || std::this_thread::get_id() == loopThread_;
+    }
+
+    void track(Operation* operation) {
+        operations_.insert(operation);
+        operation->registration->pending++;
+    }
+
+    std::unique_ptr<Operation> finish(Operation* operation) {
+        operations_.erase(operation);
+        release(operation->registration);
+        return std::unique_ptr<Operation>(operation);
+    }
+
+    void release(Registration* registration) {
+        if (--registration->pending == 0 && registration->removed) {
+            freeSlot(registration);
+            retired_.erase(registration);
+        }
+    }
+
+    void freeSlot(Registration* registration) {
+        if (registration->slot >= 0) {
+            freeSlots_.push_back(registration->slot);
+            registration->slot = -1;
+        }
+    }
+
+    bool armPoll(Registration* registration) {
+        io_uring_sqe* sqe = getSqe();
+        if (!sqe) {
+            return false;
+        }
+        prepare(sqe, IORING_OP_POLL_ADD, registration);
+        sqe->poll32_events = toPollMask(registration->events);
+        sqe->user_data = reinterpret_cast<uint64_t>(&registration->poll);
+        registration->pollArmed = true;
+        registration->pending++;
+        return true;
+    }
+
+    bool armAccept(AcceptOperation* operation) {
+        io_uring_sqe* sqe = getSqe();
+        if (!sqe) {
+            return false;
+        }
+        prepare(sqe, IORING_OP_ACCEPT, operation->registration);
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+        sqe->user_data = reinterpret_cast<uint64_t>(operation);
+        return true;
+    }
+
+    bool armReceive(ReceiveOperation* operation) {
+        io_uring_sqe* sqe = getSqe();
+        if (!sqe) {
+            return false;
+        }
+        prepare(sqe, IORING_OP_RECV, operation->registration);
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags |= IOSQE_BUFFER_SELECT;
+        sqe->buf_group = kBufferGroup;
+        sqe->user_data = reinterpret_cast<uint64_t>(operation);
+        return true;
+    }
+
+    bool completePoll(Registration* registration, int32_t result, std::vector<ReadyEvent>& ready) {
+        registration->pollArmed = false;
+        if (registration->removed) {
+            release(registration);
+            return false;
+        }
+        registration->pending--;
+
+        // Cancelled by modify(); the interest may have come back since
+        if (result == -ECANCELED) {
+            if (registration->events != 0) {
+                armPoll(registration);
+            }
+            return false;
+        }
+
+        uint32_t events = result < 0 ? EventLoop::Error : fromPollMask(static_cast<uint32_t>(result));
+        events &= registration->events | EventLoop::Error | EventLoop::Hangup;
+        if (result >= 0 && registration->events != 0) {
+            armPoll(registration);
+        }
+        if (events == 0) {
+            return false;
+        }
+        ready.push_back({registration->socket, events});
+        return true;
+    }
+
+    void completeAccept(AcceptOperation* operation, const Completion& completion) {
+        std::unique_ptr<Operation> finished; // Destroyed after the lock is released
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (completion.result >= 0) {
+            if (operation->registration->removed) {
+                closeSocketHandle(completion.result);
+            } else {
+                lock.unlock();
+                operation->handler(completion.result);
+                lock.lock();
+            }
+        }
+
+        if (!(completion.flags & IORING_CQE_F_MORE)) {
+            if (operation->registration->removed || completion.result == -ECANCELED || !armAccept(operation)) {
+                finished = finish(operation);
+            }
+        }
+    }
+
+    void completeReceive(ReceiveOperation* operation, const Completion& completion) {
+        std::unique_ptr<Operation> finished;
+        std::unique_lock<std::mutex> lock(mutex_);
+        int32_t result = completion.result;
+        int id = -1;
+        if (completion.flags & IORING_CQE_F_BUFFER) {
+            id = static_cast<int>(completion.flags >> IORING_CQE_BUFFER_SHIFT);
+            inKernel_[id] = false;
+            ringDelivered_ = ringDelivered_ || bufferRing_ != nullptr;
+        }
+
+        if (!operation->registration->removed) {
+            if (result > 0 && id >= 0) {
+                buffers_[id].setSize(static_cast<size_t>(result));
+                BufferView data(buffers_[id], 0, static_cast<size_t>(result));
+                lock.unlock();
+                operation->handler(data, ErrorCode::Success);
+                lock.lock();
+            } else if (result == 0 || (result < 0 && result != -ENOBUFS && result != -ECANCELED)) {
+                lock.unlock();
+                operation->handler(BufferView(), result == 0 ? ErrorCode::ConnectionClosed : ErrorCode::ReceiveFailed);
+                lock.lock();
+            }
+        }
+
+        if (id >= 0) {
+            recycleBuffer(static_cast<uint16_t>(id));
+        }
+        if (result == -ENOBUFS && bufferRing_ && !ringDelivered_) {
+            // Buffers were published but none was ever taken: some kernels
+            // accept a mapped ring without reading from it
+            switchToProvidedBuffers();
+        }
+
+        if (!(completion.flags & IORING_CQE_F_MORE)) {
+            bool ended = operation->registration->removed || result == 0 || (result < 0 && result != -ENOBUFS);
+            if (ended || !armReceive(operation)) {
+                finished = finish(operation);
+            }
+        }
+    }
+
+    void completeSend(SendLink* link, const Completion& completion) {
+        // A chain reports once: the last link, or the link that cut it (the
+        // kernel skips the cancelled links after one with CQE_SKIP_SUCCESS)
+        std::unique_ptr<Operation> finished;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            SendChain* chain = link->chain;
+            int32_t result = completion.result;
+            // A short write without an error leaves the rest queued
+            chain->written = link->offset + (result > 0 ? static_cast<size_t>(result) : 0);
+            if (result == -ECANCELED) {
+                chain->error = ErrorCode::ConnectionClosed;
+            } else if (result < 0) {
+                chain->error = ErrorCode::SendFailed;
+            }
+            finished = finish(chain);
+        }
+
+        SendChain* chain = static_cast<SendChain*>(finished.get());
+        chain->handler(chain->written, chain->error);
+    }
+
+    // Completion of a discarded operation: resources are reclaimed, the
+    // handler never runs
+    void settle(const Completion& completion, std::vector<std::unique_ptr<Operation>>& discarded) {
+        Operation* operation = completion.operation;
+        bool final = !(completion.flags & IORING_CQE_F_MORE);
+        switch (operation->kind) {
+        case Kind::Accept:
+            if (completion.result >= 0) {
+                closeSocketHandle(completion.result);
+            }
+            break;
+        case Kind::Receive:
+            if (completion.flags & IORING_CQE_F_BUFFER) {
+                uint16_t id = static_cast<uint16_t>(completion.flags >> IORING_CQE_BUFFER_SHIFT);
+                inKernel_[id] = false;
+                recycleBuffer(id);
+            }
+            break;
+        case Kind::SendLink:
+            operation = static_cast<SendLink*>(operation)->chain;
+            final = true;
+            break;
+        default:
+            break;
+        }
+        if (final) {
+            discarded.push_back(finish(operation));
+        }
+    }
+
+    void provideBuffer(uint16_t id) {
+        Buffer& block = buffers_[id];
+        if (bufferRing_) {
+            io_uring_buf& entry = bufferRing_->bufs[bufferTail_ & (kReceiveBuffers - 1)];
+            entry.addr = reinterpret_cast<uint64_t>(block.data());
+            entry.len = static_cast<uint32_t>(block.capacity());
+            entry.bid = id;
+            bufferTail_++;
+        } else {
+            io_uring_sqe* sqe = getSqe();
+            if (!sqe) {
+                return;
+            }
+            sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+            sqe->fd = 1;
+            sqe->addr = reinterpret_cast<uint64_t>(block.data());
+            sqe->len = static_cast<uint32_t>(block.capacity());
+            sqe->buf_group = kBufferGroup;
+            sqe->off = id;
+            sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+        }
+        inKernel_[id] = true;
+    }
+
+    void recycleBuffer(uint16_t id) {
+        // A handler that kept a view keeps the block; the group gets another
+        if (!buffers_[id].unique()) {
+            buffers_[id] = pool_.acquire(kReceiveBufferSize);
+        }
+        provideBuffer(id);
+    }
+
+    void publishBuffers() {
+        if (bufferRing_) {
+            __atomic_store_n(&bufferRing_->tail, bufferTail_, __ATOMIC_RELEASE);
+        }
+    }
+
+    void switchToProvidedBuffers() {
+        ring_.unregisterBufferRing(kBufferGroup);
+        bufferRing_ = nullptr;
+        for (unsigned id = 0; id < kReceiveBuffers; id++) {
+            if (inKernel_[id]) {
+                provideBuffer(static_cast<uint16_t>(id));
+            }
+        }
+    }
+};
+
+#endif
+
+// EventLoop implementation
+EventLoop::EventLoop() : EventLoop(Options()) {}
+
+EventLoop::EventLoop(const Options& options)
+    : bufferPool_(options.localBufferBytes > 0 ? new BufferPool() : nullptr),
+      running_(false), shouldStop_(false), threadId_(std::thread::id()), callingPendingTasks_(false),
+      wakeupRead_(INVALID_SOCKET), wakeupWrite_(INVALID_SOCKET), wakeupPending_(false),
+      cpu_(options.cpu), busyPoll_(options.busyPollUs), localBufferBytes_(options.localBufferBytes),
+      lastCpu_(-1), busyNanos_(0), idleNanos_(0), waitingSince_(0) {
+#if defined(TCP_EVENT_LOOP_IO_URING)
+    if (options.ioUring) {
+        std::unique_ptr<Poller> ring(new IoUringPoller(options, getBufferPool()));
+        if (ring->isValid()) {
+            poller_ = std::move(ring);
+        }
+    }
+    if (!poller_) {
+        poller_.reset(new EpollPoller());
+    }
+#elif defined(TCP_EVENT_LOOP_EPOLL)
+    (void)options;
+    poller_.reset(new EpollPoller());
+#elif defined(TCP_EVENT_LOOP_KQUEUE)
+    (void)options;
+    poller_.reset(new KqueuePoller());
+#else
+    (void)options;
+    poller_.reset(new PollPoller());
+#endif
+
+    if (poller_->isValid() && createWakeup()) {
+        poller_->add(wakeupRead_, Readable);
+    }
+}
+
+EventLoop::~EventLoop() {
+    stop();
+    // A loop that never ran; the poller must outlive the handlers' removals
+    poller_->discardOperations();
+    closeWakeup();
+}
+
+bool EventLoop::start() {
+    if (running_ || !poller_->isValid() || wakeupRead_ == INVALID_SOCKET) {
+        return false;
+    }
+
+    shouldStop_ = false;
+    running_ = true;
+    thread_ = std::thread(&EventLoop::run, this);
+    return true;
+}
+
+void EventLoop::run() {
+    threadId_ = std::this_thread::get_id();
+    running_ = true;
+
+    // Pinned first, so the local pool is touched from the loop's own node
+    if (cpu_ >= 0 && !pinCurrentThread(cpu_)) {
+        cpu_ = -1;
+    }
+    bool pinned = cpu_ >= 0;
+    lastCpu_ = pinned ? cpu_.load() : currentCpu();
+    if (bufferPool_) {
+        bufferPool_->reserve(localBufferBytes_);
+    }
+
+    std::vector<Poller::ReadyEvent> ready;
+    ready.reserve(kMaxEventsPerWait);
+    wakeTime_ = std::chrono::steady_clock::now();
+
+    while (!shouldStop_) {
+        ready.clear();
+        auto waitStart = std::chrono::steady_clock::now();
+        busyNanos_.fetch_add(elapsedNanos(wakeTime_, waitStart), std::memory_order_relaxed);
+        waitingSince_.store(waitStart.time_since_epoch().count(), std::memory_order_relaxed);
+
+        // Busy poll: spin on non-blocking polls before sleeping, trading a
+        // core for the wakeup latency
+        int count = 0;
+        int timeout = nextTimeout();
+        if (busyPoll_.count() > 0 && timeout != 0) {
+            auto spinUntil = waitStart + busyPoll_;
+            do {
+                count = poller_->wait(ready, 0);
+            } while (count == 0 && !shouldStop_ && std::chrono::steady_clock::now() < spinUntil);
+            timeout = count == 0 ? nextTimeout() : 0;
+        }
+        if (count == 0 && !shouldStop_) {
+            poller_->wait(ready, timeout);
+        }
+        wakeTime_ = std::chrono::steady_clock::now();
+        waitingSince_.store(0, std::memory_order_relaxed);
+        idleNanos_.fetch_add(elapsedNanos(waitStart, wakeTime_), std::memory_order_relaxed);
+        if (!pinned) {
+            lastCpu_.store(currentCpu(), std::memory_order_relaxed);
+        }
+
+        for (const auto& event : ready) {
+            if (event.socket == wakeupRead_) {
+                drainWakeup();
+            } else {
+                dispatchEvent(event.socket, event.events);
+            }
+        }
+        poller_->dispatchCompletions();
+
+        // Before tasks, so tasks posted by timers run in this iteration
+        runTimers();
+        runPendingTasks();
+    }
+
+    // Run whatever was posted while stopping (e.g. connection closes).
+    // Completion operations still pending are dropped with their handlers,
+    // which may be what keeps connections (and through them this loop) alive.
+    runPendingTasks();
+    poller_->discardOperations();
+
+    threadId_ = std::thread::id();
+    running_ = false;
+}
+
+void EventLoop::stop() {
+    shouldStop_ = true;
+    wakeup();
+
+    if (thread_.joinable()) {
+        if (thread_.get_id() == std::this_thread::get_id()) {
+            thread_.detach();
+        } else {
+            thread_.join();
+        }
+    }
+}
+
+bool EventLoop::isInLoopThread() const {
+    return threadId_.load() == std::this_thread::get_id();
+}
+
+bool EventLoop::add(socket_t socket, uint32_t events, IoHandler handler) {
+    {
+        std::lock_guard<std::mutex> lock(handlersMutex_);
+        if (handlers_.count(socket) > 0) {
+            return false;
+        }
+        handlers_[socket] = std::make_shared<IoHandler>(std::move(handler));
+    }
+
+    if (!poller_->add(socket, events)) {
+        std::lock_guard<std::mutex> lock(handlersMutex_);
+        handlers_.erase(socket);
+        return false;
+    }
+
+    if (poller_->deferredChanges() && !isInLoopThread()) {
+        wakeup();
+    }
+    return true;
+}
+
+bool EventLoop::modify(socket_t socket, uint32_t events) {
+    bool result = poller_->modify(socket, events);
+    if (result && poller_->deferredChanges() && !isInLoopThread()) {
+        wakeup();
+    }
+    return result;
+}
+
+void EventLoop::remove(socket_t socket) {
+    poller_->remove(socket);
+
+    std::lock_guard<std::mutex> lock(handlersMutex_);
+    handlers_.erase(socket);
+}
+
+bool EventLoop::acceptMultishot(socket_t listener, AcceptHandler handler) {
+    return wakeupIfQueued(poller_->accept(listener, handler));
+}
+
+bool EventLoop::receiveMultishot(socket_t socket, ReceiveHandler handler) {
+    return wakeupIfQueued(poller_->receive(socket, handler));
+}
+
+bool EventLoop::sendChain(socket_t socket, const ByteView* buffers, size_t count, SendHandler handler) {
+    return count > 0 && wakeupIfQueued(poller_->send(socket, buffers, count, handler));
+}
+
+bool EventLoop::wakeupIfQueued(bool queued) {
+    // Completion requests are submitted by the loop thread only
+    if (queued && !isInLoopThread()) {
+        wakeup();
+    }
+    return queued;
+}
+
+bool EventLoop::hasCompletionIo() const {
+    return poller_->hasCompletionIo();
+}
+
+void EventLoop::post(Task task) {
+    {
+        std::lock_guard<std::mutex> lock(tasksMutex_);
+        pendingTasks_.push_back(std::move(task));
+    }
+    
+    // From a handler on the loop thread the task runs at the end of this
+    // iteration anyway; tasks posted by tasks need another turn
+    if (!isInLoopThread() || callingPendingTasks_) {
+        wakeup();
+    }
+}
+
+void EventLoop::dispatch(Task task) {
+    if (isInLoopThread()) {
+        task();
+    } else {
+        post(std::move(task));
+    }
+}
+
+TimerId EventLoop::runAfter(std::chrono::milliseconds delay, Task task) {
+    return scheduleTimer(delay, std::chrono::milliseconds(0), std::move(task));
+}
+
+TimerId EventLoop::runEvery(std::chrono::milliseconds interval, Task task) {
+    return scheduleTimer(interval, interval, std::move(task));
+}
+
+bool EventLoop::cancelTimer(TimerId id) {
+    Task task; // Destroyed once the lock is released
+    std::lock_guard<std::mutex> lock(timersMutex_);
+    return timers_.cancel(id, &task);
+}
+
+size_t EventLoop::getTimerCount() const {
+    std::lock_guard<std::mutex> lock(timersMutex_);
+    return timers_.size();
+}
+
+EventLoop& EventLoop::shared() {
+    // Never destroyed: timers may be cancelled from static destructors
+    static EventLoop* loop = []() {
+        EventLoop* created = new EventLoop();
+        created->start();
+        return created;
+    }();
+    return *loop;
+}
+
+TimerId EventLoop::scheduleTimer(std::chrono::milliseconds delay, std::chrono::milliseconds interval, Task task) {
+    TimerId id;
+    {
+        std::lock_guard<std::mutex> lock(timersMutex_);
+        id = timers_.schedule(std::chrono::steady_clock::now() + delay, std::move(task), interval);
+    }
+    
+    // The loop may be waiting with a later timeout
+    if (!isInLoopThread()) {
+        wakeup();
+    }
+    return id;
+}
+
+EventLoop::Backend EventLoop::getBackend() const {
+    return poller_->backend();
+}
+
+size_t EventLoop::getHandlerCount() const {
+    std::lock_guard<std::mutex> lock(handlersMutex_);
+    return handlers_.size();
+}
+
+BufferPool& EventLoop::getBufferPool() {
+    return bufferPool_ ? *bufferPool_ : BufferPool::shared();
+}
+
+EventLoop::Utilization EventLoop::getUtilization() const {
+    Utilization utilization;
+    utilization.cpu = lastCpu_.load(std::memory_order_relaxed);
+    utilization.busyNanos = busyNanos_.load(std::memory_order_relaxed);
+    utilization.idleNanos = idleNanos_.load(std::memory_order_relaxed);
+    
+    // A loop asleep right now has been idle since it started waiting
+    std::chrono::steady_clock::rep since = waitingSince_.load(std::memory_order_relaxed);
+    if (since != 0) {
+        std::chrono::steady_clock::time_point started{std::chrono::steady_clock::duration(since)};
+        utilization.idleNanos += elapsedNanos(started, std::chrono::steady_clock::now());
+    }
+    return utilization;
+}
+
+double EventLoop::Utilization::busyFraction() const {
+    uint64_t total = busyNanos + idleNanos;
+    return total > 0 ? static_cast<double>(busyNanos) / total : 0.0;
+}
+
+double EventLoop::Utilization::busyFraction(const Utilization& earlier) const {
+    uint64_t busy = busyNanos - earlier.busyNanos;
+    uint64_t total = busy + idleNanos - earlier.idleNanos;
+    return total > 0 ? static_cast<double>(busy) / total : 0.0;
+}
+
+uint64_t EventLoop::getSyscallCount() const {
+    return poller_->getSyscallCount();
+}
+
+bool EventLoop::createWakeup() {
+#if defined(TCP_EVENT_LOOP_EPOLL)
+    wakeupRead_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    wakeupWrite_ = wakeupRead_;
+    return wakeupRead_ >= 0;
+#elif defined(_WIN32)
+    // A UDP socket connected to itself serves as a self-pipe
+    socket_t sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock == INVALID_SOCKET) {
+        return false;
+    }
+
+    struct sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int len = sizeof(addr);
+    u_long mode = 1;
+
+    if (::bind(sock, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == SOCKET_ERROR ||
+        getsockname(sock, reinterpret_cast<struct sockaddr*>(&addr), &len) == SOCKET_ERROR ||
+        ::connect(sock, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == SOCKET_ERROR ||
+        ioctlsocket(sock, FIONBIO, &mode) != 0) {
+        closesocket(sock);
+        return false;
+    }
+
+    wakeupRead_ = sock;
+    wakeupWrite_ = sock;
+    return true;
+#else
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return false;
+    }
+    for (int fd : fds) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+    wakeupRead_ = fds[0];
+    wakeupWrite_ = fds[1];
+    return true;
+#endif
+}
+
+void EventLoop::closeWakeup() {
+    if (wakeupRead_ != INVALID_SOCKET) {
+        closeSocketHandle(wakeupRead_);
+    }
+    if (wakeupWrite_ != INVALID_SOCKET && wakeupWrite_ != wakeupRead_) {
+        closeSocketHandle(wakeupWrite_);
+    }
+    wakeupRead_ = INVALID_SOCKET;
+    wakeupWrite_ = INVALID_SOCKET;
+}
+
+void EventLoop::wakeup() {
+    // A pending write already guarantees another turn of the loop, which
+    // picks up everything posted before it drains
+    if (wakeupWrite_ == INVALID_SOCKET || wakeupPending_.exchange(true, std::memory_order_acq_rel)) {
+        return;
+    }
+
+#if defined(TCP_EVENT_LOOP_EPOLL)
+    uint64_t one = 1;
+    ssize_t written = ::write(wakeupWrite_, &one, sizeof(one));
+    (void)written;
+#elif defined(_WIN32)
+    char one = 1;
+    ::send(wakeupWrite_, &one, 1, 0);
+#else
+    char one = 1;
+    ssize_t written = ::write(wakeupWrite_, &one, 1);
+    (void)written;
+#endif
+}
+
+void EventLoop::drainWakeup() {
+#if defined(TCP_EVENT_LOOP_EPOLL)
+    uint64_t value;
+    ssize_t result = ::read(wakeupRead_, &value, sizeof(value));
+    (void)result;
+#elif defined(_WIN32)
+    char buffer[64];
+    while (::recv(wakeupRead_, buffer, sizeof(buffer), 0) > 0) {
+    }
+#else
+    char buffer[64];
+    while (::read(wakeupRead_, buffer, sizeof(buffer)) > 0) {
+    }
+#endif
+    // Cleared only after reading: clearing first lets a racing write be
+    // consumed here while its flag stays set. A wakeup() that finds the
+    // flag still set skips its write, which is fine because pending tasks
+    // run after this drain in the same pass (the acq_rel exchange orders
+    // its post before our runPendingTasks)
+    wakeupPending_.exchange(false, std::memory_order_acq_rel);
+}
+
+void EventLoop::runPendingTasks() {
+    std::vector<Task> tasks;
+    {
+        std::lock_guard<std::mutex> lock(tasksMutex_);
+        tasks.swap(pendingTasks_);
+    }
+
+    callingPendingTasks_ = true;
+    for (auto& task : tasks) {
+        task();
+    }
+    callingPendingTasks_ = false;
+}
+
+void EventLoop::runTimers() {
+    {
+        std::lock_guard<std::mutex> lock(timersMutex_);
+        if (timers_.empty()) {
+            return;
+        }
+        timers_.advance(std::chrono::steady_clock::now(), expiredTimers_);
+    }
+    
+    // Outside the lock, so callbacks can schedule and cancel
+    for (auto& task : expiredTimers_) {
+        task();
+    }
+    expiredTimers_.clear();
+}
+
+int EventLoop::nextTimeout() const {
+    std::lock_guard<std::mutex> lock(timersMutex_);
+    return timers_.timeUntilNext(std::chrono::steady_clock::now());
+}
+
+void EventLoop::dispatchEvent(socket_t socket, uint32_t events) {
+    std::shared_ptr<IoHandler> handler;
+    {
+        std::lock_guard<std::mutex> lock(handlersMutex_);
+        auto it = handlers_.find(socket);
+        if (it == handlers_.end()) {
+            return;
+        }
+        handler = it->second;
+    }
+
+    (*handler)(events);
+}
+
+// EventLoopGroup implementation
+EventLoopGroup::EventLoopGroup(size_t threadCount, const EventLoop::Options& options, const std::vector<int>& cpus)
+    : nextLoop_(0), running_(false) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (size_t i = 0; i < threadCount; i++) {
+        EventLoop::Options loopOptions = options;
+        if (!cpus.empty()) {
+            loopOptions.cpu = cpus[i % cpus.size()];
+        }
+        loops_.push_back(std::make_shared<EventLoop>(loopOptions));
+    }
+}
+
+EventLoopGroup::~EventLoopGroup() {
+    stop();
+}
+
+bool EventLoopGroup::start() {
+    if (running_) {
+        return true;
+    }
+
+    for (auto& loop : loops_) {
+        if (!loop->start()) {
+            stop();
+            return false;
+        }
+    }
+
+    running_ = true;
+    return true;
+}
+
+void EventLoopGroup::stop() {
+    for (auto& loop : loops_) {
+        loop->stop();
+    }
+    running_ = false;
+}
+
+EventLoop* EventLoopGroup::next() {
+    if (loops_.empty()) {
+        return nullptr;
+    }
+    return loops_[nextLoop_.fetch_add(1, std::memory_order_relaxed) % loops_.size()].get();
+}
+
+EventLoop* EventLoopGroup::getLoop(size_t index) const {
+    return index < loops_.size() ? loops_[index].get() : nullptr;
+}
+
+EventLoop* EventLoopGroup::forCpu(int cpu) const {
+    if (cpu < 0) {
+        return nullptr;
+    }
+    for (const auto& loop : loops_) {
+        if (loop->getCpu() == cpu) {
+            return loop.get();
+        }
+    }
+    return nullptr;
+}
+
+size_t EventLoopGroup::indexOf(const EventLoop* loop) const {
+    for (size_t i = 0; i < loops_.size(); i++) {
+        if (loops_[i].get() == loop) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+} // namespace tcp
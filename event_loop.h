@@ -0,0 +1,220 @@
+#pragma once
+
+#include "tcp_socket.h"
+#include "timer_wheel.h"
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <unordered_map>
+
+namespace tcp {
+
+// Readiness-based I/O reactor. Each loop owns one kernel poller (epoll on
+// Linux, kqueue on macOS/BSD, WSAPoll on Windows) and dispatches handlers
+// on a single thread. Timers share the loop through a timing wheel whose
+// next expiry bounds the poller's wait.
+//
+// Built with TCP_IO_URING, Linux loops run on io_uring instead: readiness
+// becomes re-armed poll requests, and the completion operations below
+// (multishot accept and receive, linked sends) are available. Each loop
+// turn then costs one system call, whatever it submits and reaps.
+class EventLoop : public std::enable_shared_from_this<EventLoop> {
+public:
+    using IoHandler = std::function<void(uint32_t events)>;
+    using Task = std::function<void()>;
+
+    // Completion handlers, run on the loop thread
+    using AcceptHandler = std::function<void(socket_t socket)>;
+    // Data is valid during the call only; the end of the stream is reported
+    // as ConnectionClosed
+    using ReceiveHandler = std::function<void(const BufferView& data, ErrorCode error)>;
+    using SendHandler = std::function<void(size_t bytesWritten, ErrorCode error)>;
+
+    // Event bits passed to add()/modify() and reported to handlers
+    static constexpr uint32_t Readable = 0x01;
+    static constexpr uint32_t Writable = 0x02;
+    static constexpr uint32_t Error = 0x04;
+    static constexpr uint32_t Hangup = 0x08;
+
+    enum class Backend {
+        Epoll,
+        Kqueue,
+        Poll,
+        IoUring
+    };
+
+    struct Options {
+        bool ioUring = true;          // When built with it; falls back to epoll if the kernel can't
+        bool sqPoll = false;          // A kernel thread takes submissions (costs a CPU while busy)
+        unsigned sqPollIdleMs = 50;   // ... and sleeps after this long idle
+        unsigned ringEntries = 1024;  // Submission queue size
+        int cpu = -1;                 // Pin the loop thread to this CPU (-1 = unpinned)
+        unsigned busyPollUs = 0;      // Poll without blocking this long before sleeping (0 = off)
+        size_t localBufferBytes = 0;  // A buffer pool of its own, this much reserved from the
+                                      // loop thread (0 = the shared pool)
+    };
+
+    // Time the loop thread spent on handlers, tasks and timers against time
+    // spent waiting for events (busy-poll spins count as waiting)
+    struct Utilization {
+        int cpu = -1; // Pinned CPU, else the one the loop last woke on
+        uint64_t busyNanos = 0;
+        uint64_t idleNanos = 0;
+
+        double busyFraction() const;                           // Since the loop started
+        double busyFraction(const Utilization& earlier) const; // Between two samples
+    };
+
+    // Kernel poller interface, implemented per platform in event_loop.cpp
+    class Poller;
+
+    EventLoop();
+    explicit EventLoop(const Options& options);
+    ~EventLoop();
+
+    // Non-copyable, non-movable
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+    EventLoop(EventLoop&&) = delete;
+    EventLoop& operator=(EventLoop&&) = delete;
+
+    // Loop lifecycle
+    bool start();   // Run the loop on a dedicated thread
+    void run();     // Run the loop on the calling thread until stop()
+    void stop();
+    bool isRunning() const { return running_; }
+    bool isInLoopThread() const;
+
+    // Descriptor registration (thread-safe)
+    bool add(socket_t socket, uint32_t events, IoHandler handler);
+    bool modify(socket_t socket, uint32_t events);
+    void remove(socket_t socket); // Also cancels its completion operations
+
+    // Completion operations (thread-safe). False when the backend has none,
+    // or the request can't be queued; callers then fall back to readiness.
+    // acceptMultishot() and receiveMultishot() stay armed until remove();
+    // operations still pending when the loop stops are dropped, handlers
+    // unrun.
+    bool acceptMultishot(socket_t listener, AcceptHandler handler);
+    bool receiveMultishot(socket_t socket, ReceiveHandler handler);
+    // Sends the buffers in order as one linked chain; they must stay valid
+    // until the handler reports how much of them was written. A chain may
+    // be cut short when the ring is full: the handler then reports only
+    // what was included, with Success.
+    bool sendChain(socket_t socket, const ByteView* buffers, size_t count, SendHandler handler);
+    bool hasCompletionIo() const;
+
+    // Task submission (thread-safe)
+    void post(Task task);
+    void dispatch(Task task); // Runs inline when called on the loop thread
+
+    // Timers (thread-safe), run on the loop thread with 1 ms resolution.
+    // Cancelling is O(1) and safe after the timer fired.
+    TimerId runAfter(std::chrono::milliseconds delay, Task task);
+    TimerId runEvery(std::chrono::milliseconds interval, Task task); // Until cancelled
+    bool cancelTimer(TimerId id); // False if it already fired or was cancelled
+    size_t getTimerCount() const;
+
+    // Process-wide loop, started on first use, for timers of objects that
+    // have no loop of their own (TcpClient connects, heartbeats and reconnects)
+    static EventLoop& shared();
+
+    // Loop info
+    Backend getBackend() const;
+    size_t getHandlerCount() const;
+    // System calls the poller made: waits, and registration changes
+    uint64_t getSyscallCount() const;
+    // When the current batch of events was reported (loop thread only)
+    std::chrono::steady_clock::time_point getWakeTime() const { return wakeTime_; }
+    Utilization getUtilization() const;
+
+    // Placement. A pinned loop with a pool of its own reads into memory on
+    // its NUMA node.
+    int getCpu() const { return cpu_.load(std::memory_order_relaxed); } // -1 unless pinned
+    BufferPool& getBufferPool(); // Its own, else BufferPool::shared()
+
+private:
+    std::unique_ptr<BufferPool> bufferPool_; // Outlives the poller's receive buffers
+    std::unique_ptr<Poller> poller_;
+    std::atomic<bool> running_;
+    std::atomic<bool> shouldStop_;
+    std::atomic<std::thread::id> threadId_;
+    std::thread thread_;
+
+    // Registered handlers
+    std::unordered_map<socket_t, std::shared_ptr<IoHandler>> handlers_;
+    mutable std::mutex handlersMutex_;
+
+    // Pending cross-thread tasks
+    std::vector<Task> pendingTasks_;
+    std::mutex tasksMutex_;
+    bool callingPendingTasks_; // Loop thread only
+
+    // Timers
+    TimerWheel timers_;
+    mutable std::mutex timersMutex_;
+    std::vector<Task> expiredTimers_; // Loop thread only
+
+    // Wakeup channel
+    socket_t wakeupRead_;
+    socket_t wakeupWrite_;
+    std::atomic<bool> wakeupPending_; // Written but not yet drained
+    std::chrono::steady_clock::time_point wakeTime_; // Loop thread only
+
+    // Placement and utilization (written by the loop thread)
+    std::atomic<int> cpu_; // Cleared if pinning fails
+    std::chrono::microseconds busyPoll_;
+    size_t localBufferBytes_;
+    std::atomic<int> lastCpu_;
+    std::atomic<uint64_t> busyNanos_;
+    std::atomic<uint64_t> idleNanos_;
+    std::atomic<std::chrono::steady_clock::rep> waitingSince_; // 0 while not waiting
+
+    // Internal methods
+    bool createWakeup();
+    void closeWakeup();
+    void wakeup(); // At most one pending wakeup write at a time
+    bool wakeupIfQueued(bool queued);
+    void drainWakeup();
+    void runPendingTasks();
+    void runTimers();
+    int nextTimeout() const;
+    TimerId scheduleTimer(std::chrono::milliseconds delay, std::chrono::milliseconds interval, Task task);
+    void dispatchEvent(socket_t socket, uint32_t events);
+};
+
+// Fixed set of event loops, each on its own I/O thread
+class EventLoopGroup {
+public:
+    // With cpus, loop i is pinned to cpus[i % cpus.size()]
+    explicit EventLoopGroup(size_t threadCount = 0, // 0 = hardware concurrency
+                            const EventLoop::Options& options = EventLoop::Options(),
+                            const std::vector<int>& cpus = std::vector<int>());
+    ~EventLoopGroup();
+
+    // Non-copyable
+    EventLoopGroup(const EventLoopGroup&) = delete;
+    EventLoopGroup& operator=(const EventLoopGroup&) = delete;
+
+    bool start();
+    void stop();
+    bool isRunning() const { return running_; }
+
+    // Loop selection
+    EventLoop* next(); // Round-robin
+    EventLoop* getLoop(size_t index) const;
+    EventLoop* forCpu(int cpu) const; // The loop pinned to cpu, or null
+    size_t indexOf(const EventLoop* loop) const;
+    size_t size() const { return loops_.size(); }
+
+private:
+    // Shared so connections can outlive the group that created them
+    std::vector<std::shared_ptr<EventLoop>> loops_;
+    std::atomic<size_t> nextLoop_;
+    std::atomic<bool> running_;
+};
+
+} // namespace tcp
@@ -1,6 +1,7 @@
 #include "../tcp.h"
 #include <iostream>
 #include <string>
+#include <map>
 #include <set>
 #include <sstream>
 
@@ -8,22 +9,47 @@ class ChatServer {
 private:
     tcp::TcpServer server_;
     std::set<std::shared_ptr<tcp::TcpConnection>> clients_;
+    std::map<tcp::ConnectionId, std::string> rooms_; // Current room of each client
     std::mutex clientsMutex_;
     
-    void broadcastMessage(const std::string& message, std::shared_ptr<tcp::TcpConnection> sender = nullptr) {
+    // Rooms are server topics: the line is encoded once and each I/O thread
+    // writes it to its own members
+    void broadcastMessage(const std::string& room, const std::string& message,
+                          std::shared_ptr<tcp::TcpConnection> sender = nullptr) {
+        server_.publish(room, message + "\r\n", sender ? sender->getId() : 0);
+    }
+    
+    std::string getRoom(std::shared_ptr<tcp::TcpConnection> client) {
         std::lock_guard<std::mutex> lock(clientsMutex_);
+        auto it = rooms_.find(client->getId());
+        return it != rooms_.end() ? it->second : std::string();
+    }
+    
+    void joinRoom(std::shared_ptr<tcp::TcpConnection> client, const std::string& room) {
+        std::string previous = getRoom(client);
+        if (previous == room) {
+            return;
+        }
         
-        std::string formattedMessage = message + "\r\n";
-        for (auto& client : clients_) {
-            if (client && client != sender && client->isConnected()) {
-                client->send(formattedMessage);
-            }
+        auto info = client->getInfo();
+        std::string user = info.remoteAddress + ":" + std::to_string(info.remotePort);
+        if (!previous.empty()) {
+            server_.unsubscribe(client, previous);
+            broadcastMessage(previous, "User " + user + " left the room", client);
         }
+        
+        server_.subscribe(client, room);
+        {
+            std::lock_guard<std::mutex> lock(clientsMutex_);
+            rooms_[client->getId()] = room;
+        }
+        broadcastMessage(room, "User " + user + " joined " + room, client);
     }
     
     void removeClient(std::shared_ptr<tcp::TcpConnection> client) {
         std::lock_guard<std::mutex> lock(clientsMutex_);
         clients_.erase(client);
+        rooms_.erase(client->getId());
     }
     
 public:
@@ -44,20 +70,21 @@ public:
             // Send welcome message
             connection->send("Welcome to Chat Server! Type '/help' for commands.\r\n");
             
-            // Notify other clients
-            std::stringstream ss;
-            ss << "User " << info.remoteAddress << ":" << info.remotePort << " joined the chat";
-            broadcastMessage(ss.str(), connection);
+            // Everyone starts in the lobby; joining notifies its members
+            joinRoom(connection, "lobby");
         });
         
         server_.setOnDisconnected([this](std::shared_ptr<tcp::TcpConnection> connection) {
             auto info = connection->getInfo();
             std::cout << "Client disconnected: " << info.remoteAddress << ":" << info.remotePort << std::endl;
             
-            // Notify other clients
-            std::stringstream ss;
-            ss << "User " << info.remoteAddress << ":" << info.remotePort << " left the chat";
-            broadcastMessage(ss.str(), connection);
+            // Notify the rest of the room
+            std::string room = getRoom(connection);
+            if (!room.empty()) {
+                std::stringstream ss;
+                ss << "User " << info.remoteAddress << ":" << info.remotePort << " left the chat";
+                broadcastMessage(room, ss.str(), connection);
+            }
             
             removeClient(connection);
         });
@@ -79,10 +106,10 @@ public:
             if (message[0] == '/') {
                 handleCommand(connection, message);
             } else {
-                // Broadcast message to all clients
+                // Send the message to everyone else in the room
                 std::stringstream ss;
                 ss << "[" << info.remoteAddress << ":" << info.remotePort << "] " << message;
-                broadcastMessage(ss.str(), connection);
+                broadcastMessage(getRoom(connection), ss.str(), connection);
             }
         });
         
@@ -98,6 +125,8 @@ public:
             connection->send("Available commands:\r\n");
             connection->send("  /help - Show this help message\r\n");
             connection->send("  /users - List connected users\r\n");
+            connection->send("  /join <room> - Switch to another room\r\n");
+            connection->send("  /room - Show your current room\r\n");
             connection->send("  /stats - Show server statistics\r\n");
             connection->send("  /quit - Disconnect from server\r\n");
         } else if (command == "/users") {
@@ -106,10 +135,27 @@ public:
             for (const auto& client : clients_) {
                 if (client && client->isConnected()) {
                     auto info = client->getInfo();
-                    std::string userInfo = "  " + info.remoteAddress + ":" + std::to_string(info.remotePort) + "\r\n";
+                    auto room = rooms_.find(client->getId());
+                    std::string userInfo = "  " + info.remoteAddress + ":" + std::to_string(info.remotePort);
+                    if (room != rooms_.end()) {
+                        userInfo += " (" + room->second + ")";
+                    }
+                    userInfo += "\r\n";
                     connection->send(userInfo);
                 }
             }
+        } else if (command.compare(0, 6, "/join ") == 0) {
+            std::string room = command.substr(6);
+            room.erase(0, room.find_first_not_of(" \t"));
+            if (room.empty()) {
+                connection->send("Usage: /join <room>\r\n");
+                return;
+            }
+            joinRoom(connection, room);
+            connection->send("You are now in " + room + " (" +
+                             std::to_string(server_.getBroadcaster().getSubscriberCount(room)) + " users)\r\n");
+        } else if (command == "/room") {
+            connection->send("You are in " + getRoom(connection) + "\r\n");
         } else if (command == "/stats") {
             auto stats = server_.getStatistics();
             std::stringstream ss;
@@ -0,0 +1,126 @@
+#include "executor.h"
+#include <algorithm>
+
+namespace tcp {
+
+namespace {
+
+// Executor whose worker is the current thread, if any
+thread_local const Executor* currentExecutor = nullptr;
+
+} // namespace
+
+Executor::Executor(size_t threadCount, size_t queueCapacity)
+    : capacity_(std::max<size_t>(1, queueCapacity)), stopping_(false) {
+    if (threadCount == 0) {
+        threadCount = std::max(2u, std::thread::hardware_concurrency());
+    }
+    
+    workers_.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; i++) {
+        workers_.emplace_back(&Executor::workerLoop, this);
+    }
+}
+
+Executor::~Executor() {
+    shutdown();
+}
+
+bool Executor::submit(Task task) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    
+    if (!stopping_ && tasks_.size() >= capacity_ && isWorkerThread()) {
+        // Waiting here could deadlock the pool on itself
+        lock.unlock();
+        task();
+        return true;
+    }
+    
+    notFull_.wait(lock, [this] { return stopping_ || tasks_.size() < capacity_; });
+    if (stopping_) {
+        return false;
+    }
+    
+    tasks_.push_back(std::move(task));
+    lock.unlock();
+    notEmpty_.notify_one();
+    return true;
+}
+
+bool Executor::trySubmit(Task task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_ || tasks_.size() >= capacity_) {
+            return false;
+        }
+        tasks_.push_back(std::move(task));
+    }
+    notEmpty_.notify_one();
+    return true;
+}
+
+void Executor::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) {
+            return;
+        }
+        stopping_ = true;
+    }
+    notEmpty_.notify_all();
+    notFull_.notify_all();
+    
+    for (auto& worker : workers_) {
+        if (worker.get_id() == std::this_thread::get_id()) {
+            worker.detach();
+        } else if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+size_t Executor::getQueuedTasks() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return tasks_.size();
+}
+
+Executor& Executor::shared() {
+    // Never destroyed, like EventLoop::shared(): its timers submit work here
+    // and may fire during static destruction
+    static Executor* executor = new Executor();
+    return *executor;
+}
+
+void Executor::workerLoop() {
+    currentExecutor = this;
+    
+    while (true) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            notEmpty_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+            
+            // Drain what was accepted before shutdown
+            if (tasks_.empty()) {
+                break;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        notFull_.notify_one();
+        
+        try {
+            task();
+        } catch (...) {
+            // A failing task must not take the worker down
+        }
+    }
+    
+    currentExecutor = nullptr;
+}
+
+bool Executor::isWorkerThread() const {
+    return currentExecutor == this;
+}
+
+} // namespace tcp
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+namespace tcp {
+
+// Fixed-size worker pool with a bounded task queue. Backs the library's
+// sendAsync()/receiveAsync() calls so an async operation costs an enqueue
+// rather than a thread spawn.
+class Executor {
+public:
+    using Task = std::function<void()>;
+
+    explicit Executor(size_t threadCount = 0, size_t queueCapacity = 65536); // 0 = hardware concurrency
+    ~Executor(); // Runs queued tasks, then joins the workers
+
+    // Non-copyable
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+
+    // Blocks while the queue is full (runs inline when called from a worker).
+    // Returns false once the executor is shut down.
+    bool submit(Task task);
+    bool trySubmit(Task task); // Returns false instead of blocking
+    void shutdown();
+
+    size_t getThreadCount() const { return workers_.size(); }
+    size_t getQueueCapacity() const { return capacity_; }
+    size_t getQueuedTasks() const;
+
+    // Process-wide executor used by the async socket APIs
+    static Executor& shared();
+
+private:
+    std::vector<std::thread> workers_;
+    std::deque<Task> tasks_;
+    size_t capacity_;
+    bool stopping_;
+    mutable std::mutex mutex_;
+    std::condition_variable notEmpty_;
+    std::condition_variable notFull_;
+
+    void workerLoop();
+    bool isWorkerThread() const;
+};
+
+} // namespace tcp
@@ -0,0 +1,242 @@
+#include "file_transfer.h"
+#include "sigpipe_guard.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <mswsock.h>
+#include <io.h>
+#pragma comment(lib, "mswsock.lib")
+#else
+#include <sys/stat.h>
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#elif defined(__APPLE__)
+#include <sys/types.h>
+#include <sys/uio.h>
+#endif
+#endif
+
+namespace tcp {
+
+namespace {
+
+// Upper bound for one kernel copy (Linux caps sendfile at 2 GiB anyway)
+constexpr size_t kMaxTransmitChunk = size_t(1) << 30;
+
+#ifdef MSG_NOSIGNAL
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+constexpr int kSendFlags = 0;
+#endif
+
+#ifdef _WIN32
+std::string lastSystemError() {
+    return "error " + std::to_string(GetLastError());
+}
+#else
+std::string lastSystemError() {
+    return std::strerror(errno);
+}
+#endif
+
+} // namespace
+
+FileTransfer::FileTransfer()
+#ifdef _WIN32
+    : file_(INVALID_HANDLE_VALUE),
+#else
+    : fd_(-1),
+#endif
+      offset_(0), length_(0), sent_(0), error_(ErrorCode::Success), finished_(false) {
+}
+
+FileTransfer::~FileTransfer() {
+#ifdef _WIN32
+    if (file_ != INVALID_HANDLE_VALUE) {
+        CloseHandle(file_);
+    }
+#else
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+#endif
+}
+
+std::shared_ptr<FileTransfer> FileTransfer::open(const std::string& path, uint64_t offset, uint64_t length,
+                                                 FileTransferCallback callback, std::string& error) {
+    std::shared_ptr<FileTransfer> transfer(new FileTransfer());
+
+#ifdef _WIN32
+    transfer->file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                  FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (transfer->file_ == INVALID_HANDLE_VALUE) {
+#else
+    transfer->fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (transfer->fd_ < 0) {
+#endif
+        error = "Failed to open " + path + ": " + lastSystemError();
+        return nullptr;
+    }
+
+    if (!transfer->initialize(offset, length, std::move(callback), error)) {
+        return nullptr;
+    }
+    return transfer;
+}
+
+std::shared_ptr<FileTransfer> FileTransfer::fromDescriptor(int fd, uint64_t offset, uint64_t length,
+                                                           FileTransferCallback callback, std::string& error) {
+    std::shared_ptr<FileTransfer> transfer(new FileTransfer());
+
+#ifdef _WIN32
+    HANDLE source = reinterpret_cast<HANDLE>(_get_osfhandle(fd));
+    if (source == INVALID_HANDLE_VALUE ||
+        !DuplicateHandle(GetCurrentProcess(), source, GetCurrentProcess(), &transfer->file_,
+                         0, FALSE, DUPLICATE_SAME_ACCESS)) {
+        transfer->file_ = INVALID_HANDLE_VALUE;
+#else
+    transfer->fd_ = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (transfer->fd_ < 0) {
+#endif
+        error = "Invalid file descriptor: " + lastSystemError();
+        return nullptr;
+    }
+
+    if (!transfer->initialize(offset, length, std::move(callback), error)) {
+        return nullptr;
+    }
+    return transfer;
+}
+
+bool FileTransfer::initialize(uint64_t offset, uint64_t length, FileTransferCallback callback, std::string& error) {
+    uint64_t fileSize;
+#ifdef _WIN32
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file_, &size)) {
+        error = "Failed to stat file: " + lastSystemError();
+        return false;
+    }
+    fileSize = static_cast<uint64_t>(size.QuadPart);
+#else
+    struct stat info;
+    if (fstat(fd_, &info) != 0) {
+        error = "Failed to stat file: " + lastSystemError();
+        return false;
+    }
+    if (!S_ISREG(info.st_mode)) {
+        error = "Not a regular file";
+        return false;
+    }
+    fileSize = static_cast<uint64_t>(info.st_size);
+#endif
+
+    if (offset > fileSize || length > fileSize - offset) {
+        error = "Range is beyond the end of the file";
+        return false;
+    }
+
+    offset_ = offset;
+    length_ = length == 0 ? fileSize - offset : length;
+    callback_ = std::move(callback);
+    return true;
+}
+
+long FileTransfer::transmit(socket_t socket, size_t maxBytes) {
+    size_t count = static_cast<size_t>(std::min<uint64_t>({getRemaining(), maxBytes, kMaxTransmitChunk}));
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t position = offset_ + sent_;
+
+#if defined(_WIN32)
+    // Non-overlapped: completes once the range is in the send path
+    LARGE_INTEGER filePosition;
+    filePosition.QuadPart = static_cast<LONGLONG>(position);
+    if (!SetFilePointerEx(file_, filePosition, nullptr, FILE_BEGIN)) {
+        return -1;
+    }
+    if (!TransmitFile(socket, file_, static_cast<DWORD>(count), 0, nullptr, nullptr, 0)) {
+        return WSAGetLastError() == WSAEWOULDBLOCK ? 0 : -1;
+    }
+    return static_cast<long>(count);
+#elif defined(__linux__)
+    SigpipeGuard guard;
+    off_t filePosition = static_cast<off_t>(position);
+    ssize_t sent = ::sendfile(socket, fd_, &filePosition, count);
+    if (sent < 0) {
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+    }
+    return sent > 0 ? static_cast<long>(sent) : -1; // 0: the file shrank
+#elif defined(__APPLE__)
+    int noSigpipe = 1;
+    setsockopt(socket, SOL_SOCKET, SO_NOSIGPIPE, &noSigpipe, sizeof(noSigpipe));
+
+    // Reports the bytes sent even when it fails with EAGAIN
+    off_t sent = static_cast<off_t>(count);
+    int result = ::sendfile(fd_, socket, static_cast<off_t>(position), &sent, nullptr, 0);
+    if (sent > 0) {
+        return static_cast<long>(sent);
+    }
+    if (result < 0) {
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+    }
+    return -1;
+#else
+    // No kernel copy: stage through a pooled block
+    Buffer block = BufferPool::shared().acquire();
+    long length = read(block.data(), std::min(count, block.capacity()));
+    if (length <= 0) {
+        return -1;
+    }
+    ssize_t sent = ::send(socket, block.data(), static_cast<size_t>(length), kSendFlags);
+    if (sent < 0) {
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+    }
+    return static_cast<long>(sent);
+#endif
+}
+
+long FileTransfer::read(void* buffer, size_t maxBytes) {
+    size_t count = static_cast<size_t>(std::min<uint64_t>({getRemaining(), maxBytes, kMaxTransmitChunk}));
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t position = offset_ + sent_;
+
+#ifdef _WIN32
+    OVERLAPPED overlapped = {};
+    overlapped.Offset = static_cast<DWORD>(position);
+    overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+    DWORD bytesRead = 0;
+    if (!ReadFile(file_, buffer, static_cast<DWORD>(count), &bytesRead, &overlapped) || bytesRead == 0) {
+        return -1;
+    }
+    return static_cast<long>(bytesRead);
+#else
+    ssize_t bytesRead;
+    do {
+        bytesRead = ::pread(fd_, buffer, count, static_cast<off_t>(position));
+    } while (bytesRead < 0 && errno == EINTR);
+    return bytesRead > 0 ? static_cast<long>(bytesRead) : -1; // 0: the file shrank
+#endif
+}
+
+void FileTransfer::notify() {
+    if (finished_) {
+        return;
+    }
+
+    FileTransferProgress progress;
+    progress.bytesSent = sent_;
+    progress.totalBytes = length_;
+    progress.done = isComplete() || error_ != ErrorCode::Success;
+    progress.error = error_;
+    finished_ = progress.done;
+
+    if (callback_) {
+        callback_(progress);
+    }
+}
+
+} // namespace tcp
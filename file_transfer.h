@@ -0,0 +1,63 @@
+#pragma once
+
+#include "tcp_socket.h"
+#include <memory>
+#include <string>
+
+namespace tcp {
+
+// A byte range of an open file queued by sendFile(). Owns its own
+// descriptor, so the caller may close theirs once sendFile() returns.
+// Only the thread writing the transfer touches it; progress is tracked
+// here so queued and direct sends share one implementation.
+class FileTransfer {
+public:
+    ~FileTransfer();
+
+    // Non-copyable
+    FileTransfer(const FileTransfer&) = delete;
+    FileTransfer& operator=(const FileTransfer&) = delete;
+
+    // A length of 0 sends to the end of the file. Return nullptr with
+    // error set when the file can't be opened or the range is out of bounds.
+    static std::shared_ptr<FileTransfer> open(const std::string& path, uint64_t offset, uint64_t length,
+                                              FileTransferCallback callback, std::string& error);
+    static std::shared_ptr<FileTransfer> fromDescriptor(int fd, uint64_t offset, uint64_t length,
+                                                        FileTransferCallback callback, std::string& error);
+
+    uint64_t getLength() const { return length_; }
+    uint64_t getBytesSent() const { return sent_; }
+    uint64_t getRemaining() const { return length_ - sent_; }
+    bool isComplete() const { return sent_ == length_; }
+
+    // Send up to maxBytes from the current position. transmit() copies in
+    // the kernel (sendfile/TransmitFile); read() copies out for TLS. Both
+    // return the byte count, 0 when the socket would block, or -1 on error
+    // (including a file truncated under us). Neither advances the position.
+    long transmit(socket_t socket, size_t maxBytes);
+    long read(void* buffer, size_t maxBytes);
+
+    // Progress: advance() after bytes were accepted, fail() when the
+    // transfer is abandoned; notify() reports the current state once.
+    void advance(uint64_t bytes) { sent_ += bytes; }
+    void fail(ErrorCode error) { error_ = error; }
+    void notify();
+
+private:
+#ifdef _WIN32
+    HANDLE file_;
+#else
+    int fd_;
+#endif
+    uint64_t offset_;
+    uint64_t length_;
+    uint64_t sent_;
+    ErrorCode error_;
+    bool finished_; // Final progress delivered
+    FileTransferCallback callback_;
+
+    FileTransfer();
+    bool initialize(uint64_t offset, uint64_t length, FileTransferCallback callback, std::string& error);
+};
+
+} // namespace tcp
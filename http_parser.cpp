@@ -0,0 +1,946 @@
+#include "http_parser.h"
+#include "tcp_socket.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define TCP_HTTP_SSE2 1
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+    #include <arm_neon.h>
+    #define TCP_HTTP_NEON 1
+#endif
+#ifdef _MSC_VER
+    #include <intrin.h>
+#endif
+
+namespace tcp {
+
+namespace {
+
+constexpr size_t kMaxChunkLine = 4096;
+constexpr size_t kInitialHeadCapacity = 512;
+
+inline unsigned countTrailingZeros(uint64_t mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctzll(mask));
+#endif
+}
+
+// RFC 9110 token characters: methods and field names
+struct TokenTable {
+    bool values[256];
+
+    TokenTable() {
+        std::memset(values, 0, sizeof(values));
+        for (int c = '0'; c <= '9'; c++) {
+            values[c] = true;
+        }
+        for (int c = 'a'; c <= 'z'; c++) {
+            values[c] = true;
+            values[c - 'a' + 'A'] = true;
+        }
+        for (const char* c = "!#$%&'*+-.^_`|~"; *c; c++) {
+            values[static_cast<uint8_t>(*c)] = true;
+        }
+    }
+};
+
+const TokenTable kTokenTable;
+
+bool isToken(uint8_t c) {
+    return kTokenTable.values[c];
+}
+
+bool isTokenString(std::string_view text) {
+    return !text.empty() && std::all_of(text.begin(), text.end(), [](char c) { return isToken(static_cast<uint8_t>(c)); });
+}
+
+// First byte below 0x20 or DEL, or end: 16 bytes per compare
+const uint8_t* findControl(const uint8_t* data, const uint8_t* end) {
+#if defined(TCP_HTTP_SSE2)
+    const __m128i unitSeparator = _mm_set1_epi8(0x1F);
+    const __m128i del = _mm_set1_epi8(0x7F);
+    while (end - data >= 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        // Unsigned block <= 0x1F: max(block, 0x1F) == 0x1F
+        __m128i control = _mm_or_si128(_mm_cmpeq_epi8(_mm_max_epu8(block, unitSeparator), unitSeparator),
+                                       _mm_cmpeq_epi8(block, del));
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(control));
+        if (mask != 0) {
+            return data + countTrailingZeros(mask);
+        }
+        data += 16;
+    }
+#elif defined(TCP_HTTP_NEON)
+    const uint8x16_t space = vdupq_n_u8(0x20);
+    const uint8x16_t del = vdupq_n_u8(0x7F);
+    while (end - data >= 16) {
+        uint8x16_t block = vld1q_u8(data);
+        uint8x16_t control = vorrq_u8(vcltq_u8(block, space), vceqq_u8(block, del));
+        // Narrow to 4 bits per byte to get a scalar mask
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(control), 4)), 0);
+        if (mask != 0) {
+            return data + countTrailingZeros(mask) / 4;
+        }
+        data += 16;
+    }
+#endif
+    while (data < end && *data >= 0x20 && *data != 0x7F) {
+        data++;
+    }
+    return data;
+}
+
+// Length through the first "\n\n" or "\n\r\n" at or after from, or 0.
+// Three overlapping loads test 16 candidate positions per step.
+size_t findBlankLine(const uint8_t* data, size_t from, size_t size) {
+    size_t i = from;
+#if defined(TCP_HTTP_SSE2)
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+    while (i + 18 <= size) {
+        __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 1));
+        __m128i third = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 2));
+        __m128i blank = _mm_and_si128(_mm_cmpeq_epi8(first, lf),
+                                      _mm_or_si128(_mm_cmpeq_epi8(second, lf),
+                                                   _mm_and_si128(_mm_cmpeq_epi8(second, cr), _mm_cmpeq_epi8(third, lf))));
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(blank));
+        if (mask != 0) {
+            size_t at = i + countTrailingZeros(mask);
+            return data[at + 1] == '\n' ? at + 2 : at + 3;
+        }
+        i += 16;
+    }
+#elif defined(TCP_HTTP_NEON)
+    const uint8x16_t lf = vdupq_n_u8('\n');
+    const uint8x16_t cr = vdupq_n_u8('\r');
+    while (i + 18 <= size) {
+        uint8x16_t first = vld1q_u8(data + i);
+        uint8x16_t second = vld1q_u8(data + i + 1);
+        uint8x16_t third = vld1q_u8(data + i + 2);
+        uint8x16_t blank = vandq_u8(vceqq_u8(first, lf),
+                                    vorrq_u8(vceqq_u8(second, lf), vandq_u8(vceqq_u8(second, cr), vceqq_u8(third, lf))));
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(blank), 4)), 0);
+        if (mask != 0) {
+            size_t at = i + countTrailingZeros(mask) / 4;
+            return data[at + 1] == '\n' ? at + 2 : at + 3;
+        }
+        i += 16;
+    }
+#endif
+    for (; i < size; i++) {
+        if (data[i] != '\n') {
+            continue;
+        }
+        if (i + 1 < size && data[i + 1] == '\n') {
+            return i + 2;
+        }
+        if (i + 2 < size && data[i + 1] == '\r' && data[i + 2] == '\n') {
+            return i + 3;
+        }
+    }
+    return 0;
+}
+
+// End of the line at data (its CR or LF); next is set past the terminator.
+// Tabs are allowed, any other control byte (or a bare CR) fails with null.
+const uint8_t* findLineEnd(const uint8_t* data, const uint8_t* end, const uint8_t*& next) {
+    for (;;) {
+        const uint8_t* control = findControl(data, end);
+        if (control == end) {
+            return nullptr;
+        }
+        if (*control == '\t') {
+            data = control + 1;
+            continue;
+        }
+        if (*control == '\n') {
+            next = control + 1;
+            return control;
+        }
+        if (*control == '\r' && control + 1 < end && control[1] == '\n') {
+            next = control + 2;
+            return control;
+        }
+        return nullptr;
+    }
+}
+
+// Past a CRLF or bare LF at data, or null
+const uint8_t* skipLineEnd(const uint8_t* data, const uint8_t* end) {
+    if (data < end && *data == '\n') {
+        return data + 1;
+    }
+    if (end - data >= 2 && data[0] == '\r' && data[1] == '\n') {
+        return data + 2;
+    }
+    return nullptr;
+}
+
+std::string_view view(const uint8_t* begin, const uint8_t* end) {
+    return std::string_view(reinterpret_cast<const char*>(begin), static_cast<size_t>(end - begin));
+}
+
+char toLower(char c) {
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (toLower(a[i]) != toLower(b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string_view trim(std::string_view text) {
+    while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && (text.back() == ' ' || text.back() == '\t')) {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
+// Whether a comma-separated field value lists token
+bool hasToken(std::string_view list, std::string_view token) {
+    while (!list.empty()) {
+        size_t comma = list.find(',');
+        if (equalsIgnoreCase(trim(list.substr(0, comma)), token)) {
+            return true;
+        }
+        if (comma == std::string_view::npos) {
+            break;
+        }
+        list.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+int hexValue(uint8_t c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    c = static_cast<uint8_t>(toLower(static_cast<char>(c)));
+    return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+// Statuses whose responses never carry a body
+bool isBodyless(int statusCode) {
+    return (statusCode >= 100 && statusCode < 200) || statusCode == 204 || statusCode == 304;
+}
+
+} // namespace
+
+// HttpMessage
+
+std::string_view HttpMessage::header(std::string_view name) const {
+    for (size_t i = 0; i < headerCount; i++) {
+        if (equalsIgnoreCase(headers[i].name, name)) {
+            return headers[i].value;
+        }
+    }
+    return std::string_view();
+}
+
+bool HttpMessage::keepAlive() const {
+    std::string_view connection = header("Connection");
+    if (versionMinor >= 1) {
+        return !hasToken(connection, "close");
+    }
+    return hasToken(connection, "keep-alive");
+}
+
+// HttpParser
+
+HttpParser::HttpParser(Type type)
+    : type_(type), maxHeadSize_(kDefaultMaxHeadSize), maxBodySize_(kDefaultMaxBodySize), error_(Error::None),
+      headResponses_(0), carrySize_(0), scanned_(0), headSize_(0), chunkOffset_(0), chunkBodySize_(0) {
+}
+
+std::vector<uint8_t> HttpParser::frame(const std::vector<uint8_t>& data) {
+    return data;
+}
+
+std::vector<std::vector<uint8_t>> HttpParser::unframe(const std::vector<uint8_t>& data) {
+    std::vector<std::vector<uint8_t>> messages;
+    Buffer block = BufferPool::shared().acquire(data.size());
+    if (!data.empty()) {
+        std::memcpy(block.data(), data.data(), data.size());
+    }
+    block.setSize(data.size());
+    dispatch(BufferView(std::move(block)), false, [&messages](const HttpMessage&, const uint8_t* raw, size_t rawSize) {
+        messages.emplace_back(raw, raw + rawSize);
+    });
+    return messages;
+}
+
+bool HttpParser::isComplete(const std::vector<uint8_t>& data) {
+    HttpParser probe(type_);
+    probe.maxHeadSize_ = maxHeadSize_;
+    probe.maxBodySize_ = maxBodySize_;
+    probe.headResponses_ = headResponses_;
+    return probe.parse(ByteView(data), [](const HttpMessage&) {}) > 0;
+}
+
+void HttpParser::reset() {
+    error_ = Error::None;
+    headResponses_ = 0;
+    carry_.reset();
+    carrySize_ = 0;
+    finishMessage();
+}
+
+size_t HttpParser::parse(const ByteView& data, const MessageCallback& onMessage) {
+    // Bodies are retainable, so they need a block of their own
+    Buffer block = BufferPool::shared().acquire(data.size());
+    if (!data.empty()) {
+        std::memcpy(block.data(), data.data(), data.size());
+    }
+    block.setSize(data.size());
+    return parse(BufferView(std::move(block)), onMessage);
+}
+
+size_t HttpParser::parse(const BufferView& data, const MessageCallback& onMessage) {
+    return dispatch(data, false, [&onMessage](const HttpMessage& message, const uint8_t*, size_t) {
+        onMessage(message);
+    });
+}
+
+size_t HttpParser::finish(const MessageCallback& onMessage) {
+    size_t delivered = 0;
+    if (carrySize_ > 0) {
+        delivered = dispatch(BufferView(), true, [&onMessage](const HttpMessage& message, const uint8_t*, size_t) {
+            onMessage(message);
+        });
+    }
+    // Whatever is left was cut off
+    carry_.reset();
+    carrySize_ = 0;
+    finishMessage();
+    return delivered;
+}
+
+int HttpParser::getStatusCode() const {
+    switch (error_) {
+        case Error::BadMessage: return 400;
+        case Error::HeadersTooLarge: return 431;
+        case Error::BodyTooLarge: return 413;
+        default: return 0;
+    }
+}
+
+template <typename Emit>
+size_t HttpParser::dispatch(const BufferView& data, bool atEnd, Emit&& emit) {
+    if (error_ != Error::None) {
+        return 0;
+    }
+
+    // Parse from the input itself unless a message is already under way
+    const BufferView* window = &data;
+    BufferView carried;
+    if (carrySize_ > 0) {
+        size_t needed = carrySize_ + data.size();
+        if (!carry_.unique() || carry_.capacity() < needed) {
+            // Grow geometrically; a delivered body may still share the old block
+            Buffer grown = BufferPool::shared().acquire(std::max(needed, carry_.capacity() * 2));
+            std::memcpy(grown.data(), carry_.data(), carrySize_);
+            carry_ = std::move(grown);
+        }
+        if (!data.empty()) {
+            std::memcpy(carry_.data() + carrySize_, data.data(), data.size());
+        }
+        carrySize_ = needed;
+        carry_.setSize(carrySize_);
+        carried = BufferView(carry_, 0, carrySize_);
+        window = &carried;
+    }
+
+    const uint8_t* input = window->data();
+    size_t size = window->size();
+    size_t offset = 0;
+    size_t delivered = 0;
+
+    while (error_ == Error::None) {
+        // Empty lines before a request are ignored (RFC 9112 section 2.2)
+        if (type_ == Type::Request && headSize_ == 0 && scanned_ == 0) {
+            while (offset < size && (input[offset] == '\r' || input[offset] == '\n')) {
+                offset++;
+            }
+        }
+        if (offset == size) {
+            break;
+        }
+
+        const uint8_t* message = input + offset;
+        size_t available = size - offset;
+        if (headSize_ == 0) {
+            headSize_ = findHeadEnd(message, available);
+            if (headSize_ == 0) {
+                if (available > maxHeadSize_) {
+                    fail(Error::HeadersTooLarge);
+                }
+                break;
+            }
+            if (headSize_ > maxHeadSize_) {
+                fail(Error::HeadersTooLarge);
+                break;
+            }
+        }
+
+        // The head is parsed again on each attempt; it may have moved
+        HttpMessage& parsed = message_;
+        BodyKind kind = BodyKind::None;
+        uint64_t length = 0;
+        if (!parseHead(message, headSize_, parsed, kind, length)) {
+            break;
+        }
+
+        size_t total = 0;
+        switch (kind) {
+            case BodyKind::None:
+                total = headSize_;
+                break;
+            case BodyKind::Length:
+                if (length > maxBodySize_) {
+                    fail(Error::BodyTooLarge);
+                } else if (available - headSize_ >= length) {
+                    total = headSize_ + static_cast<size_t>(length);
+                    parsed.body = window->slice(offset + headSize_, static_cast<size_t>(length));
+                }
+                break;
+            case BodyKind::Chunked:
+                total = parseChunks(message, available);
+                if (total > 0) {
+                    parsed.body = BufferView(std::move(chunkBody_), 0, chunkBodySize_);
+                }
+                break;
+            case BodyKind::UntilClose:
+                if (available - headSize_ > maxBodySize_) {
+                    fail(Error::BodyTooLarge);
+                } else if (atEnd) {
+                    total = available;
+                    parsed.body = window->slice(offset + headSize_, available - headSize_);
+                }
+                break;
+        }
+        if (total == 0) {
+            break; // Failed, or the rest comes with later reads
+        }
+
+        if (type_ == Type::Response && parsed.statusCode >= 200 && headResponses_ > 0) {
+            headResponses_--;
+        }
+        finishMessage();
+        emit(static_cast<const HttpMessage&>(parsed), message, total);
+        parsed.body = BufferView(); // The parser mustn't pin the block
+        delivered++;
+        offset += total;
+    }
+
+    if (error_ != Error::None) {
+        carry_.reset();
+        carrySize_ = 0;
+        return delivered;
+    }
+
+    // Keep the unparsed tail; in place when nothing else holds the block
+    const uint8_t* rest = input + offset;
+    size_t restSize = size - offset;
+    carried = BufferView();
+    if (restSize == 0) {
+        carrySize_ = 0;
+    } else if (carrySize_ > 0 && carry_.unique()) {
+        std::memmove(carry_.data(), rest, restSize);
+        carrySize_ = restSize;
+        carry_.setSize(carrySize_);
+    } else {
+        Buffer block = BufferPool::shared().acquire(std::max(restSize, kInitialHeadCapacity));
+        std::memcpy(block.data(), rest, restSize);
+        carry_ = std::move(block);
+        carrySize_ = restSize;
+        carry_.setSize(carrySize_);
+    }
+    return delivered;
+}
+
+size_t HttpParser::findHeadEnd(const uint8_t* data, size_t size) {
+    // Resume just before the last search stopped, for a blank line split
+    // across reads
+    size_t length = findBlankLine(data, scanned_ > 2 ? scanned_ - 2 : 0, size);
+    if (length == 0) {
+        scanned_ = size;
+    }
+    return length;
+}
+
+bool HttpParser::parseHead(const uint8_t* data, size_t size, HttpMessage& message, BodyKind& kind, uint64_t& length) {
+    const uint8_t* p = data;
+    const uint8_t* end = data + size;
+    message.method = message.target = message.reason = std::string_view();
+    message.statusCode = 0;
+    message.versionMinor = 1;
+    message.headerCount = 0;
+    message.chunked = false;
+
+    if (type_ == Type::Request) {
+        // method SP request-target SP HTTP/1.x
+        const uint8_t* start = p;
+        while (p < end && isToken(*p)) {
+            p++;
+        }
+        if (p == start || p == end || *p != ' ') {
+            fail(Error::BadMessage);
+            return false;
+        }
+        message.method = view(start, p++);
+
+        start = p;
+        while (p < end && *p > 0x20 && *p != 0x7F) {
+            p++;
+        }
+        if (p == start || p == end || *p != ' ') {
+            fail(Error::BadMessage);
+            return false;
+        }
+        message.target = view(start, p++);
+
+        if (end - p < 8 || std::memcmp(p, "HTTP/1.", 7) != 0 || p[7] < '0' || p[7] > '9') {
+            fail(Error::BadMessage);
+            return false;
+        }
+        message.versionMinor = p[7] - '0';
+        p = skipLineEnd(p + 8, end);
+    } else {
+        // HTTP/1.x SP 3DIGIT SP reason-phrase
+        if (end - p < 12 || std::memcmp(p, "HTTP/1.", 7) != 0 || p[7] < '0' || p[7] > '9' || p[8] != ' ') {
+            fail(Error::BadMessage);
+            return false;
+        }
+        message.versionMinor = p[7] - '0';
+        int statusCode = 0;
+        for (int i = 9; i < 12; i++) {
+            if (p[i] < '0' || p[i] > '9') {
+                fail(Error::BadMessage);
+                return false;
+            }
+            statusCode = statusCode * 10 + (p[i] - '0');
+        }
+        message.statusCode = statusCode;
+        p += 12;
+
+        const uint8_t* reason = p < end && *p == ' ' ? p + 1 : p;
+        const uint8_t* next = nullptr;
+        const uint8_t* reasonEnd = findLineEnd(reason, end, next);
+        if (!reasonEnd || (reason == p && reasonEnd != p)) {
+            fail(Error::BadMessage);
+            return false;
+        }
+        message.reason = view(reason, reasonEnd);
+        p = next;
+    }
+    if (!p) {
+        fail(Error::BadMessage);
+        return false;
+    }
+
+    // Fields up to the blank line. Obsolete line folding (a line starting
+    // with whitespace) and whitespace before the colon are rejected.
+    bool hasLength = false;
+    std::string_view transferEncoding;
+    for (;;) {
+        const uint8_t* next = skipLineEnd(p, end);
+        if (next) {
+            p = next;
+            break;
+        }
+        if (message.headerCount == HttpMessage::kMaxHeaders) {
+            fail(Error::HeadersTooLarge);
+            return false;
+        }
+
+        const uint8_t* name = p;
+        while (p < end && isToken(*p)) {
+            p++;
+        }
+        if (p == name || p == end || *p != ':') {
+            fail(Error::BadMessage);
+            return false;
+        }
+        const uint8_t* nameEnd = p++;
+        while (p < end && (*p == ' ' || *p == '\t')) {
+            p++;
+        }
+        const uint8_t* valueEnd = findLineEnd(p, end, next);
+        if (!valueEnd) {
+            fail(Error::BadMessage);
+            return false;
+        }
+        while (valueEnd > p && (valueEnd[-1] == ' ' || valueEnd[-1] == '\t')) {
+            valueEnd--;
+        }
+
+        HttpHeader& header = message.headers[message.headerCount++];
+        header.name = view(name, nameEnd);
+        header.value = view(p, valueEnd);
+        p = next;
+
+        if (equalsIgnoreCase(header.name, "Content-Length")) {
+            // Repeats must agree (RFC 9112 section 6.3)
+            uint64_t value = 0;
+            if (header.value.empty() || header.value.size() > 19 ||
+                !std::all_of(header.value.begin(), header.value.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+                fail(Error::BadMessage);
+                return false;
+            }
+            for (char c : header.value) {
+                value = value * 10 + static_cast<uint64_t>(c - '0');
+            }
+            if (hasLength && value != length) {
+                fail(Error::BadMessage);
+                return false;
+            }
+            hasLength = true;
+            length = value;
+        } else if (equalsIgnoreCase(header.name, "Transfer-Encoding")) {
+            transferEncoding = header.value;
+        }
+    }
+
+    // Body framing (RFC 9112 section 6.3): Transfer-Encoding wins over
+    // Content-Length; a request without either has no body
+    if (type_ == Type::Response && (isBodyless(message.statusCode) || headResponses_ > 0)) {
+        kind = BodyKind::None;
+    } else if (!transferEncoding.empty()) {
+        size_t comma = transferEncoding.rfind(',');
+        std::string_view last = trim(comma == std::string_view::npos ? transferEncoding : transferEncoding.substr(comma + 1));
+        if (equalsIgnoreCase(last, "chunked")) {
+            kind = BodyKind::Chunked;
+            message.chunked = true;
+        } else if (type_ == Type::Request) {
+            fail(Error::BadMessage);
+            return false;
+        } else {
+            kind = BodyKind::UntilClose;
+        }
+    } else if (hasLength) {
+        kind = BodyKind::Length;
+    } else {
+        kind = type_ == Type::Request ? BodyKind::None : BodyKind::UntilClose;
+    }
+    return true;
+}
+
+size_t HttpParser::parseChunks(const uint8_t* data, size_t size) {
+    size_t position = chunkOffset_ > 0 ? chunkOffset_ : headSize_;
+    for (;;) {
+        // chunk-size [; extensions] CRLF
+        const uint8_t* line = data + position;
+        size_t remaining = size - position;
+        const void* match = std::memchr(line, '\n', std::min(remaining, kMaxChunkLine));
+        if (!match) {
+            if (remaining >= kMaxChunkLine) {
+                fail(Error::BadMessage);
+            }
+            return 0;
+        }
+        size_t lineSize = static_cast<size_t>(static_cast<const uint8_t*>(match) - line);
+
+        uint64_t chunkSize = 0;
+        size_t digits = 0;
+        for (; digits < lineSize && hexValue(line[digits]) >= 0; digits++) {
+            if (digits == 15) {
+                fail(Error::BadMessage);
+                return 0;
+            }
+            chunkSize = chunkSize * 16 + static_cast<uint64_t>(hexValue(line[digits]));
+        }
+        uint8_t after = digits < lineSize ? line[digits] : '\n';
+        if (digits == 0 || (after != ';' && after != ' ' && after != '\t' && after != '\r' && after != '\n')) {
+            fail(Error::BadMessage);
+            return 0;
+        }
+        size_t dataStart = position + lineSize + 1;
+
+        if (chunkSize == 0) {
+            // Trailer fields (skipped), then a blank line
+            size_t trailer = dataStart;
+            for (;;) {
+                const void* lineEnd = std::memchr(data + trailer, '\n', size - trailer);
+                if (!lineEnd) {
+                    if (size - dataStart > maxHeadSize_) {
+                        fail(Error::HeadersTooLarge);
+                    }
+                    return 0;
+                }
+                size_t trailerSize = static_cast<size_t>(static_cast<const uint8_t*>(lineEnd) - (data + trailer));
+                bool blank = trailerSize == 0 || (trailerSize == 1 && data[trailer] == '\r');
+                trailer += trailerSize + 1;
+                if (blank) {
+                    return trailer;
+                }
+            }
+        }
+
+        if (chunkSize > maxBodySize_ - chunkBodySize_) {
+            fail(Error::BodyTooLarge);
+            return 0;
+        }
+        // The data, then its CRLF
+        if (size - dataStart < chunkSize + 1) {
+            return 0;
+        }
+        size_t dataEnd = dataStart + static_cast<size_t>(chunkSize);
+        size_t next;
+        if (data[dataEnd] == '\n') {
+            next = dataEnd + 1;
+        } else if (data[dataEnd] == '\r') {
+            if (dataEnd + 1 == size) {
+                return 0;
+            }
+            if (data[dataEnd + 1] != '\n') {
+                fail(Error::BadMessage);
+                return 0;
+            }
+            next = dataEnd + 2;
+        } else {
+            fail(Error::BadMessage);
+            return 0;
+        }
+
+        appendChunk(data + dataStart, static_cast<size_t>(chunkSize));
+        position = chunkOffset_ = next;
+    }
+}
+
+void HttpParser::appendChunk(const uint8_t* data, size_t length) {
+    if (chunkBodySize_ + length > chunkBody_.capacity()) {
+        size_t capacity = std::max(chunkBodySize_ + length, chunkBody_.capacity() * 2);
+        Buffer grown = BufferPool::shared().acquire(capacity);
+        if (chunkBodySize_ > 0) {
+            std::memcpy(grown.data(), chunkBody_.data(), chunkBodySize_);
+        }
+        chunkBody_ = std::move(grown);
+    }
+    if (length > 0) {
+        std::memcpy(chunkBody_.data() + chunkBodySize_, data, length);
+    }
+    chunkBodySize_ += length;
+    chunkBody_.setSize(chunkBodySize_);
+}
+
+void HttpParser::fail(Error error) {
+    error_ = error;
+}
+
+void HttpParser::finishMessage() {
+    scanned_ = 0;
+    headSize_ = 0;
+    chunkOffset_ = 0;
+    chunkBody_.reset();
+    chunkBodySize_ = 0;
+}
+
+// HttpBuilder
+
+HttpBuilder::HttpBuilder()
+    : block_(BufferPool::shared().acquire(kInitialHeadCapacity)), size_(0), valid_(true), hasLength_(false),
+      chunked_(false), bodyless_(false) {
+}
+
+HttpBuilder HttpBuilder::request(std::string_view method, std::string_view target) {
+    HttpBuilder builder;
+    const uint8_t* begin = reinterpret_cast<const uint8_t*>(target.data());
+    const uint8_t* end = begin + target.size();
+    bool visible = std::all_of(begin, end, [](uint8_t c) { return c > 0x20 && c != 0x7F; });
+    builder.valid_ = isTokenString(method) && !target.empty() && visible;
+    builder.append(method);
+    builder.append(" ");
+    builder.append(target);
+    builder.append(" HTTP/1.1\r\n");
+    return builder;
+}
+
+HttpBuilder HttpBuilder::response(int statusCode, std::string_view reason) {
+    HttpBuilder builder;
+    if (reason.empty()) {
+        reason = reasonPhrase(statusCode);
+    }
+    const uint8_t* begin = reinterpret_cast<const uint8_t*>(reason.data());
+    const uint8_t* end = begin + reason.size();
+    builder.valid_ = statusCode >= 100 && statusCode <= 999 && findControl(begin, end) == end;
+    builder.bodyless_ = isBodyless(statusCode);
+
+    char status[4] = {'0', '0', '0', ' '};
+    for (int i = 2, code = statusCode; i >= 0 && code > 0; i--, code /= 10) {
+        status[i] = static_cast<char>('0' + code % 10);
+    }
+    builder.append("HTTP/1.1 ");
+    builder.append(std::string_view(status, sizeof(status)));
+    builder.append(reason);
+    builder.append("\r\n");
+    return builder;
+}
+
+HttpBuilder& HttpBuilder::header(std::string_view name, std::string_view value) {
+    const uint8_t* begin = reinterpret_cast<const uint8_t*>(value.data());
+    const uint8_t* end = begin + value.size();
+    // Tabs are the only control byte a value may hold
+    while (begin < end) {
+        const uint8_t* control = findControl(begin, end);
+        if (control == end) {
+            break;
+        }
+        if (*control != '\t') {
+            valid_ = false;
+            break;
+        }
+        begin = control + 1;
+    }
+    if (!isTokenString(name)) {
+        valid_ = false;
+    }
+
+    if (equalsIgnoreCase(name, "Content-Length")) {
+        hasLength_ = true;
+    } else if (equalsIgnoreCase(name, "Transfer-Encoding")) {
+        chunked_ = true;
+    }
+    append(name);
+    append(": ");
+    append(value);
+    append("\r\n");
+    return *this;
+}
+
+HttpBuilder& HttpBuilder::contentLength(uint64_t length) {
+    char digits[20];
+    size_t count = 0;
+    do {
+        digits[sizeof(digits) - 1 - count++] = static_cast<char>('0' + length % 10);
+        length /= 10;
+    } while (length > 0);
+    return header("Content-Length", std::string_view(digits + sizeof(digits) - count, count));
+}
+
+HttpBuilder& HttpBuilder::chunked() {
+    return header("Transfer-Encoding", "chunked");
+}
+
+BufferView HttpBuilder::finish() {
+    if (!valid_ || !block_) {
+        return BufferView();
+    }
+    append("\r\n");
+    Buffer block = std::move(block_);
+    block.setSize(size_);
+    return BufferView(std::move(block), 0, size_);
+}
+
+bool HttpBuilder::send(TcpConnection& connection, const BufferView& body) {
+    if (!hasLength_ && !chunked_ && !bodyless_) {
+        contentLength(body.size());
+    }
+    BufferView head = finish();
+    if (head.empty()) {
+        return false;
+    }
+    return connection.send(head) && (body.empty() || connection.send(body));
+}
+
+bool HttpBuilder::sendChunk(TcpConnection& connection, const BufferView& data) {
+    if (data.empty()) {
+        return true; // An empty chunk would end the body
+    }
+    char line[20];
+    size_t count = 0;
+    for (size_t length = data.size(); length > 0; length >>= 4) {
+        count++;
+    }
+    for (size_t i = 0, length = data.size(); i < count; i++, length >>= 4) {
+        line[count - 1 - i] = "0123456789abcdef"[length & 0xF];
+    }
+    line[count++] = '\r';
+    line[count++] = '\n';
+
+    Buffer header = BufferPool::shared().acquire(count);
+    std::memcpy(header.data(), line, count);
+    header.setSize(count);
+    Buffer trailer = BufferPool::shared().acquire(2);
+    std::memcpy(trailer.data(), "\r\n", 2);
+    trailer.setSize(2);
+    return connection.send(BufferView(std::move(header))) && connection.send(data) &&
+           connection.send(BufferView(std::move(trailer)));
+}
+
+BufferView HttpBuilder::lastChunk() {
+    static const char kLastChunk[] = "0\r\n\r\n";
+    Buffer block = BufferPool::shared().acquire(sizeof(kLastChunk) - 1);
+    std::memcpy(block.data(), kLastChunk, sizeof(kLastChunk) - 1);
+    block.setSize(sizeof(kLastChunk) - 1);
+    return BufferView(std::move(block));
+}
+
+std::string_view HttpBuilder::reasonPhrase(int statusCode) {
+    switch (statusCode) {
+        case 100: return "Continue";
+        case 101: return "Switching Protocols";
+        case 200: return "OK";
+        case 201: return "Created";
+        case 202: return "Accepted";
+        case 204: return "No Content";
+        case 206: return "Partial Content";
+        case 301: return "Moved Permanently";
+        case 302: return "Found";
+        case 303: return "See Other";
+        case 304: return "Not Modified";
+        case 307: return "Temporary Redirect";
+        case 308: return "Permanent Redirect";
+        case 400: return "Bad Request";
+        case 401: return "Unauthorized";
+        case 403: return "Forbidden";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 408: return "Request Timeout";
+        case 409: return "Conflict";
+        case 411: return "Length Required";
+        case 413: return "Content Too Large";
+        case 414: return "URI Too Long";
+        case 415: return "Unsupported Media Type";
+        case 426: return "Upgrade Required";
+        case 429: return "Too Many Requests";
+        case 431: return "Request Header Fields Too Large";
+        case 500: return "Internal Server Error";
+        case 501: return "Not Implemented";
+        case 502: return "Bad Gateway";
+        case 503: return "Service Unavailable";
+        case 504: return "Gateway Timeout";
+        default: return "Unknown";
+    }
+}
+
+void HttpBuilder::append(std::string_view text) {
+    if (!block_) {
+        return; // Already finished
+    }
+    if (size_ + text.size() > block_.capacity()) {
+        Buffer grown = BufferPool::shared().acquire(std::max(size_ + text.size(), block_.capacity() * 2));
+        std::memcpy(grown.data(), block_.data(), size_);
+        block_ = std::move(grown);
+    }
+    std::memcpy(block_.data() + size_, text.data(), text.size());
+    size_ += text.size();
+}
+
+} // namespace tcp
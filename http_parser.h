@@ -0,0 +1,170 @@
+#pragma once
+
+#include "tcp_utils.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace tcp {
+
+// Forward declarations
+class TcpConnection;
+
+struct HttpHeader {
+    std::string_view name;
+    std::string_view value;
+};
+
+// One parsed request or response. The strings view the receive block and
+// are valid for the duration of the callback; the body may be retained.
+struct HttpMessage {
+    static constexpr size_t kMaxHeaders = 64;
+
+    std::string_view method; // Requests
+    std::string_view target;
+    int statusCode = 0;      // Responses
+    std::string_view reason;
+    int versionMinor = 1;    // HTTP/1.x
+    HttpHeader headers[kMaxHeaders];
+    size_t headerCount = 0;
+    bool chunked = false;
+    BufferView body;         // Already dechunked
+
+    std::string_view header(std::string_view name) const; // Case-insensitive; empty when absent
+    bool keepAlive() const;  // From the version and the Connection header
+};
+
+// Streaming HTTP/1.1 parser in the style of picohttpparser. Heads are
+// scanned 16 bytes at a time for line ends and control bytes, fields become
+// views into the receive block, and every pipelined message in a read is
+// delivered. Content-Length bodies are slices of the input; chunked bodies
+// are gathered into a pooled block. Only an incomplete message is carried
+// between reads. Not thread-safe; use one parser per connection.
+class HttpParser : public MessageFramer {
+public:
+    enum class Type {
+        Request,
+        Response
+    };
+
+    // Fails the stream until reset(); getStatusCode() is the status to answer with
+    enum class Error {
+        None,
+        BadMessage,      // Malformed start line, field or body framing (400)
+        HeadersTooLarge, // Head over the limit or over kMaxHeaders fields (431)
+        BodyTooLarge     // Body over the limit (413)
+    };
+
+    using MessageCallback = std::function<void(const HttpMessage& message)>;
+
+    static constexpr size_t kDefaultMaxHeadSize = 64 * 1024;
+    static constexpr size_t kDefaultMaxBodySize = 16 * 1024 * 1024;
+
+    explicit HttpParser(Type type = Type::Request);
+
+    // MessageFramer: HTTP delimits itself, so frame() passes data through
+    // (build messages with HttpBuilder); unframe() splits the stream into
+    // whole messages as they were on the wire
+    std::vector<uint8_t> frame(const std::vector<uint8_t>& data) override;
+    std::vector<std::vector<uint8_t>> unframe(const std::vector<uint8_t>& data) override;
+    bool isComplete(const std::vector<uint8_t>& data) override;
+    void reset() override;
+
+    // Streaming decoding; returns the number of messages delivered. The
+    // ByteView overload copies what it keeps.
+    size_t parse(const BufferView& data, const MessageCallback& onMessage);
+    size_t parse(const ByteView& data, const MessageCallback& onMessage);
+    size_t finish(const MessageCallback& onMessage); // At end of stream: a response whose body runs to the close
+
+    // The next response answers a HEAD request: no body, whatever its
+    // headers say. Call once per HEAD sent.
+    void expectHeadResponse() { headResponses_++; }
+
+    // Limits
+    void setMaxHeadSize(size_t maxHeadSize) { maxHeadSize_ = maxHeadSize; }
+    size_t getMaxHeadSize() const { return maxHeadSize_; }
+    void setMaxBodySize(size_t maxBodySize) { maxBodySize_ = maxBodySize; }
+    size_t getMaxBodySize() const { return maxBodySize_; }
+    bool hasError() const { return error_ != Error::None; }
+    Error getError() const { return error_; }
+    int getStatusCode() const; // 400, 413 or 431; 0 without an error
+
+    Type getType() const { return type_; }
+
+private:
+    enum class BodyKind {
+        None,
+        Length,
+        Chunked,
+        UntilClose
+    };
+
+    Type type_;
+    size_t maxHeadSize_;
+    size_t maxBodySize_;
+    Error error_;
+    size_t headResponses_;
+
+    // Incomplete message carried over from earlier reads
+    Buffer carry_;
+    size_t carrySize_;
+
+    // Message in progress, offsets from its first byte. The message is
+    // reused so its field table isn't cleared for every request.
+    HttpMessage message_;
+    size_t scanned_;     // Searched for the end of the head without finding it
+    size_t headSize_;    // 0 until the head is complete
+    size_t chunkOffset_; // Next chunk-size line
+    Buffer chunkBody_;
+    size_t chunkBodySize_;
+
+    template <typename Emit>
+    size_t dispatch(const BufferView& data, bool atEnd, Emit&& emit); // emit(message, raw bytes, raw size)
+    size_t findHeadEnd(const uint8_t* data, size_t size);
+    bool parseHead(const uint8_t* data, size_t size, HttpMessage& message, BodyKind& kind, uint64_t& length);
+    size_t parseChunks(const uint8_t* data, size_t size); // Whole message length, or 0 while incomplete
+    void appendChunk(const uint8_t* data, size_t length);
+    void fail(Error error);
+    void finishMessage();
+};
+
+// Writes a request or response head into one pooled block, ready for
+// TcpConnection::send(). On queued connections a head and the body views
+// sent right after it leave in one gathered write. Fields whose name or
+// value could split the message (CR, LF, a bad name) invalidate the
+// builder: finish() then returns an empty view and send() fails.
+class HttpBuilder {
+public:
+    static HttpBuilder request(std::string_view method, std::string_view target);
+    static HttpBuilder response(int statusCode, std::string_view reason = std::string_view()); // Standard phrase when empty
+
+    HttpBuilder& header(std::string_view name, std::string_view value);
+    HttpBuilder& contentLength(uint64_t length);
+    HttpBuilder& chunked(); // Follow with sendChunk() and lastChunk()
+
+    bool isValid() const { return valid_; }
+    bool hasFraming() const { return hasLength_ || chunked_; } // Content-Length or Transfer-Encoding given
+    BufferView finish(); // Ends the head; the builder is spent
+    bool send(TcpConnection& connection, const BufferView& body = BufferView()); // Adds Content-Length unless framed
+
+    // Chunked transfer coding: the data is shared, not copied
+    static bool sendChunk(TcpConnection& connection, const BufferView& data);
+    static BufferView lastChunk();
+
+    static std::string_view reasonPhrase(int statusCode);
+
+private:
+    HttpBuilder();
+
+    Buffer block_;
+    size_t size_;
+    bool valid_;
+    bool hasLength_;
+    bool chunked_;
+    bool bodyless_; // 1xx, 204 and 304 responses
+
+    void append(std::string_view text);
+};
+
+} // namespace tcp
@@ -0,0 +1,311 @@
+#include "io_ring.h"
+
+#if defined(TCP_IO_URING) && defined(__linux__)
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace tcp {
+
+namespace {
+
+int setupRing(unsigned entries, io_uring_params& params) {
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+}
+
+int registerRing(int fd, unsigned opcode, const void* arg, unsigned count) {
+    int result = static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, count));
+    return result < 0 ? -errno : result;
+}
+
+} // namespace
+
+IoRing::IoRing()
+    : fd_(-1), features_(0), sqPoll_(false),
+      sqRing_(MAP_FAILED), sqRingSize_(0), sqHead_(nullptr), sqTail_(nullptr), sqFlags_(nullptr),
+      sqMask_(0), sqEntries_(0), sqes_(nullptr), sqesSize_(0), sqeTail_(0),
+      cqRing_(MAP_FAILED), cqRingSize_(0), cqHead_(nullptr), cqTail_(nullptr), cqMask_(0), cqes_(nullptr),
+      bufferRing_(MAP_FAILED), bufferRingSize_(0), syscallCount_(0) {
+    std::memset(supported_, 0, sizeof(supported_));
+}
+
+IoRing::~IoRing() {
+    close();
+}
+
+bool IoRing::open(const Config& config) {
+    close();
+
+    // Newer flags first; older kernels reject what they don't know
+    io_uring_params params;
+    unsigned optional[] = {IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN, IORING_SETUP_SUBMIT_ALL, 0};
+    for (unsigned flags : optional) {
+        std::memset(&params, 0, sizeof(params));
+        params.flags = IORING_SETUP_CLAMP | flags;
+        if (config.sqPoll) {
+            // Task work runs on the poller thread, so cooperative runs don't apply
+            params.flags = (params.flags & ~IORING_SETUP_COOP_TASKRUN) | IORING_SETUP_SQPOLL;
+            params.sq_thread_idle = config.sqPollIdleMs;
+        }
+        fd_ = setupRing(config.entries, params);
+        if (fd_ >= 0 || errno != EINVAL) {
+            break;
+        }
+    }
+    if (fd_ < 0) {
+        return false;
+    }
+    features_ = params.features;
+    sqPoll_ = config.sqPoll;
+
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (features_ & IORING_FEAT_SINGLE_MMAP) {
+        sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+    }
+
+    sqRing_ = ::mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+    if (sqRing_ == MAP_FAILED) {
+        close();
+        return false;
+    }
+    if (features_ & IORING_FEAT_SINGLE_MMAP) {
+        cqRing_ = sqRing_;
+    } else {
+        cqRing_ = ::mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+        if (cqRing_ == MAP_FAILED) {
+            close();
+            return false;
+        }
+    }
+    sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = ::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        close();
+        return false;
+    }
+    sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    uint8_t* sq = static_cast<uint8_t*>(sqRing_);
+    sqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqFlags_ = reinterpret_cast<unsigned*>(sq + params.sq_off.flags);
+    sqMask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqEntries_ = params.sq_entries;
+    sqeTail_ = *sqTail_;
+
+    // Entries are used in ring order, so the index array maps each slot to itself
+    unsigned* array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    for (unsigned i = 0; i < sqEntries_; i++) {
+        array[i] = i;
+    }
+
+    uint8_t* cq = static_cast<uint8_t*>(cqRing_);
+    cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    probe();
+    return true;
+}
+
+void IoRing::close() {
+    if (bufferRing_ != MAP_FAILED) {
+        ::munmap(bufferRing_, bufferRingSize_);
+        bufferRing_ = MAP_FAILED;
+    }
+    if (sqes_) {
+        ::munmap(sqes_, sqesSize_);
+        sqes_ = nullptr;
+    }
+    if (cqRing_ != MAP_FAILED && cqRing_ != sqRing_) {
+        ::munmap(cqRing_, cqRingSize_);
+    }
+    cqRing_ = MAP_FAILED;
+    if (sqRing_ != MAP_FAILED) {
+        ::munmap(sqRing_, sqRingSize_);
+        sqRing_ = MAP_FAILED;
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    std::memset(supported_, 0, sizeof(supported_));
+}
+
+bool IoRing::supports(uint8_t opcode) const {
+    return opcode < IORING_OP_LAST && supported_[opcode];
+}
+
+io_uring_sqe* IoRing::getSqe() {
+    if (getFreeSqes() == 0) {
+        return nullptr;
+    }
+    io_uring_sqe* sqe = &sqes_[sqeTail_ & sqMask_];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqeTail_++;
+    return sqe;
+}
+
+unsigned IoRing::getFreeSqes() const {
+    return sqEntries_ - (sqeTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE));
+}
+
+unsigned IoRing::flush() {
+    __atomic_store_n(sqTail_, sqeTail_, __ATOMIC_RELEASE);
+    return sqeTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+}
+
+int IoRing::submit() {
+    unsigned pending = flush();
+    if (sqPoll_) {
+        // The poller thread takes them; it only needs a nudge when asleep
+        if (pending > 0 && (__atomic_load_n(sqFlags_, __ATOMIC_ACQUIRE) & IORING_SQ_NEED_WAKEUP)) {
+            enter(0, 0, IORING_ENTER_SQ_WAKEUP, nullptr, 0);
+        }
+        return static_cast<int>(pending);
+    }
+    return pending > 0 ? enter(pending, 0, 0, nullptr, 0) : 0;
+}
+
+int IoRing::wait(unsigned pending, int timeoutMs) {
+    unsigned flags = 0;
+    if (sqPoll_) {
+        if (pending > 0 && (__atomic_load_n(sqFlags_, __ATOMIC_ACQUIRE) & IORING_SQ_NEED_WAKEUP)) {
+            flags |= IORING_ENTER_SQ_WAKEUP;
+        }
+        pending = 0;
+    }
+
+    // Completions already posted (or no wait at all) need no entry unless
+    // there is something to submit, or completions the kernel held back
+    if (hasCompletions() || timeoutMs == 0) {
+        if (__atomic_load_n(sqFlags_, __ATOMIC_ACQUIRE) & IORING_SQ_CQ_OVERFLOW) {
+            flags |= IORING_ENTER_GETEVENTS;
+        }
+        return pending > 0 || flags != 0 ? enter(pending, 0, flags, nullptr, 0) : 0;
+    }
+
+    flags |= IORING_ENTER_GETEVENTS;
+    if (timeoutMs < 0) {
+        return enter(pending, 1, flags, nullptr, 0);
+    }
+
+    struct __kernel_timespec timeout;
+    timeout.tv_sec = timeoutMs / 1000;
+    timeout.tv_nsec = (timeoutMs % 1000) * 1000000LL;
+    io_uring_getevents_arg arg;
+    std::memset(&arg, 0, sizeof(arg));
+    arg.ts = reinterpret_cast<uint64_t>(&timeout);
+    return enter(pending, 1, flags | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+}
+
+int IoRing::enter(unsigned toSubmit, unsigned minComplete, unsigned flags, const void* arg, size_t argSize) {
+    syscallCount_.fetch_add(1, std::memory_order_relaxed);
+    int result = static_cast<int>(::syscall(__NR_io_uring_enter, fd_, toSubmit, minComplete, flags, arg, argSize));
+    if (result >= 0) {
+        return result;
+    }
+
+    // A timeout, a signal, or a full completion queue still submitted what it could
+    int error = errno;
+    return error == ETIME || error == EINTR || error == EBUSY || error == EAGAIN ? 0 : -error;
+}
+
+bool IoRing::registerFiles(unsigned count) {
+    std::vector<int> files(count, -1);
+    return registerRing(fd_, IORING_REGISTER_FILES, files.data(), count) == 0;
+}
+
+bool IoRing::updateFile(unsigned slot, int fd) {
+    io_uring_files_update update;
+    std::memset(&update, 0, sizeof(update));
+    update.offset = slot;
+    update.fds = reinterpret_cast<uint64_t>(&fd);
+    syscallCount_.fetch_add(1, std::memory_order_relaxed);
+    return registerRing(fd_, IORING_REGISTER_FILES_UPDATE, &update, 1) == 1;
+}
+
+io_uring_buf_ring* IoRing::registerBufferRing(uint16_t groupId, unsigned entries) {
+    if (bufferRing_ != MAP_FAILED || entries == 0 || (entries & (entries - 1)) != 0) {
+        return nullptr;
+    }
+
+    // The kernel wants page-aligned memory it can pin
+    bufferRingSize_ = entries * sizeof(io_uring_buf);
+    bufferRing_ = ::mmap(nullptr, bufferRingSize_, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (bufferRing_ == MAP_FAILED) {
+        return nullptr;
+    }
+
+    io_uring_buf_reg registration;
+    std::memset(&registration, 0, sizeof(registration));
+    registration.ring_addr = reinterpret_cast<uint64_t>(bufferRing_);
+    registration.ring_entries = entries;
+    registration.bgid = groupId;
+    if (registerRing(fd_, IORING_REGISTER_PBUF_RING, &registration, 1) != 0) {
+        ::munmap(bufferRing_, bufferRingSize_);
+        bufferRing_ = MAP_FAILED;
+        return nullptr;
+    }
+    return static_cast<io_uring_buf_ring*>(bufferRing_);
+}
+
+void IoRing::unregisterBufferRing(uint16_t groupId) {
+    if (bufferRing_ == MAP_FAILED) {
+        return;
+    }
+    io_uring_buf_reg registration;
+    std::memset(&registration, 0, sizeof(registration));
+    registration.bgid = groupId;
+    registerRing(fd_, IORING_UNREGISTER_PBUF_RING, &registration, 1);
+    ::munmap(bufferRing_, bufferRingSize_);
+    bufferRing_ = MAP_FAILED;
+}
+
+int IoRing::cancelFile(int fd, bool fixed) {
+    io_uring_sync_cancel_reg cancel;
+    std::memset(&cancel, 0, sizeof(cancel));
+    cancel.fd = fd;
+    cancel.flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL | (fixed ? IORING_ASYNC_CANCEL_FD_FIXED : 0);
+    cancel.timeout.tv_sec = -1;
+    cancel.timeout.tv_nsec = -1;
+    syscallCount_.fetch_add(1, std::memory_order_relaxed);
+    int result = registerRing(fd_, IORING_REGISTER_SYNC_CANCEL, &cancel, 1);
+    return result == -ENOENT ? 0 : result;
+}
+
+int IoRing::cancelAll() {
+    io_uring_sync_cancel_reg cancel;
+    std::memset(&cancel, 0, sizeof(cancel));
+    cancel.fd = -1;
+    cancel.flags = IORING_ASYNC_CANCEL_ANY;
+    cancel.timeout.tv_sec = -1;
+    cancel.timeout.tv_nsec = -1;
+    syscallCount_.fetch_add(1, std::memory_order_relaxed);
+    int result = registerRing(fd_, IORING_REGISTER_SYNC_CANCEL, &cancel, 1);
+    return result == -ENOENT ? 0 : result;
+}
+
+void IoRing::probe() {
+    size_t size = sizeof(io_uring_probe) + IORING_OP_LAST * sizeof(io_uring_probe_op);
+    std::vector<uint8_t> storage(size, 0);
+    io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(storage.data());
+    if (registerRing(fd_, IORING_REGISTER_PROBE, probe, IORING_OP_LAST) != 0) {
+        return;
+    }
+    for (unsigned i = 0; i < probe->ops_len && i < IORING_OP_LAST; i++) {
+        supported_[i] = (probe->ops[i].flags & IO_URING_OP_SUPPORTED) != 0;
+    }
+}
+
+} // namespace tcp
+
+#endif // TCP_IO_URING
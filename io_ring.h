@@ -0,0 +1,120 @@
+#pragma once
+
+// io_uring rings for the event loop, built with TCP_IO_URING (CMake -DTCP_IO_URING=ON)
+#if defined(TCP_IO_URING) && defined(__linux__)
+
+#include <linux/io_uring.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace tcp {
+
+// One submission/completion queue pair shared with the kernel. The rings
+// are mapped straight from the kernel ABI, so no liburing is needed. Not
+// thread-safe: the owner serializes submissions, and reaps completions
+// on one thread.
+class IoRing {
+public:
+    struct Config {
+        unsigned entries = 1024;    // Submission queue; completions get twice as many
+        bool sqPoll = false;        // A kernel thread polls the submission queue
+        unsigned sqPollIdleMs = 50; // ... and sleeps after this long without work
+    };
+
+    IoRing();
+    ~IoRing();
+
+    // Non-copyable
+    IoRing(const IoRing&) = delete;
+    IoRing& operator=(const IoRing&) = delete;
+
+    bool open(const Config& config);
+    void close();
+    bool isOpen() const { return fd_ >= 0; }
+    uint32_t getFeatures() const { return features_; }
+    bool isSqPoll() const { return sqPoll_; }
+    bool supports(uint8_t opcode) const; // From the kernel's probe
+
+    // Submission. getSqe() returns a zeroed entry, or null while the queue
+    // is full (submit() makes room). Entries reach the kernel in order.
+    io_uring_sqe* getSqe();
+    unsigned getFreeSqes() const;
+    unsigned getEntries() const { return sqEntries_; }
+    int submit(); // Entries submitted, or -errno
+    // For owners that wait without holding their lock: flush() publishes
+    // the prepared entries under it and returns how many the kernel hasn't
+    // taken; wait() submits those and waits up to timeoutMs (-1 = forever)
+    // for a completion, returning at once when completions are waiting.
+    unsigned flush();
+    int wait(unsigned toSubmit, int timeoutMs);
+
+    // Completion. Calls handler(const io_uring_cqe&) for each one ready,
+    // and returns how many there were.
+    template <typename Handler>
+    unsigned reap(Handler&& handler) {
+        unsigned head = *cqHead_;
+        unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+        for (unsigned i = head; i != tail; i++) {
+            handler(cqes_[i & cqMask_]);
+        }
+        __atomic_store_n(cqHead_, tail, __ATOMIC_RELEASE);
+        return tail - head;
+    }
+    bool hasCompletions() const { return *cqHead_ != __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE); }
+
+    // Registration
+    bool registerFiles(unsigned count); // Sparse table of count empty slots
+    bool updateFile(unsigned slot, int fd); // fd -1 empties the slot
+    io_uring_buf_ring* registerBufferRing(uint16_t groupId, unsigned entries); // Power of two
+    void unregisterBufferRing(uint16_t groupId);
+
+    // Cancels every request on fd (a slot with fixed) and waits until they
+    // are done: their completions are posted when this returns
+    int cancelFile(int fd, bool fixed);
+    int cancelAll();
+
+    // System calls made on the I/O path so far: io_uring_enter, and the
+    // per-socket file updates and cancels (setup and probing leave it alone)
+    uint64_t getSyscallCount() const { return syscallCount_.load(std::memory_order_relaxed); }
+
+private:
+    int fd_;
+    uint32_t features_;
+    bool sqPoll_;
+
+    // Submission queue
+    void* sqRing_;
+    size_t sqRingSize_;
+    unsigned* sqHead_;
+    unsigned* sqTail_;
+    unsigned* sqFlags_;
+    unsigned sqMask_;
+    unsigned sqEntries_;
+    io_uring_sqe* sqes_;
+    size_t sqesSize_;
+    unsigned sqeTail_; // Prepared, published to *sqTail_ on submit
+
+    // Completion queue, in the same mapping as the submission queue when
+    // the kernel has IORING_FEAT_SINGLE_MMAP
+    void* cqRing_;
+    size_t cqRingSize_;
+    unsigned* cqHead_;
+    unsigned* cqTail_;
+    unsigned cqMask_;
+    io_uring_cqe* cqes_;
+
+    // Registered buffer ring (one group is all the loop needs)
+    void* bufferRing_;
+    size_t bufferRingSize_;
+
+    uint8_t supported_[IORING_OP_LAST];
+    std::atomic<uint64_t> syscallCount_;
+
+    int enter(unsigned toSubmit, unsigned minComplete, unsigned flags, const void* arg, size_t argSize);
+    void probe();
+};
+
+} // namespace tcp
+
+#endif // TCP_IO_URING
@@ -0,0 +1,519 @@
+#include "load_generator.h"
+#include "tcp_utils.h"
+#include "ssl_context.h"
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <random>
+
+#ifndef _WIN32
+#include <netinet/tcp.h>
+#endif
+
+namespace tcp {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+void closeSocketHandle(socket_t socket) {
+#ifdef _WIN32
+    closesocket(socket);
+#else
+    ::close(socket);
+#endif
+}
+
+bool isConnectInProgress() {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EINPROGRESS;
+#endif
+}
+
+void prepareSocket(socket_t socket) {
+#ifdef _WIN32
+    u_long mode = 1;
+    ioctlsocket(socket, FIONBIO, &mode);
+#else
+    fcntl(socket, F_SETFL, fcntl(socket, F_GETFL, 0) | O_NONBLOCK);
+#endif
+    int noDelay = 1;
+    setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+}
+
+} // namespace
+
+// One logical client. Loop thread only, like the worker that owns it.
+struct LoadGenerator::Session {
+    Worker* worker = nullptr;
+    std::shared_ptr<TcpConnection> connection;
+    socket_t connecting = INVALID_SOCKET;
+    TimerId connectTimer = 0;
+    Clock::time_point connectStarted;
+    uint64_t generation = 0; // Bumped by every attempt, so stale timers are ignored
+    bool recycling = false;  // Closed by churn; reconnect at once
+    Clock::time_point nextSend;
+    std::deque<Clock::time_point> inFlight; // Send times of unanswered requests
+    DelimiterFramer lineFramer{"\r\n", false};
+    LengthPrefixedFramer lengthFramer;
+};
+
+// Sessions of one event loop, whose timers run on that loop
+struct LoadGenerator::Worker {
+    EventLoop* loop = nullptr;
+    std::vector<std::unique_ptr<Session>> sessions;
+    std::mt19937 random;
+
+    // Uniform in [low, high) times base
+    Clock::duration jitter(Clock::duration base, double low, double high) {
+        std::uniform_real_distribution<double> distribution(low, high);
+        return std::chrono::duration_cast<Clock::duration>(base * distribution(random));
+    }
+};
+
+struct LoadGenerator::Totals {
+    Counter connects;
+    Counter connectFailures;
+    Counter disconnects;
+    Counter messagesSent;
+    Counter messagesReceived;
+    Counter deferredSends;
+    Gauge activeSessions;
+    LatencyHistogram latency;
+    LatencyHistogram connectLatency;
+};
+
+LoadGenerator::LoadGenerator(Config config)
+    : config_(std::move(config)), address_(), metrics_(std::make_shared<ConnectionMetrics>()),
+      totals_(new Totals()), running_(false), stopping_(false), finished_(false) {
+    if (config_.serverName.empty()) {
+        config_.serverName = config_.host;
+    }
+}
+
+LoadGenerator::~LoadGenerator() {
+    stop();
+}
+
+bool LoadGenerator::start() {
+    if (running_ || config_.port == 0) {
+        return false;
+    }
+
+    if (!TcpSocket::resolveAddress(config_.host, ip_)) {
+        Logger::error("Load generator: failed to resolve {}", config_.host);
+        return false;
+    }
+    SocketAddress::parse(ip_, config_.port, address_);
+
+    // Every session sends the same framed payload from one pooled block
+    std::vector<uint8_t> payload(config_.messageSize, 'x');
+    std::vector<uint8_t> framed = config_.framing == Framing::Line
+        ? DelimiterFramer("\r\n").frame(payload)
+        : LengthPrefixedFramer().frame(payload);
+    Buffer block = BufferPool::shared().acquire(framed.size());
+    std::memcpy(block.data(), framed.data(), framed.size());
+    block.setSize(framed.size());
+    request_ = BufferView(block);
+
+    loops_.reset(new EventLoopGroup(config_.ioThreads));
+    if (!loops_->start()) {
+        loops_.reset();
+        return false;
+    }
+
+    workers_.clear();
+    for (size_t i = 0; i < loops_->size(); i++) {
+        std::unique_ptr<Worker> worker(new Worker());
+        worker->loop = loops_->getLoop(i);
+        worker->random.seed(static_cast<uint32_t>(std::random_device{}() + i));
+        workers_.push_back(std::move(worker));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = false;
+        finished_ = false;
+    }
+    running_ = true; // Before the first timer can fire
+
+    // Ramp-up: connects are spread evenly over the ramp, round-robin over loops
+    startTime_ = Clock::now();
+    for (size_t i = 0; i < config_.sessions; i++) {
+        Worker& worker = *workers_[i % workers_.size()];
+        std::unique_ptr<Session> session(new Session());
+        session->worker = &worker;
+        auto offset = std::chrono::duration_cast<Clock::duration>(config_.rampUp) * i / config_.sessions;
+        schedule(*session, offset, TimerKind::Connect);
+        worker.sessions.push_back(std::move(session));
+    }
+
+    timerThread_ = std::thread(&LoadGenerator::timerLoop, this);
+    return true;
+}
+
+void LoadGenerator::stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wakeup_.notify_all();
+    if (timerThread_.joinable()) {
+        timerThread_.join();
+    }
+
+    // Sessions are closed on their own loops before the loops stop
+    std::vector<std::future<void>> closed;
+    for (auto& worker : workers_) {
+        auto done = std::make_shared<std::promise<void>>();
+        closed.push_back(done->get_future());
+        Worker* target = worker.get();
+        worker->loop->post([this, target, done]() {
+            closeSessions(*target);
+            done->set_value();
+        });
+    }
+    for (auto& future : closed) {
+        future.wait_for(std::chrono::seconds(5));
+    }
+
+    loops_->stop();
+}
+
+void LoadGenerator::wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    wakeup_.wait(lock, [this]() { return finished_ || stopping_ || !running_; });
+}
+
+LoadGenerator::Report LoadGenerator::getTotals() const {
+    return takeReport();
+}
+
+LoadGenerator::Report LoadGenerator::takeReport() const {
+    Report report;
+    report.elapsedSeconds = std::chrono::duration<double>(Clock::now() - startTime_).count();
+    report.intervalSeconds = report.elapsedSeconds;
+    report.activeSessions = static_cast<size_t>(std::max<int64_t>(0, totals_->activeSessions.value()));
+    report.connects = totals_->connects.value();
+    report.connectFailures = totals_->connectFailures.value();
+    report.disconnects = totals_->disconnects.value();
+    report.messagesSent = totals_->messagesSent.value();
+    report.messagesReceived = totals_->messagesReceived.value();
+    report.deferredSends = totals_->deferredSends.value();
+    report.bytesSent = metrics_->bytesSent.value();
+    report.bytesReceived = metrics_->bytesReceived.value();
+    report.latency = totals_->latency.snapshot();
+    report.connectLatency = totals_->connectLatency.snapshot();
+    return report;
+}
+
+void LoadGenerator::timerLoop() {
+    Report previous;
+    bool reporting = config_.reportInterval.count() > 0;
+    auto nextReport = startTime_ + config_.reportInterval;
+    auto deadline = startTime_ + config_.duration;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+        // Wakes for the next report or the end of a timed run, whichever is first
+        auto wakeAt = reporting ? nextReport : Clock::time_point::max();
+        if (config_.duration.count() > 0 && !finished_) {
+            wakeAt = std::min(wakeAt, deadline);
+        }
+        if (wakeAt == Clock::time_point::max()) {
+            wakeup_.wait(lock, [this]() { return stopping_; });
+        } else {
+            wakeup_.wait_until(lock, wakeAt, [this]() { return stopping_; });
+        }
+        if (stopping_) {
+            break;
+        }
+        lock.unlock();
+
+        auto now = Clock::now();
+        if (reporting && now >= nextReport) {
+            Report totals = takeReport();
+            Report interval = totals;
+            interval.intervalSeconds = totals.elapsedSeconds - previous.elapsedSeconds;
+            interval.connects -= previous.connects;
+            interval.connectFailures -= previous.connectFailures;
+            interval.disconnects -= previous.disconnects;
+            interval.messagesSent -= previous.messagesSent;
+            interval.messagesReceived -= previous.messagesReceived;
+            interval.deferredSends -= previous.deferredSends;
+            interval.bytesSent -= previous.bytesSent;
+            interval.bytesReceived -= previous.bytesReceived;
+            interval.latency = totals.latency.since(previous.latency);
+            interval.connectLatency = totals.connectLatency.since(previous.connectLatency);
+            previous = std::move(totals);
+
+            nextReport += config_.reportInterval;
+            if (nextReport <= now) {
+                nextReport = now + config_.reportInterval;
+            }
+            if (onReport_) {
+                onReport_(interval);
+            }
+        }
+
+        lock.lock();
+        if (config_.duration.count() > 0 && !finished_ && now >= deadline) {
+            finished_ = true;
+            wakeup_.notify_all();
+        }
+    }
+}
+
+TimerId LoadGenerator::schedule(Session& session, Clock::duration delay, TimerKind kind) {
+    Session* target = &session;
+    uint64_t generation = session.generation;
+    return session.worker->loop->runAfter(std::chrono::ceil<std::chrono::milliseconds>(delay),
+                                   [this, target, generation, kind]() {
+        onTimer(*target, generation, kind);
+    });
+}
+
+void LoadGenerator::onTimer(Session& session, uint64_t generation, TimerKind kind) {
+    if (!running_) {
+        return;
+    }
+    bool current = generation == session.generation;
+
+    switch (kind) {
+        case TimerKind::Connect:
+            if (!session.connection && session.connecting == INVALID_SOCKET) {
+                connect(session);
+            }
+            break;
+        case TimerKind::ConnectTimeout:
+            if (current && session.connecting != INVALID_SOCKET) {
+                session.worker->loop->remove(session.connecting);
+                closeSocketHandle(session.connecting);
+                session.connecting = INVALID_SOCKET;
+                onConnectFailed(session);
+            }
+            break;
+        case TimerKind::Send:
+            if (current && session.connection) {
+                sendRequest(session);
+                // Fixed schedule; one that fell behind restarts rather than bursting
+                auto now = Clock::now();
+                auto interval = std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double>(1.0 / config_.messagesPerSecond));
+                session.nextSend += interval;
+                if (session.nextSend <= now) {
+                    session.nextSend = now + interval;
+                }
+                schedule(session, session.nextSend - now, kind);
+            }
+            break;
+        case TimerKind::Recycle:
+            if (current && session.connection) {
+                session.recycling = true;
+                std::shared_ptr<TcpConnection> connection = session.connection;
+                connection->close(); // Reports through onDisconnected()
+            }
+            break;
+    }
+}
+
+void LoadGenerator::connect(Session& session) {
+    Worker& worker = *session.worker;
+    session.generation++;
+    session.connectStarted = Clock::now();
+
+    socket_t socket = ::socket(address_.getFamily(), SOCK_STREAM, 0);
+    if (socket == INVALID_SOCKET) {
+        onConnectFailed(session);
+        return;
+    }
+    prepareSocket(socket);
+
+    if (::connect(socket, address_.get(), address_.getLength()) == 0) {
+        onConnected(session, socket);
+        return;
+    }
+    if (!isConnectInProgress()) {
+        closeSocketHandle(socket);
+        onConnectFailed(session);
+        return;
+    }
+
+    // Writable once the handshake finished, either way
+    Session* target = &session;
+    uint64_t generation = session.generation;
+    if (!worker.loop->add(socket, EventLoop::Writable, [this, target, generation](uint32_t) {
+            onConnectReady(*target, generation);
+        })) {
+        closeSocketHandle(socket);
+        onConnectFailed(session);
+        return;
+    }
+    session.connecting = socket;
+    session.connectTimer = schedule(session, config_.connectTimeout, TimerKind::ConnectTimeout);
+}
+
+void LoadGenerator::onConnectReady(Session& session, uint64_t generation) {
+    if (generation != session.generation || session.connecting == INVALID_SOCKET) {
+        return;
+    }
+
+    socket_t socket = session.connecting;
+    session.connecting = INVALID_SOCKET;
+    session.worker->loop->remove(socket);
+    session.worker->loop->cancelTimer(session.connectTimer);
+
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (getsockopt(socket, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error), &length) != 0 || error != 0) {
+        closeSocketHandle(socket);
+        onConnectFailed(session);
+        return;
+    }
+    onConnected(session, socket);
+}
+
+void LoadGenerator::onConnected(Session& session, socket_t socket) {
+    Worker& worker = *session.worker;
+    auto now = Clock::now();
+    totals_->connectLatency.record(now - session.connectStarted);
+
+    auto connection = std::make_shared<TcpConnection>(socket, ip_, config_.port, worker.loop);
+    connection->setMetrics(metrics_);
+    connection->setSendMode(TcpConnection::SendMode::Queued);
+
+    Session* target = &session;
+    connection->setOnBufferReceived([this, target](std::shared_ptr<TcpConnection>, const BufferView& data) {
+        onReceived(*target, data);
+    });
+    connection->setOnDisconnected([this, target](std::shared_ptr<TcpConnection> closed) {
+        if (target->connection == closed) {
+            onDisconnected(*target);
+        }
+    });
+
+    if (config_.sslContext &&
+        !connection->enableClientSsl(config_.sslContext, config_.serverName,
+                                     config_.serverName + ":" + std::to_string(config_.port))) {
+        connection->close();
+        onConnectFailed(session);
+        return;
+    }
+
+    session.inFlight.clear();
+    session.lineFramer.reset();
+    session.lengthFramer.reset();
+    session.connection = connection;
+    if (!connection->startReading()) {
+        session.connection.reset();
+        connection->close();
+        onConnectFailed(session);
+        return;
+    }
+
+    totals_->connects.add();
+    totals_->activeSessions.add();
+
+    // Open loop: random phase so sessions started together don't send together
+    if (config_.messagesPerSecond > 0) {
+        auto interval = std::chrono::duration<double>(1.0 / config_.messagesPerSecond);
+        auto phase = worker.jitter(std::chrono::duration_cast<Clock::duration>(interval), 0.0, 1.0);
+        session.nextSend = now + phase;
+        schedule(session, phase, TimerKind::Send);
+    } else {
+        sendRequest(session);
+    }
+
+    if (config_.sessionLifetime.count() > 0) {
+        schedule(session, worker.jitter(config_.sessionLifetime, 0.5, 1.5), TimerKind::Recycle);
+    }
+}
+
+void LoadGenerator::onConnectFailed(Session& session) {
+    totals_->connectFailures.add();
+    if (running_) {
+        schedule(session, config_.reconnectDelay, TimerKind::Connect);
+    }
+}
+
+void LoadGenerator::onReceived(Session& session, const BufferView& data) {
+    // Timed from when the loop saw the reply, not when this session got to it
+    auto receivedAt = session.worker->loop->getWakeTime();
+    size_t replies = 0;
+    auto onReply = [&](const ByteView&) {
+        replies++;
+        if (!session.inFlight.empty()) {
+            totals_->latency.record(std::max(Clock::duration::zero(), receivedAt - session.inFlight.front()));
+            session.inFlight.pop_front();
+        }
+    };
+
+    ByteView input(data.data(), data.size());
+    if (config_.framing == Framing::Line) {
+        session.lineFramer.unframe(input, onReply);
+    } else {
+        session.lengthFramer.unframe(input, onReply);
+    }
+    totals_->messagesReceived.add(static_cast<int64_t>(replies));
+
+    // Closed loop: the next request follows the last reply
+    if (config_.messagesPerSecond <= 0 && replies > 0 && session.inFlight.empty() && session.connection) {
+        sendRequest(session);
+    }
+}
+
+void LoadGenerator::onDisconnected(Session& session) {
+    session.connection.reset();
+    session.generation++;
+    session.inFlight.clear();
+    totals_->disconnects.add();
+    totals_->activeSessions.add(-1);
+
+    bool recycled = session.recycling;
+    session.recycling = false;
+    if (running_) {
+        auto delay = recycled ? Clock::duration::zero() : Clock::duration(config_.reconnectDelay);
+        schedule(session, delay, TimerKind::Connect);
+    }
+}
+
+void LoadGenerator::sendRequest(Session& session) {
+    if (session.connection->isAboveHighWatermark()) {
+        totals_->deferredSends.add();
+        return;
+    }
+
+    session.inFlight.push_back(Clock::now());
+    if (session.connection->send(request_)) {
+        totals_->messagesSent.add();
+    } else {
+        session.inFlight.pop_back();
+    }
+}
+
+void LoadGenerator::closeSessions(Worker& worker) {
+    for (auto& session : worker.sessions) {
+        if (session->connecting != INVALID_SOCKET) {
+            worker.loop->remove(session->connecting);
+            closeSocketHandle(session->connecting);
+            session->connecting = INVALID_SOCKET;
+        }
+
+        if (session->connection) {
+            std::shared_ptr<TcpConnection> connection = std::move(session->connection);
+            connection->setOnDisconnected(nullptr);
+            connection->setOnBufferReceived(nullptr);
+            connection->close();
+            totals_->activeSessions.add(-1);
+        }
+    }
+}
+
+} // namespace tcp
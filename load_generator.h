@@ -0,0 +1,141 @@
+#pragma once
+
+#include "tcp_socket.h"
+#include "event_loop.h"
+#include "metrics.h"
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <string>
+
+namespace tcp {
+
+class SslContext;
+
+// Drives many logical client sessions against one server from a few event
+// loops, for soak and capacity tests. Each session is a loop-owned
+// TcpConnection with queued sends that frames a fixed payload with the
+// library's framers and times every reply against its request (replies are
+// matched in order, as with an echo server). Sessions are ramped up,
+// optionally recycled to produce connection churn, and reconnect when the
+// server drops them.
+class LoadGenerator {
+public:
+    // How requests and replies are delimited on the wire
+    enum class Framing {
+        Line,          // CRLF-terminated, as examples/echo_server.cpp speaks
+        LengthPrefixed // UInt32 big-endian length prefix
+    };
+
+    struct Config {
+        std::string host = "127.0.0.1";
+        uint16_t port = 0;
+        size_t sessions = 100;
+        size_t ioThreads = 0;                     // 0 = hardware concurrency
+        size_t messageSize = 64;                  // Payload bytes before framing
+        Framing framing = Framing::Line;
+        double messagesPerSecond = 1.0;           // Per session; 0 = one request in flight at a time
+        std::chrono::milliseconds rampUp{0};      // Session starts spread evenly over this
+        std::chrono::milliseconds duration{0};    // wait() returns after this; 0 = run until stop()
+        std::chrono::milliseconds sessionLifetime{0}; // Churn: reconnect after ~this long; 0 = never
+        std::chrono::milliseconds connectTimeout{5000};
+        std::chrono::milliseconds reconnectDelay{1000}; // After a failed connect or a server close
+        std::chrono::milliseconds reportInterval{1000};
+        std::shared_ptr<SslContext> sslContext;   // Client context; null = plain TCP
+        std::string serverName;                   // SNI and verification; defaults to host
+    };
+
+    // Activity over one report interval, or since start() for getTotals()
+    struct Report {
+        double elapsedSeconds = 0;   // Since start()
+        double intervalSeconds = 0;  // Covered by the counts below
+        size_t activeSessions = 0;   // Connected when the report was taken
+        uint64_t connects = 0;
+        uint64_t connectFailures = 0;
+        uint64_t disconnects = 0;
+        uint64_t messagesSent = 0;
+        uint64_t messagesReceived = 0;
+        uint64_t deferredSends = 0;  // Skipped while a session's queue was above its high watermark
+        uint64_t bytesSent = 0;
+        uint64_t bytesReceived = 0;
+        LatencyHistogram::Snapshot latency;        // Request to reply
+        LatencyHistogram::Snapshot connectLatency; // TCP connect
+
+        double messagesPerSecond() const { return intervalSeconds > 0 ? messagesReceived / intervalSeconds : 0; }
+        double bytesPerSecond() const { return intervalSeconds > 0 ? (bytesSent + bytesReceived) / intervalSeconds : 0; }
+    };
+
+    using OnReportCallback = std::function<void(const Report&)>;
+
+    explicit LoadGenerator(Config config);
+    ~LoadGenerator();
+
+    // Non-copyable
+    LoadGenerator(const LoadGenerator&) = delete;
+    LoadGenerator& operator=(const LoadGenerator&) = delete;
+
+    // Resolves the host once and starts the loops; false if either fails
+    bool start();
+    void stop(); // Closes every session
+    bool isRunning() const { return running_; }
+
+    // Blocks until the configured duration has passed or stop() is called
+    void wait();
+
+    // Called on the generator's timer thread every reportInterval
+    void setOnReport(OnReportCallback callback) { onReport_ = callback; }
+    Report getTotals() const;
+    const Config& getConfig() const { return config_; }
+
+private:
+    struct Session;
+    struct Worker;
+    struct Totals;
+
+    // Session timers, run on the session's loop
+    enum class TimerKind {
+        Connect,
+        ConnectTimeout,
+        Send,
+        Recycle
+    };
+
+    Config config_;
+    std::string ip_;
+    SocketAddress address_;
+    BufferView request_; // Framed payload shared by every send
+    std::unique_ptr<EventLoopGroup> loops_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::shared_ptr<ConnectionMetrics> metrics_; // Bytes and syscalls of every session
+    std::unique_ptr<Totals> totals_;
+
+    std::atomic<bool> running_;
+    std::chrono::steady_clock::time_point startTime_;
+    OnReportCallback onReport_;
+
+    // Timer thread: takes reports and ends timed runs
+    std::thread timerThread_;
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    bool stopping_;
+    bool finished_;
+
+    void timerLoop();
+    TimerId schedule(Session& session, std::chrono::steady_clock::duration delay, TimerKind kind);
+    void onTimer(Session& session, uint64_t generation, TimerKind kind);
+    void connect(Session& session);
+    void onConnectReady(Session& session, uint64_t generation);
+    void onConnected(Session& session, socket_t socket);
+    void onConnectFailed(Session& session);
+    void onReceived(Session& session, const BufferView& data);
+    void onDisconnected(Session& session);
+    void sendRequest(Session& session);
+    void closeSessions(Worker& worker);
+    Report takeReport() const;
+};
+
+} // namespace tcp
@@ -0,0 +1,216 @@
+#include "metrics.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace tcp {
+
+namespace {
+
+// Prometheus histogram bounds in seconds, 1 us to 10 s
+const double kExportBounds[] = {
+    1e-6, 2.5e-6, 5e-6, 1e-5, 2.5e-5, 5e-5, 1e-4, 2.5e-4, 5e-4,
+    1e-3, 2.5e-3, 5e-3, 1e-2, 2.5e-2, 5e-2, 1e-1, 2.5e-1, 5e-1,
+    1.0, 2.5, 5.0, 10.0
+};
+
+std::string formatValue(double value) {
+    char text[32];
+    if (value == std::floor(value) && std::fabs(value) < 9007199254740992.0) {
+        std::snprintf(text, sizeof(text), "%.0f", value);
+    } else {
+        std::snprintf(text, sizeof(text), "%.9g", value);
+    }
+    return text;
+}
+
+int highestBit(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(value);
+#else
+    int bit = 0;
+    while (value >>= 1) {
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+} // namespace
+
+// Counter
+
+int64_t Counter::value() const {
+    int64_t total = 0;
+    for (const Cell& cell : cells_) {
+        total += cell.value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+size_t Counter::shardIndex() {
+    static std::atomic<size_t> nextShard(0);
+    thread_local size_t shard = nextShard.fetch_add(1, std::memory_order_relaxed) % kShards;
+    return shard;
+}
+
+// LatencyHistogram
+
+LatencyHistogram::LatencyHistogram() {
+    for (Shard& shard : shards_) {
+        for (auto& bucket : shard.buckets) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+        shard.sum.store(0, std::memory_order_relaxed);
+        shard.max.store(0, std::memory_order_relaxed);
+    }
+}
+
+size_t LatencyHistogram::bucketIndex(uint64_t value) {
+    if (value < kSubBuckets) {
+        return static_cast<size_t>(value);
+    }
+
+    int exponent = std::min(highestBit(value), kMaxExponent);
+    int shift = exponent - kSubBucketBits;
+    uint64_t subBucket = std::min<uint64_t>(value >> shift, 2 * kSubBuckets - 1) - kSubBuckets;
+    return static_cast<size_t>(shift + 1) * kSubBuckets + static_cast<size_t>(subBucket);
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(size_t index) {
+    if (index < kSubBuckets) {
+        return index;
+    }
+
+    int shift = static_cast<int>(index / kSubBuckets) - 1;
+    uint64_t lower = static_cast<uint64_t>(kSubBuckets + index % kSubBuckets) << shift;
+    return lower + (uint64_t(1) << shift) - 1;
+}
+
+void LatencyHistogram::record(std::chrono::nanoseconds value) {
+    uint64_t nanoseconds = value.count() > 0 ? static_cast<uint64_t>(value.count()) : 0;
+    Shard& shard = shards_[Counter::shardIndex() % kShards];
+
+    shard.buckets[bucketIndex(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    shard.sum.fetch_add(nanoseconds, std::memory_order_relaxed);
+
+    uint64_t max = shard.max.load(std::memory_order_relaxed);
+    while (nanoseconds > max && !shard.max.compare_exchange_weak(max, nanoseconds, std::memory_order_relaxed)) {
+    }
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+    Snapshot snapshot;
+    snapshot.buckets.assign(kBucketCount, 0);
+
+    for (const Shard& shard : shards_) {
+        for (size_t i = 0; i < kBucketCount; i++) {
+            uint64_t count = shard.buckets[i].load(std::memory_order_relaxed);
+            snapshot.buckets[i] += count;
+            snapshot.count += count;
+        }
+        snapshot.sum += shard.sum.load(std::memory_order_relaxed);
+        snapshot.max = std::max(snapshot.max, shard.max.load(std::memory_order_relaxed));
+    }
+    return snapshot;
+}
+
+std::chrono::nanoseconds LatencyHistogram::Snapshot::percentile(double q) const {
+    if (count == 0) {
+        return std::chrono::nanoseconds(0);
+    }
+
+    q = std::min(std::max(q, 0.0), 1.0);
+    uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q * static_cast<double>(count))));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); i++) {
+        seen += buckets[i];
+        if (seen >= target) {
+            uint64_t bound = std::min(bucketUpperBound(i), max);
+            return std::chrono::nanoseconds(static_cast<int64_t>(bound));
+        }
+    }
+    return std::chrono::nanoseconds(static_cast<int64_t>(max));
+}
+
+std::chrono::nanoseconds LatencyHistogram::Snapshot::mean() const {
+    return std::chrono::nanoseconds(count > 0 ? static_cast<int64_t>(sum / count) : 0);
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::Snapshot::since(const Snapshot& earlier) const {
+    Snapshot delta;
+    delta.buckets.assign(buckets.size(), 0);
+    for (size_t i = 0; i < buckets.size(); i++) {
+        uint64_t before = i < earlier.buckets.size() ? earlier.buckets[i] : 0;
+        delta.buckets[i] = buckets[i] > before ? buckets[i] - before : 0;
+        delta.count += delta.buckets[i];
+        if (delta.buckets[i] > 0) {
+            delta.max = std::min(bucketUpperBound(i), max);
+        }
+    }
+    delta.sum = sum > earlier.sum ? sum - earlier.sum : 0;
+    return delta;
+}
+
+// PrometheusWriter
+
+PrometheusWriter::PrometheusWriter(std::string prefix) : prefix_(std::move(prefix)) {
+    if (!prefix_.empty() && prefix_.back() != '_') {
+        prefix_ += '_';
+    }
+}
+
+void PrometheusWriter::counter(const std::string& name, const std::string& help, double value) {
+    header(name, help, "counter");
+    sample(name, "", value);
+}
+
+void PrometheusWriter::counter(const std::string& name, const std::string& help,
+                               const std::vector<std::pair<std::string, double>>& samples) {
+    if (samples.empty()) {
+        return;
+    }
+    header(name, help, "counter");
+    for (const auto& sample : samples) {
+        this->sample(name, sample.first, sample.second);
+    }
+}
+
+void PrometheusWriter::gauge(const std::string& name, const std::string& help, double value) {
+    header(name, help, "gauge");
+    sample(name, "", value);
+}
+
+void PrometheusWriter::histogram(const std::string& name, const std::string& help,
+                                 const LatencyHistogram::Snapshot& snapshot) {
+    header(name, help, "histogram");
+
+    // Cumulative counts of the buckets that end at or below each bound
+    size_t index = 0;
+    uint64_t cumulative = 0;
+    for (double bound : kExportBounds) {
+        uint64_t limit = static_cast<uint64_t>(bound * 1e9);
+        while (index < snapshot.buckets.size() && LatencyHistogram::bucketUpperBound(index) <= limit) {
+            cumulative += snapshot.buckets[index++];
+        }
+        sample(name + "_bucket", "le=\"" + formatValue(bound) + "\"", static_cast<double>(cumulative));
+    }
+    sample(name + "_bucket", "le=\"+Inf\"", static_cast<double>(snapshot.count));
+    sample(name + "_sum", "", static_cast<double>(snapshot.sum) / 1e9);
+    sample(name + "_count", "", static_cast<double>(snapshot.count));
+}
+
+void PrometheusWriter::header(const std::string& name, const std::string& help, const char* type) {
+    output_ += "# HELP " + prefix_ + name + " " + help + "\n";
+    output_ += "# TYPE " + prefix_ + name + " " + type + "\n";
+}
+
+void PrometheusWriter::sample(const std::string& name, const std::string& labels, double value) {
+    output_ += prefix_ + name;
+    if (!labels.empty()) {
+        output_ += "{" + labels + "}";
+    }
+    output_ += " " + formatValue(value) + "\n";
+}
+
+} // namespace tcp
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <utility>
+
+namespace tcp {
+
+// Event counter for hot paths. Writers add to one of several cache-line
+// padded cells picked per thread, so threads never contend on one line;
+// value() sums the cells. Deltas may be negative, so the same type serves
+// as a gauge (e.g. bytes currently queued).
+class Counter {
+public:
+    static constexpr size_t kShards = 16;
+
+    Counter() = default;
+
+    // Non-copyable
+    Counter(const Counter&) = delete;
+    Counter& operator=(const Counter&) = delete;
+
+    void add(int64_t delta = 1) { cells_[shardIndex()].value.fetch_add(delta, std::memory_order_relaxed); }
+    int64_t value() const;
+
+    // Cell used by the calling thread (assigned round-robin on first use)
+    static size_t shardIndex();
+
+private:
+    struct alignas(64) Cell {
+        std::atomic<int64_t> value{0};
+    };
+    Cell cells_[kShards];
+};
+
+using Gauge = Counter;
+
+// Log-linear latency histogram in the style of HdrHistogram: buckets are
+// exact below 16 ns and then split every power of two into 16 steps, so any
+// recorded value is reported within 1/16 (~6%) of itself. Values clamp just
+// below 2^37 ns (~137 s). Recording is a few relaxed adds on per-thread shards.
+class LatencyHistogram {
+public:
+    static constexpr int kSubBucketBits = 4;
+    static constexpr size_t kSubBuckets = size_t(1) << kSubBucketBits;
+    static constexpr int kMaxExponent = 36; // Highest power of two with buckets
+    static constexpr size_t kBucketCount = (kMaxExponent - kSubBucketBits + 2) * kSubBuckets;
+
+    struct Snapshot {
+        uint64_t count = 0;
+        uint64_t sum = 0; // Nanoseconds
+        uint64_t max = 0;
+        std::vector<uint64_t> buckets;
+
+        // q in [0, 1]; returns the upper bound of the bucket holding it
+        std::chrono::nanoseconds percentile(double q) const;
+        std::chrono::nanoseconds mean() const;
+
+        // Values recorded after an earlier snapshot of the same histogram.
+        // max becomes the upper bound of the highest bucket that grew.
+        Snapshot since(const Snapshot& earlier) const;
+    };
+
+    LatencyHistogram();
+
+    // Non-copyable
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    void record(std::chrono::nanoseconds value);
+    Snapshot snapshot() const;
+
+    static size_t bucketIndex(uint64_t value);
+    static uint64_t bucketUpperBound(size_t index);
+
+private:
+    static constexpr size_t kShards = 4;
+
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> buckets[kBucketCount];
+        std::atomic<uint64_t> sum;
+        std::atomic<uint64_t> max;
+    };
+    Shard shards_[kShards];
+};
+
+// Counters every connection of one server adds to. Connections hold a
+// reference, so a snapshot covers closed connections too and is never
+// more than a sum over shards.
+struct ConnectionMetrics {
+    Counter bytesSent;
+    Counter bytesReceived;
+    Counter messagesSent;     // send()/sendFile() calls and sendBatch() messages
+    Counter messagesReceived; // Receive callbacks
+    Counter sendCalls;        // Write syscalls (send, sendmsg, sendfile, TLS writes)
+    Counter receiveCalls;     // Read syscalls, including those that would block
+    Gauge queuedBytes;        // Send-queue depth summed over queued connections
+    LatencyHistogram readToCallback;   // Readiness reported to callback entry
+    LatencyHistogram callbackDuration; // Time spent in receive callbacks
+};
+
+// Prometheus text exposition format (version 0.0.4). Names are prefixed;
+// histograms are written in seconds with fixed 1-2.5-5 bucket bounds.
+class PrometheusWriter {
+public:
+    explicit PrometheusWriter(std::string prefix = "tcp");
+
+    void counter(const std::string& name, const std::string& help, double value);
+    void gauge(const std::string& name, const std::string& help, double value);
+    void histogram(const std::string& name, const std::string& help, const LatencyHistogram::Snapshot& snapshot);
+    // One family, a sample per label set (e.g. reactor="0"); nothing when empty
+    void counter(const std::string& name, const std::string& help, const std::vector<std::pair<std::string, double>>& samples);
+
+    const std::string& str() const { return output_; }
+
+private:
+    std::string prefix_;
+    std::string output_;
+
+    void header(const std::string& name, const std::string& help, const char* type);
+    void sample(const std::string& name, const std::string& labels, double value);
+};
+
+} // namespace tcp
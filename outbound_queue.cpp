@@ -0,0 +1,338 @@
+#include "outbound_queue.h"
+#include <algorithm>
+#include <cstring>
+
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
+
+namespace tcp {
+
+namespace {
+
+// Messages gathered per send call (well below IOV_MAX everywhere)
+constexpr int kMaxIovecs = 64;
+
+// Writer flushes coalesce messages up to one full TLS record
+constexpr size_t kMaxStagedBytes = 16384;
+
+#ifdef MSG_NOSIGNAL
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+constexpr int kSendFlags = 0;
+#endif
+
+} // namespace
+
+OutboundQueue::OutboundQueue() : headOffset_(0), queuedBytes_(0), stagingOffset_(0), metrics_(nullptr) {
+    tail_ = new Node();
+    head_.store(tail_, std::memory_order_relaxed);
+}
+
+OutboundQueue::~OutboundQueue() {
+    clear();
+    delete tail_;
+}
+
+size_t OutboundQueue::push(std::vector<uint8_t> data) {
+    if (data.empty()) {
+        return getQueuedBytes();
+    }
+    
+    Node* node = new Node();
+    node->vector = std::move(data);
+    node->data = node->vector.data();
+    node->size = node->vector.size();
+    return link(node);
+}
+
+size_t OutboundQueue::push(const void* data, size_t length) {
+    if (length == 0) {
+        return getQueuedBytes();
+    }
+    
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    if (length > BufferPool::shared().getMaxBlockSize()) {
+        return push(std::vector<uint8_t>(bytes, bytes + length));
+    }
+    
+    Node* node = new Node();
+    node->buffer = BufferPool::shared().acquire(length);
+    std::memcpy(node->buffer.data(), bytes, length);
+    node->buffer.setSize(length);
+    node->data = node->buffer.data();
+    node->size = length;
+    return link(node);
+}
+
+size_t OutboundQueue::push(const BufferView& data) {
+    if (data.empty()) {
+        return getQueuedBytes();
+    }
+    
+    Node* node = new Node();
+    node->buffer = data.buffer();
+    node->data = data.data();
+    node->size = data.size();
+    return link(node);
+}
+
+size_t OutboundQueue::push(std::shared_ptr<FileTransfer> file) {
+    if (!file || file->isComplete()) {
+        return getQueuedBytes();
+    }
+    
+    Node* node = new Node();
+    node->size = static_cast<size_t>(file->getRemaining());
+    node->file = std::move(file);
+    return link(node);
+}
+
+size_t OutboundQueue::link(Node* node) {
+    // Account before linking so the consumer never subtracts unseen bytes
+    size_t queued = queuedBytes_.fetch_add(node->size, std::memory_order_acq_rel) + node->size;
+    if (metrics_) {
+        metrics_->queuedBytes.add(static_cast<int64_t>(node->size));
+    }
+    Node* previous = head_.exchange(node, std::memory_order_acq_rel);
+    previous->next.store(node, std::memory_order_release);
+    return queued;
+}
+
+OutboundQueue::FlushResult OutboundQueue::flush(socket_t socket, size_t& bytesWritten) {
+    bytesWritten = 0;
+    
+    while (true) {
+#ifdef _WIN32
+        WSABUF buffers[kMaxIovecs];
+#else
+        struct iovec buffers[kMaxIovecs];
+#endif
+        int count = 0;
+        size_t offset = headOffset_;
+        
+        // A producer mid-push has not linked its node yet; it is picked up next flush
+        for (Node* node = tail_->next.load(std::memory_order_acquire);
+             node && count < kMaxIovecs; node = node->next.load(std::memory_order_acquire)) {
+            if (node->file) {
+                break; // Sent on its own once it reaches the head
+            }
+#ifdef _WIN32
+            buffers[count].buf = reinterpret_cast<char*>(const_cast<uint8_t*>(node->data + offset));
+            buffers[count].len = static_cast<ULONG>(node->size - offset);
+#else
+            buffers[count].iov_base = const_cast<uint8_t*>(node->data + offset);
+            buffers[count].iov_len = node->size - offset;
+#endif
+            offset = 0;
+            count++;
+        }
+        
+        if (count == 0) {
+            Node* node = tail_->next.load(std::memory_order_acquire);
+            if (!node) {
+                return FlushResult::Drained;
+            }
+            
+            // A file at the head goes from the page cache without a user-space copy
+            long sent = node->file->transmit(socket, node->size - headOffset_);
+            countWriteCall();
+            if (sent < 0) {
+                return FlushResult::Failed;
+            }
+            if (sent == 0) {
+                return FlushResult::Pending;
+            }
+            consume(static_cast<size_t>(sent));
+            bytesWritten += static_cast<size_t>(sent);
+            continue;
+        }
+        
+#ifdef _WIN32
+        DWORD sent = 0;
+        countWriteCall();
+        if (WSASend(socket, buffers, count, &sent, 0, nullptr, nullptr) == SOCKET_ERROR) {
+            int error = WSAGetLastError();
+            if (error == WSAEWOULDBLOCK) {
+                return FlushResult::Pending;
+            }
+            if (error == WSAEINTR) {
+                continue;
+            }
+            return FlushResult::Failed;
+        }
+#else
+        struct msghdr message = {};
+        message.msg_iov = buffers;
+        message.msg_iovlen = count;
+        
+        ssize_t sent = ::sendmsg(socket, &message, kSendFlags);
+        countWriteCall();
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return FlushResult::Pending;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            return FlushResult::Failed;
+        }
+#endif
+        
+        consume(static_cast<size_t>(sent));
+        bytesWritten += static_cast<size_t>(sent);
+    }
+}
+
+size_t OutboundQueue::gather(ByteView* buffers, size_t maxBuffers) const {
+    size_t count = 0;
+    size_t offset = headOffset_;
+    for (Node* node = tail_->next.load(std::memory_order_acquire);
+         node && count < maxBuffers && !node->file; node = node->next.load(std::memory_order_acquire)) {
+        buffers[count++] = ByteView(node->data + offset, node->size - offset);
+        offset = 0;
+    }
+    return count;
+}
+
+OutboundQueue::FlushResult OutboundQueue::flush(const Writer& write, size_t& bytesWritten) {
+    bytesWritten = 0;
+    
+    while (true) {
+        const uint8_t* data;
+        size_t length;
+        
+        if (stagingOffset_ < staging_.size()) {
+            // Finish the staged bytes before looking at the queue again
+            data = staging_.data() + stagingOffset_;
+            length = staging_.size() - stagingOffset_;
+        } else {
+            staging_.clear();
+            stagingOffset_ = 0;
+            
+            Node* node = tail_->next.load(std::memory_order_acquire);
+            if (!node) {
+                return FlushResult::Drained;
+            }
+            
+            if (node->file) {
+                // No kernel copy through a user-space record layer: read one
+                // record's worth of the file at a time
+                staging_.resize(std::min(kMaxStagedBytes, node->size - headOffset_));
+                long bytesRead = node->file->read(staging_.data(), staging_.size());
+                if (bytesRead < 0) {
+                    staging_.clear();
+                    return FlushResult::Failed;
+                }
+                staging_.resize(static_cast<size_t>(bytesRead));
+                data = staging_.data();
+                length = staging_.size();
+            } else {
+                data = node->data + headOffset_;
+                length = node->size - headOffset_;
+            }
+            
+            // Small messages are copied together so they share one record
+            // and one syscall; large ones are written in place
+            Node* next = node->next.load(std::memory_order_acquire);
+            if (!node->file && length < kMaxStagedBytes && next && !next->file) {
+                staging_.insert(staging_.end(), data, data + length);
+                for (; next && !next->file && staging_.size() + next->size <= kMaxStagedBytes;
+                     next = next->next.load(std::memory_order_acquire)) {
+                    staging_.insert(staging_.end(), next->data, next->data + next->size);
+                }
+                data = staging_.data();
+                length = staging_.size();
+            }
+        }
+        
+        long written = write(data, length);
+        countWriteCall();
+        if (written < 0) {
+            return FlushResult::Failed;
+        }
+        if (written == 0) {
+            return FlushResult::Pending;
+        }
+        
+        if (!staging_.empty()) {
+            stagingOffset_ += static_cast<size_t>(written);
+        }
+        consume(static_cast<size_t>(written));
+        bytesWritten += static_cast<size_t>(written);
+    }
+}
+
+void OutboundQueue::clear() {
+    staging_.clear();
+    stagingOffset_ = 0;
+    
+    size_t dropped = 0;
+    Node* next = tail_->next.load(std::memory_order_acquire);
+    while (next) {
+        if (next->file) {
+            next->file->fail(ErrorCode::ConnectionClosed);
+            noteFileProgress(next->file);
+        }
+        dropped += next->size - headOffset_;
+        headOffset_ = 0;
+        delete tail_;
+        tail_ = next;
+        tail_->release();
+        next = tail_->next.load(std::memory_order_acquire);
+    }
+    queuedBytes_.fetch_sub(dropped, std::memory_order_acq_rel);
+    if (metrics_) {
+        metrics_->queuedBytes.add(-static_cast<int64_t>(dropped));
+    }
+}
+
+void OutboundQueue::consume(size_t bytes) {
+    queuedBytes_.fetch_sub(bytes, std::memory_order_acq_rel);
+    if (metrics_) {
+        metrics_->queuedBytes.add(-static_cast<int64_t>(bytes));
+    }
+    
+    while (bytes > 0) {
+        Node* next = tail_->next.load(std::memory_order_acquire);
+        size_t remaining = next->size - headOffset_;
+        
+        size_t written = std::min(bytes, remaining);
+        if (next->file) {
+            next->file->advance(written);
+            noteFileProgress(next->file);
+        }
+        
+        if (bytes < remaining) {
+            headOffset_ += bytes;
+            return;
+        }
+        
+        // Fully written: the node becomes the new (empty) tail
+        bytes -= remaining;
+        headOffset_ = 0;
+        delete tail_;
+        tail_ = next;
+        tail_->release();
+    }
+}
+
+void OutboundQueue::countWriteCall() {
+    if (metrics_) {
+        metrics_->sendCalls.add();
+    }
+}
+
+void OutboundQueue::noteFileProgress(const std::shared_ptr<FileTransfer>& file) {
+    // Files are written in order, so a repeat is always the last entry
+    if (fileProgress_.empty() || fileProgress_.back() != file) {
+        fileProgress_.push_back(file);
+    }
+}
+
+void OutboundQueue::takeFileProgress(std::vector<std::shared_ptr<FileTransfer>>& files) {
+    files.insert(files.end(), fileProgress_.begin(), fileProgress_.end());
+    fileProgress_.clear();
+}
+
+} // namespace tcp
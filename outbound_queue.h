@@ -0,0 +1,105 @@
+#pragma once
+
+#include "tcp_socket.h"
+#include "tcp_buffer.h"
+#include "file_transfer.h"
+#include "metrics.h"
+#include <vector>
+#include <atomic>
+#include <functional>
+
+namespace tcp {
+
+// Multi-producer, single-consumer queue of pending writes for one socket.
+// Any thread may push(); only the I/O thread that owns the socket may call
+// flush() or clear(). Flushing gathers queued messages into a single
+// scatter-gather send so many small writes cost one syscall. Queued files
+// keep their place in the stream and go out with sendfile().
+class OutboundQueue {
+public:
+    enum class FlushResult {
+        Drained,  // Everything queued has been written
+        Pending,  // Socket buffer is full; wait for writability
+        Failed    // Send error; the connection should be closed
+    };
+
+    OutboundQueue();
+    ~OutboundQueue();
+
+    // Non-copyable
+    OutboundQueue(const OutboundQueue&) = delete;
+    OutboundQueue& operator=(const OutboundQueue&) = delete;
+
+    // Producer side (thread-safe, lock-free). Returns bytes queued after the push.
+    size_t push(std::vector<uint8_t> data);
+    size_t push(const void* data, size_t length); // Copies into a pooled buffer
+    size_t push(const BufferView& data);          // Shares the block, no copy
+    size_t push(std::shared_ptr<FileTransfer> file);
+
+    // Byte-stream sink such as a TLS session: returns bytes accepted, 0 when
+    // it would block, or a negative value on failure. A stalled write is
+    // retried with the same bytes, as TLS requires.
+    using Writer = std::function<long(const uint8_t* data, size_t length)>;
+
+    // Consumer side
+    FlushResult flush(socket_t socket, size_t& bytesWritten);
+    FlushResult flush(const Writer& write, size_t& bytesWritten); // Coalesces small messages
+    void clear(); // Pending files fail with ConnectionClosed
+    
+    // Completion-based sends: gather() describes the next queued messages,
+    // up to the first file, without consuming them; complete() consumes
+    // what the kernel reports written. Nothing else may flush in between.
+    size_t gather(ByteView* buffers, size_t maxBuffers) const;
+    void complete(size_t bytesWritten) { consume(bytesWritten); }
+    
+    // Files that advanced or failed since the last call, for notify() once
+    // the caller is done with the queue
+    void takeFileProgress(std::vector<std::shared_ptr<FileTransfer>>& files);
+
+    size_t getQueuedBytes() const { return queuedBytes_.load(std::memory_order_acquire); }
+    bool empty() const { return getQueuedBytes() == 0; }
+
+    // Mirrors queue depth and write syscalls into shared counters. Set
+    // before the first push; the metrics must outlive the queue.
+    void setMetrics(ConnectionMetrics* metrics) { metrics_ = metrics; }
+
+private:
+    // Payload lives in a moved-in vector, a pooled buffer, or a file (data
+    // is null and bytes are read from the file at its own position)
+    struct Node {
+        std::atomic<Node*> next;
+        std::vector<uint8_t> vector;
+        Buffer buffer;
+        std::shared_ptr<FileTransfer> file;
+        const uint8_t* data;
+        size_t size;
+
+        Node() : next(nullptr), data(nullptr), size(0) {}
+        void release() {
+            vector = std::vector<uint8_t>();
+            buffer.reset();
+            file.reset();
+        }
+    };
+
+    // Vyukov intrusive MPSC list: producers swing head_, the consumer owns
+    // tail_ (an already-consumed node whose successor is the oldest message)
+    std::atomic<Node*> head_;
+    Node* tail_;
+    size_t headOffset_; // Bytes of the oldest message already written
+    std::atomic<size_t> queuedBytes_;
+    
+    // Writer flushes: copy of the next queued bytes, gathered from small messages
+    std::vector<uint8_t> staging_;
+    size_t stagingOffset_;
+    
+    std::vector<std::shared_ptr<FileTransfer>> fileProgress_;
+    ConnectionMetrics* metrics_;
+
+    size_t link(Node* node);
+    void consume(size_t bytes);
+    void countWriteCall();
+    void noteFileProgress(const std::shared_ptr<FileTransfer>& file);
+};
+
+} // namespace tcp
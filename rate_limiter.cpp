@@ -0,0 +1,165 @@
+#include "rate_limiter.h"
+#include "event_loop.h"
+#include <algorithm>
+#include <thread>
+#include <ctime>
+
+namespace tcp {
+
+namespace {
+
+constexpr double kNanosPerSecond = 1e9;
+
+// The coarse clock is a plain read of the last tick, cheaper than a full
+// clock read; its resolution (a few milliseconds) is well inside any
+// useful burst
+int64_t monotonicNanos() {
+#if defined(__linux__) && defined(CLOCK_MONOTONIC_COARSE)
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+} // namespace
+
+RateLimiter::RateLimiter(size_t bytesPerSecond, size_t bucketSize)
+    : RateLimiter(bytesPerSecond, bucketSize, nullptr) {
+}
+
+RateLimiter::RateLimiter(size_t bytesPerSecond, size_t bucketSize, std::shared_ptr<RateLimiter> parent)
+    : bytesPerSecond_(bytesPerSecond), bucketSize_(bucketSize > 0 ? bucketSize : bytesPerSecond),
+      tat_(0), parent_(std::move(parent)) {
+}
+
+bool RateLimiter::allowBytes(size_t bytes) {
+    if (!takeLocal(bytes, monotonicNanos())) {
+        return false;
+    }
+    if (parent_ && !parent_->allowBytes(bytes)) {
+        // Give ours back; the send isn't happening
+        tat_.fetch_sub(costOf(bytes), std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+std::chrono::nanoseconds RateLimiter::reserve(size_t bytes) {
+    int64_t debt = reserveLocal(bytes, monotonicNanos());
+    if (parent_) {
+        debt = std::max<int64_t>(debt, parent_->reserve(bytes).count());
+    }
+    return std::chrono::nanoseconds(debt);
+}
+
+std::chrono::milliseconds RateLimiter::getDelay(size_t bytes) const {
+    std::chrono::milliseconds delay(0);
+    if (getRate() > 0) {
+        int64_t now = monotonicNanos();
+        int64_t base = std::max(tat_.load(std::memory_order_relaxed), now);
+        int64_t excess = base + costOf(bytes) - (now + burst());
+        if (excess > 0) {
+            delay = std::chrono::ceil<std::chrono::milliseconds>(std::chrono::nanoseconds(excess));
+        }
+    }
+    if (parent_) {
+        delay = std::max(delay, parent_->getDelay(bytes));
+    }
+    return delay;
+}
+
+void RateLimiter::waitForBytes(size_t bytes) {
+    std::chrono::nanoseconds delay = reserve(bytes);
+    if (delay.count() > 0) {
+        std::this_thread::sleep_for(delay);
+    }
+}
+
+TimerId RateLimiter::waitAsync(EventLoop& loop, size_t bytes, std::function<void()> ready) {
+    std::chrono::nanoseconds delay = reserve(bytes);
+    if (delay.count() <= 0) {
+        ready();
+        return 0;
+    }
+    return loop.runAfter(std::chrono::ceil<std::chrono::milliseconds>(delay), std::move(ready));
+}
+
+void RateLimiter::setRate(size_t bytesPerSecond) {
+    bytesPerSecond_.store(bytesPerSecond, std::memory_order_relaxed);
+}
+
+void RateLimiter::setBucketSize(size_t bucketSize) {
+    bucketSize_.store(bucketSize, std::memory_order_relaxed);
+}
+
+size_t RateLimiter::getAvailableBytes() const {
+    size_t rate = getRate();
+    if (rate == 0) {
+        return getBucketSize();
+    }
+    int64_t now = monotonicNanos();
+    int64_t headroom = now + burst() - std::max(tat_.load(std::memory_order_relaxed), now);
+    if (headroom <= 0) {
+        return 0;
+    }
+    size_t available = static_cast<size_t>(static_cast<double>(headroom) * rate / kNanosPerSecond);
+    return std::min(available, getBucketSize());
+}
+
+double RateLimiter::getUtilization() const {
+    size_t bucketSize = getBucketSize();
+    if (bucketSize == 0) {
+        return 0.0;
+    }
+    return 1.0 - static_cast<double>(getAvailableBytes()) / bucketSize;
+}
+
+void RateLimiter::reset() {
+    tat_.store(0, std::memory_order_relaxed);
+}
+
+bool RateLimiter::takeLocal(size_t bytes, int64_t now) {
+    if (getRate() == 0) {
+        return true;
+    }
+    int64_t cost = costOf(bytes);
+    int64_t limit = now + burst();
+    int64_t tat = tat_.load(std::memory_order_relaxed);
+    for (;;) {
+        int64_t next = std::max(tat, now) + cost;
+        if (next > limit) {
+            return false;
+        }
+        if (tat_.compare_exchange_weak(tat, next, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+}
+
+int64_t RateLimiter::reserveLocal(size_t bytes, int64_t now) {
+    if (getRate() == 0) {
+        return 0;
+    }
+    int64_t cost = costOf(bytes);
+    int64_t tat = tat_.load(std::memory_order_relaxed);
+    int64_t next;
+    do {
+        next = std::max(tat, now) + cost;
+    } while (!tat_.compare_exchange_weak(tat, next, std::memory_order_relaxed));
+    return std::max<int64_t>(0, next - (now + burst()));
+}
+
+int64_t RateLimiter::costOf(size_t bytes) const {
+    size_t rate = getRate();
+    return rate > 0 ? static_cast<int64_t>(static_cast<double>(bytes) * kNanosPerSecond / rate) : 0;
+}
+
+int64_t RateLimiter::burst() const {
+    size_t rate = getRate();
+    return rate > 0 ? static_cast<int64_t>(static_cast<double>(getBucketSize()) * kNanosPerSecond / rate) : 0;
+}
+
+} // namespace tcp
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "timer_wheel.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace tcp {
+
+// Forward declarations
+class EventLoop;
+
+// Lock-free token bucket, kept as the bucket's "theoretical arrival time"
+// (GCRA): one atomic nanosecond stamp that each take advances by the
+// bytes' cost with a CAS, so concurrent senders never serialize on a lock
+// and nothing on the path sleeps. A limiter with a parent draws from both,
+// e.g. per-connection buckets under one shared egress cap; a rate of 0
+// means no limit of its own. Time comes from a coarse monotonic clock.
+class RateLimiter {
+public:
+    RateLimiter(size_t bytesPerSecond, size_t bucketSize = 0); // bucketSize 0 = one second's worth
+    RateLimiter(size_t bytesPerSecond, size_t bucketSize, std::shared_ptr<RateLimiter> parent);
+
+    // Non-copyable
+    RateLimiter(const RateLimiter&) = delete;
+    RateLimiter& operator=(const RateLimiter&) = delete;
+
+    // Takes the bytes if this bucket and every parent have them; a request
+    // larger than the bucket never fits, use reserve() for those
+    bool allowBytes(size_t bytes);
+
+    // Takes the bytes unconditionally, going into debt if need be, and
+    // returns how long the caller should hold off before sending them (or,
+    // after the fact, before sending more). Zero when they were available.
+    std::chrono::nanoseconds reserve(size_t bytes);
+
+    std::chrono::milliseconds getDelay(size_t bytes) const; // Until allowBytes() would succeed
+    void waitForBytes(size_t bytes); // Blocking: sleeps once, for the reserved delay
+
+    // Reserves the bytes and runs ready on the loop thread once they may
+    // go out, or inline when they already may. Returns the timer, or 0 when
+    // ready already ran.
+    TimerId waitAsync(EventLoop& loop, size_t bytes, std::function<void()> ready);
+
+    // Configuration
+    void setRate(size_t bytesPerSecond);
+    size_t getRate() const { return bytesPerSecond_.load(std::memory_order_relaxed); }
+    void setBucketSize(size_t bucketSize);
+    size_t getBucketSize() const { return bucketSize_.load(std::memory_order_relaxed); }
+    const std::shared_ptr<RateLimiter>& getParent() const { return parent_; }
+
+    // Statistics, for this bucket alone
+    size_t getAvailableBytes() const;
+    double getUtilization() const;
+    void reset();
+
+private:
+    std::atomic<size_t> bytesPerSecond_;
+    std::atomic<size_t> bucketSize_;
+    std::atomic<int64_t> tat_; // Nanoseconds; the bucket is full while this is in the past
+    std::shared_ptr<RateLimiter> parent_;
+
+    bool takeLocal(size_t bytes, int64_t now);
+    int64_t reserveLocal(size_t bytes, int64_t now); // Nanoseconds of debt beyond the burst
+    int64_t costOf(size_t bytes) const;
+    int64_t burst() const;
+};
+
+} // namespace tcp
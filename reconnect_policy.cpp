@@ -0,0 +1,133 @@
+#include "reconnect_policy.h"
+#include <algorithm>
+
+namespace tcp {
+
+ReconnectPolicy::ReconnectPolicy() : ReconnectPolicy(Config()) {
+}
+
+ReconnectPolicy::ReconnectPolicy(const Config& config)
+    : config_(config), failures_(0), delay_(config.initialDelay), circuit_(CircuitState::Closed),
+      probing_(false), random_(std::random_device{}()) {
+}
+
+ReconnectPolicy::Config ReconnectPolicy::fixedInterval(std::chrono::milliseconds interval) {
+    Config config;
+    config.initialDelay = interval;
+    config.maxDelay = interval;
+    config.jitter = false;
+    return config;
+}
+
+void ReconnectPolicy::recordSuccess() {
+    reset();
+}
+
+void ReconnectPolicy::recordFailure() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto now = Clock::now();
+    failures_++;
+    probing_ = false;
+
+    if (config_.jitter) {
+        // Decorrelated jitter: min(cap, random(base, 3 * previous))
+        auto upper = std::max(config_.initialDelay, delay_ * 3);
+        std::uniform_int_distribution<long long> range(config_.initialDelay.count(), upper.count());
+        delay_ = std::chrono::milliseconds(range(random_));
+    } else if (failures_ > 1) {
+        delay_ = delay_ * 2;
+    }
+    delay_ = std::min(delay_, config_.maxDelay);
+    retryAt_ = now + delay_;
+
+    if (circuit_ == CircuitState::HalfOpen ||
+        (circuit_ == CircuitState::Closed && config_.failureThreshold > 0 && failures_ >= config_.failureThreshold)) {
+        circuit_ = CircuitState::Open;
+        openUntil_ = now + config_.openDuration;
+    }
+}
+
+bool ReconnectPolicy::allowAttempt() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto now = Clock::now();
+    updateCircuit(now);
+
+    if ((config_.maxAttempts > 0 && failures_ >= config_.maxAttempts) || now < retryAt_) {
+        return false;
+    }
+    switch (circuit_) {
+        case CircuitState::Open:
+            return false;
+        case CircuitState::HalfOpen:
+            if (probing_) {
+                return false;
+            }
+            probing_ = true;
+            return true;
+        default:
+            return true;
+    }
+}
+
+std::chrono::milliseconds ReconnectPolicy::nextDelay() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto now = Clock::now();
+    updateCircuit(now);
+
+    if (failures_ == 0 && circuit_ == CircuitState::Closed) {
+        if (!config_.jitter) {
+            return config_.initialDelay;
+        }
+        std::uniform_int_distribution<long long> range(0, config_.initialDelay.count());
+        return std::chrono::milliseconds(range(random_));
+    }
+
+    Clock::time_point until = retryAt_;
+    if (circuit_ == CircuitState::Open) {
+        until = std::max(until, openUntil_);
+    } else if (circuit_ == CircuitState::HalfOpen && probing_) {
+        // Someone else's probe decides; look again a little later
+        until = std::max(until, now + config_.initialDelay);
+    }
+    if (until <= now) {
+        return std::chrono::milliseconds(0);
+    }
+    // Rounded up, so a timer for this delay finds the attempt allowed
+    return std::chrono::duration_cast<std::chrono::milliseconds>(until - now) + std::chrono::milliseconds(1);
+}
+
+bool ReconnectPolicy::isExhausted() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return config_.maxAttempts > 0 && failures_ >= config_.maxAttempts;
+}
+
+void ReconnectPolicy::reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    failures_ = 0;
+    delay_ = config_.initialDelay;
+    retryAt_ = Clock::time_point();
+    circuit_ = CircuitState::Closed;
+    probing_ = false;
+}
+
+ReconnectPolicy::CircuitState ReconnectPolicy::getCircuitState() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (circuit_ == CircuitState::Open && Clock::now() >= openUntil_) {
+        return CircuitState::HalfOpen;
+    }
+    return circuit_;
+}
+
+size_t ReconnectPolicy::getConsecutiveFailures() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return failures_;
+}
+
+void ReconnectPolicy::updateCircuit(Clock::time_point now) {
+    if (circuit_ == CircuitState::Open && now >= openUntil_) {
+        circuit_ = CircuitState::HalfOpen;
+        probing_ = false;
+    }
+}
+
+} // namespace tcp
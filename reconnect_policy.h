@@ -0,0 +1,81 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <cstddef>
+
+namespace tcp {
+
+// When to retry a connection that keeps failing. Delays grow exponentially
+// from the initial delay to the cap with decorrelated jitter (each delay is
+// drawn from [initial, 3 * previous]), so clients that lost a backend
+// together spread their retries out instead of returning in lockstep. After
+// enough consecutive failures a circuit breaker opens: no attempts at all
+// for a while, then a single probe (half-open) that closes or reopens it.
+// Thread-safe; one policy may be shared by many clients of one backend, in
+// which case their failures trip the breaker together.
+class ReconnectPolicy {
+public:
+    struct Config {
+        std::chrono::milliseconds initialDelay{100};
+        std::chrono::milliseconds maxDelay{30000};
+        bool jitter = true;      // Off: exact doubling
+        size_t maxAttempts = 0;  // Consecutive failures before giving up; 0 = never
+        size_t failureThreshold = 0; // Consecutive failures that open the circuit; 0 = never
+        std::chrono::milliseconds openDuration{30000};
+    };
+
+    enum class CircuitState {
+        Closed,   // Attempts allowed, subject to backoff
+        Open,     // Failing fast until openDuration has passed
+        HalfOpen  // One probe in flight or allowed
+    };
+
+    ReconnectPolicy();
+    explicit ReconnectPolicy(const Config& config);
+
+    // The old behaviour: every interval, no jitter, no limits
+    static Config fixedInterval(std::chrono::milliseconds interval);
+
+    // Non-copyable
+    ReconnectPolicy(const ReconnectPolicy&) = delete;
+    ReconnectPolicy& operator=(const ReconnectPolicy&) = delete;
+
+    // Outcome of an attempt
+    void recordSuccess();
+    void recordFailure();
+
+    // True if an attempt may start now: not backing off, not open, not
+    // exhausted. In the half-open state the first caller gets the probe.
+    bool allowAttempt();
+
+    // How long until allowAttempt() may succeed. Before any failure this is
+    // a first delay (jittered within the initial delay), so a fleet that
+    // lost its backend at once does not return at once either.
+    std::chrono::milliseconds nextDelay();
+
+    bool isExhausted() const;
+    void reset();
+
+    CircuitState getCircuitState() const;
+    size_t getConsecutiveFailures() const;
+    const Config& getConfig() const { return config_; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    const Config config_;
+    size_t failures_;
+    std::chrono::milliseconds delay_; // Last backoff
+    Clock::time_point retryAt_;
+    CircuitState circuit_;
+    Clock::time_point openUntil_;
+    bool probing_;
+    std::mt19937 random_;
+    mutable std::mutex mutex_;
+
+    void updateCircuit(Clock::time_point now); // mutex_ held
+};
+
+} // namespace tcp
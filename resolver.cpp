@@ -0,0 +1,217 @@
+#include "resolver.h"
+#include <algorithm>
+#include <cstring>
+
+namespace tcp {
+
+namespace {
+
+constexpr size_t kLookupQueueCapacity = 1024;
+
+} // namespace
+
+Resolver::Resolver(size_t threadCount)
+    : ttl_(30000), negativeTtl_(5000), workers_(std::max<size_t>(1, threadCount), kLookupQueueCapacity) {
+}
+
+void Resolver::resolve(const std::string& host, Callback callback) {
+    SocketAddress numeric;
+    if (host.empty() || SocketAddress::parse(host, 0, numeric)) {
+        callback(query(host));
+        return;
+    }
+
+    Result cached;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto now = std::chrono::steady_clock::now();
+        auto it = cache_.find(host);
+        if (it != cache_.end() && it->second.pending) {
+            it->second.waiting.push_back(std::move(callback));
+            return;
+        }
+
+        if (it != cache_.end() && it->second.expires > now) {
+            cached = it->second.result;
+            cached.fromCache = true;
+        } else {
+            Entry& entry = cache_[host];
+            entry.pending = true;
+            entry.waiting.push_back(std::move(callback));
+        }
+    }
+
+    if (cached.fromCache) {
+        callback(cached);
+        return;
+    }
+
+    if (!workers_.submit([this, host]() { lookup(host); })) {
+        // Shutting down: fail whoever joined the lookup
+        std::vector<Callback> waiting;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = cache_.find(host);
+            if (it != cache_.end()) {
+                waiting.swap(it->second.waiting);
+                cache_.erase(it);
+            }
+        }
+        Result failed;
+        failed.error = "Resolver stopped";
+        for (auto& waiter : waiting) {
+            waiter(failed);
+        }
+    }
+}
+
+Resolver::Result Resolver::resolve(const std::string& host) {
+    SocketAddress numeric;
+    if (host.empty() || SocketAddress::parse(host, 0, numeric)) {
+        return query(host);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = cache_.find(host);
+        if (it != cache_.end() && !it->second.pending && it->second.expires > std::chrono::steady_clock::now()) {
+            Result cached = it->second.result;
+            cached.fromCache = true;
+            return cached;
+        }
+    }
+
+    // On the calling thread; a lookup already in flight keeps its own entry
+    Result result = query(host);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto now = std::chrono::steady_clock::now();
+    Entry& entry = cache_[host];
+    if (!entry.pending) {
+        entry.result = result;
+        entry.expires = now + (result.ok() ? ttl_ : negativeTtl_);
+        evict(now);
+    }
+    return result;
+}
+
+void Resolver::setCacheTtl(std::chrono::milliseconds ttl, std::chrono::milliseconds negativeTtl) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ttl_ = ttl;
+    negativeTtl_ = negativeTtl;
+}
+
+std::chrono::milliseconds Resolver::getCacheTtl() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return ttl_;
+}
+
+void Resolver::invalidate(const std::string& host) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = cache_.find(host);
+    if (it != cache_.end() && !it->second.pending) {
+        cache_.erase(it);
+    }
+}
+
+void Resolver::clearCache() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = cache_.begin(); it != cache_.end();) {
+        it = it->second.pending ? std::next(it) : cache_.erase(it);
+    }
+}
+
+size_t Resolver::getCacheSize() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return cache_.size();
+}
+
+Resolver& Resolver::shared() {
+    static Resolver resolver;
+    return resolver;
+}
+
+void Resolver::lookup(const std::string& host) {
+    Result result = query(host);
+
+    std::vector<Callback> waiting;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto now = std::chrono::steady_clock::now();
+        Entry& entry = cache_[host];
+        entry.result = result;
+        entry.expires = now + (result.ok() ? ttl_ : negativeTtl_);
+        entry.pending = false;
+        waiting.swap(entry.waiting);
+        evict(now);
+    }
+
+    for (auto& callback : waiting) {
+        callback(result);
+    }
+}
+
+void Resolver::evict(std::chrono::steady_clock::time_point now) {
+    if (cache_.size() <= kMaxCacheEntries) {
+        return;
+    }
+
+    // Expired answers first, then whatever comes first
+    for (auto it = cache_.begin(); it != cache_.end();) {
+        it = !it->second.pending && it->second.expires <= now ? cache_.erase(it) : std::next(it);
+    }
+    for (auto it = cache_.begin(); it != cache_.end() && cache_.size() > kMaxCacheEntries;) {
+        it = it->second.pending ? std::next(it) : cache_.erase(it);
+    }
+}
+
+Resolver::Result Resolver::query(const std::string& host) {
+    Result result;
+    if (host.empty()) {
+        result.error = "Empty host name";
+        return result;
+    }
+
+    SocketAddress numeric;
+    if (SocketAddress::parse(host, 0, numeric)) {
+        result.addresses.push_back(numeric);
+        return result;
+    }
+
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+#ifdef AI_ADDRCONFIG
+    hints.ai_flags = AI_ADDRCONFIG; // No AAAA answers without an IPv6 address to use them
+#endif
+
+    struct addrinfo* list = nullptr;
+    int status = getaddrinfo(host.c_str(), nullptr, &hints, &list);
+    if (status != 0) {
+        result.error = gai_strerror(status);
+        return result;
+    }
+
+    for (struct addrinfo* entry = list; entry != nullptr; entry = entry->ai_next) {
+        SocketAddress address(entry->ai_addr, static_cast<socklen_t>(entry->ai_addrlen));
+        if (!address.isValid()) {
+            continue;
+        }
+        bool duplicate = std::any_of(result.addresses.begin(), result.addresses.end(), [&address](const SocketAddress& other) {
+            return other.getLength() == address.getLength() &&
+                   std::memcmp(other.get(), address.get(), address.getLength()) == 0;
+        });
+        if (!duplicate) {
+            result.addresses.push_back(address);
+        }
+    }
+    freeaddrinfo(list);
+
+    if (result.addresses.empty()) {
+        result.error = "No usable addresses for " + host;
+    }
+    return result;
+}
+
+} // namespace tcp
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "tcp_socket.h"
+#include "executor.h"
+#include <vector>
+#include <string>
+#include <chrono>
+#include <mutex>
+#include <functional>
+#include <unordered_map>
+
+namespace tcp {
+
+// Asynchronous host name resolution with a TTL cache, so reconnect loops
+// don't hit DNS on every attempt. getaddrinfo() runs on the resolver's own
+// workers, never queued behind blocking work on the shared Executor, and
+// concurrent lookups of one name share a single query. getaddrinfo()
+// reports no TTL, so answers are kept for a fixed time (failures for a
+// shorter one). Numeric addresses are answered inline.
+class Resolver {
+public:
+    // Addresses in the system's preference order (RFC 6724), port 0
+    struct Result {
+        std::vector<SocketAddress> addresses;
+        std::string error;
+        bool fromCache = false;
+
+        bool ok() const { return !addresses.empty(); }
+    };
+    using Callback = std::function<void(const Result&)>;
+
+    static constexpr size_t kMaxCacheEntries = 1024;
+
+    explicit Resolver(size_t threadCount = 2);
+
+    // Non-copyable
+    Resolver(const Resolver&) = delete;
+    Resolver& operator=(const Resolver&) = delete;
+
+    // The callback runs inline for numeric and cached names, otherwise on a
+    // resolver worker
+    void resolve(const std::string& host, Callback callback);
+    Result resolve(const std::string& host); // Blocking
+
+    // Cache
+    void setCacheTtl(std::chrono::milliseconds ttl, std::chrono::milliseconds negativeTtl);
+    std::chrono::milliseconds getCacheTtl() const;
+    void invalidate(const std::string& host);
+    void clearCache();
+    size_t getCacheSize() const;
+
+    // Process-wide resolver used by TcpClient and the Connector
+    static Resolver& shared();
+
+private:
+    struct Entry {
+        Result result;
+        std::chrono::steady_clock::time_point expires;
+        bool pending = false;
+        std::vector<Callback> waiting; // Joined a lookup in flight
+    };
+
+    std::unordered_map<std::string, Entry> cache_;
+    std::chrono::milliseconds ttl_;
+    std::chrono::milliseconds negativeTtl_;
+    mutable std::mutex mutex_;
+    Executor workers_; // Last, so lookups finish before the cache goes away
+
+    void lookup(const std::string& host);
+    void evict(std::chrono::steady_clock::time_point now); // mutex_ held
+    static Result query(const std::string& host);
+};
+
+} // namespace tcp
@@ -0,0 +1,299 @@
+#include "ring_buffer.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace tcp {
+
+namespace {
+
+constexpr size_t kMinRingCapacity = 64;
+
+size_t roundUpToPowerOfTwo(size_t value) {
+    size_t rounded = kMinRingCapacity;
+    while (rounded < value) {
+        rounded <<= 1;
+    }
+    return rounded;
+}
+
+#ifndef _WIN32
+// Anonymous shared memory to map twice; -1 if there is none
+int createSharedMemory(size_t size) {
+    int fd = -1;
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+    fd = memfd_create("tcp-ring", MFD_CLOEXEC);
+#else
+    static std::atomic<unsigned> sequence(0);
+    std::string name = "/tcp-ring-" + std::to_string(getpid()) + "-" + std::to_string(sequence++);
+    fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd >= 0) {
+        shm_unlink(name.c_str());
+    }
+#endif
+    if (fd >= 0 && ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+#endif
+
+} // namespace
+
+// RingMemory
+
+RingMemory::RingMemory(size_t capacity, bool mirrored)
+    : data_(nullptr), capacity_(roundUpToPowerOfTwo(capacity)), mirrored_(false) {
+#ifndef _WIN32
+    if (mirrored) {
+        // Each copy must be whole pages
+        size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        capacity_ = roundUpToPowerOfTwo(std::max(capacity_, page));
+        mirrored_ = mapMirrored();
+    }
+#endif
+    if (!mirrored_) {
+        heap_.resize(capacity_);
+        data_ = heap_.data();
+    }
+}
+
+RingMemory::~RingMemory() {
+#ifndef _WIN32
+    if (mirrored_) {
+        munmap(data_, capacity_ * 2);
+    }
+#endif
+}
+
+bool RingMemory::mapMirrored() {
+#ifdef _WIN32
+    return false;
+#else
+    int fd = createSharedMemory(capacity_);
+    if (fd < 0) {
+        return false;
+    }
+
+    // Reserve both halves first so nothing else lands in between
+    void* base = mmap(nullptr, capacity_ * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+    uint8_t* first = static_cast<uint8_t*>(base);
+    bool mapped =
+        mmap(first, capacity_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == first &&
+        mmap(first + capacity_, capacity_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == first + capacity_;
+    close(fd);
+
+    if (!mapped) {
+        munmap(base, capacity_ * 2);
+        return false;
+    }
+    data_ = first;
+    return true;
+#endif
+}
+
+void RingMemory::copyIn(size_t position, const void* data, size_t length) {
+    size_t index = position & (capacity_ - 1);
+    size_t first = mirrored_ ? length : std::min(length, capacity_ - index);
+    std::memcpy(data_ + index, data, first);
+    if (first < length) {
+        std::memcpy(data_, static_cast<const uint8_t*>(data) + first, length - first);
+    }
+}
+
+void RingMemory::copyOut(size_t position, void* data, size_t length) const {
+    size_t index = position & (capacity_ - 1);
+    size_t first = mirrored_ ? length : std::min(length, capacity_ - index);
+    std::memcpy(data, data_ + index, first);
+    if (first < length) {
+        std::memcpy(static_cast<uint8_t*>(data) + first, data_, length - first);
+    }
+}
+
+// SpscRingBuffer
+
+SpscRingBuffer::SpscRingBuffer(size_t capacity, bool mirrored)
+    : memory_(capacity, mirrored), mask_(memory_.capacity() - 1),
+      head_(0), cachedTail_(0), tail_(0), cachedHead_(0) {
+}
+
+size_t SpscRingBuffer::write(const void* data, size_t length) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t space = getCapacity() - (tail - cachedHead_);
+    if (space < length) {
+        cachedHead_ = head_.load(std::memory_order_acquire);
+        space = getCapacity() - (tail - cachedHead_);
+    }
+
+    size_t written = std::min(length, space);
+    if (written > 0) {
+        memory_.copyIn(tail, data, written);
+        tail_.store(tail + written, std::memory_order_release);
+    }
+    return written;
+}
+
+uint8_t* SpscRingBuffer::writable(size_t& length) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t space = writableSize();
+    size_t index = tail & mask_;
+    length = isMirrored() ? space : std::min(space, getCapacity() - index);
+    return memory_.data() + index;
+}
+
+void SpscRingBuffer::commit(size_t length) {
+    tail_.store(tail_.load(std::memory_order_relaxed) + length, std::memory_order_release);
+}
+
+size_t SpscRingBuffer::read(void* data, size_t length) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    size_t available = cachedTail_ - head;
+    if (available < length) {
+        available = readableSize();
+    }
+
+    size_t count = std::min(length, available);
+    if (count > 0) {
+        memory_.copyOut(head, data, count);
+        head_.store(head + count, std::memory_order_release);
+    }
+    return count;
+}
+
+size_t SpscRingBuffer::peek(void* data, size_t length) const {
+    size_t head = head_.load(std::memory_order_relaxed);
+    size_t count = std::min(length, readableSize());
+    memory_.copyOut(head, data, count);
+    return count;
+}
+
+void SpscRingBuffer::skip(size_t length) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    size_t available = cachedTail_ - head;
+    if (available < length) {
+        available = readableSize();
+    }
+    head_.store(head + std::min(length, available), std::memory_order_release);
+}
+
+ByteView SpscRingBuffer::readable() const {
+    size_t head = head_.load(std::memory_order_relaxed);
+    size_t available = readableSize();
+    size_t index = head & mask_;
+    size_t length = isMirrored() ? available : std::min(available, getCapacity() - index);
+    return ByteView(memory_.data() + index, length);
+}
+
+void SpscRingBuffer::clear() {
+    head_.store(tail_.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+size_t SpscRingBuffer::getSize() const {
+    // Head first: the tail never falls behind the head read before it
+    size_t head = head_.load(std::memory_order_acquire);
+    return tail_.load(std::memory_order_acquire) - head;
+}
+
+size_t SpscRingBuffer::readableSize() const {
+    cachedTail_ = tail_.load(std::memory_order_acquire);
+    return cachedTail_ - head_.load(std::memory_order_relaxed);
+}
+
+size_t SpscRingBuffer::writableSize() {
+    cachedHead_ = head_.load(std::memory_order_acquire);
+    return getCapacity() - (tail_.load(std::memory_order_relaxed) - cachedHead_);
+}
+
+// MpscRingBuffer
+
+MpscRingBuffer::MpscRingBuffer(size_t capacity, bool mirrored)
+    : memory_(capacity, mirrored), mask_(memory_.capacity() - 1),
+      reserved_(0), published_(0), head_(0) {
+}
+
+size_t MpscRingBuffer::write(const void* data, size_t length) {
+    if (length == 0 || length > getCapacity()) {
+        return 0;
+    }
+
+    size_t position = reserved_.load(std::memory_order_relaxed);
+    for (;;) {
+        // A stale position may already be behind the head; the CAS then
+        // fails and reloads it
+        size_t head = head_.load(std::memory_order_acquire);
+        if (position >= head && position + length - head > getCapacity()) {
+            return 0;
+        }
+        if (reserved_.compare_exchange_weak(position, position + length, std::memory_order_relaxed)) {
+            break;
+        }
+    }
+
+    memory_.copyIn(position, data, length);
+
+    // Publish in claim order
+    while (published_.load(std::memory_order_acquire) != position) {
+        std::this_thread::yield();
+    }
+    published_.store(position + length, std::memory_order_release);
+    return length;
+}
+
+size_t MpscRingBuffer::read(void* data, size_t length) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    size_t count = std::min(length, published_.load(std::memory_order_acquire) - head);
+    if (count > 0) {
+        memory_.copyOut(head, data, count);
+        head_.store(head + count, std::memory_order_release);
+    }
+    return count;
+}
+
+size_t MpscRingBuffer::peek(void* data, size_t length) const {
+    size_t head = head_.load(std::memory_order_relaxed);
+    size_t count = std::min(length, published_.load(std::memory_order_acquire) - head);
+    memory_.copyOut(head, data, count);
+    return count;
+}
+
+void MpscRingBuffer::skip(size_t length) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    size_t count = std::min(length, published_.load(std::memory_order_acquire) - head);
+    head_.store(head + count, std::memory_order_release);
+}
+
+ByteView MpscRingBuffer::readable() const {
+    size_t head = head_.load(std::memory_order_relaxed);
+    size_t available = published_.load(std::memory_order_acquire) - head;
+    size_t index = head & mask_;
+    size_t length = isMirrored() ? available : std::min(available, getCapacity() - index);
+    return ByteView(memory_.data() + index, length);
+}
+
+void MpscRingBuffer::clear() {
+    head_.store(published_.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+size_t MpscRingBuffer::getSize() const {
+    size_t head = head_.load(std::memory_order_acquire);
+    return published_.load(std::memory_order_acquire) - head;
+}
+
+size_t MpscRingBuffer::getAvailableSpace() const {
+    size_t head = head_.load(std::memory_order_acquire);
+    return getCapacity() - (reserved_.load(std::memory_order_acquire) - head);
+}
+
+} // namespace tcp
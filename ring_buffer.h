@@ -0,0 +1,132 @@
+#pragma once
+
+#include "tcp_buffer.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tcp {
+
+// Backing store for the lock-free rings: a power-of-two block, optionally
+// mapped twice back to back (the same pages at data() and data() +
+// capacity()), so any run of up to capacity() bytes starting anywhere in
+// the first copy is contiguous. Mirroring needs shared memory and page
+// granularity; where it isn't available (Windows, or the mapping fails)
+// the ring falls back to one plain block and isMirrored() says so.
+class RingMemory {
+public:
+    RingMemory(size_t capacity, bool mirrored);
+    ~RingMemory();
+
+    // Non-copyable
+    RingMemory(const RingMemory&) = delete;
+    RingMemory& operator=(const RingMemory&) = delete;
+
+    uint8_t* data() const { return data_; }
+    size_t capacity() const { return capacity_; }
+    bool isMirrored() const { return mirrored_; }
+
+    // At most two memcpys across the wrap point (one when mirrored)
+    void copyIn(size_t position, const void* data, size_t length);
+    void copyOut(size_t position, void* data, size_t length) const;
+
+private:
+    uint8_t* data_;
+    size_t capacity_;
+    bool mirrored_;
+    std::vector<uint8_t> heap_; // When not mirrored
+
+    bool mapMirrored();
+};
+
+// Lock-free byte ring for one producer thread and one consumer thread. The
+// capacity is rounded up to a power of two; positions only grow, so the
+// index is a mask away. Head and tail live on separate cache lines, and
+// each side caches the other's position so it only reads the shared one
+// when its cache says the ring looks full (or empty).
+class SpscRingBuffer {
+public:
+    explicit SpscRingBuffer(size_t capacity, bool mirrored = false);
+
+    // Non-copyable
+    SpscRingBuffer(const SpscRingBuffer&) = delete;
+    SpscRingBuffer& operator=(const SpscRingBuffer&) = delete;
+
+    // Producer. write() copies what fits; writable()/commit() let the
+    // producer fill the ring in place, e.g. straight from recv().
+    size_t write(const void* data, size_t length);
+    uint8_t* writable(size_t& length); // Contiguous free space, up to the wrap unless mirrored
+    void commit(size_t length);
+
+    // Consumer. readable() is every buffered byte when mirrored, otherwise
+    // those up to the wrap; it stays valid until consume().
+    size_t read(void* data, size_t length);
+    size_t peek(void* data, size_t length) const;
+    void skip(size_t length);
+    ByteView readable() const;
+    void consume(size_t length) { skip(length); }
+    void clear(); // Consumer side: drops everything written so far
+
+    size_t getCapacity() const { return memory_.capacity(); }
+    size_t getSize() const; // Exact only on the producer or consumer thread
+    size_t getAvailableSpace() const { return getCapacity() - getSize(); }
+    bool isEmpty() const { return getSize() == 0; }
+    bool isFull() const { return getSize() == getCapacity(); }
+    bool isMirrored() const { return memory_.isMirrored(); }
+
+private:
+    RingMemory memory_;
+    size_t mask_;
+
+    // Consumer's line
+    alignas(64) std::atomic<size_t> head_;
+    mutable size_t cachedTail_;
+
+    // Producer's line
+    alignas(64) std::atomic<size_t> tail_;
+    size_t cachedHead_;
+
+    size_t readableSize() const; // Consumer
+    size_t writableSize();       // Producer
+};
+
+// Lock-free byte ring for many producer threads and one consumer. Each
+// write() is all or nothing, so concurrent writes never interleave: a
+// producer claims its range with a CAS, copies, then publishes in claim
+// order (briefly waiting for earlier claimants to publish theirs).
+class MpscRingBuffer {
+public:
+    explicit MpscRingBuffer(size_t capacity, bool mirrored = false);
+
+    // Non-copyable
+    MpscRingBuffer(const MpscRingBuffer&) = delete;
+    MpscRingBuffer& operator=(const MpscRingBuffer&) = delete;
+
+    // Any thread. Returns length, or 0 if it doesn't fit.
+    size_t write(const void* data, size_t length);
+
+    // Consumer, as in SpscRingBuffer
+    size_t read(void* data, size_t length);
+    size_t peek(void* data, size_t length) const;
+    void skip(size_t length);
+    ByteView readable() const;
+    void consume(size_t length) { skip(length); }
+    void clear();
+
+    size_t getCapacity() const { return memory_.capacity(); }
+    size_t getSize() const; // Published bytes
+    size_t getAvailableSpace() const;
+    bool isEmpty() const { return getSize() == 0; }
+    bool isMirrored() const { return memory_.isMirrored(); }
+
+private:
+    RingMemory memory_;
+    size_t mask_;
+
+    alignas(64) std::atomic<size_t> reserved_;  // Claimed by producers
+    alignas(64) std::atomic<size_t> published_; // Visible to the consumer
+    alignas(64) std::atomic<size_t> head_;      // Consumer
+};
+
+} // namespace tcp
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cerrno>
+
+#ifndef _WIN32
+#include <sys/socket.h> // SO_NOSIGPIPE
+#endif
+
+#if !defined(_WIN32) && !defined(SO_NOSIGPIPE)
+#include <csignal>
+#include <ctime>
+#include <pthread.h>
+#endif
+
+namespace tcp {
+
+// Writes that cannot pass MSG_NOSIGNAL (OpenSSL's socket BIO, sendfile)
+// raise SIGPIPE once the peer is gone. Without SO_NOSIGPIPE the signal is
+// blocked for the call and a pending one is discarded before unblocking.
+class SigpipeGuard {
+public:
+#if !defined(_WIN32) && !defined(SO_NOSIGPIPE)
+    SigpipeGuard() {
+        sigemptyset(&pipeSet_);
+        sigaddset(&pipeSet_, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &pipeSet_, &previous_);
+    }
+
+    ~SigpipeGuard() {
+        int savedErrno = errno;
+        if (savedErrno == EPIPE && !sigismember(&previous_, SIGPIPE)) {
+            struct timespec zero = {0, 0};
+            while (sigtimedwait(&pipeSet_, nullptr, &zero) == SIGPIPE) {
+            }
+        }
+        pthread_sigmask(SIG_SETMASK, &previous_, nullptr);
+        errno = savedErrno;
+    }
+
+private:
+    sigset_t pipeSet_;
+    sigset_t previous_;
+#endif
+};
+
+} // namespace tcp
@@ -0,0 +1,1019 @@
+#include "ssl_context.h"
+#include "tcp_socket.h"
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <unordered_map>
+
+namespace tcp {
+
+#ifdef TCP_SSL_SUPPORT
+
+bool SslContext::sslInitialized_ = false;
+std::mutex SslContext::sslMutex_;
+
+// Data OpenSSL callbacks need. Heap-allocated so the pointer registered with
+// the SSL_CTX stays valid when the owning SslContext is moved.
+struct SslContext::CallbackState {
+    std::vector<unsigned char> alpnWire; // Length-prefixed protocol list
+
+    // Client sessions by peer key ("host:port")
+    mutable std::mutex sessionsMutex;
+    std::unordered_map<std::string, SSL_SESSION*> sessions;
+    size_t maxSessions = kDefaultSessionCacheSize;
+
+    ~CallbackState() {
+        for (auto& entry : sessions) {
+            SSL_SESSION_free(entry.second);
+        }
+    }
+};
+
+namespace {
+
+// Sessions are only resumed by servers sharing this context id
+const unsigned char kSessionIdContext[] = "tcp";
+
+SSL_CTX* nativeContext(void* context) {
+    return static_cast<SSL_CTX*>(context);
+}
+
+const SSL_METHOD* selectMethod(SslContext::Method method) {
+    switch (method) {
+        case SslContext::Method::TLS_CLIENT: return TLS_client_method();
+        case SslContext::Method::TLS_SERVER: return TLS_server_method();
+        case SslContext::Method::DTLS: return DTLS_method();
+        case SslContext::Method::DTLS_CLIENT: return DTLS_client_method();
+        case SslContext::Method::DTLS_SERVER: return DTLS_server_method();
+        default: return TLS_method();
+    }
+}
+
+bool isDtls(SslContext::Method method) {
+    return method == SslContext::Method::DTLS ||
+           method == SslContext::Method::DTLS_CLIENT ||
+           method == SslContext::Method::DTLS_SERVER;
+}
+
+int toVerifyFlags(SslContext::VerifyMode mode) {
+    switch (mode) {
+        case SslContext::VerifyMode::Peer: return SSL_VERIFY_PEER;
+        case SslContext::VerifyMode::FailIfNoPeer: return SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT;
+        case SslContext::VerifyMode::Once: return SSL_VERIFY_PEER | SSL_VERIFY_CLIENT_ONCE;
+        default: return SSL_VERIFY_NONE;
+    }
+}
+
+std::vector<uint8_t> drainBio(BIO* bio) {
+    char* data = nullptr;
+    long length = BIO_get_mem_data(bio, &data);
+    if (length <= 0 || !data) {
+        return {};
+    }
+    return std::vector<uint8_t>(data, data + length);
+}
+
+std::string bioToString(BIO* bio) {
+    std::vector<uint8_t> data = drainBio(bio);
+    return std::string(data.begin(), data.end());
+}
+
+std::string nameToString(X509_NAME* name) {
+    BIO* bio = BIO_new(BIO_s_mem());
+    X509_NAME_print_ex(bio, name, 0, XN_FLAG_RFC2253);
+    std::string result = bioToString(bio);
+    BIO_free(bio);
+    return result;
+}
+
+std::string timeToString(const ASN1_TIME* time) {
+    BIO* bio = BIO_new(BIO_s_mem());
+    ASN1_TIME_print(bio, time);
+    std::string result = bioToString(bio);
+    BIO_free(bio);
+    return result;
+}
+
+std::vector<std::string> altNames(X509* cert, int nid) {
+    std::vector<std::string> names;
+    auto* entries = static_cast<GENERAL_NAMES*>(X509_get_ext_d2i(cert, nid, nullptr, nullptr));
+    if (!entries) {
+        return names;
+    }
+
+    for (int i = 0; i < sk_GENERAL_NAME_num(entries); i++) {
+        const GENERAL_NAME* entry = sk_GENERAL_NAME_value(entries, i);
+        if (entry->type == GEN_DNS || entry->type == GEN_EMAIL || entry->type == GEN_URI) {
+            const ASN1_IA5STRING* value = entry->d.ia5;
+            names.emplace_back(reinterpret_cast<const char*>(ASN1_STRING_get0_data(value)), ASN1_STRING_length(value));
+        } else if (entry->type == GEN_IPADD) {
+            const ASN1_OCTET_STRING* value = entry->d.iPAddress;
+            char text[INET6_ADDRSTRLEN] = {};
+            int family = ASN1_STRING_length(value) == 4 ? AF_INET : AF_INET6;
+            if (inet_ntop(family, ASN1_STRING_get0_data(value), text, sizeof(text))) {
+                names.emplace_back(text);
+            }
+        }
+    }
+
+    GENERAL_NAMES_free(entries);
+    return names;
+}
+
+CertificateInfo describeCertificate(X509* cert) {
+    CertificateInfo info{};
+    info.subject = nameToString(X509_get_subject_name(cert));
+    info.issuer = nameToString(X509_get_issuer_name(cert));
+    info.version = std::to_string(X509_get_version(cert) + 1);
+    info.notBefore = timeToString(X509_get0_notBefore(cert));
+    info.notAfter = timeToString(X509_get0_notAfter(cert));
+    info.subjectAltNames = altNames(cert, NID_subject_alt_name);
+    info.issuerAltNames = altNames(cert, NID_issuer_alt_name);
+
+    if (BIGNUM* serial = ASN1_INTEGER_to_BN(X509_get0_serialNumber(cert), nullptr)) {
+        if (char* hex = BN_bn2hex(serial)) {
+            info.serialNumber = hex;
+            OPENSSL_free(hex);
+        }
+        BN_free(serial);
+    }
+
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digestLength = 0;
+    if (X509_digest(cert, EVP_sha256(), digest, &digestLength)) {
+        std::ostringstream fingerprint;
+        for (unsigned int i = 0; i < digestLength; i++) {
+            if (i > 0) {
+                fingerprint << ':';
+            }
+            fingerprint << std::hex << std::uppercase << std::setw(2) << std::setfill('0') << static_cast<int>(digest[i]);
+        }
+        info.fingerprint = fingerprint.str();
+    }
+
+    if (EVP_PKEY* key = X509_get0_pubkey(cert)) {
+        info.keyBits = EVP_PKEY_bits(key);
+        info.keyAlgorithm = OBJ_nid2sn(EVP_PKEY_base_id(key));
+    }
+    info.signatureAlgorithm = OBJ_nid2ln(X509_get_signature_nid(cert));
+
+    info.isSelfSigned = X509_check_issued(cert, cert) == X509_V_OK;
+    info.isExpired = X509_cmp_current_time(X509_get0_notAfter(cert)) < 0;
+    info.isValid = !info.isExpired && X509_cmp_current_time(X509_get0_notBefore(cert)) <= 0;
+    return info;
+}
+
+// Parses PEM, falling back to DER
+X509* readCertificate(const std::vector<uint8_t>& data) {
+    BIO* bio = BIO_new_mem_buf(data.data(), static_cast<int>(data.size()));
+    X509* cert = PEM_read_bio_X509(bio, nullptr, nullptr, nullptr);
+    BIO_free(bio);
+    if (cert) {
+        return cert;
+    }
+
+    ERR_clear_error();
+    const unsigned char* cursor = data.data();
+    return d2i_X509(nullptr, &cursor, static_cast<long>(data.size()));
+}
+
+bool readFile(const std::string& path, std::vector<uint8_t>& data) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+bool matchesHostname(const std::string& pattern, const std::string& hostname) {
+    auto lower = [](std::string text) {
+        std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return std::tolower(c); });
+        return text;
+    };
+    std::string name = lower(pattern);
+    std::string host = lower(hostname);
+
+    // "*.example.com" covers exactly one label
+    if (name.size() > 2 && name[0] == '*' && name[1] == '.') {
+        size_t dot = host.find('.');
+        return dot != std::string::npos && dot > 0 && host.compare(dot, std::string::npos, name, 1, std::string::npos) == 0;
+    }
+    return name == host;
+}
+
+} // namespace
+
+// SslContext implementation
+SslContext::SslContext(Method method)
+    : context_(nullptr), method_(method), verifyMode_(VerifyMode::None), verifyDepth_(9),
+      kernelTls_(false), callbackState_(new CallbackState()) {
+    initialize();
+}
+
+SslContext::~SslContext() {
+    cleanup();
+}
+
+SslContext::SslContext(SslContext&& other) noexcept
+    : context_(other.context_), method_(other.method_), verifyMode_(other.verifyMode_),
+      verifyDepth_(other.verifyDepth_), sniHostname_(std::move(other.sniHostname_)),
+      alpnProtocols_(std::move(other.alpnProtocols_)), cipherSuites_(std::move(other.cipherSuites_)),
+      kernelTls_(other.kernelTls_), callbackState_(std::move(other.callbackState_)),
+      lastError_(std::move(other.lastError_)) {
+    other.context_ = nullptr;
+}
+
+SslContext& SslContext::operator=(SslContext&& other) noexcept {
+    if (this != &other) {
+        cleanup();
+        context_ = other.context_;
+        method_ = other.method_;
+        verifyMode_ = other.verifyMode_;
+        verifyDepth_ = other.verifyDepth_;
+        sniHostname_ = std::move(other.sniHostname_);
+        alpnProtocols_ = std::move(other.alpnProtocols_);
+        cipherSuites_ = std::move(other.cipherSuites_);
+        kernelTls_ = other.kernelTls_;
+        callbackState_ = std::move(other.callbackState_);
+        lastError_ = std::move(other.lastError_);
+        other.context_ = nullptr;
+    }
+    return *this;
+}
+
+bool SslContext::loadCertificate(const std::string& certFile) {
+    if (!isValid() || SSL_CTX_use_certificate_file(nativeContext(context_), certFile.c_str(), SSL_FILETYPE_PEM) != 1) {
+        setLastError("Failed to load certificate " + certFile + ": " + SslUtils::getLastSslError());
+        return false;
+    }
+    return true;
+}
+
+bool SslContext::loadCertificateChain(const std::string& chainFile) {
+    if (!isValid() || SSL_CTX_use_certificate_chain_file(nativeContext(context_), chainFile.c_str()) != 1) {
+        setLastError("Failed to load certificate chain " + chainFile + ": " + SslUtils::getLastSslError());
+        return false;
+    }
+    return true;
+}
+
+bool SslContext::loadPrivateKey(const std::string& keyFile) {
+    SSL_CTX* ctx = nativeContext(context_);
+    if (!isValid() || SSL_CTX_use_PrivateKey_file(ctx, keyFile.c_str(), SSL_FILETYPE_PEM) != 1) {
+        setLastError("Failed to load private key " + keyFile + ": " + SslUtils::getLastSslError());
+        return false;
+    }
+    if (SSL_CTX_get0_certificate(ctx) && SSL_CTX_check_private_key(ctx) != 1) {
+        setLastError("Private key does not match the certificate");
+        return false;
+    }
+    return true;
+}
+
+bool SslContext::loadCertificateFromMemory(const std::vector<uint8_t>& certData) {
+    if (!isValid()) {
+        return false;
+    }
+
+    // Leaf first, any following certificates form the chain
+    BIO* bio = BIO_new_mem_buf(certData.data(), static_cast<int>(certData.size()));
+    X509* cert = PEM_read_bio_X509(bio, nullptr, nullptr, nullptr);
+    bool success = cert && SSL_CTX_use_certificate(nativeContext(context_), cert) == 1;
+    X509_free(cert);
+
+    while (success) {
+        X509* chainCert = PEM_read_bio_X509(bio, nullptr, nullptr, nullptr);
+        if (!chainCert) {
+            ERR_clear_error(); // End of input
+            break;
+        }
+        if (SSL_CTX_add0_chain_cert(nativeContext(context_), chainCert) != 1) {
+            X509_free(chainCert);
+            success = false;
+        }
+    }
+    BIO_free(bio);
+
+    if (!success) {
+        setLastError("Failed to load certificate: " + SslUtils::getLastSslError());
+    }
+    return success;
+}
+
+bool SslContext::loadPrivateKeyFromMemory(const std::vector<uint8_t>& keyData) {
+    if (!isValid()) {
+        return false;
+    }
+
+    BIO* bio = BIO_new_mem_buf(keyData.data(), static_cast<int>(keyData.size()));
+    EVP_PKEY* key = PEM_read_bio_PrivateKey(bio, nullptr, nullptr, nullptr);
+    BIO_free(bio);
+
+    SSL_CTX* ctx = nativeContext(context_);
+    bool success = key && SSL_CTX_use_PrivateKey(ctx, key) == 1;
+    EVP_PKEY_free(key);
+    if (!success) {
+        setLastError("Failed to load private key: " + SslUtils::getLastSslError());
+        return false;
+    }
+    if (SSL_CTX_get0_certificate(ctx) && SSL_CTX_check_private_key(ctx) != 1) {
+        setLastError("Private key does not match the certificate");
+        return false;
+    }
+    return true;
+}
+
+bool SslContext::loadCaCertificate(const std::string& caCertFile) {
+    if (!isValid() || SSL_CTX_load_verify_locations(nativeContext(context_), caCertFile.c_str(), nullptr) != 1) {
+        setLastError("Failed to load CA certificate " + caCertFile + ": " + SslUtils::getLastSslError());
+        return false;
+    }
+    return true;
+}
+
+bool SslContext::loadCaCertificateDir(const std::string& caCertDir) {
+    if (!isValid() || SSL_CTX_load_verify_locations(nativeContext(context_), nullptr, caCertDir.c_str()) != 1) {
+        setLastError("Failed to load CA directory " + caCertDir + ": " + SslUtils::getLastSslError());
+        return false;
+    }
+    return true;
+}
+
+bool SslContext::loadCaCertificateFromMemory(const std::vector<uint8_t>& caCertData) {
+    if (!isValid()) {
+        return false;
+    }
+
+    X509_STORE* store = SSL_CTX_get_cert_store(nativeContext(context_));
+    BIO* bio = BIO_new_mem_buf(caCertData.data(), static_cast<int>(caCertData.size()));
+    size_t loaded = 0;
+    while (X509* cert = PEM_read_bio_X509(bio, nullptr, nullptr, nullptr)) {
+        if (X509_STORE_add_cert(store, cert) == 1) {
+            loaded++;
+        }
+        X509_free(cert);
+    }
+    ERR_clear_error(); // End of input
+    BIO_free(bio);
+
+    if (loaded == 0) {
+        setLastError("No CA certificates found");
+        return false;
+    }
+    return true;
+}
+
+void SslContext::setVerifyMode(VerifyMode mode) {
+    verifyMode_ = mode;
+    if (isValid()) {
+        SSL_CTX_set_verify(nativeContext(context_), toVerifyFlags(mode), [](int preverifyOk, X509_STORE_CTX* store) {
+            return verifyCallback(preverifyOk, store);
+        });
+    }
+}
+
+void SslContext::setVerifyDepth(int depth) {
+    verifyDepth_ = depth;
+    if (isValid()) {
+        SSL_CTX_set_verify_depth(nativeContext(context_), depth);
+    }
+}
+
+bool SslContext::setCipherSuites(const std::string& ciphers) {
+    if (!isValid()) {
+        return false;
+    }
+
+    // TLS 1.3 suites ("TLS_...") and TLS 1.2 cipher strings are configured separately
+    std::string suites;
+    std::string legacy;
+    std::istringstream stream(ciphers);
+    std::string name;
+    while (std::getline(stream, name, ':')) {
+        if (name.empty()) {
+            continue;
+        }
+        std::string& target = name.compare(0, 4, "TLS_") == 0 ? suites : legacy;
+        target += (target.empty() ? "" : ":") + name;
+    }
+
+    SSL_CTX* ctx = nativeContext(context_);
+    if ((!suites.empty() && SSL_CTX_set_ciphersuites(ctx, suites.c_str()) != 1) ||
+        (!legacy.empty() && SSL_CTX_set_cipher_list(ctx, legacy.c_str()) != 1)) {
+        setLastError("Invalid cipher list: " + SslUtils::getLastSslError());
+        return false;
+    }
+
+    cipherSuites_ = ciphers;
+    return true;
+}
+
+std::string SslContext::getCipherSuites() const {
+    return cipherSuites_;
+}
+
+bool SslContext::setMinProtocolVersion(int version) {
+    return isValid() && SSL_CTX_set_min_proto_version(nativeContext(context_), version) == 1;
+}
+
+bool SslContext::setMaxProtocolVersion(int version) {
+    return isValid() && SSL_CTX_set_max_proto_version(nativeContext(context_), version) == 1;
+}
+
+int SslContext::getMinProtocolVersion() const {
+    return isValid() ? static_cast<int>(SSL_CTX_get_min_proto_version(nativeContext(context_))) : 0;
+}
+
+int SslContext::getMaxProtocolVersion() const {
+    return isValid() ? static_cast<int>(SSL_CTX_get_max_proto_version(nativeContext(context_))) : 0;
+}
+
+void SslContext::setSessionCacheMode(int mode) {
+    if (isValid()) {
+        SSL_CTX_set_session_cache_mode(nativeContext(context_), mode);
+    }
+}
+
+int SslContext::getSessionCacheMode() const {
+    return isValid() ? static_cast<int>(SSL_CTX_get_session_cache_mode(nativeContext(context_))) : 0;
+}
+
+void SslContext::setSessionTimeout(long timeout) {
+    if (isValid()) {
+        SSL_CTX_set_timeout(nativeContext(context_), timeout);
+    }
+}
+
+long SslContext::getSessionTimeout() const {
+    return isValid() ? SSL_CTX_get_timeout(nativeContext(context_)) : 0;
+}
+
+void SslContext::setSessionTickets(bool enable) {
+    if (!isValid()) {
+        return;
+    }
+    if (enable) {
+        SSL_CTX_clear_options(nativeContext(context_), SSL_OP_NO_TICKET);
+    } else {
+        SSL_CTX_set_options(nativeContext(context_), SSL_OP_NO_TICKET);
+    }
+}
+
+bool SslContext::getSessionTickets() const {
+    return isValid() && (SSL_CTX_get_options(nativeContext(context_)) & SSL_OP_NO_TICKET) == 0;
+}
+
+void SslContext::setClientSessionCacheSize(size_t maxSessions) {
+    std::lock_guard<std::mutex> lock(callbackState_->sessionsMutex);
+    callbackState_->maxSessions = maxSessions;
+    while (callbackState_->sessions.size() > maxSessions) {
+        auto victim = callbackState_->sessions.begin();
+        SSL_SESSION_free(victim->second);
+        callbackState_->sessions.erase(victim);
+    }
+}
+
+size_t SslContext::getCachedSessionCount() const {
+    std::lock_guard<std::mutex> lock(callbackState_->sessionsMutex);
+    return callbackState_->sessions.size();
+}
+
+void SslContext::clearSessionCache() {
+    std::lock_guard<std::mutex> lock(callbackState_->sessionsMutex);
+    for (auto& entry : callbackState_->sessions) {
+        SSL_SESSION_free(entry.second);
+    }
+    callbackState_->sessions.clear();
+}
+
+void* SslContext::findSession(const std::string& peerKey) const {
+    std::lock_guard<std::mutex> lock(callbackState_->sessionsMutex);
+    auto it = callbackState_->sessions.find(peerKey);
+    if (it == callbackState_->sessions.end() || !SSL_SESSION_is_resumable(it->second)) {
+        return nullptr;
+    }
+    SSL_SESSION_up_ref(it->second);
+    return it->second;
+}
+
+bool SslContext::setKernelTlsOffload(bool enable) {
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+    if (!isValid()) {
+        return false;
+    }
+    if (enable) {
+        SSL_CTX_set_options(nativeContext(context_), SSL_OP_ENABLE_KTLS);
+    } else {
+        SSL_CTX_clear_options(nativeContext(context_), SSL_OP_ENABLE_KTLS);
+    }
+    kernelTls_ = enable;
+    return true;
+#else
+    if (enable) {
+        setLastError("OpenSSL was built without kernel TLS support");
+        return false;
+    }
+    return true;
+#endif
+}
+
+bool SslContext::isKernelTlsSupported() {
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool SslContext::setSniHostname(const std::string& hostname) {
+    sniHostname_ = hostname;
+    return true;
+}
+
+bool SslContext::setAlpnProtocols(const std::vector<std::string>& protocols) {
+    std::vector<unsigned char> wire;
+    for (const auto& protocol : protocols) {
+        if (protocol.empty() || protocol.size() > 255) {
+            setLastError("Invalid ALPN protocol name");
+            return false;
+        }
+        wire.push_back(static_cast<unsigned char>(protocol.size()));
+        wire.insert(wire.end(), protocol.begin(), protocol.end());
+    }
+
+    // Offered by clients; servers pick from it in the select callback.
+    // Note SSL_CTX_set_alpn_protos() returns 0 on success.
+    if (!isValid() || SSL_CTX_set_alpn_protos(nativeContext(context_), wire.data(), static_cast<unsigned int>(wire.size())) != 0) {
+        setLastError("Failed to set ALPN protocols");
+        return false;
+    }
+
+    alpnProtocols_ = protocols;
+    callbackState_->alpnWire = std::move(wire);
+    return true;
+}
+
+std::vector<std::string> SslContext::getAlpnProtocols() const {
+    return alpnProtocols_;
+}
+
+bool SslContext::isValid() const {
+    return context_ != nullptr;
+}
+
+std::string SslContext::getLastError() const {
+    return lastError_;
+}
+
+std::string SslContext::getOpenSslVersion() {
+    return OpenSSL_version(OPENSSL_VERSION);
+}
+
+std::vector<std::string> SslContext::getAvailableCiphers() {
+    initializeOpenSsl();
+    std::vector<std::string> ciphers;
+
+    SSL_CTX* ctx = SSL_CTX_new(TLS_method());
+    SSL* ssl = ctx ? SSL_new(ctx) : nullptr;
+    if (ssl) {
+        STACK_OF(SSL_CIPHER)* list = SSL_get_ciphers(ssl);
+        for (int i = 0; i < sk_SSL_CIPHER_num(list); i++) {
+            ciphers.push_back(SSL_CIPHER_get_name(sk_SSL_CIPHER_value(list, i)));
+        }
+    }
+    SSL_free(ssl);
+    SSL_CTX_free(ctx);
+    return ciphers;
+}
+
+bool SslContext::isOpenSslAvailable() {
+    return true;
+}
+
+std::shared_ptr<SslContext> SslContext::createClientContext() {
+    auto context = std::make_shared<SslContext>(Method::TLS_CLIENT);
+    if (context->isValid()) {
+        context->setVerifyMode(VerifyMode::Peer);
+        SSL_CTX_set_default_verify_paths(nativeContext(context->context_));
+    }
+    return context;
+}
+
+std::shared_ptr<SslContext> SslContext::createServerContext() {
+    return std::make_shared<SslContext>(Method::TLS_SERVER);
+}
+
+bool SslContext::initialize() {
+    initializeOpenSsl();
+
+    SSL_CTX* ctx = SSL_CTX_new(selectMethod(method_));
+    if (!ctx) {
+        setLastError("Failed to create SSL context: " + SslUtils::getLastSslError());
+        return false;
+    }
+    context_ = ctx;
+    SSL_CTX_set_app_data(ctx, callbackState_.get());
+
+    // Non-blocking writes may complete partially and be retried from a
+    // different buffer address once the socket drains
+    SSL_CTX_set_mode(ctx, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+    SSL_CTX_set_min_proto_version(ctx, isDtls(method_) ? DTLS1_2_VERSION : TLS1_2_VERSION);
+
+    // Servers resume from tickets or their internal cache. Clients store
+    // sessions in our per-peer cache through the new-session callback, which
+    // for TLS 1.3 fires when tickets arrive after the handshake.
+    long cacheMode = SSL_SESS_CACHE_BOTH;
+    if (method_ == Method::TLS_CLIENT || method_ == Method::DTLS_CLIENT) {
+        cacheMode = SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE;
+    } else if (method_ == Method::TLS_SERVER || method_ == Method::DTLS_SERVER) {
+        cacheMode = SSL_SESS_CACHE_SERVER;
+    }
+    SSL_CTX_set_session_cache_mode(ctx, cacheMode);
+    SSL_CTX_set_session_id_context(ctx, kSessionIdContext, sizeof(kSessionIdContext) - 1);
+
+    SSL_CTX_sess_set_new_cb(ctx, [](SSL* ssl, SSL_SESSION* session) -> int {
+        // The session's app data is its peer key, set by TlsSession
+        auto* state = static_cast<CallbackState*>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+        auto* peerKey = static_cast<const std::string*>(SSL_get_app_data(ssl));
+        if (!state || !peerKey || peerKey->empty() || state->maxSessions == 0) {
+            return 0;
+        }
+
+        std::lock_guard<std::mutex> lock(state->sessionsMutex);
+        auto it = state->sessions.find(*peerKey);
+        if (it != state->sessions.end()) {
+            SSL_SESSION_free(it->second);
+            it->second = session;
+            return 1;
+        }
+        if (state->sessions.size() >= state->maxSessions) {
+            auto victim = state->sessions.begin();
+            SSL_SESSION_free(victim->second);
+            state->sessions.erase(victim);
+        }
+        state->sessions.emplace(*peerKey, session);
+        return 1; // We keep the reference
+    });
+
+    SSL_CTX_set_alpn_select_cb(ctx, [](SSL* ssl, const unsigned char** out, unsigned char* outlen,
+                                       const unsigned char* in, unsigned int inlen, void* arg) {
+        return alpnCallback(ssl, out, outlen, in, inlen, arg);
+    }, callbackState_.get());
+
+    SSL_CTX_set_tlsext_servername_callback(ctx, +[](SSL* ssl, int* ad, void* arg) {
+        return sniCallback(ssl, ad, arg);
+    });
+
+    return true;
+}
+
+void SslContext::cleanup() {
+    if (context_) {
+        SSL_CTX_free(nativeContext(context_));
+        context_ = nullptr;
+    }
+}
+
+int SslContext::verifyCallback(int preverify_ok, void* /*x509_ctx*/) {
+    // Chain and hostname checks are left to OpenSSL
+    return preverify_ok;
+}
+
+int SslContext::sniCallback(void* /*ssl*/, int* /*ad*/, void* /*arg*/) {
+    // A single certificate serves every name
+    return SSL_TLSEXT_ERR_OK;
+}
+
+int SslContext::alpnCallback(void* /*ssl*/, const unsigned char** out, unsigned char* outlen,
+                             const unsigned char* in, unsigned int inlen, void* arg) {
+    auto* state = static_cast<CallbackState*>(arg);
+    if (!state || state->alpnWire.empty()) {
+        return SSL_TLSEXT_ERR_NOACK;
+    }
+
+    // Server preference order
+    if (SSL_select_next_proto(const_cast<unsigned char**>(out), outlen,
+                              state->alpnWire.data(), static_cast<unsigned int>(state->alpnWire.size()),
+                              in, inlen) != OPENSSL_NPN_NEGOTIATED) {
+        return SSL_TLSEXT_ERR_NOACK;
+    }
+    return SSL_TLSEXT_ERR_OK;
+}
+
+void SslContext::setLastError(const std::string& error) {
+    lastError_ = error;
+}
+
+void SslContext::initializeOpenSsl() {
+    std::lock_guard<std::mutex> lock(sslMutex_);
+    if (!sslInitialized_) {
+        OPENSSL_init_ssl(OPENSSL_INIT_LOAD_SSL_STRINGS | OPENSSL_INIT_LOAD_CRYPTO_STRINGS, nullptr);
+        sslInitialized_ = true;
+    }
+}
+
+void SslContext::cleanupOpenSsl() {
+    // OpenSSL 1.1+ releases its global state at exit
+}
+
+// SslUtils implementation
+CertificateInfo SslUtils::parseCertificate(const std::vector<uint8_t>& certData) {
+    X509* cert = readCertificate(certData);
+    if (!cert) {
+        return CertificateInfo{};
+    }
+    CertificateInfo info = describeCertificate(cert);
+    X509_free(cert);
+    return info;
+}
+
+CertificateInfo SslUtils::parseCertificateFile(const std::string& certFile) {
+    std::vector<uint8_t> data;
+    return readFile(certFile, data) ? parseCertificate(data) : CertificateInfo{};
+}
+
+std::vector<CertificateInfo> SslUtils::parseCertificateChain(const std::vector<uint8_t>& chainData) {
+    std::vector<CertificateInfo> chain;
+    BIO* bio = BIO_new_mem_buf(chainData.data(), static_cast<int>(chainData.size()));
+    while (X509* cert = PEM_read_bio_X509(bio, nullptr, nullptr, nullptr)) {
+        chain.push_back(describeCertificate(cert));
+        X509_free(cert);
+    }
+    ERR_clear_error(); // End of input
+    BIO_free(bio);
+    return chain;
+}
+
+std::vector<CertificateInfo> SslUtils::parseCertificateChainFile(const std::string& chainFile) {
+    std::vector<uint8_t> data;
+    return readFile(chainFile, data) ? parseCertificateChain(data) : std::vector<CertificateInfo>();
+}
+
+bool SslUtils::validateCertificate(const CertificateInfo& cert, const std::string& hostname) {
+    if (!cert.isValid || cert.isExpired) {
+        return false;
+    }
+    if (hostname.empty()) {
+        return true;
+    }
+
+    for (const auto& name : cert.subjectAltNames) {
+        if (matchesHostname(name, hostname)) {
+            return true;
+        }
+    }
+
+    // Legacy certificates without SANs carry the name in the CN
+    size_t cn = cert.subject.find("CN=");
+    if (cert.subjectAltNames.empty() && cn != std::string::npos) {
+        size_t end = cert.subject.find(',', cn);
+        return matchesHostname(cert.subject.substr(cn + 3, end == std::string::npos ? std::string::npos : end - cn - 3), hostname);
+    }
+    return false;
+}
+
+bool SslUtils::validateCertificateChain(const std::vector<CertificateInfo>& chain) {
+    if (chain.empty()) {
+        return false;
+    }
+
+    // Leaf first; each certificate must be issued by the next one
+    for (size_t i = 0; i < chain.size(); i++) {
+        if (!validateCertificate(chain[i])) {
+            return false;
+        }
+        if (i + 1 < chain.size() && chain[i].issuer != chain[i + 1].subject) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::pair<std::vector<uint8_t>, std::vector<uint8_t>> SslUtils::generateKeyPair(int keyBits) {
+    std::pair<std::vector<uint8_t>, std::vector<uint8_t>> result;
+
+    EVP_PKEY* key = nullptr;
+    EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, nullptr);
+    if (ctx && EVP_PKEY_keygen_init(ctx) == 1 &&
+        EVP_PKEY_CTX_set_rsa_keygen_bits(ctx, keyBits) == 1 &&
+        EVP_PKEY_keygen(ctx, &key) == 1) {
+        BIO* privateBio = BIO_new(BIO_s_mem());
+        BIO* publicBio = BIO_new(BIO_s_mem());
+        if (PEM_write_bio_PrivateKey(privateBio, key, nullptr, nullptr, 0, nullptr, nullptr) == 1 &&
+            PEM_write_bio_PUBKEY(publicBio, key) == 1) {
+            result.first = drainBio(privateBio);
+            result.second = drainBio(publicBio);
+        }
+        BIO_free(privateBio);
+        BIO_free(publicBio);
+    }
+
+    EVP_PKEY_free(key);
+    EVP_PKEY_CTX_free(ctx);
+    return result;
+}
+
+std::vector<uint8_t> SslUtils::generateSelfSignedCertificate(
+    const std::vector<uint8_t>& privateKey,
+    const std::string& subject,
+    int validDays) {
+    BIO* keyBio = BIO_new_mem_buf(privateKey.data(), static_cast<int>(privateKey.size()));
+    EVP_PKEY* key = PEM_read_bio_PrivateKey(keyBio, nullptr, nullptr, nullptr);
+    BIO_free(keyBio);
+    if (!key) {
+        return {};
+    }
+
+    X509* cert = X509_new();
+    X509_set_version(cert, 2); // v3
+
+    std::random_device random;
+    uint64_t serial = (static_cast<uint64_t>(random()) << 32 | random()) & 0x7fffffffffffffffULL;
+    BIGNUM* serialBn = BN_new();
+    BN_set_word(serialBn, static_cast<BN_ULONG>(serial));
+    BN_to_ASN1_INTEGER(serialBn, X509_get_serialNumber(cert));
+    BN_free(serialBn);
+
+    X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert), static_cast<long>(validDays) * 24 * 60 * 60);
+    X509_set_pubkey(cert, key);
+
+    // "CN=host,O=org" or "/CN=host/O=org"; a bare name becomes the CN
+    X509_NAME* name = X509_get_subject_name(cert);
+    std::string commonName;
+    if (subject.find('=') == std::string::npos) {
+        commonName = subject;
+        X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_UTF8, reinterpret_cast<const unsigned char*>(subject.c_str()), -1, -1, 0);
+    } else {
+        char separator = subject[0] == '/' ? '/' : ',';
+        std::istringstream stream(subject);
+        std::string field;
+        while (std::getline(stream, field, separator)) {
+            size_t equals = field.find('=');
+            if (equals == std::string::npos) {
+                continue;
+            }
+            std::string key = field.substr(0, equals);
+            std::string value = field.substr(equals + 1);
+            key.erase(0, key.find_first_not_of(' '));
+            if (key == "CN") {
+                commonName = value;
+            }
+            X509_NAME_add_entry_by_txt(name, key.c_str(), MBSTRING_UTF8, reinterpret_cast<const unsigned char*>(value.c_str()), -1, -1, 0);
+        }
+    }
+    X509_set_issuer_name(cert, name);
+
+    // Hostname verification only looks at subjectAltName
+    if (!commonName.empty()) {
+        std::string san = (commonName.find_first_not_of("0123456789.") == std::string::npos ? "IP:" : "DNS:") + commonName;
+        X509V3_CTX extensionContext;
+        X509V3_set_ctx_nodb(&extensionContext);
+        X509V3_set_ctx(&extensionContext, cert, cert, nullptr, nullptr, 0);
+        if (X509_EXTENSION* extension = X509V3_EXT_conf_nid(nullptr, &extensionContext, NID_subject_alt_name, san.c_str())) {
+            X509_add_ext(cert, extension, -1);
+            X509_EXTENSION_free(extension);
+        }
+    }
+
+    std::vector<uint8_t> pem;
+    if (X509_sign(cert, key, EVP_sha256()) > 0) {
+        BIO* bio = BIO_new(BIO_s_mem());
+        if (PEM_write_bio_X509(bio, cert) == 1) {
+            pem = drainBio(bio);
+        }
+        BIO_free(bio);
+    }
+
+    X509_free(cert);
+    EVP_PKEY_free(key);
+    return pem;
+}
+
+std::vector<uint8_t> SslUtils::pemToDer(const std::string& pem) {
+    BIO* bio = BIO_new_mem_buf(pem.data(), static_cast<int>(pem.size()));
+    char* name = nullptr;
+    char* header = nullptr;
+    unsigned char* data = nullptr;
+    long length = 0;
+
+    std::vector<uint8_t> der;
+    if (PEM_read_bio(bio, &name, &header, &data, &length) == 1) {
+        der.assign(data, data + length);
+    }
+
+    OPENSSL_free(name);
+    OPENSSL_free(header);
+    OPENSSL_free(data);
+    BIO_free(bio);
+    return der;
+}
+
+std::string SslUtils::derToPem(const std::vector<uint8_t>& der, const std::string& label) {
+    BIO* bio = BIO_new(BIO_s_mem());
+    std::string pem;
+    if (PEM_write_bio(bio, label.c_str(), "", der.data(), static_cast<long>(der.size())) > 0) {
+        pem = bioToString(bio);
+    }
+    BIO_free(bio);
+    return pem;
+}
+
+std::string SslUtils::getLastSslError() {
+    std::string message;
+    while (unsigned long error = ERR_get_error()) {
+        if (!message.empty()) {
+            message += "; ";
+        }
+        message += sslErrorToString(error);
+    }
+    return message;
+}
+
+std::string SslUtils::sslErrorToString(unsigned long error) {
+    char buffer[256];
+    ERR_error_string_n(error, buffer, sizeof(buffer));
+    return buffer;
+}
+
+#else // !TCP_SSL_SUPPORT
+
+// Built without OpenSSL: contexts are never valid and every operation fails
+
+struct SslContext::CallbackState {};
+
+namespace {
+const char kNoSslSupport[] = "SSL/TLS support not compiled in";
+} // namespace
+
+SslContext::SslContext(Method method)
+    : context_(nullptr), method_(method), verifyMode_(VerifyMode::None), verifyDepth_(9),
+      kernelTls_(false), callbackState_(new CallbackState()), lastError_(kNoSslSupport) {
+}
+
+SslContext::~SslContext() = default;
+SslContext::SslContext(SslContext&& other) noexcept = default;
+SslContext& SslContext::operator=(SslContext&& other) noexcept = default;
+
+bool SslContext::loadCertificate(const std::string&) { return false; }
+bool SslContext::loadCertificateChain(const std::string&) { return false; }
+bool SslContext::loadPrivateKey(const std::string&) { return false; }
+bool SslContext::loadCertificateFromMemory(const std::vector<uint8_t>&) { return false; }
+bool SslContext::loadPrivateKeyFromMemory(const std::vector<uint8_t>&) { return false; }
+bool SslContext::loadCaCertificate(const std::string&) { return false; }
+bool SslContext::loadCaCertificateDir(const std::string&) { return false; }
+bool SslContext::loadCaCertificateFromMemory(const std::vector<uint8_t>&) { return false; }
+void SslContext::setVerifyMode(VerifyMode mode) { verifyMode_ = mode; }
+void SslContext::setVerifyDepth(int depth) { verifyDepth_ = depth; }
+bool SslContext::setCipherSuites(const std::string&) { return false; }
+std::string SslContext::getCipherSuites() const { return cipherSuites_; }
+bool SslContext::setMinProtocolVersion(int) { return false; }
+bool SslContext::setMaxProtocolVersion(int) { return false; }
+int SslContext::getMinProtocolVersion() const { return 0; }
+int SslContext::getMaxProtocolVersion() const { return 0; }
+void SslContext::setSessionCacheMode(int) {}
+int SslContext::getSessionCacheMode() const { return 0; }
+void SslContext::setSessionTimeout(long) {}
+long SslContext::getSessionTimeout() const { return 0; }
+void SslContext::setSessionTickets(bool) {}
+bool SslContext::getSessionTickets() const { return false; }
+void SslContext::setClientSessionCacheSize(size_t) {}
+size_t SslContext::getCachedSessionCount() const { return 0; }
+void SslContext::clearSessionCache() {}
+void* SslContext::findSession(const std::string&) const { return nullptr; }
+bool SslContext::setKernelTlsOffload(bool enable) { return !enable; }
+bool SslContext::isKernelTlsSupported() { return false; }
+bool SslContext::setSniHostname(const std::string& hostname) { sniHostname_ = hostname; return true; }
+bool SslContext::setAlpnProtocols(const std::vector<std::string>&) { return false; }
+std::vector<std::string> SslContext::getAlpnProtocols() const { return alpnProtocols_; }
+bool SslContext::isValid() const { return false; }
+std::string SslContext::getLastError() const { return lastError_; }
+std::string SslContext::getOpenSslVersion() { return ""; }
+std::vector<std::string> SslContext::getAvailableCiphers() { return {}; }
+bool SslContext::isOpenSslAvailable() { return false; }
+std::shared_ptr<SslContext> SslContext::createClientContext() { return std::make_shared<SslContext>(Method::TLS_CLIENT); }
+std::shared_ptr<SslContext> SslContext::createServerContext() { return std::make_shared<SslContext>(Method::TLS_SERVER); }
+void SslContext::setLastError(const std::string& error) { lastError_ = error; }
+
+CertificateInfo SslUtils::parseCertificate(const std::vector<uint8_t>&) { return CertificateInfo{}; }
+CertificateInfo SslUtils::parseCertificateFile(const std::string&) { return CertificateInfo{}; }
+std::vector<CertificateInfo> SslUtils::parseCertificateChain(const std::vector<uint8_t>&) { return {}; }
+std::vector<CertificateInfo> SslUtils::parseCertificateChainFile(const std::string&) { return {}; }
+bool SslUtils::validateCertificate(const CertificateInfo&, const std::string&) { return false; }
+bool SslUtils::validateCertificateChain(const std::vector<CertificateInfo>&) { return false; }
+std::pair<std::vector<uint8_t>, std::vector<uint8_t>> SslUtils::generateKeyPair(int) { return {}; }
+std::vector<uint8_t> SslUtils::generateSelfSignedCertificate(const std::vector<uint8_t>&, const std::string&, int) { return {}; }
+std::vector<uint8_t> SslUtils::pemToDer(const std::string&) { return {}; }
+std::string SslUtils::derToPem(const std::vector<uint8_t>&, const std::string&) { return ""; }
+std::string SslUtils::getLastSslError() { return kNoSslSupport; }
+std::string SslUtils::sslErrorToString(unsigned long) { return kNoSslSupport; }
+
+#endif // TCP_SSL_SUPPORT
+
+} // namespace tcp
@@ -3,6 +3,8 @@
 #include <memory>
 #include <string>
 #include <vector>
+#include <mutex>
+#include <cstdint>
 
 #ifdef TCP_SSL_SUPPORT
 #include <openssl/ssl.h>
@@ -33,6 +35,8 @@ public:
         Once           // Verify once
     };
 
+    static constexpr size_t kDefaultSessionCacheSize = 1024;
+
     SslContext(Method method = Method::TLS);
     ~SslContext();
 
@@ -77,6 +81,21 @@ public:
     int getSessionCacheMode() const;
     void setSessionTimeout(long timeout);
     long getSessionTimeout() const;
+    
+    // Session resumption. Servers issue stateless tickets (on by default);
+    // clients cache the latest session per peer and offer it on reconnect.
+    void setSessionTickets(bool enable);
+    bool getSessionTickets() const;
+    void setClientSessionCacheSize(size_t maxSessions);
+    size_t getCachedSessionCount() const;
+    void clearSessionCache();
+    
+    // Kernel TLS: once the handshake is done OpenSSL hands the record keys to
+    // the kernel, so plain socket writes and sendfile() are encrypted there.
+    // Falls back to user-space crypto when the kernel or cipher lacks support.
+    bool setKernelTlsOffload(bool enable);
+    bool isKernelTlsOffloadEnabled() const { return kernelTls_; }
+    static bool isKernelTlsSupported(); // OpenSSL built with kTLS
 
     // SNI (Server Name Indication)
     bool setSniHostname(const std::string& hostname);
@@ -101,12 +120,19 @@ public:
     static std::shared_ptr<SslContext> createServerContext();
 
 private:
+    friend class TlsSession;
+    
+    struct CallbackState;
+    
     void* context_;  // SSL_CTX* handle
     Method method_;
     VerifyMode verifyMode_;
     int verifyDepth_;
     std::string sniHostname_;
     std::vector<std::string> alpnProtocols_;
+    std::string cipherSuites_;
+    bool kernelTls_;
+    std::unique_ptr<CallbackState> callbackState_; // Reached from OpenSSL callbacks
     mutable std::string lastError_;
 
     // Internal methods
@@ -117,6 +143,7 @@ private:
     static int alpnCallback(void* ssl, const unsigned char** out, unsigned char* outlen,
                            const unsigned char* in, unsigned int inlen, void* arg);
     void setLastError(const std::string& error);
+    void* findSession(const std::string& peerKey) const; // Referenced SSL_SESSION* or nullptr
     
 #ifdef TCP_SSL_SUPPORT
     static bool sslInitialized_;
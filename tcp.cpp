@@ -34,6 +34,9 @@ void Library::cleanup() {
         return;
     }
     
+    // Write out anything still queued by the async logger
+    Logger::stopAsync();
+    
 #ifdef _WIN32
     WSACleanup();
 #endif
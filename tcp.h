@@ -5,7 +5,25 @@
 #include "tcp_client.h"
 #include "tcp_server.h"
 #include "ssl_context.h"
+#include "tls_session.h"
+#include "file_transfer.h"
+#include "broadcaster.h"
+#include "metrics.h"
+#include "load_generator.h"
 #include "tcp_utils.h"
+#include "event_loop.h"
+#include "timer_wheel.h"
+#include "resolver.h"
+#include "connector.h"
+#include "reconnect_policy.h"
+#include "connection_pool.h"
+#include "ring_buffer.h"
+#include "rate_limiter.h"
+#include "websocket_framer.h"
+#include "http_parser.h"
+#include "coroutine.h"
+#include "io_ring.h"
+#include "executor.h"
 
 /**
  * @file tcp.h
@@ -18,11 +36,28 @@
  * - TcpClient: TCP client with async operations, auto-reconnect, and heartbeat
  * - TcpServer: TCP server with connection management and broadcasting
  * - TcpConnection: Individual connection management
+ * - EventLoop: epoll/kqueue/poll reactor driving server connections from a fixed thread pool
+ * - TimerWheel: O(1) hierarchical timers behind EventLoop heartbeats, reconnects and idle timeouts
+ * - Resolver: asynchronous getaddrinfo() with a TTL cache shared by every client
+ * - Connector: non-blocking IPv4/IPv6 connects racing addresses per Happy Eyeballs (RFC 8305)
+ * - ReconnectPolicy: exponential backoff with jitter and a circuit breaker for reconnects and pools
+ * - ConnectionPool/ClientPool: per-endpoint, health-checked pools with O(1) handles and acquire timeouts
+ * - SpscRingBuffer/MpscRingBuffer: lock-free byte rings, optionally mirrored so reads never wrap
+ * - RateLimiter: lock-free token bucket, nestable under a shared parent, shaping connection sends and reads
+ * - WebSocketFramer: streaming RFC 6455 codec with SIMD masking and permessage-deflate
+ * - HttpParser / HttpBuilder: zero-allocation HTTP/1.1 parsing with pipelining and chunked bodies, gathered writes
+ * - Task / AsyncConnection / AsyncClient / AsyncServer: C++20 coroutines over the event loop (TCP_COROUTINES)
+ * - IoRing: io_uring event loop backend with multishot accept/receive and linked sends (TCP_IO_URING)
+ * - Executor: bounded worker pool behind the sendAsync()/receiveAsync() APIs
+ * - Broadcaster: one-copy fan-out to all connections or topic subscribers, per I/O thread
+ * - Metrics: sharded counters, latency histograms and a Prometheus text exporter
+ * - LoadGenerator: many client sessions over a few event loops, for soak and capacity tests
  * 
  * Security:
  * - SSL/TLS support with OpenSSL integration
  * - Certificate management and validation
  * - Secure client/server connections
+ * - TlsSession: non-blocking handshake and records, session resumption, kernel TLS offload
  * 
  * Utilities:
  * - Message framing (length-prefixed, delimiter-based)
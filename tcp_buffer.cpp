@@ -0,0 +1,423 @@
+#include "tcp_buffer.h"
+#include "metrics.h"
+#include <algorithm>
+#include <cstring>
+
+namespace tcp {
+
+namespace {
+
+constexpr size_t kMinClassSize = 256;
+constexpr size_t kMaxClasses = 24;
+
+// Bytes a thread may park per size class before spilling to the shared list
+constexpr size_t kThreadCacheBytes = 256 * 1024;
+
+size_t threadCacheLimit(size_t blockSize) {
+    return std::min<size_t>(64, std::max<size_t>(4, kThreadCacheBytes / blockSize));
+}
+
+// Set once this thread's cache is destroyed; trivially destructible so it
+// stays readable while other thread_locals release buffers at thread exit
+thread_local bool threadCacheDestroyed = false;
+
+} // namespace
+
+struct Buffer::Block {
+    std::atomic<uint32_t> references{0};
+    size_t capacity = 0;
+    size_t size = 0;
+    uint8_t* data = nullptr;
+    int sizeClass = -1;                       // -1: unpooled, data owned by the block
+    // Pooled blocks hold it from carving until the pool closes, so handing
+    // one out never touches the shared reference count
+    std::shared_ptr<BufferPool::State> owner;
+
+    ~Block() {
+        if (sizeClass < 0) {
+            delete[] data;
+        }
+    }
+};
+
+struct BufferPool::State : std::enable_shared_from_this<BufferPool::State> {
+    struct SizeClass {
+        size_t blockSize = 0;
+        std::mutex mutex;
+        std::vector<Buffer::Block*> freeBlocks;
+    };
+
+    size_t classCount = 0;
+    size_t slabSize = 0;
+    SizeClass classes[kMaxClasses];
+    std::atomic<bool> closed{false};
+
+    // Slab arenas, released with the state
+    std::mutex slabMutex;
+    std::vector<std::unique_ptr<uint8_t[]>> slabs;
+    std::vector<std::unique_ptr<Buffer::Block[]>> headers;
+
+    // Statistics. The hot-path counters are sharded per thread; the peak is
+    // sampled off the fast path.
+    Counter hits;
+    Counter misses;
+    Counter bytesOutstanding;
+    std::atomic<size_t> highWaterMark{0};
+    std::atomic<size_t> bytesReserved{0};
+    
+    void samplePeak() {
+        size_t outstanding = static_cast<size_t>(std::max<int64_t>(0, bytesOutstanding.value()));
+        size_t peak = highWaterMark.load(std::memory_order_relaxed);
+        while (outstanding > peak && !highWaterMark.compare_exchange_weak(peak, outstanding, std::memory_order_relaxed)) {
+        }
+    }
+
+    int classFor(size_t capacity) const {
+        for (size_t i = 0; i < classCount; i++) {
+            if (classes[i].blockSize >= capacity) {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+    // Carves a new slab for a class; returns one block and frees the rest
+    Buffer::Block* carve(int sizeClass, std::vector<Buffer::Block*>& spare) {
+        size_t blockSize = classes[sizeClass].blockSize;
+        size_t count = std::max<size_t>(1, slabSize / blockSize);
+        
+        std::unique_ptr<uint8_t[]> slab(new uint8_t[count * blockSize]);
+        std::unique_ptr<Buffer::Block[]> blocks(new Buffer::Block[count]);
+        std::shared_ptr<State> self = shared_from_this();
+        for (size_t i = 0; i < count; i++) {
+            blocks[i].capacity = blockSize;
+            blocks[i].data = slab.get() + i * blockSize;
+            blocks[i].sizeClass = sizeClass;
+            blocks[i].owner = self;
+        }
+        for (size_t i = 1; i < count; i++) {
+            spare.push_back(&blocks[i]);
+        }
+        
+        Buffer::Block* first = &blocks[0];
+        {
+            std::lock_guard<std::mutex> lock(slabMutex);
+            slabs.push_back(std::move(slab));
+            headers.push_back(std::move(blocks));
+        }
+        bytesReserved.fetch_add(count * blockSize, std::memory_order_relaxed);
+        return first;
+    }
+
+    void release(int sizeClass, std::vector<Buffer::Block*>& blocks) {
+        if (blocks.empty()) {
+            return;
+        }
+        // Blocks parked after the pool closed drop their owner so the state
+        // can be freed. The last reference may be ours: dropped after unlocking.
+        std::shared_ptr<State> last;
+        {
+            std::lock_guard<std::mutex> lock(classes[sizeClass].mutex);
+            if (closed.load()) {
+                for (Buffer::Block* block : blocks) {
+                    if (block->owner) {
+                        last = std::move(block->owner);
+                    }
+                }
+            }
+            classes[sizeClass].freeBlocks.insert(classes[sizeClass].freeBlocks.end(), blocks.begin(), blocks.end());
+            blocks.clear();
+        }
+    }
+};
+
+// Per-thread free lists, one entry per pool the thread has used
+struct BufferPool::ThreadCache {
+    struct Entry {
+        std::shared_ptr<State> state;
+        std::vector<Buffer::Block*> blocks[kMaxClasses];
+    };
+    std::vector<Entry> entries;
+
+    ~ThreadCache() {
+        for (auto& entry : entries) {
+            flush(entry);
+        }
+        threadCacheDestroyed = true;
+    }
+
+    static void flush(Entry& entry) {
+        for (size_t i = 0; i < entry.state->classCount; i++) {
+            entry.state->release(static_cast<int>(i), entry.blocks[i]);
+        }
+    }
+
+    Entry* find(const std::shared_ptr<State>& state, bool create) {
+        // Drop entries of pools that no longer exist so their state can be freed
+        for (auto it = entries.begin(); it != entries.end();) {
+            if (it->state != state && it->state->closed.load(std::memory_order_relaxed)) {
+                flush(*it);
+                it = entries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        
+        for (auto& entry : entries) {
+            if (entry.state == state) {
+                return &entry;
+            }
+        }
+        if (!create) {
+            return nullptr;
+        }
+        entries.emplace_back();
+        entries.back().state = state;
+        return &entries.back();
+    }
+
+    // Returns blocks beyond the class limit to the shared list
+    static void trim(State& state, int sizeClass, std::vector<Buffer::Block*>& local, size_t keep) {
+        if (local.size() <= keep) {
+            return;
+        }
+        std::vector<Buffer::Block*> spill(local.begin() + keep, local.end());
+        local.resize(keep);
+        state.release(sizeClass, spill);
+    }
+
+    static ThreadCache* local() {
+        if (threadCacheDestroyed) {
+            return nullptr;
+        }
+        thread_local ThreadCache cache;
+        return &cache;
+    }
+};
+
+// ByteView implementation
+ByteView ByteView::subview(size_t offset, size_t length) const {
+    offset = std::min(offset, size_);
+    return ByteView(data_ + offset, std::min(length, size_ - offset));
+}
+
+// Buffer implementation
+Buffer::Buffer(const Buffer& other) : block_(other.block_) {
+    if (block_) {
+        block_->references.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+Buffer& Buffer::operator=(const Buffer& other) {
+    if (block_ != other.block_) {
+        Buffer copy(other);
+        std::swap(block_, copy.block_);
+    }
+    return *this;
+}
+
+Buffer& Buffer::operator=(Buffer&& other) noexcept {
+    if (this != &other) {
+        release();
+        block_ = other.block_;
+        other.block_ = nullptr;
+    }
+    return *this;
+}
+
+uint8_t* Buffer::data() const {
+    return block_ ? block_->data : nullptr;
+}
+
+size_t Buffer::capacity() const {
+    return block_ ? block_->capacity : 0;
+}
+
+size_t Buffer::size() const {
+    return block_ ? block_->size : 0;
+}
+
+void Buffer::setSize(size_t size) {
+    if (block_) {
+        block_->size = std::min(size, block_->capacity);
+    }
+}
+
+bool Buffer::unique() const {
+    return block_ && block_->references.load(std::memory_order_acquire) == 1;
+}
+
+void Buffer::release() {
+    if (block_ && block_->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        BufferPool::recycle(block_);
+    }
+    block_ = nullptr;
+}
+
+// BufferView implementation
+BufferView::BufferView(Buffer buffer, size_t offset, size_t size)
+    : buffer_(std::move(buffer)) {
+    offset_ = std::min(offset, buffer_.size());
+    size_ = std::min(size, buffer_.size() - offset_);
+}
+
+BufferView BufferView::slice(size_t offset, size_t length) const {
+    offset = std::min(offset, size_);
+    BufferView result;
+    result.buffer_ = buffer_;
+    result.offset_ = offset_ + offset;
+    result.size_ = std::min(length, size_ - offset);
+    return result;
+}
+
+// BufferPool implementation
+BufferPool::BufferPool(size_t maxBlockSize, size_t slabSize) : state_(std::make_shared<State>()) {
+    size_t blockSize = kMinClassSize;
+    while (state_->classCount < kMaxClasses) {
+        state_->classes[state_->classCount++].blockSize = blockSize;
+        if (blockSize >= maxBlockSize) {
+            break;
+        }
+        blockSize <<= 1;
+    }
+    state_->slabSize = slabSize;
+}
+
+BufferPool::~BufferPool() {
+    // Outstanding blocks and thread caches keep the state alive until released;
+    // the free ones let go of it now
+    state_->closed = true;
+    for (size_t i = 0; i < state_->classCount; i++) {
+        State::SizeClass& shared = state_->classes[i];
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        for (Buffer::Block* block : shared.freeBlocks) {
+            block->owner.reset();
+        }
+    }
+    if (ThreadCache* cache = ThreadCache::local()) {
+        cache->find(nullptr, false);
+    }
+}
+
+Buffer BufferPool::acquire() {
+    return acquire(getMaxBlockSize());
+}
+
+Buffer BufferPool::acquire(size_t minCapacity) {
+    State& state = *state_;
+    int sizeClass = state.classFor(std::max<size_t>(1, minCapacity));
+    Buffer::Block* block = nullptr;
+    bool slowPath = true;
+    
+    if (sizeClass < 0) {
+        // Too large to pool
+        block = new Buffer::Block();
+        block->capacity = minCapacity;
+        block->data = new uint8_t[minCapacity];
+        block->owner = state_;
+        state.misses.add();
+    } else {
+        ThreadCache* cache = ThreadCache::local();
+        ThreadCache::Entry* entry = cache ? cache->find(state_, true) : nullptr;
+        std::vector<Buffer::Block*> spare;
+        std::vector<Buffer::Block*>& local = entry ? entry->blocks[sizeClass] : spare;
+        
+        slowPath = local.empty();
+        if (local.empty()) {
+            // Refill half a cache's worth from the shared list in one lock
+            State::SizeClass& shared = state.classes[sizeClass];
+            size_t batch = std::max<size_t>(1, threadCacheLimit(shared.blockSize) / 2);
+            std::lock_guard<std::mutex> lock(shared.mutex);
+            size_t take = std::min(batch, shared.freeBlocks.size());
+            local.insert(local.end(), shared.freeBlocks.end() - take, shared.freeBlocks.end());
+            shared.freeBlocks.resize(shared.freeBlocks.size() - take);
+        }
+        
+        if (!local.empty()) {
+            block = local.back();
+            local.pop_back();
+            state.hits.add();
+        } else {
+            block = state.carve(sizeClass, local);
+            state.misses.add();
+        }
+        
+        ThreadCache::trim(state, sizeClass, local, entry ? threadCacheLimit(block->capacity) : 0);
+    }
+    
+    // Only past its cache does a thread raise the total much, so the peak is
+    // sampled there
+    state.bytesOutstanding.add(static_cast<int64_t>(block->capacity));
+    if (slowPath) {
+        state.samplePeak();
+    }
+    
+    block->references.store(1, std::memory_order_relaxed);
+    block->size = 0;
+    return Buffer(block);
+}
+
+size_t BufferPool::getMaxBlockSize() const {
+    return state_->classes[state_->classCount - 1].blockSize;
+}
+
+void BufferPool::reserve(size_t bytes) {
+    State& state = *state_;
+    int sizeClass = static_cast<int>(state.classCount - 1);
+    size_t blockSize = state.classes[sizeClass].blockSize;
+    std::vector<Buffer::Block*> blocks;
+    while (blocks.size() * blockSize < bytes) {
+        blocks.push_back(state.carve(sizeClass, blocks));
+    }
+    for (Buffer::Block* block : blocks) {
+        std::memset(block->data, 0, block->capacity);
+    }
+    state.release(sizeClass, blocks);
+}
+
+BufferPool::Statistics BufferPool::getStatistics() const {
+    state_->samplePeak();
+    Statistics stats;
+    stats.hits = static_cast<size_t>(state_->hits.value());
+    stats.misses = static_cast<size_t>(state_->misses.value());
+    stats.bytesOutstanding = static_cast<size_t>(std::max<int64_t>(0, state_->bytesOutstanding.value()));
+    stats.highWaterMark = state_->highWaterMark.load(std::memory_order_relaxed);
+    stats.bytesReserved = state_->bytesReserved.load(std::memory_order_relaxed);
+    return stats;
+}
+
+BufferPool& BufferPool::shared() {
+    // Never destroyed: receive threads may still release blocks during exit
+    static BufferPool* pool = new BufferPool(65536, 256 * 1024);
+    return *pool;
+}
+
+void BufferPool::recycle(Buffer::Block* block) {
+    // The state may go with the last block released after the pool closed,
+    // so nothing touches it after release()
+    State& owner = *block->owner;
+    owner.bytesOutstanding.add(-static_cast<int64_t>(block->capacity));
+    
+    if (block->sizeClass < 0) {
+        delete block;
+        return;
+    }
+    
+    ThreadCache* cache = ThreadCache::local();
+    ThreadCache::Entry* entry = cache && !owner.closed ? cache->find(block->owner, true) : nullptr;
+    if (!entry) {
+        std::vector<Buffer::Block*> single(1, block);
+        owner.release(block->sizeClass, single);
+        return;
+    }
+    
+    // Spill half the cache when it is full
+    std::vector<Buffer::Block*>& local = entry->blocks[block->sizeClass];
+    local.push_back(block);
+    size_t limit = threadCacheLimit(block->capacity);
+    if (local.size() > limit) {
+        ThreadCache::trim(owner, block->sizeClass, local, limit / 2);
+    }
+}
+
+} // namespace tcp
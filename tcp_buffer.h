@@ -0,0 +1,146 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace tcp {
+
+// Non-owning view of contiguous bytes
+class ByteView {
+public:
+    ByteView() : data_(nullptr), size_(0) {}
+    ByteView(const void* data, size_t size) : data_(static_cast<const uint8_t*>(data)), size_(size) {}
+    ByteView(const std::vector<uint8_t>& data) : data_(data.data()), size_(data.size()) {}
+    ByteView(const std::string& data) : data_(reinterpret_cast<const uint8_t*>(data.data())), size_(data.size()) {}
+
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    const uint8_t* begin() const { return data_; }
+    const uint8_t* end() const { return data_ + size_; }
+    uint8_t operator[](size_t index) const { return data_[index]; }
+
+    ByteView subview(size_t offset, size_t length = static_cast<size_t>(-1)) const;
+    std::vector<uint8_t> toVector() const { return std::vector<uint8_t>(begin(), end()); }
+    std::string toString() const { return std::string(reinterpret_cast<const char*>(data_), size_); }
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+};
+
+class BufferPool;
+
+// Reference-counted, fixed-capacity block of memory from a BufferPool.
+// Copies share the block; the last reference returns it to its pool.
+class Buffer {
+public:
+    Buffer() : block_(nullptr) {}
+    Buffer(const Buffer& other);
+    Buffer(Buffer&& other) noexcept : block_(other.block_) { other.block_ = nullptr; }
+    Buffer& operator=(const Buffer& other);
+    Buffer& operator=(Buffer&& other) noexcept;
+    ~Buffer() { release(); }
+
+    uint8_t* data() const;
+    size_t capacity() const;
+    size_t size() const;       // Bytes in use
+    void setSize(size_t size); // Clamped to capacity()
+
+    explicit operator bool() const { return block_ != nullptr; }
+    bool unique() const;       // True when this is the only reference
+    void reset() { release(); }
+
+    ByteView view() const { return ByteView(data(), size()); }
+
+private:
+    friend class BufferPool;
+    struct Block;
+
+    Block* block_;
+
+    explicit Buffer(Block* block) : block_(block) {}
+    void release();
+};
+
+// Retained slice of a Buffer. Keeping a BufferView keeps the whole block
+// alive, so copy out (toVector()) small slices that are stored long-term.
+class BufferView {
+public:
+    BufferView() : offset_(0), size_(0) {}
+    BufferView(Buffer buffer, size_t offset, size_t size);
+    explicit BufferView(Buffer buffer) : BufferView(buffer, 0, buffer.size()) {}
+
+    const uint8_t* data() const { return buffer_ ? buffer_.data() + offset_ : nullptr; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    const uint8_t* begin() const { return data(); }
+    const uint8_t* end() const { return data() + size_; }
+    uint8_t operator[](size_t index) const { return data()[index]; }
+
+    BufferView slice(size_t offset, size_t length = static_cast<size_t>(-1)) const;
+    const Buffer& buffer() const { return buffer_; }
+
+    ByteView view() const { return ByteView(data(), size_); }
+    operator ByteView() const { return view(); }
+    std::vector<uint8_t> toVector() const { return view().toVector(); }
+    std::string toString() const { return view().toString(); }
+
+private:
+    Buffer buffer_;
+    size_t offset_;
+    size_t size_;
+};
+
+// Size-classed slab allocator for Buffers. Requests are rounded up to a
+// power-of-two class (256 B up to the maximum block size) and carved from
+// slabs that stay reserved until the pool state is gone. Each thread keeps a
+// small cache per class and counts into per-thread shards, so steady-state
+// acquire/release takes no lock and no pool-wide atomic.
+// Larger requests are allocated exactly and freed on release.
+class BufferPool {
+public:
+    struct Statistics {
+        size_t hits = 0;             // Served from a cache or free list
+        size_t misses = 0;           // Needed a new slab or an unpooled allocation
+        size_t bytesOutstanding = 0; // Capacity currently handed out
+        size_t highWaterMark = 0;    // Peak of bytesOutstanding, sampled when a thread cache
+                                     // runs dry, so it may trail by what threads keep cached
+        size_t bytesReserved = 0;    // Slab memory owned by the pool
+    };
+
+    explicit BufferPool(size_t maxBlockSize = 65536, size_t slabSize = 256 * 1024);
+    ~BufferPool();
+
+    // Non-copyable
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    Buffer acquire();                    // Maximum block size
+    Buffer acquire(size_t minCapacity);  // Size starts at 0
+    size_t getMaxBlockSize() const;
+    Statistics getStatistics() const;
+    // Carves at least this much in maximum-size blocks and touches it on
+    // the calling thread, whose NUMA node then holds the pages (the
+    // kernel places memory where it is first written)
+    void reserve(size_t bytes);
+
+    // Pool shared by the receive paths, send queues and BufferManager
+    static BufferPool& shared();
+
+private:
+    friend class Buffer;
+    struct State;
+    struct ThreadCache;
+
+    std::shared_ptr<State> state_;
+
+    static void recycle(Buffer::Block* block);
+};
+
+} // namespace tcp
@@ -1,20 +1,76 @@
 #include "tcp_client.h"
+#include "executor.h"
+#include "tls_session.h"
+#include "file_transfer.h"
+#include "tcp_utils.h"
 #include <iostream>
 #include <chrono>
 #include <thread>
 #include <cstring>
+#include <algorithm>
+
+#ifndef _WIN32
+#include <netinet/tcp.h>
+#endif
 
 namespace tcp {
 
+namespace {
+
+// Non-blocking read flag; without it (Windows) reads rely on prior readiness
+// and sends block under the lock
+#ifdef MSG_DONTWAIT
+constexpr int kRecvNoWait = MSG_DONTWAIT;
+#else
+constexpr int kRecvNoWait = 0;
+#endif
+constexpr int kSendNoWait = kRecvNoWait;
+
+// TLS sends that stall on a handshake poll in short slices: the receive
+// thread may consume the readiness they are waiting for
+constexpr std::chrono::milliseconds kTlsRetrySlice{10};
+
+// Bytes per sendfile() call, bounding how long the receive thread waits for mutex_
+constexpr size_t kFileChunkSize = 1024 * 1024;
+
+// A receive thread held back by its rate limiter sleeps in slices this
+// long, so disconnect() never waits on it for the whole delay
+constexpr std::chrono::milliseconds kShapingSleepSlice{50};
+
+bool isWouldBlock() {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+void closeSocketHandle(socket_t socket) {
+#ifdef _WIN32
+    closesocket(socket);
+#else
+    ::close(socket);
+#endif
+}
+
+} // namespace
+
 TcpClient::TcpClient() 
     : remotePort_(0), localPort_(0), state_(ConnectionState::Disconnected),
-      sslEnabled_(false), sslContext_(nullptr), sslHandle_(nullptr),
-      shouldStop_(false), autoReconnect_(false), reconnectInterval_(5000),
-      heartbeatEnabled_(false), heartbeatInterval_(30000) {
+      sslEnabled_(false), sslContext_(nullptr),
+      shouldStop_(false), asyncTarget_(std::make_shared<AsyncTarget>()),
+      batchMaxReads_(0), batchMaxBytes_(0), autoReconnect_(false),
+      reconnectPolicy_(std::make_shared<ReconnectPolicy>(ReconnectPolicy::fixedInterval(std::chrono::milliseconds(5000)))),
+      reconnectTimer_(0),
+      heartbeatEnabled_(false), heartbeatInterval_(30000), heartbeatTimer_(0) {
+    asyncTarget_->client = this;
 }
 
 TcpClient::~TcpClient() {
     disconnect();
+    
+    std::lock_guard<std::recursive_mutex> lock(asyncTarget_->mutex);
+    asyncTarget_->client = nullptr;
 }
 
 bool TcpClient::connect(const std::string& address, uint16_t port) {
@@ -28,32 +84,20 @@ bool TcpClient::connect(const std::string& address, uint16_t port, std::chrono::
 void TcpClient::disconnect() {
     setState(ConnectionState::Disconnecting);
     shouldStop_ = true;
+    autoReconnect_ = false;
+    heartbeatEnabled_ = false;
+    cancelTimers();
+    cancelConnect();
     
+    // Wait out a reconnect attempt, heartbeat or connect already finishing;
+    // ones that start later see the flags above
     {
-        std::lock_guard<std::mutex> lock(reconnectMutex_);
-        autoReconnect_ = false;
-        reconnectCondition_.notify_all();
-    }
-    
-    {
-        std::lock_guard<std::mutex> lock(heartbeatMutex_);
-        heartbeatEnabled_ = false;
-        heartbeatCondition_.notify_all();
-    }
-    
-    if (receiveThread_.joinable()) {
-        receiveThread_.join();
-    }
-    
-    if (reconnectThread_.joinable()) {
-        reconnectThread_.join();
-    }
-    
-    if (heartbeatThread_.joinable()) {
-        heartbeatThread_.join();
+        std::lock_guard<std::recursive_mutex> lock(asyncTarget_->mutex);
     }
     
+    // close_notify goes out before the socket is shut down
     cleanupSsl();
+    stopReceiveThread();
     close();
     setState(ConnectionState::Disconnected);
     
@@ -66,14 +110,51 @@ bool TcpClient::isConnected() const {
     return state_ == ConnectionState::Connected;
 }
 
+void TcpClient::connectAsync(const std::string& address, uint16_t port, std::chrono::milliseconds timeout,
+                             std::function<void(bool)> callback) {
+    prepareConnect(address);
+    
+    std::shared_ptr<AsyncTarget> target = asyncTarget_;
+    startConnect(address, port, timeout, [target, address, port, timeout, callback](
+                     std::shared_ptr<Connector> connector, const Connector::Result& result) {
+        // TLS handshakes block, so connects finish off the shared loop
+        bool submitted = Executor::shared().submit([target, connector, address, port, timeout, callback, result]() {
+            bool connected = false;
+            {
+                std::lock_guard<std::recursive_mutex> lock(target->mutex);
+                if (target->client) {
+                    connected = target->client->finishConnect(connector, address, port, timeout, result);
+                } else if (result.ok()) {
+                    closeSocketHandle(result.socket);
+                }
+            }
+            if (callback) {
+                callback(connected);
+            }
+        });
+        
+        if (!submitted) {
+            if (result.ok()) {
+                closeSocketHandle(result.socket);
+            }
+            if (callback) {
+                callback(false);
+            }
+        }
+    });
+}
+
 std::future<bool> TcpClient::connectAsync(const std::string& address, uint16_t port) {
     return connectAsync(address, port, options_.connectTimeout);
 }
 
 std::future<bool> TcpClient::connectAsync(const std::string& address, uint16_t port, std::chrono::milliseconds timeout) {
-    return std::async(std::launch::async, [this, address, port, timeout]() {
-        return connectInternal(address, port, timeout);
+    auto promise = std::make_shared<std::promise<bool>>();
+    std::future<bool> result = promise->get_future();
+    connectAsync(address, port, timeout, [promise](bool connected) {
+        promise->set_value(connected);
     });
+    return result;
 }
 
 void TcpClient::disconnectAsync() {
@@ -91,29 +172,85 @@ bool TcpClient::send(const std::string& data) {
 }
 
 bool TcpClient::send(const void* data, size_t length) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    if (!isConnected() || !isValid()) {
-        return false;
+    if (sendLimiter_) {
+        sendLimiter_->waitForBytes(length);
+    }
+    return sendInternal(data, length);
+}
+
+bool TcpClient::sendBatch(const ByteView* messages, size_t count, MessageFramer& framer) {
+    if (count == 0) {
+        return isConnected();
     }
     
-    int sent;
+    // The batch buffer is kept per thread, so steady batching allocates nothing
+    thread_local std::vector<uint8_t> batch;
+    framer.frameBatch(messages, count, batch);
+    if (sendLimiter_) {
+        sendLimiter_->waitForBytes(batch.size());
+    }
+    return sendInternal(batch.data(), batch.size(), count);
+}
+
+bool TcpClient::sendBatch(const std::vector<ByteView>& messages, MessageFramer& framer) {
+    return sendBatch(messages.data(), messages.size(), framer);
+}
+
+void TcpClient::setReceiveBatching(std::unique_ptr<MessageFramer> framer, size_t maxReads, size_t maxBytes) {
+    batchFramer_ = std::move(framer);
+    batchMaxReads_ = std::max<size_t>(maxReads, 1);
+    batchMaxBytes_ = std::max<size_t>(maxBytes, 1);
+}
+
+bool TcpClient::sendInternal(const void* data, size_t length, size_t messages) {
     if (sslEnabled_) {
-        sent = sendSsl(data, length);
-    } else {
-        sent = ::send(socket_, static_cast<const char*>(data), length, 0);
+        // Not under mutex_: a TLS write may wait for the receive thread
+        if (!isConnected()) {
+            return false;
+        }
+        int sent = sendSsl(data, length);
+        if (sent == SOCKET_ERROR) {
+            return false;
+        }
+        
+        bytesSent_.add(sent);
+        messagesSent_.add(static_cast<int64_t>(messages));
+        return true;
     }
     
-    if (sent == SOCKET_ERROR) {
-        handleError(ErrorCode::SendFailed, "Send failed");
-        return false;
-    }
+    std::lock_guard<std::mutex> sendLock(sendMutex_);
+    const char* buffer = static_cast<const char*>(data);
+    size_t totalSent = 0;
     
-    {
-        std::lock_guard<std::mutex> statsLock(statisticsMutex_);
-        statistics_.bytesSent += sent;
+    while (totalSent < length) {
+        int sent;
+        {
+            // Never wait under mutex_: a large write (a batch) could fill the
+            // window while the receive thread needs the lock to drain the echo
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!isConnected() || !isValid()) {
+                return false;
+            }
+            sent = ::send(socket_, buffer + totalSent, length - totalSent, kSendNoWait);
+        }
+        
+        if (sent == SOCKET_ERROR) {
+            if (!isWouldBlock()) {
+                handleError(ErrorCode::SendFailed, "Send failed");
+                return false;
+            }
+            if (!waitForReady(socket_, true, options_.sendTimeout)) {
+                handleError(ErrorCode::Timeout, "Send timed out");
+                return false;
+            }
+            continue;
+        }
+        
+        totalSent += sent;
+        bytesSent_.add(sent);
     }
     
+    messagesSent_.add(static_cast<int64_t>(messages));
     return true;
 }
 
@@ -133,18 +270,24 @@ std::string TcpClient::receiveString(size_t maxLength) {
 }
 
 int TcpClient::receiveRaw(void* buffer, size_t length) {
+    if (sslEnabled_) {
+        if (!isConnected()) {
+            return -1;
+        }
+        int received = receiveSsl(buffer, length);
+        if (received > 0) {
+            bytesReceived_.add(received);
+        }
+        return received;
+    }
+    
     std::lock_guard<std::mutex> lock(mutex_);
     
     if (!isConnected() || !isValid()) {
         return -1;
     }
     
-    int received;
-    if (sslEnabled_) {
-        received = receiveSsl(buffer, length);
-    } else {
-        received = ::recv(socket_, static_cast<char*>(buffer), length, MSG_DONTWAIT);
-    }
+    int received = ::recv(socket_, static_cast<char*>(buffer), length, kRecvNoWait);
     
     if (received == SOCKET_ERROR) {
 #ifdef _WIN32
@@ -175,76 +318,288 @@ int TcpClient::receiveRaw(void* buffer, size_t length) {
         return -1;
     }
     
-    {
-        std::lock_guard<std::mutex> statsLock(statisticsMutex_);
-        statistics_.bytesReceived += received;
+#ifdef TCP_QUICKACK
+    if (options_.quickAck) {
+        // Cleared by the kernel once it leaves quick-ack mode
+        int optval = 1;
+        setSocketOption(IPPROTO_TCP, TCP_QUICKACK, &optval, sizeof(optval));
     }
-    
+#endif
+    bytesReceived_.add(received);
     return received;
 }
 
-void TcpClient::sendAsync(const std::vector<uint8_t>& data, std::function<void(bool)> callback) {
-    std::thread([this, data, callback]() {
-        // Check if we're still connected before sending
-        if (isConnected()) {
-            bool success = send(data);
-            if (callback) {
-                callback(success);
-            }
-        } else {
-            // Not connected
-            if (callback) {
-                callback(false);
+void TcpClient::sendAsync(std::vector<uint8_t> data, std::function<void(bool)> callback) {
+    std::chrono::nanoseconds delay = sendLimiter_ ? sendLimiter_->reserve(data.size()) : std::chrono::nanoseconds(0);
+    if (delay.count() > 0) {
+        // Already paid for: wait on the shared loop, then send on the Executor
+        std::shared_ptr<AsyncTarget> target = asyncTarget_;
+        auto send = std::make_shared<std::pair<std::vector<uint8_t>, std::function<void(bool)>>>(
+            std::move(data), std::move(callback));
+        EventLoop::shared().runAfter(std::chrono::ceil<std::chrono::milliseconds>(delay), [target, send]() {
+            bool submitted = Executor::shared().submit([target, send]() {
+                bool success = false;
+                {
+                    std::lock_guard<std::recursive_mutex> lock(target->mutex);
+                    TcpClient* client = target->client;
+                    success = client && client->isConnected() &&
+                              client->sendInternal(send->first.data(), send->first.size());
+                }
+                if (send->second) {
+                    send->second(success);
+                }
+            });
+            if (!submitted && send->second) {
+                send->second(false);
             }
+        });
+        return;
+    }
+    
+    std::shared_ptr<AsyncTarget> target = asyncTarget_;
+    bool submitted = Executor::shared().submit([target, data = std::move(data), callback]() {
+        // Check if we're still connected before sending
+        bool success = false;
+        {
+            std::lock_guard<std::recursive_mutex> lock(target->mutex);
+            TcpClient* client = target->client;
+            success = client && client->isConnected() && client->sendInternal(data.data(), data.size());
         }
-    }).detach();
+        if (callback) {
+            callback(success);
+        }
+    });
+    
+    if (!submitted && callback) {
+        callback(false);
+    }
 }
 
-void TcpClient::sendAsync(const std::string& data, std::function<void(bool)> callback) {
-    std::thread([this, data, callback]() {
-        // Check if we're still connected before sending
-        if (isConnected()) {
-            bool success = send(data);
-            if (callback) {
-                callback(success);
-            }
-        } else {
-            // Not connected
-            if (callback) {
-                callback(false);
-            }
-        }
-    }).detach();
+void TcpClient::sendAsync(std::string data, std::function<void(bool)> callback) {
+    sendAsync(std::vector<uint8_t>(data.begin(), data.end()), std::move(callback));
+}
+
+std::future<bool> TcpClient::sendAsync(std::vector<uint8_t> data) {
+    auto promise = std::make_shared<std::promise<bool>>();
+    std::future<bool> result = promise->get_future();
+    sendAsync(std::move(data), [promise](bool success) {
+        promise->set_value(success);
+    });
+    return result;
+}
+
+std::future<bool> TcpClient::sendAsync(std::string data) {
+    return sendAsync(std::vector<uint8_t>(data.begin(), data.end()));
 }
 
 void TcpClient::receiveAsync(size_t maxLength, std::function<void(const std::vector<uint8_t>&)> callback) {
-    std::thread([this, maxLength, callback]() {
-        std::vector<uint8_t> data = receive(maxLength);
+    std::shared_ptr<AsyncTarget> target = asyncTarget_;
+    bool submitted = Executor::shared().submit([target, maxLength, callback]() {
+        std::vector<uint8_t> data;
+        {
+            std::lock_guard<std::recursive_mutex> lock(target->mutex);
+            if (target->client) {
+                data = target->client->receive(maxLength);
+            }
+        }
         if (callback) {
             callback(data);
         }
-    }).detach();
+    });
+    
+    if (!submitted && callback) {
+        callback({});
+    }
+}
+
+std::future<std::vector<uint8_t>> TcpClient::receiveAsync(size_t maxLength) {
+    auto promise = std::make_shared<std::promise<std::vector<uint8_t>>>();
+    std::future<std::vector<uint8_t>> result = promise->get_future();
+    receiveAsync(maxLength, [promise](const std::vector<uint8_t>& data) {
+        promise->set_value(data);
+    });
+    return result;
+}
+
+bool TcpClient::sendFile(const std::string& path, uint64_t offset, uint64_t length) {
+    std::string error;
+    std::shared_ptr<FileTransfer> file = FileTransfer::open(path, offset, length, nullptr, error);
+    return file && sendFileInternal(file);
+}
+
+bool TcpClient::sendFile(int fd, uint64_t offset, uint64_t length) {
+    std::string error;
+    std::shared_ptr<FileTransfer> file = FileTransfer::fromDescriptor(fd, offset, length, nullptr, error);
+    return file && sendFileInternal(file);
+}
+
+bool TcpClient::sendFileAsync(const std::string& path, uint64_t offset, uint64_t length, FileTransferCallback callback) {
+    std::string error;
+    return submitFile(FileTransfer::open(path, offset, length, std::move(callback), error));
+}
+
+bool TcpClient::sendFileAsync(int fd, uint64_t offset, uint64_t length, FileTransferCallback callback) {
+    std::string error;
+    return submitFile(FileTransfer::fromDescriptor(fd, offset, length, std::move(callback), error));
+}
+
+bool TcpClient::submitFile(std::shared_ptr<FileTransfer> file) {
+    if (!file) {
+        return false;
+    }
+    
+    std::shared_ptr<AsyncTarget> target = asyncTarget_;
+    bool submitted = Executor::shared().submit([target, file]() {
+        std::lock_guard<std::recursive_mutex> lock(target->mutex);
+        if (target->client) {
+            target->client->sendFileInternal(file);
+        } else {
+            file->fail(ErrorCode::ConnectionClosed);
+            file->notify();
+        }
+    });
+    
+    if (!submitted) {
+        file->fail(ErrorCode::SendFailed);
+        file->notify();
+    }
+    return true;
+}
+
+bool TcpClient::sendFileInternal(const std::shared_ptr<FileTransfer>& file) {
+    ErrorCode error = ErrorCode::Success;
+    uint64_t startedAt = file->getBytesSent();
+    
+    if (!isConnected()) {
+        error = ErrorCode::ConnectionClosed;
+    } else {
+        std::lock_guard<std::mutex> sendLock(sendMutex_);
+        
+        // Without kernel TLS the record layer is in user space, so the file
+        // is copied through a pooled block
+        std::shared_ptr<TlsSession> session = currentTls();
+        bool copy = sslEnabled_ && !(session && session->isKernelTlsSend());
+        Buffer block = copy ? BufferPool::shared().acquire() : Buffer();
+        
+        while (!file->isComplete()) {
+            if (copy) {
+                long length = session ? file->read(block.data(), block.capacity()) : -1;
+                if (length < 0) {
+                    error = ErrorCode::SendFailed;
+                    handleError(error, "Send failed");
+                    break;
+                }
+                if (writeSsl(*session, block.data(), static_cast<size_t>(length)) == SOCKET_ERROR) {
+                    error = ErrorCode::SendFailed; // Already reported
+                    break;
+                }
+                file->advance(static_cast<uint64_t>(length));
+                if (sendLimiter_) {
+                    sendLimiter_->waitForBytes(static_cast<size_t>(length));
+                }
+                continue;
+            }
+            
+            long sent;
+            {
+                // One chunk at a time so the receive thread gets mutex_ back
+                std::lock_guard<std::mutex> lock(mutex_);
+                sent = isValid() ? file->transmit(socket_, kFileChunkSize) : -1;
+            }
+            if (sent < 0) {
+                error = ErrorCode::SendFailed;
+                handleError(error, "Send failed");
+                break;
+            }
+            if (sent == 0) {
+                if (!waitForReady(socket_, true, options_.sendTimeout)) {
+                    error = ErrorCode::Timeout;
+                    handleError(error, "Send timed out");
+                    break;
+                }
+                continue;
+            }
+            file->advance(static_cast<uint64_t>(sent));
+            if (sendLimiter_) {
+                // Charged per chunk, after it went out
+                sendLimiter_->waitForBytes(static_cast<size_t>(sent));
+            }
+        }
+    }
+    
+    bytesSent_.add(static_cast<int64_t>(file->getBytesSent() - startedAt));
+    messagesSent_.add();
+    
+    if (error != ErrorCode::Success) {
+        file->fail(error);
+    }
+    file->notify();
+    return error == ErrorCode::Success;
 }
 
 bool TcpClient::enableSsl(std::shared_ptr<SslContext> context) {
+    if (!context) {
+        context = SslContext::createClientContext();
+    }
+    if (!context || !context->isValid()) {
+        return false;
+    }
+    
     sslContext_ = context;
     sslEnabled_ = true;
-    return setupSsl();
+    return true;
+}
+
+std::shared_ptr<const TlsSession> TcpClient::getTlsSession() const {
+    return currentTls();
 }
 
 void TcpClient::enableAutoReconnect(bool enable, std::chrono::milliseconds interval) {
-    std::lock_guard<std::mutex> lock(reconnectMutex_);
-    autoReconnect_ = enable;
-    reconnectInterval_ = interval;
+    enableAutoReconnect(enable, std::make_shared<ReconnectPolicy>(ReconnectPolicy::fixedInterval(interval)));
+}
+
+void TcpClient::enableAutoReconnect(bool enable, std::shared_ptr<ReconnectPolicy> policy) {
+    {
+        std::lock_guard<std::mutex> lock(reconnectMutex_);
+        autoReconnect_ = enable;
+        if (policy) {
+            reconnectPolicy_ = policy;
+        }
+        
+        if (!enable) {
+            if (reconnectTimer_ != 0) {
+                EventLoop::shared().cancelTimer(reconnectTimer_);
+                reconnectTimer_ = 0;
+            }
+            lostAt_ = std::chrono::steady_clock::time_point();
+        }
+    }
     
-    if (enable && !reconnectThread_.joinable()) {
-        reconnectThread_ = std::thread(&TcpClient::reconnectLoop, this);
+    // Already lost: start retrying now
+    ConnectionState state = state_;
+    if (enable && !remoteHost_.empty() &&
+        (state == ConnectionState::Disconnected || state == ConnectionState::Error)) {
+        scheduleReconnect();
     }
 }
 
+std::shared_ptr<ReconnectPolicy> TcpClient::getReconnectPolicy() const {
+    std::lock_guard<std::mutex> lock(reconnectMutex_);
+    return reconnectPolicy_;
+}
+
 TcpClient::Statistics TcpClient::getStatistics() const {
-    std::lock_guard<std::mutex> lock(statisticsMutex_);
-    return statistics_;
+    Statistics stats;
+    {
+        std::lock_guard<std::mutex> lock(statisticsMutex_);
+        stats = statistics_;
+    }
+    stats.bytesSent = static_cast<size_t>(bytesSent_.value());
+    stats.bytesReceived = static_cast<size_t>(bytesReceived_.value());
+    stats.messagesSent = static_cast<size_t>(messagesSent_.value());
+    stats.messagesReceived = static_cast<size_t>(messagesReceived_.value());
+    stats.reconnectLatency = reconnectLatency_.snapshot();
+    return stats;
 }
 
 void TcpClient::enableHeartbeat(bool enable, std::chrono::milliseconds interval) {
@@ -252,8 +607,12 @@ void TcpClient::enableHeartbeat(bool enable, std::chrono::milliseconds interval)
     heartbeatEnabled_ = enable;
     heartbeatInterval_ = interval;
     
-    if (enable && !heartbeatThread_.joinable()) {
-        heartbeatThread_ = std::thread(&TcpClient::heartbeatLoop, this);
+    if (heartbeatTimer_ != 0) {
+        EventLoop::shared().cancelTimer(heartbeatTimer_);
+        heartbeatTimer_ = 0;
+    }
+    if (enable) {
+        heartbeatTimer_ = scheduleTimer(interval, true, &TcpClient::sendHeartbeat);
     }
 }
 
@@ -268,100 +627,88 @@ void TcpClient::setHeartbeatData(const std::string& data) {
 }
 
 bool TcpClient::connectInternal(const std::string& address, uint16_t port, std::chrono::milliseconds timeout) {
+    prepareConnect(address);
+    
+    auto promise = std::make_shared<std::promise<Connector::Result>>();
+    std::future<Connector::Result> future = promise->get_future();
+    std::shared_ptr<Connector> connector = startConnect(address, port, timeout, [promise](
+        std::shared_ptr<Connector>, const Connector::Result& result) {
+        promise->set_value(result);
+    });
+    
+    return finishConnect(connector, address, port, timeout, future.get());
+}
+
+void TcpClient::prepareConnect(const std::string& address) {
     if (isConnected()) {
         disconnect();
     }
     
-    setState(ConnectionState::Connecting);
+    // Reap the receive thread of a connection the peer already closed
+    stopReceiveThread();
+    shouldStop_ = false;
+    remoteHost_ = address;
     
-    if (!create()) {
-        setState(ConnectionState::Error);
-        return false;
+    setState(ConnectionState::Connecting);
+}
+
+std::shared_ptr<Connector> TcpClient::startConnect(const std::string& address, uint16_t port,
+                                                   std::chrono::milliseconds timeout, ConnectCallback callback) {
+    auto connector = std::make_shared<Connector>(EventLoop::shared());
+    std::shared_ptr<Connector> previous;
+    {
+        std::lock_guard<std::mutex> lock(connectMutex_);
+        previous.swap(connector_);
+        connector_ = connector;
     }
     
-    // Resolve address
-    std::string resolvedAddress = address;
-    if (!resolveAddress(address, resolvedAddress)) {
-        resolvedAddress = address; // Use as-is if resolution fails
+    // A newer connect supersedes one still in flight
+    if (previous) {
+        previous->cancel();
     }
     
-    // Set up address structure
-    struct sockaddr_in serverAddr;
-    std::memset(&serverAddr, 0, sizeof(serverAddr));
-    serverAddr.sin_family = AF_INET;
-    serverAddr.sin_port = htons(port);
+    // The connector holds itself until it reports, which drops the cycle
+    connector->connect(address, port, timeout, [connector, callback](const Connector::Result& result) {
+        callback(connector, result);
+    });
+    return connector;
+}
+
+bool TcpClient::finishConnect(const std::shared_ptr<Connector>& connector, const std::string& address, uint16_t port,
+                              std::chrono::milliseconds timeout, const Connector::Result& result) {
+    {
+        std::lock_guard<std::mutex> lock(connectMutex_);
+        if (connector_ != connector) {
+            // Cancelled by disconnect() or superseded by a newer connect
+            if (result.ok()) {
+                closeSocketHandle(result.socket);
+            }
+            return false;
+        }
+        connector_.reset();
+    }
     
-    if (inet_pton(AF_INET, resolvedAddress.c_str(), &serverAddr.sin_addr) <= 0) {
-        handleError(ErrorCode::InvalidAddress, "Invalid address: " + resolvedAddress);
+    if (!result.ok()) {
+        handleError(result.error, result.message);
         setState(ConnectionState::Error);
         return false;
     }
     
-    // Set non-blocking for timeout control
-    setNonBlocking(true);
-    
-    // Connect
-    int result = ::connect(socket_, reinterpret_cast<struct sockaddr*>(&serverAddr), sizeof(serverAddr));
-    
-    if (result == SOCKET_ERROR) {
-#ifdef _WIN32
-        int error = WSAGetLastError();
-        if (error != WSAEWOULDBLOCK) {
-#else
-        if (errno != EINPROGRESS) {
-#endif
-            handleError(ErrorCode::ConnectionFailed, "Connection failed");
-            setState(ConnectionState::Error);
-            return false;
-        }
-        
-        // Wait for connection with timeout
-        fd_set writeSet, errorSet;
-        FD_ZERO(&writeSet);
-        FD_ZERO(&errorSet);
-        FD_SET(socket_, &writeSet);
-        FD_SET(socket_, &errorSet);
-        
-        struct timeval tv;
-        tv.tv_sec = timeout.count() / 1000;
-        tv.tv_usec = (timeout.count() % 1000) * 1000;
-        
-        result = select(socket_ + 1, nullptr, &writeSet, &errorSet, &tv);
-        
-        if (result == 0) {
-            handleError(ErrorCode::Timeout, "Connection timeout");
-            setState(ConnectionState::Error);
-            return false;
-        }
-        
-        if (result == SOCKET_ERROR || FD_ISSET(socket_, &errorSet)) {
-            handleError(ErrorCode::ConnectionFailed, "Connection failed");
-            setState(ConnectionState::Error);
-            return false;
-        }
-        
-        // Check if connection was successful
-        int error = 0;
-        socklen_t len = sizeof(error);
-        if (getsockopt(socket_, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error), &len) == SOCKET_ERROR || error != 0) {
-            handleError(ErrorCode::ConnectionFailed, "Connection failed");
-            setState(ConnectionState::Error);
-            return false;
-        }
+    // Connected non-blocking. TLS keeps it that way so that the reader and
+    // writers never block inside the shared session.
+    adopt(result.socket, true);
+    if (!sslEnabled_) {
+        setNonBlocking(false);
     }
     
-    // Restore blocking mode
-    setNonBlocking(false);
-    
     // Store connection info
-    remoteAddress_ = resolvedAddress;
+    remoteAddress_ = result.address.getIp();
     remotePort_ = port;
     connectedAt_ = std::chrono::system_clock::now();
     initializeLocalAddress();
     
-    // Setup SSL if enabled
-    if (sslEnabled_ && !setupSsl()) {
-        handleError(ErrorCode::SslError, "SSL setup failed");
+    // Setup SSL if enabled; reports its own errors
+    if (sslEnabled_ && !setupSsl(address, port, timeout)) {
         setState(ConnectionState::Error);
         return false;
     }
@@ -379,84 +726,263 @@ bool TcpClient::connectInternal(const std::string& address, uint16_t port, std::
     return true;
 }
 
+void TcpClient::cancelConnect() {
+    std::shared_ptr<Connector> connector;
+    {
+        std::lock_guard<std::mutex> lock(connectMutex_);
+        connector.swap(connector_);
+    }
+    if (connector) {
+        connector->cancel();
+    }
+}
+
 void TcpClient::setState(ConnectionState state) {
     state_ = state;
 }
 
 void TcpClient::startReceiveThread() {
+    // Assigned under mutex_, which the thread takes before it can hand a
+    // reconnect (and so a join) to another thread
+    std::lock_guard<std::mutex> lock(mutex_);
     receiveThread_ = std::thread(&TcpClient::receiveLoop, this);
 }
 
-void TcpClient::receiveLoop() {
-    std::vector<uint8_t> buffer(4096);
+void TcpClient::stopReceiveThread() {
+    if (!receiveThread_.joinable()) {
+        return;
+    }
     
-    while (!shouldStop_ && isConnected()) {
-        // Check if we should stop before attempting to receive
-        if (shouldStop_) {
-            break;
-        }
-        
-        int received = receiveRaw(buffer.data(), buffer.size());
-        if (received > 0) {
-            std::vector<uint8_t> data(buffer.begin(), buffer.begin() + received);
-            if (onDataReceived_) {
-                onDataReceived_(data);
-            }
-        } else if (received == -1) {
-            // Connection closed or error occurred
-            break;
-        } else if (received == 0) {
-            // No data available, continue
+    // Wake the thread out of poll() before joining
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (isValid()) {
+#ifdef _WIN32
+            ::shutdown(socket_, SD_BOTH);
+#else
+            ::shutdown(socket_, SHUT_RDWR);
+#endif
         }
-        
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    
+    if (receiveThread_.get_id() == std::this_thread::get_id()) {
+        receiveThread_.detach();
+    } else {
+        receiveThread_.join();
     }
 }
 
-void TcpClient::reconnectLoop() {
-    while (!shouldStop_) {
-        std::unique_lock<std::mutex> lock(reconnectMutex_);
-        reconnectCondition_.wait(lock, [this] { return !autoReconnect_ || shouldStop_; });
-        
-        if (shouldStop_) {
+void TcpClient::receiveLoop() {
+    Buffer buffer = BufferPool::shared().acquire();
+    bool closed = false;
+    std::vector<BufferView> batch;
+    size_t batchBytes = 0;
+    if (batchFramer_) {
+        batchFramer_->reset();
+    }
+    
+    while (!shouldStop_ && !closed && isConnected()) {
+        // Block until readable (or writable for a stalled TLS read);
+        // disconnect() shuts the socket down to wake us
+        std::shared_ptr<TlsSession> tls = currentTls();
+        if (!waitForReady(socket_, tls && tls->wantsWrite(), std::chrono::milliseconds(-1))) {
             break;
         }
         
-        if (autoReconnect_ && !isConnected()) {
-            lock.unlock();
+        // Drain everything that is buffered before waiting again
+        size_t reads = 0;
+        do {
+            int received = receiveRaw(buffer.data(), buffer.capacity());
+            if (received == 0) {
+                break;
+            }
+            if (received < 0) {
+                // Connection closed or error occurred
+                closed = true;
+                break;
+            }
+            
+            buffer.setSize(received);
+            messagesReceived_.add();
+            if (onBufferReceived_) {
+                onBufferReceived_(BufferView(buffer));
+            }
+            if (onDataReceived_) {
+                onDataReceived_(buffer.view().toVector());
+            }
+            if (batchFramer_) {
+                batchFramer_->decodeFrames(BufferView(buffer), [&batch](const BufferView& message) {
+                    batch.push_back(message);
+                });
+                batchBytes += static_cast<size_t>(received);
+            }
             
-            std::this_thread::sleep_for(reconnectInterval_);
+            // The application kept the block; read into a fresh one
+            if (!buffer.unique()) {
+                buffer = BufferPool::shared().acquire();
+            }
             
-            if (!shouldStop_ && !isConnected()) {
-                if (connectInternal(remoteAddress_, remotePort_, options_.connectTimeout)) {
-                    std::lock_guard<std::mutex> statsLock(statisticsMutex_);
-                    statistics_.reconnections++;
-                }
+            if (receiveLimiter_) {
+                waitForReceiveBudget(received);
             }
             
-            lock.lock();
+            if (batchFramer_ && (++reads >= batchMaxReads_ || batchBytes >= batchMaxBytes_)) {
+                break; // Reported before reading on
+            }
+            if (!sslEnabled_ && static_cast<size_t>(received) < buffer.capacity()) {
+                // Short read: the socket is drained. TLS reads go on until the
+                // session would block, as records may be buffered inside OpenSSL.
+                break;
+            }
+        } while ((kRecvNoWait != 0 || sslEnabled_) && !shouldStop_);
+        
+        if (!batch.empty()) {
+            if (onMessagesReceived_) {
+                onMessagesReceived_(batch);
+            }
+            batch.clear();
+        }
+        batchBytes = 0;
+    }
+    
+    // Lost rather than ended by disconnect(): retry from the shared loop
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+    }
+    if (!shouldStop_) {
+        if (isConnected()) {
+            setState(ConnectionState::Disconnected);
+        }
+        if (autoReconnect_) {
+            scheduleReconnect();
         }
     }
 }
 
-void TcpClient::heartbeatLoop() {
+void TcpClient::waitForReceiveBudget(size_t received) {
+    // Leaves the data in the socket buffer, so the peer's window closes
+    auto until = std::chrono::steady_clock::now() + receiveLimiter_->reserve(received);
     while (!shouldStop_) {
-        std::unique_lock<std::mutex> lock(heartbeatMutex_);
-        heartbeatCondition_.wait_for(lock, heartbeatInterval_, [this] { return !heartbeatEnabled_ || shouldStop_; });
-        
-        if (shouldStop_) {
+        auto now = std::chrono::steady_clock::now();
+        if (now >= until) {
             break;
         }
-        
-        if (heartbeatEnabled_ && isConnected()) {
-            std::vector<uint8_t> data = heartbeatData_;
-            lock.unlock();
-            
-            if (!data.empty()) {
-                send(data);
+        std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(until - now, kShapingSleepSlice));
+    }
+}
+
+TimerId TcpClient::scheduleTimer(std::chrono::milliseconds delay, bool repeat, void (TcpClient::*method)()) {
+    std::shared_ptr<AsyncTarget> target = asyncTarget_;
+    auto task = [target, method]() {
+        // Connects and sends block, so they run off the shared loop
+        Executor::shared().submit([target, method]() {
+            std::lock_guard<std::recursive_mutex> lock(target->mutex);
+            if (target->client) {
+                (target->client->*method)();
             }
-            
-            lock.lock();
+        });
+    };
+    
+    EventLoop& loop = EventLoop::shared();
+    return repeat ? loop.runEvery(delay, task) : loop.runAfter(delay, task);
+}
+
+void TcpClient::scheduleReconnect() {
+    {
+        std::lock_guard<std::mutex> lock(reconnectMutex_);
+        if (!autoReconnect_ || reconnectTimer_ != 0) {
+            return;
+        }
+        if (lostAt_ == std::chrono::steady_clock::time_point()) {
+            lostAt_ = std::chrono::steady_clock::now();
+        }
+        
+        if (!reconnectPolicy_->isExhausted()) {
+            reconnectTimer_ = scheduleTimer(reconnectPolicy_->nextDelay(), false, &TcpClient::attemptReconnect);
+            return;
+        }
+        autoReconnect_ = false;
+        lostAt_ = std::chrono::steady_clock::time_point();
+    }
+    handleError(ErrorCode::ConnectionFailed, "Reconnect attempts exhausted");
+}
+
+void TcpClient::attemptReconnect() {
+    std::shared_ptr<ReconnectPolicy> policy;
+    {
+        std::lock_guard<std::mutex> lock(reconnectMutex_);
+        reconnectTimer_ = 0;
+        if (!autoReconnect_) {
+            return;
+        }
+        if (isConnected()) {
+            lostAt_ = std::chrono::steady_clock::time_point();
+            return;
+        }
+        policy = reconnectPolicy_;
+    }
+    
+    // A shared policy may be backing off or open because of other clients
+    if (!policy->allowAttempt()) {
+        scheduleReconnect();
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> statsLock(statisticsMutex_);
+        statistics_.reconnectAttempts++;
+    }
+    
+    std::string host = remoteHost_;
+    if (!connectInternal(host, remotePort_, options_.connectTimeout)) {
+        policy->recordFailure();
+        scheduleReconnect();
+        return;
+    }
+    policy->recordSuccess();
+    
+    std::chrono::steady_clock::time_point lostAt;
+    {
+        std::lock_guard<std::mutex> lock(reconnectMutex_);
+        lostAt = lostAt_;
+        lostAt_ = std::chrono::steady_clock::time_point();
+    }
+    if (lostAt != std::chrono::steady_clock::time_point()) {
+        reconnectLatency_.record(std::chrono::steady_clock::now() - lostAt);
+    }
+    
+    std::lock_guard<std::mutex> statsLock(statisticsMutex_);
+    statistics_.reconnections++;
+}
+
+void TcpClient::sendHeartbeat() {
+    std::vector<uint8_t> data;
+    {
+        std::lock_guard<std::mutex> lock(heartbeatMutex_);
+        if (!heartbeatEnabled_) {
+            return;
+        }
+        data = heartbeatData_;
+    }
+    
+    if (!data.empty() && isConnected()) {
+        send(data);
+    }
+}
+
+void TcpClient::cancelTimers() {
+    EventLoop& loop = EventLoop::shared();
+    {
+        std::lock_guard<std::mutex> lock(reconnectMutex_);
+        if (reconnectTimer_ != 0) {
+            loop.cancelTimer(reconnectTimer_);
+            reconnectTimer_ = 0;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(heartbeatMutex_);
+        if (heartbeatTimer_ != 0) {
+            loop.cancelTimer(heartbeatTimer_);
+            heartbeatTimer_ = 0;
         }
     }
 }
@@ -473,15 +999,13 @@ bool TcpClient::initializeLocalAddress() {
         return false;
     }
     
-    struct sockaddr_in addr;
-    socklen_t len = sizeof(addr);
-    if (getsockname(socket_, reinterpret_cast<struct sockaddr*>(&addr), &len) == 0) {
-        localAddress_ = inet_ntoa(addr.sin_addr);
-        localPort_ = ntohs(addr.sin_port);
-        return true;
+    SocketAddress local = SocketAddress::local(socket_);
+    if (!local.isValid()) {
+        return false;
     }
-    
-    return false;
+    localAddress_ = local.getIp();
+    localPort_ = local.getPort();
+    return true;
 }
 
 void TcpClient::updateStatistics() {
@@ -491,29 +1015,137 @@ void TcpClient::updateStatistics() {
 }
 
 void TcpClient::cleanupSsl() {
-    if (sslHandle_) {
-        // SSL cleanup would go here
-        sslHandle_ = nullptr;
+    std::shared_ptr<TlsSession> session;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        session.swap(tls_);
+    }
+    
+    // Threads still holding a copy see Closed from here on
+    if (session) {
+        session->shutdown();
     }
 }
 
-bool TcpClient::setupSsl() {
+bool TcpClient::setupSsl(const std::string& serverName, uint16_t port, std::chrono::milliseconds timeout) {
     if (!sslContext_) {
+        handleError(ErrorCode::SslError, "No SSL context");
+        return false;
+    }
+    
+    // Sessions are cached per host and port for resumption on reconnect
+    auto session = std::make_shared<TlsSession>();
+    if (!session->create(sslContext_, socket_, TlsSession::Role::Client, serverName,
+                         serverName + ":" + std::to_string(port))) {
+        handleError(ErrorCode::SslError, session->getLastError());
         return false;
     }
     
-    // SSL setup would go here
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    for (;;) {
+        TlsSession::Status status = session->handshake();
+        if (status == TlsSession::Status::Ok) {
+            break;
+        }
+        if (status == TlsSession::Status::Closed) {
+            handleError(ErrorCode::SslError, "TLS handshake failed: connection closed by peer");
+            return false;
+        }
+        if (status == TlsSession::Status::Failed) {
+            handleError(ErrorCode::SslError, "TLS handshake failed: " + session->getLastError());
+            return false;
+        }
+        
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (remaining.count() <= 0) {
+            handleError(ErrorCode::Timeout, "TLS handshake timeout");
+            return false;
+        }
+        waitForReady(socket_, status == TlsSession::Status::WantWrite, remaining);
+    }
+    
+    std::lock_guard<std::mutex> lock(mutex_);
+    tls_ = session;
     return true;
 }
 
+std::shared_ptr<TlsSession> TcpClient::currentTls() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return tls_;
+}
+
 int TcpClient::sendSsl(const void* data, size_t length) {
-    // SSL send implementation would go here
-    return ::send(socket_, static_cast<const char*>(data), length, 0);
+    std::shared_ptr<TlsSession> session = currentTls();
+    if (!session) {
+        return SOCKET_ERROR;
+    }
+    
+    std::lock_guard<std::mutex> lock(sendMutex_);
+    return writeSsl(*session, static_cast<const uint8_t*>(data), length);
+}
+
+int TcpClient::writeSsl(TlsSession& session, const uint8_t* buffer, size_t length) {
+    // sendMutex_ held
+    bool hasDeadline = options_.sendTimeout.count() > 0;
+    auto deadline = std::chrono::steady_clock::now() + options_.sendTimeout;
+    size_t totalSent = 0;
+    
+    while (totalSent < length) {
+        size_t written = 0;
+        TlsSession::Status status = session.write(buffer + totalSent, length - totalSent, written);
+        totalSent += written;
+        
+        if (status == TlsSession::Status::Ok) {
+            continue;
+        }
+        if (status == TlsSession::Status::Closed) {
+            setState(ConnectionState::Disconnected);
+            return SOCKET_ERROR;
+        }
+        if (status == TlsSession::Status::Failed) {
+            handleError(ErrorCode::SslError, "TLS send failed: " + session.getLastError());
+            return SOCKET_ERROR;
+        }
+        
+        std::chrono::milliseconds wait = status == TlsSession::Status::WantWrite
+            ? std::chrono::milliseconds(-1) : kTlsRetrySlice;
+        if (hasDeadline) {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            if (remaining.count() <= 0) {
+                handleError(ErrorCode::Timeout, "Send timed out");
+                return SOCKET_ERROR;
+            }
+            wait = wait.count() < 0 ? remaining : std::min(wait, remaining);
+        }
+        waitForReady(socket_, status == TlsSession::Status::WantWrite, wait);
+    }
+    
+    return static_cast<int>(totalSent);
 }
 
 int TcpClient::receiveSsl(void* buffer, size_t length) {
-    // SSL receive implementation would go here
-    return ::recv(socket_, static_cast<char*>(buffer), length, 0);
+    // > 0 bytes read, 0 would block, -1 closed (errors are reported here)
+    std::shared_ptr<TlsSession> session = currentTls();
+    if (!session) {
+        return -1;
+    }
+    
+    size_t received = 0;
+    switch (session->read(buffer, length, received)) {
+        case TlsSession::Status::Ok:
+            return static_cast<int>(received);
+        case TlsSession::Status::WantRead:
+        case TlsSession::Status::WantWrite:
+            return 0;
+        case TlsSession::Status::Closed:
+            setState(ConnectionState::Disconnected);
+            return -1;
+        default:
+            if (!shouldStop_) {
+                handleError(ErrorCode::SslError, "TLS receive failed: " + session->getLastError());
+            }
+            return -1;
+    }
 }
 
 } // namespace tcp
@@ -1,28 +1,42 @@
 #pragma once
 
 #include "tcp_socket.h"
+#include "event_loop.h"
+#include "connector.h"
+#include "metrics.h"
+#include "reconnect_policy.h"
+#include "rate_limiter.h"
 #include <memory>
 #include <atomic>
 #include <thread>
 #include <mutex>
-#include <condition_variable>
 #include <functional>
 #include <future>
 
 namespace tcp {
 
+class TlsSession;
+class FileTransfer;
+class MessageFramer;
+
 class TcpClient : public TcpSocket {
 public:
     TcpClient();
     ~TcpClient();
 
-    // Connection management
+    // Connection management. Host names resolve through the Resolver cache
+    // and their IPv4 and IPv6 addresses race on EventLoop::shared() (see
+    // Connector); the timeout covers both. connect() waits for the result,
+    // so it must not be called from that loop's thread.
     bool connect(const std::string& address, uint16_t port);
     bool connect(const std::string& address, uint16_t port, std::chrono::milliseconds timeout);
-    void disconnect();
+    void disconnect(); // Also cancels a connect in progress
     bool isConnected() const;
     
-    // Async connection
+    // Async connection. Returns at once; the connection is finished (TLS
+    // handshake, onConnected) on the shared Executor, which then reports.
+    void connectAsync(const std::string& address, uint16_t port, std::chrono::milliseconds timeout,
+                      std::function<void(bool)> callback);
     std::future<bool> connectAsync(const std::string& address, uint16_t port);
     std::future<bool> connectAsync(const std::string& address, uint16_t port, std::chrono::milliseconds timeout);
     void disconnectAsync();
@@ -39,46 +53,95 @@ public:
     bool send(const std::string& data);
     bool send(const void* data, size_t length);
     
+    // Frames the messages back to back and sends them as one write,
+    // counting each as a message sent
+    bool sendBatch(const ByteView* messages, size_t count, MessageFramer& framer);
+    bool sendBatch(const std::vector<ByteView>& messages, MessageFramer& framer);
+    
     std::vector<uint8_t> receive(size_t maxLength = 4096);
     std::string receiveString(size_t maxLength = 4096);
     int receiveRaw(void* buffer, size_t length);
 
-    // Async operations
-    void sendAsync(const std::vector<uint8_t>& data, std::function<void(bool)> callback = nullptr);
-    void sendAsync(const std::string& data, std::function<void(bool)> callback = nullptr);
+    // Async operations, run on the shared Executor
+    void sendAsync(std::vector<uint8_t> data, std::function<void(bool)> callback);
+    void sendAsync(std::string data, std::function<void(bool)> callback);
+    std::future<bool> sendAsync(std::vector<uint8_t> data);
+    std::future<bool> sendAsync(std::string data);
     void receiveAsync(size_t maxLength, std::function<void(const std::vector<uint8_t>&)> callback);
+    std::future<std::vector<uint8_t>> receiveAsync(size_t maxLength);
+
+    // File transmission without a user-space copy (sendfile/TransmitFile;
+    // TLS without kernel offload copies through a pooled buffer). A length
+    // of 0 sends to the end of the file. sendFile() blocks until the range
+    // is written; sendFileAsync() opens the file at once, sends it on the
+    // Executor and reports once, when done (false if it can't be opened).
+    bool sendFile(const std::string& path, uint64_t offset = 0, uint64_t length = 0);
+    bool sendFile(int fd, uint64_t offset, uint64_t length);
+    bool sendFileAsync(const std::string& path, uint64_t offset, uint64_t length, FileTransferCallback callback);
+    bool sendFileAsync(int fd, uint64_t offset, uint64_t length, FileTransferCallback callback);
 
     // Callbacks
     void setOnConnected(std::function<void()> callback) { onConnected_ = callback; }
     void setOnDisconnected(std::function<void()> callback) { onDisconnected_ = callback; }
     void setOnDataReceived(std::function<void(const std::vector<uint8_t>&)> callback) { onDataReceived_ = callback; }
+    void setOnBufferReceived(std::function<void(const BufferView&)> callback) { onBufferReceived_ = callback; } // Zero-copy
     void setOnError(std::function<void(ErrorCode, const std::string&)> callback) { onError_ = callback; }
+    void setOnMessagesReceived(std::function<void(const std::vector<BufferView>&)> callback) { onMessagesReceived_ = callback; }
 
-    // SSL/TLS
+    // Batched receive (set before connecting). The receive thread drains up
+    // to maxReads reads or maxBytes bytes at a time, decodes them with the
+    // framer (reset on each connect) and reports the messages in one
+    // onMessagesReceived call; views may be retained. The data callbacks
+    // still see every read.
+    void setReceiveBatching(std::unique_ptr<MessageFramer> framer, size_t maxReads = 16, size_t maxBytes = 256 * 1024);
+
+    // SSL/TLS. Takes effect on the next connect; without a context a
+    // verifying client context is created.
     bool enableSsl(std::shared_ptr<SslContext> context = nullptr);
     bool isSslEnabled() const { return sslEnabled_; }
+    std::shared_ptr<const TlsSession> getTlsSession() const;
 
-    // Reconnection
+    // Reconnection. After the peer closes or the connection fails, retries
+    // from EventLoop::shared() as the policy allows until connected,
+    // disabled or out of attempts (reported as ErrorCode::ConnectionFailed).
+    // The interval overload retries at a fixed interval without limits.
     void enableAutoReconnect(bool enable, std::chrono::milliseconds interval = std::chrono::milliseconds{5000});
+    void enableAutoReconnect(bool enable, std::shared_ptr<ReconnectPolicy> policy);
     bool isAutoReconnectEnabled() const { return autoReconnect_; }
+    std::shared_ptr<ReconnectPolicy> getReconnectPolicy() const;
     
     // Statistics
     struct Statistics {
         size_t totalConnections = 0;
         size_t reconnections = 0;
+        size_t reconnectAttempts = 0;         // Including failed ones
+        LatencyHistogram::Snapshot reconnectLatency; // Connection lost to reconnected
         size_t bytesReceived = 0;
         size_t bytesSent = 0;
+        size_t messagesSent = 0;
+        size_t messagesReceived = 0; // Receive callbacks
         std::chrono::system_clock::time_point lastConnectedAt;
         std::chrono::milliseconds totalConnectedTime{0};
     };
     Statistics getStatistics() const;
 
-    // Heartbeat/Keep-alive
+    // Traffic shaping (set before connecting; nullptr = none). send() waits
+    // out the limiter's delay on the calling thread, and file sends between
+    // chunks (sendFileAsync() on its Executor worker); a delayed sendAsync()
+    // waits on a timer on EventLoop::shared(), holding no thread. The
+    // receive thread stops reading while in debt.
+    void setSendRateLimiter(std::shared_ptr<RateLimiter> limiter) { sendLimiter_ = std::move(limiter); }
+    void setReceiveRateLimiter(std::shared_ptr<RateLimiter> limiter) { receiveLimiter_ = std::move(limiter); }
+    const std::shared_ptr<RateLimiter>& getSendRateLimiter() const { return sendLimiter_; }
+    const std::shared_ptr<RateLimiter>& getReceiveRateLimiter() const { return receiveLimiter_; }
+
+    // Heartbeat/Keep-alive, sent from a timer on EventLoop::shared()
     void enableHeartbeat(bool enable, std::chrono::milliseconds interval = std::chrono::milliseconds{30000});
     void setHeartbeatData(const std::vector<uint8_t>& data);
     void setHeartbeatData(const std::string& data);
 
 private:
+    std::string remoteHost_;    // As given to connect(), for reconnects and TLS
     std::string remoteAddress_;
     uint16_t remotePort_;
     std::string localAddress_;
@@ -89,50 +152,97 @@ private:
     // SSL/TLS
     bool sslEnabled_;
     std::shared_ptr<SslContext> sslContext_;
-    void* sslHandle_; // SSL* handle
+    std::shared_ptr<TlsSession> tls_; // Guarded by mutex_; callers use a copy
+    std::mutex sendMutex_;            // Serializes writers; taken before mutex_
     
     // Threading
     std::thread receiveThread_;
-    std::thread reconnectThread_;
-    std::thread heartbeatThread_;
     std::atomic<bool> shouldStop_;
     
+    // Timers and connects run on EventLoop::shared() and hand blocking work
+    // to the Executor, which reaches the client through this, as do the
+    // *Async() calls. The destructor clears it, waiting out work in progress.
+    struct AsyncTarget {
+        std::recursive_mutex mutex;
+        TcpClient* client;
+    };
+    std::shared_ptr<AsyncTarget> asyncTarget_;
+    
+    // Connect in flight
+    std::shared_ptr<Connector> connector_; // Guarded by connectMutex_
+    std::mutex connectMutex_;
+    
     // Callbacks
     std::function<void()> onConnected_;
     std::function<void()> onDisconnected_;
     std::function<void(const std::vector<uint8_t>&)> onDataReceived_;
+    std::function<void(const BufferView&)> onBufferReceived_;
     std::function<void(ErrorCode, const std::string&)> onError_;
+    std::function<void(const std::vector<BufferView>&)> onMessagesReceived_;
+    
+    // Receive batching (receive thread only once connected)
+    std::unique_ptr<MessageFramer> batchFramer_;
+    size_t batchMaxReads_;
+    size_t batchMaxBytes_;
     
     // Auto-reconnect
     std::atomic<bool> autoReconnect_;
-    std::chrono::milliseconds reconnectInterval_;
-    std::condition_variable reconnectCondition_;
-    std::mutex reconnectMutex_;
+    std::shared_ptr<ReconnectPolicy> reconnectPolicy_; // Guarded by reconnectMutex_
+    TimerId reconnectTimer_;                           // Guarded by reconnectMutex_
+    std::chrono::steady_clock::time_point lostAt_;     // Guarded by reconnectMutex_; set while down
+    mutable std::mutex reconnectMutex_;
+    LatencyHistogram reconnectLatency_;
     
     // Heartbeat
     std::atomic<bool> heartbeatEnabled_;
     std::chrono::milliseconds heartbeatInterval_;
     std::vector<uint8_t> heartbeatData_;
-    std::condition_variable heartbeatCondition_;
+    TimerId heartbeatTimer_; // Guarded by heartbeatMutex_
     std::mutex heartbeatMutex_;
     
-    // Statistics
+    // Shaping
+    std::shared_ptr<RateLimiter> sendLimiter_;
+    std::shared_ptr<RateLimiter> receiveLimiter_;
+    
+    // Statistics. Traffic counters are lock-free; the rest change only on
+    // connect and reconnect.
     mutable Statistics statistics_;
     mutable std::mutex statisticsMutex_;
+    Counter bytesSent_;
+    Counter bytesReceived_;
+    Counter messagesSent_;
+    Counter messagesReceived_;
     
     // Internal methods
     bool connectInternal(const std::string& address, uint16_t port, std::chrono::milliseconds timeout);
+    void prepareConnect(const std::string& address);
+    using ConnectCallback = std::function<void(std::shared_ptr<Connector>, const Connector::Result&)>;
+    std::shared_ptr<Connector> startConnect(const std::string& address, uint16_t port,
+                                            std::chrono::milliseconds timeout, ConnectCallback callback);
+    bool finishConnect(const std::shared_ptr<Connector>& connector, const std::string& address, uint16_t port,
+                       std::chrono::milliseconds timeout, const Connector::Result& result);
+    void cancelConnect();
     void setState(ConnectionState state);
     void startReceiveThread();
+    void stopReceiveThread();
     void receiveLoop();
-    void reconnectLoop();
-    void heartbeatLoop();
+    TimerId scheduleTimer(std::chrono::milliseconds delay, bool repeat, void (TcpClient::*method)());
+    void scheduleReconnect();
+    void attemptReconnect();
+    void sendHeartbeat();
+    void cancelTimers();
     void handleError(ErrorCode error, const std::string& message);
     bool initializeLocalAddress();
     void updateStatistics();
     void cleanupSsl();
-    bool setupSsl();
+    bool setupSsl(const std::string& serverName, uint16_t port, std::chrono::milliseconds timeout);
+    std::shared_ptr<TlsSession> currentTls() const;
+    bool sendInternal(const void* data, size_t length, size_t messages = 1);
+    void waitForReceiveBudget(size_t received);
     int sendSsl(const void* data, size_t length);
+    int writeSsl(TlsSession& session, const uint8_t* data, size_t length);
+    bool sendFileInternal(const std::shared_ptr<FileTransfer>& file);
+    bool submitFile(std::shared_ptr<FileTransfer> file);
     int receiveSsl(void* buffer, size_t length);
 };
 
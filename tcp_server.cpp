@@ -1,48 +1,183 @@
 #include "tcp_server.h"
+#include "resolver.h"
+#include "rate_limiter.h"
+#include "tcp_utils.h"
 #include <iostream>
 #include <algorithm>
 #include <cstring>
 
 namespace tcp {
 
+namespace {
+
+// CPU whose softirq last handled the socket's packets, or -1
+int incomingCpu(socket_t socket) {
+#ifdef SO_INCOMING_CPU
+    int cpu = -1;
+    socklen_t length = sizeof(cpu);
+    if (getsockopt(socket, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &length) == 0) {
+        return cpu;
+    }
+#else
+    (void)socket;
+#endif
+    return -1;
+}
+
+// Upper bound on accepts per readiness event so one listener can't starve the loop
+constexpr int kMaxAcceptsPerEvent = 64;
+
+// Kernels that load-balance connections across SO_REUSEPORT listeners
+#if defined(__linux__) && defined(SO_REUSEPORT)
+constexpr bool kReusePortSharding = true;
+constexpr int kReusePortOption = SO_REUSEPORT;
+#elif defined(__FreeBSD__) && defined(SO_REUSEPORT_LB)
+constexpr bool kReusePortSharding = true;
+constexpr int kReusePortOption = SO_REUSEPORT_LB;
+#else
+constexpr bool kReusePortSharding = false;
+constexpr int kReusePortOption = 0;
+#endif
+
+void closeSocketHandle(socket_t socket) {
+#ifdef _WIN32
+    closesocket(socket);
+#else
+    ::close(socket);
+#endif
+}
+
+void shutdownSocketHandle(socket_t socket) {
+#ifdef _WIN32
+    ::shutdown(socket, SD_BOTH);
+#else
+    ::shutdown(socket, SHUT_RDWR);
+#endif
+}
+
+bool setNonBlockingHandle(socket_t socket) {
+#ifdef _WIN32
+    u_long mode = 1;
+    return ioctlsocket(socket, FIONBIO, &mode) == 0;
+#else
+    int flags = fcntl(socket, F_GETFL, 0);
+    return flags != -1 && fcntl(socket, F_SETFL, flags | O_NONBLOCK) != -1;
+#endif
+}
+
+// IPV6_V6ONLY off lets an IPv6 wildcard listener take IPv4 connections too
+bool setIpv6Only(socket_t socket, bool only) {
+    int optval = only ? 1 : 0;
+    return setsockopt(socket, IPPROTO_IPV6, IPV6_V6ONLY, reinterpret_cast<const char*>(&optval), sizeof(optval)) == 0;
+}
+
+bool shouldRetryAccept() {
+#ifdef _WIN32
+    int error = WSAGetLastError();
+    return error == WSAECONNRESET || error == WSAEINTR;
+#else
+    return errno == EINTR || errno == ECONNABORTED || errno == EPROTO;
+#endif
+}
+
+} // namespace
+
 TcpServer::TcpServer() 
     : localPort_(0), running_(false), shouldStop_(false),
-      sslEnabled_(false), sslContext_(nullptr) {
-    statistics_.startTime = std::chrono::system_clock::now();
+      ioMode_(IoMode::Reactor), ioThreadCount_(0), incomingCpuSteering_(false), acceptorSharding_(false),
+      dualStack_(true), sendMode_(TcpConnection::SendMode::Queued),
+      lowWatermark_(0), highWatermark_(0),
+      idleTimeout_(0), handshakeTimeout_(0), batchMaxReads_(16), batchMaxBytes_(256 * 1024),
+      sendRatePerConnection_(0), receiveRatePerConnection_(0),
+      sslEnabled_(false), sslContext_(nullptr),
+      startTime_(std::chrono::system_clock::now()), metrics_(std::make_shared<ConnectionMetrics>()) {
 }
 
 TcpServer::~TcpServer() {
     stop();
 }
 
+size_t TcpServer::getIoThreadCount() const {
+    if (loopGroup_) {
+        return loopGroup_->size();
+    }
+    return ioThreadCount_ > 0 ? ioThreadCount_ : std::max(1u, std::thread::hardware_concurrency());
+}
+
+bool TcpServer::isAcceptorShardingSupported() {
+    return kReusePortSharding;
+}
+
+void TcpServer::setWriteWatermarks(size_t lowWatermark, size_t highWatermark) {
+    lowWatermark_ = lowWatermark;
+    highWatermark_ = highWatermark;
+}
+
+void TcpServer::setSendRateLimit(size_t perConnectionBytesPerSecond, size_t totalBytesPerSecond) {
+    sendRatePerConnection_ = perConnectionBytesPerSecond;
+    sendLimiter_ = totalBytesPerSecond > 0 ? std::make_shared<RateLimiter>(totalBytesPerSecond) : nullptr;
+}
+
+void TcpServer::setReceiveRateLimit(size_t perConnectionBytesPerSecond, size_t totalBytesPerSecond) {
+    receiveRatePerConnection_ = perConnectionBytesPerSecond;
+    receiveLimiter_ = totalBytesPerSecond > 0 ? std::make_shared<RateLimiter>(totalBytesPerSecond) : nullptr;
+}
+
+void TcpServer::setBusyPoll(std::chrono::microseconds duration) {
+    loopOptions_.busyPollUs = static_cast<unsigned>(duration.count());
+    SocketOptions options = getSocketOptions();
+    options.busyPoll = duration;
+    setSocketOptions(options);
+}
+
+void TcpServer::setReceiveBatching(std::function<std::unique_ptr<MessageFramer>()> makeFramer,
+                                   size_t maxReads, size_t maxBytes) {
+    makeFramer_ = makeFramer;
+    batchMaxReads_ = maxReads;
+    batchMaxBytes_ = maxBytes;
+}
+
 bool TcpServer::bind(const std::string& address, uint16_t port) {
     if (running_) {
         return false;
     }
     
-    if (!create()) {
-        return false;
+    SocketAddress serverAddr;
+    if (!SocketAddress::parse(address, port, serverAddr)) {
+        Resolver::Result resolved = Resolver::shared().resolve(address);
+        if (!resolved.ok()) {
+            return false;
+        }
+        serverAddr = resolved.addresses.front();
+        serverAddr.setPort(port);
     }
     
-    struct sockaddr_in serverAddr;
-    std::memset(&serverAddr, 0, sizeof(serverAddr));
-    serverAddr.sin_family = AF_INET;
-    serverAddr.sin_port = htons(port);
+    if (!create(serverAddr.getFamily())) {
+        return false;
+    }
+    if (serverAddr.isIPv6()) {
+        setIpv6Only(socket_, !dualStack_);
+    }
     
-    if (address.empty() || address == "0.0.0.0") {
-        serverAddr.sin_addr.s_addr = INADDR_ANY;
-        localAddress_ = "0.0.0.0";
-    } else {
-        if (inet_pton(AF_INET, address.c_str(), &serverAddr.sin_addr) <= 0) {
-            return false;
-        }
-        localAddress_ = address;
+    // Every sharded listener, including this one, must opt in before bind()
+    if (usesAcceptorSharding()) {
+        int optval = 1;
+        setSocketOption(SOL_SOCKET, kReusePortOption, &optval, sizeof(optval));
     }
     
-    if (::bind(socket_, reinterpret_cast<struct sockaddr*>(&serverAddr), sizeof(serverAddr)) == SOCKET_ERROR) {
+    if (::bind(socket_, serverAddr.get(), serverAddr.getLength()) == SOCKET_ERROR) {
         return false;
     }
     
+    // Resolve the actual port when binding to port 0
+    SocketAddress bound = SocketAddress::local(socket_);
+    if (bound.isValid()) {
+        port = bound.getPort();
+    }
+    
+    bindAddress_ = serverAddr;
+    bindAddress_.setPort(port);
+    localAddress_ = serverAddr.getIp();
     localPort_ = port;
     return true;
 }
@@ -75,11 +210,21 @@ bool TcpServer::start(const std::string& address, uint16_t port, int backlog) {
     running_ = true;
     shouldStop_ = false;
     
-    // Start accept thread
-    acceptThread_ = std::thread(&TcpServer::acceptLoop, this);
-    
-    // Start cleanup thread
-    cleanupThread_ = std::thread(&TcpServer::cleanupLoop, this);
+    if (ioMode_ == IoMode::Reactor) {
+        loopGroup_.reset(new EventLoopGroup(ioThreadCount_, loopOptions_, ioThreadCpus_));
+        reactorConnections_.reset(new std::atomic<size_t>[loopGroup_->size()]);
+        for (size_t i = 0; i < loopGroup_->size(); i++) {
+            reactorConnections_[i] = 0;
+        }
+        
+        if (!loopGroup_->start() || !startAcceptors(backlog)) {
+            stop();
+            return false;
+        }
+    } else {
+        // Start accept thread
+        acceptThread_ = std::thread(&TcpServer::acceptLoop, this);
+    }
     
     return true;
 }
@@ -92,34 +237,181 @@ void TcpServer::stop() {
     running_ = false;
     shouldStop_ = true;
     
-    // Close server socket to unblock accept
-    close();
-    
-    // Notify cleanup thread
-    {
-        std::lock_guard<std::mutex> lock(stopMutex_);
-        stopCondition_.notify_all();
+    // Unblock a legacy accept(); the descriptor is closed once the thread is gone
+    if (acceptThread_.joinable() && isValid()) {
+        shutdownSocketHandle(socket_);
     }
     
-    // Wait for threads to finish
+    // Wait for the accept thread to finish
     if (acceptThread_.joinable()) {
         acceptThread_.join();
     }
     
-    if (cleanupThread_.joinable()) {
-        cleanupThread_.join();
-    }
-    
     // Close all connections
     closeAllConnections();
+    
+    // Reactor threads finish pending closes before exiting
+    if (loopGroup_) {
+        loopGroup_->stop();
+        loopGroup_.reset();
+    }
+    broadcaster_.clear();
+    
+    // Listeners are no longer polled by any thread
+    for (const auto& listener : listeners_) {
+        if (listener.socket != socket_) {
+            closeSocketHandle(listener.socket);
+        }
+    }
+    listeners_.clear();
+    close();
+}
+
+bool TcpServer::startAcceptors(int backlog) {
+    if (!setNonBlockingHandle(socket_)) {
+        return false;
+    }
+    listeners_.push_back({socket_, 0});
+    
+    // One SO_REUSEPORT listener per reactor; the kernel spreads incoming
+    // connections and each stays on the reactor that accepted it
+    if (usesAcceptorSharding()) {
+        for (size_t i = 1; i < loopGroup_->size(); i++) {
+            socket_t listener = createShardListener(backlog);
+            if (listener == INVALID_SOCKET) {
+                // Fall back to a single listener with round-robin handoff
+                for (size_t j = 1; j < listeners_.size(); j++) {
+                    closeSocketHandle(listeners_[j].socket);
+                }
+                listeners_.resize(1);
+                break;
+            }
+            listeners_.push_back({listener, i});
+        }
+    }
+    
+    // Completion loops keep one multishot accept armed per listener
+    for (size_t i = 0; i < listeners_.size(); i++) {
+        EventLoop* loop = loopGroup_->getLoop(listeners_[i].loopIndex);
+        socket_t listener = listeners_[i].socket;
+        if (!loop->acceptMultishot(listener, [this, i, listener](socket_t clientSocket) {
+                handleAccepted(i, clientSocket, SocketAddress::peer(clientSocket));
+            }) &&
+            !loop->add(listener, EventLoop::Readable, [this, i](uint32_t) { handleAcceptReady(i); })) {
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+socket_t TcpServer::createShardListener(int backlog) {
+    socket_t listener = socket(bindAddress_.getFamily(), SOCK_STREAM, IPPROTO_TCP);
+    if (listener == INVALID_SOCKET) {
+        return INVALID_SOCKET;
+    }
+    
+    // Accepted sockets inherit the listener's options, as on the first one
+    applySocketOptions(listener, getSocketOptions());
+    int optval = 1;
+    bool ok = setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&optval), sizeof(optval)) == 0 &&
+              setsockopt(listener, SOL_SOCKET, kReusePortOption, reinterpret_cast<const char*>(&optval), sizeof(optval)) == 0 &&
+              (!bindAddress_.isIPv6() || setIpv6Only(listener, !dualStack_)) &&
+              ::bind(listener, bindAddress_.get(), bindAddress_.getLength()) != SOCKET_ERROR &&
+              ::listen(listener, backlog) != SOCKET_ERROR &&
+              setNonBlockingHandle(listener);
+    
+    if (!ok) {
+        closeSocketHandle(listener);
+        return INVALID_SOCKET;
+    }
+    return listener;
+}
+
+void TcpServer::handleAcceptReady(size_t listenerIndex) {
+    socket_t listener = listeners_[listenerIndex].socket;
+    for (int i = 0; i < kMaxAcceptsPerEvent; i++) {
+        struct sockaddr_storage clientAddr;
+        socklen_t clientLen = sizeof(clientAddr);
+        
+        socket_t clientSocket = ::accept(listener, reinterpret_cast<struct sockaddr*>(&clientAddr), &clientLen);
+        if (clientSocket == INVALID_SOCKET) {
+            if (shouldRetryAccept()) {
+                continue;
+            }
+            break;
+        }
+        handleAccepted(listenerIndex, clientSocket, SocketAddress(reinterpret_cast<struct sockaddr*>(&clientAddr), clientLen));
+    }
+}
+
+void TcpServer::handleAccepted(size_t listenerIndex, socket_t clientSocket, const SocketAddress& address) {
+    if (!running_) {
+        closeSocketHandle(clientSocket);
+        return;
+    }
+    
+    EventLoop* acceptingLoop = loopGroup_->getLoop(listeners_[listenerIndex].loopIndex);
+    EventLoop* loop = incomingCpuSteering_ ? loopGroup_->forCpu(incomingCpu(clientSocket)) : nullptr;
+    if (!loop) {
+        loop = listeners_.size() > 1 ? acceptingLoop : loopGroup_->next();
+    }
+    auto connection = createConnection(clientSocket, address, loop);
+    
+    // All callbacks for a connection run on its own reactor
+    if (loop == acceptingLoop) {
+        handleNewConnection(connection);
+    } else {
+        loop->post([this, connection]() {
+            handleNewConnection(connection);
+        });
+    }
+}
+
+std::shared_ptr<TcpConnection> TcpServer::createConnection(socket_t socket, const SocketAddress& address, EventLoop* loop) {
+    std::string clientAddress = address.getIp();
+    uint16_t clientPort = address.getPort();
+    
+    // A null loop selects the legacy receive thread, started by handleNewConnection()
+    auto connection = std::make_shared<TcpConnection>(socket, clientAddress, clientPort, loop);
+    connection->setMetrics(metrics_);
+    if (loop) {
+        connection->setSendMode(sendMode_);
+        connection->setIdleTimeout(idleTimeout_);
+        connection->setHandshakeTimeout(handshakeTimeout_);
+    }
+    if (highWatermark_ > 0) {
+        connection->setWriteWatermarks(lowWatermark_, highWatermark_);
+    }
+    if (sendRatePerConnection_ > 0 || sendLimiter_) {
+        connection->setSendRateLimiter(std::make_shared<RateLimiter>(sendRatePerConnection_, 0, sendLimiter_));
+    }
+    if (receiveRatePerConnection_ > 0 || receiveLimiter_) {
+        connection->setReceiveRateLimiter(std::make_shared<RateLimiter>(receiveRatePerConnection_, 0, receiveLimiter_));
+    }
+    if (makeFramer_) {
+        connection->setReceiveBatching(makeFramer_(), batchMaxReads_, batchMaxBytes_);
+    }
+    connection->setQuickAck(getSocketOptions().quickAck);
+    setupConnectionCallbacks(connection);
+    return connection;
 }
 
 std::shared_ptr<TcpConnection> TcpServer::acceptConnection() {
+    auto connection = acceptPendingConnection();
+    if (connection && !connection->startReading()) {
+        connection->close();
+        return nullptr;
+    }
+    return connection;
+}
+
+std::shared_ptr<TcpConnection> TcpServer::acceptPendingConnection() {
     if (!isValid() || !running_) {
         return nullptr;
     }
     
-    struct sockaddr_in clientAddr;
+    struct sockaddr_storage clientAddr;
     socklen_t clientLen = sizeof(clientAddr);
     
     socket_t clientSocket = ::accept(socket_, reinterpret_cast<struct sockaddr*>(&clientAddr), &clientLen);
@@ -127,25 +419,22 @@ std::shared_ptr<TcpConnection> TcpServer::acceptConnection() {
         return nullptr;
     }
     
-    std::string clientAddress = inet_ntoa(clientAddr.sin_addr);
-    uint16_t clientPort = ntohs(clientAddr.sin_port);
-    
-    auto connection = std::make_shared<TcpConnection>(clientSocket, clientAddress, clientPort);
-    setupConnectionCallbacks(connection);
-    
-    return connection;
+    return createConnection(clientSocket, SocketAddress(reinterpret_cast<struct sockaddr*>(&clientAddr), clientLen),
+                            loopGroup_ ? loopGroup_->next() : nullptr);
 }
 
 std::vector<std::shared_ptr<TcpConnection>> TcpServer::getConnections() const {
-    std::lock_guard<std::mutex> lock(connectionsMutex_);
-    return connections_;
+    return connections_.snapshot();
 }
 
 size_t TcpServer::getConnectionCount() const {
-    std::lock_guard<std::mutex> lock(connectionsMutex_);
     return connections_.size();
 }
 
+std::shared_ptr<TcpConnection> TcpServer::findConnection(ConnectionId id) const {
+    return connections_.find(id);
+}
+
 void TcpServer::closeConnection(std::shared_ptr<TcpConnection> connection) {
     if (connection) {
         connection->close();
@@ -154,15 +443,21 @@ void TcpServer::closeConnection(std::shared_ptr<TcpConnection> connection) {
 }
 
 void TcpServer::closeAllConnections() {
-    std::lock_guard<std::mutex> lock(connectionsMutex_);
-    
-    for (auto& connection : connections_) {
+    // Close outside the registry: disconnect callbacks re-enter removeConnection()
+    for (auto& connection : connections_.clear()) {
         if (connection) {
             connection->close();
         }
     }
-    
-    connections_.clear();
+}
+
+bool TcpServer::sendBatch(ConnectionId id, const ByteView* messages, size_t count, MessageFramer& framer) {
+    auto connection = findConnection(id);
+    return connection && connection->sendBatch(messages, count, framer);
+}
+
+bool TcpServer::sendBatch(ConnectionId id, const std::vector<ByteView>& messages, MessageFramer& framer) {
+    return sendBatch(id, messages.data(), messages.size(), framer);
 }
 
 void TcpServer::enableSsl(std::shared_ptr<SslContext> context) {
@@ -191,39 +486,113 @@ void TcpServer::broadcast(const std::string& data) {
 }
 
 void TcpServer::broadcast(const void* data, size_t length) {
-    std::lock_guard<std::mutex> lock(connectionsMutex_);
-    
-    for (auto& connection : connections_) {
-        if (connection && connection->isConnected()) {
-            connection->send(data, length);
-        }
-    }
+    broadcaster_.broadcast(Broadcaster::encode(data, length));
+}
+
+void TcpServer::broadcast(const BufferView& payload, ConnectionId exclude) {
+    broadcaster_.broadcast(payload, exclude);
+}
+
+void TcpServer::publish(const std::string& topic, const std::string& data, ConnectionId exclude) {
+    broadcaster_.publish(topic, Broadcaster::encode(data.data(), data.size()), exclude);
+}
+
+void TcpServer::publish(const std::string& topic, const BufferView& payload, ConnectionId exclude) {
+    broadcaster_.publish(topic, payload, exclude);
+}
+
+bool TcpServer::subscribe(std::shared_ptr<TcpConnection> connection, const std::string& topic) {
+    return connection && broadcaster_.subscribe(connection, topic);
+}
+
+bool TcpServer::unsubscribe(std::shared_ptr<TcpConnection> connection, const std::string& topic) {
+    return connection && broadcaster_.unsubscribe(connection, topic);
 }
 
 TcpServer::Statistics TcpServer::getStatistics() const {
-    std::lock_guard<std::mutex> lock(statisticsMutex_);
-    
-    Statistics stats = statistics_;
+    Statistics stats;
+    stats.sampledAt = std::chrono::steady_clock::now();
+    stats.startTime = startTime_;
+    stats.totalConnections = static_cast<size_t>(acceptedConnections_.value());
     stats.activeConnections = getConnectionCount();
+    stats.listenerCount = listeners_.empty() && isValid() ? 1 : listeners_.size();
     
-    // Calculate total bytes from all connections
-    {
-        std::lock_guard<std::mutex> connLock(connectionsMutex_);
-        for (const auto& connection : connections_) {
-            if (connection) {
-                auto info = connection->getInfo();
-                stats.totalBytesReceived += info.bytesReceived;
-                stats.totalBytesSent += info.bytesSent;
-            }
+    if (loopGroup_ && reactorConnections_) {
+        for (size_t i = 0; i < loopGroup_->size(); i++) {
+            stats.reactorConnections.push_back(reactorConnections_[i].load(std::memory_order_relaxed));
         }
     }
     
+    stats.totalBytesReceived = static_cast<size_t>(metrics_->bytesReceived.value());
+    stats.totalBytesSent = static_cast<size_t>(metrics_->bytesSent.value());
+    stats.messagesSent = static_cast<size_t>(metrics_->messagesSent.value());
+    stats.messagesReceived = static_cast<size_t>(metrics_->messagesReceived.value());
+    stats.sendCalls = static_cast<size_t>(metrics_->sendCalls.value());
+    stats.receiveCalls = static_cast<size_t>(metrics_->receiveCalls.value());
+    if (loopGroup_) {
+        for (size_t i = 0; i < loopGroup_->size(); i++) {
+            stats.pollerCalls += static_cast<size_t>(loopGroup_->getLoop(i)->getSyscallCount());
+            stats.reactorUtilization.push_back(loopGroup_->getLoop(i)->getUtilization());
+        }
+    }
+    stats.queuedBytes = static_cast<size_t>(std::max<int64_t>(0, metrics_->queuedBytes.value()));
+    stats.readLatency = metrics_->readToCallback.snapshot();
+    stats.callbackDuration = metrics_->callbackDuration.snapshot();
     return stats;
 }
 
+double TcpServer::Statistics::messagesPerSecond(const Statistics& earlier) const {
+    double seconds = std::chrono::duration<double>(sampledAt - earlier.sampledAt).count();
+    size_t messages = messagesSent + messagesReceived - earlier.messagesSent - earlier.messagesReceived;
+    return seconds > 0 ? messages / seconds : 0.0;
+}
+
+double TcpServer::Statistics::acceptsPerSecond(const Statistics& earlier) const {
+    double seconds = std::chrono::duration<double>(sampledAt - earlier.sampledAt).count();
+    return seconds > 0 ? (totalConnections - earlier.totalConnections) / seconds : 0.0;
+}
+
+double TcpServer::Statistics::syscallsPerMessage() const {
+    size_t messages = messagesSent + messagesReceived;
+    return messages > 0 ? static_cast<double>(sendCalls + receiveCalls + pollerCalls) / messages : 0.0;
+}
+
+std::string TcpServer::getPrometheusMetrics(const std::string& prefix) const {
+    Statistics stats = getStatistics();
+    Broadcaster::Statistics broadcast = broadcaster_.getStatistics();
+    
+    PrometheusWriter writer(prefix);
+    writer.counter("connections_total", "Connections accepted", stats.totalConnections);
+    writer.gauge("connections_active", "Open connections", stats.activeConnections);
+    writer.counter("bytes_sent_total", "Bytes written to sockets", stats.totalBytesSent);
+    writer.counter("bytes_received_total", "Bytes read from sockets", stats.totalBytesReceived);
+    writer.counter("messages_sent_total", "Messages sent or queued", stats.messagesSent);
+    writer.counter("messages_received_total", "Receive callbacks", stats.messagesReceived);
+    writer.counter("send_syscalls_total", "Write system calls", stats.sendCalls);
+    writer.counter("receive_syscalls_total", "Read system calls", stats.receiveCalls);
+    writer.counter("poller_syscalls_total", "Reactor wait and registration system calls", stats.pollerCalls);
+    std::vector<std::pair<std::string, double>> busy;
+    std::vector<std::pair<std::string, double>> idle;
+    for (size_t i = 0; i < stats.reactorUtilization.size(); i++) {
+        const EventLoop::Utilization& reactor = stats.reactorUtilization[i];
+        std::string labels = "reactor=\"" + std::to_string(i) + "\",cpu=\"" + std::to_string(reactor.cpu) + "\"";
+        busy.emplace_back(labels, reactor.busyNanos / 1e9);
+        idle.emplace_back(labels, reactor.idleNanos / 1e9);
+    }
+    writer.counter("reactor_busy_seconds_total", "I/O thread time spent handling events", busy);
+    writer.counter("reactor_idle_seconds_total", "I/O thread time spent waiting for events", idle);
+    writer.gauge("send_queue_bytes", "Bytes waiting in send queues", stats.queuedBytes);
+    writer.histogram("read_latency_seconds", "Time from readiness to receive callback", stats.readLatency);
+    writer.histogram("callback_duration_seconds", "Time spent in receive callbacks", stats.callbackDuration);
+    writer.counter("broadcast_messages_total", "broadcast() and publish() calls", broadcast.messages);
+    writer.counter("broadcast_deliveries_total", "Broadcast messages handed to connections", broadcast.deliveries);
+    writer.counter("broadcast_dropped_total", "Broadcast messages dropped for slow consumers", broadcast.dropped);
+    return writer.str();
+}
+
 void TcpServer::acceptLoop() {
     while (!shouldStop_ && running_) {
-        auto connection = acceptConnection();
+        auto connection = acceptPendingConnection();
         if (connection) {
             handleNewConnection(connection);
         } else {
@@ -233,77 +602,73 @@ void TcpServer::acceptLoop() {
     }
 }
 
-void TcpServer::cleanupLoop() {
-    while (!shouldStop_) {
-        // Clean up disconnected connections
-        {
-            std::lock_guard<std::mutex> lock(connectionsMutex_);
-            connections_.erase(
-                std::remove_if(connections_.begin(), connections_.end(),
-                    [](const std::shared_ptr<TcpConnection>& conn) {
-                        return !conn || !conn->isConnected();
-                    }),
-                connections_.end()
-            );
-        }
-        
-        // Wait for stop signal or timeout
-        std::unique_lock<std::mutex> lock(stopMutex_);
-        stopCondition_.wait_for(lock, std::chrono::seconds(5), [this] { return shouldStop_.load(); });
-    }
-}
-
 void TcpServer::handleNewConnection(std::shared_ptr<TcpConnection> connection) {
-    {
-        std::lock_guard<std::mutex> lock(connectionsMutex_);
-        connections_.push_back(connection);
+    // Accepted while stopping: the connection's reactor may already be draining
+    if (!running_) {
+        refuseConnection(connection);
+        return;
     }
     
-    {
-        std::lock_guard<std::mutex> lock(statisticsMutex_);
-        statistics_.totalConnections++;
+    // The handshake runs from the connection's first readable event
+    if (sslEnabled_ && sslContext_ && !connection->enableSsl(sslContext_)) {
+        refuseConnection(connection);
+        return;
     }
     
-    // Enable SSL if configured
-    if (sslEnabled_ && sslContext_) {
-        connection->enableSsl(sslContext_);
+    connections_.insert(connection);
+    broadcaster_.add(connection);
+    
+    acceptedConnections_.add();
+    
+    if (EventLoop* loop = connection->getEventLoop()) {
+        reactorConnections_[loopGroup_->indexOf(loop)]++;
     }
     
     if (onConnected_) {
         onConnected_(connection);
     }
+    
+    // Start reading once the application has seen the connection
+    if (!connection->startReading()) {
+        connection->close();
+    }
+}
+
+void TcpServer::refuseConnection(std::shared_ptr<TcpConnection> connection) {
+    // Never registered or counted, and the application never saw it, so
+    // its close must not reach handleDisconnection(). Nothing reads the
+    // callback yet: reading has not started.
+    connection->setOnDisconnected(nullptr);
+    connection->close();
 }
 
 void TcpServer::handleDisconnection(std::shared_ptr<TcpConnection> connection) {
     removeConnection(connection);
     
+    EventLoop* loop = connection->getEventLoop();
+    if (loop && loopGroup_) {
+        reactorConnections_[loopGroup_->indexOf(loop)]--;
+    }
+    
     if (onDisconnected_) {
         onDisconnected_(connection);
     }
 }
 
 void TcpServer::removeConnection(std::shared_ptr<TcpConnection> connection) {
-    std::lock_guard<std::mutex> lock(connectionsMutex_);
-    
-    connections_.erase(
-        std::remove_if(connections_.begin(), connections_.end(),
-            [connection](const std::shared_ptr<TcpConnection>& conn) {
-                return conn == connection;
-            }),
-        connections_.end()
-    );
-}
-
-void TcpServer::updateStatistics() {
-    std::lock_guard<std::mutex> lock(statisticsMutex_);
-    statistics_.activeConnections = getConnectionCount();
+    connections_.remove(connection->getId());
+    broadcaster_.remove(connection);
 }
 
 void TcpServer::setupConnectionCallbacks(std::shared_ptr<TcpConnection> connection) {
     // Set up connection callbacks
-    connection->setOnDataReceived([this](std::shared_ptr<TcpConnection> conn, const std::vector<uint8_t>& data) {
+    // Single zero-copy hook; a vector is only built for vector callbacks
+    connection->setOnBufferReceived([this](std::shared_ptr<TcpConnection> conn, const BufferView& data) {
+        if (onBufferReceived_) {
+            onBufferReceived_(conn, data);
+        }
         if (onDataReceived_) {
-            onDataReceived_(conn, data);
+            onDataReceived_(conn, data.toVector());
         }
     });
     
@@ -316,6 +681,21 @@ void TcpServer::setupConnectionCallbacks(std::shared_ptr<TcpConnection> connecti
             onError_(conn, error, message);
         }
     });
+    
+    connection->setOnBackpressure([this](std::shared_ptr<TcpConnection> conn, bool aboveHighWatermark) {
+        if (!aboveHighWatermark) {
+            broadcaster_.onDrained(conn);
+        }
+        if (onBackpressure_) {
+            onBackpressure_(conn, aboveHighWatermark);
+        }
+    });
+    
+    connection->setOnMessagesReceived([this](std::shared_ptr<TcpConnection> conn, const std::vector<BufferView>& messages) {
+        if (onMessagesReceived_) {
+            onMessagesReceived_(conn, messages);
+        }
+    });
 }
 
 } // namespace tcp
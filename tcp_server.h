@@ -1,6 +1,10 @@
 #pragma once
 
 #include "tcp_socket.h"
+#include "event_loop.h"
+#include "connection_registry.h"
+#include "broadcaster.h"
+#include "metrics.h"
 #include <vector>
 #include <memory>
 #include <atomic>
@@ -13,12 +17,87 @@ namespace tcp {
 
 class TcpServer : public TcpSocket {
 public:
+    // How accepted connections are driven
+    enum class IoMode {
+        Reactor,             // Fixed pool of event-loop threads multiplexes all connections
+        ThreadPerConnection  // Legacy: one receive thread per connection
+    };
+
     TcpServer();
     ~TcpServer();
 
-    // Server lifecycle
+    // I/O configuration (must be set before start())
+    void setIoMode(IoMode mode) { ioMode_ = mode; }
+    IoMode getIoMode() const { return ioMode_; }
+    void setIoThreadCount(size_t count) { ioThreadCount_ = count; } // 0 = hardware concurrency
+    size_t getIoThreadCount() const;
+    // io_uring and its SQPOLL thread, when built with TCP_IO_URING
+    void setEventLoopOptions(const EventLoop::Options& options) { loopOptions_ = options; }
+    const EventLoop::Options& getEventLoopOptions() const { return loopOptions_; }
+    
+    // Placement for latency-critical servers. I/O thread i is pinned to
+    // cpus[i % cpus.size()]; with a local pool (EventLoop::Options::
+    // localBufferBytes) each reads into memory on its own NUMA node. With
+    // steering, reactor mode hands each connection to the I/O thread
+    // pinned to the CPU that takes its packets (SO_INCOMING_CPU), so the
+    // NIC queue, the reactor and its buffers share a core.
+    void setIoThreadCpus(const std::vector<int>& cpus) { ioThreadCpus_ = cpus; }
+    const std::vector<int>& getIoThreadCpus() const { return ioThreadCpus_; }
+    void setIncomingCpuSteering(bool enable) { incomingCpuSteering_ = enable; }
+    bool isIncomingCpuSteeringEnabled() const { return incomingCpuSteering_; }
+    // Busy-poll mode: reads spin on the device queue (SO_BUSY_POLL on the
+    // listeners, inherited by accepted sockets) and I/O threads spin this
+    // long before sleeping. Costs a core per I/O thread while spinning.
+    void setBusyPoll(std::chrono::microseconds duration);
+    
+    // Reactor mode: give every I/O thread its own SO_REUSEPORT listener so
+    // accepts are spread by the kernel. Without kernel support a single
+    // listener hands connections off round-robin.
+    void setAcceptorSharding(bool enable) { acceptorSharding_ = enable; }
+    bool isAcceptorShardingEnabled() const { return acceptorSharding_; }
+    static bool isAcceptorShardingSupported();
+    
+    // Send mode and write watermarks applied to each accepted connection.
+    // Queued (the default) is only available in reactor mode; Direct sends
+    // from an I/O-thread callback fail with WouldBlock rather than wait.
+    void setSendMode(TcpConnection::SendMode mode) { sendMode_ = mode; }
+    TcpConnection::SendMode getSendMode() const { return sendMode_; }
+    void setWriteWatermarks(size_t lowWatermark, size_t highWatermark);
+    
+    // Deadlines applied to each accepted connection in reactor mode (0 =
+    // none): close after this long without traffic either way, or when a
+    // TLS handshake hasn't finished in time. Both run on the connection's
+    // I/O thread, so idle eviction costs no thread per connection.
+    void setIdleTimeout(std::chrono::milliseconds timeout) { idleTimeout_ = timeout; }
+    std::chrono::milliseconds getIdleTimeout() const { return idleTimeout_; }
+    void setHandshakeTimeout(std::chrono::milliseconds timeout) { handshakeTimeout_ = timeout; }
+    std::chrono::milliseconds getHandshakeTimeout() const { return handshakeTimeout_; }
+
+    // Shaping for accepted connections (set before start(); 0 = no limit).
+    // Each connection gets its own bucket at the per-connection rate, and
+    // all of them draw from one shared bucket at the total rate, so a busy
+    // connection can't take the whole budget.
+    void setSendRateLimit(size_t perConnectionBytesPerSecond, size_t totalBytesPerSecond = 0);
+    void setReceiveRateLimit(size_t perConnectionBytesPerSecond, size_t totalBytesPerSecond = 0);
+    std::shared_ptr<RateLimiter> getSendRateLimiter() const { return sendLimiter_; }       // Total; may be null
+    std::shared_ptr<RateLimiter> getReceiveRateLimiter() const { return receiveLimiter_; } // Total; may be null
+
+    // IPv6 listeners also accept IPv4 peers (default), whose addresses are
+    // reported in IPv4 form; so bind("::", port) serves both families.
+    // Set before bind().
+    void setDualStack(bool enable) { dualStack_ = enable; }
+    bool isDualStack() const { return dualStack_; }
+
+    // Receive batching for accepted connections (set before start()): each
+    // gets a framer from makeFramer, and setOnMessagesReceived gets the
+    // messages of one readiness event at a time (see TcpConnection)
+    void setReceiveBatching(std::function<std::unique_ptr<MessageFramer>()> makeFramer,
+                            size_t maxReads = 16, size_t maxBytes = 256 * 1024);
+
+    // Server lifecycle. The address is an IPv4 or IPv6 literal or a host
+    // name, which binds its first address.
     bool bind(const std::string& address, uint16_t port);
-    bool bind(uint16_t port); // Bind to all interfaces
+    bool bind(uint16_t port); // Bind to all IPv4 interfaces
     bool listen(int backlog = 10);
     bool start(const std::string& address, uint16_t port, int backlog = 10);
     void stop();
@@ -28,8 +107,12 @@ public:
     std::shared_ptr<TcpConnection> acceptConnection();
     std::vector<std::shared_ptr<TcpConnection>> getConnections() const;
     size_t getConnectionCount() const;
+    std::shared_ptr<TcpConnection> findConnection(ConnectionId id) const;
     void closeConnection(std::shared_ptr<TcpConnection> connection);
     void closeAllConnections();
+    // Frames the messages into one write on the connection
+    bool sendBatch(ConnectionId id, const ByteView* messages, size_t count, MessageFramer& framer);
+    bool sendBatch(ConnectionId id, const std::vector<ByteView>& messages, MessageFramer& framer);
 
     // Server info
     std::string getLocalAddress() const { return localAddress_; }
@@ -39,7 +122,10 @@ public:
     void setOnConnected(OnConnectedCallback callback) { onConnected_ = callback; }
     void setOnDisconnected(OnDisconnectedCallback callback) { onDisconnected_ = callback; }
     void setOnDataReceived(OnDataReceivedCallback callback) { onDataReceived_ = callback; }
+    void setOnBufferReceived(OnBufferReceivedCallback callback) { onBufferReceived_ = callback; }
     void setOnError(OnErrorCallback callback) { onError_ = callback; }
+    void setOnBackpressure(OnBackpressureCallback callback) { onBackpressure_ = callback; }
+    void setOnMessagesReceived(OnMessagesReceivedCallback callback) { onMessagesReceived_ = callback; }
 
     // SSL/TLS
     void enableSsl(std::shared_ptr<SslContext> context);
@@ -49,20 +135,50 @@ public:
     void startAsync();
     void stopAsync();
 
-    // Broadcast to all connections
+    // Broadcast to all connections, or publish to a topic's subscribers.
+    // The payload is copied once and shared by every queue; each I/O thread
+    // delivers to its own connections (see Broadcaster for slow consumers).
     void broadcast(const std::vector<uint8_t>& data);
     void broadcast(const std::string& data);
     void broadcast(const void* data, size_t length);
+    void broadcast(const BufferView& payload, ConnectionId exclude = 0);
+    void publish(const std::string& topic, const std::string& data, ConnectionId exclude = 0);
+    void publish(const std::string& topic, const BufferView& payload, ConnectionId exclude = 0);
+    bool subscribe(std::shared_ptr<TcpConnection> connection, const std::string& topic);
+    bool unsubscribe(std::shared_ptr<TcpConnection> connection, const std::string& topic);
+    Broadcaster& getBroadcaster() { return broadcaster_; }
 
-    // Statistics
+    // Statistics. Totals cover every connection since start(), closed ones
+    // included; taking a snapshot sums counter shards and never walks the
+    // connections.
     struct Statistics {
         size_t totalConnections = 0;
         size_t activeConnections = 0;
         size_t totalBytesReceived = 0;
         size_t totalBytesSent = 0;
         std::chrono::system_clock::time_point startTime;
+        size_t listenerCount = 0;
+        std::vector<size_t> reactorConnections; // Active connections per I/O thread
+        size_t messagesSent = 0;                // send()/sendFile() calls and batched messages
+        size_t messagesReceived = 0;            // Receive callbacks
+        size_t sendCalls = 0;                   // Write syscalls
+        size_t receiveCalls = 0;                // Read syscalls
+        size_t pollerCalls = 0;                 // Reactor waits and registration changes
+        std::vector<EventLoop::Utilization> reactorUtilization; // Per I/O thread, with its CPU
+        size_t queuedBytes = 0;                 // Bytes waiting in send queues
+        LatencyHistogram::Snapshot readLatency; // Readiness to receive callback
+        LatencyHistogram::Snapshot callbackDuration;
+        std::chrono::steady_clock::time_point sampledAt;
+        
+        // Rates between an earlier snapshot and this one
+        double messagesPerSecond(const Statistics& earlier) const;
+        double acceptsPerSecond(const Statistics& earlier) const;
+        double syscallsPerMessage() const;
     };
     Statistics getStatistics() const;
+    
+    // Prometheus text format of getStatistics() and the broadcaster's counters
+    std::string getPrometheusMetrics(const std::string& prefix = "tcp_server") const;
 
 private:
     std::string localAddress_;
@@ -70,9 +186,46 @@ private:
     std::atomic<bool> running_;
     std::atomic<bool> shouldStop_;
     
-    // Connection management
-    std::vector<std::shared_ptr<TcpConnection>> connections_;
-    mutable std::mutex connectionsMutex_;
+    // I/O mode
+    IoMode ioMode_;
+    size_t ioThreadCount_;
+    EventLoop::Options loopOptions_;
+    std::vector<int> ioThreadCpus_;
+    bool incomingCpuSteering_;
+    std::unique_ptr<EventLoopGroup> loopGroup_;
+    std::unique_ptr<std::atomic<size_t>[]> reactorConnections_;
+    
+    // Listening sockets (socket_ first, then SO_REUSEPORT shards)
+    struct Listener {
+        socket_t socket;
+        size_t loopIndex;
+    };
+    std::vector<Listener> listeners_;
+    bool acceptorSharding_;
+    bool dualStack_;
+    SocketAddress bindAddress_;
+    
+    // Per-connection write settings
+    TcpConnection::SendMode sendMode_;
+    size_t lowWatermark_;
+    size_t highWatermark_;
+    std::chrono::milliseconds idleTimeout_;
+    std::chrono::milliseconds handshakeTimeout_;
+    
+    // Receive batching
+    std::function<std::unique_ptr<MessageFramer>()> makeFramer_;
+    size_t batchMaxReads_;
+    size_t batchMaxBytes_;
+    
+    // Shaping: per-connection rates under shared totals
+    size_t sendRatePerConnection_;
+    size_t receiveRatePerConnection_;
+    std::shared_ptr<RateLimiter> sendLimiter_;
+    std::shared_ptr<RateLimiter> receiveLimiter_;
+    
+    // Connection management (entries are removed as connections close)
+    ConnectionRegistry connections_;
+    Broadcaster broadcaster_;
     
     // SSL/TLS
     bool sslEnabled_;
@@ -82,25 +235,32 @@ private:
     OnConnectedCallback onConnected_;
     OnDisconnectedCallback onDisconnected_;
     OnDataReceivedCallback onDataReceived_;
+    OnBufferReceivedCallback onBufferReceived_;
     OnErrorCallback onError_;
+    OnBackpressureCallback onBackpressure_;
+    OnMessagesReceivedCallback onMessagesReceived_;
     
     // Threading
     std::thread acceptThread_;
-    std::thread cleanupThread_;
-    std::condition_variable stopCondition_;
-    std::mutex stopMutex_;
     
     // Statistics
-    mutable Statistics statistics_;
-    mutable std::mutex statisticsMutex_;
+    std::chrono::system_clock::time_point startTime_;
+    std::shared_ptr<ConnectionMetrics> metrics_;
+    Counter acceptedConnections_;
     
     // Internal methods
     void acceptLoop();
-    void cleanupLoop();
+    std::shared_ptr<TcpConnection> acceptPendingConnection();
+    bool startAcceptors(int backlog);
+    socket_t createShardListener(int backlog);
+    void handleAcceptReady(size_t listenerIndex);
+    void handleAccepted(size_t listenerIndex, socket_t clientSocket, const SocketAddress& address);
+    std::shared_ptr<TcpConnection> createConnection(socket_t socket, const SocketAddress& address, EventLoop* loop);
+    bool usesAcceptorSharding() const { return ioMode_ == IoMode::Reactor && acceptorSharding_ && isAcceptorShardingSupported(); }
     void handleNewConnection(std::shared_ptr<TcpConnection> connection);
     void handleDisconnection(std::shared_ptr<TcpConnection> connection);
+    void refuseConnection(std::shared_ptr<TcpConnection> connection);
     void removeConnection(std::shared_ptr<TcpConnection> connection);
-    void updateStatistics();
     void setupConnectionCallbacks(std::shared_ptr<TcpConnection> connection);
 };
 
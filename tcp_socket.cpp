@@ -1,5 +1,14 @@
 #include "tcp_socket.h"
+#include "event_loop.h"
+#include "outbound_queue.h"
+#include "executor.h"
+#include "tls_session.h"
+#include "file_transfer.h"
+#include "resolver.h"
+#include "rate_limiter.h"
+#include "tcp_utils.h"
 #include <iostream>
+#include <algorithm>
 #include <cstring>
 #include <sstream>
 #include <future>
@@ -9,10 +18,205 @@ bool tcp::TcpSocket::wsaInitialized_ = false;
 std::mutex tcp::TcpSocket::wsaMutex_;
 #else
 #include <netinet/tcp.h>
+#include <net/if.h>
+#include <poll.h>
 #endif
 
 namespace tcp {
 
+namespace {
+
+// Connection IDs start at 1 so 0 can mean "none"
+std::atomic<uint64_t> nextConnectionId(1);
+
+// Default queued-send watermarks
+constexpr size_t kDefaultLowWatermark = 256 * 1024;
+constexpr size_t kDefaultHighWatermark = 1024 * 1024;
+
+#ifdef MSG_NOSIGNAL
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+constexpr int kSendFlags = 0;
+#endif
+
+// Drain flag for reads after readiness; without it (Windows) one read per wakeup
+#ifdef MSG_DONTWAIT
+constexpr int kRecvNoWait = MSG_DONTWAIT;
+#else
+constexpr int kRecvNoWait = 0;
+#endif
+
+// Upper bound on reads per readiness event so one busy peer can't starve the loop
+constexpr int kMaxReadsPerEvent = 16;
+
+// Queued messages per linked send chain on completion loops
+constexpr size_t kMaxSendLinks = 64;
+
+// A receive thread held back by its rate limiter sleeps in slices this
+// long, so close() never waits on it for the whole delay
+constexpr std::chrono::milliseconds kShapingSleepSlice(50);
+
+void closeSocketHandle(socket_t socket) {
+#ifdef _WIN32
+    closesocket(socket);
+#else
+    ::close(socket);
+#endif
+}
+
+bool isWouldBlock() {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+void setNonBlockingHandle(socket_t socket) {
+#ifdef _WIN32
+    u_long mode = 1;
+    ioctlsocket(socket, FIONBIO, &mode);
+#else
+    fcntl(socket, F_SETFL, fcntl(socket, F_GETFL, 0) | O_NONBLOCK);
+#endif
+}
+
+// TLS sends that stall on a handshake poll in short slices: the reader side
+// may consume the readiness they are waiting for
+constexpr std::chrono::milliseconds kTlsRetrySlice{10};
+
+// Queued data goes through the TLS session unless kernel TLS took over the
+// record layer, in which case plain gathered writes are encrypted in the kernel
+OutboundQueue::FlushResult flushQueue(OutboundQueue& queue, socket_t socket, TlsSession* tls, size_t& bytesWritten) {
+    if (!tls || tls->isKernelTlsSend()) {
+        return queue.flush(socket, bytesWritten);
+    }
+    
+    return queue.flush([tls](const uint8_t* data, size_t length) -> long {
+        size_t written = 0;
+        switch (tls->write(data, length, written)) {
+            case TlsSession::Status::Ok: return static_cast<long>(written);
+            case TlsSession::Status::WantRead:
+            case TlsSession::Status::WantWrite: return 0;
+            default: return -1;
+        }
+    }, bytesWritten);
+}
+
+} // namespace
+
+// SocketAddress implementation
+SocketAddress::SocketAddress() : length_(0) {
+    std::memset(&storage_, 0, sizeof(storage_));
+}
+
+SocketAddress::SocketAddress(const struct sockaddr* address, socklen_t length) : SocketAddress() {
+    if (address && length > 0 && static_cast<size_t>(length) <= sizeof(storage_) &&
+        (address->sa_family == AF_INET || address->sa_family == AF_INET6)) {
+        std::memcpy(&storage_, address, length);
+        length_ = length;
+    }
+}
+
+bool SocketAddress::parse(const std::string& ip, uint16_t port, SocketAddress& address) {
+    address = SocketAddress();
+    
+    struct sockaddr_in* ipv4 = reinterpret_cast<struct sockaddr_in*>(&address.storage_);
+    if (ip.empty() || inet_pton(AF_INET, ip.c_str(), &ipv4->sin_addr) == 1) {
+        ipv4->sin_family = AF_INET;
+        ipv4->sin_port = htons(port);
+        address.length_ = sizeof(struct sockaddr_in);
+        return true;
+    }
+    
+    // Brackets as in URLs; a zone index selects the interface of a link-local address
+    std::string host = ip.size() > 2 && ip.front() == '[' && ip.back() == ']' ? ip.substr(1, ip.size() - 2) : ip;
+    std::string zone;
+    size_t percent = host.find('%');
+    if (percent != std::string::npos) {
+        zone = host.substr(percent + 1);
+        host.resize(percent);
+    }
+    
+    struct sockaddr_in6* ipv6 = reinterpret_cast<struct sockaddr_in6*>(&address.storage_);
+    if (inet_pton(AF_INET6, host.c_str(), &ipv6->sin6_addr) != 1) {
+        return false;
+    }
+    ipv6->sin6_family = AF_INET6;
+    ipv6->sin6_port = htons(port);
+    if (!zone.empty()) {
+#ifndef _WIN32
+        ipv6->sin6_scope_id = if_nametoindex(zone.c_str());
+#endif
+        if (ipv6->sin6_scope_id == 0) {
+            ipv6->sin6_scope_id = static_cast<uint32_t>(std::strtoul(zone.c_str(), nullptr, 10));
+        }
+    }
+    address.length_ = sizeof(struct sockaddr_in6);
+    return true;
+}
+
+SocketAddress SocketAddress::local(socket_t socket) {
+    struct sockaddr_storage storage;
+    socklen_t length = sizeof(storage);
+    if (getsockname(socket, reinterpret_cast<struct sockaddr*>(&storage), &length) != 0) {
+        return SocketAddress();
+    }
+    return SocketAddress(reinterpret_cast<struct sockaddr*>(&storage), length);
+}
+
+SocketAddress SocketAddress::peer(socket_t socket) {
+    struct sockaddr_storage storage;
+    socklen_t length = sizeof(storage);
+    if (getpeername(socket, reinterpret_cast<struct sockaddr*>(&storage), &length) != 0) {
+        return SocketAddress();
+    }
+    return SocketAddress(reinterpret_cast<struct sockaddr*>(&storage), length);
+}
+
+std::string SocketAddress::getIp() const {
+    char text[INET6_ADDRSTRLEN] = {};
+    
+    if (storage_.ss_family == AF_INET) {
+        const struct sockaddr_in* ipv4 = reinterpret_cast<const struct sockaddr_in*>(&storage_);
+        inet_ntop(AF_INET, &ipv4->sin_addr, text, sizeof(text));
+    } else if (storage_.ss_family == AF_INET6) {
+        // Dual-stack listeners see IPv4 peers as ::ffff:a.b.c.d
+        const struct sockaddr_in6* ipv6 = reinterpret_cast<const struct sockaddr_in6*>(&storage_);
+        if (IN6_IS_ADDR_V4MAPPED(&ipv6->sin6_addr)) {
+            inet_ntop(AF_INET, &ipv6->sin6_addr.s6_addr[12], text, sizeof(text));
+        } else {
+            inet_ntop(AF_INET6, &ipv6->sin6_addr, text, sizeof(text));
+        }
+    }
+    return text;
+}
+
+uint16_t SocketAddress::getPort() const {
+    if (storage_.ss_family == AF_INET) {
+        return ntohs(reinterpret_cast<const struct sockaddr_in*>(&storage_)->sin_port);
+    }
+    if (storage_.ss_family == AF_INET6) {
+        return ntohs(reinterpret_cast<const struct sockaddr_in6*>(&storage_)->sin6_port);
+    }
+    return 0;
+}
+
+void SocketAddress::setPort(uint16_t port) {
+    if (storage_.ss_family == AF_INET) {
+        reinterpret_cast<struct sockaddr_in*>(&storage_)->sin_port = htons(port);
+    } else if (storage_.ss_family == AF_INET6) {
+        reinterpret_cast<struct sockaddr_in6*>(&storage_)->sin6_port = htons(port);
+    }
+}
+
+std::string SocketAddress::toString() const {
+    std::string ip = getIp();
+    bool bracketed = ip.find(':') != std::string::npos;
+    return (bracketed ? "[" + ip + "]" : ip) + ":" + std::to_string(getPort());
+}
+
+// TcpSocket implementation
 TcpSocket::TcpSocket() : socket_(INVALID_SOCKET), nonBlocking_(false) {
     initialize();
 }
@@ -61,17 +265,20 @@ void TcpSocket::cleanup() {
 #endif
 }
 
-bool TcpSocket::create() {
+bool TcpSocket::create(int family) {
     std::lock_guard<std::mutex> lock(mutex_);
     
+    // A socket left behind by a lost connection (close() would relock mutex_)
     if (isValid()) {
-        close();
+        closeSocketHandle(socket_);
+        socket_ = INVALID_SOCKET;
     }
     
-    socket_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    socket_ = socket(family, SOCK_STREAM, IPPROTO_TCP);
     if (socket_ == INVALID_SOCKET) {
         return false;
     }
+    nonBlocking_ = false;
     
     // Set default options (don't fail if some options can't be set)
     setSocketOptionsInternal(options_);
@@ -79,6 +286,17 @@ bool TcpSocket::create() {
     return true;
 }
 
+void TcpSocket::adopt(socket_t socket, bool nonBlocking) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    
+    if (isValid()) {
+        closeSocketHandle(socket_);
+    }
+    socket_ = socket;
+    nonBlocking_ = nonBlocking;
+    setSocketOptionsInternal(options_);
+}
+
 void TcpSocket::close() {
     std::lock_guard<std::mutex> lock(mutex_);
     
@@ -99,70 +317,85 @@ bool TcpSocket::isValid() const {
 bool TcpSocket::setSocketOptions(const SocketOptions& options) {
     std::lock_guard<std::mutex> lock(mutex_);
     
-    if (!isValid()) {
-        return false;
-    }
-    
+    // Applied by create() and adopt() when there is no socket yet
     options_ = options;
-    return setSocketOptionsInternal(options);
+    return !isValid() || setSocketOptionsInternal(options);
 }
 
 bool TcpSocket::setSocketOptionsInternal(const SocketOptions& options) {
+    return applySocketOptions(socket_, options);
+}
+
+bool TcpSocket::applySocketOptions(socket_t socket, const SocketOptions& options) {
     bool success = true;
+    auto set = [socket, &success](int level, int optname, const void* optval, socklen_t optlen) {
+        if (setsockopt(socket, level, optname, static_cast<const char*>(optval), optlen) != 0) {
+            success = false;
+        }
+    };
     
     // Set reuse address
     int optval = options.reuseAddress ? 1 : 0;
-    if (!setSocketOption(SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval))) {
-        success = false;
-    }
+    set(SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
     
     // Set keep alive
     optval = options.keepAlive ? 1 : 0;
-    if (!setSocketOption(SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof(optval))) {
-        success = false;
-    }
+    set(SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof(optval));
     
     // Set no delay (disable Nagle's algorithm)
     optval = options.noDelay ? 1 : 0;
-    if (!setSocketOption(IPPROTO_TCP, TCP_NODELAY, &optval, sizeof(optval))) {
-        success = false;
-    }
+    set(IPPROTO_TCP, TCP_NODELAY, &optval, sizeof(optval));
     
     // Set send buffer size
     optval = options.sendBufferSize;
-    if (!setSocketOption(SOL_SOCKET, SO_SNDBUF, &optval, sizeof(optval))) {
-        success = false;
-    }
+    set(SOL_SOCKET, SO_SNDBUF, &optval, sizeof(optval));
     
     // Set receive buffer size
     optval = options.receiveBufferSize;
-    if (!setSocketOption(SOL_SOCKET, SO_RCVBUF, &optval, sizeof(optval))) {
-        success = false;
-    }
+    set(SOL_SOCKET, SO_RCVBUF, &optval, sizeof(optval));
     
     // Set timeouts
 #ifdef _WIN32
     DWORD timeout = static_cast<DWORD>(options.sendTimeout.count());
-    if (!setSocketOption(SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout))) {
-        success = false;
-    }
+    set(SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
     
     timeout = static_cast<DWORD>(options.receiveTimeout.count());
-    if (!setSocketOption(SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout))) {
-        success = false;
-    }
+    set(SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
 #else
     struct timeval timeout;
     timeout.tv_sec = options.sendTimeout.count() / 1000;
     timeout.tv_usec = (options.sendTimeout.count() % 1000) * 1000;
-    if (!setSocketOption(SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout))) {
-        success = false;
-    }
+    set(SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
     
     timeout.tv_sec = options.receiveTimeout.count() / 1000;
     timeout.tv_usec = (options.receiveTimeout.count() % 1000) * 1000;
-    if (!setSocketOption(SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout))) {
-        success = false;
+    set(SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+#endif
+    
+    // Latency tuning: only what was asked for, so defaults cost nothing
+    // (raising SO_BUSY_POLL above net.core.busy_read needs CAP_NET_ADMIN)
+#ifdef TCP_QUICKACK
+    if (options.quickAck) {
+        optval = 1;
+        set(IPPROTO_TCP, TCP_QUICKACK, &optval, sizeof(optval));
+    }
+#endif
+#ifdef TCP_NOTSENT_LOWAT
+    if (options.notSentLowWatermark > 0) {
+        optval = options.notSentLowWatermark;
+        set(IPPROTO_TCP, TCP_NOTSENT_LOWAT, &optval, sizeof(optval));
+    }
+#endif
+#ifdef SO_BUSY_POLL
+    if (options.busyPoll.count() > 0) {
+        optval = static_cast<int>(options.busyPoll.count());
+        set(SOL_SOCKET, SO_BUSY_POLL, &optval, sizeof(optval));
+    }
+#endif
+#ifdef SO_ZEROCOPY
+    if (options.zeroCopy) {
+        optval = 1;
+        set(SOL_SOCKET, SO_ZEROCOPY, &optval, sizeof(optval));
     }
 #endif
     
@@ -270,8 +503,7 @@ std::string TcpSocket::getLocalAddress() {
         struct addrinfo* result = nullptr;
         if (getaddrinfo(hostname, nullptr, &hints, &result) == 0) {
             if (result && result->ai_family == AF_INET) {
-                struct sockaddr_in* addr = reinterpret_cast<struct sockaddr_in*>(result->ai_addr);
-                std::string ip = inet_ntoa(addr->sin_addr);
+                std::string ip = SocketAddress(result->ai_addr, static_cast<socklen_t>(result->ai_addrlen)).getIp();
                 freeaddrinfo(result);
                 return ip;
             }
@@ -293,9 +525,10 @@ std::vector<std::string> TcpSocket::getLocalAddresses() {
         struct addrinfo* result = nullptr;
         if (getaddrinfo(hostname, nullptr, &hints, &result) == 0) {
             for (struct addrinfo* addr = result; addr != nullptr; addr = addr->ai_next) {
-                if (addr->ai_family == AF_INET) {
-                    struct sockaddr_in* addr_in = reinterpret_cast<struct sockaddr_in*>(addr->ai_addr);
-                    addresses.push_back(inet_ntoa(addr_in->sin_addr));
+                SocketAddress address(addr->ai_addr, static_cast<socklen_t>(addr->ai_addrlen));
+                if (address.isValid() &&
+                    std::find(addresses.begin(), addresses.end(), address.getIp()) == addresses.end()) {
+                    addresses.push_back(address.getIp());
                 }
             }
             freeaddrinfo(result);
@@ -310,87 +543,128 @@ std::vector<std::string> TcpSocket::getLocalAddresses() {
 }
 
 bool TcpSocket::resolveAddress(const std::string& hostname, std::string& ip) {
-    struct addrinfo hints = {};
-    hints.ai_family = AF_INET;
-    hints.ai_socktype = SOCK_STREAM;
-    
-    struct addrinfo* result = nullptr;
-    if (getaddrinfo(hostname.c_str(), nullptr, &hints, &result) == 0) {
-        if (result && result->ai_family == AF_INET) {
-            struct sockaddr_in* addr = reinterpret_cast<struct sockaddr_in*>(result->ai_addr);
-            ip = inet_ntoa(addr->sin_addr);
-            freeaddrinfo(result);
-            return true;
-        }
-        freeaddrinfo(result);
+    Resolver::Result result = Resolver::shared().resolve(hostname);
+    if (!result.ok()) {
+        return false;
     }
-    return false;
+    ip = result.addresses.front().getIp();
+    return true;
+}
+
+bool TcpSocket::waitForReady(socket_t socket, bool forWrite, std::chrono::milliseconds timeout) {
+    if (socket == INVALID_SOCKET) {
+        return false;
+    }
+    
+    pollfd descriptor;
+    descriptor.fd = socket;
+    descriptor.events = forWrite ? POLLOUT : POLLIN;
+    descriptor.revents = 0;
+    
+    int timeoutMs = timeout.count() < 0 ? -1 : static_cast<int>(timeout.count());
+#ifdef _WIN32
+    int result = WSAPoll(&descriptor, 1, timeoutMs);
+#else
+    int result;
+    do {
+        result = ::poll(&descriptor, 1, timeoutMs);
+    } while (result == -1 && errno == EINTR);
+#endif
+    
+    return result > 0;
 }
 
 // TcpConnection implementation
 TcpConnection::TcpConnection(socket_t socket, const std::string& remoteAddress, uint16_t remotePort)
-    : socket_(socket), remoteAddress_(remoteAddress), remotePort_(remotePort),
+    : TcpConnection(socket, remoteAddress, remotePort, nullptr) {
+    startReceiveThread();
+}
+
+TcpConnection::TcpConnection(socket_t socket, const std::string& remoteAddress, uint16_t remotePort, EventLoop* loop)
+    : id_(nextConnectionId.fetch_add(1, std::memory_order_relaxed)),
+      socket_(socket), remoteAddress_(remoteAddress), remotePort_(remotePort),
       localPort_(0), state_(ConnectionState::Connected), bytesSent_(0), bytesReceived_(0),
-      sslEnabled_(false), sslContext_(nullptr), sslHandle_(nullptr), shouldStop_(false) {
+      sslEnabled_(false), sslContext_(nullptr), directWriters_(0), directCloseSocket_(INVALID_SOCKET),
+      shouldStop_(false), loop_(loop), sendMode_(SendMode::Direct), flushScheduled_(false), aboveHighWatermark_(false),
+      writeInterest_(false), completionIo_(false), sendInFlight_(false), lingerSocket_(INVALID_SOCKET),
+      lingerFlush_(false), lowWatermark_(kDefaultLowWatermark), highWatermark_(kDefaultHighWatermark),
+      idleTimeout_(0), handshakeTimeout_(0), lastActivity_(0), idleTimer_(0), handshakeTimer_(0),
+      sendPaused_(false), readPaused_(false), sendShapingTimer_(0), readShapingTimer_(0),
+      batchMaxReads_(0), batchMaxBytes_(0), batchReads_(0), batchBytes_(0), batchScheduled_(false),
+      quickAck_(false), asyncSendRunning_(false) {
     
     connectedAt_ = std::chrono::system_clock::now();
     initializeLocalAddress();
-    startReceiveThread();
+    
+    if (loop_) {
+        loopRef_ = loop_->weak_from_this().lock();
+        setSendMode(SendMode::Queued); // A direct write would stall every connection on the loop
+    }
+    
+    // The owner calls startReading() once callbacks are set
 }
 
 TcpConnection::~TcpConnection() {
+    if (loop_) {
+        releaseLoopSocket();
+        return;
+    }
     close();
+    
+    // Last reference dropped on the receive thread itself
+    if (receiveThread_.joinable()) {
+        receiveThread_.detach();
+    }
 }
 
 void TcpConnection::close() {
-    std::shared_ptr<TcpConnection> self;
-    bool callDisconnectedCallback = false;
+    if (loop_) {
+        if (loop_->isInLoopThread()) {
+            handleClose();
+            return;
+        }
+        
+        // Mark as closing now, finish on the loop thread which owns the socket
+        if (state_ == ConnectionState::Connected) {
+            setState(ConnectionState::Disconnecting);
+        }
+        shouldStop_ = true;
+        
+        std::shared_ptr<TcpConnection> self = weak_from_this().lock();
+        if (!self) {
+            releaseLoopSocket();
+            return;
+        }
+        loop_->post([self]() {
+            self->handleClose();
+        });
+        return;
+    }
     
     {
         std::lock_guard<std::mutex> lock(mutex_);
         
-        if (state_ != ConnectionState::Disconnected) {
+        if (!shouldStop_ && socket_ != INVALID_SOCKET) {
             setState(ConnectionState::Disconnecting);
-            shouldStop_ = true;
             
-            // Close the socket first to interrupt any blocking recv calls
-            if (socket_ != INVALID_SOCKET) {
+            // Wake the receive thread out of poll(); the descriptor is only
+            // closed once the thread is done with it
 #ifdef _WIN32
-                closesocket(socket_);
+            ::shutdown(socket_, SD_BOTH);
 #else
-                ::close(socket_);
+            ::shutdown(socket_, SHUT_RDWR);
 #endif
-                socket_ = INVALID_SOCKET;
-            }
         }
+        shouldStop_ = true;
     }
     
-    // Wait for receive thread to finish without holding the mutex
-    if (receiveThread_.joinable()) {
+    // Wait for receive thread to finish without holding the mutex. When
+    // close() is called from a receive callback the thread exits on its own.
+    if (receiveThread_.joinable() && receiveThread_.get_id() != std::this_thread::get_id()) {
         receiveThread_.join();
     }
     
-    {
-        std::lock_guard<std::mutex> lock(mutex_);
-        if (state_ != ConnectionState::Disconnected) {
-            setState(ConnectionState::Disconnected);
-            
-            // Only call callback if we can safely get shared_from_this
-            if (onDisconnected_) {
-                try {
-                    self = shared_from_this();
-                    callDisconnectedCallback = true;
-                } catch (const std::bad_weak_ptr&) {
-                    // Object is being destroyed, skip callback
-                }
-            }
-        }
-    }
-    
-    // Call disconnected callback outside the mutex if safe
-    if (callDisconnectedCallback && self) {
-        onDisconnected_(self);
-    }
+    handleClose();
 }
 
 bool TcpConnection::isConnected() const {
@@ -403,6 +677,7 @@ ConnectionState TcpConnection::getState() const {
 
 ConnectionInfo TcpConnection::getInfo() const {
     ConnectionInfo info;
+    info.id = id_;
     info.remoteAddress = remoteAddress_;
     info.remotePort = remotePort_;
     info.localAddress = localAddress_;
@@ -422,168 +697,1399 @@ bool TcpConnection::send(const std::string& data) {
     return send(data.data(), data.size());
 }
 
+bool TcpConnection::send(const BufferView& data) {
+    if (sendMode_ == SendMode::Queued) {
+        return isConnected() && onEnqueued(outbound_->push(data));
+    }
+    return send(data.data(), data.size());
+}
+
 bool TcpConnection::send(const void* data, size_t length) {
-    std::lock_guard<std::mutex> lock(mutex_);
+    if (sendMode_ == SendMode::Queued) {
+        return isConnected() && onEnqueued(outbound_->push(data, length));
+    }
+    return sendDirect(data, length, 1);
+}
+
+bool TcpConnection::sendBatch(const ByteView* messages, size_t count, MessageFramer& framer) {
+    if (count == 0) {
+        return isConnected();
+    }
     
-    if (!isConnected() || socket_ == INVALID_SOCKET) {
-        return false;
+    std::vector<uint8_t> batch;
+    framer.frameBatch(messages, count, batch);
+    if (sendMode_ == SendMode::Queued) {
+        return isConnected() && onEnqueued(outbound_->push(std::move(batch)), count);
+    }
+    return sendDirect(batch.data(), batch.size(), count);
+}
+
+bool TcpConnection::sendBatch(const std::vector<ByteView>& messages, MessageFramer& framer) {
+    return sendBatch(messages.data(), messages.size(), framer);
+}
+
+bool TcpConnection::sendDirect(const void* data, size_t length, size_t messages) {
+    // Queued data (from sendAsync()) goes first; this write lines up behind it
+    if (outbound_ && !outbound_->empty()) {
+        return queueBehindFlush(data, length, messages);
+    }
+    
+    // Shaping waits here, before the lock. The loop thread never sleeps:
+    // it hands the data to the flush, which charges and pauses instead.
+    if (sendLimiter_) {
+        if (loop_ && loop_->isInLoopThread()) {
+            return outbound_ ? queueBehindFlush(data, length, messages) : failSend(ErrorCode::WouldBlock);
+        }
+        sendLimiter_->waitForBytes(length);
+    }
+    
+    // Writers serialize on their own mutex so a slow peer never blocks the
+    // reader, and never hold mutex_ so a close does not wait on them either
+    ErrorCode error = ErrorCode::Success;
+    bool queued = false;
+    {
+        std::lock_guard<std::mutex> lock(sendMutex_);
+        
+        // Checked again: a flush may have queued data since
+        queued = outbound_ && !outbound_->empty();
+        if (!queued) {
+            socket_t socket = beginDirectWrite();
+            if (socket == INVALID_SOCKET) {
+                return false;
+            }
+            error = writeDirect(socket, data, length);
+            endDirectWrite();
+        }
+    }
+    
+    // Backpressure callbacks may send, so this waits until the lock is released
+    if (queued) {
+        return queueBehindFlush(data, length, messages);
+    }
+    
+    // A flush that found the socket busy left its data to us
+    if (outbound_ && !outbound_->empty()) {
+        scheduleFlush();
+    }
+    
+    // Report outside the lock; error callbacks may close the connection
+    if (error != ErrorCode::Success) {
+        return failSend(error);
+    }
+    if (metrics_) {
+        metrics_->messagesSent.add(static_cast<int64_t>(messages));
+    }
+    return true;
+}
+
+ErrorCode TcpConnection::writeDirect(socket_t socket, const void* data, size_t length) {
+    // sendMutex_ held
+    if (tls_) {
+        return sendTls(socket, static_cast<const uint8_t*>(data), length);
     }
     
     size_t totalSent = 0;
     const char* buffer = static_cast<const char*>(data);
+    std::chrono::milliseconds timeout = directSendTimeout();
     
     while (totalSent < length) {
-        int sent = ::send(socket_, buffer + totalSent, length - totalSent, 0);
+        int sent = ::send(socket, buffer + totalSent, length - totalSent, kSendFlags);
+        countSyscall(true);
         if (sent == SOCKET_ERROR) {
-#ifdef _WIN32
-            int error = WSAGetLastError();
-            if (error == WSAEWOULDBLOCK) {
-                continue;
+            if (!isWouldBlock()) {
+                return ErrorCode::SendFailed;
             }
-#else
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                continue;
+            if (timeout.count() == 0) {
+                return ErrorCode::WouldBlock;
             }
-#endif
-            handleError(ErrorCode::SendFailed, "Send failed");
-            return false;
+            // Non-blocking socket with a full send buffer: wait for room
+            // instead of spinning on the syscall
+            if (!TcpSocket::waitForReady(socket, true, timeout)) {
+                return ErrorCode::Timeout;
+            }
+            continue;
         }
         
         totalSent += sent;
-        bytesSent_ += sent;
+        addBytesSent(sent);
     }
-    
-    return true;
+    return ErrorCode::Success;
 }
 
-std::vector<uint8_t> TcpConnection::receive(size_t maxLength) {
-    std::vector<uint8_t> buffer(maxLength);
-    int received = receiveRaw(buffer.data(), maxLength);
-    if (received > 0) {
-        buffer.resize(received);
-        return buffer;
+bool TcpConnection::queueBehindFlush(const void* data, size_t length, size_t messages) {
+    // Shaped by the flush, which charges the limiter for what it writes
+    return isConnected() && onEnqueued(outbound_->push(data, length), messages);
+}
+
+bool TcpConnection::failSend(ErrorCode error) {
+    if (error == ErrorCode::Timeout) {
+        handleError(error, "Send timed out");
+    } else if (error == ErrorCode::WouldBlock) {
+        handleError(error, "Send buffer full on the event-loop thread");
+    } else if (error == ErrorCode::SslError) {
+        handleError(error, "TLS send failed: " + tls_->getLastError());
+    } else {
+        handleError(error, "Send failed");
     }
-    return {};
+    return false;
 }
 
-std::string TcpConnection::receiveString(size_t maxLength) {
-    std::vector<uint8_t> data = receive(maxLength);
-    return std::string(data.begin(), data.end());
+bool TcpConnection::sendFile(const std::string& path, uint64_t offset, uint64_t length, FileTransferCallback callback) {
+    std::string error;
+    std::shared_ptr<FileTransfer> file = FileTransfer::open(path, offset, length, std::move(callback), error);
+    return file && sendFileInternal(std::move(file));
 }
 
-int TcpConnection::receiveRaw(void* buffer, size_t length) {
-    std::lock_guard<std::mutex> lock(mutex_);
+bool TcpConnection::sendFile(int fd, uint64_t offset, uint64_t length, FileTransferCallback callback) {
+    std::string error;
+    std::shared_ptr<FileTransfer> file = FileTransfer::fromDescriptor(fd, offset, length, std::move(callback), error);
+    return file && sendFileInternal(std::move(file));
+}
+
+bool TcpConnection::sendFileInternal(std::shared_ptr<FileTransfer> file) {
+    if (!isConnected()) {
+        return false;
+    }
     
-    if (!isConnected() || socket_ == INVALID_SOCKET) {
-        return -1;
+    if (file->isComplete()) {
+        file->notify(); // Empty range
+        return true;
     }
     
-    int received = ::recv(socket_, static_cast<char*>(buffer), length, 0);
-    if (received == SOCKET_ERROR) {
-#ifdef _WIN32
-        int error = WSAGetLastError();
-        if (error == WSAEWOULDBLOCK) {
-            return 0;
-        }
-        // Don't report connection reset as an error if we're already stopping
-        if (shouldStop_ && error == WSAECONNRESET) {
-            return -1;
+    if (sendMode_ == SendMode::Queued) {
+        return onEnqueued(outbound_->push(file));
+    }
+    
+    // Shaped files go through the flush on the loop thread, like sendDirect()
+    if (sendLimiter_ && loop_ && loop_->isInLoopThread()) {
+        if (outbound_) {
+            return onEnqueued(outbound_->push(file));
         }
-#else
-        if (errno == EAGAIN || errno == EWOULDBLOCK) {
-            return 0;
+        file->fail(ErrorCode::WouldBlock);
+        file->notify();
+        return failSend(ErrorCode::WouldBlock);
+    }
+    
+    // With a limiter each write is paid for after the lock is released, so
+    // other writers never queue behind the wait
+    ErrorCode error = ErrorCode::Success;
+    while (!file->isComplete()) {
+        size_t written = 0;
+        {
+            std::lock_guard<std::mutex> lock(sendMutex_);
+            socket_t socket = beginDirectWrite();
+            if (socket == INVALID_SOCKET) {
+                return false;
+            }
+            error = sendFileDirect(socket, *file, written);
+            endDirectWrite();
         }
-        // Don't report connection reset as an error if we're already stopping
-        if (shouldStop_ && errno == ECONNRESET) {
-            return -1;
+        if (error != ErrorCode::Success || !sendLimiter_) {
+            break;
         }
-#endif
-        handleError(ErrorCode::ReceiveFailed, "Receive failed");
-        return -1;
+        sendLimiter_->waitForBytes(written);
     }
-    
-    if (received == 0) {
-        // Connection closed by peer
-        setState(ConnectionState::Disconnected);
-        return -1;
+    if (outbound_ && !outbound_->empty()) {
+        scheduleFlush();
     }
     
-    bytesReceived_ += received;
-    return received;
+    if (error != ErrorCode::Success) {
+        file->fail(error);
+        file->notify();
+        return failSend(error);
+    }
+    if (metrics_) {
+        metrics_->messagesSent.add();
+    }
+    file->notify();
+    return true;
 }
 
-void TcpConnection::sendAsync(const std::vector<uint8_t>& data, std::function<void(bool)> callback) {
-    // Make a copy of the data and capture shared_ptr to keep connection alive
-    auto self = shared_from_this();
-    std::thread([self, data, callback]() {
-        bool success = self->send(data);
-        if (callback) {
-            callback(success);
-        }
-    }).detach();
+ErrorCode TcpConnection::sendFileDirect(socket_t socket, FileTransfer& file, size_t& written) {
+    // sendMutex_ held. Without kernel TLS the record layer is in user
+    // space, so the file is copied through a pooled block. With a limiter
+    // this returns after one write, for the caller to pay for it.
+    bool copy = tls_ && !tls_->isKernelTlsSend();
+    Buffer block = copy ? BufferPool::shared().acquire() : Buffer();
+    
+    while (!file.isComplete()) {
+        if (copy) {
+            long length = file.read(block.data(), block.capacity());
+            if (length < 0) {
+                return ErrorCode::SendFailed;
+            }
+            ErrorCode error = sendTls(socket, block.data(), static_cast<size_t>(length));
+            if (error != ErrorCode::Success) {
+                return error;
+            }
+            file.advance(static_cast<uint64_t>(length));
+            written += static_cast<size_t>(length);
+            if (sendLimiter_) {
+                break;
+            }
+            continue;
+        }
+        
+        long sent = file.transmit(socket, static_cast<size_t>(file.getRemaining()));
+        countSyscall(true);
+        if (sent < 0) {
+            return ErrorCode::SendFailed;
+        }
+        if (sent == 0) {
+            std::chrono::milliseconds timeout = directSendTimeout();
+            if (timeout.count() == 0) {
+                return ErrorCode::WouldBlock;
+            }
+            if (!TcpSocket::waitForReady(socket, true, timeout)) {
+                return ErrorCode::Timeout;
+            }
+            continue;
+        }
+        file.advance(static_cast<uint64_t>(sent));
+        addBytesSent(sent);
+        written += static_cast<size_t>(sent);
+        if (sendLimiter_) {
+            // Charged after each write, which takes what the socket buffer holds
+            break;
+        }
+    }
+    
+    return ErrorCode::Success;
 }
 
-void TcpConnection::sendAsync(const std::string& data, std::function<void(bool)> callback) {
-    // Make a copy of the data and capture shared_ptr to keep connection alive
-    auto self = shared_from_this();
-    std::thread([self, data, callback]() {
-        bool success = self->send(data);
+ErrorCode TcpConnection::sendTls(socket_t socket, const uint8_t* data, size_t length) {
+    // sendMutex_ held; the session serializes against the reader itself
+    std::chrono::milliseconds timeout = directSendTimeout();
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    size_t totalSent = 0;
+    
+    while (totalSent < length) {
+        size_t written = 0;
+        TlsSession::Status status = tls_->write(data + totalSent, length - totalSent, written);
+        countSyscall(true);
+        totalSent += written;
+        addBytesSent(written);
+        
+        if (status == TlsSession::Status::Ok) {
+            continue;
+        }
+        if (status == TlsSession::Status::Closed) {
+            return ErrorCode::ConnectionClosed;
+        }
+        if (status == TlsSession::Status::Failed) {
+            return ErrorCode::SslError;
+        }
+        
+        if (timeout.count() == 0) {
+            return ErrorCode::WouldBlock;
+        }
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (remaining.count() <= 0) {
+            return ErrorCode::Timeout;
+        }
+        bool forWrite = status == TlsSession::Status::WantWrite;
+        TcpSocket::waitForReady(socket, forWrite, forWrite ? remaining : std::min(remaining, kTlsRetrySlice));
+    }
+    
+    return ErrorCode::Success;
+}
+
+socket_t TcpConnection::beginDirectWrite() {
+    // sendMutex_ held
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!isConnected() || socket_ == INVALID_SOCKET) {
+        return INVALID_SOCKET;
+    }
+    directWriters_++;
+    return socket_;
+}
+
+void TcpConnection::endDirectWrite() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--directWriters_ == 0 && directCloseSocket_ != INVALID_SOCKET) {
+        closeSocketHandle(directCloseSocket_);
+        directCloseSocket_ = INVALID_SOCKET;
+    }
+}
+
+std::chrono::milliseconds TcpConnection::directSendTimeout() const {
+    // Waiting on the loop thread would stall every connection it serves
+    bool onLoop = loop_ && loop_->isInLoopThread();
+    return std::chrono::milliseconds(onLoop ? 0 : 5000);
+}
+
+bool TcpConnection::setSendMode(SendMode mode) {
+    if (mode == SendMode::Queued) {
+        if (!loop_) {
+            return false;
+        }
+        if (!outbound_) {
+            outbound_.reset(new OutboundQueue());
+            outbound_->setMetrics(metrics_.get());
+        }
+    }
+    sendMode_ = mode;
+    return true;
+}
+
+void TcpConnection::setWriteWatermarks(size_t lowWatermark, size_t highWatermark) {
+    lowWatermark_ = lowWatermark;
+    highWatermark_ = std::max(lowWatermark, highWatermark);
+}
+
+void TcpConnection::setReceiveBatching(std::unique_ptr<MessageFramer> framer, size_t maxReads, size_t maxBytes) {
+    batchFramer_ = std::move(framer);
+    batchMaxReads_ = std::max<size_t>(maxReads, 1);
+    batchMaxBytes_ = std::max<size_t>(maxBytes, 1);
+}
+
+size_t TcpConnection::getPendingSendBytes() const {
+    return outbound_ ? outbound_->getQueuedBytes() : 0;
+}
+
+bool TcpConnection::enqueueSend(std::vector<uint8_t> data) {
+    return isConnected() && onEnqueued(outbound_->push(std::move(data)));
+}
+
+bool TcpConnection::onEnqueued(size_t queued, size_t messages) {
+    if (metrics_) {
+        metrics_->messagesSent.add(static_cast<int64_t>(messages));
+    }
+    if (queued >= highWatermark_ && !aboveHighWatermark_.exchange(true)) {
+        notifyBackpressure(true);
+    }
+    
+    scheduleFlush();
+    return true;
+}
+
+void TcpConnection::scheduleFlush() {
+    // One flush task at a time; everything queued before it runs is coalesced
+    if (flushScheduled_.exchange(true)) {
+        return;
+    }
+    
+    std::shared_ptr<TcpConnection> self = weak_from_this().lock();
+    if (!self) {
+        flushScheduled_ = false;
+        return;
+    }
+    loop_->post([self]() {
+        self->flushOutbound();
+    });
+}
+
+void TcpConnection::flushOutbound() {
+    // Runs on the loop thread, the queue's only consumer
+    flushScheduled_ = false;
+    if (socket_ == INVALID_SOCKET) {
+        return;
+    }
+    
+    // Held until the handshake completes, which flushes again
+    if (tls_ && !tls_->isEstablished()) {
+        return;
+    }
+    
+    // Over the send rate; the shaping timer flushes again
+    if (sendPaused_) {
+        return;
+    }
+    
+    // A direct writer owns the socket and flushes again once done. Released
+    // before any callback, which may send directly.
+    std::unique_lock<std::mutex> sendLock(sendMutex_, std::try_to_lock);
+    if (!sendLock.owns_lock()) {
+        return;
+    }
+    
+    // A chain in flight flushes again when it reports
+    if (sendInFlight_ || (completionIo_ && sendChained())) {
+        return;
+    }
+    
+    size_t written = 0;
+    OutboundQueue::FlushResult result = flushQueue(*outbound_, socket_, tls_.get(), written);
+    sendLock.unlock();
+    addBytesSent(written);
+    
+    if (result == OutboundQueue::FlushResult::Failed) {
+        handleError(ErrorCode::SendFailed, "Send failed");
+        handleClose();
+        return;
+    }
+    
+    // Charged after the fact: a flush writes at most what the socket takes,
+    // then the connection holds off until the bucket has paid for it
+    if (sendLimiter_ && written > 0) {
+        pauseSending(sendLimiter_->reserve(written));
+    }
+    
+    // Only watch for writability while data is stuck in the queue. A TLS
+    // write waiting on the peer resumes from the next readable event instead.
+    bool wantWrite = !sendPaused_ && result == OutboundQueue::FlushResult::Pending &&
+                     (!tls_ || tls_->isKernelTlsSend() || tls_->wantsWrite());
+    setWriteInterest(wantWrite);
+    
+    if (aboveHighWatermark_ && outbound_->getQueuedBytes() <= lowWatermark_ && aboveHighWatermark_.exchange(false)) {
+        notifyBackpressure(false);
+    }
+    
+    // Last: progress callbacks may send or close
+    std::vector<std::shared_ptr<FileTransfer>> files;
+    outbound_->takeFileProgress(files);
+    notifyFileProgress(files);
+}
+
+bool TcpConnection::sendChained() {
+    // Files at the head still go out with sendfile() from flushOutbound()
+    ByteView buffers[kMaxSendLinks];
+    size_t count = outbound_->gather(buffers, kMaxSendLinks);
+    if (count == 0) {
+        return false;
+    }
+    
+    std::shared_ptr<TcpConnection> self = shared_from_this();
+    if (!loop_->sendChain(socket_, buffers, count, [self](size_t written, ErrorCode error) {
+            self->handleSent(written, error);
+        })) {
+        return false;
+    }
+    sendInFlight_ = true;
+    return true;
+}
+
+void TcpConnection::handleSent(size_t bytesWritten, ErrorCode error) {
+    sendInFlight_ = false;
+    outbound_->complete(bytesWritten);
+    addBytesSent(bytesWritten);
+    
+    // Closed while the chain was in flight: finish what handleClose() deferred
+    if (lingerSocket_ != INVALID_SOCKET) {
+        if (lingerFlush_) {
+            size_t written = 0;
+            flushQueue(*outbound_, lingerSocket_, nullptr, written);
+            addBytesSent(written);
+        }
+        std::vector<std::shared_ptr<FileTransfer>> files;
+        outbound_->clear();
+        outbound_->takeFileProgress(files);
+        closeSocketHandle(lingerSocket_);
+        lingerSocket_ = INVALID_SOCKET;
+        notifyFileProgress(files);
+        return;
+    }
+    
+    if (socket_ == INVALID_SOCKET) {
+        return;
+    }
+    if (error != ErrorCode::Success) {
+        handleError(ErrorCode::SendFailed, "Send failed");
+        handleClose();
+        return;
+    }
+    
+    if (sendLimiter_ && bytesWritten > 0) {
+        pauseSending(sendLimiter_->reserve(bytesWritten));
+    }
+    if (aboveHighWatermark_ && outbound_->getQueuedBytes() <= lowWatermark_ && aboveHighWatermark_.exchange(false)) {
+        notifyBackpressure(false);
+    }
+    if (!outbound_->empty()) {
+        flushOutbound();
+    }
+}
+
+void TcpConnection::notifyFileProgress(std::vector<std::shared_ptr<FileTransfer>>& files) {
+    for (auto& file : files) {
+        file->notify();
+    }
+}
+
+void TcpConnection::setWriteInterest(bool enable) {
+    // Loop thread only
+    if (enable != writeInterest_ && socket_ != INVALID_SOCKET) {
+        writeInterest_ = enable;
+        loop_->modify(socket_, getInterest());
+    }
+}
+
+uint32_t TcpConnection::getInterest() const {
+    // Hangups and errors are reported even while reading is paused. A
+    // multishot receive needs no readable events.
+    return (readPaused_ || completionIo_ ? 0 : EventLoop::Readable) | (writeInterest_ ? EventLoop::Writable : 0);
+}
+
+void TcpConnection::pauseSending(std::chrono::nanoseconds delay) {
+    if (delay.count() <= 0) {
+        return;
+    }
+    sendPaused_ = true;
+    std::weak_ptr<TcpConnection> weak = weak_from_this();
+    sendShapingTimer_ = loop_->runAfter(std::chrono::ceil<std::chrono::milliseconds>(delay), [weak]() {
+        if (auto connection = weak.lock()) {
+            connection->sendShapingTimer_ = 0;
+            connection->sendPaused_ = false;
+            if (connection->outbound_ && !connection->outbound_->empty()) {
+                connection->flushOutbound();
+            }
+        }
+    });
+}
+
+void TcpConnection::pauseReading(std::chrono::nanoseconds delay) {
+    // A hangup can still get us here while paused; the armed timer resumes
+    if (readPaused_) {
+        return;
+    }
+    readPaused_ = true;
+    loop_->modify(socket_, getInterest());
+    std::weak_ptr<TcpConnection> weak = weak_from_this();
+    readShapingTimer_ = loop_->runAfter(std::chrono::ceil<std::chrono::milliseconds>(delay), [weak]() {
+        if (auto connection = weak.lock()) {
+            connection->resumeReading();
+        }
+    });
+}
+
+void TcpConnection::resumeReading() {
+    readShapingTimer_ = 0;
+    readPaused_ = false;
+    if (socket_ == INVALID_SOCKET) {
+        return;
+    }
+    loop_->modify(socket_, getInterest());
+    
+    // Level-triggered, but the kernel may have buffered data all along
+    handleReadable();
+}
+
+void TcpConnection::notifyBackpressure(bool aboveHighWatermark) {
+    if (onBackpressure_) {
+        std::shared_ptr<TcpConnection> self = weak_from_this().lock();
+        if (self) {
+            onBackpressure_(self, aboveHighWatermark);
+        }
+    }
+}
+
+std::vector<uint8_t> TcpConnection::receive(size_t maxLength) {
+    std::vector<uint8_t> buffer(maxLength);
+    int received = receiveRaw(buffer.data(), maxLength);
+    if (received > 0) {
+        buffer.resize(received);
+        return buffer;
+    }
+    return {};
+}
+
+std::string TcpConnection::receiveString(size_t maxLength) {
+    std::vector<uint8_t> data = receive(maxLength);
+    return std::string(data.begin(), data.end());
+}
+
+int TcpConnection::receiveRaw(void* buffer, size_t length) {
+    return receiveInternal(buffer, length, 0);
+}
+
+int TcpConnection::receiveInternal(void* buffer, size_t length, int flags) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    
+    if (!isConnected() || socket_ == INVALID_SOCKET) {
+        return -1;
+    }
+    
+    countSyscall(false);
+    if (tls_) {
+        int received = receiveTls(buffer, length);
+        if (received > 0) {
+            addBytesReceived(received);
+        }
+        return received;
+    }
+    
+    int received = ::recv(socket_, static_cast<char*>(buffer), length, flags);
+    if (received == SOCKET_ERROR) {
+#ifdef _WIN32
+        int error = WSAGetLastError();
+        if (error == WSAEWOULDBLOCK) {
+            return 0;
+        }
+        // Don't report connection reset as an error if we're already stopping
+        if (shouldStop_ && error == WSAECONNRESET) {
+            return -1;
+        }
+#else
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 0;
+        }
+        // Don't report connection reset as an error if we're already stopping
+        if (shouldStop_ && errno == ECONNRESET) {
+            return -1;
+        }
+#endif
+        handleError(ErrorCode::ReceiveFailed, "Receive failed");
+        return -1;
+    }
+    
+    if (received == 0) {
+        // Connection closed by peer
+        setState(ConnectionState::Disconnected);
+        return -1;
+    }
+    
+    addBytesReceived(received);
+    return received;
+}
+
+void TcpConnection::sendAsync(std::vector<uint8_t> data, std::function<void(bool)> callback) {
+    // Never a blocking send on the Executor: later direct sends queue behind this
+    if (outbound_) {
+        bool queued = enqueueSend(std::move(data));
         if (callback) {
-            callback(success);
+            callback(queued);
+        }
+        return;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(asyncSendMutex_);
+        asyncSends_.emplace(std::move(data), std::move(callback));
+        if (asyncSendRunning_) {
+            return;
+        }
+        asyncSendRunning_ = true;
+    }
+    
+    // Capture shared_ptr to keep connection alive until the sends have run
+    auto self = shared_from_this();
+    if (!Executor::shared().submit([self]() { self->runAsyncSends(); })) {
+        std::queue<std::pair<std::vector<uint8_t>, std::function<void(bool)>>> failed;
+        {
+            std::lock_guard<std::mutex> lock(asyncSendMutex_);
+            failed.swap(asyncSends_);
+            asyncSendRunning_ = false;
         }
-    }).detach();
+        for (; !failed.empty(); failed.pop()) {
+            if (failed.front().second) {
+                failed.front().second(false);
+            }
+        }
+    }
+}
+
+void TcpConnection::runAsyncSends() {
+    while (true) {
+        std::pair<std::vector<uint8_t>, std::function<void(bool)>> next;
+        {
+            std::lock_guard<std::mutex> lock(asyncSendMutex_);
+            if (asyncSends_.empty()) {
+                asyncSendRunning_ = false;
+                return;
+            }
+            next = std::move(asyncSends_.front());
+            asyncSends_.pop();
+        }
+        
+        bool success = send(next.first);
+        if (next.second) {
+            next.second(success);
+        }
+    }
+}
+
+void TcpConnection::sendAsync(std::string data, std::function<void(bool)> callback) {
+    sendAsync(std::vector<uint8_t>(data.begin(), data.end()), std::move(callback));
+}
+
+std::future<bool> TcpConnection::sendAsync(std::vector<uint8_t> data) {
+    auto promise = std::make_shared<std::promise<bool>>();
+    std::future<bool> result = promise->get_future();
+    sendAsync(std::move(data), [promise](bool success) {
+        promise->set_value(success);
+    });
+    return result;
+}
+
+std::future<bool> TcpConnection::sendAsync(std::string data) {
+    return sendAsync(std::vector<uint8_t>(data.begin(), data.end()));
 }
 
 void TcpConnection::receiveAsync(size_t maxLength, std::function<void(const std::vector<uint8_t>&)> callback) {
-    std::thread([this, maxLength, callback]() {
-        std::vector<uint8_t> data = receive(maxLength);
+    auto self = shared_from_this();
+    bool submitted = Executor::shared().submit([self, maxLength, callback]() {
+        std::vector<uint8_t> data = self->receive(maxLength);
         if (callback) {
             callback(data);
         }
-    }).detach();
+    });
+    
+    if (!submitted && callback) {
+        callback({});
+    }
+}
+
+std::future<std::vector<uint8_t>> TcpConnection::receiveAsync(size_t maxLength) {
+    auto promise = std::make_shared<std::promise<std::vector<uint8_t>>>();
+    std::future<std::vector<uint8_t>> result = promise->get_future();
+    receiveAsync(maxLength, [promise](const std::vector<uint8_t>& data) {
+        promise->set_value(data);
+    });
+    return result;
 }
 
 bool TcpConnection::enableSsl(std::shared_ptr<SslContext> context) {
-    // SSL implementation would go here
+    return attachTls(context, false, "", "");
+}
+
+bool TcpConnection::enableClientSsl(std::shared_ptr<SslContext> context, const std::string& serverName,
+                                    const std::string& peerKey) {
+    return attachTls(context, true, serverName, peerKey);
+}
+
+bool TcpConnection::attachTls(std::shared_ptr<SslContext> context, bool client, const std::string& serverName,
+                              const std::string& peerKey) {
+    if (!context || socket_ == INVALID_SOCKET || tls_) {
+        return false;
+    }
+    
+    std::unique_ptr<TlsSession> session(new TlsSession());
+    TlsSession::Role role = client ? TlsSession::Role::Client : TlsSession::Role::Server;
+    if (!session->create(context, socket_, role, serverName, peerKey)) {
+        handleError(ErrorCode::SslError, session->getLastError());
+        return false;
+    }
+    
+    // Every TLS call must return at once: the session lock is shared by the
+    // reader and writers, so none of them may block inside OpenSSL
+    setNonBlockingHandle(socket_);
+    
+    tls_ = std::move(session);
     sslContext_ = context;
     sslEnabled_ = true;
     return true;
 }
 
+int TcpConnection::receiveTls(void* buffer, size_t length) {
+    // > 0 bytes read, 0 would block, -1 closed (errors are reported here)
+    size_t received = 0;
+    switch (tls_->read(buffer, length, received)) {
+        case TlsSession::Status::Ok:
+            return static_cast<int>(received);
+        case TlsSession::Status::WantWrite:
+            if (loop_) {
+                setWriteInterest(true);
+            }
+            return 0;
+        case TlsSession::Status::WantRead:
+            return 0;
+        case TlsSession::Status::Closed:
+            setState(ConnectionState::Disconnected);
+            return -1;
+        default:
+            if (!shouldStop_) {
+                handleError(ErrorCode::SslError, "TLS receive failed: " + tls_->getLastError());
+            }
+            return -1;
+    }
+}
+
 void TcpConnection::startReceiveThread() {
     receiveThread_ = std::thread(&TcpConnection::receiveLoop, this);
 }
 
 void TcpConnection::receiveLoop() {
-    std::vector<uint8_t> buffer(4096);
+    Buffer buffer = BufferPool::shared().acquire();
+    
+    // Pins the connection while callbacks run. Released on return, so if this
+    // is the last reference the destructor runs after the loop is done.
+    std::shared_ptr<TcpConnection> self;
+    bool peerClosed = false;
     
-    while (!shouldStop_ && isConnected()) {
-        // Check if we should stop before attempting to receive
-        if (shouldStop_) {
+    while (!shouldStop_ && !peerClosed) {
+        // Block until readable (or writable for a stalled TLS write); close()
+        // shuts the socket down to wake us
+        if (!TcpSocket::waitForReady(socket_, tls_ && tls_->wantsWrite(), std::chrono::milliseconds(-1))) {
+            if (shouldStop_) {
+                break;
+            }
+            peerClosed = true;
             break;
         }
         
-        int received = receiveRaw(buffer.data(), buffer.size());
-        if (received > 0) {
-            std::vector<uint8_t> data(buffer.begin(), buffer.begin() + received);
+        if (!self) {
+            self = weak_from_this().lock();
+        }
+        auto readyAt = metrics_ ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+        
+        // Drain everything that is buffered before waiting again
+        do {
+            int received = receiveInternal(buffer.data(), buffer.capacity(), kRecvNoWait);
+            if (received == 0) {
+                break;
+            }
+            if (received < 0) {
+                peerClosed = true;
+                break;
+            }
+            
+            if (quickAck_) {
+                rearmQuickAck();
+            }
             
-            if (onDataReceived_) {
+            bool batchFull = false;
+            if (self) {
+                buffer.setSize(received);
                 try {
-                    onDataReceived_(shared_from_this(), data);
-                } catch (const std::exception& e) {
+                    deliverReceived(self, BufferView(buffer), readyAt);
+                } catch (const std::exception&) {
                     // Handle any exceptions in the callback gracefully
+                    peerClosed = true;
+                    break;
+                }
+                batchFull = batchFramer_ && collectMessages(BufferView(buffer));
+                
+                // The application kept the block; read into a fresh one
+                if (!buffer.unique()) {
+                    buffer = BufferPool::shared().acquire();
+                }
+            }
+            
+            if (receiveLimiter_) {
+                waitForReceiveBudget(received);
+            }
+            
+            if (batchFull) {
+                break; // Reported before reading on
+            }
+            if (!tls_ && static_cast<size_t>(received) < buffer.capacity()) {
+                // Short read: the socket is drained. TLS reads go on until the
+                // session would block, as records may be buffered inside OpenSSL.
+                break;
+            }
+        } while ((kRecvNoWait != 0 || tls_) && !shouldStop_);
+        
+        if (batchFramer_ && !deliverMessages(self)) {
+            peerClosed = true;
+        }
+    }
+    
+    if (peerClosed && !shouldStop_) {
+        handleClose();
+    }
+}
+
+void TcpConnection::waitForReceiveBudget(size_t received) {
+    // Dedicated receive thread: sleeping is all it could do anyway
+    auto until = std::chrono::steady_clock::now() + receiveLimiter_->reserve(received);
+    while (!shouldStop_) {
+        auto now = std::chrono::steady_clock::now();
+        if (now >= until) {
+            break;
+        }
+        std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(until - now, kShapingSleepSlice));
+    }
+}
+
+void TcpConnection::deliverReceived(const std::shared_ptr<TcpConnection>& self, const BufferView& data,
+                                    std::chrono::steady_clock::time_point readyAt) {
+    std::chrono::steady_clock::time_point started;
+    if (metrics_) {
+        started = std::chrono::steady_clock::now();
+        metrics_->messagesReceived.add();
+        metrics_->readToCallback.record(started - readyAt);
+    }
+    
+    if (onBufferReceived_) {
+        onBufferReceived_(self, data);
+    }
+    
+    // Vector callbacks get their own copy
+    if (onDataReceived_) {
+        onDataReceived_(self, data.toVector());
+    }
+    
+    if (metrics_) {
+        metrics_->callbackDuration.record(std::chrono::steady_clock::now() - started);
+    }
+}
+
+void TcpConnection::rearmQuickAck() {
+    // The kernel leaves quick-ack mode on its own, so every read asks again
+#ifdef TCP_QUICKACK
+    int optval = 1;
+    setsockopt(socket_, IPPROTO_TCP, TCP_QUICKACK, reinterpret_cast<const char*>(&optval), sizeof(optval));
+#endif
+}
+
+bool TcpConnection::collectMessages(const BufferView& data) {
+    batchFramer_->decodeFrames(data, [this](const BufferView& message) {
+        batch_.push_back(message);
+    });
+    batchReads_++;
+    batchBytes_ += data.size();
+    return batchReads_ >= batchMaxReads_ || batchBytes_ >= batchMaxBytes_;
+}
+
+bool TcpConnection::deliverMessages(const std::shared_ptr<TcpConnection>& self) {
+    // False if the callback threw; the caller closes
+    batchReads_ = 0;
+    batchBytes_ = 0;
+    if (batch_.empty()) {
+        return true;
+    }
+    
+    std::vector<BufferView> messages;
+    messages.swap(batch_);
+    bool ok = true;
+    if (onMessagesReceived_ && self) {
+        try {
+            onMessagesReceived_(self, messages);
+        } catch (const std::exception&) {
+            ok = false;
+        }
+    }
+    
+    // Keep the capacity for the next batch
+    messages.clear();
+    if (batch_.empty()) {
+        batch_.swap(messages);
+    }
+    return ok;
+}
+
+void TcpConnection::setMetrics(std::shared_ptr<ConnectionMetrics> metrics) {
+    metrics_ = std::move(metrics);
+    if (outbound_) {
+        outbound_->setMetrics(metrics_.get());
+    }
+}
+
+void TcpConnection::addBytesSent(size_t bytes) {
+    touch();
+    bytesSent_ += bytes;
+    if (metrics_) {
+        metrics_->bytesSent.add(static_cast<int64_t>(bytes));
+    }
+}
+
+void TcpConnection::addBytesReceived(size_t bytes) {
+    touch();
+    bytesReceived_ += bytes;
+    if (metrics_) {
+        metrics_->bytesReceived.add(static_cast<int64_t>(bytes));
+    }
+}
+
+void TcpConnection::countSyscall(bool write) {
+    if (metrics_) {
+        (write ? metrics_->sendCalls : metrics_->receiveCalls).add();
+    }
+}
+
+bool TcpConnection::startReading() {
+    if (socket_ == INVALID_SOCKET) {
+        return false;
+    }
+    
+    if (!loop_) {
+        if (!receiveThread_.joinable()) {
+            startReceiveThread();
+        }
+        return true;
+    }
+    
+    setNonBlockingHandle(socket_);
+    
+    // A TLS client speaks first, so it waits for writability instead
+    if (tls_ && tls_->getRole() == TlsSession::Role::Client && !tls_->isEstablished()) {
+        writeInterest_ = true;
+    }
+    
+    // Plain connections on a completion loop read from a multishot
+    // receive; TLS and receive shaping need readiness to read
+    completionIo_ = loop_->hasCompletionIo() && !tls_ && !receiveLimiter_;
+    
+    std::weak_ptr<TcpConnection> weak = weak_from_this();
+    bool added = loop_->add(socket_, getInterest(), [weak](uint32_t events) {
+        auto connection = weak.lock();
+        if (!connection) {
+            return;
+        }
+        
+        // With a multishot receive, hangups and errors arrive there too
+        if ((events & (EventLoop::Readable | EventLoop::Hangup | EventLoop::Error)) && !connection->completionIo_) {
+            connection->handleReadable();
+        }
+        
+        if (events & EventLoop::Writable) {
+            connection->handleWritable();
+        }
+    });
+    if (!added) {
+        return false;
+    }
+    
+    if (completionIo_ && !loop_->receiveMultishot(socket_, [weak](const BufferView& data, ErrorCode error) {
+            if (auto connection = weak.lock()) {
+                connection->handleReceived(data, error);
+            }
+        })) {
+        completionIo_ = false;
+        loop_->modify(socket_, getInterest());
+    }
+    
+    if (idleTimeout_.count() > 0) {
+        touch();
+        armIdleTimer(idleTimeout_);
+    }
+    if (tls_ && handshakeTimeout_.count() > 0) {
+        handshakeTimer_ = loop_->runAfter(handshakeTimeout_, [weak]() {
+            if (auto connection = weak.lock()) {
+                connection->checkHandshake();
+            }
+        });
+    }
+    return true;
+}
+
+void TcpConnection::armIdleTimer(std::chrono::milliseconds delay) {
+    std::weak_ptr<TcpConnection> weak = weak_from_this();
+    idleTimer_ = loop_->runAfter(delay, [weak]() {
+        if (auto connection = weak.lock()) {
+            connection->checkIdle();
+        }
+    });
+}
+
+void TcpConnection::checkIdle() {
+    // Loop thread, which is the only one to close the socket
+    if (socket_ == INVALID_SOCKET) {
+        return;
+    }
+    
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    auto idle = std::chrono::duration_cast<std::chrono::milliseconds>(
+        now - std::chrono::nanoseconds(lastActivity_.load(std::memory_order_relaxed)));
+    if (idle < idleTimeout_) {
+        armIdleTimer(idleTimeout_ - idle);
+        return;
+    }
+    
+    idleTimer_ = 0;
+    handleError(ErrorCode::Timeout, "Idle timeout");
+    handleClose();
+}
+
+void TcpConnection::checkHandshake() {
+    handshakeTimer_ = 0;
+    if (socket_ != INVALID_SOCKET && tls_ && !tls_->isEstablished()) {
+        handleError(ErrorCode::Timeout, "TLS handshake timed out");
+        handleClose();
+    }
+}
+
+void TcpConnection::touch() {
+    if (idleTimeout_.count() > 0) {
+        lastActivity_.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+    }
+}
+
+void TcpConnection::cancelTimers() {
+    for (std::atomic<TimerId>* timer : {&idleTimer_, &handshakeTimer_, &sendShapingTimer_, &readShapingTimer_}) {
+        TimerId id = timer->exchange(0);
+        if (id != 0) {
+            loop_->cancelTimer(id);
+        }
+    }
+}
+
+void TcpConnection::handleReadable() {
+    // Runs on the loop thread, which is the only reader of the socket. The
+    // block is shared by every connection on this loop until one retains it.
+    thread_local Buffer buffer;
+    auto self = shared_from_this();
+    
+    if (tls_ && !tls_->isEstablished() && !advanceHandshake()) {
+        return;
+    }
+    
+    size_t maxReads = batchFramer_ ? batchMaxReads_ : kMaxReadsPerEvent;
+    for (size_t i = 0; i < maxReads && !shouldStop_; i++) {
+        if (!buffer.unique()) {
+            buffer = loop_->getBufferPool().acquire();
+        }
+        
+        int received;
+        countSyscall(false);
+        if (tls_) {
+            received = receiveTls(buffer.data(), buffer.capacity());
+            if (received == 0) {
+                break;
+            }
+            if (received < 0) {
+                handleClose();
+                return;
+            }
+        } else {
+            received = ::recv(socket_, reinterpret_cast<char*>(buffer.data()), buffer.capacity(), 0);
+        }
+        
+        if (received > 0) {
+            addBytesReceived(received);
+            buffer.setSize(received);
+            if (quickAck_) {
+                rearmQuickAck();
+            }
+            
+            try {
+                deliverReceived(self, BufferView(buffer), loop_->getWakeTime());
+            } catch (const std::exception&) {
+                handleClose();
+                return;
+            }
+            bool batchFull = batchFramer_ && collectMessages(BufferView(buffer));
+            
+            // Over the receive rate: stop reading until the bucket catches up
+            if (receiveLimiter_) {
+                std::chrono::nanoseconds delay = receiveLimiter_->reserve(received);
+                if (delay.count() > 0) {
+                    pauseReading(delay);
                     break;
                 }
             }
-        } else if (received == -1) {
-            // Connection closed or error occurred
+            
+            if (batchFull) {
+                break; // Reported before reading on
+            }
+            if (!tls_ && static_cast<size_t>(received) < buffer.capacity()) {
+                // Short read: the socket is drained
+                break;
+            }
+            continue;
+        }
+        
+        if (received == SOCKET_ERROR && isWouldBlock()) {
+            break;
+        }
+        
+        if (received == SOCKET_ERROR) {
+            handleError(ErrorCode::ReceiveFailed, "Receive failed");
+        }
+        
+        // Peer closed the connection or the socket failed; what was read first is reported
+        if (batchFramer_) {
+            deliverMessages(self);
+        }
+        handleClose();
+        return;
+    }
+    
+    if (batchFramer_ && !deliverMessages(self)) {
+        handleClose();
+        return;
+    }
+    
+    if (shouldStop_ && socket_ != INVALID_SOCKET) {
+        handleClose();
+        return;
+    }
+    
+    if (tls_ && socket_ != INVALID_SOCKET) {
+        // Decrypted bytes left inside OpenSSL raise no readiness event;
+        // while paused, resuming reads them
+        if (!readPaused_ && tls_->hasPendingData()) {
+            loop_->post([self]() {
+                self->handleReadable();
+            });
+        }
+        
+        // Queued writes that stalled waiting for the peer can resume
+        if (outbound_ && !outbound_->empty() && !writeInterest_) {
+            flushOutbound();
+        }
+    }
+}
+
+void TcpConnection::handleReceived(const BufferView& data, ErrorCode error) {
+    // Loop thread: handleReadable() for a multishot receive, which already read
+    if (socket_ == INVALID_SOCKET) {
+        return;
+    }
+    
+    std::shared_ptr<TcpConnection> self = shared_from_this();
+    if (error != ErrorCode::Success) {
+        if (error == ErrorCode::ReceiveFailed) {
+            handleError(ErrorCode::ReceiveFailed, "Receive failed");
+        }
+        if (batchFramer_) {
+            deliverMessages(self);
+        }
+        handleClose();
+        return;
+    }
+    
+    addBytesReceived(data.size());
+    if (quickAck_) {
+        rearmQuickAck();
+    }
+    try {
+        deliverReceived(self, data, loop_->getWakeTime());
+    } catch (const std::exception&) {
+        handleClose();
+        return;
+    }
+    
+    // Receives reaped in one turn form a batch, reported after them
+    if (batchFramer_) {
+        if (collectMessages(data)) {
+            if (!deliverMessages(self)) {
+                handleClose();
+                return;
+            }
+        } else if (!batchScheduled_) {
+            batchScheduled_ = true;
+            loop_->post([self]() {
+                self->batchScheduled_ = false;
+                if (self->socket_ != INVALID_SOCKET && !self->deliverMessages(self)) {
+                    self->handleClose();
+                }
+            });
+        }
+    }
+    
+    if (shouldStop_ && socket_ != INVALID_SOCKET) {
+        handleClose();
+    }
+}
+
+void TcpConnection::handleWritable() {
+    if (tls_ && !tls_->isEstablished()) {
+        if (advanceHandshake()) {
+            handleReadable();
+        }
+        return;
+    }
+    
+    if (outbound_ && !outbound_->empty()) {
+        flushOutbound();
+    } else if (writeInterest_) {
+        // A TLS read was waiting to write; retry it
+        setWriteInterest(false);
+        if (tls_) {
+            handleReadable();
+        }
+    }
+}
+
+bool TcpConnection::advanceHandshake() {
+    // Loop thread only. Returns true once application data can flow.
+    switch (tls_->handshake()) {
+        case TlsSession::Status::Ok:
+            if (TimerId timer = handshakeTimer_.exchange(0)) {
+                loop_->cancelTimer(timer);
+            }
+            setWriteInterest(false);
+            if (outbound_ && !outbound_->empty()) {
+                flushOutbound();
+            }
+            return true;
+        case TlsSession::Status::WantRead:
+            setWriteInterest(false);
+            return false;
+        case TlsSession::Status::WantWrite:
+            setWriteInterest(true);
+            return false;
+        case TlsSession::Status::Failed:
+            handleError(ErrorCode::SslError, "TLS handshake failed: " + tls_->getLastError());
             break;
-        } else if (received == 0) {
-            // No data available, continue
+        default:
+            break;
+    }
+    
+    handleClose();
+    return false;
+}
+
+void TcpConnection::handleClose() {
+    std::vector<std::shared_ptr<FileTransfer>> files;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        
+        if (socket_ == INVALID_SOCKET) {
+            return;
+        }
+        
+        // Best-effort flush of queued data on an orderly close. A send chain
+        // in flight still owns the head of the queue, so that waits until
+        // the chain reports.
+        bool orderly = state_ != ConnectionState::Error && (!tls_ || tls_->isEstablished());
+        if (outbound_ && !sendInFlight_ && directWriters_ == 0) {
+            if (orderly) {
+                size_t written = 0;
+                flushQueue(*outbound_, socket_, tls_.get(), written);
+                addBytesSent(written);
+            }
+            outbound_->clear();
+            outbound_->takeFileProgress(files);
+        }
+        
+        if (tls_) {
+            tls_->shutdown(); // close_notify
         }
         
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        shouldStop_ = true;
+        setState(ConnectionState::Disconnecting);
+        if (loop_) {
+            loop_->remove(socket_); // Cancels the chain, which reports on the next turn
+            cancelTimers();
+        }
+        if (sendInFlight_) {
+            lingerSocket_ = socket_;
+            lingerFlush_ = orderly;
+        } else if (directWriters_ > 0) {
+            // Wakes a writer waiting for room; it closes the descriptor
+#ifdef _WIN32
+            ::shutdown(socket_, SD_BOTH);
+#else
+            ::shutdown(socket_, SHUT_RDWR);
+#endif
+            directCloseSocket_ = socket_;
+        } else {
+            closeSocketHandle(socket_);
+        }
+        socket_ = INVALID_SOCKET;
+        setState(ConnectionState::Disconnected);
     }
+    
+    // Files that never finished report ConnectionClosed
+    notifyFileProgress(files);
+    
+    if (onDisconnected_) {
+        try {
+            onDisconnected_(shared_from_this());
+        } catch (const std::bad_weak_ptr&) {
+            // Object is being destroyed, skip callback
+        }
+    }
+}
+
+void TcpConnection::releaseLoopSocket() {
+    // Destructor path: no handler can hold a reference any more
+    std::lock_guard<std::mutex> sendLock(sendMutex_);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (socket_ != INVALID_SOCKET) {
+        loop_->remove(socket_);
+        cancelTimers();
+        closeSocketHandle(socket_);
+        socket_ = INVALID_SOCKET;
+    }
+    // A loop discarding a chain in flight drops it without a report
+    if (lingerSocket_ != INVALID_SOCKET) {
+        closeSocketHandle(lingerSocket_);
+        lingerSocket_ = INVALID_SOCKET;
+    }
+    setState(ConnectionState::Disconnected);
 }
 
 void TcpConnection::setState(ConnectionState state) {
@@ -602,15 +2108,13 @@ bool TcpConnection::initializeLocalAddress() {
         return false;
     }
     
-    struct sockaddr_in addr;
-    socklen_t len = sizeof(addr);
-    if (getsockname(socket_, reinterpret_cast<struct sockaddr*>(&addr), &len) == 0) {
-        localAddress_ = inet_ntoa(addr.sin_addr);
-        localPort_ = ntohs(addr.sin_port);
-        return true;
+    SocketAddress local = SocketAddress::local(socket_);
+    if (!local.isValid()) {
+        return false;
     }
-    
-    return false;
+    localAddress_ = local.getIp();
+    localPort_ = local.getPort();
+    return true;
 }
 
 } // namespace tcp
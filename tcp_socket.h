@@ -10,6 +10,10 @@
 #include <thread>
 #include <chrono>
 #include <queue>
+#include <future>
+
+#include "tcp_buffer.h"
+#include "timer_wheel.h"
 
 #ifdef _WIN32
     #include <winsock2.h>
@@ -36,6 +40,13 @@ class TcpServer;
 class TcpClient;
 class TcpConnection;
 class SslContext;
+class EventLoop;
+class OutboundQueue;
+class TlsSession;
+class FileTransfer;
+class RateLimiter;
+class MessageFramer;
+struct ConnectionMetrics;
 
 // Error codes
 enum class ErrorCode {
@@ -74,10 +85,49 @@ struct SocketOptions {
     std::chrono::milliseconds sendTimeout{5000};
     std::chrono::milliseconds receiveTimeout{5000};
     std::chrono::milliseconds connectTimeout{10000};
+    
+    // Latency tuning, off by default (Linux; ignored where unsupported).
+    // Accepted sockets inherit what the listener has set.
+    bool quickAck = false;                  // TCP_QUICKACK, re-armed after every read
+    int notSentLowWatermark = 0;            // TCP_NOTSENT_LOWAT: unsent bytes before writes wait (0 = system default)
+    std::chrono::microseconds busyPoll{0};  // SO_BUSY_POLL: blocking reads spin on the device queue this long
+    bool zeroCopy = false;                  // SO_ZEROCOPY, so MSG_ZEROCOPY sends are allowed
+};
+
+// IPv4 or IPv6 address and port, as passed to bind() and connect()
+class SocketAddress {
+public:
+    SocketAddress();
+    SocketAddress(const struct sockaddr* address, socklen_t length);
+
+    // Numeric addresses only ("" is the IPv4 wildcard, "::" the IPv6 one)
+    static bool parse(const std::string& ip, uint16_t port, SocketAddress& address);
+    // Bound (local) or connected (peer) address of a socket; invalid on failure
+    static SocketAddress local(socket_t socket);
+    static SocketAddress peer(socket_t socket);
+
+    bool isValid() const { return length_ > 0; }
+    int getFamily() const { return storage_.ss_family; }
+    bool isIPv6() const { return storage_.ss_family == AF_INET6; }
+    std::string getIp() const; // IPv4-mapped IPv6 addresses print as IPv4
+    uint16_t getPort() const;
+    void setPort(uint16_t port);
+    std::string toString() const; // "1.2.3.4:80" or "[::1]:80"
+
+    const struct sockaddr* get() const { return reinterpret_cast<const struct sockaddr*>(&storage_); }
+    socklen_t getLength() const { return length_; }
+
+private:
+    struct sockaddr_storage storage_;
+    socklen_t length_;
 };
 
 // Connection info
+// Process-unique connection identifier
+using ConnectionId = uint64_t;
+
 struct ConnectionInfo {
+    ConnectionId id = 0;
     std::string remoteAddress;
     uint16_t remotePort;
     std::string localAddress;
@@ -93,6 +143,21 @@ using OnConnectedCallback = std::function<void(std::shared_ptr<TcpConnection>)>;
 using OnDisconnectedCallback = std::function<void(std::shared_ptr<TcpConnection>)>;
 using OnDataReceivedCallback = std::function<void(std::shared_ptr<TcpConnection>, const std::vector<uint8_t>&)>;
 using OnErrorCallback = std::function<void(std::shared_ptr<TcpConnection>, ErrorCode, const std::string&)>;
+// Zero-copy receive: the view points into a pooled block the callback may retain
+using OnBufferReceivedCallback = std::function<void(std::shared_ptr<TcpConnection>, const BufferView&)>;
+using OnBackpressureCallback = std::function<void(std::shared_ptr<TcpConnection>, bool aboveHighWatermark)>;
+// Every message decoded from one batch of reads; views may be retained
+using OnMessagesReceivedCallback = std::function<void(std::shared_ptr<TcpConnection>, const std::vector<BufferView>& messages)>;
+
+// sendFile() progress. The final call has done set; error is Success when
+// the whole range was sent.
+struct FileTransferProgress {
+    uint64_t bytesSent = 0;
+    uint64_t totalBytes = 0;
+    bool done = false;
+    ErrorCode error = ErrorCode::Success;
+};
+using FileTransferCallback = std::function<void(const FileTransferProgress&)>;
 
 // Base TCP socket class
 class TcpSocket {
@@ -109,12 +174,12 @@ public:
     TcpSocket& operator=(TcpSocket&& other) noexcept;
 
     // Socket management
-    bool create();
+    bool create(int family = AF_INET);
     void close();
     bool isValid() const;
     socket_t getHandle() const { return socket_; }
 
-    // Socket options
+    // Socket options. Without a socket yet they are kept for the next one.
     bool setSocketOptions(const SocketOptions& options);
     SocketOptions getSocketOptions() const;
 
@@ -125,7 +190,10 @@ public:
     // Address utilities
     static std::string getLocalAddress();
     static std::vector<std::string> getLocalAddresses();
-    static bool resolveAddress(const std::string& hostname, std::string& ip);
+    static bool resolveAddress(const std::string& hostname, std::string& ip); // First address, through the Resolver cache
+
+    // Readiness wait (poll-based, no FD_SETSIZE limit)
+    static bool waitForReady(socket_t socket, bool forWrite, std::chrono::milliseconds timeout);
 
 protected:
     socket_t socket_;
@@ -137,6 +205,9 @@ protected:
     bool setSocketOption(int level, int optname, const void* optval, socklen_t optlen);
     bool getSocketOption(int level, int optname, void* optval, socklen_t* optlen) const;
     bool setSocketOptionsInternal(const SocketOptions& options);
+    static bool applySocketOptions(socket_t socket, const SocketOptions& options);
+    // Takes ownership of an open socket (closing the current one) and applies the options
+    void adopt(socket_t socket, bool nonBlocking);
     ErrorCode getLastError() const;
     std::string errorToString(ErrorCode error) const;
 
@@ -153,7 +224,14 @@ private:
 // TCP Connection class
 class TcpConnection : public std::enable_shared_from_this<TcpConnection> {
 public:
+    // How send() hands data to the socket
+    enum class SendMode {
+        Direct, // Write on the calling thread, waiting for buffer space (never on the loop thread)
+        Queued  // Enqueue and return; the event-loop thread flushes (event loop only, the default there)
+    };
+
     TcpConnection(socket_t socket, const std::string& remoteAddress, uint16_t remotePort);
+    TcpConnection(socket_t socket, const std::string& remoteAddress, uint16_t remotePort, EventLoop* loop);
     ~TcpConnection();
 
     // Non-copyable, non-movable
@@ -167,31 +245,104 @@ public:
     bool isConnected() const;
     ConnectionState getState() const;
     ConnectionInfo getInfo() const;
+    ConnectionId getId() const { return id_; }
 
     // Data transmission
     bool send(const std::vector<uint8_t>& data);
     bool send(const std::string& data);
     bool send(const void* data, size_t length);
+    bool send(const BufferView& data); // Queued mode shares the block instead of copying
+    
+    // Frames the messages back to back and sends them as one write (one
+    // queue entry in queued mode), counting each as a message sent
+    bool sendBatch(const ByteView* messages, size_t count, MessageFramer& framer);
+    bool sendBatch(const std::vector<ByteView>& messages, MessageFramer& framer);
     
     std::vector<uint8_t> receive(size_t maxLength = 4096);
     std::string receiveString(size_t maxLength = 4096);
     int receiveRaw(void* buffer, size_t length);
 
-    // Async operations
-    void sendAsync(const std::vector<uint8_t>& data, std::function<void(bool)> callback = nullptr);
-    void sendAsync(const std::string& data, std::function<void(bool)> callback = nullptr);
+    // Async operations, run on the shared Executor. On an event-loop
+    // connection sendAsync() enqueues directly, in either send mode, and
+    // completes once the data is queued. Thread-per-connection sends run on
+    // the Executor one at a time, so a slow peer holds at most one worker.
+    void sendAsync(std::vector<uint8_t> data, std::function<void(bool)> callback);
+    void sendAsync(std::string data, std::function<void(bool)> callback);
+    std::future<bool> sendAsync(std::vector<uint8_t> data);
+    std::future<bool> sendAsync(std::string data);
     void receiveAsync(size_t maxLength, std::function<void(const std::vector<uint8_t>&)> callback);
+    std::future<std::vector<uint8_t>> receiveAsync(size_t maxLength);
+
+    // File transmission without a user-space copy (sendfile/TransmitFile;
+    // TLS without kernel offload copies through a pooled buffer). A length
+    // of 0 sends to the end of the file. In queued mode the file keeps its
+    // place among queued sends and progress is reported from the loop
+    // thread; direct mode blocks and reports once, when done. Returns false
+    // without calling back if the file can't be opened.
+    bool sendFile(const std::string& path, uint64_t offset = 0, uint64_t length = 0, FileTransferCallback callback = nullptr);
+    bool sendFile(int fd, uint64_t offset, uint64_t length, FileTransferCallback callback = nullptr);
+
+    // Send mode and write backpressure. The callback fires with true once
+    // queued bytes reach the high watermark and with false once they drain
+    // to the low watermark.
+    bool setSendMode(SendMode mode); // Queued requires an event loop
+    SendMode getSendMode() const { return sendMode_; }
+    void setWriteWatermarks(size_t lowWatermark, size_t highWatermark);
+    size_t getPendingSendBytes() const;
+    bool isAboveHighWatermark() const { return aboveHighWatermark_; }
+    
+    // TCP_QUICKACK on every read, so acks never wait for a delayed-ack
+    // timer (set before reading starts; the server copies its
+    // SocketOptions::quickAck)
+    void setQuickAck(bool enable) { quickAck_ = enable; }
 
     // Callbacks
     void setOnDataReceived(OnDataReceivedCallback callback) { onDataReceived_ = callback; }
+    void setOnBufferReceived(OnBufferReceivedCallback callback) { onBufferReceived_ = callback; }
     void setOnDisconnected(OnDisconnectedCallback callback) { onDisconnected_ = callback; }
     void setOnError(OnErrorCallback callback) { onError_ = callback; }
+    void setOnBackpressure(OnBackpressureCallback callback) { onBackpressure_ = callback; }
+    void setOnMessagesReceived(OnMessagesReceivedCallback callback) { onMessagesReceived_ = callback; }
 
-    // SSL/TLS
+    // Batched receive (set before reading starts). Each readiness event
+    // drains up to maxReads reads or maxBytes bytes, decodes them with the
+    // framer and reports the messages in one onMessagesReceived call.
+    // Completion loops batch the receives reaped in one turn. The buffer
+    // callbacks still see every read.
+    void setReceiveBatching(std::unique_ptr<MessageFramer> framer, size_t maxReads = 16, size_t maxBytes = 256 * 1024);
+
+    // SSL/TLS. Call before reading starts (the server does this on accept);
+    // the connection takes the server role. Data sent or queued before the
+    // handshake completes goes out once it does.
     bool enableSsl(std::shared_ptr<SslContext> context);
     bool isSslEnabled() const { return sslEnabled_; }
+    const TlsSession* getTlsSession() const { return tls_.get(); }
+
+    // Deadlines on the connection's event loop (loop mode; set before
+    // reading starts, 0 = none). A connection with no traffic either way for
+    // the idle timeout, or whose TLS handshake hasn't finished by the
+    // handshake timeout, reports ErrorCode::Timeout and is closed.
+    void setIdleTimeout(std::chrono::milliseconds timeout) { idleTimeout_ = timeout; }
+    void setHandshakeTimeout(std::chrono::milliseconds timeout) { handshakeTimeout_ = timeout; }
+
+    // Traffic shaping (set before reading starts; nullptr = none). Limiters
+    // may be shared between connections, or children of one parent for an
+    // aggregate cap. In loop mode a connection in debt stops flushing queued
+    // sends, or stops reading, and a timer on its loop resumes it; direct
+    // sends and the dedicated receive thread wait on their own thread.
+    void setSendRateLimiter(std::shared_ptr<RateLimiter> limiter) { sendLimiter_ = std::move(limiter); }
+    void setReceiveRateLimiter(std::shared_ptr<RateLimiter> limiter) { receiveLimiter_ = std::move(limiter); }
+    const std::shared_ptr<RateLimiter>& getSendRateLimiter() const { return sendLimiter_; }
+    const std::shared_ptr<RateLimiter>& getReceiveRateLimiter() const { return receiveLimiter_; }
+
+    // Event loop (nullptr when using a dedicated receive thread)
+    EventLoop* getEventLoop() const { return loop_; }
 
 private:
+    friend class TcpServer;
+    friend class LoadGenerator;
+
+    ConnectionId id_;
     socket_t socket_;
     std::string remoteAddress_;
     uint16_t remotePort_;
@@ -201,23 +352,140 @@ private:
     std::chrono::system_clock::time_point connectedAt_;
     std::atomic<size_t> bytesSent_;
     std::atomic<size_t> bytesReceived_;
+    std::shared_ptr<ConnectionMetrics> metrics_; // Shared with the server; may be null
     
     bool sslEnabled_;
     std::shared_ptr<SslContext> sslContext_;
-    void* sslHandle_; // SSL* handle
+    std::unique_ptr<TlsSession> tls_;
     
-    mutable std::mutex mutex_;
+    mutable std::mutex mutex_;     // Guards socket_ and reads
+    std::mutex sendMutex_;         // Serializes direct writes; taken before mutex_
+    
+    // Direct writes hold the descriptor without mutex_, so a close while
+    // one is running shuts the socket down to wake it and leaves the
+    // descriptor to the last writer (guarded by mutex_)
+    size_t directWriters_;
+    socket_t directCloseSocket_;
     std::thread receiveThread_;
     std::atomic<bool> shouldStop_;
+    EventLoop* loop_;
+    std::shared_ptr<EventLoop> loopRef_; // Keeps a shared-owned loop alive
+    
+    // Queued sends
+    SendMode sendMode_;
+    std::unique_ptr<OutboundQueue> outbound_;
+    std::atomic<bool> flushScheduled_;
+    std::atomic<bool> aboveHighWatermark_;
+    bool writeInterest_; // Loop thread only
+    
+    // Completion loops (loop thread only): a multishot receive reads, and
+    // queued sends go out as linked chains, one in flight at a time. A
+    // chain still in flight at close keeps the socket open in
+    // lingerSocket_ until it reports, then the close finishes.
+    bool completionIo_;
+    bool sendInFlight_;
+    socket_t lingerSocket_;
+    bool lingerFlush_;
+    size_t lowWatermark_;
+    size_t highWatermark_;
+    
+    // Timers. Idle checks are lazy: traffic only stamps lastActivity_, and
+    // the timer re-arms for the remainder when it finds the stamp recent.
+    std::chrono::milliseconds idleTimeout_;
+    std::chrono::milliseconds handshakeTimeout_;
+    std::atomic<int64_t> lastActivity_; // Steady-clock nanoseconds
+    std::atomic<TimerId> idleTimer_;
+    std::atomic<TimerId> handshakeTimer_;
+    
+    // Shaping. Sends are charged after each flush, reads after each recv;
+    // the paused flags are loop thread only.
+    std::shared_ptr<RateLimiter> sendLimiter_;
+    std::shared_ptr<RateLimiter> receiveLimiter_;
+    bool sendPaused_;
+    bool readPaused_;
+    std::atomic<TimerId> sendShapingTimer_;
+    std::atomic<TimerId> readShapingTimer_;
+    
+    // Receive batching; the batch is the reading thread's only
+    std::unique_ptr<MessageFramer> batchFramer_;
+    size_t batchMaxReads_;
+    size_t batchMaxBytes_;
+    std::vector<BufferView> batch_;
+    size_t batchReads_;
+    size_t batchBytes_;
+    bool batchScheduled_;
+    
+    bool quickAck_;
+    
+    // sendAsync() without an event loop: one Executor task drains these in order
+    std::mutex asyncSendMutex_;
+    std::queue<std::pair<std::vector<uint8_t>, std::function<void(bool)>>> asyncSends_;
+    bool asyncSendRunning_;
     
     // Callbacks
     OnDataReceivedCallback onDataReceived_;
+    OnBufferReceivedCallback onBufferReceived_;
     OnDisconnectedCallback onDisconnected_;
     OnErrorCallback onError_;
+    OnBackpressureCallback onBackpressure_;
+    OnMessagesReceivedCallback onMessagesReceived_;
     
     // Internal methods
     void startReceiveThread();
     void receiveLoop();
+    int receiveInternal(void* buffer, size_t length, int flags);
+    bool startReading();
+    void handleReadable();
+    void handleReceived(const BufferView& data, ErrorCode error);
+    void handleWritable();
+    bool advanceHandshake();
+    // Outbound connections: the handshake starts from the first writable event
+    bool enableClientSsl(std::shared_ptr<SslContext> context, const std::string& serverName,
+                         const std::string& peerKey);
+    bool attachTls(std::shared_ptr<SslContext> context, bool client, const std::string& serverName,
+                   const std::string& peerKey);
+    int receiveTls(void* buffer, size_t length);
+    ErrorCode sendTls(socket_t socket, const uint8_t* data, size_t length);
+    bool sendFileInternal(std::shared_ptr<FileTransfer> file);
+    ErrorCode sendFileDirect(socket_t socket, FileTransfer& file, size_t& written);
+    socket_t beginDirectWrite();
+    void endDirectWrite();
+    std::chrono::milliseconds directSendTimeout() const;
+    bool failSend(ErrorCode error);
+    void deliverReceived(const std::shared_ptr<TcpConnection>& self, const BufferView& data,
+                         std::chrono::steady_clock::time_point readyAt);
+    bool collectMessages(const BufferView& data); // True once the batch is full
+    void rearmQuickAck();
+    bool deliverMessages(const std::shared_ptr<TcpConnection>& self);
+    void setMetrics(std::shared_ptr<ConnectionMetrics> metrics); // Before any send
+    void addBytesSent(size_t bytes);
+    void addBytesReceived(size_t bytes);
+    void countSyscall(bool write);
+    bool enqueueSend(std::vector<uint8_t> data);
+    bool onEnqueued(size_t queued, size_t messages = 1);
+    bool sendDirect(const void* data, size_t length, size_t messages);
+    ErrorCode writeDirect(socket_t socket, const void* data, size_t length);
+    bool queueBehindFlush(const void* data, size_t length, size_t messages);
+    void runAsyncSends();
+    void scheduleFlush();
+    void flushOutbound();
+    bool sendChained();
+    void handleSent(size_t bytesWritten, ErrorCode error);
+    void notifyFileProgress(std::vector<std::shared_ptr<FileTransfer>>& files);
+    void setWriteInterest(bool enable);
+    uint32_t getInterest() const;
+    void pauseSending(std::chrono::nanoseconds delay);
+    void pauseReading(std::chrono::nanoseconds delay);
+    void resumeReading();
+    void waitForReceiveBudget(size_t received);
+    void notifyBackpressure(bool aboveHighWatermark);
+    void armIdleTimer(std::chrono::milliseconds delay);
+    void checkIdle();
+    void checkHandshake();
+    void touch();
+    void cancelTimers();
+    void handleClose();
+    void releaseLoopSocket();
     void setState(ConnectionState state);
     void handleError(ErrorCode error, const std::string& message);
     bool initializeLocalAddress();
@@ -1,5 +1,7 @@
 #include "tcp_utils.h"
 #include "tcp_socket.h"
+#include "websocket_framer.h"
+#include "http_parser.h"
 #include <sstream>
 #include <iomanip>
 #include <random>
@@ -7,12 +9,191 @@
 #include <cstring>
 #include <iostream>
 #include <thread>
+#include <ctime>
+#include <cstdlib>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define TCP_DELIMITER_SSE2 1
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+    #include <arm_neon.h>
+    #define TCP_DELIMITER_NEON 1
+#endif
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#endif
+#ifdef _MSC_VER
+    #include <intrin.h>
+#endif
+
+// Base64: AVX2 chosen at run time on x86 (GCC/Clang), NEON on AArch64
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #include <immintrin.h>
+    #define TCP_BASE64_AVX2 1
+#elif defined(TCP_DELIMITER_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+    #define TCP_BASE64_NEON 1
+#endif
+
+#ifdef TCP_SSL_SUPPORT
+    #include <openssl/evp.h>
+#endif
 
 namespace tcp {
 
+namespace {
+
+// Per-thread reuse list behind BufferManager::allocateBuffer()
+constexpr size_t kMaxRecycledVectors = 16;
+constexpr size_t kMaxRecycledVectorSize = 1024 * 1024;
+
+std::vector<std::vector<uint8_t>>& recycledVectors() {
+    thread_local std::vector<std::vector<uint8_t>> vectors;
+    return vectors;
+}
+
+inline unsigned countTrailingZeros(uint64_t mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctzll(mask));
+#endif
+}
+
+// Delimiter scanners used by DelimiterFramer. find() returns the offset of
+// the first complete delimiter, or npos.
+
+// Single byte: libc memchr is already vectorized
+struct SingleByteMatcher {
+    uint8_t byte;
+    
+    size_t find(const uint8_t* data, size_t size) const {
+        const void* match = std::memchr(data, byte, size);
+        return match ? static_cast<size_t>(static_cast<const uint8_t*>(match) - data) : std::string::npos;
+    }
+};
+
+// "\r\n": each block is compared against '\r' and the block one byte later
+// against '\n', so a match is found in a single pass
+struct CrLfMatcher {
+    size_t find(const uint8_t* data, size_t size) const {
+        size_t i = 0;
+#if defined(__AVX2__)
+        const __m256i cr32 = _mm256_set1_epi8('\r');
+        const __m256i lf32 = _mm256_set1_epi8('\n');
+        for (; i + 33 <= size; i += 32) {
+            __m256i first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            __m256i second = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 1));
+            __m256i match = _mm256_and_si256(_mm256_cmpeq_epi8(first, cr32), _mm256_cmpeq_epi8(second, lf32));
+            uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(match));
+            if (mask != 0) {
+                return i + countTrailingZeros(mask);
+            }
+        }
+#endif
+#if defined(TCP_DELIMITER_SSE2)
+        const __m128i cr = _mm_set1_epi8('\r');
+        const __m128i lf = _mm_set1_epi8('\n');
+        for (; i + 17 <= size; i += 16) {
+            __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 1));
+            __m128i match = _mm_and_si128(_mm_cmpeq_epi8(first, cr), _mm_cmpeq_epi8(second, lf));
+            uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(match));
+            if (mask != 0) {
+                return i + countTrailingZeros(mask);
+            }
+        }
+#elif defined(TCP_DELIMITER_NEON)
+        const uint8x16_t cr = vdupq_n_u8('\r');
+        const uint8x16_t lf = vdupq_n_u8('\n');
+        for (; i + 17 <= size; i += 16) {
+            uint8x16_t match = vandq_u8(vceqq_u8(vld1q_u8(data + i), cr), vceqq_u8(vld1q_u8(data + i + 1), lf));
+            // Narrow to 4 bits per byte to get a scalar mask
+            uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(match), 4)), 0);
+            if (mask != 0) {
+                return i + countTrailingZeros(mask) / 4;
+            }
+        }
+#endif
+        // Remaining bytes
+        while (i + 1 < size) {
+            const void* match = std::memchr(data + i, '\r', size - 1 - i);
+            if (!match) {
+                break;
+            }
+            i = static_cast<const uint8_t*>(match) - data;
+            if (data[i + 1] == '\n') {
+                return i;
+            }
+            i++;
+        }
+        return std::string::npos;
+    }
+};
+
+// Anything else: find the first byte, then verify the rest
+struct GenericMatcher {
+    const uint8_t* delimiter;
+    size_t length;
+    
+    size_t find(const uint8_t* data, size_t size) const {
+        if (length == 0 || size < length) {
+            return std::string::npos;
+        }
+        
+        const size_t last = size - length;
+        size_t i = 0;
+        while (i <= last) {
+            const void* match = std::memchr(data + i, delimiter[0], last - i + 1);
+            if (!match) {
+                break;
+            }
+            i = static_cast<const uint8_t*>(match) - data;
+            if (std::memcmp(data + i + 1, delimiter + 1, length - 1) == 0) {
+                return i;
+            }
+            i++;
+        }
+        return std::string::npos;
+    }
+};
+
+} // namespace
+
+// MessageFramer implementation
+void MessageFramer::appendFrame(const ByteView& message, std::vector<uint8_t>& out) {
+    std::vector<uint8_t> framed = frame(message.toVector());
+    out.insert(out.end(), framed.begin(), framed.end());
+}
+
+size_t MessageFramer::decodeFrames(const BufferView& data, const BufferFrameCallback& onFrame) {
+    std::vector<std::vector<uint8_t>> messages = unframe(data.toVector());
+    for (const auto& message : messages) {
+        Buffer buffer = BufferPool::shared().acquire(message.size());
+        std::memcpy(buffer.data(), message.data(), message.size());
+        buffer.setSize(message.size());
+        onFrame(BufferView(std::move(buffer)));
+    }
+    return messages.size();
+}
+
+void MessageFramer::frameBatch(const ByteView* messages, size_t count, std::vector<uint8_t>& out) {
+    // Room for the payloads and most headers, so appending rarely grows it
+    size_t bytes = 0;
+    for (size_t i = 0; i < count; i++) {
+        bytes += messages[i].size() + 8;
+    }
+    out.clear();
+    out.reserve(bytes);
+    for (size_t i = 0; i < count; i++) {
+        appendFrame(messages[i], out);
+    }
+}
+
 // LengthPrefixedFramer implementation
 LengthPrefixedFramer::LengthPrefixedFramer(LengthType lengthType, bool bigEndian)
-    : lengthType_(lengthType), bigEndian_(bigEndian), expectedLength_(0), lengthReceived_(false) {
+    : lengthType_(lengthType), bigEndian_(bigEndian), maxFrameSize_(kDefaultMaxFrameSize), error_(false) {
 }
 
 std::vector<uint8_t> LengthPrefixedFramer::frame(const std::vector<uint8_t>& data) {
@@ -28,33 +209,103 @@ std::vector<uint8_t> LengthPrefixedFramer::frame(const std::vector<uint8_t>& dat
     return framedData;
 }
 
+void LengthPrefixedFramer::appendFrame(const ByteView& message, std::vector<uint8_t>& out) {
+    writeLength(out, message.size());
+    out.insert(out.end(), message.begin(), message.end());
+}
+
+size_t LengthPrefixedFramer::decodeFrames(const BufferView& data, const BufferFrameCallback& onFrame) {
+    return unframe(data, onFrame);
+}
+
 std::vector<std::vector<uint8_t>> LengthPrefixedFramer::unframe(const std::vector<uint8_t>& data) {
     std::vector<std::vector<uint8_t>> messages;
-    buffer_.insert(buffer_.end(), data.begin(), data.end());
-    
-    while (buffer_.size() >= getLengthSize()) {
-        if (!lengthReceived_) {
-            if (buffer_.size() >= getLengthSize()) {
-                expectedLength_ = readLength(buffer_, 0);
-                lengthReceived_ = true;
-                buffer_.erase(buffer_.begin(), buffer_.begin() + getLengthSize());
-            } else {
-                break;
+    parse(ByteView(data), [&messages](const ByteView& frame, bool) {
+        messages.push_back(frame.toVector());
+    });
+    return messages;
+}
+
+size_t LengthPrefixedFramer::unframe(const ByteView& data, const FrameCallback& onFrame) {
+    return parse(data, [&onFrame](const ByteView& frame, bool) {
+        onFrame(frame);
+    });
+}
+
+size_t LengthPrefixedFramer::unframe(const BufferView& data, const BufferFrameCallback& onFrame) {
+    return parse(data.view(), [&data, &onFrame](const ByteView& frame, bool inInput) {
+        if (inInput) {
+            onFrame(data.slice(frame.data() - data.data(), frame.size()));
+            return;
+        }
+        
+        // Reassembled across reads: give it a block of its own
+        Buffer buffer = BufferPool::shared().acquire(frame.size());
+        std::memcpy(buffer.data(), frame.data(), frame.size());
+        buffer.setSize(frame.size());
+        onFrame(BufferView(std::move(buffer)));
+    });
+}
+
+template <typename Emit>
+size_t LengthPrefixedFramer::parse(ByteView input, Emit&& emit) {
+    if (error_) {
+        return 0;
+    }
+    
+    const size_t headerSize = getLengthSize();
+    size_t frames = 0;
+    
+    // Finish the frame carried over from earlier reads
+    if (!buffer_.empty()) {
+        if (buffer_.size() < headerSize) {
+            size_t take = std::min(headerSize - buffer_.size(), input.size());
+            buffer_.insert(buffer_.end(), input.begin(), input.begin() + take);
+            input = input.subview(take);
+            if (buffer_.size() < headerSize) {
+                return 0;
             }
         }
         
-        if (lengthReceived_ && buffer_.size() >= expectedLength_) {
-            std::vector<uint8_t> message(buffer_.begin(), buffer_.begin() + expectedLength_);
-            messages.push_back(message);
-            buffer_.erase(buffer_.begin(), buffer_.begin() + expectedLength_);
-            lengthReceived_ = false;
-            expectedLength_ = 0;
-        } else {
+        size_t length = readLength(buffer_.data());
+        if (length > maxFrameSize_) {
+            error_ = true;
+            buffer_.clear();
+            return 0;
+        }
+        
+        size_t take = std::min(headerSize + length - buffer_.size(), input.size());
+        buffer_.insert(buffer_.end(), input.begin(), input.begin() + take);
+        input = input.subview(take);
+        if (buffer_.size() < headerSize + length) {
+            return 0;
+        }
+        
+        emit(ByteView(buffer_.data() + headerSize, length), false);
+        buffer_.clear();
+        frames++;
+    }
+    
+    // Whole frames straight from the input, no copies
+    size_t offset = 0;
+    while (input.size() - offset >= headerSize) {
+        size_t length = readLength(input.data() + offset);
+        if (length > maxFrameSize_) {
+            error_ = true;
+            return frames;
+        }
+        if (input.size() - offset - headerSize < length) {
             break;
         }
+        
+        emit(ByteView(input.data() + offset + headerSize, length), true);
+        offset += headerSize + length;
+        frames++;
     }
     
-    return messages;
+    // Keep the partial tail for the next read
+    buffer_.assign(input.begin() + offset, input.end());
+    return frames;
 }
 
 bool LengthPrefixedFramer::isComplete(const std::vector<uint8_t>& data) {
@@ -62,14 +313,13 @@ bool LengthPrefixedFramer::isComplete(const std::vector<uint8_t>& data) {
         return false;
     }
     
-    size_t expectedLength = readLength(data, 0);
+    size_t expectedLength = readLength(data.data());
     return data.size() >= getLengthSize() + expectedLength;
 }
 
 void LengthPrefixedFramer::reset() {
     buffer_.clear();
-    expectedLength_ = 0;
-    lengthReceived_ = false;
+    error_ = false;
 }
 
 size_t LengthPrefixedFramer::getLengthSize() const {
@@ -130,40 +380,40 @@ void LengthPrefixedFramer::writeLength(std::vector<uint8_t>& data, size_t length
     }
 }
 
-size_t LengthPrefixedFramer::readLength(const std::vector<uint8_t>& data, size_t offset) const {
+size_t LengthPrefixedFramer::readLength(const uint8_t* data) const {
     switch (lengthType_) {
         case LengthType::UInt8: {
-            return data[offset];
+            return data[0];
         }
         case LengthType::UInt16: {
             if (bigEndian_) {
-                return (static_cast<uint16_t>(data[offset]) << 8) | data[offset + 1];
+                return (static_cast<uint16_t>(data[0]) << 8) | data[1];
             } else {
-                return data[offset] | (static_cast<uint16_t>(data[offset + 1]) << 8);
+                return data[0] | (static_cast<uint16_t>(data[1]) << 8);
             }
         }
         case LengthType::UInt32: {
             if (bigEndian_) {
-                return (static_cast<uint32_t>(data[offset]) << 24) |
-                       (static_cast<uint32_t>(data[offset + 1]) << 16) |
-                       (static_cast<uint32_t>(data[offset + 2]) << 8) |
-                       data[offset + 3];
+                return (static_cast<uint32_t>(data[0]) << 24) |
+                       (static_cast<uint32_t>(data[1]) << 16) |
+                       (static_cast<uint32_t>(data[2]) << 8) |
+                       data[3];
             } else {
-                return data[offset] |
-                       (static_cast<uint32_t>(data[offset + 1]) << 8) |
-                       (static_cast<uint32_t>(data[offset + 2]) << 16) |
-                       (static_cast<uint32_t>(data[offset + 3]) << 24);
+                return data[0] |
+                       (static_cast<uint32_t>(data[1]) << 8) |
+                       (static_cast<uint32_t>(data[2]) << 16) |
+                       (static_cast<uint32_t>(data[3]) << 24);
             }
         }
         case LengthType::UInt64: {
             uint64_t result = 0;
             if (bigEndian_) {
                 for (int i = 0; i < 8; i++) {
-                    result |= static_cast<uint64_t>(data[offset + i]) << ((7 - i) * 8);
+                    result |= static_cast<uint64_t>(data[i]) << ((7 - i) * 8);
                 }
             } else {
                 for (int i = 0; i < 8; i++) {
-                    result |= static_cast<uint64_t>(data[offset + i]) << (i * 8);
+                    result |= static_cast<uint64_t>(data[i]) << (i * 8);
                 }
             }
             return result;
@@ -174,11 +424,16 @@ size_t LengthPrefixedFramer::readLength(const std::vector<uint8_t>& data, size_t
 
 // DelimiterFramer implementation
 DelimiterFramer::DelimiterFramer(const std::vector<uint8_t>& delimiter, bool includeDelimiter)
-    : delimiter_(delimiter), includeDelimiter_(includeDelimiter) {
+    : delimiter_(delimiter), includeDelimiter_(includeDelimiter), kind_(DelimiterKind::Generic) {
+    if (delimiter_.size() == 1) {
+        kind_ = DelimiterKind::SingleByte;
+    } else if (delimiter_.size() == 2 && delimiter_[0] == '\r' && delimiter_[1] == '\n') {
+        kind_ = DelimiterKind::CrLf;
+    }
 }
 
 DelimiterFramer::DelimiterFramer(const std::string& delimiter, bool includeDelimiter)
-    : delimiter_(delimiter.begin(), delimiter.end()), includeDelimiter_(includeDelimiter) {
+    : DelimiterFramer(std::vector<uint8_t>(delimiter.begin(), delimiter.end()), includeDelimiter) {
 }
 
 std::vector<uint8_t> DelimiterFramer::frame(const std::vector<uint8_t>& data) {
@@ -187,216 +442,167 @@ std::vector<uint8_t> DelimiterFramer::frame(const std::vector<uint8_t>& data) {
     return framedData;
 }
 
+void DelimiterFramer::appendFrame(const ByteView& message, std::vector<uint8_t>& out) {
+    out.insert(out.end(), message.begin(), message.end());
+    out.insert(out.end(), delimiter_.begin(), delimiter_.end());
+}
+
+size_t DelimiterFramer::decodeFrames(const BufferView& data, const BufferFrameCallback& onFrame) {
+    return unframe(data, onFrame);
+}
+
 std::vector<std::vector<uint8_t>> DelimiterFramer::unframe(const std::vector<uint8_t>& data) {
     std::vector<std::vector<uint8_t>> messages;
-    buffer_.insert(buffer_.end(), data.begin(), data.end());
-    
-    size_t pos = 0;
-    while ((pos = findDelimiter(buffer_, pos)) != std::string::npos) {
-        std::vector<uint8_t> message(buffer_.begin(), buffer_.begin() + pos);
-        if (includeDelimiter_) {
-            message.insert(message.end(), delimiter_.begin(), delimiter_.end());
-        }
-        messages.push_back(message);
-        buffer_.erase(buffer_.begin(), buffer_.begin() + pos + delimiter_.size());
-        pos = 0;
-    }
-    
+    dispatch(ByteView(data), [&messages](const ByteView& message, bool) {
+        messages.push_back(message.toVector());
+    });
     return messages;
 }
 
+size_t DelimiterFramer::unframe(const ByteView& data, const FrameCallback& onFrame) {
+    return dispatch(data, [&onFrame](const ByteView& message, bool) {
+        onFrame(message);
+    });
+}
+
+size_t DelimiterFramer::unframe(const BufferView& data, const BufferFrameCallback& onFrame) {
+    return dispatch(data.view(), [&data, &onFrame](const ByteView& message, bool inInput) {
+        if (inInput) {
+            onFrame(data.slice(message.data() - data.data(), message.size()));
+            return;
+        }
+        
+        // Reassembled across reads: give it a block of its own
+        Buffer buffer = BufferPool::shared().acquire(message.size());
+        std::memcpy(buffer.data(), message.data(), message.size());
+        buffer.setSize(message.size());
+        onFrame(BufferView(std::move(buffer)));
+    });
+}
+
 bool DelimiterFramer::isComplete(const std::vector<uint8_t>& data) {
-    return findDelimiter(data) != std::string::npos;
+    return findDelimiter(data.data(), data.size()) != std::string::npos;
 }
 
 void DelimiterFramer::reset() {
     buffer_.clear();
 }
 
-size_t DelimiterFramer::findDelimiter(const std::vector<uint8_t>& data, size_t startPos) const {
-    if (delimiter_.empty() || data.size() < delimiter_.size()) {
-        return std::string::npos;
+size_t DelimiterFramer::findDelimiter(const uint8_t* data, size_t size) const {
+    switch (kind_) {
+        case DelimiterKind::SingleByte: return SingleByteMatcher{delimiter_[0]}.find(data, size);
+        case DelimiterKind::CrLf: return CrLfMatcher{}.find(data, size);
+        default: return GenericMatcher{delimiter_.data(), delimiter_.size()}.find(data, size);
     }
+}
+
+size_t DelimiterFramer::findStraddling(const ByteView& input) const {
+    // Only the last delimiter-size - 1 carried bytes can start a delimiter
+    // that ends in the input; everything before them was already scanned
+    const size_t delimiterSize = delimiter_.size();
+    const size_t carried = buffer_.size();
+    size_t start = carried >= delimiterSize ? carried - delimiterSize + 1 : 0;
     
-    for (size_t i = startPos; i <= data.size() - delimiter_.size(); i++) {
-        if (std::equal(delimiter_.begin(), delimiter_.end(), data.begin() + i)) {
-            return i;
+    for (; start < carried; start++) {
+        size_t head = carried - start;
+        size_t tail = delimiterSize - head;
+        if (tail <= input.size() &&
+            std::memcmp(buffer_.data() + start, delimiter_.data(), head) == 0 &&
+            std::memcmp(input.data(), delimiter_.data() + head, tail) == 0) {
+            return start;
         }
     }
     
     return std::string::npos;
 }
 
-// ConnectionPool implementation
-ConnectionPool::ConnectionPool(size_t maxConnections) : maxConnections_(maxConnections) {
-}
-
-ConnectionPool::~ConnectionPool() {
-    clear();
+template <typename Emit>
+size_t DelimiterFramer::dispatch(const ByteView& input, Emit&& emit) {
+    switch (kind_) {
+        case DelimiterKind::SingleByte: return parse(SingleByteMatcher{delimiter_[0]}, input, emit);
+        case DelimiterKind::CrLf: return parse(CrLfMatcher{}, input, emit);
+        default: return parse(GenericMatcher{delimiter_.data(), delimiter_.size()}, input, emit);
+    }
 }
 
-std::shared_ptr<TcpConnection> ConnectionPool::acquire() {
-    std::unique_lock<std::mutex> lock(mutex_);
-    
-    // Try to get an idle connection
-    if (!idleConnections_.empty()) {
-        auto connection = idleConnections_.back();
-        idleConnections_.pop_back();
-        activeConnections_.push_back(connection);
-        return connection;
-    }
+template <typename Matcher, typename Emit>
+size_t DelimiterFramer::parse(const Matcher& matcher, ByteView input, Emit&& emit) {
+    const size_t delimiterSize = delimiter_.size();
+    size_t messages = 0;
     
-    // Create new connection if under limit
-    if (activeConnections_.size() < maxConnections_) {
-        if (connectionFactory_) {
-            auto connection = connectionFactory_();
-            if (connection) {
-                activeConnections_.push_back(connection);
-                return connection;
+    // Finish the message carried over from earlier reads
+    if (!buffer_.empty()) {
+        size_t end = findStraddling(input);
+        size_t consumed;
+        if (end != std::string::npos) {
+            consumed = end + delimiterSize - buffer_.size();
+        } else {
+            size_t pos = matcher.find(input.data(), input.size());
+            if (pos == std::string::npos) {
+                buffer_.insert(buffer_.end(), input.begin(), input.end());
+                return 0;
             }
+            end = buffer_.size() + pos;
+            consumed = pos + delimiterSize;
         }
+        
+        buffer_.insert(buffer_.end(), input.begin(), input.begin() + consumed);
+        emit(ByteView(buffer_.data(), includeDelimiter_ ? end + delimiterSize : end), false);
+        buffer_.clear();
+        input = input.subview(consumed);
+        messages++;
     }
     
-    // Wait for a connection to become available
-    condition_.wait(lock, [this] { return !idleConnections_.empty() || activeConnections_.size() < maxConnections_; });
-    
-    if (!idleConnections_.empty()) {
-        auto connection = idleConnections_.back();
-        idleConnections_.pop_back();
-        activeConnections_.push_back(connection);
-        return connection;
-    }
-    
-    return nullptr;
-}
-
-void ConnectionPool::release(std::shared_ptr<TcpConnection> connection) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    // Remove from active connections
-    auto it = std::find(activeConnections_.begin(), activeConnections_.end(), connection);
-    if (it != activeConnections_.end()) {
-        activeConnections_.erase(it);
-        
-        // Add to idle connections if connection is valid
-        // Note: We can't check isConnected() here due to forward declaration
-        // The connection factory should ensure connections are valid
-        if (connection) {
-            idleConnections_.push_back(connection);
-        }
-        
-        condition_.notify_one();
+    // Whole messages straight from the input, no copies
+    size_t offset = 0;
+    size_t pos;
+    while ((pos = matcher.find(input.data() + offset, input.size() - offset)) != std::string::npos) {
+        emit(ByteView(input.data() + offset, includeDelimiter_ ? pos + delimiterSize : pos), true);
+        offset += pos + delimiterSize;
+        messages++;
     }
-}
-
-void ConnectionPool::clear() {
-    std::lock_guard<std::mutex> lock(mutex_);
     
-    // Clear connections (can't call close() due to forward declaration)
-    // The connections will be properly cleaned up when their destructors are called
-    activeConnections_.clear();
-    idleConnections_.clear();
-    condition_.notify_all();
-}
-
-void ConnectionPool::setMaxConnections(size_t maxConnections) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    maxConnections_ = maxConnections;
-}
-
-size_t ConnectionPool::getActiveConnections() const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return activeConnections_.size();
-}
-
-size_t ConnectionPool::getIdleConnections() const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return idleConnections_.size();
-}
-
-void ConnectionPool::setConnectionFactory(std::function<std::shared_ptr<TcpConnection>()> factory) {
-    connectionFactory_ = factory;
+    // Keep the undelimited tail for the next read
+    buffer_.assign(input.begin() + offset, input.end());
+    return messages;
 }
 
-// RateLimiter implementation
-RateLimiter::RateLimiter(size_t bytesPerSecond, size_t bucketSize)
-    : bytesPerSecond_(bytesPerSecond), bucketSize_(bucketSize > 0 ? bucketSize : bytesPerSecond),
-      availableBytes_(bucketSize_), lastRefill_(std::chrono::steady_clock::now()) {
+// BufferManager implementation
+Buffer BufferManager::acquire(size_t size) {
+    Buffer buffer = BufferPool::shared().acquire(size);
+    buffer.setSize(size);
+    return buffer;
 }
 
-bool RateLimiter::allowBytes(size_t bytes) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    refillBucket();
+std::vector<uint8_t> BufferManager::allocateBuffer(size_t size) {
+    auto& freeList = recycledVectors();
     
-    if (availableBytes_ >= bytes) {
-        availableBytes_ -= bytes;
-        return true;
+    // Smallest recycled vector that fits
+    auto best = freeList.end();
+    for (auto it = freeList.begin(); it != freeList.end(); ++it) {
+        if (it->capacity() >= size && (best == freeList.end() || it->capacity() < best->capacity())) {
+            best = it;
+        }
     }
     
-    return false;
-}
-
-std::chrono::milliseconds RateLimiter::getDelay(size_t bytes) const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    if (availableBytes_ >= bytes) {
-        return std::chrono::milliseconds{0};
+    if (best == freeList.end()) {
+        return std::vector<uint8_t>(size);
     }
     
-    size_t deficit = bytes - availableBytes_;
-    double secondsToWait = static_cast<double>(deficit) / bytesPerSecond_;
-    return std::chrono::milliseconds{static_cast<long long>(secondsToWait * 1000)};
-}
-
-void RateLimiter::waitForBytes(size_t bytes) {
-    while (!allowBytes(bytes)) {
-        std::this_thread::sleep_for(std::chrono::milliseconds{10});
-    }
-}
-
-void RateLimiter::setRate(size_t bytesPerSecond) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    bytesPerSecond_ = bytesPerSecond;
-}
-
-void RateLimiter::setBucketSize(size_t bucketSize) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    bucketSize_ = bucketSize;
-}
-
-size_t RateLimiter::getAvailableBytes() const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return availableBytes_;
-}
-
-double RateLimiter::getUtilization() const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return 1.0 - (static_cast<double>(availableBytes_) / bucketSize_);
-}
-
-void RateLimiter::reset() {
-    std::lock_guard<std::mutex> lock(mutex_);
-    availableBytes_ = bucketSize_;
-    lastRefill_ = std::chrono::steady_clock::now();
+    std::vector<uint8_t> buffer = std::move(*best);
+    freeList.erase(best);
+    buffer.assign(size, 0);
+    return buffer;
 }
 
-void RateLimiter::refillBucket() {
-    auto now = std::chrono::steady_clock::now();
-    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - lastRefill_);
+void BufferManager::deallocateBuffer(std::vector<uint8_t>& buffer) {
+    auto& freeList = recycledVectors();
     
-    if (elapsed.count() > 0) {
-        size_t tokensToAdd = static_cast<size_t>((elapsed.count() / 1000.0) * bytesPerSecond_);
-        availableBytes_ = std::min(bucketSize_, availableBytes_ + tokensToAdd);
-        lastRefill_ = now;
+    if (buffer.capacity() > 0 && buffer.capacity() <= kMaxRecycledVectorSize && freeList.size() < kMaxRecycledVectors) {
+        buffer.clear();
+        freeList.push_back(std::move(buffer));
     }
-}
-
-// BufferManager implementation
-std::vector<uint8_t> BufferManager::allocateBuffer(size_t size) {
-    return std::vector<uint8_t>(size);
-}
-
-void BufferManager::deallocateBuffer(std::vector<uint8_t>& buffer) {
+    
     buffer.clear();
     buffer.shrink_to_fit();
 }
@@ -446,16 +652,15 @@ BufferManager::CircularBuffer::CircularBuffer(size_t capacity)
 size_t BufferManager::CircularBuffer::write(const void* data, size_t length) {
     std::lock_guard<std::mutex> lock(mutex_);
     
-    size_t availableSpace = capacity_ - size_;
-    size_t writeLength = std::min(length, availableSpace);
-    
+    size_t writeLength = std::min(length, capacity_ - size_);
     const uint8_t* sourceData = static_cast<const uint8_t*>(data);
     
-    for (size_t i = 0; i < writeLength; i++) {
-        buffer_[tail_] = sourceData[i];
-        tail_ = (tail_ + 1) % capacity_;
-        size_++;
-    }
+    // At most two copies: up to the end, then from the start
+    size_t first = std::min(writeLength, capacity_ - tail_);
+    std::memcpy(buffer_.data() + tail_, sourceData, first);
+    std::memcpy(buffer_.data(), sourceData + first, writeLength - first);
+    tail_ = (tail_ + writeLength) % capacity_;
+    size_ += writeLength;
     
     return writeLength;
 }
@@ -463,31 +668,27 @@ size_t BufferManager::CircularBuffer::write(const void* data, size_t length) {
 size_t BufferManager::CircularBuffer::read(void* data, size_t length) {
     std::lock_guard<std::mutex> lock(mutex_);
     
-    size_t readLength = std::min(length, size_);
-    uint8_t* destData = static_cast<uint8_t*>(data);
-    
-    for (size_t i = 0; i < readLength; i++) {
-        destData[i] = buffer_[head_];
-        head_ = (head_ + 1) % capacity_;
-        size_--;
-    }
+    size_t readLength = copyOut(data, length);
+    head_ = (head_ + readLength) % capacity_;
+    size_ -= readLength;
     
     return readLength;
 }
 
 size_t BufferManager::CircularBuffer::peek(void* data, size_t length) const {
     std::lock_guard<std::mutex> lock(mutex_);
-    
-    size_t peekLength = std::min(length, size_);
+    return copyOut(data, length);
+}
+
+size_t BufferManager::CircularBuffer::copyOut(void* data, size_t length) const {
+    size_t copyLength = std::min(length, size_);
     uint8_t* destData = static_cast<uint8_t*>(data);
     
-    size_t tempHead = head_;
-    for (size_t i = 0; i < peekLength; i++) {
-        destData[i] = buffer_[tempHead];
-        tempHead = (tempHead + 1) % capacity_;
-    }
+    size_t first = std::min(copyLength, capacity_ - head_);
+    std::memcpy(destData, buffer_.data() + head_, first);
+    std::memcpy(destData + first, buffer_.data(), copyLength - first);
     
-    return peekLength;
+    return copyLength;
 }
 
 void BufferManager::CircularBuffer::skip(size_t length) {
@@ -505,69 +706,1306 @@ void BufferManager::CircularBuffer::clear() {
     tail_ = 0;
 }
 
-// Logger implementation
-Logger::Level Logger::currentLevel_ = Logger::Level::Info;
-std::function<void(Logger::Level, const std::string&)> Logger::output_ = nullptr;
-std::mutex Logger::mutex_;
+// NetworkUtils implementation
+bool NetworkUtils::isPortAvailable(const std::string& address, uint16_t port) {
+    SocketAddress addr;
+    if (!SocketAddress::parse(address, port, addr)) {
+        return false;
+    }
+    
+    socket_t probe = socket(addr.getFamily(), SOCK_STREAM, IPPROTO_TCP);
+    if (probe == INVALID_SOCKET) {
+        return false;
+    }
+    
+    bool available = ::bind(probe, addr.get(), addr.getLength()) != SOCKET_ERROR;
+    
+#ifdef _WIN32
+    closesocket(probe);
+#else
+    ::close(probe);
+#endif
+    return available;
+}
 
-void Logger::setLevel(Level level) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    currentLevel_ = level;
+uint16_t NetworkUtils::findAvailablePort(const std::string& address, uint16_t startPort) {
+    for (uint32_t port = startPort; port <= 65535; port++) {
+        if (isPortAvailable(address, static_cast<uint16_t>(port))) {
+            return static_cast<uint16_t>(port);
+        }
+    }
+    return 0;
 }
 
-Logger::Level Logger::getLevel() {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return currentLevel_;
+std::vector<uint16_t> NetworkUtils::findAvailablePorts(const std::string& address, size_t count, uint16_t startPort) {
+    std::vector<uint16_t> ports;
+    for (uint32_t port = startPort; port <= 65535 && ports.size() < count; port++) {
+        if (isPortAvailable(address, static_cast<uint16_t>(port))) {
+            ports.push_back(static_cast<uint16_t>(port));
+        }
+    }
+    return ports;
 }
 
-void Logger::setOutput(std::function<void(Level, const std::string&)> output) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    output_ = output;
+// ProtocolHelper implementation
+namespace {
+
+const char kBase64Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Sextet value of each byte, or -1 for bytes outside the alphabet
+struct Base64DecodeTable {
+    int8_t values[256];
+
+    Base64DecodeTable() {
+        std::memset(values, -1, sizeof(values));
+        for (int i = 0; i < 64; i++) {
+            values[static_cast<uint8_t>(kBase64Alphabet[i])] = static_cast<int8_t>(i);
+        }
+    }
+};
+
+const Base64DecodeTable& base64DecodeTable() {
+    static const Base64DecodeTable table;
+    return table;
 }
 
-void Logger::debug(const std::string& message) {
-    log(Level::Debug, message);
+// Scalar codecs: the SIMD loops below hand them whatever is left
+size_t base64EncodeScalar(const uint8_t* in, size_t length, char* out) {
+    char* start = out;
+    while (length >= 3) {
+        uint32_t triple = (static_cast<uint32_t>(in[0]) << 16) | (static_cast<uint32_t>(in[1]) << 8) | in[2];
+        out[0] = kBase64Alphabet[(triple >> 18) & 0x3F];
+        out[1] = kBase64Alphabet[(triple >> 12) & 0x3F];
+        out[2] = kBase64Alphabet[(triple >> 6) & 0x3F];
+        out[3] = kBase64Alphabet[triple & 0x3F];
+        in += 3;
+        out += 4;
+        length -= 3;
+    }
+
+    if (length > 0) {
+        uint32_t triple = static_cast<uint32_t>(in[0]) << 16;
+        if (length == 2) {
+            triple |= static_cast<uint32_t>(in[1]) << 8;
+        }
+        out[0] = kBase64Alphabet[(triple >> 18) & 0x3F];
+        out[1] = kBase64Alphabet[(triple >> 12) & 0x3F];
+        out[2] = length == 2 ? kBase64Alphabet[(triple >> 6) & 0x3F] : '=';
+        out[3] = '=';
+        out += 4;
+    }
+    return static_cast<size_t>(out - start);
 }
 
-void Logger::info(const std::string& message) {
-    log(Level::Info, message);
+// Stops at the first padding or non-alphabet byte
+size_t base64DecodeScalar(const uint8_t* in, size_t length, uint8_t* out) {
+    const Base64DecodeTable& table = base64DecodeTable();
+    uint8_t* start = out;
+    uint32_t accumulator = 0;
+    int bits = 0;
+    for (size_t i = 0; i < length; i++) {
+        int8_t value = table.values[in[i]];
+        if (value < 0) {
+            break;
+        }
+        accumulator = (accumulator << 6) | static_cast<uint32_t>(value);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            *out++ = static_cast<uint8_t>(accumulator >> bits);
+        }
+    }
+    return static_cast<size_t>(out - start);
 }
 
-void Logger::warning(const std::string& message) {
-    log(Level::Warning, message);
+#if defined(TCP_BASE64_AVX2)
+// 24 bytes in, 32 characters out per step (Muła and Lemire's method):
+// shuffle each 3-byte group into a 32-bit word, pull the four sextets out
+// with two multiplies, then map them to ASCII with a 16-entry offset table.
+// Reads 4 bytes past the 24 it uses.
+__attribute__((target("avx2")))
+size_t base64EncodeAvx2(const uint8_t* in, size_t length, char* out) {
+    const __m256i shuffle = _mm256_setr_epi8(
+        1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+        1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    const __m256i offsets = _mm256_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+
+    size_t done = 0;
+    for (; done + 28 <= length; done += 24) {
+        __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + done));
+        __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + done + 12));
+        __m256i input = _mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1), shuffle);
+
+        __m256i ab = _mm256_mulhi_epu16(_mm256_and_si256(input, _mm256_set1_epi32(0x0FC0FC00)),
+                                        _mm256_set1_epi32(0x04000040));
+        __m256i cd = _mm256_mullo_epi16(_mm256_and_si256(input, _mm256_set1_epi32(0x003F03F0)),
+                                        _mm256_set1_epi32(0x01000010));
+        __m256i sextets = _mm256_or_si256(ab, cd);
+
+        // 0-25 -> 13, 26-51 -> 0, 52-61 -> 1-10, 62 -> 11, 63 -> 12
+        __m256i classes = _mm256_subs_epu8(sextets, _mm256_set1_epi8(51));
+        __m256i letters = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), sextets);
+        classes = _mm256_or_si256(classes, _mm256_and_si256(letters, _mm256_set1_epi8(13)));
+        __m256i ascii = _mm256_add_epi8(sextets, _mm256_shuffle_epi8(offsets, classes));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + done / 3 * 4), ascii);
+    }
+    return done / 3 * 4 + base64EncodeScalar(in + done, length - done, out + done / 3 * 4);
 }
 
-void Logger::error(const std::string& message) {
-    log(Level::Error, message);
+// 32 characters in, 24 bytes out per step. A block holding anything outside
+// the alphabet (padding included) is left to the scalar decoder, which
+// stops there.
+__attribute__((target("avx2")))
+size_t base64DecodeAvx2(const uint8_t* in, size_t length, uint8_t* out) {
+    // Nibble tables: a byte is valid when its low and high nibble entries
+    // share no bit
+    const __m256i lowValid = _mm256_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m256i highValid = _mm256_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i roll = _mm256_setr_epi8(
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i pack = _mm256_setr_epi8(
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+
+    size_t done = 0;
+    uint8_t* start = out;
+    for (; done + 32 <= length; done += 32) {
+        __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + done));
+        __m256i high = _mm256_and_si256(_mm256_srli_epi32(input, 4), nibble);
+        __m256i low = _mm256_and_si256(input, nibble);
+        if (!_mm256_testz_si256(_mm256_shuffle_epi8(lowValid, low), _mm256_shuffle_epi8(highValid, high))) {
+            break;
+        }
+
+        // ASCII to sextets: one offset per high nibble, '/' singled out
+        __m256i slash = _mm256_cmpeq_epi8(input, _mm256_set1_epi8('/'));
+        __m256i sextets = _mm256_add_epi8(input, _mm256_shuffle_epi8(roll, _mm256_add_epi8(slash, high)));
+
+        // Four sextets to three bytes, then close the gaps
+        __m256i pairs = _mm256_maddubs_epi16(sextets, _mm256_set1_epi32(0x01400140));
+        __m256i words = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+        __m256i bytes = _mm256_shuffle_epi8(words, pack);
+        bytes = _mm256_permutevar8x32_epi32(bytes, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, -1, -1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm256_castsi256_si128(bytes));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + 16), _mm256_extracti128_si256(bytes, 1));
+        out += 24;
+    }
+    out += base64DecodeScalar(in + done, length - done, out);
+    return static_cast<size_t>(out - start);
 }
 
-void Logger::critical(const std::string& message) {
-    log(Level::Critical, message);
+bool hasAvx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
 }
+#endif
 
-void Logger::log(Level level, const std::string& message) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    if (static_cast<int>(level) >= static_cast<int>(currentLevel_)) {
-        std::string formattedMessage = formatMessage(level, message);
-        
-        if (output_) {
-            output_(level, formattedMessage);
-        } else {
-            std::cout << formattedMessage << std::endl;
+#if defined(TCP_BASE64_NEON)
+// 48 bytes in, 64 characters out: de-interleave into four sextet vectors
+// and look them up in the 64-byte alphabet
+size_t base64EncodeNeon(const uint8_t* in, size_t length, char* out) {
+    uint8x16x4_t alphabet;
+    for (int i = 0; i < 4; i++) {
+        alphabet.val[i] = vld1q_u8(reinterpret_cast<const uint8_t*>(kBase64Alphabet) + i * 16);
+    }
+    const uint8x16_t sextet = vdupq_n_u8(0x3F);
+
+    size_t done = 0;
+    for (; done + 48 <= length; done += 48) {
+        uint8x16x3_t input = vld3q_u8(in + done);
+        uint8x16x4_t result;
+        result.val[0] = vshrq_n_u8(input.val[0], 2);
+        result.val[1] = vandq_u8(vorrq_u8(vshrq_n_u8(input.val[1], 4), vshlq_n_u8(input.val[0], 4)), sextet);
+        result.val[2] = vandq_u8(vorrq_u8(vshrq_n_u8(input.val[2], 6), vshlq_n_u8(input.val[1], 2)), sextet);
+        result.val[3] = vandq_u8(input.val[2], sextet);
+        for (int i = 0; i < 4; i++) {
+            result.val[i] = vqtbl4q_u8(alphabet, result.val[i]);
         }
+        vst4q_u8(reinterpret_cast<uint8_t*>(out) + done / 3 * 4, result);
     }
+    return done / 3 * 4 + base64EncodeScalar(in + done, length - done, out + done / 3 * 4);
 }
 
-std::string Logger::formatMessage(Level level, const std::string& message) {
-    auto now = std::chrono::system_clock::now();
-    auto time_t = std::chrono::system_clock::to_time_t(now);
-    
-    std::stringstream ss;
-    ss << std::put_time(std::localtime(&time_t), "%Y-%m-%d %H:%M:%S");
-    ss << " [" << levelToString(level) << "] " << message;
-    
-    return ss.str();
+// 64 characters in, 48 bytes out. Invalid bytes look up as 0xFF (or are
+// 0x80 and up themselves); a block with one goes to the scalar decoder.
+size_t base64DecodeNeon(const uint8_t* in, size_t length, uint8_t* out) {
+    const Base64DecodeTable& table = base64DecodeTable();
+    uint8x16x4_t lower;
+    uint8x16x4_t upper;
+    for (int i = 0; i < 4; i++) {
+        lower.val[i] = vld1q_u8(reinterpret_cast<const uint8_t*>(table.values) + i * 16);
+        upper.val[i] = vld1q_u8(reinterpret_cast<const uint8_t*>(table.values) + 64 + i * 16);
+    }
+    const uint8x16_t half = vdupq_n_u8(64);
+
+    size_t done = 0;
+    uint8_t* start = out;
+    for (; done + 64 <= length; done += 64) {
+        uint8x16x4_t input = vld4q_u8(in + done);
+        uint8x16x4_t sextets;
+        uint8x16_t invalid = vdupq_n_u8(0);
+        for (int i = 0; i < 4; i++) {
+            sextets.val[i] = vqtbx4q_u8(vqtbl4q_u8(lower, input.val[i]), upper, vsubq_u8(input.val[i], half));
+            invalid = vorrq_u8(invalid, vorrq_u8(sextets.val[i], input.val[i]));
+        }
+        if (vmaxvq_u8(invalid) & 0x80) {
+            break;
+        }
+
+        uint8x16x3_t result;
+        result.val[0] = vorrq_u8(vshlq_n_u8(sextets.val[0], 2), vshrq_n_u8(sextets.val[1], 4));
+        result.val[1] = vorrq_u8(vshlq_n_u8(sextets.val[1], 4), vshrq_n_u8(sextets.val[2], 2));
+        result.val[2] = vorrq_u8(vshlq_n_u8(sextets.val[2], 6), sextets.val[3]);
+        vst3q_u8(out, result);
+        out += 48;
+    }
+    out += base64DecodeScalar(in + done, length - done, out);
+    return static_cast<size_t>(out - start);
+}
+#endif
+
+const char kHexDigits[] = "0123456789abcdef";
+
+std::string toHex(const uint8_t* data, size_t length) {
+    std::string hex(length * 2, '\0');
+    for (size_t i = 0; i < length; i++) {
+        hex[i * 2] = kHexDigits[data[i] >> 4];
+        hex[i * 2 + 1] = kHexDigits[data[i] & 0x0F];
+    }
+    return hex;
+}
+
+#ifndef TCP_SSL_SUPPORT
+// Portable digests for builds without OpenSSL
+
+uint32_t rotateLeft(uint32_t value, int bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+uint32_t loadBigEndian32(const uint8_t* data) {
+    return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) |
+           (static_cast<uint32_t>(data[2]) << 8) | data[3];
+}
+
+uint32_t loadLittleEndian32(const uint8_t* data) {
+    return (static_cast<uint32_t>(data[3]) << 24) | (static_cast<uint32_t>(data[2]) << 16) |
+           (static_cast<uint32_t>(data[1]) << 8) | data[0];
+}
+
+void storeBigEndian32(uint8_t* data, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        data[i] = static_cast<uint8_t>(value >> (24 - i * 8));
+    }
+}
+
+void storeLittleEndian32(uint8_t* data, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        data[i] = static_cast<uint8_t>(value >> (i * 8));
+    }
+}
+
+// Runs compress over every 64-byte block of the message and its padding:
+// 0x80, zeros, then the bit length in the last 8 bytes
+template <typename Compress>
+void digestBlocks(const uint8_t* data, size_t length, bool bigEndianLength, Compress compress) {
+    size_t whole = length / 64 * 64;
+    for (size_t i = 0; i < whole; i += 64) {
+        compress(data + i);
+    }
+
+    uint8_t tail[128];
+    std::memset(tail, 0, sizeof(tail));
+    size_t rest = length - whole;
+    if (rest > 0) {
+        std::memcpy(tail, data + whole, rest);
+    }
+    tail[rest] = 0x80;
+    size_t tailSize = rest + 9 <= 64 ? 64 : 128;
+    uint64_t bits = static_cast<uint64_t>(length) * 8;
+    for (size_t i = 0; i < 8; i++) {
+        size_t position = bigEndianLength ? tailSize - 1 - i : tailSize - 8 + i;
+        tail[position] = static_cast<uint8_t>(bits >> (i * 8));
+    }
+    for (size_t i = 0; i < tailSize; i += 64) {
+        compress(tail + i);
+    }
+}
+
+void sha1Block(uint32_t state[5], const uint8_t* block) {
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++) {
+        w[i] = loadBigEndian32(block + i * 4);
+    }
+    for (int i = 16; i < 80; i++) {
+        w[i] = rotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+    for (int i = 0; i < 80; i++) {
+        uint32_t f;
+        uint32_t k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+        uint32_t next = rotateLeft(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = rotateLeft(b, 30);
+        b = a;
+        a = next;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+const uint32_t kSha256Constants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+uint32_t rotateRight(uint32_t value, int bits) {
+    return (value >> bits) | (value << (32 - bits));
+}
+
+void sha256Block(uint32_t state[8], const uint8_t* block) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = loadBigEndian32(block + i * 4);
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = rotateRight(w[i - 15], 7) ^ rotateRight(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = rotateRight(w[i - 2], 17) ^ rotateRight(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t v[8];
+    std::memcpy(v, state, sizeof(v));
+    for (int i = 0; i < 64; i++) {
+        uint32_t s1 = rotateRight(v[4], 6) ^ rotateRight(v[4], 11) ^ rotateRight(v[4], 25);
+        uint32_t choose = (v[4] & v[5]) ^ (~v[4] & v[6]);
+        uint32_t t1 = v[7] + s1 + choose + kSha256Constants[i] + w[i];
+        uint32_t s0 = rotateRight(v[0], 2) ^ rotateRight(v[0], 13) ^ rotateRight(v[0], 22);
+        uint32_t majority = (v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]);
+        std::memmove(v + 1, v, 7 * sizeof(uint32_t));
+        v[4] += t1;
+        v[0] = t1 + s0 + majority;
+    }
+    for (int i = 0; i < 8; i++) {
+        state[i] += v[i];
+    }
+}
+
+const uint32_t kMd5Constants[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+};
+
+const int kMd5Shifts[16] = {7, 12, 17, 22, 5, 9, 14, 20, 4, 11, 16, 23, 6, 10, 15, 21};
+
+void md5Block(uint32_t state[4], const uint8_t* block) {
+    uint32_t m[16];
+    for (int i = 0; i < 16; i++) {
+        m[i] = loadLittleEndian32(block + i * 4);
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    for (int i = 0; i < 64; i++) {
+        uint32_t f;
+        int index;
+        if (i < 16) {
+            f = (b & c) | (~b & d);
+            index = i;
+        } else if (i < 32) {
+            f = (d & b) | (~d & c);
+            index = (5 * i + 1) & 15;
+        } else if (i < 48) {
+            f = b ^ c ^ d;
+            index = (3 * i + 5) & 15;
+        } else {
+            f = c ^ (b | ~d);
+            index = (7 * i) & 15;
+        }
+        uint32_t next = b + rotateLeft(a + f + kMd5Constants[i] + m[index], kMd5Shifts[(i / 16) * 4 + (i & 3)]);
+        a = d;
+        d = c;
+        c = b;
+        b = next;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+}
+#endif
+
+std::mt19937& randomEngine() {
+    thread_local std::mt19937 engine(std::random_device{}());
+    return engine;
+}
+
+} // namespace
+
+std::string ProtocolHelper::buildHttpRequest(const std::string& method, const std::string& path,
+                                             const std::vector<std::pair<std::string, std::string>>& headers,
+                                             const std::string& body) {
+    HttpBuilder builder = HttpBuilder::request(method, path);
+    for (const auto& header : headers) {
+        builder.header(header.first, header.second);
+    }
+    if (!body.empty() && !builder.hasFraming()) {
+        builder.contentLength(body.size());
+    }
+    BufferView head = builder.finish();
+    if (head.empty()) {
+        return std::string(); // Invalid method, path or field
+    }
+    return head.toString() + body;
+}
+
+std::string ProtocolHelper::buildHttpResponse(int statusCode, const std::string& reasonPhrase,
+                                              const std::vector<std::pair<std::string, std::string>>& headers,
+                                              const std::string& body) {
+    HttpBuilder builder = HttpBuilder::response(statusCode, reasonPhrase);
+    for (const auto& header : headers) {
+        builder.header(header.first, header.second);
+    }
+    // Responses are delimited even when empty, so the connection can be reused
+    bool bodyless = (statusCode >= 100 && statusCode < 200) || statusCode == 204 || statusCode == 304;
+    if (!bodyless && !builder.hasFraming()) {
+        builder.contentLength(body.size());
+    }
+    BufferView head = builder.finish();
+    if (head.empty()) {
+        return std::string();
+    }
+    return head.toString() + body;
+}
+
+std::vector<uint8_t> ProtocolHelper::buildWebSocketFrame(const std::vector<uint8_t>& payload, bool mask) {
+    size_t length = payload.size();
+    std::vector<uint8_t> frame;
+    frame.reserve(length + 14);
+    frame.push_back(0x82); // FIN, binary
+
+    uint8_t maskBit = mask ? 0x80 : 0x00;
+    if (length < 126) {
+        frame.push_back(static_cast<uint8_t>(maskBit | length));
+    } else if (length <= 0xFFFF) {
+        frame.push_back(maskBit | 126);
+        frame.push_back(static_cast<uint8_t>(length >> 8));
+        frame.push_back(static_cast<uint8_t>(length));
+    } else {
+        frame.push_back(maskBit | 127);
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            frame.push_back(static_cast<uint8_t>(static_cast<uint64_t>(length) >> shift));
+        }
+    }
+
+    if (!mask) {
+        frame.insert(frame.end(), payload.begin(), payload.end());
+        return frame;
+    }
+
+    uint32_t key = static_cast<uint32_t>(randomEngine()());
+    uint8_t maskKey[4];
+    std::memcpy(maskKey, &key, sizeof(maskKey));
+    frame.insert(frame.end(), maskKey, maskKey + 4);
+
+    size_t offset = frame.size();
+    frame.resize(offset + length);
+    WebSocketFramer::copyMasked(frame.data() + offset, payload.data(), length, maskKey);
+    return frame;
+}
+
+std::vector<uint8_t> ProtocolHelper::parseWebSocketFrame(const std::vector<uint8_t>& data) {
+    // Payload of the first frame, unmasked; empty until the frame is complete
+    if (data.size() < 2) {
+        return {};
+    }
+
+    bool masked = (data[1] & 0x80) != 0;
+    uint64_t length = data[1] & 0x7F;
+    size_t offset = 2;
+    if (length == 126) {
+        if (data.size() < 4) {
+            return {};
+        }
+        length = (static_cast<uint64_t>(data[2]) << 8) | data[3];
+        offset = 4;
+    } else if (length == 127) {
+        if (data.size() < 10) {
+            return {};
+        }
+        length = 0;
+        for (size_t i = 2; i < 10; i++) {
+            length = (length << 8) | data[i];
+        }
+        offset = 10;
+    }
+
+    size_t keyOffset = offset;
+    if (masked) {
+        offset += 4;
+    }
+    if (data.size() < offset || length > data.size() - offset) {
+        return {};
+    }
+
+    std::vector<uint8_t> payload(data.begin() + offset, data.begin() + offset + static_cast<size_t>(length));
+    if (masked) {
+        WebSocketFramer::applyMask(payload.data(), payload.size(), data.data() + keyOffset);
+    }
+    return payload;
+}
+
+std::string ProtocolHelper::escapeJson(const std::string& str) {
+    static const char kHex[] = "0123456789abcdef";
+
+    std::string escaped;
+    escaped.reserve(str.size() + 2);
+    for (char c : str) {
+        switch (c) {
+            case '"': escaped += "\\\""; break;
+            case '\\': escaped += "\\\\"; break;
+            case '\b': escaped += "\\b"; break;
+            case '\f': escaped += "\\f"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\r': escaped += "\\r"; break;
+            case '\t': escaped += "\\t"; break;
+            default:
+                if (static_cast<uint8_t>(c) < 0x20) {
+                    escaped += "\\u00";
+                    escaped += kHex[static_cast<uint8_t>(c) >> 4];
+                    escaped += kHex[c & 0x0F];
+                } else {
+                    escaped += c;
+                }
+                break;
+        }
+    }
+    return escaped;
+}
+
+std::string ProtocolHelper::unescapeJson(const std::string& str) {
+    // \uXXXX escapes (including surrogate pairs) are written as UTF-8
+    auto hexValue = [&str](size_t offset, uint32_t& value) {
+        if (offset + 4 > str.size()) {
+            return false;
+        }
+        value = 0;
+        for (size_t i = offset; i < offset + 4; i++) {
+            char c = str[i];
+            int digit = (c >= '0' && c <= '9') ? c - '0' :
+                        (c >= 'a' && c <= 'f') ? c - 'a' + 10 :
+                        (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+            if (digit < 0) {
+                return false;
+            }
+            value = (value << 4) | static_cast<uint32_t>(digit);
+        }
+        return true;
+    };
+
+    std::string unescaped;
+    unescaped.reserve(str.size());
+    for (size_t i = 0; i < str.size(); i++) {
+        if (str[i] != '\\' || i + 1 == str.size()) {
+            unescaped += str[i];
+            continue;
+        }
+
+        char c = str[++i];
+        switch (c) {
+            case 'b': unescaped += '\b'; break;
+            case 'f': unescaped += '\f'; break;
+            case 'n': unescaped += '\n'; break;
+            case 'r': unescaped += '\r'; break;
+            case 't': unescaped += '\t'; break;
+            case 'u': {
+                uint32_t code;
+                if (!hexValue(i + 1, code)) {
+                    unescaped += "\\u";
+                    break;
+                }
+                i += 4;
+
+                uint32_t low;
+                if (code >= 0xD800 && code <= 0xDBFF && i + 2 < str.size() && str[i + 1] == '\\' &&
+                    str[i + 2] == 'u' && hexValue(i + 3, low) && low >= 0xDC00 && low <= 0xDFFF) {
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    i += 6;
+                }
+
+                if (code < 0x80) {
+                    unescaped += static_cast<char>(code);
+                } else if (code < 0x800) {
+                    unescaped += static_cast<char>(0xC0 | (code >> 6));
+                    unescaped += static_cast<char>(0x80 | (code & 0x3F));
+                } else if (code < 0x10000) {
+                    unescaped += static_cast<char>(0xE0 | (code >> 12));
+                    unescaped += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                    unescaped += static_cast<char>(0x80 | (code & 0x3F));
+                } else {
+                    unescaped += static_cast<char>(0xF0 | (code >> 18));
+                    unescaped += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+                    unescaped += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                    unescaped += static_cast<char>(0x80 | (code & 0x3F));
+                }
+                break;
+            }
+            default: unescaped += c; break; // '"', '\\', '/'
+        }
+    }
+    return unescaped;
+}
+
+std::string ProtocolHelper::base64Encode(const std::vector<uint8_t>& data) {
+    std::string encoded(base64EncodedSize(data.size()), '\0');
+    if (!data.empty()) {
+        base64Encode(ByteView(data), &encoded[0]);
+    }
+    return encoded;
+}
+
+std::vector<uint8_t> ProtocolHelper::base64Decode(const std::string& encoded) {
+    std::vector<uint8_t> decoded(base64DecodedSize(encoded.size()));
+    decoded.resize(base64Decode(ByteView(encoded), decoded.data()));
+    return decoded;
+}
+
+size_t ProtocolHelper::base64Encode(const ByteView& data, char* output) {
+#if defined(TCP_BASE64_AVX2)
+    if (hasAvx2()) {
+        return base64EncodeAvx2(data.data(), data.size(), output);
+    }
+#elif defined(TCP_BASE64_NEON)
+    return base64EncodeNeon(data.data(), data.size(), output);
+#endif
+    return base64EncodeScalar(data.data(), data.size(), output);
+}
+
+size_t ProtocolHelper::base64Decode(const ByteView& encoded, uint8_t* output) {
+#if defined(TCP_BASE64_AVX2)
+    if (hasAvx2()) {
+        return base64DecodeAvx2(encoded.data(), encoded.size(), output);
+    }
+#elif defined(TCP_BASE64_NEON)
+    return base64DecodeNeon(encoded.data(), encoded.size(), output);
+#endif
+    return base64DecodeScalar(encoded.data(), encoded.size(), output);
+}
+
+std::string ProtocolHelper::sha1Hash(const std::vector<uint8_t>& data) {
+    uint8_t digest[kSha1DigestSize];
+    sha1Digest(ByteView(data), digest);
+    return toHex(digest, sizeof(digest));
+}
+
+std::string ProtocolHelper::sha256Hash(const std::vector<uint8_t>& data) {
+    uint8_t digest[kSha256DigestSize];
+    sha256Digest(ByteView(data), digest);
+    return toHex(digest, sizeof(digest));
+}
+
+std::string ProtocolHelper::md5Hash(const std::vector<uint8_t>& data) {
+    uint8_t digest[kMd5DigestSize];
+    md5Digest(ByteView(data), digest);
+    return toHex(digest, sizeof(digest));
+}
+
+#ifdef TCP_SSL_SUPPORT
+// One-shot EVP digests; OpenSSL picks SHA-NI or the ARMv8 crypto
+// extensions itself when the CPU has them
+
+void ProtocolHelper::sha1Digest(const ByteView& data, uint8_t digest[kSha1DigestSize]) {
+    EVP_Digest(data.data(), data.size(), digest, nullptr, EVP_sha1(), nullptr);
+}
+
+void ProtocolHelper::sha256Digest(const ByteView& data, uint8_t digest[kSha256DigestSize]) {
+    EVP_Digest(data.data(), data.size(), digest, nullptr, EVP_sha256(), nullptr);
+}
+
+void ProtocolHelper::md5Digest(const ByteView& data, uint8_t digest[kMd5DigestSize]) {
+    EVP_Digest(data.data(), data.size(), digest, nullptr, EVP_md5(), nullptr);
+}
+#else
+void ProtocolHelper::sha1Digest(const ByteView& data, uint8_t digest[kSha1DigestSize]) {
+    uint32_t state[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    digestBlocks(data.data(), data.size(), true, [&state](const uint8_t* block) { sha1Block(state, block); });
+    for (int i = 0; i < 5; i++) {
+        storeBigEndian32(digest + i * 4, state[i]);
+    }
+}
+
+void ProtocolHelper::sha256Digest(const ByteView& data, uint8_t digest[kSha256DigestSize]) {
+    uint32_t state[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    digestBlocks(data.data(), data.size(), true, [&state](const uint8_t* block) { sha256Block(state, block); });
+    for (int i = 0; i < 8; i++) {
+        storeBigEndian32(digest + i * 4, state[i]);
+    }
+}
+
+void ProtocolHelper::md5Digest(const ByteView& data, uint8_t digest[kMd5DigestSize]) {
+    uint32_t state[4] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476};
+    digestBlocks(data.data(), data.size(), false, [&state](const uint8_t* block) { md5Block(state, block); });
+    for (int i = 0; i < 4; i++) {
+        storeLittleEndian32(digest + i * 4, state[i]);
+    }
+}
+#endif
+
+std::vector<uint8_t> ProtocolHelper::generateRandomBytes(size_t length) {
+    std::vector<uint8_t> bytes(length);
+    std::uniform_int_distribution<int> distribution(0, 255);
+    for (auto& byte : bytes) {
+        byte = static_cast<uint8_t>(distribution(randomEngine()));
+    }
+    return bytes;
+}
+
+std::string ProtocolHelper::generateRandomString(size_t length, const std::string& charset) {
+    if (charset.empty()) {
+        return {};
+    }
+
+    std::string result(length, '\0');
+    std::uniform_int_distribution<size_t> distribution(0, charset.size() - 1);
+    for (auto& c : result) {
+        c = charset[distribution(randomEngine())];
+    }
+    return result;
+}
+
+// Logger implementation
+std::atomic<Logger::Level> Logger::currentLevel_(Logger::Level::Info);
+std::function<void(Logger::Level, const std::string&)> Logger::output_ = nullptr;
+std::FILE* Logger::file_ = nullptr;
+std::mutex Logger::mutex_;
+
+namespace {
+
+// The async writer wakes at least this often to pick up records
+constexpr auto kLogFlushInterval = std::chrono::milliseconds(10);
+
+struct LogRecord {
+    std::chrono::system_clock::time_point time;
+    Logger::Level level = Logger::Level::Info;
+    std::string message;
+};
+
+// Bounded single-producer, single-consumer ring: the owning thread pushes,
+// the writer thread drains
+class LogRing {
+public:
+    LogRing(size_t capacity, uint64_t epoch)
+        : slots_(capacity), mask_(capacity - 1), epoch_(epoch), orphaned_(false), closed_(false),
+          pushing_(false), head_(0), tail_(0) {}
+
+    uint64_t getEpoch() const { return epoch_; }
+    size_t getCapacity() const { return slots_.size(); }
+
+    // Producer side. Moves the record only when there is room and the ring
+    // is still open.
+    bool push(LogRecord& record, size_t& size) {
+        // Sequentially consistent against close(): either it sees this push
+        // in progress and waits for it, or this sees the ring closed
+        pushing_.store(true);
+        bool pushed = false;
+        if (!closed_.load()) {
+            size_t head = head_.load(std::memory_order_relaxed);
+            size_t tail = tail_.load(std::memory_order_acquire);
+            if (head - tail < slots_.size()) {
+                slots_[head & mask_] = std::move(record);
+                head_.store(head + 1, std::memory_order_release);
+                size = head + 1 - tail;
+                pushed = true;
+            }
+        }
+        pushing_.store(false, std::memory_order_release);
+        return pushed;
+    }
+
+    // Once nothing drains the ring again: later pushes fail, and one in
+    // progress lands first so a last drain() picks it up
+    void close() {
+        closed_.store(true);
+        while (pushing_.load()) {
+            std::this_thread::yield();
+        }
+    }
+    bool isClosed() const { return closed_.load(std::memory_order_acquire); }
+
+    // Consumer side
+    void drain(std::vector<LogRecord>& records) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t head = head_.load(std::memory_order_acquire);
+        for (; tail != head; tail++) {
+            records.push_back(std::move(slots_[tail & mask_]));
+        }
+        tail_.store(tail, std::memory_order_release);
+    }
+
+    // Set by the producer after its last push, when its thread exits
+    void orphan() { orphaned_.store(true, std::memory_order_release); }
+    bool isOrphaned() const { return orphaned_.load(std::memory_order_acquire); }
+
+private:
+    std::vector<LogRecord> slots_;
+    size_t mask_;
+    uint64_t epoch_;
+    std::atomic<bool> orphaned_;
+    std::atomic<bool> closed_;
+    std::atomic<bool> pushing_;
+    alignas(64) std::atomic<size_t> head_;
+    alignas(64) std::atomic<size_t> tail_;
+};
+
+// Owner of the calling thread's ring; the writer frees it once drained
+struct ThreadLogRing {
+    std::shared_ptr<LogRing> ring;
+    ~ThreadLogRing() {
+        if (ring) {
+            ring->orphan();
+        }
+    }
+};
+
+// "YYYY-MM-DD HH:MM:SS", reformatted only when the second changes
+void appendTimestamp(std::string& out, std::chrono::system_clock::time_point time) {
+    thread_local std::time_t cachedSecond = -1;
+    thread_local char cached[32];
+    
+    std::time_t second = std::chrono::system_clock::to_time_t(time);
+    if (second != cachedSecond) {
+        std::tm local;
+#ifdef _WIN32
+        localtime_s(&local, &second);
+#else
+        localtime_r(&second, &local);
+#endif
+        std::strftime(cached, sizeof(cached), "%Y-%m-%d %H:%M:%S", &local);
+        cachedSecond = second;
+    }
+    out += cached;
+}
+
+void appendLine(std::string& out, std::chrono::system_clock::time_point time,
+                const std::string& level, const std::string& message) {
+    appendTimestamp(out, time);
+    out += " [";
+    out += level;
+    out += "] ";
+    out += message;
+}
+
+} // namespace
+
+// Background writer behind Logger::startAsync(). Never destroyed: threads
+// may still log while static objects are torn down.
+class Logger::AsyncWriter {
+public:
+    static AsyncWriter& instance() {
+        static AsyncWriter* writer = new AsyncWriter();
+        return *writer;
+    }
+    
+    bool isRunning() const { return running_.load(std::memory_order_acquire); }
+    size_t getDropped() const { return dropped_.load(std::memory_order_relaxed); }
+    
+    bool start(size_t ringCapacity, OverflowPolicy policy) {
+        std::lock_guard<std::mutex> lifecycle(lifecycleMutex_);
+        if (isRunning()) {
+            return false;
+        }
+        
+        size_t capacity = 2;
+        while (capacity < ringCapacity) {
+            capacity <<= 1;
+        }
+        
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            capacity_ = capacity;
+            stopping_ = false;
+            wakeRequested_ = false;
+            epoch_++;
+            policy_ = policy;
+            running_.store(true, std::memory_order_release);
+        }
+        thread_ = std::thread(&AsyncWriter::run, this);
+        
+        static bool exitHandlerInstalled = false;
+        if (!exitHandlerInstalled) {
+            exitHandlerInstalled = true;
+            std::atexit([]() { Logger::stopAsync(); });
+        }
+        return true;
+    }
+    
+    void stop() {
+        std::lock_guard<std::mutex> lifecycle(lifecycleMutex_);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!isRunning()) {
+                return;
+            }
+            running_.store(false, std::memory_order_release);
+            stopping_ = true;
+        }
+        wake_.notify_one();
+        thread_.join();
+        
+        // Records pushed while the writer made its last pass. Closed first,
+        // so a producer that raced stop() writes its record itself.
+        std::vector<LogRecord> batch;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto& ring : rings_) {
+                ring->close();
+            }
+            drainRings(batch);
+            rings_.clear();
+        }
+        writeBatch(batch);
+    }
+    
+    // False when async logging is off; the caller then writes the message
+    bool enqueue(Level level, std::string& message) {
+        if (!isRunning()) {
+            return false;
+        }
+        std::shared_ptr<LogRing> ring = ringForThread();
+        if (!ring) {
+            return false;
+        }
+        
+        LogRecord record;
+        record.time = std::chrono::system_clock::now();
+        record.level = level;
+        record.message = std::move(message);
+        
+        size_t size = 0;
+        if (ring->push(record, size)) {
+            // Half full: don't wait for the next interval
+            if (size == ring->getCapacity() / 2) {
+                wake();
+            }
+            return true;
+        }
+        
+        // Closed by stopAsync() after this thread looked: not ours to drop
+        if (ring->isClosed()) {
+            message = std::move(record.message);
+            return false;
+        }
+        
+        // The writer can't make room for itself
+        if (policy_ == OverflowPolicy::Drop || std::this_thread::get_id() == writerId_) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        
+        while (!ring->isClosed()) {
+            wake();
+            std::this_thread::yield();
+            if (ring->push(record, size)) {
+                return true;
+            }
+        }
+        message = std::move(record.message);
+        return false;
+    }
+    
+    void flush() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!isRunning() || std::this_thread::get_id() == writerId_) {
+            return;
+        }
+        
+        // The pass in progress may have missed records; the next one can't
+        uint64_t target = passes_ + 2;
+        wakeRequested_ = true;
+        wake_.notify_one();
+        passed_.wait(lock, [this, target]() { return passes_ >= target || !isRunning(); });
+    }
+
+private:
+    std::mutex lifecycleMutex_; // Serializes start() and stop()
+    std::mutex mutex_;          // Guards everything below except the atomics
+    std::condition_variable wake_;
+    std::condition_variable passed_;
+    std::vector<std::shared_ptr<LogRing>> rings_;
+    std::thread thread_;
+    std::atomic<std::thread::id> writerId_;
+    std::atomic<bool> running_{false};
+    std::atomic<OverflowPolicy> policy_{OverflowPolicy::Drop};
+    std::atomic<uint64_t> epoch_{0};
+    std::atomic<size_t> dropped_{0};
+    size_t capacity_ = 0;
+    size_t reportedDrops_ = 0;
+    uint64_t passes_ = 0;
+    bool stopping_ = false;
+    bool wakeRequested_ = false;
+    
+    AsyncWriter() = default;
+    
+    std::shared_ptr<LogRing> ringForThread() {
+        thread_local ThreadLogRing local;
+        
+        // A ring from before a stopAsync()/startAsync() cycle is no longer drained
+        uint64_t epoch = epoch_.load(std::memory_order_acquire);
+        if (!local.ring || local.ring->getEpoch() != epoch) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!isRunning()) {
+                return nullptr;
+            }
+            if (local.ring) {
+                local.ring->orphan();
+            }
+            local.ring = std::make_shared<LogRing>(capacity_, epoch_.load(std::memory_order_relaxed));
+            rings_.push_back(local.ring);
+        }
+        return local.ring;
+    }
+    
+    void wake() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            wakeRequested_ = true;
+        }
+        wake_.notify_one();
+    }
+    
+    void run() {
+        writerId_ = std::this_thread::get_id();
+        std::vector<LogRecord> batch;
+        std::unique_lock<std::mutex> lock(mutex_);
+        
+        while (true) {
+            bool stopping = stopping_;
+            wakeRequested_ = false;
+            drainRings(batch);
+            
+            lock.unlock();
+            writeBatch(batch);
+            batch.clear();
+            lock.lock();
+            
+            passes_++;
+            passed_.notify_all();
+            if (stopping) {
+                break;
+            }
+            wake_.wait_for(lock, kLogFlushInterval, [this]() { return wakeRequested_ || stopping_; });
+        }
+        writerId_ = std::thread::id();
+    }
+    
+    void drainRings(std::vector<LogRecord>& batch) {
+        // mutex_ held. A ring seen orphaned has had its last push.
+        for (size_t i = 0; i < rings_.size();) {
+            bool orphaned = rings_[i]->isOrphaned();
+            rings_[i]->drain(batch);
+            if (orphaned) {
+                rings_[i] = rings_.back();
+                rings_.pop_back();
+            } else {
+                i++;
+            }
+        }
+    }
+    
+    void writeBatch(std::vector<LogRecord>& batch) {
+        // One consumer at a time: the writer thread, or stop() after joining it
+        size_t dropped = getDropped();
+        if (dropped != reportedDrops_) {
+            LogRecord notice;
+            notice.time = std::chrono::system_clock::now();
+            notice.level = Level::Warning;
+            notice.message = "Logger dropped " + std::to_string(dropped - reportedDrops_) + " records (ring full)";
+            batch.push_back(std::move(notice));
+            reportedDrops_ = dropped;
+        }
+        if (batch.empty()) {
+            return;
+        }
+        
+        // Rings are drained one after another; restore the global order
+        std::stable_sort(batch.begin(), batch.end(), [](const LogRecord& a, const LogRecord& b) {
+            return a.time < b.time;
+        });
+        
+        std::lock_guard<std::mutex> lock(Logger::mutex_);
+        if (Logger::output_) {
+            std::string line;
+            for (const LogRecord& record : batch) {
+                line.clear();
+                appendLine(line, record.time, levelToString(record.level), record.message);
+                Logger::output_(record.level, line);
+            }
+            return;
+        }
+        
+        std::string text;
+        for (const LogRecord& record : batch) {
+            appendLine(text, record.time, levelToString(record.level), record.message);
+            text += '\n';
+        }
+        std::FILE* out = Logger::file_ ? Logger::file_ : stdout;
+        std::fwrite(text.data(), 1, text.size(), out);
+        std::fflush(out);
+    }
+};
+
+void Logger::setLevel(Level level) {
+    currentLevel_.store(level, std::memory_order_relaxed);
+}
+
+Logger::Level Logger::getLevel() {
+    return currentLevel_.load(std::memory_order_relaxed);
+}
+
+void Logger::setOutput(std::function<void(Level, const std::string&)> output) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    output_ = output;
+}
+
+bool Logger::setOutputFile(const std::string& path) {
+    std::FILE* file = nullptr;
+    if (!path.empty()) {
+        file = std::fopen(path.c_str(), "a");
+        if (!file) {
+            return false;
+        }
+    }
+    
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (file_) {
+        std::fclose(file_);
+    }
+    file_ = file;
+    return true;
+}
+
+bool Logger::startAsync(size_t ringCapacity, OverflowPolicy policy) {
+    return AsyncWriter::instance().start(ringCapacity, policy);
+}
+
+void Logger::stopAsync() {
+    AsyncWriter::instance().stop();
+}
+
+bool Logger::isAsync() {
+    return AsyncWriter::instance().isRunning();
+}
+
+void Logger::flush() {
+    AsyncWriter::instance().flush();
+    
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::fflush(file_ ? file_ : stdout);
+}
+
+size_t Logger::getDroppedCount() {
+    return AsyncWriter::instance().getDropped();
+}
+
+void Logger::debug(std::string_view message) {
+    if (isEnabled(Level::Debug)) {
+        log(Level::Debug, std::string(message));
+    }
+}
+
+void Logger::info(std::string_view message) {
+    if (isEnabled(Level::Info)) {
+        log(Level::Info, std::string(message));
+    }
+}
+
+void Logger::warning(std::string_view message) {
+    if (isEnabled(Level::Warning)) {
+        log(Level::Warning, std::string(message));
+    }
+}
+
+void Logger::error(std::string_view message) {
+    if (isEnabled(Level::Error)) {
+        log(Level::Error, std::string(message));
+    }
+}
+
+void Logger::critical(std::string_view message) {
+    if (isEnabled(Level::Critical)) {
+        log(Level::Critical, std::string(message));
+    }
+}
+
+void Logger::log(Level level, std::string message) {
+    if (!isEnabled(level)) {
+        return;
+    }
+    
+    AsyncWriter& writer = AsyncWriter::instance();
+    if (writer.isRunning() && writer.enqueue(level, message)) {
+        return;
+    }
+    write(level, formatMessage(level, message));
+}
+
+void Logger::write(Level level, const std::string& line) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    
+    if (output_) {
+        output_(level, line);
+    } else if (file_) {
+        std::fwrite(line.data(), 1, line.size(), file_);
+        std::fputc('\n', file_);
+        std::fflush(file_);
+    } else {
+        std::cout << line << std::endl;
+    }
+}
+
+std::string Logger::formatMessage(Level level, const std::string& message) {
+    std::string line;
+    line.reserve(message.size() + 32);
+    appendLine(line, std::chrono::system_clock::now(), levelToString(level), message);
+    return line;
 }
 
 std::string Logger::levelToString(Level level) {
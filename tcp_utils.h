@@ -8,6 +8,14 @@
 #include <atomic>
 #include <mutex>
 #include <condition_variable>
+#include <cstdio>
+#include <sstream>
+#include <string_view>
+#include <type_traits>
+
+#include "tcp_buffer.h"
+#include "ring_buffer.h"
+#include "rate_limiter.h"
 
 namespace tcp {
 
@@ -17,14 +25,28 @@ class TcpConnection;
 // Message framing for protocols
 class MessageFramer {
 public:
+    // Views are only valid for the duration of the callback
+    using FrameCallback = std::function<void(const ByteView& frame)>;
+    // Views may be retained; frames inside the input share its block
+    using BufferFrameCallback = std::function<void(const BufferView& frame)>;
+
     virtual ~MessageFramer() = default;
     virtual std::vector<uint8_t> frame(const std::vector<uint8_t>& data) = 0;
     virtual std::vector<std::vector<uint8_t>> unframe(const std::vector<uint8_t>& data) = 0;
     virtual bool isComplete(const std::vector<uint8_t>& data) = 0;
     virtual void reset() = 0;
+
+    // Batched I/O (sendBatch() and receive batching). The defaults go
+    // through frame() and unframe() with copies; the library's framers
+    // append in place and decode into slices of the input block.
+    virtual void appendFrame(const ByteView& message, std::vector<uint8_t>& out);
+    virtual size_t decodeFrames(const BufferView& data, const BufferFrameCallback& onFrame);
+    // Every message framed, back to back, replacing out's contents
+    void frameBatch(const ByteView* messages, size_t count, std::vector<uint8_t>& out);
 };
 
-// Length-prefixed message framer
+// Length-prefixed message framer. Complete frames are parsed in place from
+// each read; only a trailing partial frame is buffered between reads.
 class LengthPrefixedFramer : public MessageFramer {
 public:
     enum class LengthType {
@@ -34,26 +56,43 @@ public:
         UInt64
     };
 
+    static constexpr size_t kDefaultMaxFrameSize = 16 * 1024 * 1024;
+
     LengthPrefixedFramer(LengthType lengthType = LengthType::UInt32, bool bigEndian = true);
     
     std::vector<uint8_t> frame(const std::vector<uint8_t>& data) override;
     std::vector<std::vector<uint8_t>> unframe(const std::vector<uint8_t>& data) override;
     bool isComplete(const std::vector<uint8_t>& data) override;
     void reset() override;
+    void appendFrame(const ByteView& message, std::vector<uint8_t>& out) override;
+    size_t decodeFrames(const BufferView& data, const BufferFrameCallback& onFrame) override;
+    
+    // Zero-copy decoding; returns the number of frames delivered
+    size_t unframe(const ByteView& data, const FrameCallback& onFrame);
+    size_t unframe(const BufferView& data, const BufferFrameCallback& onFrame);
+    
+    // A header announcing more than this fails the stream until reset()
+    void setMaxFrameSize(size_t maxFrameSize) { maxFrameSize_ = maxFrameSize; }
+    size_t getMaxFrameSize() const { return maxFrameSize_; }
+    bool hasError() const { return error_; }
 
 private:
     LengthType lengthType_;
     bool bigEndian_;
-    std::vector<uint8_t> buffer_;
-    size_t expectedLength_;
-    bool lengthReceived_;
+    std::vector<uint8_t> buffer_; // Partial frame carried over from earlier reads
+    size_t maxFrameSize_;
+    bool error_;
     
     size_t getLengthSize() const;
     void writeLength(std::vector<uint8_t>& data, size_t length) const;
-    size_t readLength(const std::vector<uint8_t>& data, size_t offset) const;
+    size_t readLength(const uint8_t* data) const;
+    
+    template <typename Emit>
+    size_t parse(ByteView input, Emit&& emit);
 };
 
-// Delimiter-based message framer
+// Delimiter-based message framer. Single-byte and "\r\n" delimiters get
+// dedicated vectorized scanners; bytes are never scanned twice.
 class DelimiterFramer : public MessageFramer {
 public:
     DelimiterFramer(const std::vector<uint8_t>& delimiter, bool includeDelimiter = false);
@@ -63,78 +102,43 @@ public:
     std::vector<std::vector<uint8_t>> unframe(const std::vector<uint8_t>& data) override;
     bool isComplete(const std::vector<uint8_t>& data) override;
     void reset() override;
+    void appendFrame(const ByteView& message, std::vector<uint8_t>& out) override;
+    size_t decodeFrames(const BufferView& data, const BufferFrameCallback& onFrame) override;
+    
+    // Zero-copy decoding; returns the number of messages delivered
+    size_t unframe(const ByteView& data, const FrameCallback& onFrame);
+    size_t unframe(const BufferView& data, const BufferFrameCallback& onFrame);
 
 private:
+    enum class DelimiterKind {
+        SingleByte,
+        CrLf,
+        Generic
+    };
+
     std::vector<uint8_t> delimiter_;
     bool includeDelimiter_;
-    std::vector<uint8_t> buffer_;
+    DelimiterKind kind_;
+    std::vector<uint8_t> buffer_; // Undelimited bytes carried over from earlier reads
     
-    size_t findDelimiter(const std::vector<uint8_t>& data, size_t startPos = 0) const;
-};
-
-// Connection pool for managing multiple connections
-class ConnectionPool {
-public:
-    ConnectionPool(size_t maxConnections = 10);
-    ~ConnectionPool();
-
-    // Pool management
-    std::shared_ptr<TcpConnection> acquire();
-    void release(std::shared_ptr<TcpConnection> connection);
-    void clear();
-    
-    // Configuration
-    void setMaxConnections(size_t maxConnections);
-    size_t getMaxConnections() const { return maxConnections_; }
-    size_t getActiveConnections() const;
-    size_t getIdleConnections() const;
-
-    // Connection factory
-    void setConnectionFactory(std::function<std::shared_ptr<TcpConnection>()> factory);
-
-private:
-    size_t maxConnections_;
-    std::vector<std::shared_ptr<TcpConnection>> idleConnections_;
-    std::vector<std::shared_ptr<TcpConnection>> activeConnections_;
-    std::function<std::shared_ptr<TcpConnection>()> connectionFactory_;
-    mutable std::mutex mutex_;
-    std::condition_variable condition_;
-};
-
-// Rate limiter for controlling data flow
-class RateLimiter {
-public:
-    RateLimiter(size_t bytesPerSecond, size_t bucketSize = 0);
-    
-    // Rate limiting
-    bool allowBytes(size_t bytes);
-    std::chrono::milliseconds getDelay(size_t bytes) const;
-    void waitForBytes(size_t bytes);
-    
-    // Configuration
-    void setRate(size_t bytesPerSecond);
-    size_t getRate() const { return bytesPerSecond_; }
-    void setBucketSize(size_t bucketSize);
-    size_t getBucketSize() const { return bucketSize_; }
-    
-    // Statistics
-    size_t getAvailableBytes() const;
-    double getUtilization() const;
-    void reset();
-
-private:
-    size_t bytesPerSecond_;
-    size_t bucketSize_;
-    std::atomic<size_t> availableBytes_;
-    std::chrono::steady_clock::time_point lastRefill_;
-    mutable std::mutex mutex_;
+    size_t findDelimiter(const uint8_t* data, size_t size) const;
+    size_t findStraddling(const ByteView& input) const;
     
-    void refillBucket();
+    template <typename Emit>
+    size_t dispatch(const ByteView& input, Emit&& emit);
+    template <typename Matcher, typename Emit>
+    size_t parse(const Matcher& matcher, ByteView input, Emit&& emit);
 };
 
 // Buffer management utilities
 class BufferManager {
 public:
+    // Pooled, reference-counted buffers (BufferPool::shared())
+    static Buffer acquire(size_t size);
+    static BufferPool& getPool() { return BufferPool::shared(); }
+    static BufferPool::Statistics getPoolStatistics() { return BufferPool::shared().getStatistics(); }
+    
+    // Vector buffers; deallocated vectors are kept per thread for reuse
     static std::vector<uint8_t> allocateBuffer(size_t size);
     static void deallocateBuffer(std::vector<uint8_t>& buffer);
     static std::vector<uint8_t> resizeBuffer(std::vector<uint8_t>& buffer, size_t newSize);
@@ -142,7 +146,13 @@ public:
     static std::vector<uint8_t> concatenateBuffers(const std::vector<std::vector<uint8_t>>& buffers);
     static std::vector<std::vector<uint8_t>> splitBuffer(const std::vector<uint8_t>& buffer, size_t chunkSize);
     
-    // Circular buffer
+    // Circular buffer, safe for any number of threads. One producer and
+    // one consumer are better served by the lock-free SpscCircularBuffer,
+    // several producers by MpscCircularBuffer; both can mirror their
+    // memory so readable() never splits at the wrap.
+    using SpscCircularBuffer = SpscRingBuffer;
+    using MpscCircularBuffer = MpscRingBuffer;
+    
     class CircularBuffer {
     public:
         CircularBuffer(size_t capacity);
@@ -166,6 +176,8 @@ public:
         size_t head_;
         size_t tail_;
         mutable std::mutex mutex_;
+        
+        size_t copyOut(void* data, size_t length) const; // mutex_ held
     };
 };
 
@@ -243,25 +255,41 @@ public:
     static std::string unescapeJson(const std::string& str);
     static bool isValidJson(const std::string& json);
     
-    // Base64 utilities
+    // Base64 utilities. Decoding stops at padding or the first byte outside
+    // the alphabet. The pointer forms write into caller storage, at least
+    // base64EncodedSize() / base64DecodedSize() bytes, and return the bytes
+    // written; AVX2 (picked at run time) or NEON do the bulk when available.
     static std::string base64Encode(const std::vector<uint8_t>& data);
     static std::vector<uint8_t> base64Decode(const std::string& encoded);
+    static size_t base64Encode(const ByteView& data, char* output);
+    static size_t base64Decode(const ByteView& encoded, uint8_t* output);
+    static size_t base64EncodedSize(size_t length) { return (length + 2) / 3 * 4; }
+    static size_t base64DecodedSize(size_t length) { return length / 4 * 3 + (length % 4) * 3 / 4; }
     
     // URL utilities
     static std::string urlEncode(const std::string& str);
     static std::string urlDecode(const std::string& str);
     
-    // Hash utilities
+    // Hash utilities: lowercase hex, or the raw digest into caller storage.
+    // OpenSSL's EVP digests with TCP_SSL_SUPPORT, portable code without.
+    static constexpr size_t kSha1DigestSize = 20;
+    static constexpr size_t kSha256DigestSize = 32;
+    static constexpr size_t kMd5DigestSize = 16;
     static std::string sha1Hash(const std::vector<uint8_t>& data);
     static std::string sha256Hash(const std::vector<uint8_t>& data);
     static std::string md5Hash(const std::vector<uint8_t>& data);
+    static void sha1Digest(const ByteView& data, uint8_t digest[kSha1DigestSize]);
+    static void sha256Digest(const ByteView& data, uint8_t digest[kSha256DigestSize]);
+    static void md5Digest(const ByteView& data, uint8_t digest[kMd5DigestSize]);
     
     // Random utilities
     static std::vector<uint8_t> generateRandomBytes(size_t length);
     static std::string generateRandomString(size_t length, const std::string& charset = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789");
 };
 
-// Logging utilities
+// Logging utilities. Levels are checked before anything is allocated or
+// formatted, so filtered calls cost one relaxed load. Formatted calls replace each "{}" in the
+// format with the next argument.
 class Logger {
 public:
     enum class Level {
@@ -272,42 +300,142 @@ public:
         Critical
     };
     
+    // What an async producer does when its ring is full
+    enum class OverflowPolicy {
+        Drop,  // Discard the record; getDroppedCount() and a warning report it
+        Block  // Wait for the writer to make room
+    };
+    
     static void setLevel(Level level);
     static Level getLevel();
+    static bool isEnabled(Level level) {
+        return static_cast<int>(level) >= static_cast<int>(currentLevel_.load(std::memory_order_relaxed));
+    }
     static void setOutput(std::function<void(Level, const std::string&)> output);
-    
-    static void debug(const std::string& message);
-    static void info(const std::string& message);
-    static void warning(const std::string& message);
-    static void error(const std::string& message);
-    static void critical(const std::string& message);
+    static bool setOutputFile(const std::string& path); // Appends; empty path restores stdout
+    
+    // Asynchronous mode: each thread logs into its own lock-free ring and a
+    // background thread formats and writes the records in batches. Outputs
+    // set with setOutput() are then called on that thread. stopAsync()
+    // writes everything logged before it returns.
+    static bool startAsync(size_t ringCapacity = 4096, OverflowPolicy policy = OverflowPolicy::Drop);
+    static void stopAsync();
+    static bool isAsync();
+    static void flush(); // Returns once records logged so far are written
+    static size_t getDroppedCount();
+    
+    static void debug(std::string_view message);
+    static void info(std::string_view message);
+    static void warning(std::string_view message);
+    static void error(std::string_view message);
+    static void critical(std::string_view message);
     
     template<typename... Args>
-    static void debug(const std::string& format, Args&&... args);
+    static void debug(std::string_view format, Args&&... args);
     
     template<typename... Args>
-    static void info(const std::string& format, Args&&... args);
+    static void info(std::string_view format, Args&&... args);
     
     template<typename... Args>
-    static void warning(const std::string& format, Args&&... args);
+    static void warning(std::string_view format, Args&&... args);
     
     template<typename... Args>
-    static void error(const std::string& format, Args&&... args);
+    static void error(std::string_view format, Args&&... args);
     
     template<typename... Args>
-    static void critical(const std::string& format, Args&&... args);
+    static void critical(std::string_view format, Args&&... args);
 
 private:
-    static Level currentLevel_;
+    static std::atomic<Level> currentLevel_;
     static std::function<void(Level, const std::string&)> output_;
-    static std::mutex mutex_;
+    static std::FILE* file_;
+    static std::mutex mutex_; // Guards output_ and file_
     
-    static void log(Level level, const std::string& message);
+    static void log(Level level, std::string message);
+    static void write(Level level, const std::string& line);
     static std::string formatMessage(Level level, const std::string& message);
     static std::string levelToString(Level level);
     
+    class AsyncWriter; // Per-thread rings and the writer thread (tcp_utils.cpp)
+    
     template<typename... Args>
-    static std::string format(const std::string& format, Args&&... args);
+    static std::string format(std::string_view format, Args&&... args);
+    
+    template<typename T>
+    static void appendArgument(std::string& out, std::string_view format, size_t& position, const T& value);
 };
 
+template<typename... Args>
+void Logger::debug(std::string_view format, Args&&... args) {
+    if (isEnabled(Level::Debug)) {
+        log(Level::Debug, Logger::format(format, std::forward<Args>(args)...));
+    }
+}
+
+template<typename... Args>
+void Logger::info(std::string_view format, Args&&... args) {
+    if (isEnabled(Level::Info)) {
+        log(Level::Info, Logger::format(format, std::forward<Args>(args)...));
+    }
+}
+
+template<typename... Args>
+void Logger::warning(std::string_view format, Args&&... args) {
+    if (isEnabled(Level::Warning)) {
+        log(Level::Warning, Logger::format(format, std::forward<Args>(args)...));
+    }
+}
+
+template<typename... Args>
+void Logger::error(std::string_view format, Args&&... args) {
+    if (isEnabled(Level::Error)) {
+        log(Level::Error, Logger::format(format, std::forward<Args>(args)...));
+    }
+}
+
+template<typename... Args>
+void Logger::critical(std::string_view format, Args&&... args) {
+    if (isEnabled(Level::Critical)) {
+        log(Level::Critical, Logger::format(format, std::forward<Args>(args)...));
+    }
+}
+
+template<typename... Args>
+std::string Logger::format(std::string_view format, Args&&... args) {
+    std::string out;
+    out.reserve(format.size() + 16 * sizeof...(Args));
+    size_t position = 0;
+    (appendArgument(out, format, position, args), ...);
+    out += format.substr(position);
+    return out;
+}
+
+template<typename T>
+void Logger::appendArgument(std::string& out, std::string_view format, size_t& position, const T& value) {
+    // Arguments without a placeholder left are appended after a space
+    size_t placeholder = format.find("{}", position);
+    if (placeholder == std::string_view::npos) {
+        out += format.substr(position);
+        out += ' ';
+        position = format.size();
+    } else {
+        out += format.substr(position, placeholder - position);
+        position = placeholder + 2;
+    }
+    
+    if constexpr (std::is_same<T, bool>::value) {
+        out += value ? "true" : "false";
+    } else if constexpr (std::is_same<T, char>::value) {
+        out += value;
+    } else if constexpr (std::is_integral<T>::value) {
+        out += std::to_string(value);
+    } else if constexpr (std::is_convertible<const T&, std::string_view>::value) {
+        out += std::string_view(value);
+    } else {
+        std::ostringstream stream;
+        stream << value;
+        out += stream.str();
+    }
+}
+
 } // namespace tcp
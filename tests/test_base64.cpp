@@ -0,0 +1,120 @@
+#include "test_support.h"
+#include <random>
+
+// Base64 against a byte-at-a-time reference at every length through
+// several SIMD blocks, so the vector loops and the scalar tail they hand
+// off to are both covered, plus the RFC 4648 vectors and decoding that
+// stops early.
+
+namespace {
+
+using tcp::ByteView;
+using tcp::ProtocolHelper;
+
+const char kAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+std::string referenceEncode(const std::vector<uint8_t>& data) {
+    std::string out;
+    size_t i = 0;
+    for (; i + 3 <= data.size(); i += 3) {
+        uint32_t group = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
+        for (int shift = 18; shift >= 0; shift -= 6) {
+            out += kAlphabet[(group >> shift) & 63];
+        }
+    }
+    if (data.size() - i == 1) {
+        uint32_t group = data[i] << 16;
+        out += kAlphabet[(group >> 18) & 63];
+        out += kAlphabet[(group >> 12) & 63];
+        out += "==";
+    } else if (data.size() - i == 2) {
+        uint32_t group = (data[i] << 16) | (data[i + 1] << 8);
+        out += kAlphabet[(group >> 18) & 63];
+        out += kAlphabet[(group >> 12) & 63];
+        out += kAlphabet[(group >> 6) & 63];
+        out += '=';
+    }
+    return out;
+}
+
+std::vector<uint8_t> randomBytes(std::mt19937& random, size_t length) {
+    std::vector<uint8_t> data(length);
+    for (uint8_t& byte : data) {
+        byte = static_cast<uint8_t>(random());
+    }
+    return data;
+}
+
+} // namespace
+
+TEST(rfc4648_vectors) {
+    const std::pair<std::string, std::string> vectors[] = {
+        {"", ""}, {"f", "Zg=="}, {"fo", "Zm8="}, {"foo", "Zm9v"},
+        {"foob", "Zm9vYg=="}, {"fooba", "Zm9vYmE="}, {"foobar", "Zm9vYmFy"},
+    };
+    for (const auto& vector : vectors) {
+        CHECK_EQ(ProtocolHelper::base64Encode(tcp_test::bytes(vector.first)), vector.second);
+        CHECK(ProtocolHelper::base64Decode(vector.second) == tcp_test::bytes(vector.first));
+    }
+}
+
+TEST(encode_and_decode_match_reference_at_every_length) {
+    std::mt19937 random(7);
+    for (size_t length = 0; length <= 400; length++) {
+        std::vector<uint8_t> data = randomBytes(random, length);
+        std::string expected = referenceEncode(data);
+        
+        // Pointer form writes exactly base64EncodedSize() bytes
+        std::string encoded(ProtocolHelper::base64EncodedSize(length) + 1, '#');
+        size_t written = ProtocolHelper::base64Encode(ByteView(data), &encoded[0]);
+        CHECK_EQ(written, expected.size());
+        CHECK_EQ(encoded.substr(0, written), expected);
+        CHECK_EQ(encoded[written], '#');
+        
+        std::vector<uint8_t> decoded(ProtocolHelper::base64DecodedSize(expected.size()) + 1, 0xEE);
+        size_t decodedSize = ProtocolHelper::base64Decode(ByteView(expected), decoded.data());
+        CHECK_EQ(decodedSize, length);
+        CHECK(std::equal(data.begin(), data.end(), decoded.begin()));
+        CHECK(ProtocolHelper::base64Decode(expected) == data);
+    }
+}
+
+TEST(decoding_stops_at_the_first_byte_outside_the_alphabet) {
+    // The bad byte lands inside and outside vector blocks
+    std::mt19937 random(11);
+    std::vector<uint8_t> data = randomBytes(random, 300);
+    std::string encoded = referenceEncode(data);
+    for (size_t position : {0, 4, 8, 31, 32, 36, 100, 128, 396}) {
+        for (char bad : {'*', '\n', ' ', '\x80'}) {
+            std::string corrupted = encoded;
+            corrupted[position] = bad;
+            std::vector<uint8_t> decoded = ProtocolHelper::base64Decode(corrupted);
+            
+            // Only the whole quanta before the bad byte are decoded
+            size_t expectedSize = position / 4 * 3;
+            CHECK(decoded.size() >= expectedSize && decoded.size() < expectedSize + 3);
+            CHECK(std::equal(data.begin(), data.begin() + expectedSize, decoded.begin()));
+        }
+    }
+}
+
+TEST(unpadded_input_decodes) {
+    CHECK(ProtocolHelper::base64Decode("Zm9vYg") == tcp_test::bytes("foob"));
+    CHECK(ProtocolHelper::base64Decode("Zm9vYmE") == tcp_test::bytes("fooba"));
+}
+
+TEST(digest_vectors) {
+    CHECK_EQ(ProtocolHelper::sha1Hash(tcp_test::bytes("abc")), "a9993e364706816aba3e25717850c26c9cd0d89d");
+    CHECK_EQ(ProtocolHelper::sha256Hash(tcp_test::bytes("abc")),
+             "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    CHECK_EQ(ProtocolHelper::md5Hash(tcp_test::bytes("abc")), "900150983cd24fb0d6963f7d28e17f72");
+    
+    // The WebSocket accept key (RFC 6455 section 1.3)
+    uint8_t digest[ProtocolHelper::kSha1DigestSize];
+    std::string key = "dGhlIHNhbXBsZSBub25jZQ==258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    ProtocolHelper::sha1Digest(ByteView(key), digest);
+    CHECK_EQ(ProtocolHelper::base64Encode(std::vector<uint8_t>(digest, digest + sizeof(digest))),
+             "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=");
+}
+
+TEST_MAIN()
@@ -0,0 +1,132 @@
+#include "test_support.h"
+#include <thread>
+
+// BufferPool: size classes, statistics summed across threads, blocks
+// released on other threads, and buffers that outlive their pool.
+
+namespace {
+
+using tcp::Buffer;
+using tcp::BufferPool;
+
+} // namespace
+
+TEST(requests_round_up_to_a_size_class) {
+    BufferPool pool(65536);
+    CHECK_EQ(pool.getMaxBlockSize(), 65536u);
+    CHECK_EQ(pool.acquire(1).capacity(), 256u);
+    CHECK_EQ(pool.acquire(300).capacity(), 512u);
+    CHECK_EQ(pool.acquire().capacity(), 65536u);
+
+    // Too large to pool: allocated exactly
+    Buffer large = pool.acquire(100000);
+    CHECK_EQ(large.capacity(), 100000u);
+    CHECK_EQ(large.size(), 0u);
+}
+
+TEST(statistics_track_hits_misses_and_outstanding_bytes) {
+    BufferPool pool(4096, 64 * 1024);
+    {
+        Buffer first = pool.acquire(4096);
+        BufferPool::Statistics stats = pool.getStatistics();
+        CHECK_EQ(stats.misses, 1u);
+        CHECK_EQ(stats.bytesOutstanding, 4096u);
+        CHECK_EQ(stats.bytesReserved, 64u * 1024);
+
+        Buffer second = pool.acquire(4096);
+        stats = pool.getStatistics();
+        CHECK_EQ(stats.hits, 1u);
+        CHECK_EQ(stats.bytesOutstanding, 8192u);
+        CHECK(stats.highWaterMark >= 4096u);
+    }
+
+    BufferPool::Statistics stats = pool.getStatistics();
+    CHECK_EQ(stats.bytesOutstanding, 0u);
+    CHECK(stats.highWaterMark >= 8192u);
+
+    // A released block is served again from the thread's cache
+    Buffer again = pool.acquire(4096);
+    CHECK_EQ(pool.getStatistics().hits, 2u);
+    CHECK_EQ(pool.getStatistics().bytesReserved, 64u * 1024);
+}
+
+TEST(counts_from_every_thread_add_up) {
+    BufferPool pool(4096);
+    const int threads = 4;
+    const int perThread = 5000;
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&pool]() {
+            for (int i = 0; i < perThread; i++) {
+                Buffer buffer = pool.acquire(1000);
+                buffer.setSize(1000);
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    BufferPool::Statistics stats = pool.getStatistics();
+    CHECK_EQ(stats.hits + stats.misses, static_cast<size_t>(threads * perThread));
+    CHECK_EQ(stats.bytesOutstanding, 0u);
+}
+
+TEST(blocks_released_on_another_thread_return_to_the_pool) {
+    BufferPool pool(4096);
+    std::vector<Buffer> buffers;
+    for (int i = 0; i < 200; i++) {
+        buffers.push_back(pool.acquire(4096));
+    }
+    CHECK_EQ(pool.getStatistics().bytesOutstanding, 200u * 4096);
+
+    std::thread releaser([&buffers]() {
+        buffers.clear();
+    });
+    releaser.join();
+    CHECK_EQ(pool.getStatistics().bytesOutstanding, 0u);
+
+    // Reused, not carved again
+    size_t reserved = pool.getStatistics().bytesReserved;
+    for (int i = 0; i < 200; i++) {
+        buffers.push_back(pool.acquire(4096));
+    }
+    CHECK_EQ(pool.getStatistics().bytesReserved, reserved);
+}
+
+TEST(buffers_outlive_their_pool) {
+    Buffer kept;
+    Buffer large;
+    std::vector<Buffer> cross;
+    {
+        BufferPool pool(4096);
+        kept = pool.acquire(100);
+        large = pool.acquire(10000);
+        for (int i = 0; i < 50; i++) {
+            cross.push_back(pool.acquire(4096));
+        }
+        // Parked in this thread's cache and the shared list when the pool goes
+        Buffer cached = pool.acquire(4096);
+    }
+
+    std::memset(kept.data(), 0xab, kept.capacity());
+    std::memset(large.data(), 0xcd, large.capacity());
+    CHECK_EQ(kept.data()[kept.capacity() - 1], 0xab);
+
+    // Released after the pool is gone, from this thread and another
+    std::thread releaser([&cross]() {
+        cross.clear();
+    });
+    releaser.join();
+    kept.reset();
+    large.reset();
+    CHECK(!kept);
+
+    // A new pool on this thread starts from its own state
+    BufferPool pool(4096);
+    Buffer fresh = pool.acquire(4096);
+    CHECK_EQ(pool.getStatistics().bytesOutstanding, 4096u);
+}
+
+TEST_MAIN()
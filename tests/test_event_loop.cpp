@@ -0,0 +1,194 @@
+#include "test_support.h"
+#include <thread>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+// EventLoop task and timer paths: posts racing the loop's wakeup drain
+// from many threads, dispatch(), timers, and stop() from inside and outside
+// the loop.
+
+namespace {
+
+using tcp::EventLoop;
+using std::chrono::milliseconds;
+
+bool waitFor(std::future<void>& future, milliseconds timeout = milliseconds(5000)) {
+    return future.wait_for(timeout) == std::future_status::ready;
+}
+
+} // namespace
+
+TEST(posts_from_many_threads_all_run) {
+    EventLoop loop;
+    CHECK(loop.start());
+    
+    // Each poster waits for its task before posting the next, so every post
+    // needs its own wakeup; a lost one stalls the poster
+    const int threads = 8;
+    const int postsPerThread = 2000;
+    std::atomic<int> ran{0};
+    std::atomic<int> stalled{0};
+    std::vector<std::thread> posters;
+    for (int t = 0; t < threads; t++) {
+        posters.emplace_back([&]() {
+            for (int i = 0; i < postsPerThread; i++) {
+                std::promise<void> done;
+                std::future<void> future = done.get_future();
+                loop.post([&ran, &done]() {
+                    ran++;
+                    done.set_value();
+                });
+                if (!waitFor(future)) {
+                    stalled++;
+                    return;
+                }
+            }
+        });
+    }
+    for (auto& poster : posters) {
+        poster.join();
+    }
+    CHECK_EQ(stalled.load(), 0);
+    CHECK_EQ(ran.load(), threads * postsPerThread);
+    
+    loop.stop();
+    CHECK(!loop.isRunning());
+}
+
+TEST(tasks_run_in_post_order_on_the_loop_thread) {
+    EventLoop loop;
+    CHECK(loop.start());
+    std::vector<int> order;
+    bool onLoop = true;
+    std::promise<void> done;
+    std::future<void> future = done.get_future();
+    for (int i = 0; i < 100; i++) {
+        loop.post([&, i]() {
+            onLoop &= loop.isInLoopThread();
+            order.push_back(i);
+            if (i == 99) {
+                done.set_value();
+            }
+        });
+    }
+    CHECK(waitFor(future));
+    CHECK(onLoop);
+    CHECK_EQ(order.size(), 100u);
+    for (int i = 0; i < static_cast<int>(order.size()); i++) {
+        CHECK_EQ(order[i], i);
+    }
+    CHECK(!loop.isInLoopThread());
+    loop.stop();
+}
+
+TEST(dispatch_runs_inline_on_the_loop_thread) {
+    EventLoop loop;
+    CHECK(loop.start());
+    std::promise<void> done;
+    std::future<void> future = done.get_future();
+    loop.post([&]() {
+        bool ranInline = false;
+        loop.dispatch([&ranInline]() { ranInline = true; });
+        CHECK(ranInline);
+        
+        // A post from the loop thread runs later, in a following pass
+        loop.post([&done]() { done.set_value(); });
+    });
+    CHECK(waitFor(future));
+    loop.stop();
+}
+
+TEST(timers_fire_and_cancel) {
+    EventLoop loop;
+    CHECK(loop.start());
+    
+    std::promise<void> fired;
+    std::future<void> future = fired.get_future();
+    auto start = std::chrono::steady_clock::now();
+    loop.runAfter(milliseconds(30), [&fired]() { fired.set_value(); });
+    CHECK(waitFor(future));
+    CHECK(std::chrono::steady_clock::now() - start >= milliseconds(30));
+    
+    std::atomic<bool> cancelledRan{false};
+    tcp::TimerId cancelled = loop.runAfter(milliseconds(20), [&cancelledRan]() { cancelledRan = true; });
+    CHECK(loop.cancelTimer(cancelled));
+    CHECK(!loop.cancelTimer(cancelled));
+    
+    std::atomic<int> ticks{0};
+    std::promise<void> threeTicks;
+    std::future<void> ticked = threeTicks.get_future();
+    tcp::TimerId periodic = loop.runEvery(milliseconds(10), [&]() {
+        if (++ticks == 3) {
+            threeTicks.set_value();
+        }
+    });
+    CHECK(waitFor(ticked));
+    CHECK(loop.cancelTimer(periodic));
+    
+    std::this_thread::sleep_for(milliseconds(40));
+    CHECK(!cancelledRan);
+    CHECK_EQ(ticks.load(), 3);
+    CHECK_EQ(loop.getTimerCount(), 0u);
+    loop.stop();
+}
+
+TEST(stop_wakes_an_idle_loop) {
+    // Repeatedly: start, let the loop go to sleep, stop. stop() joins, so a
+    // missed wakeup hangs here and ctest's timeout reports it.
+    for (int i = 0; i < 50; i++) {
+        EventLoop loop;
+        CHECK(loop.start());
+        std::promise<void> idle;
+        std::future<void> future = idle.get_future();
+        loop.post([&idle]() { idle.set_value(); });
+        CHECK(waitFor(future));
+        std::this_thread::sleep_for(milliseconds(1));
+        loop.stop();
+        CHECK(!loop.isRunning());
+    }
+}
+
+TEST(run_on_the_calling_thread_until_stopped_from_a_task) {
+    EventLoop loop;
+    int ran = 0;
+    loop.post([&]() {
+        ran++;
+        loop.runAfter(milliseconds(5), [&]() {
+            ran++;
+            loop.stop();
+        });
+    });
+    loop.run();
+    CHECK_EQ(ran, 2);
+    CHECK(!loop.isRunning());
+}
+
+TEST(descriptor_handlers_see_readiness) {
+#ifndef _WIN32
+    EventLoop loop;
+    CHECK(loop.start());
+    int fds[2];
+    CHECK(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    
+    std::promise<void> readable;
+    std::future<void> future = readable.get_future();
+    std::atomic<bool> signalled{false};
+    CHECK(loop.add(fds[0], EventLoop::Readable, [&](uint32_t events) {
+        char byte;
+        if ((events & EventLoop::Readable) && ::read(fds[0], &byte, 1) == 1 && byte == 'x' && !signalled.exchange(true)) {
+            readable.set_value();
+        }
+    }));
+    CHECK(::write(fds[1], "x", 1) == 1);
+    CHECK(waitFor(future));
+    
+    loop.remove(fds[0]);
+    loop.stop();
+    ::close(fds[0]);
+    ::close(fds[1]);
+#endif
+}
+
+TEST_MAIN()
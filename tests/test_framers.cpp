@@ -0,0 +1,195 @@
+#include "test_support.h"
+
+// Length-prefixed and delimiter framing, with the stream cut at every
+// possible read size so headers, payloads and delimiters straddle reads.
+
+namespace {
+
+using tcp::ByteView;
+using tcp::BufferView;
+using tcp::DelimiterFramer;
+using tcp::LengthPrefixedFramer;
+
+// Feeds stream in reads of readSize bytes through the zero-copy BufferView path
+std::vector<std::string> decodeInReads(tcp::MessageFramer& framer, const std::vector<uint8_t>& stream, size_t readSize) {
+    std::vector<std::string> frames;
+    for (size_t offset = 0; offset < stream.size(); offset += readSize) {
+        size_t length = std::min(readSize, stream.size() - offset);
+        framer.decodeFrames(tcp_test::block(stream.data() + offset, length), [&frames](const BufferView& frame) {
+            frames.push_back(frame.toString());
+        });
+    }
+    return frames;
+}
+
+const std::vector<std::string> kMessages = {"hello", "", "a", std::string(300, 'x'), "last message"};
+
+} // namespace
+
+TEST(length_prefixed_round_trip_every_length_type) {
+    for (auto type : {LengthPrefixedFramer::LengthType::UInt16, LengthPrefixedFramer::LengthType::UInt32,
+                      LengthPrefixedFramer::LengthType::UInt64}) {
+        for (bool bigEndian : {true, false}) {
+            LengthPrefixedFramer encoder(type, bigEndian);
+            std::vector<uint8_t> stream;
+            for (const std::string& message : kMessages) {
+                encoder.appendFrame(ByteView(message), stream);
+            }
+            
+            for (size_t readSize = 1; readSize <= stream.size(); readSize++) {
+                LengthPrefixedFramer decoder(type, bigEndian);
+                CHECK(decodeInReads(decoder, stream, readSize) == kMessages);
+                CHECK(!decoder.hasError());
+            }
+        }
+    }
+}
+
+TEST(length_prefixed_header_layout) {
+    LengthPrefixedFramer big(LengthPrefixedFramer::LengthType::UInt32, true);
+    CHECK(big.frame(tcp_test::bytes("abc")) == std::vector<uint8_t>({0, 0, 0, 3, 'a', 'b', 'c'}));
+    
+    LengthPrefixedFramer little(LengthPrefixedFramer::LengthType::UInt16, false);
+    CHECK(little.frame(tcp_test::bytes("ab")) == std::vector<uint8_t>({2, 0, 'a', 'b'}));
+}
+
+TEST(length_prefixed_vector_and_view_paths_agree) {
+    LengthPrefixedFramer encoder;
+    std::vector<uint8_t> stream;
+    for (const std::string& message : kMessages) {
+        encoder.appendFrame(ByteView(message), stream);
+    }
+    
+    LengthPrefixedFramer vectorDecoder;
+    std::vector<std::string> viaVector;
+    for (size_t offset = 0; offset < stream.size(); offset += 7) {
+        std::vector<uint8_t> read(stream.begin() + offset, stream.begin() + std::min(offset + 7, stream.size()));
+        for (const auto& frame : vectorDecoder.unframe(read)) {
+            viaVector.emplace_back(frame.begin(), frame.end());
+        }
+    }
+    CHECK(viaVector == kMessages);
+    
+    LengthPrefixedFramer viewDecoder;
+    std::vector<std::string> viaView;
+    viewDecoder.unframe(ByteView(stream), [&viaView](const ByteView& frame) {
+        viaView.push_back(frame.toString());
+    });
+    CHECK(viaView == kMessages);
+}
+
+TEST(length_prefixed_whole_frames_share_the_read_block) {
+    LengthPrefixedFramer encoder;
+    std::vector<uint8_t> stream = encoder.frame(tcp_test::bytes("one"));
+    std::vector<uint8_t> second = encoder.frame(tcp_test::bytes("two"));
+    stream.insert(stream.end(), second.begin(), second.end());
+    
+    BufferView read = tcp_test::block(stream.data(), stream.size());
+    LengthPrefixedFramer decoder;
+    size_t shared = 0;
+    decoder.decodeFrames(read, [&](const BufferView& frame) {
+        shared += frame.data() >= read.data() && frame.data() < read.data() + read.size();
+    });
+    CHECK_EQ(shared, 2u);
+}
+
+TEST(length_prefixed_oversized_header_fails_until_reset) {
+    LengthPrefixedFramer encoder;
+    std::vector<uint8_t> stream = encoder.frame(std::vector<uint8_t>(100, 'z'));
+    
+    LengthPrefixedFramer decoder;
+    decoder.setMaxFrameSize(99);
+    CHECK_EQ(decoder.unframe(ByteView(stream), [](const ByteView&) {}), 0u);
+    CHECK(decoder.hasError());
+    
+    // Further input is ignored until the stream is reset
+    std::vector<uint8_t> small = encoder.frame(tcp_test::bytes("ok"));
+    CHECK_EQ(decoder.unframe(ByteView(small), [](const ByteView&) {}), 0u);
+    decoder.reset();
+    CHECK_EQ(decoder.unframe(ByteView(small), [](const ByteView&) {}), 1u);
+}
+
+TEST(delimiter_single_byte_crlf_and_generic) {
+    for (const std::string delimiter : {"\n", "\r\n", "<END>"}) {
+        DelimiterFramer encoder(delimiter);
+        std::vector<uint8_t> stream;
+        for (const std::string& message : kMessages) {
+            encoder.appendFrame(ByteView(message), stream);
+        }
+        
+        for (size_t readSize = 1; readSize <= stream.size(); readSize++) {
+            DelimiterFramer decoder(delimiter);
+            CHECK(decodeInReads(decoder, stream, readSize) == kMessages);
+        }
+    }
+}
+
+TEST(delimiter_partial_match_is_not_a_delimiter) {
+    // "\r" alone, and "<EN" followed by something else, must stay in the message
+    DelimiterFramer crlf("\r\n");
+    std::vector<std::string> frames;
+    crlf.unframe(ByteView(std::string("a\rb\r\nc\r")), [&frames](const ByteView& frame) {
+        frames.push_back(frame.toString());
+    });
+    crlf.unframe(ByteView(std::string("\r\n")), [&frames](const ByteView& frame) {
+        frames.push_back(frame.toString());
+    });
+    CHECK(frames == std::vector<std::string>({"a\rb", "c\r"}));
+    
+    DelimiterFramer generic("<END>");
+    frames.clear();
+    generic.unframe(ByteView(std::string("x<EN")), [&frames](const ByteView& frame) {
+        frames.push_back(frame.toString());
+    });
+    generic.unframe(ByteView(std::string("D<END>")), [&frames](const ByteView& frame) {
+        frames.push_back(frame.toString());
+    });
+    CHECK(frames == std::vector<std::string>({"x<END"}));
+}
+
+TEST(delimiter_long_messages_cross_the_vector_scanner) {
+    // Delimiters at every offset within and across 16- and 32-byte blocks
+    std::vector<std::string> messages;
+    std::vector<uint8_t> stream;
+    for (size_t length = 0; length < 70; length++) {
+        messages.push_back(std::string(length, static_cast<char>('a' + length % 26)));
+        stream.insert(stream.end(), messages.back().begin(), messages.back().end());
+        stream.push_back('\n');
+    }
+    
+    for (size_t readSize : {1, 15, 16, 17, 31, 32, 33, 64, 4096}) {
+        DelimiterFramer decoder("\n");
+        CHECK(decodeInReads(decoder, stream, readSize) == messages);
+    }
+}
+
+TEST(delimiter_include_delimiter) {
+    DelimiterFramer decoder("\r\n", true);
+    std::vector<std::string> frames;
+    decoder.unframe(ByteView(std::string("GET\r\nHOST\r\n")), [&frames](const ByteView& frame) {
+        frames.push_back(frame.toString());
+    });
+    CHECK(frames == std::vector<std::string>({"GET\r\n", "HOST\r\n"}));
+}
+
+TEST(frame_batch_matches_single_frames) {
+    LengthPrefixedFramer framer;
+    std::vector<ByteView> views;
+    std::vector<uint8_t> expected;
+    for (const std::string& message : kMessages) {
+        views.emplace_back(message);
+        std::vector<uint8_t> single = framer.frame(tcp_test::bytes(message));
+        expected.insert(expected.end(), single.begin(), single.end());
+    }
+    
+    std::vector<uint8_t> batch = {'s', 't', 'a', 'l', 'e'}; // Replaced, not appended to
+    framer.frameBatch(views.data(), views.size(), batch);
+    CHECK(batch == expected);
+    
+    DelimiterFramer lines("\n");
+    lines.frameBatch(views.data(), views.size(), batch);
+    DelimiterFramer decoder("\n");
+    CHECK(decodeInReads(decoder, batch, 3) == kMessages);
+}
+
+TEST_MAIN()
@@ -0,0 +1,208 @@
+#include "test_support.h"
+
+// HttpParser: requests and responses fed whole, pipelined and a byte at a
+// time, chunked bodies, limits, and the builders' header validation.
+
+namespace {
+
+using tcp::HttpBuilder;
+using tcp::HttpMessage;
+using tcp::HttpParser;
+
+// The views only live for the callback, so tests keep copies
+struct Parsed {
+    std::string method;
+    std::string target;
+    int statusCode = 0;
+    std::string host;
+    std::string body;
+    bool chunked = false;
+    bool keepAlive = false;
+};
+
+Parsed copy(const HttpMessage& message) {
+    Parsed parsed;
+    parsed.method = std::string(message.method);
+    parsed.target = std::string(message.target);
+    parsed.statusCode = message.statusCode;
+    parsed.host = std::string(message.header("host"));
+    parsed.body = message.body.toString();
+    parsed.chunked = message.chunked;
+    parsed.keepAlive = message.keepAlive();
+    return parsed;
+}
+
+std::vector<Parsed> parseInReads(HttpParser& parser, const std::string& stream, size_t readSize) {
+    std::vector<Parsed> messages;
+    for (size_t offset = 0; offset < stream.size(); offset += readSize) {
+        std::string read = stream.substr(offset, readSize);
+        parser.parse(tcp_test::block(read), [&messages](const HttpMessage& message) {
+            messages.push_back(copy(message));
+        });
+    }
+    return messages;
+}
+
+const std::string kPipelined =
+    "GET /index.html HTTP/1.1\r\nHost: example.com\r\n\r\n"
+    "POST /submit HTTP/1.1\r\nHOST: api\r\nContent-Length: 11\r\n\r\nhello world"
+    "PUT /chunks HTTP/1.1\r\nHost: c\r\nTransfer-Encoding: chunked\r\n\r\n"
+    "5\r\nhello\r\n6;ext=1\r\n world\r\n0\r\nTrailer: x\r\n\r\n"
+    "GET /close HTTP/1.0\r\n\r\n";
+
+} // namespace
+
+TEST(pipelined_requests_at_every_read_size) {
+    for (size_t readSize = 1; readSize <= kPipelined.size(); readSize++) {
+        HttpParser parser(HttpParser::Type::Request);
+        std::vector<Parsed> messages = parseInReads(parser, kPipelined, readSize);
+        CHECK(!parser.hasError());
+        CHECK_EQ(messages.size(), 4u);
+        if (messages.size() != 4) {
+            continue;
+        }
+        
+        CHECK_EQ(messages[0].method, "GET");
+        CHECK_EQ(messages[0].target, "/index.html");
+        CHECK_EQ(messages[0].host, "example.com");
+        CHECK(messages[0].body.empty());
+        CHECK(messages[0].keepAlive);
+        
+        CHECK_EQ(messages[1].method, "POST");
+        CHECK_EQ(messages[1].host, "api"); // Case-insensitive lookup
+        CHECK_EQ(messages[1].body, "hello world");
+        
+        CHECK(messages[2].chunked);
+        CHECK_EQ(messages[2].body, "hello world");
+        
+        CHECK_EQ(messages[3].target, "/close");
+        CHECK(!messages[3].keepAlive); // HTTP/1.0 without keep-alive
+    }
+}
+
+TEST(unframe_returns_messages_as_on_the_wire) {
+    std::string first = "GET /a HTTP/1.1\r\n\r\n";
+    std::string second = "POST /b HTTP/1.1\r\nContent-Length: 2\r\n\r\nhi";
+    HttpParser parser;
+    auto messages = parser.unframe(tcp_test::bytes(first + second));
+    CHECK_EQ(messages.size(), 2u);
+    if (messages.size() == 2) {
+        CHECK(messages[0] == tcp_test::bytes(first));
+        CHECK(messages[1] == tcp_test::bytes(second));
+    }
+}
+
+TEST(response_bodies) {
+    HttpParser parser(HttpParser::Type::Response);
+    std::vector<Parsed> messages = parseInReads(parser,
+        "HTTP/1.1 200 OK\r\nContent-Length: 3\r\n\r\nabc"
+        "HTTP/1.1 204 No Content\r\n\r\n"
+        "HTTP/1.1 304 Not Modified\r\nContent-Length: 99\r\n\r\n",
+        5);
+    CHECK_EQ(messages.size(), 3u);
+    if (messages.size() == 3) {
+        CHECK_EQ(messages[0].statusCode, 200);
+        CHECK_EQ(messages[0].body, "abc");
+        CHECK_EQ(messages[1].statusCode, 204);
+        CHECK_EQ(messages[2].statusCode, 304); // Bodyless whatever its headers say
+        CHECK(messages[2].body.empty());
+    }
+}
+
+TEST(response_to_head_has_no_body) {
+    HttpParser parser(HttpParser::Type::Response);
+    parser.expectHeadResponse();
+    std::vector<Parsed> messages = parseInReads(parser,
+        "HTTP/1.1 200 OK\r\nContent-Length: 1000\r\n\r\n"
+        "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok",
+        64);
+    CHECK_EQ(messages.size(), 2u);
+    if (messages.size() == 2) {
+        CHECK(messages[0].body.empty());
+        CHECK_EQ(messages[1].body, "ok");
+    }
+}
+
+TEST(response_body_until_close) {
+    HttpParser parser(HttpParser::Type::Response);
+    std::vector<Parsed> messages = parseInReads(parser, "HTTP/1.1 200 OK\r\n\r\nstreamed until the end", 4);
+    CHECK(messages.empty());
+    
+    size_t finished = parser.finish([&messages](const HttpMessage& message) {
+        messages.push_back(copy(message));
+    });
+    CHECK_EQ(finished, 1u);
+    if (messages.size() == 1) {
+        CHECK_EQ(messages[0].body, "streamed until the end");
+    }
+}
+
+TEST(malformed_requests_fail_with_400) {
+    const std::vector<std::string> bad = {
+        "GET\r\n\r\n",
+        "GET / HTTP/1.1\r\nBad Name: x\r\n\r\n",
+        "POST / HTTP/1.1\r\nContent-Length: 5\r\nContent-Length: 6\r\n\r\n",
+        "POST / HTTP/1.1\r\nContent-Length: -1\r\n\r\n",
+        "POST / HTTP/1.1\r\nTransfer-Encoding: gzip\r\n\r\n",
+        "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n",
+    };
+    for (const std::string& request : bad) {
+        HttpParser parser;
+        size_t delivered = parser.parse(tcp_test::block(request), [](const HttpMessage&) {});
+        CHECK_EQ(delivered, 0u);
+        CHECK(parser.getError() == HttpParser::Error::BadMessage);
+        CHECK_EQ(parser.getStatusCode(), 400);
+    }
+}
+
+TEST(limits_fail_with_431_and_413) {
+    HttpParser heads;
+    heads.setMaxHeadSize(64);
+    heads.parse(tcp_test::block("GET / HTTP/1.1\r\nX-Long: " + std::string(100, 'a')), [](const HttpMessage&) {});
+    CHECK_EQ(heads.getStatusCode(), 431);
+    
+    HttpParser fields;
+    std::string many = "GET / HTTP/1.1\r\n";
+    for (size_t i = 0; i <= HttpMessage::kMaxHeaders; i++) {
+        many += "X-" + std::to_string(i) + ": v\r\n";
+    }
+    fields.parse(tcp_test::block(many + "\r\n"), [](const HttpMessage&) {});
+    CHECK_EQ(fields.getStatusCode(), 431);
+    
+    HttpParser bodies;
+    bodies.setMaxBodySize(10);
+    bodies.parse(tcp_test::block("POST / HTTP/1.1\r\nContent-Length: 11\r\n\r\n"), [](const HttpMessage&) {});
+    CHECK_EQ(bodies.getStatusCode(), 413);
+    
+    // reset() clears the error
+    bodies.reset();
+    CHECK(!bodies.hasError());
+    CHECK_EQ(bodies.parse(tcp_test::block("GET / HTTP/1.1\r\n\r\n"), [](const HttpMessage&) {}), 1u);
+}
+
+TEST(builder_output_parses_back) {
+    HttpBuilder builder = HttpBuilder::request("POST", "/path?q=1");
+    builder.header("Host", "example.com").contentLength(4);
+    tcp::BufferView head = builder.finish();
+    CHECK_EQ(head.toString(), "POST /path?q=1 HTTP/1.1\r\nHost: example.com\r\nContent-Length: 4\r\n\r\n");
+    
+    HttpParser parser;
+    std::vector<Parsed> messages = parseInReads(parser, head.toString() + "body", 3);
+    CHECK_EQ(messages.size(), 1u);
+    if (messages.size() == 1) {
+        CHECK_EQ(messages[0].body, "body");
+    }
+    
+    CHECK_EQ(HttpBuilder::response(404).finish().toString(), "HTTP/1.1 404 Not Found\r\n\r\n");
+}
+
+TEST(builder_rejects_fields_that_split_the_message) {
+    CHECK(!HttpBuilder::request("GET", "/").header("X", "a\r\nInjected: 1").isValid());
+    CHECK(!HttpBuilder::request("GET", "/").header("Bad Name", "v").isValid());
+    CHECK(!HttpBuilder::request("GET", "/a b").isValid());
+    CHECK(!HttpBuilder::response(200, "OK\r\n").isValid());
+    CHECK(HttpBuilder::request("GET", "/").header("X", "tab\tis fine").isValid());
+    CHECK(HttpBuilder::request("GET", "/").header("X", "\n").finish().empty());
+}
+
+TEST_MAIN()
@@ -0,0 +1,126 @@
+#include "test_support.h"
+#include <thread>
+
+// GCRA RateLimiter: burst accounting, debt from reserve(), parents capping
+// children, concurrent takers never overdrawing, and the async wait. Rates
+// are slow enough that the sub-second runtime refills only a few bytes.
+
+namespace {
+
+using tcp::RateLimiter;
+using std::chrono::milliseconds;
+using std::chrono::nanoseconds;
+
+} // namespace
+
+TEST(full_bucket_allows_one_burst) {
+    RateLimiter limiter(1000, 1000);
+    CHECK(limiter.getAvailableBytes() >= 990);
+    CHECK(limiter.allowBytes(600));
+    CHECK(limiter.allowBytes(390));
+    CHECK(!limiter.allowBytes(100)); // Refill is about 1 byte per millisecond
+    CHECK(limiter.getAvailableBytes() < 100);
+    CHECK(limiter.getUtilization() > 0.9);
+    
+    // A request larger than the bucket never fits
+    RateLimiter fresh(1000, 1000);
+    CHECK(!fresh.allowBytes(1001));
+}
+
+TEST(bucket_defaults_to_one_second) {
+    RateLimiter limiter(5000);
+    CHECK_EQ(limiter.getBucketSize(), 5000u);
+    CHECK(limiter.allowBytes(4900));
+}
+
+TEST(delay_matches_the_missing_tokens) {
+    RateLimiter limiter(1000, 1000);
+    CHECK(limiter.allowBytes(1000));
+    
+    // 500 bytes at 1000 B/s is about half a second away
+    milliseconds delay = limiter.getDelay(500);
+    CHECK(delay >= milliseconds(450) && delay <= milliseconds(500));
+    CHECK(limiter.getDelay(0) <= milliseconds(1));
+}
+
+TEST(reserve_goes_into_debt) {
+    RateLimiter limiter(1000, 1000);
+    CHECK_EQ(limiter.reserve(1000).count(), 0);
+    
+    nanoseconds first = limiter.reserve(250);
+    CHECK(first >= milliseconds(240) && first <= milliseconds(250));
+    
+    // Debt accumulates: the next reservation waits behind the first
+    nanoseconds second = limiter.reserve(250);
+    CHECK(second >= milliseconds(490) && second <= milliseconds(500));
+    CHECK(!limiter.allowBytes(1));
+    
+    limiter.reset();
+    CHECK(limiter.allowBytes(1000));
+}
+
+TEST(zero_rate_means_unlimited) {
+    RateLimiter limiter(0);
+    for (int i = 0; i < 100; i++) {
+        CHECK(limiter.allowBytes(1 << 20));
+    }
+    CHECK_EQ(limiter.reserve(1 << 30).count(), 0);
+    CHECK_EQ(limiter.getDelay(1 << 30).count(), 0);
+}
+
+TEST(parent_caps_its_children) {
+    auto parent = std::make_shared<RateLimiter>(1000, 1000);
+    RateLimiter first(0, 0, parent);       // No limit of its own
+    RateLimiter second(10000, 10000, parent);
+    
+    CHECK(first.allowBytes(700));
+    CHECK(!second.allowBytes(700)); // The shared cap is spent...
+    CHECK(second.getAvailableBytes() >= 9900); // ...and second got its own tokens back
+    CHECK(second.allowBytes(250));
+    
+    // A child's own limit still applies under a roomy parent
+    auto roomy = std::make_shared<RateLimiter>(0);
+    RateLimiter child(1000, 1000, roomy);
+    CHECK(child.allowBytes(1000));
+    CHECK(!child.allowBytes(100));
+    CHECK(child.getDelay(100) >= milliseconds(90));
+}
+
+TEST(concurrent_takers_never_overdraw) {
+    RateLimiter limiter(1000, 100000); // 100 KB burst, refill negligible
+    std::atomic<size_t> taken{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; t++) {
+        threads.emplace_back([&]() {
+            for (int i = 0; i < 10000; i++) {
+                if (limiter.allowBytes(10)) {
+                    taken += 10;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    CHECK(taken.load() >= 99000);
+    CHECK(taken.load() <= 100000 + 1000); // At most a second's refill on top
+}
+
+TEST(wait_async_runs_ranInlineor_after_the_delay) {
+    tcp::EventLoop loop;
+    CHECK(loop.start());
+    RateLimiter limiter(1000, 1000);
+    
+    bool ranInline = false;
+    CHECK_EQ(limiter.waitAsync(loop, 1000, [&ranInline]() { ranInline = true; }), 0u);
+    CHECK(ranInline);
+    
+    std::promise<void> ready;
+    auto start = std::chrono::steady_clock::now();
+    CHECK(limiter.waitAsync(loop, 50, [&ready]() { ready.set_value(); }) != 0u);
+    CHECK(ready.get_future().wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+    CHECK(std::chrono::steady_clock::now() - start >= milliseconds(40));
+    loop.stop();
+}
+
+TEST_MAIN()
@@ -0,0 +1,224 @@
+#include "test_support.h"
+#include <thread>
+
+// SpscRingBuffer and MpscRingBuffer, plain and mirrored: wrap-around
+// copies, in-place writable()/readable(), and threaded producers checked
+// for lost, duplicated or torn data.
+
+namespace {
+
+using tcp::MpscRingBuffer;
+using tcp::SpscRingBuffer;
+
+std::vector<uint8_t> pattern(size_t length, size_t seed) {
+    std::vector<uint8_t> data(length);
+    for (size_t i = 0; i < length; i++) {
+        data[i] = static_cast<uint8_t>(seed * 31 + i);
+    }
+    return data;
+}
+
+} // namespace
+
+TEST(capacity_rounds_up_to_a_power_of_two) {
+    SpscRingBuffer spsc(1000);
+    CHECK_EQ(spsc.getCapacity(), 1024u);
+    MpscRingBuffer mpsc(4097);
+    CHECK_EQ(mpsc.getCapacity(), 8192u);
+}
+
+TEST(spsc_wraps_without_losing_bytes) {
+    for (bool mirrored : {false, true}) {
+        SpscRingBuffer ring(4096, mirrored);
+        size_t seed = 0;
+        // Chunk sizes that don't divide the capacity move the wrap point around
+        for (size_t chunk : {1, 7, 100, 1000, 4095, 4096}) {
+            for (int round = 0; round < 20; round++) {
+                std::vector<uint8_t> in = pattern(chunk, seed++);
+                CHECK_EQ(ring.write(in.data(), in.size()), chunk);
+                
+                std::vector<uint8_t> peeked(chunk);
+                CHECK_EQ(ring.peek(peeked.data(), chunk), chunk);
+                std::vector<uint8_t> out(chunk);
+                CHECK_EQ(ring.read(out.data(), chunk), chunk);
+                CHECK(in == out && peeked == out);
+                CHECK(ring.isEmpty());
+            }
+        }
+    }
+}
+
+TEST(spsc_write_stops_when_full) {
+    SpscRingBuffer ring(1024);
+    std::vector<uint8_t> in = pattern(1500, 1);
+    CHECK_EQ(ring.write(in.data(), in.size()), 1024u);
+    CHECK(ring.isFull());
+    CHECK_EQ(ring.write(in.data(), 1), 0u);
+    
+    ring.skip(24);
+    CHECK_EQ(ring.getAvailableSpace(), 24u);
+    std::vector<uint8_t> out(1000);
+    CHECK_EQ(ring.read(out.data(), out.size()), 1000u);
+    CHECK(std::equal(out.begin(), out.end(), in.begin() + 24));
+    
+    ring.clear();
+    CHECK(ring.isEmpty());
+}
+
+TEST(spsc_in_place_access) {
+    for (bool mirrored : {false, true}) {
+        SpscRingBuffer ring(4096, mirrored);
+        
+        // Move the positions near the end so the next write wraps
+        std::vector<uint8_t> pad(4000);
+        ring.write(pad.data(), pad.size());
+        ring.skip(pad.size());
+        
+        std::vector<uint8_t> in = pattern(200, 9);
+        size_t written = 0;
+        while (written < in.size()) {
+            size_t length = in.size() - written;
+            uint8_t* space = ring.writable(length);
+            CHECK(space != nullptr && length > 0);
+            if (!space || length == 0) {
+                break;
+            }
+            length = std::min(length, in.size() - written);
+            std::memcpy(space, in.data() + written, length);
+            ring.commit(length);
+            written += length;
+        }
+        
+        // Mirrored memory hands out everything in one view across the wrap
+        tcp::ByteView view = ring.readable();
+        if (ring.isMirrored()) {
+            CHECK_EQ(view.size(), in.size());
+        } else {
+            CHECK_EQ(view.size(), 96u); // Up to the wrap
+        }
+        
+        std::vector<uint8_t> out;
+        while (!ring.isEmpty()) {
+            view = ring.readable();
+            out.insert(out.end(), view.begin(), view.end());
+            ring.consume(view.size());
+        }
+        CHECK(out == in);
+    }
+}
+
+TEST(spsc_threaded_stream_arrives_in_order) {
+    for (bool mirrored : {false, true}) {
+        SpscRingBuffer ring(1 << 12, mirrored);
+        const size_t total = 1 << 20;
+        
+        std::thread producer([&]() {
+            uint8_t chunk[333];
+            size_t sent = 0;
+            while (sent < total) {
+                size_t length = std::min(sizeof(chunk), total - sent);
+                for (size_t i = 0; i < length; i++) {
+                    chunk[i] = static_cast<uint8_t>((sent + i) % 251);
+                }
+                size_t offset = 0;
+                while (offset < length) {
+                    size_t written = ring.write(chunk + offset, length - offset);
+                    if (written == 0) {
+                        std::this_thread::yield();
+                    }
+                    offset += written;
+                }
+                sent += length;
+            }
+        });
+        
+        size_t received = 0;
+        bool ordered = true;
+        uint8_t buffer[1000];
+        while (received < total) {
+            size_t length = ring.read(buffer, sizeof(buffer));
+            if (length == 0) {
+                std::this_thread::yield();
+            }
+            for (size_t i = 0; i < length; i++) {
+                ordered &= buffer[i] == static_cast<uint8_t>((received + i) % 251);
+            }
+            received += length;
+        }
+        producer.join();
+        CHECK(ordered);
+        CHECK(ring.isEmpty());
+    }
+}
+
+TEST(mpsc_writes_are_all_or_nothing) {
+    MpscRingBuffer ring(1024);
+    std::vector<uint8_t> in = pattern(600, 2);
+    CHECK_EQ(ring.write(in.data(), in.size()), 600u);
+    CHECK_EQ(ring.write(in.data(), in.size()), 0u); // Doesn't fit: nothing written
+    CHECK_EQ(ring.getSize(), 600u);
+    CHECK_EQ(ring.write(in.data(), 424), 424u);
+    
+    std::vector<uint8_t> out(1024);
+    CHECK_EQ(ring.read(out.data(), out.size()), 1024u);
+    CHECK(std::equal(in.begin(), in.end(), out.begin()));
+    CHECK(std::equal(in.begin(), in.begin() + 424, out.begin() + 600));
+}
+
+TEST(mpsc_concurrent_records_never_interleave) {
+    for (bool mirrored : {false, true}) {
+        // Records: producer id, sequence number, then a payload derived from both
+        struct Record {
+            uint32_t producer;
+            uint32_t sequence;
+            uint8_t payload[24];
+        };
+        const uint32_t producers = 4;
+        const uint32_t perProducer = 20000;
+        MpscRingBuffer ring(1 << 14, mirrored);
+        
+        std::vector<std::thread> threads;
+        for (uint32_t p = 0; p < producers; p++) {
+            threads.emplace_back([&ring, p]() {
+                for (uint32_t i = 0; i < perProducer; i++) {
+                    Record record;
+                    record.producer = p;
+                    record.sequence = i;
+                    std::memset(record.payload, static_cast<int>((p * 7 + i) & 0xFF), sizeof(record.payload));
+                    while (ring.write(&record, sizeof(record)) == 0) {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        
+        std::vector<uint32_t> next(producers, 0);
+        bool intact = true;
+        size_t records = 0;
+        while (records < producers * perProducer) {
+            Record record;
+            if (ring.getSize() < sizeof(record)) {
+                std::this_thread::yield();
+                continue;
+            }
+            ring.read(&record, sizeof(record));
+            records++;
+            if (record.producer >= producers || record.sequence != next[record.producer]) {
+                intact = false;
+                break;
+            }
+            next[record.producer]++;
+            uint8_t expected = static_cast<uint8_t>((record.producer * 7 + record.sequence) & 0xFF);
+            for (uint8_t byte : record.payload) {
+                intact &= byte == expected;
+            }
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        CHECK(intact);
+        CHECK_EQ(records, static_cast<size_t>(producers * perProducer));
+    }
+}
+
+TEST_MAIN()
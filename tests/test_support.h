@@ -0,0 +1,93 @@
+#pragma once
+
+#include "../tcp.h"
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Minimal harness for the unit tests: TEST() registers a case, CHECK()
+// records a failure with its location and lets the case carry on, and
+// TEST_MAIN() runs every case in the file. A binary exits non-zero when any
+// check failed, which is all ctest looks at.
+
+namespace tcp_test {
+
+struct TestCase {
+    const char* name;
+    void (*run)();
+};
+
+inline std::vector<TestCase>& registry() {
+    static std::vector<TestCase> cases;
+    return cases;
+}
+
+inline int& failures() {
+    static int count = 0;
+    return count;
+}
+
+struct Registrar {
+    Registrar(const char* name, void (*run)()) { registry().push_back({name, run}); }
+};
+
+inline void fail(const char* file, int line, const std::string& what) {
+    std::cerr << file << ":" << line << ": CHECK failed: " << what << std::endl;
+    failures()++;
+}
+
+inline int runAll() {
+    for (const TestCase& test : registry()) {
+        int before = failures();
+        test.run();
+        std::cout << (failures() == before ? "[ OK ] " : "[FAIL] ") << test.name << std::endl;
+    }
+    std::cout << registry().size() << " cases, " << failures() << " failed checks" << std::endl;
+    return failures() == 0 ? 0 : 1;
+}
+
+// Bytes of a string, for comparing payloads
+inline std::vector<uint8_t> bytes(const std::string& text) {
+    return std::vector<uint8_t>(text.begin(), text.end());
+}
+
+// A pooled block holding a copy of data, as a socket read would deliver it
+inline tcp::BufferView block(const void* data, size_t length) {
+    tcp::Buffer buffer = tcp::BufferPool::shared().acquire(length == 0 ? 1 : length);
+    if (length > 0) {
+        std::memcpy(buffer.data(), data, length);
+    }
+    buffer.setSize(length);
+    return tcp::BufferView(buffer);
+}
+
+inline tcp::BufferView block(const std::string& text) {
+    return block(text.data(), text.size());
+}
+
+} // namespace tcp_test
+
+#define TEST(name)                                                    \
+    static void test_##name();                                        \
+    static tcp_test::Registrar registrar_##name(#name, &test_##name); \
+    static void test_##name()
+
+#define CHECK(condition)                                      \
+    do {                                                      \
+        if (!(condition)) {                                   \
+            tcp_test::fail(__FILE__, __LINE__, #condition);   \
+        }                                                     \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                                              \
+    do {                                                                                        \
+        if (!((actual) == (expected))) {                                                        \
+            tcp_test::fail(__FILE__, __LINE__, #actual " == " #expected);                       \
+        }                                                                                       \
+    } while (0)
+
+#define TEST_MAIN()                 \
+    int main() {                    \
+        return tcp_test::runAll();  \
+    }
@@ -0,0 +1,172 @@
+#include "test_support.h"
+
+// TimerWheel driven by an explicit clock: expiry order and rounding,
+// cancellation, periodic timers, cascading from the upper levels and the
+// poll timeout bound.
+
+namespace {
+
+using tcp::TimerWheel;
+using Clock = TimerWheel::Clock;
+using std::chrono::milliseconds;
+
+// Runs the callbacks that expired by now, in order
+size_t advance(TimerWheel& wheel, Clock::time_point now) {
+    std::vector<TimerWheel::Callback> expired;
+    size_t count = wheel.advance(now, expired);
+    for (auto& callback : expired) {
+        callback();
+    }
+    return count;
+}
+
+} // namespace
+
+TEST(timers_fire_in_expiry_order_never_early) {
+    Clock::time_point start = Clock::now();
+    TimerWheel wheel(milliseconds(1), start);
+    std::vector<int> fired;
+    
+    for (int delay : {30, 10, 20, 10, 5}) {
+        wheel.schedule(start + milliseconds(delay), [&fired, delay]() { fired.push_back(delay); });
+    }
+    CHECK_EQ(wheel.size(), 5u);
+    
+    CHECK_EQ(advance(wheel, start + milliseconds(4)), 0u);
+    CHECK(fired.empty());
+    CHECK_EQ(advance(wheel, start + milliseconds(10)), 3u);
+    CHECK(fired == std::vector<int>({5, 10, 10}));
+    CHECK_EQ(advance(wheel, start + milliseconds(100)), 2u);
+    CHECK(fired == std::vector<int>({5, 10, 10, 20, 30}));
+    CHECK(wheel.empty());
+}
+
+TEST(same_tick_timers_keep_scheduling_order) {
+    Clock::time_point start = Clock::now();
+    TimerWheel wheel(milliseconds(1), start);
+    std::vector<int> fired;
+    for (int i = 0; i < 10; i++) {
+        wheel.schedule(start + milliseconds(3), [&fired, i]() { fired.push_back(i); });
+    }
+    advance(wheel, start + milliseconds(3));
+    CHECK(fired == std::vector<int>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+}
+
+TEST(deadlines_round_up_to_the_resolution) {
+    Clock::time_point start = Clock::now();
+    TimerWheel wheel(milliseconds(10), start);
+    int fired = 0;
+    wheel.schedule(start + milliseconds(11), [&fired]() { fired++; });
+    advance(wheel, start + milliseconds(19));
+    CHECK_EQ(fired, 0);
+    advance(wheel, start + milliseconds(20));
+    CHECK_EQ(fired, 1);
+}
+
+TEST(cancel_before_and_after_expiry) {
+    Clock::time_point start = Clock::now();
+    TimerWheel wheel(milliseconds(1), start);
+    int fired = 0;
+    tcp::TimerId cancelled = wheel.schedule(start + milliseconds(5), [&fired]() { fired += 100; });
+    tcp::TimerId kept = wheel.schedule(start + milliseconds(5), [&fired]() { fired++; });
+    
+    TimerWheel::Callback removed;
+    CHECK(wheel.cancel(cancelled, &removed));
+    CHECK(static_cast<bool>(removed)); // Handed back to be destroyed by the caller
+    CHECK(!wheel.isScheduled(cancelled));
+    CHECK(!wheel.cancel(cancelled));
+    
+    advance(wheel, start + milliseconds(5));
+    CHECK_EQ(fired, 1);
+    CHECK(!wheel.cancel(kept)); // Already fired
+    CHECK(!wheel.cancel(0));
+}
+
+TEST(ids_are_never_reused) {
+    Clock::time_point start = Clock::now();
+    TimerWheel wheel(milliseconds(1), start);
+    tcp::TimerId first = wheel.schedule(start + milliseconds(1), []() {});
+    advance(wheel, start + milliseconds(1));
+    tcp::TimerId second = wheel.schedule(start + milliseconds(2), []() {});
+    CHECK(first != second);
+    CHECK(!wheel.cancel(first)); // The fired timer's slot was reused, its id wasn't
+    CHECK(wheel.isScheduled(second));
+}
+
+TEST(periodic_timers_rearm_and_skip_missed_expiries) {
+    Clock::time_point start = Clock::now();
+    TimerWheel wheel(milliseconds(1), start);
+    int fired = 0;
+    tcp::TimerId id = wheel.schedule(start + milliseconds(10), [&fired]() { fired++; }, milliseconds(10));
+    
+    for (int ms = 1; ms <= 50; ms++) {
+        advance(wheel, start + milliseconds(ms));
+    }
+    CHECK_EQ(fired, 5);
+    CHECK(wheel.isScheduled(id));
+    
+    // A long stall fires once, not once per missed period
+    advance(wheel, start + milliseconds(500));
+    CHECK_EQ(fired, 6);
+    
+    CHECK(wheel.cancel(id));
+    advance(wheel, start + milliseconds(1000));
+    CHECK_EQ(fired, 6);
+}
+
+TEST(far_timers_cascade_down_the_levels) {
+    // Deadlines on every level: 256 ms, 65 s and 4.6 h are level boundaries at 1 ms
+    Clock::time_point start = Clock::now();
+    TimerWheel wheel(milliseconds(1), start);
+    const std::vector<int64_t> delays = {1, 255, 256, 257, 1000, 65535, 65536, 70000, 16777216, 20000000};
+    std::vector<int64_t> fired;
+    for (int64_t delay : delays) {
+        wheel.schedule(start + milliseconds(delay), [&fired, delay]() { fired.push_back(delay); });
+    }
+    
+    for (int64_t delay : delays) {
+        // Nothing early, even right before the deadline
+        advance(wheel, start + milliseconds(delay - 1));
+        CHECK(fired.empty() || fired.back() < delay);
+        advance(wheel, start + milliseconds(delay));
+        CHECK(!fired.empty() && fired.back() == delay);
+    }
+    CHECK(fired == delays);
+}
+
+TEST(time_until_next_bounds_the_wait) {
+    Clock::time_point start = Clock::now();
+    TimerWheel wheel(milliseconds(1), start);
+    CHECK_EQ(wheel.timeUntilNext(start), -1);
+    
+    wheel.schedule(start + milliseconds(40), []() {});
+    int wait = wheel.timeUntilNext(start);
+    CHECK(wait >= 0 && wait <= 40); // Early is allowed, late is not
+    
+    wheel.schedule(start + milliseconds(5), []() {});
+    wait = wheel.timeUntilNext(start);
+    CHECK(wait >= 0 && wait <= 5);
+    
+    wheel.schedule(start + milliseconds(100000), []() {});
+    advance(wheel, start + milliseconds(40));
+    wait = wheel.timeUntilNext(start + milliseconds(40));
+    CHECK(wait >= 0 && wait <= 100000 - 40);
+}
+
+TEST(callbacks_may_schedule_more_timers) {
+    Clock::time_point start = Clock::now();
+    TimerWheel wheel(milliseconds(1), start);
+    int fired = 0;
+    std::function<void()> chain = [&]() {
+        if (++fired < 5) {
+            wheel.schedule(start + milliseconds(fired * 10), chain);
+        }
+    };
+    wheel.schedule(start, chain);
+    for (int ms = 0; ms <= 60; ms++) {
+        advance(wheel, start + milliseconds(ms));
+    }
+    CHECK_EQ(fired, 5);
+}
+
+TEST_MAIN()
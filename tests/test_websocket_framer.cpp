@@ -0,0 +1,208 @@
+#include "test_support.h"
+#include <random>
+
+// WebSocketFramer: client/server round trips through every read size,
+// fragmentation with interleaved control frames, protocol violations and
+// limits, the vectorized masking against a byte loop, and permessage-deflate.
+
+namespace {
+
+using tcp::BufferView;
+using tcp::ByteView;
+using tcp::WebSocketFramer;
+using Opcode = WebSocketFramer::Opcode;
+using Role = WebSocketFramer::Role;
+
+struct Received {
+    Opcode opcode;
+    std::string payload;
+    
+    bool operator==(const Received& other) const { return opcode == other.opcode && payload == other.payload; }
+};
+
+std::vector<Received> decodeInReads(WebSocketFramer& framer, const std::vector<uint8_t>& stream, size_t readSize) {
+    std::vector<Received> received;
+    for (size_t offset = 0; offset < stream.size(); offset += readSize) {
+        size_t length = std::min(readSize, stream.size() - offset);
+        framer.unframe(tcp_test::block(stream.data() + offset, length), [&received](Opcode opcode, const BufferView& payload) {
+            received.push_back({opcode, payload.toString()});
+        });
+    }
+    return received;
+}
+
+void append(std::vector<uint8_t>& stream, const BufferView& frame) {
+    stream.insert(stream.end(), frame.begin(), frame.end());
+}
+
+} // namespace
+
+TEST(client_to_server_round_trip_at_every_read_size) {
+    // Payload lengths on both sides of the 7-bit and 16-bit length encodings
+    const std::vector<Received> messages = {
+        {Opcode::Text, "hello"},
+        {Opcode::Binary, std::string(125, 'a')},
+        {Opcode::Binary, std::string(126, 'b')},
+        {Opcode::Text, std::string(70000, 'c')},
+        {Opcode::Text, ""},
+    };
+    
+    WebSocketFramer client(Role::Client);
+    std::vector<uint8_t> stream;
+    for (const Received& message : messages) {
+        append(stream, client.encode(message.opcode, ByteView(message.payload)));
+    }
+    
+    for (size_t readSize : {1, 2, 3, 7, 13, 125, 4096, 65536, 1 << 20}) {
+        WebSocketFramer server(Role::Server);
+        CHECK(decodeInReads(server, stream, readSize) == messages);
+        CHECK(!server.hasError());
+    }
+}
+
+TEST(server_frames_are_unmasked) {
+    WebSocketFramer server(Role::Server);
+    BufferView frame = server.encode(Opcode::Text, ByteView(std::string("hi")));
+    CHECK(frame.toVector() == std::vector<uint8_t>({0x81, 0x02, 'h', 'i'}));
+    
+    WebSocketFramer client(Role::Client);
+    std::vector<uint8_t> stream;
+    append(stream, frame);
+    CHECK(decodeInReads(client, stream, 1) == std::vector<Received>({{Opcode::Text, "hi"}}));
+}
+
+TEST(fragments_reassemble_around_control_frames) {
+    WebSocketFramer client(Role::Client);
+    std::vector<uint8_t> stream;
+    append(stream, client.encode(Opcode::Text, ByteView(std::string("frag")), false));
+    append(stream, client.encode(Opcode::Ping, ByteView(std::string("p1"))));
+    append(stream, client.encode(Opcode::Continuation, ByteView(std::string("men")), false));
+    append(stream, client.encode(Opcode::Continuation, ByteView(std::string("ted")), true));
+    append(stream, client.encodeClose(1000, "bye"));
+    
+    for (size_t readSize : {1, 5, 4096}) {
+        WebSocketFramer server(Role::Server);
+        std::vector<Received> received = decodeInReads(server, stream, readSize);
+        CHECK_EQ(received.size(), 3u);
+        if (received.size() == 3) {
+            CHECK(received[0] == (Received{Opcode::Ping, "p1"}));
+            CHECK(received[1] == (Received{Opcode::Text, "fragmented"}));
+            CHECK(received[2].opcode == Opcode::Close);
+            CHECK_EQ(received[2].payload, std::string("\x03\xE8" "bye", 5));
+        }
+        CHECK(server.isClosed());
+    }
+}
+
+TEST(protocol_violations_fail_with_1002) {
+    // Unmasked frame to a server
+    WebSocketFramer server(Role::Server);
+    std::vector<uint8_t> unmasked = {0x81, 0x01, 'x'};
+    decodeInReads(server, unmasked, 3);
+    CHECK(server.getError() == WebSocketFramer::Error::ProtocolError);
+    CHECK_EQ(server.getCloseCode(), 1002);
+    
+    // Continuation with no message in progress, and a fragmented Ping
+    WebSocketFramer client(Role::Client);
+    for (const std::vector<uint8_t>& frame : {std::vector<uint8_t>{0x80, 0x00}, std::vector<uint8_t>{0x09, 0x00}}) {
+        WebSocketFramer receiver(Role::Client);
+        decodeInReads(receiver, frame, frame.size());
+        CHECK(receiver.getError() == WebSocketFramer::Error::ProtocolError);
+    }
+    
+    // Reserved opcode
+    WebSocketFramer reserved(Role::Client);
+    decodeInReads(reserved, std::vector<uint8_t>{0x83, 0x00}, 2);
+    CHECK(reserved.hasError());
+    
+    // Text while a fragmented message is open
+    std::vector<uint8_t> stream;
+    append(stream, client.encode(Opcode::Text, ByteView(std::string("a")), false));
+    append(stream, client.encode(Opcode::Text, ByteView(std::string("b"))));
+    WebSocketFramer interleaved(Role::Server);
+    decodeInReads(interleaved, stream, stream.size());
+    CHECK(interleaved.getError() == WebSocketFramer::Error::ProtocolError);
+}
+
+TEST(oversized_messages_fail_with_1009) {
+    WebSocketFramer client(Role::Client);
+    std::vector<uint8_t> stream;
+    append(stream, client.encode(Opcode::Binary, ByteView(std::string(600, 'z'))));
+    
+    WebSocketFramer server(Role::Server);
+    server.setMaxMessageSize(512);
+    decodeInReads(server, stream, 100);
+    CHECK(server.getError() == WebSocketFramer::Error::MessageTooBig);
+    CHECK_EQ(server.getCloseCode(), 1009);
+    
+    // Reassembly counts every fragment
+    stream.clear();
+    append(stream, client.encode(Opcode::Binary, ByteView(std::string(300, 'z')), false));
+    append(stream, client.encode(Opcode::Continuation, ByteView(std::string(300, 'z'))));
+    WebSocketFramer fragments(Role::Server);
+    fragments.setMaxMessageSize(512);
+    decodeInReads(fragments, stream, stream.size());
+    CHECK(fragments.getError() == WebSocketFramer::Error::MessageTooBig);
+}
+
+TEST(mask_matches_byte_loop_at_every_length_and_offset) {
+    std::mt19937 random(42);
+    const uint8_t key[4] = {0x12, 0x34, 0x56, 0x78};
+    for (size_t length = 0; length <= 100; length++) {
+        for (size_t keyOffset = 0; keyOffset < 4; keyOffset++) {
+            for (size_t misalign = 0; misalign < 3; misalign++) {
+                std::vector<uint8_t> source(length + misalign);
+                for (uint8_t& byte : source) {
+                    byte = static_cast<uint8_t>(random());
+                }
+                std::vector<uint8_t> expected(source.begin() + misalign, source.end());
+                for (size_t i = 0; i < length; i++) {
+                    expected[i] ^= key[(keyOffset + i) % 4];
+                }
+                
+                std::vector<uint8_t> copied(length + 1, 0xEE);
+                WebSocketFramer::copyMasked(copied.data(), source.data() + misalign, length, key, keyOffset);
+                CHECK(std::equal(expected.begin(), expected.end(), copied.begin()));
+                CHECK_EQ(copied[length], 0xEE); // Nothing past the end
+                
+                WebSocketFramer::applyMask(source.data() + misalign, length, key, keyOffset);
+                CHECK(std::equal(expected.begin(), expected.end(), source.begin() + misalign));
+            }
+        }
+    }
+}
+
+TEST(permessage_deflate_round_trip) {
+    if (!WebSocketFramer::isDeflateSupported()) {
+        return;
+    }
+    
+    WebSocketFramer client(Role::Client);
+    WebSocketFramer server(Role::Server);
+    std::string accepted = server.negotiateDeflate(WebSocketFramer::deflateOffer());
+    CHECK(!accepted.empty());
+    CHECK(!client.negotiateDeflate(accepted).empty());
+    CHECK(client.isDeflateEnabled() && server.isDeflateEnabled());
+    
+    // Repetitive text compresses; context carries over between messages
+    std::string text;
+    for (int i = 0; i < 200; i++) {
+        text += "the quick brown fox " + std::to_string(i % 10) + " ";
+    }
+    std::vector<uint8_t> stream;
+    for (int i = 0; i < 3; i++) {
+        BufferView frame = client.encode(Opcode::Text, ByteView(text));
+        CHECK(frame.size() < text.size() / 2);
+        append(stream, frame);
+    }
+    append(stream, client.encode(Opcode::Text, ByteView(std::string("tiny")))); // Under the threshold
+    
+    std::vector<Received> received = decodeInReads(server, stream, 17);
+    CHECK_EQ(received.size(), 4u);
+    for (size_t i = 0; i < received.size(); i++) {
+        CHECK_EQ(received[i].payload, i < 3 ? text : std::string("tiny"));
+    }
+    CHECK(!server.hasError());
+}
+
+TEST_MAIN()
@@ -0,0 +1,290 @@
+#include "timer_wheel.h"
+#include <algorithm>
+#include <climits>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace tcp {
+
+namespace {
+
+constexpr uint64_t kSlotMask = TimerWheel::kSlots - 1;
+
+int countTrailingZeros(uint64_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(bits);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return static_cast<int>(index);
+#else
+    int count = 0;
+    while ((bits & 1) == 0) {
+        bits >>= 1;
+        count++;
+    }
+    return count;
+#endif
+}
+
+} // namespace
+
+TimerWheel::TimerWheel(std::chrono::milliseconds resolution, Clock::time_point start)
+    : resolution_(std::max(resolution, std::chrono::milliseconds(1))), start_(start),
+      currentTick_(0), count_(0) {
+    heads_.fill(kNil);
+    tails_.fill(kNil);
+    occupied_.fill(0);
+}
+
+TimerId TimerWheel::schedule(Clock::time_point when, Callback callback, std::chrono::milliseconds interval) {
+    uint32_t index;
+    if (!freeNodes_.empty()) {
+        index = freeNodes_.back();
+        freeNodes_.pop_back();
+    } else {
+        index = static_cast<uint32_t>(nodes_.size());
+        nodes_.emplace_back();
+    }
+
+    Node& node = nodes_[index];
+    node.callback = std::move(callback);
+    node.expires = std::max(tickAt(when, true), currentTick_ + 1);
+    node.interval = 0;
+    if (interval.count() > 0) {
+        node.interval = static_cast<uint64_t>((interval + resolution_ - std::chrono::milliseconds(1)) / resolution_);
+    }
+    node.active = true;
+    link(index);
+    count_++;
+
+    return (static_cast<uint64_t>(node.generation) << 32) | (index + 1);
+}
+
+bool TimerWheel::cancel(TimerId id, Callback* removed) {
+    if (!isScheduled(id)) {
+        return false;
+    }
+
+    uint32_t index = static_cast<uint32_t>(id) - 1;
+    unlink(index);
+    if (removed) {
+        *removed = std::move(nodes_[index].callback);
+    }
+    release(index);
+    count_--;
+    return true;
+}
+
+bool TimerWheel::isScheduled(TimerId id) const {
+    uint32_t index = static_cast<uint32_t>(id) - 1;
+    return index < nodes_.size() && nodes_[index].active &&
+           nodes_[index].generation == static_cast<uint32_t>(id >> 32);
+}
+
+size_t TimerWheel::advance(Clock::time_point now, std::vector<Callback>& expired) {
+    uint64_t target = tickAt(now, false);
+    size_t before = expired.size();
+
+    while (currentTick_ < target) {
+        if (count_ == 0) {
+            currentTick_ = target;
+            break;
+        }
+
+        // Jump straight to the next tick with a timer or a non-empty cascade
+        uint64_t next = nextExpiryBound();
+        if (next > target) {
+            currentTick_ = target;
+            break;
+        }
+        currentTick_ = next;
+
+        // A wrapped level pulls the next slot of the level above down into it
+        if ((currentTick_ & kSlotMask) == 0) {
+            for (int level = 1; level < kLevels && cascade(level) == 0; level++) {
+            }
+        }
+        expire(target, expired);
+    }
+
+    return expired.size() - before;
+}
+
+int TimerWheel::timeUntilNext(Clock::time_point now) const {
+    if (count_ == 0) {
+        return -1;
+    }
+
+    Clock::time_point deadline = start_ + resolution_ * static_cast<int64_t>(nextExpiryBound());
+    if (deadline <= now) {
+        return 0;
+    }
+    auto wait = std::chrono::ceil<std::chrono::milliseconds>(deadline - now);
+    return static_cast<int>(std::min<int64_t>(wait.count(), INT_MAX));
+}
+
+uint64_t TimerWheel::tickAt(Clock::time_point when, bool roundUp) const {
+    if (when <= start_) {
+        return 0;
+    }
+    Clock::duration elapsed = when - start_;
+    uint64_t ticks = static_cast<uint64_t>(elapsed / resolution_);
+    if (roundUp && elapsed % resolution_ != Clock::duration::zero()) {
+        ticks++;
+    }
+    return ticks;
+}
+
+void TimerWheel::link(uint32_t index) {
+    Node& node = nodes_[index];
+    uint64_t delta = node.expires - currentTick_;
+
+    int level = 0;
+    while (level < kLevels - 1 && delta >= (uint64_t(1) << (kSlotBits * (level + 1)))) {
+        level++;
+    }
+
+    uint64_t slot;
+    if (delta >> (kSlotBits * kLevels)) {
+        // Beyond the wheel: park in the last top-level slot to come round,
+        // which places it again when it cascades
+        slot = ((currentTick_ >> (kSlotBits * (kLevels - 1))) + kSlotMask) & kSlotMask;
+    } else {
+        slot = (node.expires >> (kSlotBits * level)) & kSlotMask;
+    }
+
+    size_t bucket = level * kSlots + slot;
+    node.bucket = static_cast<uint16_t>(bucket);
+    node.next = kNil;
+    node.prev = tails_[bucket];
+    if (node.prev != kNil) {
+        nodes_[node.prev].next = index;
+    } else {
+        heads_[bucket] = index;
+        occupied_[bucket / 64] |= uint64_t(1) << (bucket % 64);
+    }
+    tails_[bucket] = index;
+}
+
+void TimerWheel::unlink(uint32_t index) {
+    Node& node = nodes_[index];
+    size_t bucket = node.bucket;
+
+    if (node.prev != kNil) {
+        nodes_[node.prev].next = node.next;
+    } else {
+        heads_[bucket] = node.next;
+    }
+    if (node.next != kNil) {
+        nodes_[node.next].prev = node.prev;
+    } else {
+        tails_[bucket] = node.prev;
+    }
+
+    if (heads_[bucket] == kNil) {
+        occupied_[bucket / 64] &= ~(uint64_t(1) << (bucket % 64));
+    }
+    node.prev = kNil;
+    node.next = kNil;
+}
+
+void TimerWheel::release(uint32_t index) {
+    Node& node = nodes_[index];
+    node.callback = nullptr;
+    node.active = false;
+    node.generation++;
+    freeNodes_.push_back(index);
+}
+
+int TimerWheel::cascade(int level) {
+    int slot = static_cast<int>((currentTick_ >> (kSlotBits * level)) & kSlotMask);
+    size_t bucket = level * kSlots + slot;
+
+    uint32_t index = heads_[bucket];
+    heads_[bucket] = kNil;
+    tails_[bucket] = kNil;
+    occupied_[bucket / 64] &= ~(uint64_t(1) << (bucket % 64));
+
+    while (index != kNil) {
+        uint32_t next = nodes_[index].next;
+        link(index);
+        index = next;
+    }
+    return slot;
+}
+
+void TimerWheel::expire(uint64_t target, std::vector<Callback>& expired) {
+    size_t bucket = currentTick_ & kSlotMask;
+
+    while (heads_[bucket] != kNil) {
+        uint32_t index = heads_[bucket];
+        unlink(index);
+        Node& node = nodes_[index];
+
+        if (node.interval == 0) {
+            expired.push_back(std::move(node.callback));
+            release(index);
+            count_--;
+            continue;
+        }
+
+        // Re-arm on the original phase, past everything this advance covers
+        expired.push_back(node.callback);
+        node.expires = currentTick_ + node.interval;
+        if (node.expires <= target) {
+            node.expires += ((target - node.expires) / node.interval + 1) * node.interval;
+        }
+        link(index);
+    }
+}
+
+int TimerWheel::findOccupied(int level, size_t from) const {
+    for (size_t word = from / 64; word < kWords; word++) {
+        uint64_t bits = occupied_[level * kWords + word];
+        if (word == from / 64) {
+            bits &= ~uint64_t(0) << (from % 64);
+        }
+        if (bits != 0) {
+            return static_cast<int>(word * 64 + countTrailingZeros(bits));
+        }
+    }
+    return -1;
+}
+
+uint64_t TimerWheel::nextExpiryBound() const {
+    // The rest of this turn of the first level is exact
+    int slot = findOccupied(0, (currentTick_ & kSlotMask) + 1);
+    if (slot >= 0) {
+        return (currentTick_ & ~kSlotMask) + slot;
+    }
+
+    uint64_t bound = UINT64_MAX;
+    slot = findOccupied(0, 0);
+    if (slot >= 0) {
+        bound = (currentTick_ & ~kSlotMask) + kSlots + slot;
+    }
+
+    // Timers on higher levels expire no earlier than their slot cascades
+    for (int level = 1; level < kLevels; level++) {
+        int shift = kSlotBits * level;
+        uint64_t current = (currentTick_ >> shift) & kSlotMask;
+        uint64_t distance;
+        slot = findOccupied(level, current + 1);
+        if (slot >= 0) {
+            distance = slot - current;
+        } else {
+            slot = findOccupied(level, 0);
+            if (slot < 0) {
+                continue;
+            }
+            distance = slot + kSlots - current;
+        }
+        bound = std::min(bound, ((currentTick_ >> shift) + distance) << shift);
+    }
+    return bound;
+}
+
+} // namespace tcp
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace tcp {
+
+// Scheduled timer handle. Never reused, so cancelling a timer that already
+// fired is harmless; 0 is never a valid id.
+using TimerId = uint64_t;
+
+// Hierarchical timing wheel (Varghese & Lauck) with four levels of 256
+// slots. Schedule and cancel are O(1); timers due beyond the first level
+// cascade down as the wheel turns, each at most once per level. Timers are
+// kept in a slab of intrusive lists, so a steady population schedules
+// without allocating beyond its callbacks. Not thread-safe: EventLoop
+// guards its wheel and runs the callbacks.
+class TimerWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Callback = std::function<void()>;
+
+    static constexpr int kLevels = 4;
+    static constexpr int kSlotBits = 8;
+    static constexpr size_t kSlots = size_t(1) << kSlotBits;
+
+    explicit TimerWheel(std::chrono::milliseconds resolution = std::chrono::milliseconds(1),
+                        Clock::time_point start = Clock::now());
+
+    // Non-copyable
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    // Fires no earlier than when, rounded up to the resolution. A non-zero
+    // interval re-arms the timer after each expiry until it is cancelled;
+    // one that fell behind skips the missed expiries.
+    TimerId schedule(Clock::time_point when, Callback callback,
+                     std::chrono::milliseconds interval = std::chrono::milliseconds(0));
+    // False if it already fired or was cancelled. The callback is moved to
+    // removed when given, so the caller can destroy it outside its lock.
+    bool cancel(TimerId id, Callback* removed = nullptr);
+    bool isScheduled(TimerId id) const;
+
+    // Turns the wheel to now and appends the callbacks of expired timers in
+    // expiry order (timers due in the same tick in scheduling order).
+    // Returns how many expired.
+    size_t advance(Clock::time_point now, std::vector<Callback>& expired);
+
+    // Milliseconds until the next timer may expire, for a poll timeout; -1
+    // when no timer is scheduled. May be early, never late.
+    int timeUntilNext(Clock::time_point now) const;
+
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+    std::chrono::milliseconds getResolution() const { return resolution_; }
+
+private:
+    static constexpr uint32_t kNil = UINT32_MAX;
+    static constexpr size_t kWords = kSlots / 64;
+
+    struct Node {
+        Callback callback;
+        uint64_t expires = 0;  // Tick
+        uint64_t interval = 0; // Ticks; 0 = one-shot
+        uint32_t prev = kNil;
+        uint32_t next = kNil;
+        uint32_t generation = 0;
+        uint16_t bucket = 0;   // level * kSlots + slot
+        bool active = false;
+    };
+
+    std::chrono::milliseconds resolution_;
+    Clock::time_point start_;
+    uint64_t currentTick_;
+    size_t count_;
+
+    std::vector<Node> nodes_;
+    std::vector<uint32_t> freeNodes_;
+    std::array<uint32_t, kLevels * kSlots> heads_;
+    std::array<uint32_t, kLevels * kSlots> tails_;
+    std::array<uint64_t, kLevels * kWords> occupied_; // One bit per non-empty slot
+
+    uint64_t tickAt(Clock::time_point when, bool roundUp) const;
+    void link(uint32_t index);
+    void unlink(uint32_t index);
+    void release(uint32_t index);
+    int cascade(int level);
+    void expire(uint64_t target, std::vector<Callback>& expired);
+    int findOccupied(int level, size_t from) const; // First non-empty slot >= from, or -1
+    uint64_t nextExpiryBound() const;
+};
+
+} // namespace tcp
@@ -0,0 +1,307 @@
+#include "tls_session.h"
+#include "sigpipe_guard.h"
+#include <cerrno>
+#include <cstring>
+
+namespace tcp {
+
+namespace {
+
+#ifdef TCP_SSL_SUPPORT
+bool isIpAddress(const std::string& host) {
+    unsigned char address[sizeof(struct in6_addr)];
+    return inet_pton(AF_INET, host.c_str(), address) == 1 || inet_pton(AF_INET6, host.c_str(), address) == 1;
+}
+
+SSL* nativeSsl(void* ssl) {
+    return static_cast<SSL*>(ssl);
+}
+#endif
+
+} // namespace
+
+TlsSession::TlsSession()
+    : ssl_(nullptr), role_(Role::Client), state_(State::Failed), wantsWrite_(false),
+      kernelTlsSend_(false), kernelTlsReceive_(false) {
+}
+
+#ifdef TCP_SSL_SUPPORT
+
+TlsSession::~TlsSession() {
+    // Never writes: the socket may already be closed
+    SSL_free(nativeSsl(ssl_));
+}
+
+bool TlsSession::create(std::shared_ptr<SslContext> context, socket_t socket, Role role,
+                        const std::string& serverName, const std::string& peerKey) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!context || !context->isValid() || ssl_) {
+        lastError_ = "Invalid SSL context";
+        return false;
+    }
+
+    SSL* ssl = SSL_new(static_cast<SSL_CTX*>(context->getContext()));
+    if (!ssl) {
+        lastError_ = "Failed to create SSL session: " + SslUtils::getLastSslError();
+        return false;
+    }
+
+    // A socket BIO (rather than a memory BIO) lets OpenSSL switch the socket
+    // to kernel TLS once keys are negotiated
+    if (SSL_set_fd(ssl, static_cast<int>(socket)) != 1) {
+        lastError_ = "Failed to attach socket: " + SslUtils::getLastSslError();
+        SSL_free(ssl);
+        return false;
+    }
+#ifdef SO_NOSIGPIPE
+    int noSigpipe = 1;
+    setsockopt(socket, SOL_SOCKET, SO_NOSIGPIPE, &noSigpipe, sizeof(noSigpipe));
+#endif
+
+    peerKey_ = peerKey;
+    SSL_set_app_data(ssl, &peerKey_);
+
+    if (role == Role::Client) {
+        SSL_set_connect_state(ssl);
+
+        std::string sniName = context->getSniHostname().empty() ? serverName : context->getSniHostname();
+        if (!sniName.empty() && !isIpAddress(sniName)) {
+            SSL_set_tlsext_host_name(ssl, sniName.c_str());
+        }
+
+        if (context->getVerifyMode() != SslContext::VerifyMode::None && !serverName.empty()) {
+            bool hostSet = isIpAddress(serverName)
+                ? X509_VERIFY_PARAM_set1_ip_asc(SSL_get0_param(ssl), serverName.c_str()) == 1
+                : SSL_set1_host(ssl, serverName.c_str()) == 1;
+            if (!hostSet) {
+                lastError_ = "Invalid server name: " + serverName;
+                SSL_free(ssl);
+                return false;
+            }
+        }
+
+        // Offer the last session seen from this peer to skip a full handshake
+        if (!peerKey_.empty()) {
+            if (auto* session = static_cast<SSL_SESSION*>(context->findSession(peerKey_))) {
+                SSL_set_session(ssl, session);
+                SSL_SESSION_free(session);
+            }
+        }
+    } else {
+        SSL_set_accept_state(ssl);
+    }
+
+    context_ = context;
+    ssl_ = ssl;
+    role_ = role;
+    state_ = State::Handshaking;
+    return true;
+}
+
+TlsSession::Status TlsSession::handshake() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return handshakeLocked();
+}
+
+TlsSession::Status TlsSession::read(void* buffer, size_t length, size_t& bytesRead) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    bytesRead = 0;
+
+    Status status = handshakeLocked();
+    if (status != Status::Ok) {
+        return status;
+    }
+
+    SigpipeGuard guard;
+    ERR_clear_error();
+    int result = SSL_read_ex(nativeSsl(ssl_), buffer, length, &bytesRead);
+    if (result == 1) {
+        wantsWrite_ = false;
+        return Status::Ok;
+    }
+    return translateError(result);
+}
+
+TlsSession::Status TlsSession::write(const void* data, size_t length, size_t& bytesWritten) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    bytesWritten = 0;
+
+    Status status = handshakeLocked();
+    if (status != Status::Ok || length == 0) {
+        return status;
+    }
+
+    SigpipeGuard guard;
+    ERR_clear_error();
+    int result = SSL_write_ex(nativeSsl(ssl_), data, length, &bytesWritten);
+    if (result == 1) {
+        wantsWrite_ = false;
+        return Status::Ok;
+    }
+    return translateError(result);
+}
+
+void TlsSession::shutdown() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (state_ == State::Established) {
+        SigpipeGuard guard;
+        ERR_clear_error();
+        SSL_shutdown(nativeSsl(ssl_));
+    }
+    if (state_ != State::Failed) {
+        state_ = State::Closed;
+    }
+}
+
+bool TlsSession::hasPendingData() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return ssl_ && state_ == State::Established && SSL_pending(nativeSsl(ssl_)) > 0;
+}
+
+bool TlsSession::isSessionReused() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return ssl_ && SSL_session_reused(nativeSsl(ssl_)) == 1;
+}
+
+SslConnectionInfo TlsSession::getConnectionInfo() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    SslConnectionInfo info{};
+    if (!ssl_) {
+        return info;
+    }
+
+    SSL* ssl = nativeSsl(ssl_);
+    info.protocol = SSL_get_version(ssl);
+    info.cipher = SSL_get_cipher_name(ssl);
+    info.cipherBits = std::to_string(SSL_get_cipher_bits(ssl, nullptr));
+    info.alpnProtocols = context_->getAlpnProtocols();
+
+    const unsigned char* alpn = nullptr;
+    unsigned int alpnLength = 0;
+    SSL_get0_alpn_selected(ssl, &alpn, &alpnLength);
+    if (alpn) {
+        info.selectedAlpnProtocol.assign(reinterpret_cast<const char*>(alpn), alpnLength);
+    }
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    X509* peer = SSL_get1_peer_certificate(ssl);
+#else
+    X509* peer = SSL_get_peer_certificate(ssl);
+#endif
+    if (peer) {
+        BIO* bio = BIO_new(BIO_s_mem());
+        PEM_write_bio_X509(bio, peer);
+        char* data = nullptr;
+        long size = BIO_get_mem_data(bio, &data);
+        if (size > 0) {
+            info.peerCertificate.assign(data, size);
+            info.certificateInfo = SslUtils::parseCertificate(std::vector<uint8_t>(data, data + size));
+        }
+        BIO_free(bio);
+        X509_free(peer);
+    }
+    info.isVerified = peer && SSL_get_verify_result(ssl) == X509_V_OK;
+    return info;
+}
+
+std::string TlsSession::getLastError() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lastError_;
+}
+
+TlsSession::Status TlsSession::handshakeLocked() {
+    switch (state_.load()) {
+        case State::Established: return Status::Ok;
+        case State::Closed: return Status::Closed;
+        case State::Failed: return Status::Failed;
+        default: break;
+    }
+
+    int result;
+    {
+        SigpipeGuard guard;
+        ERR_clear_error();
+        result = SSL_do_handshake(nativeSsl(ssl_));
+    }
+    if (result == 1) {
+        onEstablished();
+        return Status::Ok;
+    }
+
+    Status status = translateError(result);
+    if (status == Status::Failed) {
+        long verifyResult = SSL_get_verify_result(nativeSsl(ssl_));
+        if (verifyResult != X509_V_OK) {
+            lastError_ = std::string("Certificate verification failed: ") + X509_verify_cert_error_string(verifyResult);
+        }
+    }
+    return status;
+}
+
+TlsSession::Status TlsSession::translateError(int result) {
+    int error = SSL_get_error(nativeSsl(ssl_), result);
+    switch (error) {
+        case SSL_ERROR_WANT_READ:
+            wantsWrite_ = false;
+            return Status::WantRead;
+        case SSL_ERROR_WANT_WRITE:
+            wantsWrite_ = true;
+            return Status::WantWrite;
+        case SSL_ERROR_ZERO_RETURN:
+            state_ = State::Closed;
+            return Status::Closed;
+        default:
+            break;
+    }
+
+    // A peer that drops the TCP connection without close_notify
+    unsigned long reason = ERR_peek_error();
+    bool unexpectedEof = (error == SSL_ERROR_SYSCALL && reason == 0 && errno == 0);
+#ifdef SSL_R_UNEXPECTED_EOF_WHILE_READING
+    unexpectedEof = unexpectedEof || (error == SSL_ERROR_SSL && ERR_GET_REASON(reason) == SSL_R_UNEXPECTED_EOF_WHILE_READING);
+#endif
+    if (unexpectedEof) {
+        ERR_clear_error();
+        state_ = State::Closed;
+        return Status::Closed;
+    }
+
+    lastError_ = error == SSL_ERROR_SYSCALL && reason == 0
+        ? std::string("TLS socket error: ") + std::strerror(errno)
+        : "TLS error: " + SslUtils::getLastSslError();
+    state_ = State::Failed;
+    return Status::Failed;
+}
+
+void TlsSession::onEstablished() {
+    SSL* ssl = nativeSsl(ssl_);
+    kernelTlsSend_ = BIO_get_ktls_send(SSL_get_wbio(ssl)) > 0;
+    kernelTlsReceive_ = BIO_get_ktls_recv(SSL_get_rbio(ssl)) > 0;
+
+    // Published last: readers check isEstablished() before the kTLS flags
+    wantsWrite_ = false;
+    state_ = State::Established;
+}
+
+#else // !TCP_SSL_SUPPORT
+
+TlsSession::~TlsSession() = default;
+
+bool TlsSession::create(std::shared_ptr<SslContext>, socket_t, Role, const std::string&, const std::string&) {
+    lastError_ = "SSL/TLS support not compiled in";
+    return false;
+}
+
+TlsSession::Status TlsSession::handshake() { return Status::Failed; }
+TlsSession::Status TlsSession::read(void*, size_t, size_t& bytesRead) { bytesRead = 0; return Status::Failed; }
+TlsSession::Status TlsSession::write(const void*, size_t, size_t& bytesWritten) { bytesWritten = 0; return Status::Failed; }
+void TlsSession::shutdown() {}
+bool TlsSession::hasPendingData() const { return false; }
+bool TlsSession::isSessionReused() const { return false; }
+SslConnectionInfo TlsSession::getConnectionInfo() const { return SslConnectionInfo{}; }
+std::string TlsSession::getLastError() const { return lastError_; }
+
+#endif // TCP_SSL_SUPPORT
+
+} // namespace tcp
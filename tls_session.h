@@ -0,0 +1,93 @@
+#pragma once
+
+#include "tcp_socket.h"
+#include "ssl_context.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace tcp {
+
+// Non-blocking TLS over a connected socket. The handshake is a state
+// machine: every call returns at once, and WantRead/WantWrite say which
+// readiness to wait for before calling again. Reads and writes may come from
+// different threads; calls are serialized on the session's own mutex, which
+// is only held for the duration of one non-blocking OpenSSL call.
+class TlsSession {
+public:
+    enum class Role {
+        Client,
+        Server
+    };
+
+    enum class State {
+        Handshaking,
+        Established,
+        Closed,   // close_notify sent or received
+        Failed
+    };
+
+    enum class Status {
+        Ok,
+        WantRead,   // Retry once the socket is readable
+        WantWrite,  // Retry once the socket is writable
+        Closed,     // Peer closed the TLS stream
+        Failed      // Protocol or verification error; see getLastError()
+    };
+
+    TlsSession();
+    ~TlsSession();
+
+    // Non-copyable
+    TlsSession(const TlsSession&) = delete;
+    TlsSession& operator=(const TlsSession&) = delete;
+
+    // The socket must stay open for the session's lifetime. Clients pass the
+    // host name for SNI and certificate checks, and a peer key ("host:port")
+    // under which sessions are cached for resumption.
+    bool create(std::shared_ptr<SslContext> context, socket_t socket, Role role,
+                const std::string& serverName = "", const std::string& peerKey = "");
+
+    // Advances the handshake; Ok once it is complete
+    Status handshake();
+
+    // Data transfer. Both drive a pending handshake first.
+    Status read(void* buffer, size_t length, size_t& bytesRead);
+    Status write(const void* data, size_t length, size_t& bytesWritten);
+
+    // Sends close_notify without waiting for the peer's reply. Later calls
+    // return Closed and never touch the socket again.
+    void shutdown();
+
+    // Session info
+    State getState() const { return state_; }
+    Role getRole() const { return role_; }
+    bool isEstablished() const { return state_ == State::Established; }
+    bool wantsWrite() const { return wantsWrite_; } // Last call stalled on writability
+    bool hasPendingData() const;                     // Decrypted bytes buffered inside OpenSSL
+    bool isSessionReused() const;
+    bool isKernelTlsSend() const { return kernelTlsSend_; }
+    bool isKernelTlsReceive() const { return kernelTlsReceive_; }
+    SslConnectionInfo getConnectionInfo() const;
+    std::string getLastError() const;
+
+private:
+    std::shared_ptr<SslContext> context_;
+    void* ssl_; // SSL* handle
+    Role role_;
+    std::string peerKey_; // Referenced by the SSL's app data
+    std::atomic<State> state_;
+    std::atomic<bool> wantsWrite_;
+    bool kernelTlsSend_;
+    bool kernelTlsReceive_;
+    std::string lastError_;
+    mutable std::mutex mutex_;
+
+    // Internal methods (mutex_ held)
+    Status handshakeLocked();
+    Status translateError(int result);
+    void onEstablished();
+};
+
+} // namespace tcp
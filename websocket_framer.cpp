@@ -0,0 +1,736 @@
+#include "websocket_framer.h"
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+#ifdef TCP_ZLIB_SUPPORT
+#include <zlib.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define TCP_WEBSOCKET_SSE2 1
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+    #include <arm_neon.h>
+    #define TCP_WEBSOCKET_NEON 1
+#endif
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#endif
+
+namespace tcp {
+
+namespace {
+
+// Close codes (RFC 6455 section 7.4.1)
+constexpr uint16_t kCloseNormal = 1000;
+constexpr uint16_t kCloseProtocolError = 1002;
+constexpr uint16_t kCloseInvalidPayload = 1007;
+constexpr uint16_t kCloseMessageTooBig = 1009;
+
+constexpr size_t kMaxControlPayload = 125;
+constexpr size_t kDefaultCompressionThreshold = 64;
+
+// Every permessage-deflate message ends in an empty stored block, which
+// the sender strips and the receiver adds back (RFC 7692 section 7.2)
+const uint8_t kDeflateTail[4] = {0x00, 0x00, 0xFF, 0xFF};
+
+bool isControl(uint8_t opcode) {
+    return (opcode & 0x8) != 0;
+}
+
+bool isData(uint8_t opcode) {
+    return opcode == static_cast<uint8_t>(WebSocketFramer::Opcode::Text) ||
+           opcode == static_cast<uint8_t>(WebSocketFramer::Opcode::Binary);
+}
+
+uint32_t randomMaskKey() {
+    thread_local std::mt19937 engine(std::random_device{}());
+    return static_cast<uint32_t>(engine());
+}
+
+#ifdef TCP_ZLIB_SUPPORT
+// Extension header parsing
+std::string trim(const std::string& value) {
+    size_t begin = value.find_first_not_of(" \t");
+    if (begin == std::string::npos) {
+        return std::string();
+    }
+    size_t end = value.find_last_not_of(" \t");
+    return value.substr(begin, end - begin + 1);
+}
+
+std::vector<std::string> split(const std::string& value, char separator) {
+    std::vector<std::string> parts;
+    size_t start = 0;
+    for (;;) {
+        size_t end = value.find(separator, start);
+        parts.push_back(trim(value.substr(start, end == std::string::npos ? std::string::npos : end - start)));
+        if (end == std::string::npos) {
+            return parts;
+        }
+        start = end + 1;
+    }
+}
+
+// Window bits parameter value, unquoted; 0 if absent or out of range
+int parseWindowBits(const std::string& value) {
+    std::string digits = value;
+    if (digits.size() >= 2 && digits.front() == '"' && digits.back() == '"') {
+        digits = digits.substr(1, digits.size() - 2);
+    }
+    bool numeric = std::all_of(digits.begin(), digits.end(), [](char c) { return c >= '0' && c <= '9'; });
+    if (digits.empty() || digits.size() > 2 || !numeric) {
+        return 0;
+    }
+    int bits = std::stoi(digits);
+    return bits >= 8 && bits <= 15 ? bits : 0;
+}
+#endif
+
+} // namespace
+
+// zlib streams for permessage-deflate: ours compresses, the peer's inflates
+struct WebSocketFramer::Deflate {
+#ifdef TCP_ZLIB_SUPPORT
+    z_stream deflater;
+    z_stream inflater;
+    bool noContextTakeover; // Our side starts each message afresh
+    bool initialized;
+
+    Deflate(int windowBits, bool noTakeover) : noContextTakeover(noTakeover), initialized(false) {
+        std::memset(&deflater, 0, sizeof(deflater));
+        std::memset(&inflater, 0, sizeof(inflater));
+        // Negative window bits: raw deflate, no zlib header
+        if (deflateInit2(&deflater, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -windowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            return;
+        }
+        if (inflateInit2(&inflater, -15) != Z_OK) {
+            deflateEnd(&deflater);
+            return;
+        }
+        initialized = true;
+    }
+
+    ~Deflate() {
+        if (initialized) {
+            deflateEnd(&deflater);
+            inflateEnd(&inflater);
+        }
+    }
+
+    void reset() {
+        deflateReset(&deflater);
+        inflateReset(&inflater);
+    }
+#else
+    void reset() {}
+#endif
+};
+
+WebSocketFramer::WebSocketFramer(Role role)
+    : role_(role), maxMessageSize_(kDefaultMaxMessageSize), compressionThreshold_(kDefaultCompressionThreshold),
+      error_(Error::None), closed_(false), headerSize_(0), inFrame_(false), payloadRead_(0),
+      inMessage_(false), messageOpcode_(Opcode::Binary), messageCompressed_(false), messageSize_(0),
+      controlSize_(0) {
+}
+
+WebSocketFramer::~WebSocketFramer() = default;
+
+std::vector<uint8_t> WebSocketFramer::frame(const std::vector<uint8_t>& data) {
+    return encode(Opcode::Binary, ByteView(data)).toVector();
+}
+
+std::vector<std::vector<uint8_t>> WebSocketFramer::unframe(const std::vector<uint8_t>& data) {
+    std::vector<std::vector<uint8_t>> messages;
+    unframe(ByteView(data), [this, &messages](Opcode opcode, const BufferView& payload) {
+        if (isControl(static_cast<uint8_t>(opcode))) {
+            if (onControl_) {
+                onControl_(opcode, payload);
+            }
+            return;
+        }
+        messages.push_back(payload.toVector());
+    });
+    return messages;
+}
+
+void WebSocketFramer::appendFrame(const ByteView& message, std::vector<uint8_t>& out) {
+    BufferView frame = encode(Opcode::Binary, message);
+    out.insert(out.end(), frame.begin(), frame.end());
+}
+
+size_t WebSocketFramer::decodeFrames(const BufferView& data, const BufferFrameCallback& onFrame) {
+    size_t messages = 0;
+    unframe(data, [this, &onFrame, &messages](Opcode opcode, const BufferView& payload) {
+        if (isControl(static_cast<uint8_t>(opcode))) {
+            if (onControl_) {
+                onControl_(opcode, payload);
+            }
+            return;
+        }
+        onFrame(payload);
+        messages++;
+    });
+    return messages;
+}
+
+bool WebSocketFramer::isComplete(const std::vector<uint8_t>& data) {
+    FrameHeader header;
+    size_t used = parseHeader(data.data(), data.size(), header);
+    return used > 0 && data.size() - used >= header.length;
+}
+
+void WebSocketFramer::reset() {
+    error_ = Error::None;
+    closed_ = false;
+    headerSize_ = 0;
+    inFrame_ = false;
+    payloadRead_ = 0;
+    inMessage_ = false;
+    messageCompressed_ = false;
+    message_.reset();
+    messageSize_ = 0;
+    controlSize_ = 0;
+    if (deflate_) {
+        deflate_->reset();
+    }
+}
+
+size_t WebSocketFramer::unframe(const ByteView& data, const MessageCallback& onMessage) {
+    // Unmasking needs a block of our own
+    Buffer block = BufferPool::shared().acquire(data.size());
+    if (!data.empty()) {
+        std::memcpy(block.data(), data.data(), data.size());
+    }
+    block.setSize(data.size());
+    return unframe(BufferView(std::move(block)), onMessage);
+}
+
+size_t WebSocketFramer::unframe(const BufferView& data, const MessageCallback& onMessage) {
+    // The view's bytes are ours to unmask
+    uint8_t* input = data.empty() ? nullptr : data.buffer().data() + (data.data() - data.buffer().data());
+    size_t size = data.size();
+    size_t offset = 0;
+    size_t delivered = 0;
+
+    while (error_ == Error::None && !closed_) {
+        if (!inFrame_) {
+            if (offset == size) {
+                break;
+            }
+
+            FrameHeader header;
+            size_t used = headerSize_ == 0 ? parseHeader(input + offset, size - offset, header) : 0;
+            if (used > 0) {
+                offset += used;
+            } else {
+                // Header straddles reads: gather it
+                size_t take = std::min(kMaxHeaderSize - headerSize_, size - offset);
+                std::memcpy(header_ + headerSize_, input + offset, take);
+                used = parseHeader(header_, headerSize_ + take, header);
+                if (used == 0) {
+                    headerSize_ += take;
+                    offset += take;
+                    break;
+                }
+                offset += used - headerSize_;
+                headerSize_ = 0;
+            }
+
+            if (!validate(header)) {
+                break;
+            }
+            frame_ = header;
+            payloadRead_ = 0;
+            inFrame_ = true;
+            if (isData(header.opcode)) {
+                inMessage_ = true;
+                messageOpcode_ = static_cast<Opcode>(header.opcode);
+                messageCompressed_ = (header.rsv & 0x40) != 0;
+                messageSize_ = 0;
+            }
+        }
+
+        size_t available = static_cast<size_t>(std::min<uint64_t>(frame_.length - payloadRead_, size - offset));
+        uint8_t* chunk = input + offset;
+        if (frame_.masked && available > 0) {
+            applyMask(chunk, available, frame_.key, static_cast<size_t>(payloadRead_));
+        }
+
+        // A whole frame that is a whole message (or a control frame) is
+        // delivered from the input; anything else is gathered
+        bool whole = payloadRead_ == 0 && available == frame_.length;
+        bool direct = whole && (isControl(frame_.opcode) || (frame_.fin && isData(frame_.opcode)));
+        BufferView slice;
+        if (direct) {
+            slice = data.slice(offset, available);
+        } else if (isControl(frame_.opcode)) {
+            std::memcpy(control_ + controlSize_, chunk, available);
+            controlSize_ += available;
+        } else {
+            appendMessage(chunk, available);
+        }
+        payloadRead_ += available;
+        offset += available;
+
+        if (payloadRead_ < frame_.length) {
+            break; // The rest comes with later reads
+        }
+        inFrame_ = false;
+        delivered += finishFrame(direct ? &slice : nullptr, onMessage);
+    }
+
+    return delivered;
+}
+
+BufferView WebSocketFramer::encode(Opcode opcode, const ByteView& payload, bool fin) {
+    uint8_t code = static_cast<uint8_t>(opcode);
+    if (fin && deflate_ && isData(code) && payload.size() >= compressionThreshold_) {
+        Buffer compressed;
+        size_t compressedSize = 0;
+        if (compress(payload, compressed, compressedSize)) {
+            return writeFrame(0x80 | 0x40 | code, ByteView(compressed.data(), compressedSize));
+        }
+    }
+    return writeFrame((fin ? 0x80 : 0x00) | code, payload);
+}
+
+BufferView WebSocketFramer::encodeClose(uint16_t code, const std::string& reason) {
+    uint8_t payload[kMaxControlPayload];
+    payload[0] = static_cast<uint8_t>(code >> 8);
+    payload[1] = static_cast<uint8_t>(code);
+    size_t reasonSize = std::min(reason.size(), kMaxControlPayload - 2);
+    std::memcpy(payload + 2, reason.data(), reasonSize);
+    return writeFrame(0x80 | static_cast<uint8_t>(Opcode::Close), ByteView(payload, 2 + reasonSize));
+}
+
+std::string WebSocketFramer::deflateOffer(bool noContextTakeover) {
+    std::string offer = "permessage-deflate; client_max_window_bits";
+    if (noContextTakeover) {
+        offer += "; client_no_context_takeover; server_no_context_takeover";
+    }
+    return offer;
+}
+
+std::string WebSocketFramer::negotiateDeflate(const std::string& extensions) {
+    deflate_.reset();
+#ifndef TCP_ZLIB_SUPPORT
+    (void)extensions;
+    return std::string();
+#else
+    // A server takes the first offer it can honour; a client gets one reply
+    for (const std::string& offer : split(extensions, ',')) {
+        std::vector<std::string> parameters = split(offer, ';');
+        if (parameters.empty() || parameters[0] != "permessage-deflate") {
+            continue;
+        }
+
+        bool serverNoTakeover = false;
+        bool clientNoTakeover = false;
+        int serverBits = 0; // 0: not given, 15 applies
+        int clientBits = 0;
+        bool valid = true;
+        for (size_t i = 1; i < parameters.size() && valid; i++) {
+            size_t equals = parameters[i].find('=');
+            std::string name = trim(parameters[i].substr(0, equals));
+            std::string value = equals == std::string::npos ? std::string() : trim(parameters[i].substr(equals + 1));
+            if (name == "server_no_context_takeover" && value.empty()) {
+                serverNoTakeover = true;
+            } else if (name == "client_no_context_takeover" && value.empty()) {
+                clientNoTakeover = true;
+            } else if (name == "server_max_window_bits") {
+                serverBits = parseWindowBits(value);
+                valid = serverBits != 0;
+            } else if (name == "client_max_window_bits") {
+                // A client offers it bare to say it can honour a limit
+                if (!value.empty()) {
+                    clientBits = parseWindowBits(value);
+                    valid = clientBits != 0;
+                }
+            } else {
+                valid = false;
+            }
+        }
+
+        // zlib's raw deflate can't use a 256-byte window
+        int ourBits = role_ == Role::Server ? serverBits : clientBits;
+        bool ourNoTakeover = role_ == Role::Server ? serverNoTakeover : clientNoTakeover;
+        if (!valid || ourBits == 8) {
+            if (role_ == Role::Client) {
+                return std::string();
+            }
+            continue;
+        }
+
+        std::unique_ptr<Deflate> deflate(new Deflate(ourBits != 0 ? ourBits : 15, ourNoTakeover));
+        if (!deflate->initialized) {
+            return std::string();
+        }
+        deflate_ = std::move(deflate);
+
+        std::string accepted = "permessage-deflate";
+        if (serverNoTakeover) {
+            accepted += "; server_no_context_takeover";
+        }
+        if (clientNoTakeover) {
+            accepted += "; client_no_context_takeover";
+        }
+        if (serverBits != 0) {
+            accepted += "; server_max_window_bits=" + std::to_string(serverBits);
+        }
+        if (clientBits != 0) {
+            accepted += "; client_max_window_bits=" + std::to_string(clientBits);
+        }
+        return accepted;
+    }
+    return std::string();
+#endif
+}
+
+bool WebSocketFramer::isDeflateSupported() {
+#ifdef TCP_ZLIB_SUPPORT
+    return true;
+#else
+    return false;
+#endif
+}
+
+uint16_t WebSocketFramer::getCloseCode() const {
+    switch (error_) {
+        case Error::ProtocolError: return kCloseProtocolError;
+        case Error::MessageTooBig: return kCloseMessageTooBig;
+        case Error::InvalidPayload: return kCloseInvalidPayload;
+        default: return kCloseNormal;
+    }
+}
+
+void WebSocketFramer::applyMask(uint8_t* data, size_t length, const uint8_t key[4], size_t keyOffset) {
+    copyMasked(data, data, length, key, keyOffset);
+}
+
+void WebSocketFramer::copyMasked(uint8_t* destination, const uint8_t* source, size_t length, const uint8_t key[4],
+                                 size_t keyOffset) {
+    // Rotate the key so every block below starts on key byte 0; the blocks
+    // are multiples of four bytes, so the phase never changes
+    uint8_t rotated[4];
+    for (size_t i = 0; i < 4; i++) {
+        rotated[i] = key[(i + keyOffset) & 3];
+    }
+    uint32_t pattern;
+    std::memcpy(&pattern, rotated, sizeof(pattern));
+
+    size_t i = 0;
+#if defined(__AVX2__)
+    __m256i mask32 = _mm256_set1_epi32(static_cast<int>(pattern));
+    for (; i + 32 <= length; i += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i), _mm256_xor_si256(block, mask32));
+    }
+#endif
+#if defined(TCP_WEBSOCKET_SSE2)
+    __m128i mask16 = _mm_set1_epi32(static_cast<int>(pattern));
+    for (; i + 16 <= length; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), _mm_xor_si128(block, mask16));
+    }
+#elif defined(TCP_WEBSOCKET_NEON)
+    uint8x16_t mask16 = vreinterpretq_u8_u32(vdupq_n_u32(pattern));
+    for (; i + 16 <= length; i += 16) {
+        vst1q_u8(destination + i, veorq_u8(vld1q_u8(source + i), mask16));
+    }
+#endif
+    uint64_t mask8 = (static_cast<uint64_t>(pattern) << 32) | pattern;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t block;
+        std::memcpy(&block, source + i, sizeof(block));
+        block ^= mask8;
+        std::memcpy(destination + i, &block, sizeof(block));
+    }
+    for (; i < length; i++) {
+        destination[i] = source[i] ^ rotated[i & 3];
+    }
+}
+
+size_t WebSocketFramer::parseHeader(const uint8_t* data, size_t size, FrameHeader& header) {
+    if (size < 2) {
+        return 0;
+    }
+
+    header.fin = (data[0] & 0x80) != 0;
+    header.rsv = data[0] & 0x70;
+    header.opcode = data[0] & 0x0F;
+    header.masked = (data[1] & 0x80) != 0;
+    header.length = data[1] & 0x7F;
+
+    size_t offset = 2;
+    if (header.length == 126) {
+        if (size < 4) {
+            return 0;
+        }
+        header.length = (static_cast<uint64_t>(data[2]) << 8) | data[3];
+        offset = 4;
+    } else if (header.length == 127) {
+        if (size < 10) {
+            return 0;
+        }
+        header.length = 0;
+        for (size_t i = 2; i < 10; i++) {
+            header.length = (header.length << 8) | data[i];
+        }
+        offset = 10;
+    }
+
+    if (header.masked) {
+        if (size < offset + 4) {
+            return 0;
+        }
+        std::memcpy(header.key, data + offset, 4);
+        offset += 4;
+    }
+    header.size = offset;
+    return offset;
+}
+
+bool WebSocketFramer::validate(const FrameHeader& header) {
+    bool compressed = (header.rsv & 0x40) != 0;
+    bool valid = (header.rsv & 0x30) == 0 &&
+                 (!compressed || (deflate_ && isData(header.opcode))) &&
+                 (header.length >> 63) == 0 &&
+                 header.masked == (role_ == Role::Server);
+
+    if (isControl(header.opcode)) {
+        bool known = header.opcode <= static_cast<uint8_t>(Opcode::Pong);
+        bool closeLength = header.opcode != static_cast<uint8_t>(Opcode::Close) || header.length != 1;
+        valid = valid && known && header.fin && header.length <= kMaxControlPayload && closeLength;
+    } else if (header.opcode == static_cast<uint8_t>(Opcode::Continuation)) {
+        valid = valid && inMessage_;
+    } else {
+        // A new message can't start inside a fragmented one
+        valid = valid && isData(header.opcode) && !inMessage_;
+    }
+
+    if (!valid) {
+        fail(Error::ProtocolError);
+        return false;
+    }
+    if (!isControl(header.opcode) && header.length > maxMessageSize_ - (inMessage_ ? messageSize_ : 0)) {
+        fail(Error::MessageTooBig);
+        return false;
+    }
+    return true;
+}
+
+void WebSocketFramer::fail(Error error) {
+    error_ = error;
+    message_.reset();
+    messageSize_ = 0;
+}
+
+void WebSocketFramer::appendMessage(const uint8_t* data, size_t length) {
+    if (messageSize_ + length > message_.capacity()) {
+        // Grow geometrically; fragments of one message share a block
+        size_t capacity = std::max(messageSize_ + length, message_.capacity() * 2);
+        Buffer grown = BufferPool::shared().acquire(capacity);
+        if (messageSize_ > 0) {
+            std::memcpy(grown.data(), message_.data(), messageSize_);
+        }
+        message_ = std::move(grown);
+    }
+    if (length > 0) {
+        std::memcpy(message_.data() + messageSize_, data, length);
+    }
+    messageSize_ += length;
+    message_.setSize(messageSize_);
+}
+
+size_t WebSocketFramer::finishFrame(const BufferView* direct, const MessageCallback& onMessage) {
+    Opcode opcode = static_cast<Opcode>(frame_.opcode);
+
+    if (isControl(frame_.opcode)) {
+        BufferView payload;
+        if (direct) {
+            payload = *direct;
+        } else {
+            Buffer block = BufferPool::shared().acquire(controlSize_);
+            std::memcpy(block.data(), control_, controlSize_);
+            block.setSize(controlSize_);
+            payload = BufferView(std::move(block));
+        }
+        controlSize_ = 0;
+        if (opcode == Opcode::Close) {
+            closed_ = true;
+        }
+        onMessage(opcode, payload);
+        return 1;
+    }
+
+    if (!frame_.fin) {
+        return 0;
+    }
+
+    BufferView payload;
+    if (messageCompressed_) {
+        const uint8_t* data = direct ? direct->data() : message_.data();
+        size_t length = direct ? direct->size() : messageSize_;
+        Buffer inflated;
+        size_t inflatedSize = 0;
+        if (!decompress(data, length, inflated, inflatedSize)) {
+            return 0;
+        }
+        payload = BufferView(std::move(inflated), 0, inflatedSize);
+    } else if (direct) {
+        payload = *direct;
+    } else {
+        // Hand the reassembly block over; the next message gets a new one
+        payload = BufferView(std::move(message_), 0, messageSize_);
+    }
+
+    message_.reset();
+    messageSize_ = 0;
+    inMessage_ = false;
+    messageCompressed_ = false;
+    onMessage(messageOpcode_, payload);
+    return 1;
+}
+
+BufferView WebSocketFramer::writeFrame(uint8_t firstByte, const ByteView& payload) {
+    size_t length = payload.size();
+    Buffer block = BufferPool::shared().acquire(length + kMaxHeaderSize);
+    uint8_t* out = block.data();
+    size_t offset = 0;
+
+    out[offset++] = firstByte;
+    uint8_t maskBit = role_ == Role::Client ? 0x80 : 0x00;
+    if (length < 126) {
+        out[offset++] = static_cast<uint8_t>(maskBit | length);
+    } else if (length <= 0xFFFF) {
+        out[offset++] = maskBit | 126;
+        out[offset++] = static_cast<uint8_t>(length >> 8);
+        out[offset++] = static_cast<uint8_t>(length);
+    } else {
+        out[offset++] = maskBit | 127;
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            out[offset++] = static_cast<uint8_t>(static_cast<uint64_t>(length) >> shift);
+        }
+    }
+
+    if (role_ == Role::Client) {
+        // Masked while copying, one pass over the payload
+        uint32_t key = randomMaskKey();
+        std::memcpy(out + offset, &key, sizeof(key));
+        copyMasked(out + offset + 4, payload.data(), length, out + offset);
+        offset += 4;
+    } else if (length > 0) {
+        std::memcpy(out + offset, payload.data(), length);
+    }
+
+    block.setSize(offset + length);
+    return BufferView(std::move(block));
+}
+
+bool WebSocketFramer::compress(const ByteView& payload, Buffer& output, size_t& outputSize) {
+#ifdef TCP_ZLIB_SUPPORT
+    z_stream& stream = deflate_->deflater;
+    output = BufferPool::shared().acquire(deflateBound(&stream, payload.size()) + 16);
+    outputSize = 0;
+    stream.next_in = const_cast<Bytef*>(payload.data());
+    stream.avail_in = static_cast<uInt>(payload.size());
+
+    // A sync flush ends on a byte boundary with the empty-block tail
+    do {
+        if (outputSize == output.capacity()) {
+            Buffer grown = BufferPool::shared().acquire(output.capacity() * 2);
+            std::memcpy(grown.data(), output.data(), outputSize);
+            output = std::move(grown);
+        }
+        stream.next_out = output.data() + outputSize;
+        stream.avail_out = static_cast<uInt>(output.capacity() - outputSize);
+        int status = deflate(&stream, Z_SYNC_FLUSH);
+        if (status == Z_BUF_ERROR) {
+            break; // The flush completed exactly at the end of the last call
+        }
+        if (status != Z_OK) {
+            deflateReset(&stream);
+            return false;
+        }
+        outputSize = output.capacity() - stream.avail_out;
+    } while (stream.avail_out == 0);
+
+    if (deflate_->noContextTakeover) {
+        deflateReset(&stream);
+    }
+    if (outputSize < 4 || std::memcmp(output.data() + outputSize - 4, kDeflateTail, 4) != 0) {
+        return false;
+    }
+    outputSize -= 4;
+    return true;
+#else
+    (void)payload;
+    (void)output;
+    (void)outputSize;
+    return false;
+#endif
+}
+
+bool WebSocketFramer::decompress(const uint8_t* data, size_t length, Buffer& output, size_t& outputSize) {
+#ifdef TCP_ZLIB_SUPPORT
+    z_stream& stream = deflate_->inflater;
+    // Room for one byte past the limit, to tell "at" from "over"
+    size_t limit = maxMessageSize_ + 1;
+    output = BufferPool::shared().acquire(std::min(limit, std::max<size_t>(length * 4, 1024)));
+    outputSize = 0;
+
+    const uint8_t* parts[2] = {data, kDeflateTail};
+    size_t sizes[2] = {length, sizeof(kDeflateTail)};
+    for (int part = 0; part < 2; part++) {
+        stream.next_in = const_cast<Bytef*>(parts[part]);
+        stream.avail_in = static_cast<uInt>(sizes[part]);
+        do {
+            if (outputSize == output.capacity()) {
+                if (output.capacity() >= limit) {
+                    fail(Error::MessageTooBig);
+                    return false;
+                }
+                Buffer grown = BufferPool::shared().acquire(std::min(limit, output.capacity() * 2));
+                std::memcpy(grown.data(), output.data(), outputSize);
+                output = std::move(grown);
+            }
+            stream.next_out = output.data() + outputSize;
+            stream.avail_out = static_cast<uInt>(output.capacity() - outputSize);
+            int status = inflate(&stream, Z_SYNC_FLUSH);
+            outputSize = output.capacity() - stream.avail_out;
+            if (status == Z_STREAM_END) {
+                // The peer ended its stream with a final block; the next
+                // message starts a new one
+                inflateReset(&stream);
+                break;
+            }
+            if (status == Z_BUF_ERROR && stream.avail_out > 0) {
+                break; // Input used up
+            }
+            if (status != Z_OK && status != Z_BUF_ERROR) {
+                inflateReset(&stream);
+                fail(Error::InvalidPayload);
+                return false;
+            }
+        } while (stream.avail_in > 0 || stream.avail_out == 0);
+    }
+
+    if (outputSize > maxMessageSize_) {
+        fail(Error::MessageTooBig);
+        return false;
+    }
+    output.setSize(outputSize);
+    return true;
+#else
+    (void)data;
+    (void)length;
+    (void)output;
+    (void)outputSize;
+    fail(Error::InvalidPayload);
+    return false;
+#endif
+}
+
+} // namespace tcp
@@ -0,0 +1,155 @@
+#pragma once
+
+#include "tcp_utils.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace tcp {
+
+// Streaming WebSocket (RFC 6455) codec. Frames are parsed incrementally
+// from each read: fragments are reassembled, control frames may arrive
+// between them, and a frame may span any number of reads. Masked payloads
+// are unmasked in place, 16 or 32 bytes at a time, and whole unfragmented
+// frames are delivered as slices of the input block without a copy.
+// permessage-deflate (RFC 7692) is available when built with zlib
+// (TCP_ZLIB_SUPPORT). Not thread-safe; use one framer per connection.
+class WebSocketFramer : public MessageFramer {
+public:
+    enum class Role {
+        Client, // Masks what it sends; expects unmasked frames
+        Server  // Sends unmasked; requires masked frames
+    };
+
+    enum class Opcode : uint8_t {
+        Continuation = 0x0,
+        Text = 0x1,
+        Binary = 0x2,
+        Close = 0x8,
+        Ping = 0x9,
+        Pong = 0xA
+    };
+
+    // Fails the stream until reset(); getCloseCode() is the code to close with
+    enum class Error {
+        None,
+        ProtocolError,    // Bad header, masking or opcode sequence (1002)
+        MessageTooBig,    // Over the maximum message size (1009)
+        InvalidPayload    // permessage-deflate data that doesn't inflate (1007)
+    };
+
+    // Text and Binary payloads are whole messages; Ping, Pong and Close
+    // come as they arrive. Views may be retained.
+    using MessageCallback = std::function<void(Opcode opcode, const BufferView& payload)>;
+
+    static constexpr size_t kDefaultMaxMessageSize = 16 * 1024 * 1024;
+    static constexpr size_t kMaxHeaderSize = 14;
+
+    explicit WebSocketFramer(Role role = Role::Server);
+    ~WebSocketFramer() override;
+
+    // Non-copyable
+    WebSocketFramer(const WebSocketFramer&) = delete;
+    WebSocketFramer& operator=(const WebSocketFramer&) = delete;
+
+    // MessageFramer: frame() encodes one binary message; unframe() returns
+    // data message payloads, handing control frames to the control callback
+    std::vector<uint8_t> frame(const std::vector<uint8_t>& data) override;
+    std::vector<std::vector<uint8_t>> unframe(const std::vector<uint8_t>& data) override;
+    bool isComplete(const std::vector<uint8_t>& data) override; // Holds at least one whole frame
+    void reset() override;
+    void appendFrame(const ByteView& message, std::vector<uint8_t>& out) override;
+    size_t decodeFrames(const BufferView& data, const BufferFrameCallback& onFrame) override;
+
+    // Streaming decoding; returns the number of messages and control frames
+    // delivered. Masked bytes are unmasked inside data's block, so the input
+    // must not be parsed again. The ByteView overload copies what it keeps.
+    size_t unframe(const BufferView& data, const MessageCallback& onMessage);
+    size_t unframe(const ByteView& data, const MessageCallback& onMessage);
+    void setOnControl(MessageCallback callback) { onControl_ = std::move(callback); } // For unframe(vector) and decodeFrames()
+
+    // Encoding into a pooled block, ready for TcpConnection::send(). Text
+    // and Binary messages over the compression threshold are deflated when
+    // negotiated; fin = false starts or continues a fragmented message,
+    // which is never compressed.
+    BufferView encode(Opcode opcode, const ByteView& payload, bool fin = true);
+    BufferView encodeClose(uint16_t code, const std::string& reason = std::string());
+
+    // permessage-deflate. A client puts deflateOffer() in its handshake's
+    // Sec-WebSocket-Extensions and passes the server's reply here; a server
+    // passes the client's offer and returns the result in its reply. Returns
+    // the accepted extension, or empty (nothing enabled) when there is none
+    // or the build has no zlib.
+    static std::string deflateOffer(bool noContextTakeover = false);
+    std::string negotiateDeflate(const std::string& extensions);
+    bool isDeflateEnabled() const { return deflate_ != nullptr; }
+    void setCompressionThreshold(size_t bytes) { compressionThreshold_ = bytes; } // Default 64
+    static bool isDeflateSupported();
+
+    // Limits
+    void setMaxMessageSize(size_t maxMessageSize) { maxMessageSize_ = maxMessageSize; }
+    size_t getMaxMessageSize() const { return maxMessageSize_; }
+    bool hasError() const { return error_ != Error::None; }
+    Error getError() const { return error_; }
+    uint16_t getCloseCode() const;
+    bool isClosed() const { return closed_; } // A Close frame arrived; later input is ignored
+
+    Role getRole() const { return role_; }
+
+    // XOR with the 4-byte key starting at key byte keyOffset % 4: 32 bytes
+    // at a time with AVX2, 16 with SSE2/NEON, then 8
+    static void applyMask(uint8_t* data, size_t length, const uint8_t key[4], size_t keyOffset = 0);
+    static void copyMasked(uint8_t* destination, const uint8_t* source, size_t length, const uint8_t key[4],
+                           size_t keyOffset = 0);
+
+private:
+    struct FrameHeader {
+        bool fin = false;
+        uint8_t rsv = 0; // RSV1-3 bits as in the first byte
+        bool masked = false;
+        uint8_t opcode = 0;
+        uint8_t key[4] = {0, 0, 0, 0};
+        uint64_t length = 0;
+        size_t size = 0; // Header bytes
+    };
+    struct Deflate; // zlib streams, when negotiated
+
+    Role role_;
+    size_t maxMessageSize_;
+    size_t compressionThreshold_;
+    Error error_;
+    bool closed_;
+    MessageCallback onControl_;
+
+    // Header straddling reads
+    uint8_t header_[kMaxHeaderSize];
+    size_t headerSize_;
+
+    // Frame in progress
+    bool inFrame_;
+    FrameHeader frame_;
+    uint64_t payloadRead_;
+
+    // Message in progress (data frames) and control frame in progress
+    bool inMessage_;
+    Opcode messageOpcode_;
+    bool messageCompressed_;
+    Buffer message_;
+    size_t messageSize_;
+    uint8_t control_[125];
+    size_t controlSize_;
+
+    std::unique_ptr<Deflate> deflate_;
+
+    static size_t parseHeader(const uint8_t* data, size_t size, FrameHeader& header);
+    bool validate(const FrameHeader& header);
+    void fail(Error error);
+    void appendMessage(const uint8_t* data, size_t length);
+    size_t finishFrame(const BufferView* direct, const MessageCallback& onMessage);
+    BufferView writeFrame(uint8_t firstByte, const ByteView& payload);
+    bool compress(const ByteView& payload, Buffer& output, size_t& outputSize);
+    bool decompress(const uint8_t* data, size_t length, Buffer& output, size_t& outputSize);
+};
+
+} // namespace tcp